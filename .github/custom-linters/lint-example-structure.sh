@@ -81,6 +81,54 @@ check_examples_have_top_readme_entry() {
   return $ret
 }
 
+check_shared_sources_are_identical() {
+  local ret=0
+  local file=
+  local copy=
+  local copies=
+  local reference=
+  local fail_list=()
+
+  # Helpers that several examples keep their own copy of, since every example
+  # is built on its own. A fix to one copy must be made to all of them.
+  local shared_files=(
+    framerate_controller.c
+    framerate_controller.h
+    labelparse.c
+    labelparse.h
+    model_cache.c
+    model_cache.h
+    panic.c
+    panic.h
+    power_backoff.c
+    power_backoff.h
+    track_store.c
+    track_store.h
+    tracker.c
+    tracker.h
+  )
+
+  print_section "Verify that the copies of shared helper sources are identical"
+
+  for file in "${shared_files[@]}"; do
+    copies="$(git ls-files "*/app/$file")"
+    reference="$(printf '%s\n' "$copies" | head -n 1)"
+    for copy in $copies; do
+      cmp -s "$reference" "$copy" || fail_list+=("$copy differs from $reference")
+    done
+  done
+
+  if [ "${#fail_list[@]}" -ne 0 ]; then
+    print_line "ERROR: Copies of shared sources that have drifted:"
+    print_list_no_split_error "${fail_list[@]}"
+    ret=1
+  else
+    print_bullet_pass "All copies of shared sources are identical."
+  fi
+
+  return $ret
+}
+
 #-------------------------------------------------------------------------------
 # Main
 #-------------------------------------------------------------------------------
@@ -90,6 +138,7 @@ found_error=no
 
 if ! check_examples_have_workflow_file; then found_error=yes; fi
 if ! check_examples_have_top_readme_entry; then found_error=yes; fi
+if ! check_shared_sources_are_identical; then found_error=yes; fi
 
 [ "$found_error" = no ] || exit_value=1
 
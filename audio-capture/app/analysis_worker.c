@@ -0,0 +1,197 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "analysis_worker.h"
+
+#include <errno.h>
+#include <string.h>
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+
+static void classify(struct analysis_worker* worker,
+                     const float* const* planes,
+                     uint32_t n_samples) {
+    struct audio_classification result;
+    uint32_t offset = 0;
+
+    while (offset < n_samples) {
+        offset += mel_spectrogram_feed(&worker->mel,
+                                       planes,
+                                       worker->channels,
+                                       offset,
+                                       n_samples - offset);
+        if (!mel_spectrogram_frame_ready(&worker->mel)) {
+            continue;
+        }
+        mel_spectrogram_compute(&worker->mel, audio_classifier_next_frame(worker->classifier));
+        if (!audio_classifier_commit_frame(worker->classifier, &result)) {
+            continue;
+        }
+        if (worker->classifications == 0 || result.top_score > worker->best.top_score) {
+            worker->best = result;
+        }
+        worker->classifications++;
+    }
+}
+
+static void analyse(struct analysis_worker* worker, const struct audio_ring_slot* slot) {
+    const float* planes[LEVEL_METER_MAX_CHANNELS];
+    uint32_t c;
+
+    if (slot->channels != worker->channels || slot->rate != worker->rate) {
+        worker->channels = slot->channels;
+        worker->rate     = slot->rate;
+        level_meter_init(&worker->meter, worker->channels, worker->rate);
+        if (worker->classifier != NULL) {
+            worker->classifying =
+                mel_spectrogram_init(&worker->mel, worker->rate, worker->classifier->bands) == 0;
+            audio_classifier_reset(worker->classifier);
+        }
+    }
+
+    for (c = 0; c < worker->meter.channels; c++) {
+        planes[c] = slot->samples + c * slot->n_samples;
+    }
+    level_meter_process(&worker->meter, planes, slot->n_samples);
+    if (worker->classifying) {
+        classify(worker, planes, slot->n_samples);
+    }
+}
+
+static void report(struct analysis_worker* worker) {
+    struct analysis_report report = {0};
+    uint64_t dropped              = atomic_load(&worker->ring.dropped);
+
+    report.channels = worker->meter.channels;
+    level_meter_read(&worker->meter, report.peaks, report.rms);
+    report.loudness          = level_meter_loudness(&worker->meter);
+    report.dropped           = dropped - worker->dropped_reported;
+    worker->dropped_reported = dropped;
+    report.classifications   = worker->classifications;
+    report.best              = worker->best;
+    worker->classifications  = 0;
+
+    worker->report_func(worker->report_data, &report);
+}
+
+static void* worker_thread(void* data) {
+    struct analysis_worker* worker = data;
+    const struct audio_ring_slot* slot;
+
+    while (!atomic_load(&worker->stopping)) {
+        if (sem_wait(&worker->wakeup) != 0) {
+            continue;
+        }
+        while ((slot = audio_ring_begin_read(&worker->ring)) != NULL) {
+            analyse(worker, slot);
+            audio_ring_commit_read(&worker->ring);
+        }
+        if (atomic_exchange(&worker->report_requested, false)) {
+            report(worker);
+        }
+    }
+    return NULL;
+}
+
+int analysis_worker_start(struct analysis_worker* worker,
+                          struct audio_classifier* classifier,
+                          analysis_report_func report_func,
+                          void* report_data) {
+    int res;
+
+    memset(worker, 0, sizeof(*worker));
+    worker->classifier  = classifier;
+    worker->report_func = report_func;
+    worker->report_data = report_data;
+    atomic_init(&worker->stopping, false);
+    atomic_init(&worker->report_requested, false);
+
+    res = audio_ring_init(&worker->ring);
+    if (res < 0) {
+        audio_classifier_destroy(classifier);
+        return res;
+    }
+    if (sem_init(&worker->wakeup, 0, 0) != 0) {
+        res = -errno;
+        audio_ring_clear(&worker->ring);
+        audio_classifier_destroy(classifier);
+        return res;
+    }
+    res = pthread_create(&worker->thread, NULL, worker_thread, worker);
+    if (res != 0) {
+        sem_destroy(&worker->wakeup);
+        audio_ring_clear(&worker->ring);
+        audio_classifier_destroy(classifier);
+        return -res;
+    }
+    return 0;
+}
+
+void analysis_worker_stop(struct analysis_worker* worker) {
+    atomic_store(&worker->stopping, true);
+    sem_post(&worker->wakeup);
+    pthread_join(worker->thread, NULL);
+    sem_destroy(&worker->wakeup);
+    audio_ring_clear(&worker->ring);
+    audio_classifier_destroy(worker->classifier);
+}
+
+bool analysis_worker_push(struct analysis_worker* worker,
+                          const float* const* planes,
+                          uint32_t channels,
+                          uint32_t rate,
+                          uint32_t n_samples) {
+    uint32_t per_slot;
+    uint32_t done = 0;
+    bool complete = true;
+
+    if (channels == 0 || channels > LEVEL_METER_MAX_CHANNELS) {
+        return false;
+    }
+    per_slot = AUDIO_RING_SLOT_SAMPLES / channels;
+
+    while (done < n_samples) {
+        struct audio_ring_slot* slot = audio_ring_begin_write(&worker->ring);
+        uint32_t count               = MIN(n_samples - done, per_slot);
+        uint32_t c;
+
+        if (slot == NULL) {
+            atomic_fetch_add_explicit(&worker->ring.dropped,
+                                      n_samples - done,
+                                      memory_order_relaxed);
+            complete = false;
+            break;
+        }
+
+        slot->channels  = channels;
+        slot->rate      = rate;
+        slot->n_samples = count;
+        for (c = 0; c < channels; c++) {
+            memcpy(slot->samples + c * count, planes[c] + done, count * sizeof(float));
+        }
+        audio_ring_commit_write(&worker->ring);
+        done += count;
+    }
+
+    /* Wakes the worker without a system call unless it is waiting. */
+    sem_post(&worker->wakeup);
+    return complete;
+}
+
+void analysis_worker_request_report(struct analysis_worker* worker) {
+    atomic_store(&worker->report_requested, true);
+    sem_post(&worker->wakeup);
+}
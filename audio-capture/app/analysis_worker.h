@@ -0,0 +1,116 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Worker thread that analyses the audio of one stream.
+ *
+ * The process callback of the stream runs in the real-time thread of
+ * pipewire and only copies the samples to a ring, with
+ * analysis_worker_push(). The worker takes the blocks from the ring and runs
+ * the analysis on them, so heavier analysis can not delay the callback or
+ * make pipewire run out of buffers. If the worker falls behind, blocks are
+ * dropped and counted instead.
+ *
+ * With a classifier, the worker also computes the log-mel spectrogram of the
+ * audio and classifies it, see audio_classifier.h.
+ *
+ * Everything but the ring and the flags is only touched by the worker.
+ */
+
+#pragma once
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "audio_classifier.h"
+#include "audio_ring.h"
+#include "level_meter.h"
+#include "mel_spectrogram.h"
+
+/* The result of the analysis since the last report. */
+struct analysis_report {
+    uint32_t channels;
+    float peaks[LEVEL_METER_MAX_CHANNELS];
+    float rms[LEVEL_METER_MAX_CHANNELS];
+    float loudness;
+    /* Samples per channel dropped since the last report. */
+    uint64_t dropped;
+    /* The classifications since the last report, and the one with the top score. */
+    uint32_t classifications;
+    struct audio_classification best;
+};
+
+/* Called from the worker thread with a report that was asked for. */
+typedef void (*analysis_report_func)(void* data, const struct analysis_report* report);
+
+struct analysis_worker {
+    struct audio_ring ring;
+    pthread_t thread;
+    sem_t wakeup;
+    atomic_bool stopping;
+    atomic_bool report_requested;
+    analysis_report_func report_func;
+    void* report_data;
+
+    /* The format of the last block, and the state of the analysis. */
+    uint32_t channels;
+    uint32_t rate;
+    struct level_meter meter;
+    uint64_t dropped_reported;
+    struct audio_classifier* classifier;
+    bool classifying;
+    struct mel_spectrogram mel;
+    uint32_t classifications;
+    struct audio_classification best;
+};
+
+/**
+ * Start a worker, that takes over the classifier, which can be NULL. Returns
+ * 0, or a negative errno after destroying the classifier.
+ */
+int analysis_worker_start(struct analysis_worker* worker,
+                          struct audio_classifier* classifier,
+                          analysis_report_func report_func,
+                          void* report_data);
+
+/**
+ * Stop the worker, wait for it and destroy its classifier. The producer must
+ * have stopped pushing.
+ */
+void analysis_worker_stop(struct analysis_worker* worker);
+
+/**
+ * Copy samples to the worker, from one plane per channel. Safe to call from
+ * the real-time thread: it does not allocate, lock or block.
+ *
+ * Returns false if some of the samples were dropped since the ring was full,
+ * or all of them since there are no channels or more than
+ * LEVEL_METER_MAX_CHANNELS.
+ */
+bool analysis_worker_push(struct analysis_worker* worker,
+                          const float* const* planes,
+                          uint32_t channels,
+                          uint32_t rate,
+                          uint32_t n_samples);
+
+/**
+ * Ask the worker to report the analysis since the last report, once it has
+ * processed the blocks pushed so far.
+ */
+void analysis_worker_request_report(struct analysis_worker* worker);
@@ -0,0 +1,381 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "audio_classifier.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <syslog.h>
+#include <unistd.h>
+
+#include "mel_spectrogram.h"
+
+static bool find_device(larodConnection* conn, const char* device_name) {
+    larodError* error  = NULL;
+    size_t num_devices = 0;
+    const larodDevice** devices;
+    size_t i;
+
+    devices = larodListDevices(conn, &num_devices, &error);
+    if (num_devices == 0) {
+        syslog(LOG_ERR, "Unable to list larod devices: %s", error->msg);
+        larodClearError(&error);
+        return false;
+    }
+    for (i = 0; i < num_devices; i++) {
+        const char* name = larodGetDeviceName(devices[i], &error);
+
+        if (name != NULL && strcmp(name, device_name) == 0) {
+            return true;
+        }
+        larodClearError(&error);
+    }
+    syslog(LOG_ERR, "No larod device found for %s", device_name);
+    return false;
+}
+
+static bool load_model(struct audio_classifier* classifier, const char* model_file) {
+    larodError* error = NULL;
+    const larodDevice* device;
+
+    classifier->larod_model_fd = open(model_file, O_RDONLY);
+    if (classifier->larod_model_fd < 0) {
+        syslog(LOG_ERR, "Unable to open model file %s: %s", model_file, strerror(errno));
+        return false;
+    }
+    if (!find_device(classifier->conn, classifier->device_name)) {
+        return false;
+    }
+    device = larodGetDevice(classifier->conn, classifier->device_name, 0, &error);
+    if (device == NULL) {
+        syslog(LOG_ERR, "Unable to get larod device %s: %s", classifier->device_name, error->msg);
+        larodClearError(&error);
+        return false;
+    }
+
+    syslog(LOG_INFO, "Loading the audio model %s on %s", model_file, classifier->device_name);
+    classifier->model = larodLoadModel(classifier->conn,
+                                       classifier->larod_model_fd,
+                                       device,
+                                       LAROD_ACCESS_PRIVATE,
+                                       "Audio capture model",
+                                       NULL,
+                                       &error);
+    if (classifier->model == NULL) {
+        syslog(LOG_ERR, "Unable to load model %s: %s", model_file, error->msg);
+        larodClearError(&error);
+        return false;
+    }
+    return true;
+}
+
+/* Map the tensor, and check that it is at least min_size bytes. */
+static void* map_tensor(larodTensor* tensor, int prot, size_t min_size, size_t* size) {
+    larodError* error = NULL;
+    void* data;
+    int fd;
+
+    fd = larodGetTensorFd(tensor, &error);
+    if (fd == LAROD_INVALID_FD || !larodGetTensorFdSize(tensor, size, &error)) {
+        syslog(LOG_ERR, "Could not get the fd of a tensor: %s", error->msg);
+        larodClearError(&error);
+        return NULL;
+    }
+    if (*size < min_size) {
+        syslog(LOG_ERR, "Tensor of %zu bytes is smaller than %zu bytes", *size, min_size);
+        return NULL;
+    }
+    data = mmap(NULL, *size, prot, MAP_SHARED, fd, 0);
+    if (data == MAP_FAILED) {
+        syslog(LOG_ERR, "Could not map a tensor: %s", strerror(errno));
+        return NULL;
+    }
+    return data;
+}
+
+/* The number of elements of the tensor, and the last two that are not 1. */
+static size_t get_dims(larodTensor* tensor, uint32_t* rows, uint32_t* columns) {
+    larodError* error           = NULL;
+    const larodTensorDims* dims = larodGetTensorDims(tensor, &error);
+    size_t elements             = 1;
+    size_t found                = 0;
+    size_t i;
+
+    *rows    = 1;
+    *columns = 1;
+    if (dims == NULL) {
+        larodClearError(&error);
+        return 0;
+    }
+    for (i = 0; i < dims->len; i++) {
+        elements *= dims->dims[i];
+        if (dims->dims[i] > 1) {
+            *rows    = *columns;
+            *columns = dims->dims[i];
+            found++;
+        }
+    }
+    return found <= 2 ? elements : 0;
+}
+
+static bool setup_tensors(struct audio_classifier* classifier) {
+    larodError* error = NULL;
+    size_t score_size;
+    uint32_t rows;
+    uint32_t columns;
+
+    classifier->input_tensors = larodAllocModelInputs(classifier->conn,
+                                                      classifier->model,
+                                                      LAROD_FD_PROP_READWRITE | LAROD_FD_PROP_MAP,
+                                                      &classifier->num_inputs,
+                                                      NULL,
+                                                      &error);
+    if (classifier->input_tensors == NULL) {
+        syslog(LOG_ERR, "Failed allocating input tensors: %s", error->msg);
+        larodClearError(&error);
+        return false;
+    }
+    classifier->output_tensors = larodAllocModelOutputs(classifier->conn,
+                                                        classifier->model,
+                                                        LAROD_FD_PROP_READWRITE | LAROD_FD_PROP_MAP,
+                                                        &classifier->num_outputs,
+                                                        NULL,
+                                                        &error);
+    if (classifier->output_tensors == NULL) {
+        syslog(LOG_ERR, "Failed allocating output tensors: %s", error->msg);
+        larodClearError(&error);
+        return false;
+    }
+
+    if (classifier->num_inputs != 1 ||
+        larodGetTensorDataType(classifier->input_tensors[0], &error) !=
+            LAROD_TENSOR_DATA_TYPE_FLOAT32 ||
+        get_dims(classifier->input_tensors[0], &rows, &columns) == 0 || rows < 2 ||
+        columns > MEL_SPECTROGRAM_MAX_BANDS) {
+        syslog(LOG_ERR,
+               "The model must have one float32 input of frames times at most %d bands",
+               MEL_SPECTROGRAM_MAX_BANDS);
+        larodClearError(&error);
+        return false;
+    }
+    classifier->frames = rows;
+    classifier->bands  = columns;
+    classifier->input  = map_tensor(classifier->input_tensors[0],
+                                   PROT_READ | PROT_WRITE,
+                                   (size_t)rows * columns * sizeof(float),
+                                   &classifier->input_size);
+    if (classifier->input == NULL) {
+        return false;
+    }
+
+    classifier->output_datatype = larodGetTensorDataType(classifier->output_tensors[0], &error);
+    classifier->num_classes     = get_dims(classifier->output_tensors[0], &rows, &columns);
+    if ((classifier->output_datatype != LAROD_TENSOR_DATA_TYPE_FLOAT32 &&
+         classifier->output_datatype != LAROD_TENSOR_DATA_TYPE_UINT8) ||
+        classifier->num_classes == 0) {
+        syslog(LOG_ERR, "The first output of the model must be float32 or uint8 scores");
+        larodClearError(&error);
+        return false;
+    }
+    score_size = classifier->output_datatype == LAROD_TENSOR_DATA_TYPE_UINT8 ? 1 : sizeof(float);
+    classifier->output = map_tensor(classifier->output_tensors[0],
+                                    PROT_READ,
+                                    classifier->num_classes * score_size,
+                                    &classifier->output_size);
+    if (classifier->output == NULL) {
+        return false;
+    }
+
+    classifier->inf_req = larodCreateJobRequest(classifier->model,
+                                                classifier->input_tensors,
+                                                classifier->num_inputs,
+                                                classifier->output_tensors,
+                                                classifier->num_outputs,
+                                                NULL,
+                                                &error);
+    if (classifier->inf_req == NULL) {
+        syslog(LOG_ERR, "Failed creating inference job request: %s", error->msg);
+        larodClearError(&error);
+        return false;
+    }
+    syslog(LOG_INFO,
+           "Classifying %u frames of %u mel bands into %u classes",
+           classifier->frames,
+           classifier->bands,
+           classifier->num_classes);
+    return true;
+}
+
+struct audio_classifier* audio_classifier_new(const char* model_file, const char* device_name) {
+    struct audio_classifier* classifier = calloc(1, sizeof(struct audio_classifier));
+    larodError* error                   = NULL;
+
+    if (classifier == NULL) {
+        return NULL;
+    }
+    classifier->larod_model_fd = -1;
+    classifier->device_name    = device_name;
+    classifier->owner_job_lock = &classifier->job_lock;
+    pthread_mutex_init(&classifier->job_lock, NULL);
+
+    if (!larodConnect(&classifier->conn, &error)) {
+        syslog(LOG_ERR, "Could not connect to larod: %s", error->msg);
+        larodClearError(&error);
+        audio_classifier_destroy(classifier);
+        return NULL;
+    }
+    /* The tensors of the owner check that the model fits the spectrogram. */
+    if (!load_model(classifier, model_file) || !setup_tensors(classifier)) {
+        audio_classifier_destroy(classifier);
+        return NULL;
+    }
+    return classifier;
+}
+
+struct audio_classifier* audio_classifier_new_shared(struct audio_classifier* owner) {
+    struct audio_classifier* classifier = calloc(1, sizeof(struct audio_classifier));
+
+    if (classifier == NULL) {
+        return NULL;
+    }
+    /* Use the connection and the loaded model of the owner, so the model is
+     * only loaded once, but have separate input and output tensors. */
+    classifier->conn           = owner->conn;
+    classifier->model          = owner->model;
+    classifier->device_name    = owner->device_name;
+    classifier->larod_model_fd = -1;
+    classifier->shared_model   = true;
+    classifier->owner_job_lock = &owner->job_lock;
+    pthread_mutex_init(&classifier->job_lock, NULL);
+
+    if (!setup_tensors(classifier)) {
+        audio_classifier_destroy(classifier);
+        return NULL;
+    }
+    return classifier;
+}
+
+void audio_classifier_destroy(struct audio_classifier* classifier) {
+    larodError* error = NULL;
+
+    if (classifier == NULL) {
+        return;
+    }
+
+    larodDestroyJobRequest(&classifier->inf_req);
+    if (classifier->input != NULL) {
+        munmap(classifier->input, classifier->input_size);
+    }
+    if (classifier->output != NULL) {
+        munmap(classifier->output, classifier->output_size);
+    }
+    if (classifier->input_tensors != NULL &&
+        !larodDestroyTensors(classifier->conn,
+                             &classifier->input_tensors,
+                             classifier->num_inputs,
+                             &error)) {
+        larodClearError(&error);
+    }
+    if (classifier->output_tensors != NULL &&
+        !larodDestroyTensors(classifier->conn,
+                             &classifier->output_tensors,
+                             classifier->num_outputs,
+                             &error)) {
+        larodClearError(&error);
+    }
+
+    /* A classifier sharing the model of another leaves the model and the
+     * connection to the owner, which must be destroyed last. */
+    if (!classifier->shared_model) {
+        larodDestroyModel(&classifier->model);
+        /* The privately loaded model is released by larod when the session is
+         * disconnected. */
+        larodDisconnect(&classifier->conn, NULL);
+    }
+    if (classifier->larod_model_fd >= 0) {
+        close(classifier->larod_model_fd);
+    }
+    pthread_mutex_destroy(&classifier->job_lock);
+    free(classifier);
+}
+
+float* audio_classifier_next_frame(struct audio_classifier* classifier) {
+    return classifier->input + (size_t)classifier->next_frame * classifier->bands;
+}
+
+static float score(const struct audio_classifier* classifier, uint32_t index) {
+    if (classifier->output_datatype == LAROD_TENSOR_DATA_TYPE_UINT8) {
+        return ((const uint8_t*)classifier->output)[index] / 255.0f;
+    }
+    return ((const float*)classifier->output)[index];
+}
+
+static bool run_inference(struct audio_classifier* classifier,
+                          struct audio_classification* result) {
+    larodError* error = NULL;
+    bool ran;
+    uint32_t i;
+
+    pthread_mutex_lock(classifier->owner_job_lock);
+    ran = larodRunJob(classifier->conn, classifier->inf_req, &error);
+    pthread_mutex_unlock(classifier->owner_job_lock);
+    if (!ran) {
+        /* The audio goes on, so the job is skipped if there is not enough power. */
+        if (error->code != LAROD_ERROR_POWER_NOT_AVAILABLE) {
+            syslog(LOG_WARNING, "Unable to run inference job: %s (%d)", error->msg, error->code);
+        }
+        larodClearError(&error);
+        return false;
+    }
+
+    result->top_class = 0;
+    result->top_score = score(classifier, 0);
+    for (i = 1; i < classifier->num_classes; i++) {
+        float s = score(classifier, i);
+
+        if (s > result->top_score) {
+            result->top_class = i;
+            result->top_score = s;
+        }
+    }
+    return true;
+}
+
+bool audio_classifier_commit_frame(struct audio_classifier* classifier,
+                                   struct audio_classification* result) {
+    uint32_t kept = classifier->frames / 2;
+    bool ran;
+
+    if (++classifier->next_frame < classifier->frames) {
+        return false;
+    }
+    ran = run_inference(classifier, result);
+
+    /* The next input starts with the newest frames of this one. */
+    memmove(classifier->input,
+            audio_classifier_next_frame(classifier) - (size_t)kept * classifier->bands,
+            (size_t)kept * classifier->bands * sizeof(float));
+    classifier->next_frame = kept;
+    return ran;
+}
+
+void audio_classifier_reset(struct audio_classifier* classifier) {
+    classifier->next_frame = 0;
+}
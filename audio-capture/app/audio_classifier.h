@@ -0,0 +1,114 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/**
+ * Audio event classifier run with larod on log-mel spectrograms.
+ *
+ * The classifier is set up like the model provider of the vdo-larod example:
+ * the owner connects to larod and loads the model once, and each stream gets
+ * a classifier sharing the connection and the model, with input and output
+ * tensors and a job request of its own. Since the workers of the streams run
+ * the jobs from their threads, the jobs on the connection are serialized by a
+ * lock of the owner.
+ *
+ * The model takes one float32 input of frames times bands log-mel values,
+ * e.g. [1, 96, 64] or [1, 96, 64, 1], and gives the scores of the classes in
+ * its first output. The input tensor is mapped, and the frames of the
+ * spectrogram are written straight into it. When it is full the job is run,
+ * and the newest half of the frames is moved to the start, so the
+ * classifications overlap by half of the input.
+ *
+ * Errors are logged, and the application runs without the classifier.
+ */
+
+#pragma once
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "larod.h"
+
+struct audio_classifier {
+    larodConnection* conn;
+    const char* device_name;
+    larodModel* model;
+    int larod_model_fd;
+    /* The connection and the model belong to another classifier. */
+    bool shared_model;
+    /* The lock of the owner is held while a job runs on the connection. */
+    pthread_mutex_t job_lock;
+    pthread_mutex_t* owner_job_lock;
+
+    /* Inference variables. */
+    larodTensor** input_tensors;
+    size_t num_inputs;
+    larodTensor** output_tensors;
+    size_t num_outputs;
+    larodJobRequest* inf_req;
+
+    /* The mapped input, frames rows of bands values with the oldest first. */
+    float* input;
+    size_t input_size;
+    uint32_t frames;
+    uint32_t bands;
+    uint32_t next_frame;
+    /* The mapped scores of the first output. */
+    void* output;
+    size_t output_size;
+    larodTensorDataType output_datatype;
+    uint32_t num_classes;
+};
+
+/* The result of a classification. */
+struct audio_classification {
+    uint32_t top_class;
+    float top_score;
+};
+
+/**
+ * Connect to larod and load the model file on the device, e.g. cpu-tflite.
+ * Returns NULL if that fails. The owner only holds the model and must be
+ * destroyed after the classifiers sharing it.
+ */
+struct audio_classifier* audio_classifier_new(const char* model_file, const char* device_name);
+
+/**
+ * Set up a classifier using the connection and the model of the owner.
+ * Returns NULL if that fails.
+ */
+struct audio_classifier* audio_classifier_new_shared(struct audio_classifier* owner);
+
+void audio_classifier_destroy(struct audio_classifier* classifier);
+
+/**
+ * The row of the input tensor to write the bands of the next frame to.
+ */
+float* audio_classifier_next_frame(struct audio_classifier* classifier);
+
+/**
+ * Add the frame written to the row of audio_classifier_next_frame(), and
+ * classify the input if it is full. Returns true with the result if the
+ * input was classified.
+ */
+bool audio_classifier_commit_frame(struct audio_classifier* classifier,
+                                   struct audio_classification* result);
+
+/**
+ * Forget the frames in the input, e.g. when the format of the audio changes.
+ */
+void audio_classifier_reset(struct audio_classifier* classifier);
@@ -0,0 +1,36 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "audio_ring.h"
+
+#include <errno.h>
+#include <stdlib.h>
+
+int audio_ring_init(struct audio_ring* ring) {
+    ring->slots = calloc(AUDIO_RING_SLOTS, sizeof(struct audio_ring_slot));
+    if (ring->slots == NULL) {
+        return -ENOMEM;
+    }
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    atomic_init(&ring->dropped, 0);
+    return 0;
+}
+
+void audio_ring_clear(struct audio_ring* ring) {
+    free(ring->slots);
+    ring->slots = NULL;
+}
@@ -0,0 +1,106 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Ring of audio blocks from one producer thread to one consumer thread.
+ *
+ * The producer is the real-time thread of pipewire, so writing to the ring
+ * never allocates, locks or blocks: the slots are allocated when the ring is
+ * created, and the positions are atomics that only one of the threads writes.
+ * When the consumer falls behind and the ring is full, the producer drops the
+ * block instead of waiting.
+ */
+
+#pragma once
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* A power of two. */
+#define AUDIO_RING_SLOTS 16
+/* Samples of all channels in a slot, e.g. 1024 samples of 8 channels. */
+#define AUDIO_RING_SLOT_SAMPLES 8192
+
+struct audio_ring_slot {
+    uint32_t channels;
+    uint32_t rate;
+    /* Samples per channel. The channels follow each other in samples. */
+    uint32_t n_samples;
+    float samples[AUDIO_RING_SLOT_SAMPLES];
+};
+
+struct audio_ring {
+    struct audio_ring_slot* slots;
+    /* The next slot to write, written by the producer only. */
+    _Alignas(64) atomic_uint head;
+    /* The next slot to read, written by the consumer only. */
+    _Alignas(64) atomic_uint tail;
+    /* Samples per channel dropped since the ring was full. */
+    atomic_ullong dropped;
+};
+
+/**
+ * Allocate the slots of a ring. Returns 0, or a negative errno.
+ */
+int audio_ring_init(struct audio_ring* ring);
+
+void audio_ring_clear(struct audio_ring* ring);
+
+/**
+ * For the producer: get the slot to write next, or NULL if the ring is full.
+ */
+static inline struct audio_ring_slot* audio_ring_begin_write(struct audio_ring* ring) {
+    unsigned int head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    unsigned int tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+    if (head - tail == AUDIO_RING_SLOTS) {
+        return NULL;
+    }
+    return &ring->slots[head % AUDIO_RING_SLOTS];
+}
+
+/**
+ * For the producer: hand the slot from audio_ring_begin_write() to the consumer.
+ */
+static inline void audio_ring_commit_write(struct audio_ring* ring) {
+    unsigned int head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+/**
+ * For the consumer: get the oldest slot written, or NULL if the ring is empty.
+ */
+static inline const struct audio_ring_slot* audio_ring_begin_read(struct audio_ring* ring) {
+    unsigned int tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    unsigned int head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+    if (head == tail) {
+        return NULL;
+    }
+    return &ring->slots[tail % AUDIO_RING_SLOTS];
+}
+
+/**
+ * For the consumer: give the slot from audio_ring_begin_read() back to the
+ * producer.
+ */
+static inline void audio_ring_commit_read(struct audio_ring* ring) {
+    unsigned int tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+}
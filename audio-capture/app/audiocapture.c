@@ -20,9 +20,12 @@
  * This application is a basic pipewire application using a pipewire mainloop to
  * process audio data.
  *
- * The application starts an audio stream and calculates the peak sample values
- * for all channels of all nodes over a 5 second interval and prints them to the
- * system log. The log messages can be followed with the command:
+ * The application starts an audio stream and calculates the peak and RMS levels
+ * for all channels of all nodes over a 5 second interval, and the short-term
+ * loudness of each node, and prints them to the system log. With a larod
+ * device and an audio classification model given as arguments, the audio of
+ * each node is also classified. The log messages can be followed with the
+ * command:
  *
  * journalctl -t audiocapture -f
  *
@@ -32,11 +35,12 @@
  * Suppose that you have gone through the steps of installation. Then you can
  * also run it on your device like this:
  *
- *     /usr/local/packages/audiocapture/audiocapture
+ *     /usr/local/packages/audiocapture/audiocapture [<device> <model file>]
  *
  * and then the output will go to stderr instead of the system log.
  */
 
+#include <inttypes.h>
 #include <math.h>
 #include <stdlib.h>
 #include <string.h>
@@ -47,6 +51,8 @@
 #include <spa/param/audio/format-utils.h>
 #pragma GCC diagnostic pop
 
+#include "analysis_worker.h"
+
 PW_LOG_TOPIC_STATIC(topic, "audiocapture");
 #define PW_LOG_TOPIC_DEFAULT topic
 
@@ -59,6 +65,8 @@ struct impl {
     struct spa_hook registry_listener;
     struct spa_list streams;
     struct spa_source* timer_source;
+    /* Owns the model that the classifiers of the streams share, or NULL. */
+    struct audio_classifier* classifier;
 };
 
 struct stream_data {
@@ -68,7 +76,7 @@ struct stream_data {
     uint32_t target_id;
     char target_name[64];
     struct spa_audio_info info;
-    float peaks[SPA_AUDIO_MAX_CHANNELS];
+    struct analysis_worker worker;
 };
 
 /**
@@ -124,13 +132,18 @@ static void on_state_changed(void* data,
 }
 
 /**
- * A process callback function that will be called from the mainloop when there
- * are new audio samples to process.
+ * A process callback function that will be called from the real-time thread of
+ * pipewire when there are new audio samples to process. It only hands the
+ * samples to the analysis worker of the stream, and must not allocate, lock or
+ * block.
  */
 static void on_process(void* data) {
     struct stream_data* stream_data = data;
     struct pw_buffer* b;
     struct spa_buffer* buf;
+    const float* planes[SPA_AUDIO_MAX_CHANNELS];
+    uint32_t channels  = stream_data->info.info.raw.channels;
+    uint32_t n_samples = UINT32_MAX;
     unsigned int c;
 
     b = pw_stream_dequeue_buffer(stream_data->stream);
@@ -140,38 +153,62 @@ static void on_process(void* data) {
     }
     buf = b->buffer;
 
-    for (c = 0; c < stream_data->info.info.raw.channels; c++) {
-        const float* samples;
-        uint32_t n_samples;
-        float min;
-        float max;
-        unsigned int i;
-        float peak;
-
-        samples = buf->datas[c].data;
-        if (samples == NULL) {
-            pw_log_warn("No data in buffer from %s, channel %u.", stream_data->target_name, c);
+    if (channels == 0 || channels > buf->n_datas) {
+        goto out;
+    }
+    for (c = 0; c < channels; c++) {
+        planes[c] = buf->datas[c].data;
+        if (planes[c] == NULL) {
             goto out;
         }
-        n_samples = buf->datas[c].chunk->size / sizeof(float);
-
-        min = max = samples[0];
-        for (i = 0; i < n_samples; i++) {
-            if (samples[i] > max)
-                max = samples[i];
-            if (samples[i] < min)
-                min = samples[i];
-        }
-        peak = fmaxf(fabs(min), max);
-        if (peak > stream_data->peaks[c]) {
-            stream_data->peaks[c] = peak;
-        }
+        n_samples = SPA_MIN(n_samples, buf->datas[c].chunk->size / (uint32_t)sizeof(float));
     }
 
+    /* The samples are copied, so the buffer is given back at once. */
+    analysis_worker_push(&stream_data->worker,
+                         planes,
+                         channels,
+                         stream_data->info.info.raw.rate,
+                         n_samples);
+
 out:
     pw_stream_queue_buffer(stream_data->stream, b);
 }
 
+/**
+ * A callback function that will be called from the analysis worker of a stream
+ * with the levels since the last report.
+ */
+static void on_report(void* data, const struct analysis_report* report) {
+    struct stream_data* stream_data = data;
+    unsigned int c;
+
+    for (c = 0; c < report->channels; c++) {
+        pw_log_info("Node %s, channel %u, peak %.1f dBFS, RMS %.1f dBFS.",
+                    stream_data->target_name,
+                    c,
+                    20 * log10f(report->peaks[c]),
+                    20 * log10f(report->rms[c]));
+    }
+    if (report->channels > 0) {
+        pw_log_info("Node %s, short-term loudness %.1f LUFS.",
+                    stream_data->target_name,
+                    report->loudness);
+    }
+    if (report->classifications > 0) {
+        pw_log_info("Node %s, class %u with score %.2f, the top of %u classifications.",
+                    stream_data->target_name,
+                    report->best.top_class,
+                    report->best.top_score,
+                    report->classifications);
+    }
+    if (report->dropped > 0) {
+        pw_log_warn("Node %s, analysis fell behind, %" PRIu64 " samples dropped.",
+                    stream_data->target_name,
+                    report->dropped);
+    }
+}
+
 /**
  * A timer callback function that will be called from the mainloop periodically.
  */
@@ -179,16 +216,10 @@ static void on_timeout(void* data, uint64_t expirations) {
     (void)expirations;
     struct impl* impl = data;
     struct stream_data* stream_data;
-    unsigned int c;
 
+    /* The workers log the levels, since the analysis state is theirs. */
     spa_list_for_each(stream_data, &impl->streams, link) {
-        for (c = 0; c < stream_data->info.info.raw.channels; c++) {
-            pw_log_info("Node %s, channel %u, peak %.1f dBFS.",
-                        stream_data->target_name,
-                        c,
-                        20 * log10f(stream_data->peaks[c]));
-            stream_data->peaks[c] = 0;
-        }
+        analysis_worker_request_report(&stream_data->worker);
     }
 }
 
@@ -230,6 +261,7 @@ static void registry_event_global(void* data,
         struct spa_pod_builder builder = SPA_POD_BUILDER_INIT(buf, sizeof(buf));
         const struct spa_pod* params[1];
         struct stream_data* stream_data;
+        struct audio_classifier* classifier;
         int res;
 
         media_class = spa_dict_lookup(props, PW_KEY_MEDIA_CLASS);
@@ -273,21 +305,38 @@ static void registry_event_global(void* data,
                                &stream_events,
                                stream_data);
 
+        /* Start the analysis before the samples arrive. */
+        classifier = NULL;
+        if (impl->classifier != NULL) {
+            classifier = audio_classifier_new_shared(impl->classifier);
+            if (classifier == NULL) {
+                pw_log_warn("Could not set up the classifier for %s.", name);
+            }
+        }
+        res = analysis_worker_start(&stream_data->worker, classifier, on_report, stream_data);
+        if (res < 0) {
+            pw_log_error("Could not start analysis for %s: %s", name, strerror(-res));
+            return;
+        }
+
         /* Leave rate and channels empty to accept the native device format. */
         params[0] =
             spa_format_audio_raw_build(&builder,
                                        SPA_PARAM_EnumFormat,
                                        &SPA_AUDIO_INFO_RAW_INIT(.format = SPA_AUDIO_FORMAT_F32P));
 
-        /* Connect to pipewire. */
+        /* Connect to pipewire, with the process callback in the real-time thread. */
         res = pw_stream_connect(stream_data->stream,
                                 PW_DIRECTION_INPUT,
                                 PW_ID_ANY,
-                                PW_STREAM_FLAG_AUTOCONNECT | PW_STREAM_FLAG_MAP_BUFFERS,
+                                PW_STREAM_FLAG_AUTOCONNECT | PW_STREAM_FLAG_MAP_BUFFERS |
+                                    PW_STREAM_FLAG_RT_PROCESS,
                                 params,
                                 SPA_N_ELEMENTS(params));
         if (res < 0) {
             pw_log_error("Could not connect stream for %s: %s", name, strerror(-res));
+            pw_stream_destroy(stream_data->stream);
+            analysis_worker_stop(&stream_data->worker);
             return;
         }
 
@@ -310,7 +359,10 @@ static void registry_event_global_remove(void* data, uint32_t id) {
             pw_log_info("Destroy stream from %s.", stream_data->target_name);
             spa_hook_remove(&stream_data->stream_listener);
             pw_stream_destroy(stream_data->stream);
+            /* The stream is gone, so nothing pushes to the worker any more. */
+            analysis_worker_stop(&stream_data->worker);
             spa_list_remove(&stream_data->link);
+            free(stream_data);
             break;
         }
     }
@@ -366,6 +418,14 @@ int main(int argc, char* argv[]) {
 
     spa_list_init(&impl.streams);
 
+    /* Load the model before the streams are created, which may take a while. */
+    if (argc >= 3) {
+        impl.classifier = audio_classifier_new(argv[2], argv[1]);
+        if (impl.classifier == NULL) {
+            pw_log_warn("Could not load the model %s, the audio is not classified.", argv[2]);
+        }
+    }
+
     pw_log_info("Starting.");
 
     /* Print peaks to the system log periodically every 5 seconds. */
@@ -392,8 +452,11 @@ int main(int argc, char* argv[]) {
         pw_log_debug("Destroy stream with target node %s.", stream_data->target_name);
         spa_hook_remove(&stream_data->stream_listener);
         pw_stream_destroy(stream_data->stream);
+        analysis_worker_stop(&stream_data->worker);
         spa_list_remove(&stream_data->link);
+        free(stream_data);
     }
+    audio_classifier_destroy(impl.classifier);
     pw_core_disconnect(impl.core);
     pw_context_destroy(impl.context);
 
@@ -0,0 +1,146 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "fft.h"
+
+#include <errno.h>
+#include <math.h>
+
+#if defined(__ARM_NEON) && !defined(FFT_SCALAR)
+#include <arm_neon.h>
+#define FFT_USE_NEON
+#endif
+
+#define PI_F 3.14159265358979f
+
+int fft_init(struct fft* fft, uint32_t size) {
+    uint32_t m    = size / 2;
+    uint32_t bits = 0;
+    uint32_t half;
+    uint32_t i;
+
+    if (size < FFT_MIN_SIZE || size > FFT_MAX_SIZE || (size & (size - 1)) != 0) {
+        return -EINVAL;
+    }
+    fft->size = size;
+
+    while ((1u << bits) < m) {
+        bits++;
+    }
+    for (i = 0; i < m; i++) {
+        uint32_t reversed = 0;
+        uint32_t b;
+
+        for (b = 0; b < bits; b++) {
+            reversed |= ((i >> b) & 1) << (bits - 1 - b);
+        }
+        fft->bitrev[i] = reversed;
+    }
+
+    for (half = 1; half < m; half *= 2) {
+        for (i = 0; i < half; i++) {
+            float angle = -PI_F * i / half;
+
+            fft->stage_re[half - 1 + i] = cosf(angle);
+            fft->stage_im[half - 1 + i] = sinf(angle);
+        }
+    }
+    for (i = 0; i <= m; i++) {
+        float angle = -2 * PI_F * i / size;
+
+        fft->split_re[i] = cosf(angle);
+        fft->split_im[i] = sinf(angle);
+    }
+    return 0;
+}
+
+/* The butterflies of the stage that combines transforms of half points. */
+static void stage(struct fft* fft, uint32_t half) {
+    const float* w_re = fft->stage_re + half - 1;
+    const float* w_im = fft->stage_im + half - 1;
+    uint32_t m        = fft->size / 2;
+    uint32_t start;
+
+    for (start = 0; start < m; start += 2 * half) {
+        float* a_re = fft->re + start;
+        float* a_im = fft->im + start;
+        float* b_re = a_re + half;
+        float* b_im = a_im + half;
+        uint32_t j  = 0;
+
+#ifdef FFT_USE_NEON
+        for (; j + 4 <= half; j += 4) {
+            float32x4_t x_re = vld1q_f32(b_re + j);
+            float32x4_t x_im = vld1q_f32(b_im + j);
+            float32x4_t wr   = vld1q_f32(w_re + j);
+            float32x4_t wi   = vld1q_f32(w_im + j);
+            float32x4_t t_re = vmlsq_f32(vmulq_f32(x_re, wr), x_im, wi);
+            float32x4_t t_im = vmlaq_f32(vmulq_f32(x_re, wi), x_im, wr);
+            float32x4_t y_re = vld1q_f32(a_re + j);
+            float32x4_t y_im = vld1q_f32(a_im + j);
+
+            vst1q_f32(a_re + j, vaddq_f32(y_re, t_re));
+            vst1q_f32(a_im + j, vaddq_f32(y_im, t_im));
+            vst1q_f32(b_re + j, vsubq_f32(y_re, t_re));
+            vst1q_f32(b_im + j, vsubq_f32(y_im, t_im));
+        }
+#endif
+        for (; j < half; j++) {
+            float t_re = b_re[j] * w_re[j] - b_im[j] * w_im[j];
+            float t_im = b_re[j] * w_im[j] + b_im[j] * w_re[j];
+            float y_re = a_re[j];
+            float y_im = a_im[j];
+
+            a_re[j] = y_re + t_re;
+            a_im[j] = y_im + t_im;
+            b_re[j] = y_re - t_re;
+            b_im[j] = y_im - t_im;
+        }
+    }
+}
+
+void fft_magnitudes(struct fft* fft, const float* input, float* magnitudes) {
+    uint32_t m = fft->size / 2;
+    uint32_t half;
+    uint32_t k;
+
+    for (k = 0; k < m; k++) {
+        fft->re[fft->bitrev[k]] = input[2 * k];
+        fft->im[fft->bitrev[k]] = input[2 * k + 1];
+    }
+    for (half = 1; half < m; half *= 2) {
+        stage(fft, half);
+    }
+
+    /*
+     * With Z the transform of the pairs, the bin k of the real signal is
+     * E + W^k O, where E = (Z[k] + conj(Z[m - k])) / 2 is the transform of the
+     * even samples and O = (Z[k] - conj(Z[m - k])) / 2i the one of the odd.
+     */
+    for (k = 0; k <= m; k++) {
+        uint32_t a = k % m;
+        uint32_t b = (m - k) % m;
+        float e_re = 0.5f * (fft->re[a] + fft->re[b]);
+        float e_im = 0.5f * (fft->im[a] - fft->im[b]);
+        float o_re = 0.5f * (fft->im[a] + fft->im[b]);
+        float o_im = 0.5f * (fft->re[b] - fft->re[a]);
+        float x_re = e_re + fft->split_re[k] * o_re - fft->split_im[k] * o_im;
+        float x_im = e_im + fft->split_re[k] * o_im + fft->split_im[k] * o_re;
+
+        magnitudes[k] = sqrtf(x_re * x_re + x_im * x_im);
+    }
+}
@@ -0,0 +1,65 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/**
+ * FFT of real audio frames.
+ *
+ * A frame of N real samples is transformed with a complex FFT of N / 2, of
+ * the even samples as the real parts and the odd samples as the imaginary
+ * parts, that is then split into the N / 2 + 1 bins of the real signal. The
+ * real and imaginary parts are kept in separate arrays, so the butterflies
+ * of all but the first two stages are done four at a time with NEON when the
+ * compiler targets NEON, and in plain C otherwise. Define FFT_SCALAR to force
+ * the plain C version.
+ *
+ * All the tables and the work arrays are part of the struct, so a transform
+ * does not allocate.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#define FFT_MIN_SIZE 8
+#define FFT_MAX_SIZE 4096
+
+struct fft {
+    /* The number of real samples, a power of two. */
+    uint32_t size;
+    /* Where each sample pair goes in the complex FFT. */
+    uint16_t bitrev[FFT_MAX_SIZE / 2];
+    /* The twiddles of each stage after another, half of them at offset half - 1. */
+    float stage_re[FFT_MAX_SIZE / 2];
+    float stage_im[FFT_MAX_SIZE / 2];
+    /* The twiddles that split the complex FFT into the bins of the real signal. */
+    float split_re[FFT_MAX_SIZE / 2 + 1];
+    float split_im[FFT_MAX_SIZE / 2 + 1];
+    float re[FFT_MAX_SIZE / 2];
+    float im[FFT_MAX_SIZE / 2];
+};
+
+/**
+ * Set up an FFT of size real samples. Returns 0, or -EINVAL if size is not a
+ * power of two from FFT_MIN_SIZE to FFT_MAX_SIZE.
+ */
+int fft_init(struct fft* fft, uint32_t size);
+
+/**
+ * Transform size samples and write the magnitudes of the size / 2 + 1 bins,
+ * from 0 Hz to half of the sample rate.
+ */
+void fft_magnitudes(struct fft* fft, const float* input, float* magnitudes);
@@ -0,0 +1,261 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "level_meter.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__ARM_NEON) && !defined(LEVEL_METER_SCALAR)
+#include <arm_neon.h>
+#define LEVEL_METER_USE_NEON
+#endif
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+
+/* Coefficients of a biquad filter, normalized so that a0 is 1. */
+static void set_coefs(float* coefs,
+                      double b0,
+                      double b1,
+                      double b2,
+                      double a0,
+                      double a1,
+                      double a2) {
+    coefs[0] = (float)(b0 / a0);
+    coefs[1] = (float)(b1 / a0);
+    coefs[2] = (float)(b2 / a0);
+    coefs[3] = (float)(a1 / a0);
+    coefs[4] = (float)(a2 / a0);
+}
+
+/* The K-weighting filter of ITU-R BS.1770 at any sample rate: a high shelf
+ * modelling the head, followed by a high-pass filter. */
+static void set_k_weighting(struct level_meter* meter, uint32_t rate) {
+    double k  = tan(M_PI * 1681.974450955533 / rate);
+    double q  = 0.7071752369554196;
+    double vh = pow(10.0, 3.999843853973347 / 20.0);
+    double vb = pow(vh, 0.4996667741545416);
+    set_coefs(meter->coefs[0],
+              vh + vb * k / q + k * k,
+              2.0 * (k * k - vh),
+              vh - vb * k / q + k * k,
+              1.0 + k / q + k * k,
+              2.0 * (k * k - 1.0),
+              1.0 - k / q + k * k);
+
+    /* The gain of the high-pass filter is not normalized, b is 1, -2, 1. */
+    k         = tan(M_PI * 38.13547087602444 / rate);
+    q         = 0.5003270373238773;
+    double a0 = 1.0 + k / q + k * k;
+    set_coefs(meter->coefs[1], a0, -2.0 * a0, a0, a0, 2.0 * (k * k - 1.0), 1.0 - k / q + k * k);
+}
+
+void level_meter_init(struct level_meter* meter, uint32_t channels, uint32_t rate) {
+    memset(meter, 0, sizeof(*meter));
+    meter->channels   = MIN(channels, LEVEL_METER_MAX_CHANNELS);
+    meter->block_size = rate * LEVEL_METER_BLOCK_MS / 1000;
+    set_k_weighting(meter, rate);
+}
+
+#ifdef LEVEL_METER_USE_NEON
+/* One sample of a biquad filter, in transposed direct form II. */
+static inline float32x4_t biquad(float32x4_t x, const float* c, float32x4_t* z1, float32x4_t* z2) {
+    float32x4_t y = vmlaq_n_f32(*z1, x, c[0]);
+    *z1           = vmlsq_n_f32(vmlaq_n_f32(*z2, x, c[1]), y, c[3]);
+    *z2           = vmlsq_n_f32(vmulq_n_f32(x, c[2]), y, c[4]);
+    return y;
+}
+
+/* Transpose four samples of four channels to one vector per sample. */
+static inline void transpose(float32x4_t* rows) {
+    float32x4x2_t t01 = vtrnq_f32(rows[0], rows[1]);
+    float32x4x2_t t23 = vtrnq_f32(rows[2], rows[3]);
+    rows[0]           = vcombine_f32(vget_low_f32(t01.val[0]), vget_low_f32(t23.val[0]));
+    rows[1]           = vcombine_f32(vget_low_f32(t01.val[1]), vget_low_f32(t23.val[1]));
+    rows[2]           = vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0]));
+    rows[3]           = vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1]));
+}
+
+static void process_group(const struct level_meter* meter,
+                          struct level_meter_group* group,
+                          const float* const* lanes,
+                          uint32_t n_samples) {
+    float32x4_t z1a    = vld1q_f32(group->z[0]);
+    float32x4_t z2a    = vld1q_f32(group->z[1]);
+    float32x4_t z1b    = vld1q_f32(group->z[2]);
+    float32x4_t z2b    = vld1q_f32(group->z[3]);
+    float32x4_t peak   = vld1q_f32(group->peak);
+    float32x4_t sum    = vld1q_f32(group->sum_squares);
+    float32x4_t sum_k  = vld1q_f32(group->sum_weighted);
+    const float* shelf = meter->coefs[0];
+    const float* hp    = meter->coefs[1];
+    uint32_t i         = 0;
+
+    for (; i < n_samples; i += LEVEL_METER_LANES) {
+        float32x4_t x[LEVEL_METER_LANES];
+        uint32_t count = MIN(LEVEL_METER_LANES, n_samples - i);
+        if (count == LEVEL_METER_LANES) {
+            for (int l = 0; l < LEVEL_METER_LANES; l++) {
+                x[l] = vld1q_f32(lanes[l] + i);
+            }
+            transpose(x);
+        } else {
+            for (uint32_t s = 0; s < count; s++) {
+                float column[LEVEL_METER_LANES];
+                for (int l = 0; l < LEVEL_METER_LANES; l++) {
+                    column[l] = lanes[l][i + s];
+                }
+                x[s] = vld1q_f32(column);
+            }
+        }
+
+        for (uint32_t s = 0; s < count; s++) {
+            float32x4_t y = biquad(biquad(x[s], shelf, &z1a, &z2a), hp, &z1b, &z2b);
+            peak          = vmaxq_f32(peak, vabsq_f32(x[s]));
+            sum           = vmlaq_f32(sum, x[s], x[s]);
+            sum_k         = vmlaq_f32(sum_k, y, y);
+        }
+    }
+
+    vst1q_f32(group->z[0], z1a);
+    vst1q_f32(group->z[1], z2a);
+    vst1q_f32(group->z[2], z1b);
+    vst1q_f32(group->z[3], z2b);
+    vst1q_f32(group->peak, peak);
+    vst1q_f32(group->sum_squares, sum);
+    vst1q_f32(group->sum_weighted, sum_k);
+}
+#else
+static inline float biquad(float x, const float* c, float* z1, float* z2) {
+    float y = c[0] * x + *z1;
+    *z1     = c[1] * x - c[3] * y + *z2;
+    *z2     = c[2] * x - c[4] * y;
+    return y;
+}
+
+static void process_group(const struct level_meter* meter,
+                          struct level_meter_group* group,
+                          const float* const* lanes,
+                          uint32_t n_samples) {
+    for (int l = 0; l < LEVEL_METER_LANES; l++) {
+        const float* samples = lanes[l];
+        float z1a            = group->z[0][l];
+        float z2a            = group->z[1][l];
+        float z1b            = group->z[2][l];
+        float z2b            = group->z[3][l];
+        float peak           = group->peak[l];
+        float sum            = group->sum_squares[l];
+        float sum_k          = group->sum_weighted[l];
+
+        for (uint32_t i = 0; i < n_samples; i++) {
+            float x = samples[i];
+            float y = biquad(biquad(x, meter->coefs[0], &z1a, &z2a), meter->coefs[1], &z1b, &z2b);
+            peak    = fmaxf(peak, fabsf(x));
+            sum += x * x;
+            sum_k += y * y;
+        }
+
+        group->z[0][l]         = z1a;
+        group->z[1][l]         = z2a;
+        group->z[2][l]         = z1b;
+        group->z[3][l]         = z2b;
+        group->peak[l]         = peak;
+        group->sum_squares[l]  = sum;
+        group->sum_weighted[l] = sum_k;
+    }
+}
+#endif
+
+/* Move the sums of a complete block to the period and the short-term window. */
+static void end_block(struct level_meter* meter) {
+    double power = 0.0;
+
+    for (uint32_t c = 0; c < meter->channels; c++) {
+        struct level_meter_group* group = &meter->groups[c / LEVEL_METER_LANES];
+        uint32_t l                      = c % LEVEL_METER_LANES;
+
+        meter->peak[c] = fmaxf(meter->peak[c], group->peak[l]);
+        meter->sum_squares[c] += group->sum_squares[l];
+        power += group->sum_weighted[l] / meter->block_size;
+    }
+    for (uint32_t g = 0; g * LEVEL_METER_LANES < meter->channels; g++) {
+        struct level_meter_group* group = &meter->groups[g];
+        memset(group->peak, 0, sizeof(group->peak));
+        memset(group->sum_squares, 0, sizeof(group->sum_squares));
+        memset(group->sum_weighted, 0, sizeof(group->sum_weighted));
+    }
+
+    meter->num_samples += meter->block_size;
+    meter->block_power[meter->next_block] = power;
+    meter->next_block = (meter->next_block + 1) % LEVEL_METER_SHORT_TERM_BLOCKS;
+    meter->num_blocks = MIN(meter->num_blocks + 1, LEVEL_METER_SHORT_TERM_BLOCKS);
+    meter->block_fill = 0;
+}
+
+void level_meter_process(struct level_meter* meter,
+                         const float* const* planes,
+                         uint32_t n_samples) {
+    uint32_t done = 0;
+
+    if (meter->channels == 0 || meter->block_size == 0) {
+        return;
+    }
+
+    while (done < n_samples) {
+        /* A block is always accumulated in floats, then moved to doubles. */
+        uint32_t count = MIN(n_samples - done, meter->block_size - meter->block_fill);
+
+        for (uint32_t g = 0; g * LEVEL_METER_LANES < meter->channels; g++) {
+            const float* lanes[LEVEL_METER_LANES];
+
+            /* The lanes after the last channel repeat it, and are not read. */
+            for (int l = 0; l < LEVEL_METER_LANES; l++) {
+                uint32_t c = MIN(g * LEVEL_METER_LANES + l, meter->channels - 1);
+                lanes[l]   = planes[c] + done;
+            }
+            process_group(meter, &meter->groups[g], lanes, count);
+        }
+
+        done += count;
+        meter->block_fill += count;
+        if (meter->block_fill == meter->block_size) {
+            end_block(meter);
+        }
+    }
+}
+
+void level_meter_read(struct level_meter* meter, float* peaks, float* rms) {
+    for (uint32_t c = 0; c < meter->channels; c++) {
+        peaks[c] = meter->peak[c];
+        rms[c] = meter->num_samples > 0 ? (float)sqrt(meter->sum_squares[c] / meter->num_samples)
+                                        : 0.0f;
+        meter->peak[c]        = 0.0f;
+        meter->sum_squares[c] = 0.0;
+    }
+    meter->num_samples = 0;
+}
+
+float level_meter_loudness(const struct level_meter* meter) {
+    double power = 0.0;
+
+    if (meter->num_blocks == 0) {
+        return -INFINITY;
+    }
+    for (uint32_t b = 0; b < meter->num_blocks; b++) {
+        power += meter->block_power[b];
+    }
+    return (float)(-0.691 + 10.0 * log10(power / meter->num_blocks));
+}
@@ -0,0 +1,90 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Level meter for planar float audio with many channels.
+ *
+ * The samples are processed in one pass that gives the peak and the RMS of
+ * each channel and the short-term loudness of all channels. The channels are
+ * processed four at a time, one per lane of a NEON vector, when the compiler
+ * targets NEON, and in plain C otherwise. Define LEVEL_METER_SCALAR to force
+ * the plain C version.
+ *
+ * The samples are accumulated in blocks of LEVEL_METER_BLOCK_MS. The loudness
+ * follows ITU-R BS.1770: the signal is K-weighted, and the short-term
+ * loudness is the mean square of the last LEVEL_METER_SHORT_TERM_BLOCKS
+ * blocks, 3 seconds, summed over the channels with the same weight for all.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#define LEVEL_METER_MAX_CHANNELS      64
+#define LEVEL_METER_LANES             4
+#define LEVEL_METER_BLOCK_MS          100
+#define LEVEL_METER_SHORT_TERM_BLOCKS 30
+
+/* The state of four channels, one per lane. */
+struct level_meter_group {
+    /* The state of the two stages of the K-weighting filter. */
+    float z[4][LEVEL_METER_LANES];
+    /* Of the current block. */
+    float peak[LEVEL_METER_LANES];
+    float sum_squares[LEVEL_METER_LANES];
+    float sum_weighted[LEVEL_METER_LANES];
+};
+
+struct level_meter {
+    uint32_t channels;
+    uint32_t block_size;
+    uint32_t block_fill;
+    /* b0, b1, b2, a1 and a2 of the two stages of the K-weighting filter. */
+    float coefs[2][5];
+    struct level_meter_group groups[LEVEL_METER_MAX_CHANNELS / LEVEL_METER_LANES];
+
+    /* Of the blocks since the last read. */
+    float peak[LEVEL_METER_MAX_CHANNELS];
+    double sum_squares[LEVEL_METER_MAX_CHANNELS];
+    uint64_t num_samples;
+
+    /* The weighted mean square of the last blocks, summed over the channels. */
+    double block_power[LEVEL_METER_SHORT_TERM_BLOCKS];
+    uint32_t next_block;
+    uint32_t num_blocks;
+};
+
+/**
+ * Reset the meter for a stream with a number of channels, at most
+ * LEVEL_METER_MAX_CHANNELS, and a sample rate.
+ */
+void level_meter_init(struct level_meter* meter, uint32_t channels, uint32_t rate);
+
+/**
+ * Process n_samples samples of each channel, from one plane per channel.
+ */
+void level_meter_process(struct level_meter* meter, const float* const* planes, uint32_t n_samples);
+
+/**
+ * Get the peak and the RMS of each channel over the blocks since the last
+ * read, as linear values, and start a new period.
+ */
+void level_meter_read(struct level_meter* meter, float* peaks, float* rms);
+
+/**
+ * Get the short-term loudness in LUFS, or -INFINITY before the first block.
+ */
+float level_meter_loudness(const struct level_meter* meter);
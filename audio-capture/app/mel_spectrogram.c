@@ -0,0 +1,181 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "mel_spectrogram.h"
+
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+
+#if defined(__ARM_NEON) && !defined(FFT_SCALAR)
+#include <arm_neon.h>
+#define MEL_SPECTROGRAM_USE_NEON
+#endif
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+
+static float hz_to_mel(float hz) {
+    return 1127.0f * logf(1.0f + hz / 700.0f);
+}
+
+/* The triangles of the bands, on evenly spaced edges on the mel scale. */
+static void init_bands(struct mel_spectrogram* mel, uint32_t rate) {
+    uint32_t bins      = mel->fft.size / 2 + 1;
+    float min_mel      = hz_to_mel(MEL_SPECTROGRAM_MIN_HZ);
+    float max_mel      = hz_to_mel(MIN(MEL_SPECTROGRAM_MAX_HZ, rate / 2.0f));
+    float spacing      = (max_mel - min_mel) / (mel->bands + 1);
+    uint32_t n_weights = 0;
+    uint32_t b;
+    uint32_t k;
+
+    for (b = 0; b < mel->bands; b++) {
+        struct mel_band* band = &mel->band[b];
+        float lower           = min_mel + b * spacing;
+        float center          = lower + spacing;
+        float upper           = center + spacing;
+
+        band->first_bin    = 0;
+        band->num_bins     = 0;
+        band->first_weight = n_weights;
+        for (k = 1; k < bins; k++) {
+            float m = hz_to_mel((float)k * rate / mel->fft.size);
+            float weight;
+
+            if (m <= lower || m >= upper) {
+                continue;
+            }
+            weight = m < center ? (m - lower) / spacing : (upper - m) / spacing;
+            if (band->num_bins == 0) {
+                band->first_bin = k;
+            }
+            mel->weights[n_weights++] = weight;
+            band->num_bins++;
+        }
+    }
+}
+
+int mel_spectrogram_init(struct mel_spectrogram* mel, uint32_t rate, uint32_t bands) {
+    uint32_t window_size = rate * MEL_SPECTROGRAM_WINDOW_MS / 1000;
+    uint32_t hop_size    = rate * MEL_SPECTROGRAM_HOP_MS / 1000;
+    uint32_t fft_size    = FFT_MIN_SIZE;
+    float scale          = 16000.0f / rate;
+    uint32_t i;
+
+    if (bands == 0 || bands > MEL_SPECTROGRAM_MAX_BANDS || hop_size == 0 ||
+        window_size > FFT_MAX_SIZE) {
+        return -EINVAL;
+    }
+    while (fft_size < window_size) {
+        fft_size *= 2;
+    }
+
+    memset(mel, 0, sizeof(*mel));
+    mel->window_size = window_size;
+    mel->hop_size    = hop_size;
+    mel->bands       = bands;
+    fft_init(&mel->fft, fft_size);
+
+    /* A periodic Hann window, with the scale of the magnitudes in it. */
+    for (i = 0; i < window_size; i++) {
+        mel->window[i] = scale * 0.5f * (1.0f - cosf(2.0f * 3.14159265358979f * i / window_size));
+    }
+    init_bands(mel, rate);
+    return 0;
+}
+
+uint32_t mel_spectrogram_feed(struct mel_spectrogram* mel,
+                              const float* const* planes,
+                              uint32_t channels,
+                              uint32_t offset,
+                              uint32_t n_samples) {
+    uint32_t count = MIN(n_samples, mel->window_size - mel->fill);
+    float* out     = mel->samples + mel->fill;
+    float gain     = 1.0f / channels;
+    uint32_t c;
+    uint32_t i;
+
+    memcpy(out, planes[0] + offset, count * sizeof(float));
+    for (c = 1; c < channels; c++) {
+        const float* in = planes[c] + offset;
+
+        for (i = 0; i < count; i++) {
+            out[i] += in[i];
+        }
+    }
+    if (channels > 1) {
+        for (i = 0; i < count; i++) {
+            out[i] *= gain;
+        }
+    }
+    mel->fill += count;
+    return count;
+}
+
+bool mel_spectrogram_frame_ready(const struct mel_spectrogram* mel) {
+    return mel->fill == mel->window_size;
+}
+
+static float band_sum(const struct mel_spectrogram* mel, const struct mel_band* band) {
+    const float* magnitudes = mel->magnitudes + band->first_bin;
+    const float* weights    = mel->weights + band->first_weight;
+    uint32_t n              = band->num_bins;
+    float sum               = 0.0f;
+    uint32_t i              = 0;
+
+#ifdef MEL_SPECTROGRAM_USE_NEON
+    float32x4_t acc = vdupq_n_f32(0.0f);
+    float32x2_t pair;
+
+    for (; i + 4 <= n; i += 4) {
+        acc = vmlaq_f32(acc, vld1q_f32(magnitudes + i), vld1q_f32(weights + i));
+    }
+    pair = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+    pair = vpadd_f32(pair, pair);
+    sum  = vget_lane_f32(pair, 0);
+#endif
+    for (; i < n; i++) {
+        sum += magnitudes[i] * weights[i];
+    }
+    return sum;
+}
+
+void mel_spectrogram_compute(struct mel_spectrogram* mel, float* out) {
+    uint32_t i = 0;
+    uint32_t b;
+
+#ifdef MEL_SPECTROGRAM_USE_NEON
+    for (; i + 4 <= mel->window_size; i += 4) {
+        vst1q_f32(mel->windowed + i,
+                  vmulq_f32(vld1q_f32(mel->samples + i), vld1q_f32(mel->window + i)));
+    }
+#endif
+    for (; i < mel->window_size; i++) {
+        mel->windowed[i] = mel->samples[i] * mel->window[i];
+    }
+    /* The padding is only written by the memset of the init. */
+    fft_magnitudes(&mel->fft, mel->windowed, mel->magnitudes);
+
+    for (b = 0; b < mel->bands; b++) {
+        out[b] = logf(band_sum(mel, &mel->band[b]) + MEL_SPECTROGRAM_LOG_OFFSET);
+    }
+
+    /* Keep the samples that overlap the next frame. */
+    memmove(mel->samples,
+            mel->samples + mel->hop_size,
+            (mel->window_size - mel->hop_size) * sizeof(float));
+    mel->fill = mel->window_size - mel->hop_size;
+}
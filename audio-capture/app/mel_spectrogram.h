@@ -0,0 +1,101 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/**
+ * Streaming log-mel spectrogram of the audio of a stream.
+ *
+ * The channels are mixed to mono and collected in frames of
+ * MEL_SPECTROGRAM_WINDOW_MS, that start every MEL_SPECTROGRAM_HOP_MS. The
+ * samples of a frame that overlap the next are kept, so the blocks from the
+ * ring can be of any size. Each frame gets a Hann window, is zero padded to
+ * a power of two and transformed with the FFT, and the magnitudes are summed
+ * in mel bands from MEL_SPECTROGRAM_MIN_HZ to MEL_SPECTROGRAM_MAX_HZ, with
+ * overlapping triangles on the HTK mel scale. The result is the logarithm of
+ * each band, plus MEL_SPECTROGRAM_LOG_OFFSET. The window and the bands use
+ * NEON like the FFT, see fft.h.
+ *
+ * The magnitudes are scaled with 16000 / rate, so the frames are the same as
+ * those of the same sound sampled at 16 kHz, that audio classifiers such as
+ * YAMNet are trained on.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "fft.h"
+
+#define MEL_SPECTROGRAM_WINDOW_MS  25
+#define MEL_SPECTROGRAM_HOP_MS     10
+#define MEL_SPECTROGRAM_MIN_HZ     125.0f
+#define MEL_SPECTROGRAM_MAX_HZ     7500.0f
+#define MEL_SPECTROGRAM_LOG_OFFSET 0.001f
+#define MEL_SPECTROGRAM_MAX_BANDS  128
+
+/* The bins of the magnitudes in a band, and where their weights start. */
+struct mel_band {
+    uint32_t first_bin;
+    uint32_t num_bins;
+    uint32_t first_weight;
+};
+
+struct mel_spectrogram {
+    uint32_t window_size;
+    uint32_t hop_size;
+    uint32_t bands;
+    /* The samples of the current frame. */
+    uint32_t fill;
+    float samples[FFT_MAX_SIZE];
+
+    float window[FFT_MAX_SIZE];
+    float windowed[FFT_MAX_SIZE];
+    float magnitudes[FFT_MAX_SIZE / 2 + 1];
+    struct fft fft;
+    struct mel_band band[MEL_SPECTROGRAM_MAX_BANDS];
+    /* A bin is in at most two bands. */
+    float weights[FFT_MAX_SIZE + 2];
+};
+
+/**
+ * Set up a spectrogram of bands mel bands of audio at rate. Returns 0, or
+ * -EINVAL if there are no bands or more than MEL_SPECTROGRAM_MAX_BANDS, or
+ * the rate is too low for a hop or so high that a frame does not fit in
+ * FFT_MAX_SIZE.
+ */
+int mel_spectrogram_init(struct mel_spectrogram* mel, uint32_t rate, uint32_t bands);
+
+/**
+ * Take samples from one plane per channel, starting at offset, until the
+ * current frame is complete. Returns the number of samples taken.
+ */
+uint32_t mel_spectrogram_feed(struct mel_spectrogram* mel,
+                              const float* const* planes,
+                              uint32_t channels,
+                              uint32_t offset,
+                              uint32_t n_samples);
+
+/**
+ * Whether the current frame is complete, so mel_spectrogram_compute() must be
+ * called before more samples are fed.
+ */
+bool mel_spectrogram_frame_ready(const struct mel_spectrogram* mel);
+
+/**
+ * Write the bands of the complete frame to out, and start the next frame.
+ */
+void mel_spectrogram_compute(struct mel_spectrogram* mel, float* out);
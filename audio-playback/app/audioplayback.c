@@ -21,7 +21,11 @@
  * process audio data.
  *
  * The application starts an audio stream for each output node that plays a sine
- * tone. The log messages can be followed with the command:
+ * tone, or a WAV file given as argument over and over. With -t the sound is
+ * instead played once each time the application gets SIGUSR1, and the latency
+ * from the signal to the device is logged. With -q the stream asks for a
+ * quantum of that many samples and only fills what the graph requests, to get
+ * a low latency. The log messages can be followed with the command:
  *
  * journalctl -t audioplayback -f
  *
@@ -31,15 +35,16 @@
  * Suppose that you have gone through the steps of installation. Then you can
  * also run it on your device like this:
  *
- *     /usr/local/packages/audioplayback/audioplayback
+ *     /usr/local/packages/audioplayback/audioplayback [-q <quantum>] [-t] [<WAV file>]
  *
  * and then the output will go to stderr instead of the system log.
  */
 
-#include <math.h>
 #include <regex.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wtype-limits"
@@ -47,9 +52,19 @@
 #include <spa/param/audio/format-utils.h>
 #pragma GCC diagnostic pop
 
+#include "clip_cache.h"
+#include "oscillator.h"
+
 #define FREQUENCY 440
 #define VOLUME    0.5f
 
+/* The rate of the quantum asked for, which pipewire scales to the rate of the graph. */
+#define QUANTUM_RATE 48000
+#define MIN_QUANTUM  16
+#define MAX_QUANTUM  8192
+/* How long the tone plays for a trigger. */
+#define TRIGGERED_TONE_MS 1000
+
 PW_LOG_TOPIC_STATIC(topic, "audioplayback");
 #define PW_LOG_TOPIC_DEFAULT topic
 
@@ -62,6 +77,13 @@ struct impl {
     struct spa_hook registry_listener;
     regex_t node_name_regex;
     struct spa_list streams;
+    /* The WAV file to play instead of the tone, or NULL. */
+    const char* clip_path;
+    struct clip_cache clips;
+    /* The quantum to ask for, or 0 to fill whole buffers. */
+    uint32_t quantum;
+    /* Whether the sound is only played when triggered. */
+    bool triggered;
 };
 
 struct stream_data {
@@ -70,8 +92,15 @@ struct stream_data {
     struct spa_hook stream_listener;
     uint32_t target_id;
     char target_name[64];
+    struct impl* impl;
     struct spa_audio_info info;
-    float angle;
+    /* What the process callback plays, set up when the rate is known. */
+    struct oscillator oscillator;
+    const struct clip* clip;
+    uint32_t clip_position;
+    /* The time of a trigger not yet played, or 0, and what is left to play of it. */
+    uint64_t trigger_ns;
+    uint32_t remaining;
 };
 
 /**
@@ -99,10 +128,31 @@ static void on_param_changed(void* data, uint32_t id, const struct spa_pod* para
     }
 
     spa_format_audio_raw_parse(param, &stream_data->info.info.raw);
+    if (stream_data->info.info.raw.rate == 0) {
+        pw_log_warn("Format from %s has no rate.", stream_data->target_name);
+        return;
+    }
 
     pw_log_info("Playing to node %s, rate %d.",
                 stream_data->target_name,
                 stream_data->info.info.raw.rate);
+
+    oscillator_init(&stream_data->oscillator, FREQUENCY, VOLUME, stream_data->info.info.raw.rate);
+
+    /* Decode the clip at the rate now, so the process callback only copies it. */
+    stream_data->clip          = NULL;
+    stream_data->clip_position = 0;
+    if (stream_data->impl->clip_path != NULL) {
+        res = clip_cache_get(&stream_data->impl->clips,
+                             stream_data->impl->clip_path,
+                             stream_data->info.info.raw.rate,
+                             &stream_data->clip);
+        if (res < 0) {
+            pw_log_warn("Could not load %s, playing a tone: %s",
+                        stream_data->impl->clip_path,
+                        strerror(-res));
+        }
+    }
 }
 
 /**
@@ -125,6 +175,75 @@ static void on_state_changed(void* data,
     }
 }
 
+static uint64_t get_time_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * SPA_NSEC_PER_SEC + ts.tv_nsec;
+}
+
+/**
+ * Fill the samples with what the stream plays, the clip or a sine wave. Both
+ * remember where they are.
+ */
+static void play(struct stream_data* stream_data, float* samples, uint32_t n_samples) {
+    if (stream_data->clip != NULL) {
+        clip_play(stream_data->clip, &stream_data->clip_position, samples, n_samples);
+    } else {
+        oscillator_process(&stream_data->oscillator, samples, n_samples);
+    }
+}
+
+/**
+ * Fill the samples with the rest of the sound of the last trigger, and silence
+ * after it.
+ */
+static void play_triggered(struct stream_data* stream_data, float* samples, uint32_t n_samples) {
+    uint32_t count;
+
+    /* A trigger starts the sound over. */
+    if (stream_data->trigger_ns != 0) {
+        stream_data->clip_position = 0;
+        stream_data->remaining     = stream_data->info.info.raw.rate * TRIGGERED_TONE_MS / 1000;
+        if (stream_data->clip != NULL) {
+            stream_data->remaining = stream_data->clip->n_samples;
+        }
+    }
+    count = SPA_MIN(n_samples, stream_data->remaining);
+    play(stream_data, samples, count);
+    memset(samples + count, 0, (n_samples - count) * sizeof(float));
+    stream_data->remaining -= count;
+}
+
+/**
+ * Log how long after the trigger the first sample of the buffer about to be
+ * queued is played by the device: the time until this callback, plus the time
+ * of what is queued before it in the stream and in the graph.
+ */
+static void log_trigger_latency(struct stream_data* stream_data) {
+    struct pw_time time;
+    uint64_t callback_ns = get_time_ns() - stream_data->trigger_ns;
+    uint32_t rate        = stream_data->info.info.raw.rate;
+    uint64_t queued;
+    double queued_ms;
+
+    if (pw_stream_get_time_n(stream_data->stream, &time, sizeof(time)) < 0 ||
+        time.rate.denom == 0) {
+        pw_log_info("Trigger to %s after %.1f ms to the callback.",
+                    stream_data->target_name,
+                    callback_ns / 1e6);
+        return;
+    }
+    /* The delay of the graph is in its rate, what the stream has queued in samples. */
+    queued    = time.queued / sizeof(float) + time.buffered;
+    queued_ms = time.delay * 1e3 * time.rate.num / time.rate.denom + queued * 1e3 / rate;
+    pw_log_info("Trigger to %s after %.1f ms, %.1f ms to the callback and %.1f ms queued.",
+                stream_data->target_name,
+                callback_ns / 1e6 + queued_ms,
+                callback_ns / 1e6,
+                queued_ms);
+}
+
 /**
  * A process callback function that will be called from the mainloop when there
  * is a new buffer to fill with audio data.
@@ -135,7 +254,6 @@ static void on_process(void* data) {
     struct spa_buffer* buf;
     float* samples;
     uint32_t n_samples;
-    unsigned int i;
 
     b = pw_stream_dequeue_buffer(stream_data->stream);
     if (b == NULL) {
@@ -151,14 +269,20 @@ static void on_process(void* data) {
     }
     n_samples = buf->datas[0].maxsize / sizeof(float);
 
-    /* Fill the buffer with a sine wave. Remember the angle until next call. */
-    for (i = 0; i < n_samples; i++) {
-        samples[i] = sinf(stream_data->angle) * VOLUME;
+    /* With a quantum, queue only what the graph needs for the next cycle, since
+     * all that is queued is played before a new sound. */
+    if (stream_data->impl->quantum > 0 && b->requested > 0) {
+        n_samples = SPA_MIN(n_samples, b->requested);
+    }
 
-        stream_data->angle += (float)(2 * M_PI * FREQUENCY) / stream_data->info.info.raw.rate;
-        if (stream_data->angle >= 2 * M_PI) {
-            stream_data->angle -= 2 * M_PI;
-        }
+    if (stream_data->impl->triggered) {
+        play_triggered(stream_data, samples, n_samples);
+    } else {
+        play(stream_data, samples, n_samples);
+    }
+    if (stream_data->trigger_ns != 0) {
+        log_trigger_latency(stream_data);
+        stream_data->trigger_ns = 0;
     }
 
     /* Set buffer metadata. */
@@ -170,6 +294,21 @@ out:
     pw_stream_queue_buffer(stream_data->stream, b);
 }
 
+/**
+ * A signal callback function that will be called from the mainloop when the
+ * sound is triggered.
+ */
+static void on_trigger(void* data, int signal_num) {
+    (void)signal_num;
+    struct impl* impl = data;
+    struct stream_data* stream_data;
+    uint64_t now_ns = get_time_ns();
+
+    spa_list_for_each(stream_data, &impl->streams, link) {
+        stream_data->trigger_ns = now_ns;
+    }
+}
+
 /**
  * A signal callback function that will be called from the mainloop.
  */
@@ -228,10 +367,18 @@ static void registry_event_global(void* data,
             pw_log_warn("Could not create properties for %s.", name);
             return;
         }
+        if (impl->quantum > 0) {
+            pw_properties_setf(stream_props,
+                               PW_KEY_NODE_LATENCY,
+                               "%u/%u",
+                               impl->quantum,
+                               QUANTUM_RATE);
+        }
 
         /* Create a stream. */
         stream_data            = calloc(1, sizeof(struct stream_data));
         stream_data->target_id = id;
+        stream_data->impl      = impl;
         strncpy(stream_data->target_name, name, sizeof(stream_data->target_name) - 1);
         stream_data->stream = pw_stream_new(impl->core, "Audio playback", stream_props);
         if (stream_data->stream == NULL) {
@@ -300,6 +447,25 @@ int main(int argc, char* argv[]) {
     int res;
     struct pw_loop* loop;
     struct stream_data* stream_data;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "q:t")) != -1) {
+        switch (opt) {
+            case 'q':
+                impl.quantum = strtoul(optarg, NULL, 10);
+                if (impl.quantum < MIN_QUANTUM || impl.quantum > MAX_QUANTUM) {
+                    pw_log_error("The quantum must be %d to %d.", MIN_QUANTUM, MAX_QUANTUM);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 't':
+                impl.triggered = true;
+                break;
+            default:
+                pw_log_error("Usage: %s [-q <quantum>] [-t] [<WAV file>]", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
 
     /* Compile a regex for node names to match. */
     res =
@@ -326,6 +492,9 @@ int main(int argc, char* argv[]) {
 
     pw_loop_add_signal(loop, SIGINT, on_signal, &impl);
     pw_loop_add_signal(loop, SIGTERM, on_signal, &impl);
+    if (impl.triggered) {
+        pw_loop_add_signal(loop, SIGUSR1, on_trigger, &impl);
+    }
 
     impl.context = pw_context_new(loop, NULL, 0);
     if (impl.context == NULL) {
@@ -343,8 +512,18 @@ int main(int argc, char* argv[]) {
     pw_registry_add_listener(impl.registry, &impl.registry_listener, &registry_events, &impl);
 
     spa_list_init(&impl.streams);
+    clip_cache_init(&impl.clips);
+    if (optind < argc) {
+        impl.clip_path = argv[optind];
+    }
 
     pw_log_info("Starting.");
+    if (impl.quantum > 0) {
+        pw_log_info("Asking for a quantum of %u/%u.", impl.quantum, QUANTUM_RATE);
+    }
+    if (impl.triggered) {
+        pw_log_info("Playing the sound on SIGUSR1.");
+    }
 
     /* Start processing. */
     pw_main_loop_run(impl.loop);
@@ -362,6 +541,7 @@ int main(int argc, char* argv[]) {
     pw_main_loop_destroy(impl.loop);
     pw_deinit();
     regfree(&impl.node_name_regex);
+    clip_cache_clear(&impl.clips);
 
     pw_log_info("Terminating.");
 
@@ -0,0 +1,258 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "clip_cache.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+
+#define WAVE_FORMAT_PCM        1
+#define WAVE_FORMAT_IEEE_FLOAT 3
+#define WAVE_FORMAT_EXTENSIBLE 0xfffe
+
+/* The format and the samples of a WAV file. */
+struct wav {
+    uint16_t format;
+    uint16_t channels;
+    uint32_t rate;
+    uint16_t bits;
+    const uint8_t* data;
+    uint32_t n_frames;
+};
+
+static uint16_t read_u16(const uint8_t* p) {
+    return p[0] | p[1] << 8;
+}
+
+static uint32_t read_u32(const uint8_t* p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+/* Only 16 bit PCM and 32 bit float samples are decoded. */
+static int is_supported(const struct wav* wav) {
+    return (wav->format == WAVE_FORMAT_PCM && wav->bits == 16) ||
+           (wav->format == WAVE_FORMAT_IEEE_FLOAT && wav->bits == 32);
+}
+
+static int parse_wav(const uint8_t* file, size_t size, struct wav* wav) {
+    size_t pos = 12;
+
+    memset(wav, 0, sizeof(*wav));
+    if (size < 12 || memcmp(file, "RIFF", 4) != 0 || memcmp(file + 8, "WAVE", 4) != 0) {
+        return -EINVAL;
+    }
+    while (pos + 8 <= size) {
+        const uint8_t* chunk = file + pos;
+        uint32_t chunk_size  = read_u32(chunk + 4);
+
+        if (chunk_size > size - pos - 8) {
+            chunk_size = size - pos - 8;
+        }
+        if (memcmp(chunk, "fmt ", 4) == 0 && chunk_size >= 16) {
+            wav->format   = read_u16(chunk + 8);
+            wav->channels = read_u16(chunk + 10);
+            wav->rate     = read_u32(chunk + 12);
+            wav->bits     = read_u16(chunk + 22);
+            /* The format is the start of the sub format GUID. */
+            if (wav->format == WAVE_FORMAT_EXTENSIBLE && chunk_size >= 26) {
+                wav->format = read_u16(chunk + 32);
+            }
+        } else if (memcmp(chunk, "data", 4) == 0 && wav->channels > 0) {
+            /* The format is checked before it is used to size the frames. */
+            if (!is_supported(wav)) {
+                return -EINVAL;
+            }
+            wav->data     = chunk + 8;
+            wav->n_frames = chunk_size / (wav->channels * (wav->bits / 8));
+            break;
+        }
+        /* Chunks are padded to an even size. */
+        pos += 8 + chunk_size + (chunk_size & 1);
+    }
+
+    if (wav->data == NULL || wav->rate == 0 || wav->n_frames == 0 || !is_supported(wav)) {
+        return -EINVAL;
+    }
+    return 0;
+}
+
+/* The mean of the channels of a frame of the file. */
+static float read_frame(const struct wav* wav, uint32_t frame) {
+    float sum = 0.0f;
+    uint32_t c;
+
+    for (c = 0; c < wav->channels; c++) {
+        size_t index = (size_t)frame * wav->channels + c;
+        float sample;
+
+        if (wav->format == WAVE_FORMAT_PCM) {
+            sample = (int16_t)read_u16(wav->data + index * 2) / 32768.0f;
+        } else {
+            memcpy(&sample, wav->data + index * 4, sizeof(sample));
+        }
+        sum += sample;
+    }
+    return sum / wav->channels;
+}
+
+/* Decode the samples to mono floats at the rate, with linear interpolation. */
+static float* decode(const struct wav* wav, uint32_t rate, uint32_t* n_samples) {
+    uint64_t n  = (uint64_t)wav->n_frames * rate / wav->rate;
+    double step = (double)wav->rate / rate;
+    float* samples;
+    uint32_t i;
+
+    if (n == 0 || n > UINT32_MAX) {
+        return NULL;
+    }
+    samples = malloc(n * sizeof(float));
+    if (samples == NULL) {
+        return NULL;
+    }
+    for (i = 0; i < n; i++) {
+        double position = i * step;
+        uint32_t frame  = position;
+        float fraction  = position - frame;
+        float a         = read_frame(wav, frame);
+        float b         = frame + 1 < wav->n_frames ? read_frame(wav, frame + 1) : a;
+
+        samples[i] = a + fraction * (b - a);
+    }
+    *n_samples = n;
+    return samples;
+}
+
+static int load(struct clip* clip, const char* path, uint32_t rate) {
+    struct stat st;
+    struct wav wav;
+    int fd;
+    int res;
+
+    memset(clip, 0, sizeof(*clip));
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -errno;
+    }
+    if (fstat(fd, &st) != 0) {
+        res = -errno;
+        close(fd);
+        return res;
+    }
+    clip->map_size = st.st_size;
+    clip->map      = mmap(NULL, clip->map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (clip->map == MAP_FAILED) {
+        clip->map = NULL;
+        return -errno;
+    }
+
+    res = parse_wav(clip->map, clip->map_size, &wav);
+    if (res < 0) {
+        munmap(clip->map, clip->map_size);
+        return res;
+    }
+
+    if (wav.format == WAVE_FORMAT_IEEE_FLOAT && wav.channels == 1 && wav.rate == rate &&
+        ((uintptr_t)wav.data % sizeof(float)) == 0) {
+        clip->samples   = (const float*)wav.data;
+        clip->n_samples = wav.n_frames;
+    } else {
+        clip->decoded = decode(&wav, rate, &clip->n_samples);
+        munmap(clip->map, clip->map_size);
+        clip->map = NULL;
+        if (clip->decoded == NULL) {
+            return -ENOMEM;
+        }
+        clip->samples = clip->decoded;
+    }
+
+    clip->path = strdup(path);
+    clip->rate = rate;
+    if (clip->path == NULL) {
+        free(clip->decoded);
+        if (clip->map != NULL) {
+            munmap(clip->map, clip->map_size);
+        }
+        return -ENOMEM;
+    }
+    return 0;
+}
+
+void clip_cache_init(struct clip_cache* cache) {
+    memset(cache, 0, sizeof(*cache));
+}
+
+void clip_cache_clear(struct clip_cache* cache) {
+    uint32_t i;
+
+    for (i = 0; i < cache->n_clips; i++) {
+        struct clip* clip = &cache->clips[i];
+
+        if (clip->map != NULL) {
+            munmap(clip->map, clip->map_size);
+        }
+        free(clip->decoded);
+        free(clip->path);
+    }
+    cache->n_clips = 0;
+}
+
+int clip_cache_get(struct clip_cache* cache,
+                   const char* path,
+                   uint32_t rate,
+                   const struct clip** clip) {
+    uint32_t i;
+    int res;
+
+    for (i = 0; i < cache->n_clips; i++) {
+        if (cache->clips[i].rate == rate && strcmp(cache->clips[i].path, path) == 0) {
+            *clip = &cache->clips[i];
+            return 0;
+        }
+    }
+    if (cache->n_clips == CLIP_CACHE_MAX_CLIPS) {
+        return -ENOSPC;
+    }
+
+    res = load(&cache->clips[cache->n_clips], path, rate);
+    if (res < 0) {
+        return res;
+    }
+    *clip = &cache->clips[cache->n_clips++];
+    return 0;
+}
+
+void clip_play(const struct clip* clip, uint32_t* position, float* out, uint32_t n_samples) {
+    while (n_samples > 0) {
+        uint32_t count = MIN(n_samples, clip->n_samples - *position);
+
+        memcpy(out, clip->samples + *position, count * sizeof(float));
+        out += count;
+        n_samples -= count;
+        *position += count;
+        if (*position == clip->n_samples) {
+            *position = 0;
+        }
+    }
+}
@@ -0,0 +1,76 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/**
+ * Cache of sound clips, such as alert sounds, decoded for playback.
+ *
+ * A clip is a WAV file of 16 bit or float samples. It is memory mapped and
+ * decoded only once for each rate it is played at: if the file already has
+ * mono float samples at the rate, they are played straight from the mapping,
+ * otherwise the channels are mixed and the samples converted and resampled to
+ * the rate, into a buffer of their own. Playing a clip is then only a copy of
+ * its samples.
+ *
+ * Clips are loaded when the rate of a stream is known, not in the process
+ * callback, and stay in the cache until it is cleared.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CLIP_CACHE_MAX_CLIPS 8
+
+struct clip {
+    char* path;
+    uint32_t rate;
+    const float* samples;
+    uint32_t n_samples;
+    /* The mapped file, or NULL when it was decoded to the buffer. */
+    void* map;
+    size_t map_size;
+    float* decoded;
+};
+
+struct clip_cache {
+    struct clip clips[CLIP_CACHE_MAX_CLIPS];
+    uint32_t n_clips;
+};
+
+void clip_cache_init(struct clip_cache* cache);
+
+/**
+ * Free all the clips.
+ */
+void clip_cache_clear(struct clip_cache* cache);
+
+/**
+ * Get the clip of the file at the rate, and load it if it is not in the
+ * cache. Returns 0, or a negative errno, -EINVAL if the file is not a WAV
+ * file that can be played and -ENOSPC if the cache is full.
+ */
+int clip_cache_get(struct clip_cache* cache,
+                   const char* path,
+                   uint32_t rate,
+                   const struct clip** clip);
+
+/**
+ * Copy the next n_samples samples of the clip to out, from position, and
+ * start over at the end of the clip.
+ */
+void clip_play(const struct clip* clip, uint32_t* position, float* out, uint32_t n_samples);
@@ -0,0 +1,83 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "oscillator.h"
+
+#include <math.h>
+
+#if defined(__ARM_NEON) && !defined(OSCILLATOR_SCALAR)
+#include <arm_neon.h>
+#define OSCILLATOR_USE_NEON
+#endif
+
+#define LANES 4
+
+void oscillator_init(struct oscillator* oscillator,
+                     float frequency,
+                     float amplitude,
+                     uint32_t rate) {
+    oscillator->phase     = 0.0;
+    oscillator->step      = 2 * M_PI * frequency / rate;
+    oscillator->amplitude = amplitude;
+}
+
+void oscillator_process(struct oscillator* oscillator, float* out, uint32_t n_samples) {
+    float re[LANES];
+    float im[LANES];
+    /* The rotation of four samples. */
+    float rot_re = cos(LANES * oscillator->step);
+    float rot_im = sin(LANES * oscillator->step);
+    uint32_t i   = 0;
+    uint32_t k;
+
+    for (k = 0; k < LANES; k++) {
+        double phase = oscillator->phase + k * oscillator->step;
+
+        re[k] = oscillator->amplitude * cos(phase);
+        im[k] = oscillator->amplitude * sin(phase);
+    }
+
+#ifdef OSCILLATOR_USE_NEON
+    float32x4_t v_re = vld1q_f32(re);
+    float32x4_t v_im = vld1q_f32(im);
+
+    for (; i + LANES <= n_samples; i += LANES) {
+        float32x4_t next_re = vmlsq_n_f32(vmulq_n_f32(v_re, rot_re), v_im, rot_im);
+
+        vst1q_f32(out + i, v_im);
+        v_im = vmlaq_n_f32(vmulq_n_f32(v_im, rot_re), v_re, rot_im);
+        v_re = next_re;
+    }
+    vst1q_f32(re, v_re);
+    vst1q_f32(im, v_im);
+#else
+    for (; i + LANES <= n_samples; i += LANES) {
+        for (k = 0; k < LANES; k++) {
+            float next_re = re[k] * rot_re - im[k] * rot_im;
+
+            out[i + k] = im[k];
+            im[k]      = im[k] * rot_re + re[k] * rot_im;
+            re[k]      = next_re;
+        }
+    }
+#endif
+    for (k = 0; i < n_samples; i++, k++) {
+        out[i] = im[k];
+    }
+
+    oscillator->phase = fmod(oscillator->phase + n_samples * oscillator->step, 2 * M_PI);
+}
@@ -0,0 +1,56 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/**
+ * Sine oscillator that synthesizes blocks of samples.
+ *
+ * Four samples after each other are the four lanes of a complex phasor,
+ * that is rotated by four sample steps for the next four samples, so a
+ * sample costs two multiplications and an addition, with NEON when the
+ * compiler targets NEON and in plain C otherwise. Define OSCILLATOR_SCALAR
+ * to force the plain C version.
+ *
+ * The phase is kept in double precision and the phasor is set from it at the
+ * start of each block, so the rounding errors of the rotations do not add up
+ * over the blocks, and there is no wrap of the phase per sample.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+struct oscillator {
+    /* In radians, in [0, 2 pi). */
+    double phase;
+    /* In radians per sample. */
+    double step;
+    float amplitude;
+};
+
+/**
+ * Set up an oscillator of the frequency and amplitude at the rate, which
+ * must not be 0, starting at phase 0.
+ */
+void oscillator_init(struct oscillator* oscillator,
+                     float frequency,
+                     float amplitude,
+                     uint32_t rate);
+
+/**
+ * Write the next n_samples samples to out.
+ */
+void oscillator_process(struct oscillator* oscillator, float* out, uint32_t n_samples);
@@ -0,0 +1,152 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "event_sender.h"
+
+#include <string.h>
+#include <syslog.h>
+
+/**
+ * brief Whether two values are the same state.
+ *
+ * The values are compared bitwise, a state is only unchanged if the value is
+ * exactly the same.
+ */
+static gboolean same_value(gdouble a, gdouble b) {
+    return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+/**
+ * brief Send an event with a value now.
+ *
+ * param sender Sender of the event.
+ * param value Value of the data key.
+ */
+static void send_value(event_sender* sender, gdouble value) {
+    AXEvent* event = NULL;
+    GError* error  = NULL;
+
+    // Replace the value of the data key, the rest of the set is unchanged
+    ax_event_key_value_set_add_key_value(sender->key_value_set,
+                                         sender->key,
+                                         NULL,
+                                         &value,
+                                         AX_VALUE_TYPE_DOUBLE,
+                                         NULL);
+
+    // The event gets a copy of the set
+    event = ax_event_new2(sender->key_value_set, NULL);
+    if (!ax_event_handler_send_event(sender->event_handler, sender->declaration, event, &error)) {
+        syslog(LOG_WARNING, "Could not send event: %s", error->message);
+        g_error_free(error);
+    } else {
+        syslog(LOG_INFO,
+               "Send %s event with value: %lf",
+               sender->stateful ? "stateful" : "stateless",
+               value);
+    }
+    ax_event_free(event);
+
+    sender->has_sent   = TRUE;
+    sender->sent_value = value;
+    sender->sent_time  = g_get_monotonic_time();
+    sender->sent++;
+}
+
+/**
+ * brief Send the value that was held back, if it is still a change.
+ *
+ * param user_data The sender.
+ * return G_SOURCE_REMOVE, the next held back value schedules a new send.
+ */
+static gboolean send_pending(gpointer user_data) {
+    event_sender* sender = user_data;
+
+    sender->pending_source = 0;
+    if (sender->stateful && same_value(sender->pending_value, sender->sent_value)) {
+        // The state changed back within the interval
+        sender->suppressed++;
+    } else {
+        send_value(sender, sender->pending_value);
+    }
+    return G_SOURCE_REMOVE;
+}
+
+event_sender* event_sender_new(AXEventHandler* event_handler,
+                               guint declaration,
+                               const gchar* key,
+                               gboolean stateful,
+                               guint min_interval_ms) {
+    event_sender* sender = g_new0(event_sender, 1);
+
+    sender->event_handler   = event_handler;
+    sender->declaration     = declaration;
+    sender->stateful        = stateful;
+    sender->min_interval_us = (gint64)min_interval_ms * G_TIME_SPAN_MILLISECOND;
+    sender->key             = g_strdup(key);
+    sender->key_value_set   = ax_event_key_value_set_new();
+    return sender;
+}
+
+void event_sender_free(event_sender* sender) {
+    if (!sender) {
+        return;
+    }
+
+    if (sender->pending_source) {
+        g_source_remove(sender->pending_source);
+    }
+    syslog(LOG_INFO,
+           "Sent %" G_GUINT64_FORMAT " events, suppressed %" G_GUINT64_FORMAT
+           " unchanged and coalesced %" G_GUINT64_FORMAT " values",
+           sender->sent,
+           sender->suppressed,
+           sender->coalesced);
+    ax_event_key_value_set_free(sender->key_value_set);
+    g_free(sender->key);
+    g_free(sender);
+}
+
+gboolean event_sender_send_double(event_sender* sender, gdouble value) {
+    gint64 elapsed;
+
+    // A value is already held back, the latest value wins
+    if (sender->pending_source) {
+        sender->pending_value = value;
+        sender->coalesced++;
+        return FALSE;
+    }
+
+    if (sender->stateful && sender->has_sent && same_value(value, sender->sent_value)) {
+        sender->suppressed++;
+        return FALSE;
+    }
+
+    elapsed = g_get_monotonic_time() - sender->sent_time;
+    if (sender->has_sent && elapsed < sender->min_interval_us) {
+        sender->pending_value  = value;
+        sender->pending_source = g_timeout_add(
+            (guint)((sender->min_interval_us - elapsed + G_TIME_SPAN_MILLISECOND - 1) /
+                    G_TIME_SPAN_MILLISECOND),
+            send_pending,
+            sender);
+        return FALSE;
+    }
+
+    send_value(sender, value);
+    return TRUE;
+}
@@ -0,0 +1,87 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/**
+ * brief Rate limited sending of the events of a declaration.
+ *
+ * The sender owns a key value set with the data key of the event, built once
+ * and reused for every event with the value replaced.
+ *
+ * A value of a stateful event that is equal to the last sent value is not
+ * sent, since the state did not change. A value that comes sooner than the
+ * minimum interval after the last sent event is held back until the interval
+ * has passed, and is replaced by any later value until then, so at most one
+ * event per interval is sent with the latest value.
+ */
+
+#pragma once
+
+#include <axsdk/axevent.h>
+#include <glib.h>
+
+typedef struct {
+    AXEventHandler* event_handler;
+    guint declaration;
+    gboolean stateful;
+    gint64 min_interval_us;
+    // Reused for every event, the value of the data key is replaced
+    AXEventKeyValueSet* key_value_set;
+    gchar* key;
+    gboolean has_sent;
+    gdouble sent_value;
+    gint64 sent_time;
+    // Value held back until the minimum interval has passed
+    gdouble pending_value;
+    guint pending_source;
+    guint64 sent;
+    guint64 suppressed;
+    guint64 coalesced;
+} event_sender;
+
+/**
+ * brief Create a sender of the events of a declaration.
+ *
+ * param event_handler Event handler that the event is declared with.
+ * param declaration Declaration id.
+ * param key Data key of the event, of type double.
+ * param stateful Whether the event is stateful, i.e. a property state event.
+ * param min_interval_ms Minimum time between two sent events.
+ * return The sender.
+ */
+event_sender* event_sender_new(AXEventHandler* event_handler,
+                               guint declaration,
+                               const gchar* key,
+                               gboolean stateful,
+                               guint min_interval_ms);
+
+/**
+ * brief Free the sender.
+ *
+ * A value that is held back is dropped.
+ *
+ * param sender Sender to free.
+ */
+void event_sender_free(event_sender* sender);
+
+/**
+ * brief Send an event with a value, unless it is suppressed or held back.
+ *
+ * param sender Sender of the event.
+ * param value Value of the data key.
+ * return TRUE if the event was sent now.
+ */
+gboolean event_sender_send_double(event_sender* sender, gdouble value);
@@ -18,64 +18,56 @@
  * - send_event.c -
  *
  * This example illustrates how to send a stateful ONVIF event, which is
- * changing the value every 10th second.
+ * changing the value every 10th second. The value is produced every 100 ms,
+ * as by an analytics application at frame rate, and the event sender only
+ * sends the changes.
  *
  * Error handling has been omitted for the sake of brevity.
  */
+#include "event_sender.h"
+
 #include <axsdk/axevent.h>
 #include <glib-object.h>
 #include <glib.h>
 #include <string.h>
 #include <syslog.h>
 
+// Time between two produced values
+#define PRODUCE_INTERVAL_MS 100
+// Number of produced values between two changes of the value, i.e. 10 seconds
+#define PRODUCED_PER_CHANGE 100
+// Minimum time between two sent events
+#define SEND_MIN_INTERVAL_MS 1000
+
 typedef struct {
     AXEventHandler* event_handler;
     guint event_id;
+    event_sender* sender;
     guint timer;
+    guint produced;
     gdouble value;
 } AppData;
 
 static AppData* app_data = NULL;
 
 /**
- * brief Send event.
+ * brief Produce a value and send it as an event.
  *
- * Send the previously declared event.
+ * The value changes every PRODUCED_PER_CHANGE produced values. The sender
+ * suppresses the values that are unchanged, so an event is only sent when
+ * the value changes.
  *
- * param send_data Application data containing e.g. the event declaration id.
+ * param send_data Application data containing e.g. the event sender.
  * return TRUE
  */
 static gboolean send_event(AppData* send_data) {
-    AXEventKeyValueSet* key_value_set = NULL;
-    AXEvent* event                    = NULL;
-
-    key_value_set = ax_event_key_value_set_new();
-
-    // Add the variable elements of the event to the set
-    syslog(LOG_INFO, "Add value: %lf", send_data->value);
-    ax_event_key_value_set_add_key_value(key_value_set,
-                                         "Value",
-                                         NULL,
-                                         &send_data->value,
-                                         AX_VALUE_TYPE_DOUBLE,
-                                         NULL);
-
-    // Create the event
-    // Use ax_event_new2 since ax_event_new is deprecated from 3.2
-    event = ax_event_new2(key_value_set, NULL);
-
-    // The key/value set is no longer needed
-    ax_event_key_value_set_free(key_value_set);
-
-    // Send the event
-    ax_event_handler_send_event(send_data->event_handler, send_data->event_id, event, NULL);
-
-    syslog(LOG_INFO, "Send stateful event with value: %lf", send_data->value);
-
-    ax_event_free(event);
-
     // Toggle value
-    send_data->value = send_data->value >= 100 ? 0 : send_data->value + 10;
+    if (send_data->produced > 0 && send_data->produced % PRODUCED_PER_CHANGE == 0) {
+        send_data->value = send_data->value >= 100 ? 0 : send_data->value + 10;
+    }
+    send_data->produced++;
+
+    event_sender_send_double(send_data->sender, send_data->value);
 
     // Returning TRUE keeps the timer going
     return TRUE;
@@ -96,8 +88,8 @@ static void declaration_complete(guint declaration, gdouble* value) {
 
     app_data->value = *value;
 
-    // Set up a timer to be called every 10th second
-    app_data->timer = g_timeout_add_seconds(10, (GSourceFunc)send_event, app_data);
+    // Set up a timer to produce a value every PRODUCE_INTERVAL_MS
+    app_data->timer = g_timeout_add(PRODUCE_INTERVAL_MS, (GSourceFunc)send_event, app_data);
 }
 
 /**
@@ -196,12 +188,18 @@ gint main(void) {
     app_data                = calloc(1, sizeof(AppData));
     app_data->event_handler = ax_event_handler_new();
     app_data->event_id      = setup_declaration(app_data->event_handler, &start_value);
+    app_data->sender        = event_sender_new(app_data->event_handler,
+                                               app_data->event_id,
+                                               "Value",
+                                               TRUE,  // The event is stateful
+                                               SEND_MIN_INTERVAL_MS);
 
     // Main loop
     main_loop = g_main_loop_new(NULL, FALSE);
     g_main_loop_run(main_loop);
 
-    // Cleanup event handler
+    // Cleanup event sender and event handler
+    event_sender_free(app_data->sender);
     ax_event_handler_undeclare(app_data->event_handler, app_data->event_id, NULL);
     ax_event_handler_free(app_data->event_handler);
     free(app_data);
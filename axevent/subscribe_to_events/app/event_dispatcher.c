@@ -0,0 +1,178 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "event_dispatcher.h"
+
+#include <syslog.h>
+
+typedef struct {
+    event_dispatcher* dispatcher;
+    const event_route* route;
+    gpointer user_data;
+    guint id;
+} event_subscription;
+
+typedef struct {
+    event_subscription* subscription;
+    event_values values;
+} queued_event;
+
+/**
+ * brief Handle the queued events, in the order they were first queued.
+ *
+ * param user_data The dispatcher.
+ * return G_SOURCE_REMOVE, the next event schedules a new batch.
+ */
+static gboolean handle_batch(gpointer user_data) {
+    event_dispatcher* dispatcher = user_data;
+    guint i;
+
+    dispatcher->batch_source = 0;
+    dispatcher->batches++;
+    for (i = 0; i < dispatcher->queue->len; i++) {
+        queued_event* queued             = &g_array_index(dispatcher->queue, queued_event, i);
+        event_subscription* subscription = queued->subscription;
+
+        subscription->route->handler(&queued->values, subscription->user_data);
+    }
+    g_array_set_size(dispatcher->queue, 0);
+    return G_SOURCE_REMOVE;
+}
+
+/**
+ * brief Read the values of an event and queue them, replacing the values of
+ * a queued event with the same coalesce key value.
+ *
+ * param subscription_id Subscription id.
+ * param event Subscribed event.
+ * param user_data The subscription.
+ */
+static void on_event(guint subscription_id, AXEvent* event, gpointer user_data) {
+    event_subscription* subscription = user_data;
+    event_dispatcher* dispatcher     = subscription->dispatcher;
+    const event_route* route         = subscription->route;
+    const AXEventKeyValueSet* key_value_set;
+    queued_event* queued = NULL;
+    event_values values  = {0};
+    guint i;
+
+    (void)subscription_id;
+
+    // Read the values now, the event is freed when this callback returns
+    key_value_set = ax_event_get_key_value_set(event);
+    for (i = 0; route->keys[i].key; i++) {
+        if (route->keys[i].type == AX_VALUE_TYPE_BOOL) {
+            gboolean value = FALSE;
+            ax_event_key_value_set_get_boolean(key_value_set,
+                                               route->keys[i].key,
+                                               NULL,
+                                               &value,
+                                               NULL);
+            values.values[i] = value ? TRUE : FALSE;
+        } else {
+            ax_event_key_value_set_get_integer(key_value_set,
+                                               route->keys[i].key,
+                                               NULL,
+                                               &values.values[i],
+                                               NULL);
+        }
+    }
+    ax_event_free(event);
+    dispatcher->events++;
+
+    // The queue is short, a few entries per subscription
+    for (i = 0; i < dispatcher->queue->len && !queued; i++) {
+        queued_event* candidate = &g_array_index(dispatcher->queue, queued_event, i);
+        if (candidate->subscription == subscription &&
+            (route->coalesce_key == EVENT_DISPATCHER_NO_COALESCE_KEY ||
+             candidate->values.values[route->coalesce_key] ==
+                 values.values[route->coalesce_key])) {
+            queued = candidate;
+        }
+    }
+    if (queued) {
+        values.count = queued->values.count + 1;
+    } else {
+        g_array_set_size(dispatcher->queue, dispatcher->queue->len + 1);
+        queued               = &g_array_index(dispatcher->queue, queued_event, i);
+        queued->subscription = subscription;
+        values.count         = 1;
+    }
+    queued->values = values;
+
+    if (!dispatcher->batch_source) {
+        dispatcher->batch_source = g_timeout_add(dispatcher->batch_ms, handle_batch, dispatcher);
+    }
+}
+
+event_dispatcher* event_dispatcher_new(AXEventHandler* event_handler, guint batch_ms) {
+    event_dispatcher* dispatcher = g_new0(event_dispatcher, 1);
+
+    dispatcher->event_handler = event_handler;
+    dispatcher->batch_ms      = batch_ms;
+    dispatcher->subscriptions = g_ptr_array_new();
+    dispatcher->queue         = g_array_new(FALSE, FALSE, sizeof(queued_event));
+    return dispatcher;
+}
+
+void event_dispatcher_free(event_dispatcher* dispatcher) {
+    guint i;
+
+    if (!dispatcher) {
+        return;
+    }
+
+    for (i = 0; i < dispatcher->subscriptions->len; i++) {
+        event_subscription* subscription = g_ptr_array_index(dispatcher->subscriptions, i);
+        ax_event_handler_unsubscribe(dispatcher->event_handler, subscription->id, NULL);
+        g_free(subscription);
+    }
+    if (dispatcher->batch_source) {
+        g_source_remove(dispatcher->batch_source);
+    }
+    syslog(LOG_INFO,
+           "Handled %" G_GUINT64_FORMAT " events in %" G_GUINT64_FORMAT " batches",
+           dispatcher->events,
+           dispatcher->batches);
+    g_array_free(dispatcher->queue, TRUE);
+    g_ptr_array_free(dispatcher->subscriptions, TRUE);
+    g_free(dispatcher);
+}
+
+guint event_dispatcher_subscribe(event_dispatcher* dispatcher,
+                                 AXEventKeyValueSet* key_value_set,
+                                 const event_route* route,
+                                 gpointer user_data,
+                                 GError** error) {
+    event_subscription* subscription = g_new0(event_subscription, 1);
+
+    subscription->dispatcher = dispatcher;
+    subscription->route      = route;
+    subscription->user_data  = user_data;
+    if (!ax_event_handler_subscribe(dispatcher->event_handler,
+                                    key_value_set,
+                                    &subscription->id,
+                                    on_event,
+                                    subscription,
+                                    error)) {
+        syslog(LOG_WARNING, "%u: Could not subscribe to %s events", route->id, route->name);
+        g_free(subscription);
+        return 0;
+    }
+    g_ptr_array_add(dispatcher->subscriptions, subscription);
+    return subscription->id;
+}
@@ -0,0 +1,120 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/**
+ * brief Dispatch of subscribed events to handlers, in batches.
+ *
+ * Each subscription has a route, a static description of the keys to read
+ * from its events and of the handler to call with their values. The values
+ * are read when the event arrives, and the event is queued. The queued events
+ * are handled in a batch a while after the first one, on the main loop.
+ *
+ * Events of a subscription that arrive before their batch is handled are
+ * coalesced per value of the route's coalesce key, e.g. per channel, and the
+ * latest values win. A burst of e.g. tampering or PTZ move events then costs
+ * one handler call per batch instead of one per event.
+ */
+
+#pragma once
+
+#include <axsdk/axevent.h>
+#include <glib.h>
+
+// Number of keys a route can read from an event
+#define EVENT_DISPATCHER_MAX_KEYS 4
+// The events are not coalesced by any key
+#define EVENT_DISPATCHER_NO_COALESCE_KEY -1
+
+/**
+ * brief Values read from an event.
+ *
+ * The values are in the order of the keys of the route, booleans as TRUE or
+ * FALSE. A key that is missing in the event reads as 0.
+ */
+typedef struct {
+    gint values[EVENT_DISPATCHER_MAX_KEYS];
+    // Number of events coalesced into these values, at least 1
+    guint count;
+} event_values;
+
+typedef void (*event_handler_func)(const event_values* values, gpointer user_data);
+
+typedef struct {
+    const gchar* key;
+    // AX_VALUE_TYPE_INT or AX_VALUE_TYPE_BOOL
+    AXEventValueType type;
+} event_key;
+
+/**
+ * brief How the events of a subscription are read and handled.
+ */
+typedef struct {
+    // Identifies the route in the logs
+    guint id;
+    const gchar* name;
+    // Keys to read, ended by a NULL key
+    event_key keys[EVENT_DISPATCHER_MAX_KEYS + 1];
+    // Index in keys of the key to coalesce per, or EVENT_DISPATCHER_NO_COALESCE_KEY
+    gint coalesce_key;
+    event_handler_func handler;
+} event_route;
+
+typedef struct {
+    AXEventHandler* event_handler;
+    guint batch_ms;
+    // Subscriptions, which own their user data of the axevent callback
+    GPtrArray* subscriptions;
+    // Queued events, at most one per subscription and coalesce key value
+    GArray* queue;
+    guint batch_source;
+    guint64 events;
+    guint64 batches;
+} event_dispatcher;
+
+/**
+ * brief Create a dispatcher of the events of an event handler.
+ *
+ * param event_handler Event handler to subscribe with.
+ * param batch_ms Time from the first queued event until its batch is handled.
+ * return The dispatcher.
+ */
+event_dispatcher* event_dispatcher_new(AXEventHandler* event_handler, guint batch_ms);
+
+/**
+ * brief Unsubscribe all subscriptions and free the dispatcher.
+ *
+ * The events that are queued are dropped.
+ *
+ * param dispatcher Dispatcher to free.
+ */
+void event_dispatcher_free(event_dispatcher* dispatcher);
+
+/**
+ * brief Subscribe to events and route them to a handler.
+ *
+ * param dispatcher Dispatcher to subscribe with.
+ * param key_value_set Key value set that the events match.
+ * param route Route of the events, which must outlive the dispatcher.
+ * param user_data User data to the handler.
+ * param error Set if the subscription failed.
+ * return Subscription id, or 0 on error.
+ */
+guint event_dispatcher_subscribe(event_dispatcher* dispatcher,
+                                 AXEventKeyValueSet* key_value_set,
+                                 const event_route* route,
+                                 gpointer user_data,
+                                 GError** error);
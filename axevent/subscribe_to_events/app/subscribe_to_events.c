@@ -25,6 +25,8 @@
  * Error handling has been omitted for the sake of brevity.
  */
 
+#include "event_dispatcher.h"
+
 #include <axsdk/axevent.h>
 #include <glib-object.h>
 #include <glib.h>
@@ -36,159 +38,180 @@
 #define PTZMOVE_TOKEN       4004
 #define TAMPERING_TOKEN     5005
 
+// Time from the first event of a batch until the batch is handled
+#define EVENT_BATCH_MS 100
+
 /***** Struct declarations ****************************************************/
 
 typedef struct {
     guint id;
     struct {
         gint num_moves;
+        gboolean is_moving;
     } ptzchannel[8];
 } ptzmove;
 
-/***** Callback functions *****************************************************/
+/***** Event handlers *********************************************************/
+
+/*
+ * The handlers are called from the dispatcher in batches, with the values of
+ * the keys of their route in the order listed in the route.
+ */
+
+enum { AUDIOTRIGGER_CHANNEL, AUDIOTRIGGER_TRIGGERED };
 
 /**
- * brief Callback function which is called when event subscription is completed.
+ * brief Handle an audio trigger event.
  *
- * This callback will be called when the subscription has been registered
- * with the event system. The event subscription can now be used for
- * subscribing to events. The callback function is shared between different
- * events and separated with token.
+ * param values Channel and triggered.
+ * param user_data Not used.
+ */
+static void audiotrigger_handler(const event_values* values, gpointer user_data) {
+    (void)user_data;
+
+    // Print state of audio trigger level
+    syslog(LOG_INFO,
+           "%d:audiotrigger-event: Audio channel %d %s trigger level",
+           AUDIOTRIGGER_TOKEN,
+           values->values[AUDIOTRIGGER_CHANNEL],
+           values->values[AUDIOTRIGGER_TRIGGERED] ? "above" : "below");
+}
+
+enum { DAYNIGHT_DAY };
+
+/**
+ * brief Handle a day/night event.
  *
- * param subscription Subscription id.
- * param event Subscribed event.
- * param token Token as user data to the callback function.
+ * param values Day.
+ * param user_data Not used.
  */
-static void common_callback(guint subscription, AXEvent* event, guint* token) {
-    const AXEventKeyValueSet* key_value_set;
-    gboolean day;
-    gboolean state;
-    gboolean triggered;
-    gint channel;
-    gint port;
-
-    // The subscription id is not used in this example
-    (void)subscription;
-
-    // Extract the AXEventKeyValueSet from the event
-    key_value_set = ax_event_get_key_value_set(event);
-
-    // Handle the different events
-    if (*token == AUDIOTRIGGER_TOKEN) {
-        // Get the audio trigger variables of interest
-        ax_event_key_value_set_get_integer(key_value_set, "channel", NULL, &channel, NULL);
-        ax_event_key_value_set_get_boolean(key_value_set, "triggered", NULL, &triggered, NULL);
-
-        // Print state of audio trigger level
-        if (triggered) {
-            syslog(LOG_INFO,
-                   "%d:audiotrigger-event: Audio channel %d above "
-                   "trigger level",
-                   *token,
-                   channel);
-        } else {
-            syslog(LOG_INFO,
-                   "%d:audiotrigger-event: Audio channel %d below "
-                   "trigger level",
-                   *token,
-                   channel);
-        }
-
-    } else if (*token == DAYNIGHT_TOKEN) {
-        // Get the state of the day key
-        ax_event_key_value_set_get_boolean(key_value_set, "day", NULL, &day, NULL);
-
-        // Print if day or night
-        if (day) {
-            syslog(LOG_INFO, "%d:daynight-event: Day detected", *token);
-        } else {
-            syslog(LOG_INFO, "%d:daynight-event: Night detected", *token);
-        }
-
-    } else if (*token == MANUALTRIGGER_TOKEN) {
-        // Get the manual trigger variables of interest
-        ax_event_key_value_set_get_integer(key_value_set, "port", NULL, &port, NULL);
-        ax_event_key_value_set_get_boolean(key_value_set, "state", NULL, &state, NULL);
-
-        // Print state of manual trigger
-        if (state) {
-            syslog(LOG_INFO, "%d:manualtrigger-event: Trigger on port %d is active", *token, port);
-        } else {
-            syslog(LOG_INFO,
-                   "%d:manualtrigger-event: Trigger on port %d is inactive",
-                   *token,
-                   port);
-        }
-
-    } else if (*token == TAMPERING_TOKEN) {
-        // Get the tampering channel variable
-        ax_event_key_value_set_get_integer(key_value_set, "channel", NULL, &channel, NULL);
-
-        // Tampering is stateless, inform that event took place
-        syslog(LOG_INFO, "%d:tampering-event: Tampering detected on channel %d", *token, channel);
-    }
+static void daynight_handler(const event_values* values, gpointer user_data) {
+    (void)user_data;
+
+    // Print if day or night
+    syslog(LOG_INFO,
+           "%d:daynight-event: %s detected",
+           DAYNIGHT_TOKEN,
+           values->values[DAYNIGHT_DAY] ? "Day" : "Night");
+}
 
-    /*
-     * Free the received event, n.b. AXEventKeyValueSet should not be freed
-     * since it's owned by the event system until unsubscribing
-     */
-    ax_event_free(event);
+enum { MANUALTRIGGER_PORT, MANUALTRIGGER_STATE };
+
+/**
+ * brief Handle a manual trigger event.
+ *
+ * param values Port and state.
+ * param user_data Not used.
+ */
+static void manualtrigger_handler(const event_values* values, gpointer user_data) {
+    (void)user_data;
+
+    // Print state of manual trigger
+    syslog(LOG_INFO,
+           "%d:manualtrigger-event: Trigger on port %d is %s",
+           MANUALTRIGGER_TOKEN,
+           values->values[MANUALTRIGGER_PORT],
+           values->values[MANUALTRIGGER_STATE] ? "active" : "inactive");
 }
 
+enum { PTZMOVE_CHANNEL, PTZMOVE_IS_MOVING };
+
 /**
- * brief Callback function which is called when event subscription is completed.
+ * brief Handle a PTZ move event.
  *
- * This callback will be called when the subscription has been registered
- * with the event system. The event subscription can now be used for
- * subscribing to events. This callback function is only for PTZ move events.
+ * The events of a channel that starts and stops moving within a batch are
+ * coalesced, so only the moves that are seen by the handler are counted.
  *
- * param subscription Subscription id.
- * param event Subscribed event.
- * param data User data of type ptzmove.
+ * param values Channel and is_moving.
+ * param user_data User data of type ptzmove.
  */
-static void ptzmove_callback(guint subscription, AXEvent* event, ptzmove* data) {
-    const AXEventKeyValueSet* key_value_set;
-    gboolean is_moving;
-    gboolean val = FALSE;
-    gint channel;
-
-    // The subscription id is not used in this example
-    (void)subscription;
-
-    // Extract the AXEventKeyValueSet from the event
-    key_value_set = ax_event_get_key_value_set(event);
-
-    // Get the state of the manual trigger port
-    ax_event_key_value_set_get_integer(key_value_set,
-                                       "PTZConfigurationToken",
-                                       NULL,
-                                       &channel,
-                                       NULL);
-    ax_event_key_value_set_get_boolean(key_value_set, "is_moving", NULL, &is_moving, NULL);
+static void ptzmove_handler(const event_values* values, gpointer user_data) {
+    ptzmove* data      = user_data;
+    gint channel       = values->values[PTZMOVE_CHANNEL];
+    gboolean is_moving = values->values[PTZMOVE_IS_MOVING];
+
+    if (channel < 0 || channel >= (gint)G_N_ELEMENTS(data->ptzchannel)) {
+        return;
+    }
 
     // Print channel and if moving or stopped
-    if (is_moving) {
+    if (is_moving && !data->ptzchannel[channel].is_moving) {
         data->ptzchannel[channel].num_moves += 1;
-        val = (data->ptzchannel[channel].num_moves == 1);
         syslog(LOG_INFO,
                "%d:ptzmove-event: PTZ channel %d started moving (%d %s)",
                data->id,
                channel,
                data->ptzchannel[channel].num_moves,
-               val ? "time" : "times");
-    } else {
-        if (data->ptzchannel[channel].num_moves > 0) {
-            syslog(LOG_INFO, "%d:ptzmove-event: PTZ channel %d stopped moving", data->id, channel);
-        }
+               data->ptzchannel[channel].num_moves == 1 ? "time" : "times");
+    } else if (!is_moving && data->ptzchannel[channel].is_moving) {
+        syslog(LOG_INFO, "%d:ptzmove-event: PTZ channel %d stopped moving", data->id, channel);
     }
+    data->ptzchannel[channel].is_moving = is_moving;
+}
 
-    /*
-     * Free the received event, n.b. AXEventKeyValueSet should not be freed
-     * since it's owned by the event system until unsubscribing
-     */
-    ax_event_free(event);
+enum { TAMPERING_CHANNEL };
+
+/**
+ * brief Handle a tampering event.
+ *
+ * param values Channel, and the number of events in count.
+ * param user_data Not used.
+ */
+static void tampering_handler(const event_values* values, gpointer user_data) {
+    (void)user_data;
+
+    // Tampering is stateless, inform that events took place
+    syslog(LOG_INFO,
+           "%d:tampering-event: Tampering detected on channel %d (%u %s)",
+           TAMPERING_TOKEN,
+           values->values[TAMPERING_CHANNEL],
+           values->count,
+           values->count == 1 ? "time" : "times");
 }
 
+/***** Routes *****************************************************************/
+
+static const event_route audiotrigger_route = {
+    .id           = AUDIOTRIGGER_TOKEN,
+    .name         = "audiotrigger",
+    .keys         = {{"channel", AX_VALUE_TYPE_INT}, {"triggered", AX_VALUE_TYPE_BOOL}},
+    .coalesce_key = AUDIOTRIGGER_CHANNEL,
+    .handler      = audiotrigger_handler,
+};
+
+static const event_route daynight_route = {
+    .id           = DAYNIGHT_TOKEN,
+    .name         = "daynight",
+    .keys         = {{"day", AX_VALUE_TYPE_BOOL}},
+    .coalesce_key = EVENT_DISPATCHER_NO_COALESCE_KEY,
+    .handler      = daynight_handler,
+};
+
+static const event_route manualtrigger_route = {
+    .id           = MANUALTRIGGER_TOKEN,
+    .name         = "manualtrigger",
+    .keys         = {{"port", AX_VALUE_TYPE_INT}, {"state", AX_VALUE_TYPE_BOOL}},
+    .coalesce_key = MANUALTRIGGER_PORT,
+    .handler      = manualtrigger_handler,
+};
+
+static const event_route ptzmove_route = {
+    .id           = PTZMOVE_TOKEN,
+    .name         = "ptzmove",
+    .keys         = {{"PTZConfigurationToken", AX_VALUE_TYPE_INT},
+                     {"is_moving", AX_VALUE_TYPE_BOOL}},
+    .coalesce_key = PTZMOVE_CHANNEL,
+    .handler      = ptzmove_handler,
+};
+
+static const event_route tampering_route = {
+    .id           = TAMPERING_TOKEN,
+    .name         = "tampering",
+    .keys         = {{"channel", AX_VALUE_TYPE_INT}},
+    .coalesce_key = TAMPERING_CHANNEL,
+    .handler      = tampering_handler,
+};
+
 /***** Subscription functions *************************************************/
 
 /**
@@ -196,11 +219,10 @@ static void ptzmove_callback(guint subscription, AXEvent* event, ptzmove* data)
  *
  * Initialize a subscription that matches AudioSource/TriggerLevel.
  *
- * param event_handler Event handler.
- * param token User data to callback function.
+ * param dispatcher Event dispatcher.
  * return Subscription id as integer.
  */
-static guint audiotrigger_subscription(AXEventHandler* event_handler, guint token) {
+static guint audiotrigger_subscription(event_dispatcher* dispatcher) {
     AXEventKeyValueSet* key_value_set;
     guint subscription;
 
@@ -233,13 +255,12 @@ static guint audiotrigger_subscription(AXEventHandler* event_handler, guint toke
                                           AX_VALUE_TYPE_BOOL,
                                           NULL);
 
-    // Setup subscription and connect to callback function
-    ax_event_handler_subscribe(event_handler,                            // event handler
-                               key_value_set,                            // key value set
-                               &subscription,                            // subscription id
-                               (AXSubscriptionCallback)common_callback,  // callback function
-                               &token,                                   // user data
-                               NULL);                                    // GError
+    // Setup subscription and route its events to the handler
+    subscription = event_dispatcher_subscribe(dispatcher,            // dispatcher
+                                              key_value_set,         // key value set
+                                              &audiotrigger_route,   // route of the events
+                                              NULL,                  // user data
+                                              NULL);                 // GError
 
     // Free key value set
     ax_event_key_value_set_free(key_value_set);
@@ -254,11 +275,10 @@ static guint audiotrigger_subscription(AXEventHandler* event_handler, guint toke
  *
  * Initialize a subscription that matches VideoSource/DayNightVision.
  *
- * param event_handler Event handler.
- * param token User data to callback function.
+ * param dispatcher Event dispatcher.
  * return Subscription id as integer.
  */
-static guint daynight_subscription(AXEventHandler* event_handler, guint token) {
+static guint daynight_subscription(event_dispatcher* dispatcher) {
     AXEventKeyValueSet* key_value_set;
     guint subscription;
 
@@ -291,13 +311,12 @@ static guint daynight_subscription(AXEventHandler* event_handler, guint token) {
                                           AX_VALUE_TYPE_BOOL,
                                           NULL);
 
-    // Setup subscription and connect to callback function
-    ax_event_handler_subscribe(event_handler,                            // event handler
-                               key_value_set,                            // key value set
-                               &subscription,                            // subscription id
-                               (AXSubscriptionCallback)common_callback,  // callback function
-                               &token,                                   // user data
-                               NULL);                                    // GError
+    // Setup subscription and route its events to the handler
+    subscription = event_dispatcher_subscribe(dispatcher,        // dispatcher
+                                              key_value_set,     // key value set
+                                              &daynight_route,   // route of the events
+                                              NULL,              // user data
+                                              NULL);             // GError
 
     // Free key value set
     ax_event_key_value_set_free(key_value_set);
@@ -312,11 +331,10 @@ static guint daynight_subscription(AXEventHandler* event_handler, guint token) {
  *
  * Initialize a subscription that matches Device/IO/VirtualPort.
  *
- * param event_handler Event handler.
- * param token User data to callback function.
+ * param dispatcher Event dispatcher.
  * return Subscription id as integer.
  */
-static guint manualtrigger_subscription(AXEventHandler* event_handler, guint token) {
+static guint manualtrigger_subscription(event_dispatcher* dispatcher) {
     AXEventKeyValueSet* key_value_set;
     gint port = 1;
     guint subscription;
@@ -355,13 +373,12 @@ static guint manualtrigger_subscription(AXEventHandler* event_handler, guint tok
                                           AX_VALUE_TYPE_BOOL,
                                           NULL);
 
-    // Setup subscription and connect to callback function
-    ax_event_handler_subscribe(event_handler,                            // event handler
-                               key_value_set,                            // key value set
-                               &subscription,                            // subscription id
-                               (AXSubscriptionCallback)common_callback,  // callback function
-                               &token,                                   // user data
-                               NULL);                                    // GError
+    // Setup subscription and route its events to the handler
+    subscription = event_dispatcher_subscribe(dispatcher,             // dispatcher
+                                              key_value_set,          // key value set
+                                              &manualtrigger_route,   // route of the events
+                                              NULL,                   // user data
+                                              NULL);                  // GError
 
     // Free key value set
     ax_event_key_value_set_free(key_value_set);
@@ -376,11 +393,11 @@ static guint manualtrigger_subscription(AXEventHandler* event_handler, guint tok
  *
  * Initialize a subscription that matches PTZController/Move.
  *
- * param event_handler Event handler.
- * param data User data to callback function.
+ * param dispatcher Event dispatcher.
+ * param data User data to the handler.
  * return Subscription id as integer.
  */
-static guint ptzmove_subscription(AXEventHandler* event_handler, ptzmove* data) {
+static guint ptzmove_subscription(event_dispatcher* dispatcher, ptzmove* data) {
     AXEventKeyValueSet* key_value_set;
     guint subscription;
 
@@ -413,13 +430,12 @@ static guint ptzmove_subscription(AXEventHandler* event_handler, ptzmove* data)
                                           AX_VALUE_TYPE_BOOL,
                                           NULL);
 
-    // Setup subscription and connect to callback function
-    ax_event_handler_subscribe(event_handler,                             // event handler
-                               key_value_set,                             // key value set
-                               &subscription,                             // subscription id
-                               (AXSubscriptionCallback)ptzmove_callback,  // callback function
-                               data,                                      // user data
-                               NULL);                                     // GError
+    // Setup subscription and route its events to the handler
+    subscription = event_dispatcher_subscribe(dispatcher,       // dispatcher
+                                              key_value_set,    // key value set
+                                              &ptzmove_route,   // route of the events
+                                              data,             // user data
+                                              NULL);            // GError
 
     // Free key value set
     ax_event_key_value_set_free(key_value_set);
@@ -434,11 +450,10 @@ static guint ptzmove_subscription(AXEventHandler* event_handler, ptzmove* data)
  *
  * Initialize a subscription that matches VideoSource/Tampering.
  *
- * param event_handler Event handler.
- * param token User data to callback function.
+ * param dispatcher Event dispatcher.
  * return Subscription id as integer.
  */
-static guint tampering_subscription(AXEventHandler* event_handler, guint token) {
+static guint tampering_subscription(event_dispatcher* dispatcher) {
     AXEventKeyValueSet* key_value_set;
     gint channel = 1;
     guint subscription;
@@ -472,13 +487,12 @@ static guint tampering_subscription(AXEventHandler* event_handler, guint token)
                                           AX_VALUE_TYPE_INT,
                                           NULL);
 
-    // Setup subscription and connect to callback function
-    ax_event_handler_subscribe(event_handler,                            // event handler
-                               key_value_set,                            // key value set
-                               &subscription,                            // subscription id
-                               (AXSubscriptionCallback)common_callback,  // callback function
-                               &token,                                   // user data
-                               NULL);                                    // GError
+    // Setup subscription and route its events to the handler
+    subscription = event_dispatcher_subscribe(dispatcher,         // dispatcher
+                                              key_value_set,      // key value set
+                                              &tampering_route,   // route of the events
+                                              NULL,               // user data
+                                              NULL);              // GError
 
     // Free key value set
     ax_event_key_value_set_free(key_value_set);
@@ -496,44 +510,33 @@ static guint tampering_subscription(AXEventHandler* event_handler, guint token)
 int main(void) {
     GMainLoop* main_loop;
     AXEventHandler* event_handler;
-    guint audiotrigger_handle;
-    guint daynight_handle;
-    guint manualtrigger_handle;
-    guint ptzmove_handle;
-    guint tampering_handle;
+    event_dispatcher* dispatcher;
 
     // Setup of user data
-    guint audiotrigger_token  = AUDIOTRIGGER_TOKEN;
-    guint daynight_token      = DAYNIGHT_TOKEN;
-    guint manualtrigger_token = MANUALTRIGGER_TOKEN;
-    guint tampering_token     = TAMPERING_TOKEN;
-    ptzmove* ptzmove_data     = g_slice_new0(ptzmove);
-    ptzmove_data->id          = PTZMOVE_TOKEN;
+    ptzmove* ptzmove_data = g_slice_new0(ptzmove);
+    ptzmove_data->id      = PTZMOVE_TOKEN;
 
     // Initialize main loop
     main_loop = g_main_loop_new(NULL, FALSE);
 
     syslog(LOG_INFO, "Started logging from subscribe event application");
 
-    // Create an event handler
+    // Create an event handler and a dispatcher of its events
     event_handler = ax_event_handler_new();
+    dispatcher    = event_dispatcher_new(event_handler, EVENT_BATCH_MS);
 
-    // Subscribe to different events and get subscription id
-    audiotrigger_handle  = audiotrigger_subscription(event_handler, audiotrigger_token);
-    daynight_handle      = daynight_subscription(event_handler, daynight_token);
-    manualtrigger_handle = manualtrigger_subscription(event_handler, manualtrigger_token);
-    ptzmove_handle       = ptzmove_subscription(event_handler, ptzmove_data);
-    tampering_handle     = tampering_subscription(event_handler, tampering_token);
+    // Subscribe to different events
+    audiotrigger_subscription(dispatcher);
+    daynight_subscription(dispatcher);
+    manualtrigger_subscription(dispatcher);
+    ptzmove_subscription(dispatcher, ptzmove_data);
+    tampering_subscription(dispatcher);
 
     // Start main loop
     g_main_loop_run(main_loop);
 
-    // Unsubscribe each subscription created
-    ax_event_handler_unsubscribe(event_handler, audiotrigger_handle, NULL);
-    ax_event_handler_unsubscribe(event_handler, daynight_handle, NULL);
-    ax_event_handler_unsubscribe(event_handler, manualtrigger_handle, NULL);
-    ax_event_handler_unsubscribe(event_handler, ptzmove_handle, NULL);
-    ax_event_handler_unsubscribe(event_handler, tampering_handle, NULL);
+    // Unsubscribe each subscription created and free the dispatcher
+    event_dispatcher_free(dispatcher);
 
     // Free event handler
     ax_event_handler_free(event_handler);
@@ -21,6 +21,9 @@
  * plain boxes using 4-bit palette color format and text overlay using
  * ARGB32 color format.
  *
+ * The boxes and the text are kept in retained scenes, see overlay_scene.h,
+ * so a redraw only clears and draws the parts of an overlay that changed.
+ *
  * Colorspace and alignment:
  * 1-bit palette (AXOVERLAY_COLORSPACE_1BIT_PALETTE): 32-byte alignment
  * 4-bit palette (AXOVERLAY_COLORSPACE_4BIT_PALETTE): 16-byte alignment
@@ -28,6 +31,8 @@
  *
  */
 
+#include "overlay_scene.h"
+
 #include <axoverlay.h>
 #include <cairo/cairo.h>
 #include <errno.h>
@@ -36,7 +41,9 @@
 #include <stdlib.h>
 #include <syslog.h>
 
-#define PALETTE_VALUE_RANGE 255.0
+#define FONT_SIZE 32.0
+// Rendered layers kept per overlay, one per overlay size and rotation that is viewed
+#define MAX_RENDER_LAYERS 2
 
 static gint animation_timer = -1;
 static gint overlay_id      = -1;
@@ -45,86 +52,36 @@ static gint counter         = 10;
 static gint top_color       = 1;
 static gint bottom_color    = 3;
 
-/***** Drawing functions *****************************************************/
+// Scenes of the two overlays and their items
+static overlay_scene* box_scene  = NULL;
+static overlay_scene* text_scene = NULL;
+static guint top_rect            = 0;
+static guint bottom_rect         = 0;
+static guint countdown_text      = 0;
+// Generations of the scenes when a redraw was last requested
+static guint redrawn_box_generation  = 0;
+static guint redrawn_text_generation = 0;
 
-/**
- * brief Converts palette color index to cairo color value.
- *
- * This function converts the palette index, which has been initialized by
- * function axoverlay_set_palette_color to a value that can be used by
- * function cairo_set_source_rgba.
- *
- * param color_index Index in the palette setup.
- *
- * return color value.
- */
-static gdouble index2cairo(const gint color_index) {
-    return ((color_index << 4) + color_index) / PALETTE_VALUE_RANGE;
-}
-
-/**
- * brief Draw a rectangle using palette.
- *
- * This function draws a rectangle with lines from coordinates
- * left, top, right and bottom with a palette color index and
- * line width.
- *
- * param context Cairo rendering context.
- * param left Left coordinate (x1).
- * param top Top coordinate (y1).
- * param right Right coordinate (x2).
- * param bottom Bottom coordinate (y2).
- * param color_index Palette color index.
- * param line_width Rectange line width.
- */
-static void draw_rectangle(cairo_t* context,
-                           gint left,
-                           gint top,
-                           gint right,
-                           gint bottom,
-                           gint color_index,
-                           gint line_width) {
-    gdouble val = 0;
-
-    val = index2cairo(color_index);
-    cairo_set_source_rgba(context, val, val, val, val);
-    cairo_set_operator(context, CAIRO_OPERATOR_SOURCE);
-    cairo_set_line_width(context, line_width);
-    cairo_rectangle(context, left, top, right - left, bottom - top);
-    cairo_stroke(context);
-}
+/***** Drawing functions *****************************************************/
 
 /**
- * brief Draw a text using cairo.
+ * brief Setup the scenes of the overlays.
  *
- * This function draws a text with a specified middle position,
- * which will be adjusted depending on the text length.
- *
- * param context Cairo rendering context.
- * param pos_x Center position coordinate (x).
- * param pos_y Center position coordinate (y).
+ * The boxes are drawn on the palette overlay and the text on the ARGB32
+ * overlay, each overlay has a scene of its own.
  */
-static void draw_text(cairo_t* context, const gint pos_x, const gint pos_y) {
-    cairo_text_extents_t te;
-    cairo_text_extents_t te_length;
-    gchar* str        = NULL;
-    gchar* str_length = NULL;
-
-    //  Show text in black
-    cairo_set_source_rgb(context, 0, 0, 0);
-    cairo_select_font_face(context, "serif", CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_BOLD);
-    cairo_set_font_size(context, 32.0);
-
-    // Position the text at a fix centered position
-    str_length = g_strdup_printf("Countdown  ");
-    cairo_text_extents(context, str_length, &te_length);
-    cairo_move_to(context, pos_x - te_length.width / 2, pos_y);
-    g_free(str_length);
-
-    // Add the counter number to the shown text
-    str = g_strdup_printf("Countdown %i", counter);
-    cairo_text_extents(context, str, &te);
-    cairo_show_text(context, str);
+static void setup_scenes(void) {
+    gchar* str = g_strdup_printf("Countdown %i", counter);
+
+    box_scene = overlay_scene_new(MAX_RENDER_LAYERS);
+    //  A top rectangle in toggling color
+    top_rect = overlay_scene_add_rect(box_scene, 0.0, 0.0, 1.0, 0.25, top_color, 9.6);
+    //  A bottom rectangle in toggling color
+    bottom_rect = overlay_scene_add_rect(box_scene, 0.0, 0.75, 1.0, 1.0, bottom_color, 2.0);
+
+    // The text is positioned at a fix centered position, whatever the number of digits
+    text_scene     = overlay_scene_new(MAX_RENDER_LAYERS);
+    countdown_text = overlay_scene_add_text(text_scene, 0.5, 0.5, FONT_SIZE, "Countdown  ", str);
     g_free(str);
 }
 
@@ -264,35 +221,23 @@ static void render_overlay_cb(gpointer rendering_context,
     (void)overlay_x;
     (void)overlay_y;
 
-    gdouble val = FALSE;
-
-    syslog(LOG_INFO, "Render callback for camera: %i", stream->camera);
-    syslog(LOG_INFO, "Render callback for overlay: %i x %i", overlay_width, overlay_height);
-    syslog(LOG_INFO, "Render callback for stream: %i x %i", stream->width, stream->height);
-    syslog(LOG_INFO, "Render callback for rotation: %i", stream->rotation);
-
+    // Only the parts of the overlay that changed since it was last drawn on this stream are drawn,
+    // copied from the layer of the overlay size and rotation when it is already up to date.
+    // Nothing is logged here, since this is called for every stream on every redraw.
     if (id == overlay_id) {
-        //  Clear background by drawing a "filled" rectangle
-        val = index2cairo(0);
-        cairo_set_source_rgba(rendering_context, val, val, val, val);
-        cairo_set_operator(rendering_context, CAIRO_OPERATOR_SOURCE);
-        cairo_rectangle(rendering_context, 0, 0, overlay_width, overlay_height);
-        cairo_fill(rendering_context);
-
-        //  Draw a top rectangle in toggling color
-        draw_rectangle(rendering_context, 0, 0, overlay_width, overlay_height / 4, top_color, 9.6);
-
-        //  Draw a bottom rectangle in toggling color
-        draw_rectangle(rendering_context,
-                       0,
-                       overlay_height * 3 / 4,
-                       overlay_width,
-                       overlay_height,
-                       bottom_color,
-                       2.0);
+        overlay_scene_render(box_scene,
+                             rendering_context,
+                             stream->id,
+                             overlay_width,
+                             overlay_height,
+                             stream->rotation);
     } else if (id == overlay_id_text) {
-        //  Show text in black
-        draw_text(rendering_context, overlay_width / 2, overlay_height / 2);
+        overlay_scene_render(text_scene,
+                             rendering_context,
+                             stream->id,
+                             overlay_width,
+                             overlay_height,
+                             stream->rotation);
     } else {
         syslog(LOG_INFO, "Unknown overlay id!");
     }
@@ -302,7 +247,8 @@ static void render_overlay_cb(gpointer rendering_context,
  * brief Callback function which is called when animation timer has elapsed.
  *
  * This function is called when the animation timer has elapsed, which will
- * update the counter, colors and also trigger a redraw of the overlay.
+ * update the counter, colors and also trigger a redraw of the overlay, if
+ * anything in the scenes changed.
  *
  * param user_data Optional callback user data.
  */
@@ -311,6 +257,7 @@ static gboolean update_overlay_cb(gpointer user_data) {
     (void)user_data;
 
     GError* error = NULL;
+    gchar* str    = NULL;
 
     // Countdown
     counter = counter < 1 ? 10 : counter - 1;
@@ -321,7 +268,23 @@ static gboolean update_overlay_cb(gpointer user_data) {
         bottom_color = bottom_color > 2 ? 1 : bottom_color + 1;
     }
 
-    // Request a redraw of the overlay
+    // Update the scenes, only the items whose values differ are marked as changed
+    overlay_scene_set_color(box_scene, top_rect, top_color);
+    overlay_scene_set_color(box_scene, bottom_rect, bottom_color);
+    str = g_strdup_printf("Countdown %i", counter);
+    overlay_scene_set_text(text_scene, countdown_text, str);
+    g_free(str);
+
+    if (box_scene->generation == redrawn_box_generation &&
+        text_scene->generation == redrawn_text_generation) {
+        return G_SOURCE_CONTINUE;
+    }
+    redrawn_box_generation  = box_scene->generation;
+    redrawn_text_generation = text_scene->generation;
+
+    // Request a redraw of the overlay, which renders it on every open stream
+    overlay_scene_begin_redraw(box_scene);
+    overlay_scene_begin_redraw(text_scene);
     axoverlay_redraw(&error);
     if (error != NULL) {
         /*
@@ -376,6 +339,9 @@ int main(void) {
         return 1;
     }
 
+    //  Setup the scenes before the first render
+    setup_scenes();
+
     //  Initialize the library
     struct axoverlay_settings settings;
     axoverlay_init_axoverlay_settings(&settings);
@@ -478,6 +444,20 @@ int main(void) {
     // Release the animation timer
     g_source_remove(animation_timer);
 
+    // Release the scenes
+    syslog(LOG_INFO,
+           "Box overlay renders: %" G_GUINT64_FORMAT " full, %" G_GUINT64_FORMAT
+           " partial, %" G_GUINT64_FORMAT " skipped",
+           box_scene->full_renders,
+           box_scene->partial_renders,
+           box_scene->skipped_renders);
+    syslog(LOG_INFO,
+           "Text overlay layers: %" G_GUINT64_FORMAT " drawn, %" G_GUINT64_FORMAT " reused",
+           text_scene->layer_renders,
+           text_scene->layer_hits);
+    overlay_scene_free(box_scene);
+    overlay_scene_free(text_scene);
+
     // Release main loop
     g_main_loop_unref(loop);
 
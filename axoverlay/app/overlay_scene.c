@@ -0,0 +1,556 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "overlay_scene.h"
+
+#include <math.h>
+
+#define PALETTE_VALUE_RANGE 255.0
+// Transparent margin around a rasterized text, for glyphs that reach outside their extents
+#define TEXT_MARGIN 2
+
+typedef struct {
+    cairo_surface_t* surface;
+    // From the pen position on the baseline to the top left corner of the surface
+    gint offset_x;
+    gint offset_y;
+    // Width of the inked text, used to center it
+    gdouble width;
+} text_surface;
+
+typedef struct {
+    guint generation;
+    cairo_rectangle_int_t bounds;
+} drawn_item;
+
+// What was drawn on a stream or a layer
+typedef struct {
+    gint width;
+    gint height;
+    // What each item was drawn as, indexed as the items of the scene
+    GArray* drawn;
+    // Redraw of the scene the stream was last rendered in
+    guint64 last_redraw;
+} drawn_state;
+
+// The scene rendered at one overlay size and rotation, shared by all streams of that size
+typedef struct {
+    drawn_state state;
+    cairo_surface_t* surface;
+    guint64 last_used;
+} render_layer;
+
+/**
+ * brief Converts palette color index to cairo color value.
+ *
+ * param color_index Index in the palette setup.
+ * return color value.
+ */
+static gdouble index2cairo(const gint color_index) {
+    return ((color_index << 4) + color_index) / PALETTE_VALUE_RANGE;
+}
+
+static void select_font(cairo_t* context, gdouble font_size) {
+    cairo_select_font_face(context, "serif", CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_BOLD);
+    cairo_set_font_size(context, font_size);
+}
+
+/**
+ * brief Measure a text without drawing it.
+ *
+ * param text Text to measure.
+ * param font_size Font size in pixels.
+ * param font_extents Set to the extents of the font.
+ * param text_extents Set to the extents of the text.
+ */
+static void measure_text(const gchar* text,
+                         gdouble font_size,
+                         cairo_font_extents_t* font_extents,
+                         cairo_text_extents_t* text_extents) {
+    cairo_surface_t* scratch = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, 1, 1);
+    cairo_t* context         = cairo_create(scratch);
+
+    select_font(context, font_size);
+    cairo_font_extents(context, font_extents);
+    cairo_text_extents(context, text, text_extents);
+
+    cairo_destroy(context);
+    cairo_surface_destroy(scratch);
+}
+
+/**
+ * brief Get the rasterized surface of a text, rasterizing it the first time.
+ *
+ * param scene Scene that keeps the surfaces.
+ * param text Text to get.
+ * param font_size Font size in pixels.
+ * return The surface, owned by the scene.
+ */
+static const text_surface* get_text_surface(overlay_scene* scene,
+                                            const gchar* text,
+                                            gdouble font_size) {
+    gchar* key           = g_strdup_printf("%g:%s", font_size, text);
+    text_surface* cached = g_hash_table_lookup(scene->text_surfaces, key);
+    cairo_font_extents_t font_extents;
+    cairo_text_extents_t text_extents;
+    cairo_t* context;
+    gint width;
+    gint height;
+    gint ascent;
+
+    if (cached) {
+        g_free(key);
+        return cached;
+    }
+
+    measure_text(text, font_size, &font_extents, &text_extents);
+    ascent = (gint)ceil(font_extents.ascent);
+    width  = (gint)ceil(MAX(text_extents.x_advance, text_extents.x_bearing + text_extents.width)) +
+            2 * TEXT_MARGIN;
+    height = ascent + (gint)ceil(font_extents.descent) + 2 * TEXT_MARGIN;
+
+    cached           = g_new0(text_surface, 1);
+    cached->surface  = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+    cached->offset_x = -TEXT_MARGIN;
+    cached->offset_y = -(TEXT_MARGIN + ascent);
+    cached->width    = text_extents.width;
+
+    //  Show text in black
+    context = cairo_create(cached->surface);
+    select_font(context, font_size);
+    cairo_set_source_rgb(context, 0, 0, 0);
+    cairo_move_to(context, TEXT_MARGIN, TEXT_MARGIN + ascent);
+    cairo_show_text(context, text);
+    cairo_destroy(context);
+
+    g_hash_table_insert(scene->text_surfaces, key, cached);
+    return cached;
+}
+
+static void free_text_surface(gpointer data) {
+    text_surface* cached = data;
+    cairo_surface_destroy(cached->surface);
+    g_free(cached);
+}
+
+static void free_stream_state(gpointer data) {
+    drawn_state* state = data;
+    g_array_free(state->drawn, TRUE);
+    g_free(state);
+}
+
+static void free_layer(gpointer data) {
+    render_layer* layer = data;
+    g_array_free(layer->state.drawn, TRUE);
+    cairo_surface_destroy(layer->surface);
+    g_free(layer);
+}
+
+/**
+ * brief Get the pixel bounds of an item on an overlay, and where to draw a text.
+ *
+ * param scene Scene of the item.
+ * param item Item to get the bounds of.
+ * param width Overlay width.
+ * param height Overlay height.
+ * param bounds Set to the bounds, all pixels the item may touch.
+ * return The text surface of a text item, NULL for a rectangle.
+ */
+static const text_surface* item_bounds(overlay_scene* scene,
+                                       const overlay_item* item,
+                                       gint width,
+                                       gint height,
+                                       cairo_rectangle_int_t* bounds) {
+    const text_surface* cached;
+    gdouble centering_width;
+    gint pen_x;
+    gint pen_y;
+
+    if (item->type == OVERLAY_ITEM_RECT) {
+        // The line is stroked centered on the edges
+        gint half_line = (gint)ceil(item->line_width / 2) + 1;
+        bounds->x      = (gint)floor(item->x1 * width) - half_line;
+        bounds->y      = (gint)floor(item->y1 * height) - half_line;
+        bounds->width  = (gint)ceil(item->x2 * width) + half_line - bounds->x;
+        bounds->height = (gint)ceil(item->y2 * height) + half_line - bounds->y;
+        return NULL;
+    }
+
+    // Texts are placed on whole pixels, so the surface is painted without resampling
+    cached          = get_text_surface(scene, item->text, item->font_size);
+    centering_width = item->anchor_width > 0 ? item->anchor_width : cached->width;
+    pen_x           = (gint)round(item->x1 * width - centering_width / 2);
+    pen_y           = (gint)round(item->y1 * height);
+    bounds->x       = pen_x + cached->offset_x;
+    bounds->y       = pen_y + cached->offset_y;
+    bounds->width   = cairo_image_surface_get_width(cached->surface);
+    bounds->height  = cairo_image_surface_get_height(cached->surface);
+    return cached;
+}
+
+static void draw_item(cairo_t* context,
+                      const overlay_item* item,
+                      const text_surface* cached,
+                      const cairo_rectangle_int_t* bounds,
+                      gint width,
+                      gint height) {
+    gdouble val;
+
+    if (item->type == OVERLAY_ITEM_TEXT) {
+        cairo_set_operator(context, CAIRO_OPERATOR_OVER);
+        cairo_set_source_surface(context, cached->surface, bounds->x, bounds->y);
+        cairo_paint(context);
+        return;
+    }
+
+    val = index2cairo(item->color_index);
+    cairo_set_source_rgba(context, val, val, val, val);
+    cairo_set_operator(context, CAIRO_OPERATOR_SOURCE);
+    cairo_set_line_width(context, item->line_width);
+    cairo_rectangle(context,
+                    item->x1 * width,
+                    item->y1 * height,
+                    (item->x2 - item->x1) * width,
+                    (item->y2 - item->y1) * height);
+    cairo_stroke(context);
+}
+
+static overlay_item* add_item(overlay_scene* scene, overlay_item_type type) {
+    overlay_item* item;
+
+    g_array_set_size(scene->items, scene->items->len + 1);
+    item             = &g_array_index(scene->items, overlay_item, scene->items->len - 1);
+    item->type       = type;
+    item->generation = ++scene->generation;
+    return item;
+}
+
+static void mark_changed(overlay_scene* scene, overlay_item* item) {
+    item->generation = ++scene->generation;
+}
+
+overlay_scene* overlay_scene_new(guint max_layers) {
+    overlay_scene* scene = g_new0(overlay_scene, 1);
+
+    scene->max_layers = max_layers;
+    scene->items = g_array_new(FALSE, TRUE, sizeof(overlay_item));
+    scene->text_surfaces =
+        g_hash_table_new_full(g_str_hash, g_str_equal, g_free, free_text_surface);
+    scene->streams = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, free_stream_state);
+    scene->layers  = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, free_layer);
+    return scene;
+}
+
+void overlay_scene_free(overlay_scene* scene) {
+    guint i;
+
+    if (!scene) {
+        return;
+    }
+
+    for (i = 0; i < scene->items->len; i++) {
+        g_free(g_array_index(scene->items, overlay_item, i).text);
+    }
+    g_array_free(scene->items, TRUE);
+    g_hash_table_destroy(scene->text_surfaces);
+    g_hash_table_destroy(scene->streams);
+    g_hash_table_destroy(scene->layers);
+    g_free(scene);
+}
+
+guint overlay_scene_add_rect(overlay_scene* scene,
+                             gdouble x1,
+                             gdouble y1,
+                             gdouble x2,
+                             gdouble y2,
+                             gint color_index,
+                             gdouble line_width) {
+    overlay_item* item = add_item(scene, OVERLAY_ITEM_RECT);
+
+    item->x1          = x1;
+    item->y1          = y1;
+    item->x2          = x2;
+    item->y2          = y2;
+    item->color_index = color_index;
+    item->line_width  = line_width;
+    return scene->items->len - 1;
+}
+
+guint overlay_scene_add_text(overlay_scene* scene,
+                             gdouble x,
+                             gdouble y,
+                             gdouble font_size,
+                             const gchar* anchor_text,
+                             const gchar* text) {
+    overlay_item* item = add_item(scene, OVERLAY_ITEM_TEXT);
+
+    item->x1        = x;
+    item->y1        = y;
+    item->x2        = x;
+    item->y2        = y;
+    item->font_size = font_size;
+    item->text      = g_strdup(text);
+    if (anchor_text) {
+        cairo_font_extents_t font_extents;
+        cairo_text_extents_t text_extents;
+        measure_text(anchor_text, font_size, &font_extents, &text_extents);
+        item->anchor_width = text_extents.width;
+    }
+    return scene->items->len - 1;
+}
+
+void overlay_scene_set_color(overlay_scene* scene, guint item, gint color_index) {
+    overlay_item* changed = &g_array_index(scene->items, overlay_item, item);
+
+    if (changed->color_index != color_index) {
+        changed->color_index = color_index;
+        mark_changed(scene, changed);
+    }
+}
+
+void overlay_scene_set_text(overlay_scene* scene, guint item, const gchar* text) {
+    overlay_item* changed = &g_array_index(scene->items, overlay_item, item);
+
+    if (g_strcmp0(changed->text, text) != 0) {
+        g_free(changed->text);
+        changed->text = g_strdup(text);
+        mark_changed(scene, changed);
+    }
+}
+
+/**
+ * brief Get the region that has changed since a stream or layer was drawn.
+ *
+ * The region covers the changed items, both where they were drawn and where
+ * they are now, or the whole overlay if nothing that was drawn can be kept.
+ * The state is then updated to what is drawn once the region is redrawn.
+ *
+ * param scene Scene that is drawn.
+ * param state What was drawn.
+ * param bounds Current bounds of the items.
+ * param width Overlay width.
+ * param height Overlay height.
+ * param full Set to TRUE if the whole overlay is dirty.
+ * return The dirty region, to be destroyed by the caller.
+ */
+static cairo_region_t* take_dirty_region(overlay_scene* scene,
+                                         drawn_state* state,
+                                         const cairo_rectangle_int_t* bounds,
+                                         gint width,
+                                         gint height,
+                                         gboolean* full) {
+    cairo_rectangle_int_t overlay = {0, 0, width, height};
+    cairo_region_t* dirty         = cairo_region_create();
+    guint i;
+
+    // A new stream or layer, or one whose overlay was resized, has nothing drawn that can be kept
+    *full = state->width != width || state->height != height;
+    if (*full) {
+        state->width  = width;
+        state->height = height;
+        cairo_region_union_rectangle(dirty, &overlay);
+    }
+    g_array_set_size(state->drawn, scene->items->len);
+
+    for (i = 0; i < scene->items->len; i++) {
+        const overlay_item* item = &g_array_index(scene->items, overlay_item, i);
+        drawn_item* drawn        = &g_array_index(state->drawn, drawn_item, i);
+
+        if (!*full && drawn->generation != item->generation) {
+            cairo_region_union_rectangle(dirty, &drawn->bounds);
+            cairo_region_union_rectangle(dirty, &bounds[i]);
+        }
+        drawn->generation = item->generation;
+        drawn->bounds     = bounds[i];
+    }
+    cairo_region_intersect_rectangle(dirty, &overlay);
+    return dirty;
+}
+
+static void clip_to_region(cairo_t* context, const cairo_region_t* region) {
+    gint i;
+
+    for (i = 0; i < cairo_region_num_rectangles(region); i++) {
+        cairo_rectangle_int_t rect;
+        cairo_region_get_rectangle(region, i, &rect);
+        cairo_rectangle(context, rect.x, rect.y, rect.width, rect.height);
+    }
+    cairo_clip(context);
+}
+
+/**
+ * brief Clear and redraw the items inside a region.
+ */
+static void draw_region(overlay_scene* scene,
+                        cairo_t* context,
+                        const cairo_region_t* dirty,
+                        const cairo_rectangle_int_t* bounds,
+                        const text_surface** texts,
+                        gint width,
+                        gint height) {
+    guint i;
+
+    cairo_save(context);
+    clip_to_region(context, dirty);
+    cairo_set_operator(context, CAIRO_OPERATOR_CLEAR);
+    cairo_paint(context);
+    for (i = 0; i < scene->items->len; i++) {
+        if (cairo_region_contains_rectangle(dirty, &bounds[i]) != CAIRO_REGION_OVERLAP_OUT) {
+            draw_item(context,
+                      &g_array_index(scene->items, overlay_item, i),
+                      texts[i],
+                      &bounds[i],
+                      width,
+                      height);
+        }
+    }
+    cairo_restore(context);
+}
+
+/**
+ * brief Get the layer of an overlay size and rotation, creating it the first time.
+ *
+ * When the scene already has max_layers layers, the least recently used one
+ * is dropped.
+ *
+ * param scene Scene of the layers.
+ * param context Cairo rendering context of the overlay, whose format the layer gets.
+ * param width Overlay width.
+ * param height Overlay height.
+ * param rotation Stream rotation.
+ * return The layer, owned by the scene.
+ */
+static render_layer*
+get_layer(overlay_scene* scene, cairo_t* context, gint width, gint height, gint rotation) {
+    cairo_surface_t* target = cairo_get_target(context);
+    cairo_format_t format   = cairo_image_surface_get_format(target);
+    gchar* key              = g_strdup_printf("%ix%i@%i/%i", width, height, rotation, format);
+    render_layer* layer     = g_hash_table_lookup(scene->layers, key);
+
+    if (layer) {
+        g_free(key);
+    } else {
+        if (g_hash_table_size(scene->layers) >= scene->max_layers) {
+            GHashTableIter iter;
+            gpointer lru_key = NULL;
+            gpointer iter_key;
+            gpointer value;
+            guint64 oldest = G_MAXUINT64;
+
+            g_hash_table_iter_init(&iter, scene->layers);
+            while (g_hash_table_iter_next(&iter, &iter_key, &value)) {
+                if (((render_layer*)value)->last_used < oldest) {
+                    oldest  = ((render_layer*)value)->last_used;
+                    lru_key = iter_key;
+                }
+            }
+            g_hash_table_remove(scene->layers, lru_key);
+        }
+
+        layer              = g_new0(render_layer, 1);
+        layer->surface     = cairo_surface_create_similar_image(target, format, width, height);
+        layer->state.drawn = g_array_new(FALSE, TRUE, sizeof(drawn_item));
+        g_hash_table_insert(scene->layers, key, layer);
+    }
+    layer->last_used = ++scene->layer_uses;
+    return layer;
+}
+
+static gboolean is_closed_stream(gpointer key, gpointer value, gpointer user_data) {
+    const drawn_state* state   = value;
+    const overlay_scene* scene = user_data;
+    (void)key;
+
+    return state->last_redraw < scene->redraws;
+}
+
+void overlay_scene_begin_redraw(overlay_scene* scene) {
+    g_hash_table_foreach_remove(scene->streams, is_closed_stream, scene);
+    scene->redraws++;
+}
+
+gboolean overlay_scene_render(overlay_scene* scene,
+                              cairo_t* context,
+                              gint stream_id,
+                              gint width,
+                              gint height,
+                              gint rotation) {
+    drawn_state* state = g_hash_table_lookup(scene->streams, GINT_TO_POINTER(stream_id));
+    cairo_rectangle_int_t* bounds;
+    const text_surface** texts;
+    cairo_region_t* dirty;
+    gboolean full = FALSE;
+    gboolean drew = FALSE;
+    guint i;
+
+    if (!state) {
+        state        = g_new0(drawn_state, 1);
+        state->drawn = g_array_new(FALSE, TRUE, sizeof(drawn_item));
+        g_hash_table_insert(scene->streams, GINT_TO_POINTER(stream_id), state);
+    }
+    state->last_redraw = scene->redraws;
+
+    bounds = g_new(cairo_rectangle_int_t, scene->items->len);
+    texts  = g_new(const text_surface*, scene->items->len);
+    for (i = 0; i < scene->items->len; i++) {
+        texts[i] = item_bounds(scene,
+                               &g_array_index(scene->items, overlay_item, i),
+                               width,
+                               height,
+                               &bounds[i]);
+    }
+
+    dirty = take_dirty_region(scene, state, bounds, width, height, &full);
+    drew  = !cairo_region_is_empty(dirty);
+    if (!drew) {
+        scene->skipped_renders++;
+    } else if (scene->max_layers == 0) {
+        draw_region(scene, context, dirty, bounds, texts, width, height);
+    } else {
+        // The layer is brought up to date once per change, then copied to every stream of its size
+        render_layer* layer = get_layer(scene, context, width, height, rotation);
+        gboolean layer_full = FALSE;
+        cairo_region_t* stale =
+            take_dirty_region(scene, &layer->state, bounds, width, height, &layer_full);
+        if (cairo_region_is_empty(stale)) {
+            scene->layer_hits++;
+        } else {
+            cairo_t* layer_context = cairo_create(layer->surface);
+            draw_region(scene, layer_context, stale, bounds, texts, width, height);
+            cairo_destroy(layer_context);
+            scene->layer_renders++;
+        }
+        cairo_region_destroy(stale);
+
+        cairo_save(context);
+        clip_to_region(context, dirty);
+        cairo_set_operator(context, CAIRO_OPERATOR_SOURCE);
+        cairo_set_source_surface(context, layer->surface, 0, 0);
+        cairo_paint(context);
+        cairo_restore(context);
+    }
+    if (drew && full) {
+        scene->full_renders++;
+    } else if (drew) {
+        scene->partial_renders++;
+    }
+
+    cairo_region_destroy(dirty);
+    g_free(texts);
+    g_free(bounds);
+    return drew;
+}
@@ -0,0 +1,197 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/**
+ * brief A retained scene of the items of an overlay, drawn incrementally.
+ *
+ * The items, rectangles and texts, are kept in the scene in normalized
+ * coordinates, and changing an item marks it as changed. When the overlay of
+ * a stream is rendered, only the region covered by the changed items, where
+ * they were drawn before and where they are now, is cleared and redrawn. An
+ * overlay where nothing has changed is not drawn at all.
+ *
+ * This relies on the overlay buffer of a stream keeping its content between
+ * two renders. A stream that is rendered for the first time, or with another
+ * overlay size than before, is drawn in full.
+ *
+ * Streams of the same overlay size and rotation show the same content, so the
+ * scene can be rendered into a layer per size and rotation, which is brought
+ * up to date once per change. The dirty region of each stream is then copied
+ * from its layer instead of being drawn again. Every layer holds a surface of
+ * the full overlay size, so the number of layers is limited and the least
+ * recently used one is dropped.
+ *
+ * The texts are rasterized once into surfaces that are kept in the scene, so
+ * a text that is shown again is painted from its surface instead of being
+ * laid out and rasterized again. The surfaces are kept as long as the scene,
+ * which suits texts from a small set, like the countdown of the example.
+ *
+ * axoverlay does not tell when a stream is closed, so what was drawn on a
+ * stream is dropped when the stream is not rendered in a redraw.
+ */
+
+#pragma once
+
+#include <cairo/cairo.h>
+#include <glib.h>
+
+typedef enum { OVERLAY_ITEM_RECT, OVERLAY_ITEM_TEXT } overlay_item_type;
+
+/**
+ * brief An item of the scene.
+ */
+typedef struct {
+    overlay_item_type type;
+    // Rectangle corners, or the center of a text, normalized to the overlay
+    gdouble x1;
+    gdouble y1;
+    gdouble x2;
+    gdouble y2;
+    // Palette color index and line width of a rectangle
+    gint color_index;
+    gdouble line_width;
+    // Text, drawn in black
+    gchar* text;
+    gdouble font_size;
+    // Width that centers the text, measured on the anchor text, or 0 to center the text itself
+    gdouble anchor_width;
+    // Generation of the scene when the item was last changed
+    guint generation;
+} overlay_item;
+
+typedef struct {
+    // Items in drawing order
+    GArray* items;
+    guint generation;
+    // Rasterized texts, keyed by font size and text
+    GHashTable* text_surfaces;
+    // What was drawn on each stream, keyed by stream id
+    GHashTable* streams;
+    // Redraws begun, a stream not rendered since the previous one is dropped
+    guint64 redraws;
+    // Rendered layers, keyed by overlay size, rotation and format
+    GHashTable* layers;
+    guint max_layers;
+    guint64 layer_uses;
+    guint64 full_renders;
+    guint64 partial_renders;
+    guint64 skipped_renders;
+    // Streams that copied an up to date layer, and layers that were drawn
+    guint64 layer_hits;
+    guint64 layer_renders;
+} overlay_scene;
+
+/**
+ * brief Create an empty scene.
+ *
+ * param max_layers Maximum number of rendered layers kept, 0 to draw on each stream directly.
+ * return The scene.
+ */
+overlay_scene* overlay_scene_new(guint max_layers);
+
+/**
+ * brief Free the scene, its items and all cached text surfaces.
+ *
+ * param scene Scene to free.
+ */
+void overlay_scene_free(overlay_scene* scene);
+
+/**
+ * brief Add a rectangle outline.
+ *
+ * param scene Scene to add to.
+ * param x1 Left edge, normalized.
+ * param y1 Top edge, normalized.
+ * param x2 Right edge, normalized.
+ * param y2 Bottom edge, normalized.
+ * param color_index Palette color index.
+ * param line_width Line width in pixels.
+ * return Index of the item.
+ */
+guint overlay_scene_add_rect(overlay_scene* scene,
+                             gdouble x1,
+                             gdouble y1,
+                             gdouble x2,
+                             gdouble y2,
+                             gint color_index,
+                             gdouble line_width);
+
+/**
+ * brief Add a text.
+ *
+ * param scene Scene to add to.
+ * param x Horizontal center, normalized.
+ * param y Baseline, normalized.
+ * param font_size Font size in pixels.
+ * param anchor_text Text whose width centers the text, so texts of different widths start at
+ *        the same position, or NULL to center each text.
+ * param text Text to show.
+ * return Index of the item.
+ */
+guint overlay_scene_add_text(overlay_scene* scene,
+                             gdouble x,
+                             gdouble y,
+                             gdouble font_size,
+                             const gchar* anchor_text,
+                             const gchar* text);
+
+/**
+ * brief Change the color of a rectangle, the item is only marked as changed if it differs.
+ *
+ * param scene Scene of the item.
+ * param item Index of the item.
+ * param color_index Palette color index.
+ */
+void overlay_scene_set_color(overlay_scene* scene, guint item, gint color_index);
+
+/**
+ * brief Change the text of a text item, the item is only marked as changed if it differs.
+ *
+ * param scene Scene of the item.
+ * param item Index of the item.
+ * param text Text to show.
+ */
+void overlay_scene_set_text(overlay_scene* scene, guint item, const gchar* text);
+
+/**
+ * brief Start a redraw, call before axoverlay_redraw().
+ *
+ * Every open stream is rendered in a redraw, so the streams that were not
+ * rendered since the previous redraw are closed and what was drawn on them is
+ * dropped. A stream that shows up again is drawn in full.
+ *
+ * param scene Scene to redraw.
+ */
+void overlay_scene_begin_redraw(overlay_scene* scene);
+
+/**
+ * brief Render the changes of the scene since it was last rendered on a stream.
+ *
+ * param scene Scene to render.
+ * param context Cairo rendering context of the overlay.
+ * param stream_id Id of the rendered stream.
+ * param width Overlay width.
+ * param height Overlay height.
+ * param rotation Stream rotation.
+ * return TRUE if anything was drawn.
+ */
+gboolean overlay_scene_render(overlay_scene* scene,
+                              cairo_t* context,
+                              gint stream_id,
+                              gint width,
+                              gint height,
+                              gint rotation);
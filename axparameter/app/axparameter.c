@@ -19,7 +19,8 @@
  *
  * This example shows how to handle system-wide and application-defined parameters using the
  * AXParameter library. Emphasis has been put on the use of callback functions and some of the
- * limitations they impose.
+ * limitations they impose. The values of the application's parameters are read once and then kept
+ * up to date by the callback, so they can be read without a D-Bus call to the parameter service.
  */
 #include <axsdk/axparameter.h>
 #include <glib-unix.h>
@@ -28,9 +29,16 @@
 
 #define APP_NAME "axparameter"
 
+// The AXParameter handle and the cached values of the application's parameters.
+// The values are only accessed from the GLib main loop, so no locking is needed.
+struct app {
+    AXParameter* handle;
+    GHashTable* values;
+};
+
 // Structure used for passing data to the monitor_parameters() callback.
 struct message {
-    AXParameter* handle;
+    struct app* app;
     char* name;
     char* value;
 };
@@ -51,97 +59,90 @@ panic(const char* format, ...) {
     exit(1);
 }
 
-// Iterate over all parameters in search for a specific one.
-// An alternative would be to call ax_parameter_get() test if it succeeds or fails.
-static bool has_parameter(AXParameter* handle, const char* needle) {
+// Read the values of all parameters once, the cache is then kept up to date by the callbacks and
+// by the functions below that add, set or remove parameters.
+static void load_values(struct app* app) {
     GError* error = NULL;
-    GList* list   = ax_parameter_list(handle, &error);
-    if (!list)
+    GList* list   = ax_parameter_list(app->handle, &error);
+    if (!list && error)
         panic("%s", error->message);
 
-    bool needle_found = false;
     for (GList* x = list; x != NULL; x = g_list_next(x)) {
+        gchar* value;
+        if (!ax_parameter_get(app->handle, x->data, &value, &error))
+            panic("%s", error->message);
         syslog(LOG_INFO, "App has a parameter named %s", (gchar*)x->data);
-        if (strcmp(x->data, needle) == 0)
-            needle_found = true;
-        g_free(x->data);
+        // The cache takes ownership of the name and the value
+        g_hash_table_insert(app->values, x->data, value);
     }
     g_list_free(list);
+}
+
+// Look for a specific parameter among the cached ones.
+// An alternative would be to call ax_parameter_list() and search the list, at the cost of a D-Bus
+// call for every check.
+static bool has_parameter(struct app* app, const char* needle) {
+    bool needle_found = g_hash_table_contains(app->values, needle);
     syslog(LOG_INFO, "Parameter %s %s found", needle, needle_found ? "was" : "was not");
     return needle_found;
 }
 
 // A parameter of type "bool:no,yes" is guaranteed to contain one of those strings,
 // but user code is still needed to interpret it as a Boolean type.
-static bool is_parameter_yes(AXParameter* handle, const char* name) {
-    GError* error = NULL;
-    gchar* value;
-
-    if (!ax_parameter_get(handle, name, &value, &error))
-        panic("%s", error->message);
-
-    bool result = strcmp(value, "yes") == 0;
-
-    g_free(value);
-    return result;
+static bool is_parameter_yes(struct app* app, const char* name) {
+    return g_strcmp0(g_hash_table_lookup(app->values, name), "yes") == 0;
 }
 
 // Instead of specifying parameters in manifest.json, they can be added at runtime.
-static void restore_custom_value_from_backup(AXParameter* handle) {
-    GError* error = NULL;
-    gchar* value;
+static void restore_custom_value_from_backup(struct app* app) {
+    GError* error      = NULL;
+    const gchar* value = g_hash_table_lookup(app->values, "BackupValue");
 
-    if (!ax_parameter_get(handle, "BackupValue", &value, &error) ||
-        !ax_parameter_add(handle, "CustomValue", value, NULL, &error))
+    if (!ax_parameter_add(app->handle, "CustomValue", value, NULL, &error))
         panic("%s", error->message);
+    g_hash_table_insert(app->values, g_strdup("CustomValue"), g_strdup(value));
 
     syslog(LOG_INFO,
            "The parameter CustomValue was added, "
            "but won't be visible in the Settings page until the Apps page is reloaded.");
-
-    g_free(value);
 }
 
 // Parameters can also be removed at runtime.
-static void back_up_and_remove_custom_value(AXParameter* handle) {
+static void back_up_and_remove_custom_value(struct app* app) {
     GError* error = NULL;
-    gchar* value;
+    gchar* value  = g_strdup(g_hash_table_lookup(app->values, "CustomValue"));
 
-    if (!ax_parameter_get(handle, "CustomValue", &value, &error) ||
-        !ax_parameter_set(handle, "BackupValue", value, TRUE, &error) ||
-        !ax_parameter_remove(handle, "CustomValue", &error))
+    if (!ax_parameter_set(app->handle, "BackupValue", value, TRUE, &error) ||
+        !ax_parameter_remove(app->handle, "CustomValue", &error))
         panic("%s", error->message);
+    g_hash_table_insert(app->values, g_strdup("BackupValue"), value);
+    g_hash_table_remove(app->values, "CustomValue");
 
     syslog(LOG_INFO,
            "The parameter CustomValue was removed, "
            "but will be visible in the Settings page until the Apps page is reloaded.");
-
-    g_free(value);
 }
 
 // This function is registered as a callback from g_timeout_add_seconds(),
 // which means it can call ax_parameter_* functions without causing a deadlock.
 static gboolean monitor_parameters(void* msg_void_ptr) {
-    GError* error       = NULL;
     struct message* msg = msg_void_ptr;
-    AXParameter* handle = msg->handle;
+    struct app* app     = msg->app;
 
     syslog(LOG_INFO, "%s was changed to '%s' one second ago", msg->name, msg->value);
 
-    bool has_custom_value_param = has_parameter(handle, "CustomValue");
+    bool has_custom_value_param = has_parameter(app, "CustomValue");
 
-    if (is_parameter_yes(handle, "IsCustomized")) {
+    if (is_parameter_yes(app, "IsCustomized")) {
         if (!has_custom_value_param)
-            restore_custom_value_from_backup(handle);
+            restore_custom_value_from_backup(app);
 
-        gchar* custom_value;
-        if (!ax_parameter_get(handle, "CustomValue", &custom_value, &error))
-            panic("%s", error->message);
-        syslog(LOG_INFO, "Custom value: '%s'", custom_value);
-        g_free(custom_value);
+        syslog(LOG_INFO,
+               "Custom value: '%s'",
+               (gchar*)g_hash_table_lookup(app->values, "CustomValue"));
     } else {
         if (has_custom_value_param)
-            back_up_and_remove_custom_value(handle);
+            back_up_and_remove_custom_value(app);
 
         syslog(LOG_INFO, "Not customized");
     }
@@ -155,10 +156,15 @@ static gboolean monitor_parameters(void* msg_void_ptr) {
 
 // This function is registered as a callback using ax_parameter_register_callback().
 // It must not call any ax_parameter_* functions, since that would cause a deadlock.
-static void parameter_changed(const gchar* name, const gchar* value, gpointer handle_void_ptr) {
+static void parameter_changed(const gchar* name, const gchar* value, gpointer app_void_ptr) {
+    struct app* app                     = app_void_ptr;
     const char* name_without_qualifiers = &name[strlen("root." APP_NAME ".")];
     syslog(LOG_INFO, "%s was changed to '%s' just now", name_without_qualifiers, value);
 
+    // Updating the cache is fine, it is not part of the AXParameter library. The callback runs on
+    // the GLib main loop, like every other user of the cache.
+    g_hash_table_insert(app->values, g_strdup(name_without_qualifiers), g_strdup(value));
+
     // Schedule a call in one second to a function that is allowed to use ax_parameter_* functions.
     // The strings must be copied, since they are owned by the AXParameter library.
     // The message struct must be dynamically allocated, since there may be more AXParameter
@@ -166,9 +172,9 @@ static void parameter_changed(const gchar* name, const gchar* value, gpointer ha
 
     struct message* msg = malloc(sizeof(struct message));
 
-    msg->handle = handle_void_ptr;
-    msg->name   = strdup(name_without_qualifiers);
-    msg->value  = strdup(value);
+    msg->app   = app;
+    msg->name  = strdup(name_without_qualifiers);
+    msg->value = strdup(value);
 
     g_timeout_add_seconds(1, monitor_parameters, msg);
 }
@@ -183,6 +189,9 @@ int main(void) {
     if (handle == NULL)
         panic("%s", error->message);
 
+    struct app app = {handle, g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free)};
+    load_values(&app);
+
     // Parameters outside the application's group requires qualification.
     gchar* serial_number;
     if (!ax_parameter_get(handle, "Properties.System.SerialNumber", &serial_number, &error))
@@ -191,11 +200,11 @@ int main(void) {
     g_free(serial_number);
 
     // Act on changes to IsCustomized as soon as they happen.
-    if (!ax_parameter_register_callback(handle, "IsCustomized", parameter_changed, handle, &error))
+    if (!ax_parameter_register_callback(handle, "IsCustomized", parameter_changed, &app, &error))
         panic("%s", error->message);
 
     // Register the same callback for CustomValue, even though that parameter does not exist yet!
-    if (!ax_parameter_register_callback(handle, "CustomValue", parameter_changed, handle, &error))
+    if (!ax_parameter_register_callback(handle, "CustomValue", parameter_changed, &app, &error))
         panic("%s", error->message);
 
     // Start listening to callbacks by launching a GLib main loop.
@@ -206,4 +215,5 @@ int main(void) {
 
     g_main_loop_unref(loop);
     ax_parameter_free(handle);
+    g_hash_table_destroy(app.values);
 }
@@ -23,6 +23,8 @@
 /* AX Serial Port library. */
 #include <axsdk/axserialport.h>
 
+#include "serial_protocol.h"
+
 /**
  * MyConfigAndData contains application configuration and data.
  */
@@ -30,6 +32,7 @@ typedef struct MyConfigAndData {
     AXSerialConfig* config;
     GIOChannel* channel;
     GTimer* timer;
+    SerialProtocol* protocol;
     gpointer data;
 } MyConfigAndData;
 
@@ -45,65 +48,23 @@ static gboolean signal_handler(gpointer loop) {
 }
 
 /**
- * @brief Converts a I/O status to a string
- *
- * @param status I/O status of channel
+ * @brief Called by the protocol with each received frame
  *
- * @return Status as string
+ * @param payload Payload of the frame
+ * @param size Size of the payload
+ * @param data Application configuration and data
  */
-static gchar* iostatus2str(GIOStatus status) {
-    switch (status) {
-        case G_IO_STATUS_ERROR:
-            return "G_IO_STATUS_ERROR";
-        case G_IO_STATUS_NORMAL:
-            return "G_IO_STATUS_NORMAL";
-        case G_IO_STATUS_EOF:
-            return "G_IO_STATUS_EOF";
-        case G_IO_STATUS_AGAIN:
-            return "G_IO_STATUS_AGAIN";
-        default:
-            return "Unknown GIOStatus!";
+static void incoming_frame(const guint8* payload, gsize size, gpointer data) {
+    (void)data;
+
+    if (size != 2) {
+        syslog(LOG_WARNING,
+               "%s() frame of %" G_GSIZE_FORMAT " bytes is not a timestamp",
+               __FUNCTION__,
+               size);
+        return;
     }
-}
-
-/**
- * @brief Callback function registered by g_io_add_watch(),
- *        which is triggered to handle incoming serial data
- *
- * @param channel Channel where the communication happened
- * @param cond Condition that was satisfied when calling the function
- * @param data Incoming data
- *
- * @return Result
- */
-static gboolean incoming_data(GIOChannel* channel, GIOCondition cond, gpointer data) {
-    MyConfigAndData* conf_data = data;
-    GIOChannel* iochannel      = conf_data->channel;
-    GError* error              = NULL;
-    GIOStatus ret;
-    gsize bytes_read;
-    gchar timestamp[2];
-    gchar str[128];
-    (void)channel;
-    (void)cond;
-
-    /* We have incoming data, read it! */
-    ret = g_io_channel_read_chars(iochannel, timestamp, sizeof(timestamp), &bytes_read, &error);
-    if (ret == G_IO_STATUS_NORMAL) {
-        /* All OK! write the timestamp to stdout and syslog */
-        guchar min = timestamp[0];
-        guchar sec = timestamp[1];
-        g_snprintf(str, 128, "%s() timestamp: %02u:%02u", __FUNCTION__, min, sec);
-        syslog(LOG_INFO, "%s", str);
-    } else {
-        if (error) { /* Report error */
-            syslog(LOG_ERR, "%s", error->message);
-            g_error_free(error); /* Free error */
-        }
-    }
-
-    /* Return FALSE if the event source should be removed */
-    return TRUE;
+    syslog(LOG_INFO, "%s() timestamp: %02u:%02u", __FUNCTION__, payload[0], payload[1]);
 }
 
 /**
@@ -111,42 +72,24 @@ static gboolean incoming_data(GIOChannel* channel, GIOCondition cond, gpointer d
  *        which is triggered every 10th second and sends out a two
  *        byte timestamp on the serial port
  *
- * @param data The storage to subscribe to its events
+ * @param data Application configuration and data
  *
  * @return Result
  */
 static gboolean send_timer_data(gpointer data) {
     MyConfigAndData* conf_data = data;
-    GIOChannel* iochannel      = conf_data->channel;
     GTimer* timer              = conf_data->timer;
-    GError* error              = NULL;
-    GIOStatus ret;
     gdouble elapsed;
-    gchar min, sec;
-    gsize bytes_written;
-    gchar timestamp[2];
+    guint8 timestamp[2];
 
     /* time in seconds since timer started */
     elapsed      = g_timer_elapsed(timer, NULL);
-    min          = elapsed / 60; /* Wraps 256->0 */
-    sec          = ((guint)elapsed) % 60;
-    timestamp[0] = min;
-    timestamp[1] = sec;
-
-    ret = g_io_channel_write_chars(iochannel, timestamp, sizeof(timestamp), &bytes_written, &error);
-    if (ret == G_IO_STATUS_NORMAL) {
-        /* Flush the write buffer */
-        ret = g_io_channel_flush(iochannel, &error);
-        /* Log the return status from g_io_channel_write_chars() */
-        g_message("%s() wrote %ld bytes, status:'%s'",
-                  __FUNCTION__,
-                  (long int)bytes_written,
-                  iostatus2str(ret));
-    }
+    timestamp[0] = elapsed / 60; /* Wraps 256->0 */
+    timestamp[1] = ((guint)elapsed) % 60;
 
-    if (error) { /* Report to stderr and syslog */
-        syslog(LOG_ERR, "%s", error->message);
-        g_error_free(error); /* Free error */
+    /* Queued, and written with the other frames when the port can take them */
+    if (!serial_protocol_send(conf_data->protocol, timestamp, sizeof(timestamp))) {
+        syslog(LOG_WARNING, "%s() send queue is full", __FUNCTION__);
     }
 
     /* Return FALSE if the event source should be removed */
@@ -155,17 +98,21 @@ static gboolean send_timer_data(gpointer data) {
 
 /**
  * @brief Main function
+ *
+ * @param argc Number of arguments
+ * @param argv The framing "length", "cobs" or "modbus", by default "length"
  */
-int main(void) {
-    gint fd                = 0;
-    gint ret               = 0;
-    gint status            = EXIT_FAILURE;
-    guint port0            = 0;
-    AXSerialConfig* config = NULL;
-    GIOChannel* iochannel  = NULL;
-    GMainLoop* loop        = NULL;
-    GError* error          = NULL;
-    MyConfigAndData conf_data;
+int main(int argc, char** argv) {
+    gint fd                      = 0;
+    gint ret                     = 0;
+    gint status                  = EXIT_FAILURE;
+    guint port0                  = 0;
+    AXSerialConfig* config       = NULL;
+    GIOChannel* iochannel        = NULL;
+    GMainLoop* loop              = NULL;
+    GError* error                = NULL;
+    const SerialFraming* framing = NULL;
+    MyConfigAndData conf_data    = {0};
 
     /* Initialization */
     loop = g_main_loop_new(NULL, FALSE);
@@ -175,6 +122,12 @@ int main(void) {
     /* Print some startup messages */
     syslog(LOG_INFO, "Starting AxSerialPort application");
 
+    framing = serial_framing_find(argc > 1 ? argv[1] : "length");
+    if (!framing) {
+        syslog(LOG_ERR, "Unknown framing %s, use length, cobs or modbus", argv[1]);
+        goto error_out;
+    }
+
     /* Create a configuration for the first port (port0) */
     config = ax_serial_init(port0, &error);
     if (!config) {
@@ -221,13 +174,14 @@ int main(void) {
     conf_data.channel = iochannel;
     conf_data.timer   = g_timer_new(); /* Create and start a timer */
 
-    /* Add a watch that waits for incoming data, then calls 'incoming_data()'
-     * when the conditions are met. */
-    g_io_add_watch(iochannel,     /* GIOChannel */
-                   G_IO_IN,       /* GIOCondition: On incoming data */
-                   incoming_data, /* The function to be called */
-                   &conf_data     /* Data to pass to function */
-    );
+    /* Read and write the frames on the port, calling 'incoming_frame()'
+     * with each frame that is received. */
+    conf_data.protocol =
+        serial_protocol_new(iochannel, framing, incoming_frame, &conf_data, &error);
+    if (!conf_data.protocol) {
+        goto error_out;
+    }
+    syslog(LOG_INFO, "Using the %s framing", framing->name);
 
     /* Periodically call 'send_timer_data()' every 10 seconds */
     g_timeout_add_seconds(10, send_timer_data, &conf_data);
@@ -250,6 +204,9 @@ error_out:
         status = EXIT_FAILURE;
     }
 
+    /* stop the protocol, dropping what is not yet written */
+    serial_protocol_free(conf_data.protocol);
+
     /* close the I/O channel, no flush */
     if (iochannel != NULL) {
         g_io_channel_shutdown(iochannel, FALSE, NULL);
@@ -0,0 +1,129 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "checksum.h"
+
+#if defined(__ARM_FEATURE_CRC32) && !defined(CHECKSUM_SCALAR)
+#include <arm_acle.h>
+#define CHECKSUM_USE_CRC32_INSTRUCTIONS
+#endif
+
+/* Reversed polynomials of the CRCs, which process the low bit first. */
+#define CRC32_POLYNOMIAL        0xedb88320
+#define CRC16_MODBUS_POLYNOMIAL 0xa001
+
+/* table[0] is the CRC of a byte, table[k] of a byte followed by k zero bytes. */
+static guint32 crc32_table[8][256];
+static guint16 crc16_modbus_table[8][256];
+
+static void build_tables(void) {
+    guint i;
+    guint k;
+
+    for (i = 0; i < 256; i++) {
+        guint32 crc32 = i;
+        guint16 crc16 = i;
+
+        for (k = 0; k < 8; k++) {
+            crc32 = crc32 & 1 ? (crc32 >> 1) ^ CRC32_POLYNOMIAL : crc32 >> 1;
+            crc16 = crc16 & 1 ? (crc16 >> 1) ^ CRC16_MODBUS_POLYNOMIAL : crc16 >> 1;
+        }
+        crc32_table[0][i]        = crc32;
+        crc16_modbus_table[0][i] = crc16;
+    }
+    for (k = 1; k < 8; k++) {
+        for (i = 0; i < 256; i++) {
+            guint32 crc32 = crc32_table[k - 1][i];
+            guint16 crc16 = crc16_modbus_table[k - 1][i];
+
+            crc32_table[k][i]        = (crc32 >> 8) ^ crc32_table[0][crc32 & 0xff];
+            crc16_modbus_table[k][i] = (crc16 >> 8) ^ crc16_modbus_table[0][crc16 & 0xff];
+        }
+    }
+}
+
+static void init_tables(void) {
+    static gsize initialized = 0;
+
+    if (g_once_init_enter(&initialized)) {
+        build_tables();
+        g_once_init_leave(&initialized, 1);
+    }
+}
+
+/* Little-endian loads, which compile to single loads where they are allowed. */
+static guint32 load32(const guint8* p) {
+    return (guint32)p[0] | (guint32)p[1] << 8 | (guint32)p[2] << 16 | (guint32)p[3] << 24;
+}
+
+#ifdef CHECKSUM_USE_CRC32_INSTRUCTIONS
+static guint64 load64(const guint8* p) {
+    return (guint64)load32(p) | (guint64)load32(p + 4) << 32;
+}
+
+guint32 checksum_crc32(guint32 crc, const void* data, gsize size) {
+    const guint8* p = data;
+
+    crc = ~crc;
+    for (; size >= 8; size -= 8, p += 8) {
+        crc = __crc32d(crc, load64(p));
+    }
+    for (; size > 0; size--, p++) {
+        crc = __crc32b(crc, *p);
+    }
+    return ~crc;
+}
+#else
+guint32 checksum_crc32(guint32 crc, const void* data, gsize size) {
+    const guint8* p = data;
+
+    init_tables();
+    crc = ~crc;
+    for (; size >= 8; size -= 8, p += 8) {
+        guint32 low  = load32(p) ^ crc;
+        guint32 high = load32(p + 4);
+
+        crc = crc32_table[7][low & 0xff] ^ crc32_table[6][(low >> 8) & 0xff] ^
+              crc32_table[5][(low >> 16) & 0xff] ^ crc32_table[4][low >> 24] ^
+              crc32_table[3][high & 0xff] ^ crc32_table[2][(high >> 8) & 0xff] ^
+              crc32_table[1][(high >> 16) & 0xff] ^ crc32_table[0][high >> 24];
+    }
+    for (; size > 0; size--, p++) {
+        crc = (crc >> 8) ^ crc32_table[0][(crc ^ *p) & 0xff];
+    }
+    return ~crc;
+}
+#endif
+
+guint16 checksum_crc16_modbus(guint16 crc, const void* data, gsize size) {
+    const guint8* p = data;
+
+    init_tables();
+    for (; size >= 8; size -= 8, p += 8) {
+        guint32 low  = load32(p) ^ crc;
+        guint32 high = load32(p + 4);
+
+        crc = crc16_modbus_table[7][low & 0xff] ^ crc16_modbus_table[6][(low >> 8) & 0xff] ^
+              crc16_modbus_table[5][(low >> 16) & 0xff] ^ crc16_modbus_table[4][low >> 24] ^
+              crc16_modbus_table[3][high & 0xff] ^ crc16_modbus_table[2][(high >> 8) & 0xff] ^
+              crc16_modbus_table[1][(high >> 16) & 0xff] ^ crc16_modbus_table[0][high >> 24];
+    }
+    for (; size > 0; size--, p++) {
+        crc = (crc >> 8) ^ crc16_modbus_table[0][(crc ^ *p) & 0xff];
+    }
+    return crc;
+}
@@ -0,0 +1,59 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/**
+ * CRC checksums of data.
+ *
+ * The CRCs are computed eight bytes at a time with slice-by-8 tables, which
+ * are built at the first call. The CRC-32 is computed with the CRC32
+ * instructions of ARMv8 instead when the compiler targets them. Define
+ * CHECKSUM_SCALAR to always use the tables.
+ *
+ * The CRCs of data in parts are computed by passing the CRC of the parts
+ * before to the next call.
+ */
+
+#pragma once
+
+#include <glib.h>
+
+/* The CRC-16 of Modbus starts with all bits set. */
+#define CHECKSUM_CRC16_MODBUS_INIT 0xffff
+
+/**
+ * @brief Update the CRC-32 of data, as of zlib, Ethernet and PNG
+ *
+ * @param crc CRC-32 of the data before, 0 to start
+ * @param data Data to add to the CRC
+ * @param size Number of bytes of data
+ *
+ * @return CRC-32 of the data so far
+ */
+guint32 checksum_crc32(guint32 crc, const void* data, gsize size);
+
+/**
+ * @brief Update the CRC-16 of data, as of Modbus RTU
+ *
+ * The CRC of the data followed by its CRC, low byte first, is 0.
+ *
+ * @param crc CRC-16 of the data before, CHECKSUM_CRC16_MODBUS_INIT to start
+ * @param data Data to add to the CRC
+ * @param size Number of bytes of data
+ *
+ * @return CRC-16 of the data so far
+ */
+guint16 checksum_crc16_modbus(guint16 crc, const void* data, gsize size);
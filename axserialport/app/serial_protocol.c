@@ -0,0 +1,406 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "serial_protocol.h"
+
+#include <errno.h>
+#include <string.h>
+#include <syslog.h>
+#include <unistd.h>
+
+#include "checksum.h"
+
+/* The smallest Modbus RTU frame is an address, a function code and the CRC. */
+#define MODBUS_MIN_FRAME 4
+#define MODBUS_MAX_FRAME 256
+
+static gsize length_prefix_decode(guint8* data,
+                                  gsize size,
+                                  guint8** payload,
+                                  gsize* payload_size) {
+    gsize length;
+
+    if (size < 2) {
+        return 0;
+    }
+    length = (gsize)data[0] << 8 | data[1];
+    if (length > SERIAL_PROTOCOL_MAX_PAYLOAD) {
+        /* Not a length, skip a byte to find the next frame. */
+        *payload = NULL;
+        return 1;
+    }
+    if (size < 2 + length) {
+        return 0;
+    }
+    *payload      = data + 2;
+    *payload_size = length;
+    return 2 + length;
+}
+
+static gsize length_prefix_encode(const guint8* payload, gsize size, guint8* out) {
+    out[0] = size >> 8;
+    out[1] = size & 0xff;
+    memcpy(out + 2, payload, size);
+    return 2 + size;
+}
+
+static gsize length_prefix_max_encoded_size(gsize size) {
+    return 2 + size;
+}
+
+static gsize cobs_max_encoded_size(gsize size) {
+    return size + size / 254 + 2;
+}
+
+static gsize cobs_decode(guint8* data, gsize size, guint8** payload, gsize* payload_size) {
+    guint8* end = memchr(data, 0, size);
+    gsize length;
+    gsize in  = 0;
+    gsize out = 0;
+
+    if (end == NULL) {
+        if (size > cobs_max_encoded_size(SERIAL_PROTOCOL_MAX_PAYLOAD)) {
+            *payload = NULL;
+            return size;
+        }
+        return 0;
+    }
+    length   = end - data;
+    *payload = NULL;
+
+    /* Each code byte is followed by code - 1 bytes, and a zero unless it is 0xff. */
+    while (in < length) {
+        guint8 code = data[in++];
+
+        if (in + code - 1 > length) {
+            return length + 1;
+        }
+        memmove(data + out, data + in, code - 1);
+        out += code - 1;
+        in += code - 1;
+        if (code < 0xff && in < length) {
+            data[out++] = 0;
+        }
+    }
+    if (length > 0 && out <= SERIAL_PROTOCOL_MAX_PAYLOAD) {
+        *payload      = data;
+        *payload_size = out;
+    }
+    return length + 1;
+}
+
+static gsize cobs_encode(const guint8* payload, gsize size, guint8* out) {
+    gsize code_pos = 0;
+    gsize pos      = 1;
+    guint8 code    = 1;
+    gsize i;
+
+    for (i = 0; i < size; i++) {
+        if (payload[i] != 0) {
+            out[pos++] = payload[i];
+            code++;
+        }
+        if (payload[i] == 0 || code == 0xff) {
+            out[code_pos] = code;
+            code_pos      = pos++;
+            code          = 1;
+        }
+    }
+    out[code_pos] = code;
+    out[pos++]    = 0;
+    return pos;
+}
+
+/**
+ * The frames of Modbus RTU are separated by silence on the line, which is
+ * not seen in what is read. Instead a frame ends at the first byte where the
+ * CRC of the frame so far, with its CRC, is zero. A prefix of a frame matches
+ * by chance once in 65536, and a frame with a bad CRC is skipped a byte at a
+ * time until the next frame is found.
+ */
+static gsize modbus_rtu_decode(guint8* data, gsize size, guint8** payload, gsize* payload_size) {
+    guint16 crc = CHECKSUM_CRC16_MODBUS_INIT;
+    gsize i;
+
+    for (i = 0; i < size && i < MODBUS_MAX_FRAME; i++) {
+        crc = checksum_crc16_modbus(crc, data + i, 1);
+        if (i + 1 >= MODBUS_MIN_FRAME && crc == 0) {
+            *payload      = data;
+            *payload_size = i - 1;
+            return i + 1;
+        }
+    }
+    if (i == MODBUS_MAX_FRAME) {
+        *payload = NULL;
+        return 1;
+    }
+    return 0;
+}
+
+static gsize modbus_rtu_encode(const guint8* payload, gsize size, guint8* out) {
+    guint16 crc = checksum_crc16_modbus(CHECKSUM_CRC16_MODBUS_INIT, payload, size);
+
+    memcpy(out, payload, size);
+    out[size]     = crc & 0xff;
+    out[size + 1] = crc >> 8;
+    return size + 2;
+}
+
+static gsize modbus_rtu_max_encoded_size(gsize size) {
+    return size + 2;
+}
+
+const SerialFraming serial_framing_length_prefix = {
+    .name             = "length",
+    .decode           = length_prefix_decode,
+    .encode           = length_prefix_encode,
+    .max_encoded_size = length_prefix_max_encoded_size,
+};
+
+const SerialFraming serial_framing_cobs = {
+    .name             = "cobs",
+    .decode           = cobs_decode,
+    .encode           = cobs_encode,
+    .max_encoded_size = cobs_max_encoded_size,
+};
+
+const SerialFraming serial_framing_modbus_rtu = {
+    .name             = "modbus",
+    .decode           = modbus_rtu_decode,
+    .encode           = modbus_rtu_encode,
+    .max_encoded_size = modbus_rtu_max_encoded_size,
+};
+
+const SerialFraming* serial_framing_find(const gchar* name) {
+    const SerialFraming* framings[] = {&serial_framing_length_prefix,
+                                       &serial_framing_cobs,
+                                       &serial_framing_modbus_rtu};
+    gsize i;
+
+    for (i = 0; i < G_N_ELEMENTS(framings); i++) {
+        if (g_strcmp0(framings[i]->name, name) == 0) {
+            return framings[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Hand the complete frames in the read buffer to the callback
+ *
+ * @param protocol Protocol that has read data
+ */
+static void dispatch_frames(SerialProtocol* protocol) {
+    while (protocol->read_start < protocol->read_end) {
+        guint8* data    = protocol->read_buffer + protocol->read_start;
+        guint8* payload = NULL;
+        gsize size      = 0;
+        gsize consumed;
+
+        consumed = protocol->framing->decode(data,
+                                             protocol->read_end - protocol->read_start,
+                                             &payload,
+                                             &size);
+        if (consumed == 0) {
+            break;
+        }
+        protocol->read_start += consumed;
+        if (payload) {
+            protocol->frames_received++;
+            protocol->frame_func(payload, size, protocol->user_data);
+        } else {
+            protocol->bytes_dropped += consumed;
+        }
+    }
+}
+
+/**
+ * @brief Callback function registered by g_io_add_watch(), which reads all
+ *        that is available on the port
+ *
+ * @param channel Channel of the port
+ * @param cond Condition that was satisfied
+ * @param data The protocol
+ *
+ * @return G_SOURCE_CONTINUE to keep the watch
+ */
+static gboolean on_readable(GIOChannel* channel, GIOCondition cond, gpointer data) {
+    SerialProtocol* protocol = data;
+    guint64 dropped          = protocol->bytes_dropped;
+    (void)channel;
+    (void)cond;
+
+    while (TRUE) {
+        ssize_t bytes_read;
+
+        if (protocol->read_end == sizeof(protocol->read_buffer)) {
+            if (protocol->read_start == 0) {
+                /* A frame can not be this large, so it is garbage. */
+                protocol->bytes_dropped += protocol->read_end;
+                protocol->read_end = 0;
+            }
+            memmove(protocol->read_buffer,
+                    protocol->read_buffer + protocol->read_start,
+                    protocol->read_end - protocol->read_start);
+            protocol->read_end -= protocol->read_start;
+            protocol->read_start = 0;
+        }
+
+        bytes_read = read(protocol->fd,
+                          protocol->read_buffer + protocol->read_end,
+                          sizeof(protocol->read_buffer) - protocol->read_end);
+        if (bytes_read < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytes_read < 0 && errno != EAGAIN) {
+            syslog(LOG_ERR, "Failed to read from the serial port: %s", g_strerror(errno));
+        }
+        if (bytes_read <= 0) {
+            break;
+        }
+        protocol->read_end += bytes_read;
+        dispatch_frames(protocol);
+    }
+
+    /* Keep the start of the next frame, once per wakeup. */
+    memmove(protocol->read_buffer,
+            protocol->read_buffer + protocol->read_start,
+            protocol->read_end - protocol->read_start);
+    protocol->read_end -= protocol->read_start;
+    protocol->read_start = 0;
+
+    if (protocol->bytes_dropped > dropped) {
+        syslog(LOG_WARNING,
+               "Dropped %" G_GUINT64_FORMAT " bytes that were not %s frames",
+               protocol->bytes_dropped - dropped,
+               protocol->framing->name);
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+/**
+ * @brief Callback function registered by g_io_add_watch(), which writes as
+ *        much of the send queue as the port takes
+ *
+ * @param channel Channel of the port
+ * @param cond Condition that was satisfied
+ * @param data The protocol
+ *
+ * @return G_SOURCE_REMOVE when the send queue is empty
+ */
+static gboolean on_writable(GIOChannel* channel, GIOCondition cond, gpointer data) {
+    SerialProtocol* protocol = data;
+    GByteArray* queue        = protocol->send_queue;
+    (void)channel;
+    (void)cond;
+
+    while (protocol->send_offset < queue->len) {
+        ssize_t written = write(protocol->fd,
+                                queue->data + protocol->send_offset,
+                                queue->len - protocol->send_offset);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written < 0 && errno == EAGAIN) {
+            /* Drop the written bytes once they are half the queue, so a port that keeps the
+             * queue from emptying does not make it grow without bound. */
+            if (protocol->send_offset > queue->len / 2) {
+                g_byte_array_remove_range(queue, 0, protocol->send_offset);
+                protocol->send_offset = 0;
+            }
+            return G_SOURCE_CONTINUE;
+        }
+        if (written < 0) {
+            syslog(LOG_ERR, "Failed to write to the serial port: %s", g_strerror(errno));
+            break;
+        }
+        protocol->send_offset += written;
+    }
+
+    g_byte_array_set_size(queue, 0);
+    protocol->send_offset = 0;
+    protocol->write_watch = 0;
+    return G_SOURCE_REMOVE;
+}
+
+SerialProtocol* serial_protocol_new(GIOChannel* channel,
+                                    const SerialFraming* framing,
+                                    SerialFrameFunc frame_func,
+                                    gpointer user_data,
+                                    GError** error) {
+    SerialProtocol* protocol;
+
+    if (g_io_channel_set_flags(channel, G_IO_FLAG_NONBLOCK, error) != G_IO_STATUS_NORMAL) {
+        return NULL;
+    }
+
+    protocol             = g_new0(SerialProtocol, 1);
+    protocol->channel    = g_io_channel_ref(channel);
+    protocol->fd         = g_io_channel_unix_get_fd(channel);
+    protocol->framing    = framing;
+    protocol->frame_func = frame_func;
+    protocol->user_data  = user_data;
+    protocol->send_queue = g_byte_array_new();
+    protocol->read_watch = g_io_add_watch(channel, G_IO_IN, on_readable, protocol);
+    return protocol;
+}
+
+void serial_protocol_free(SerialProtocol* protocol) {
+    if (!protocol) {
+        return;
+    }
+
+    g_source_remove(protocol->read_watch);
+    if (protocol->write_watch) {
+        g_source_remove(protocol->write_watch);
+    }
+    syslog(LOG_INFO,
+           "Received %" G_GUINT64_FORMAT " and sent %" G_GUINT64_FORMAT
+           " %s frames, dropped %" G_GUINT64_FORMAT " bytes and rejected %" G_GUINT64_FORMAT
+           " frames",
+           protocol->frames_received,
+           protocol->frames_sent,
+           protocol->framing->name,
+           protocol->bytes_dropped,
+           protocol->frames_rejected);
+    g_byte_array_unref(protocol->send_queue);
+    g_io_channel_unref(protocol->channel);
+    g_free(protocol);
+}
+
+gboolean serial_protocol_send(SerialProtocol* protocol, const guint8* payload, gsize size) {
+    GByteArray* queue = protocol->send_queue;
+    gsize start       = queue->len;
+    gsize max_size    = protocol->framing->max_encoded_size(size);
+
+    if (size > SERIAL_PROTOCOL_MAX_PAYLOAD ||
+        queue->len - protocol->send_offset + max_size > SERIAL_PROTOCOL_SEND_QUEUE_SIZE) {
+        protocol->frames_rejected++;
+        return FALSE;
+    }
+
+    /* Encode straight into the queue. */
+    g_byte_array_set_size(queue, start + max_size);
+    g_byte_array_set_size(queue,
+                          start + protocol->framing->encode(payload, size, queue->data + start));
+    protocol->frames_sent++;
+
+    if (!protocol->write_watch) {
+        protocol->write_watch = g_io_add_watch(protocol->channel, G_IO_OUT, on_writable, protocol);
+    }
+    return TRUE;
+}
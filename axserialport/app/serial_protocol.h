@@ -0,0 +1,155 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/**
+ * Framed protocol on a serial port.
+ *
+ * The reader drains all that is available from the port at each wakeup into
+ * a buffer, and hands each complete frame to a callback as a pointer into the
+ * buffer, without copying it. The unused rest of the buffer is moved to its
+ * start only once per wakeup, so a frame is always contiguous.
+ *
+ * The writer encodes the frames into a send queue, that is written when the
+ * port can take more, so the frames sent from the same main loop iteration go
+ * out in one write instead of one write and flush each.
+ *
+ * The framing is pluggable, see SerialFraming.
+ */
+
+#pragma once
+
+#include <glib.h>
+
+/* The largest payload of a frame. */
+#define SERIAL_PROTOCOL_MAX_PAYLOAD 1024
+/* Room for several frames, so a wakeup rarely fills it. */
+#define SERIAL_PROTOCOL_READ_BUFFER_SIZE 8192
+/* Frames are rejected when this much is waiting to be written. */
+#define SERIAL_PROTOCOL_SEND_QUEUE_SIZE (64 * 1024)
+
+/**
+ * How the payloads are framed on the line.
+ */
+typedef struct SerialFraming {
+    const gchar* name;
+    /**
+     * @brief Find the next frame at the start of the data, which may be
+     *        decoded in place
+     *
+     * @param data Received data
+     * @param size Number of bytes of data
+     * @param payload Set to the payload of a frame, or NULL if the
+     *        consumed bytes are not a frame and are dropped
+     * @param payload_size Set to the size of the payload
+     *
+     * @return Number of bytes consumed, 0 if more data is needed
+     */
+    gsize (*decode)(guint8* data, gsize size, guint8** payload, gsize* payload_size);
+    /**
+     * @brief Encode a payload
+     *
+     * @param payload Payload to send
+     * @param size Size of the payload
+     * @param out Buffer of at least max_encoded_size(size) bytes
+     *
+     * @return Number of bytes written
+     */
+    gsize (*encode)(const guint8* payload, gsize size, guint8* out);
+    gsize (*max_encoded_size)(gsize size);
+} SerialFraming;
+
+/* A big-endian 16 bit length and the payload. */
+extern const SerialFraming serial_framing_length_prefix;
+/* The payload in consistent overhead byte stuffing, ended by a zero byte. */
+extern const SerialFraming serial_framing_cobs;
+/* A Modbus RTU frame, the payload followed by its CRC-16, found by the CRC. */
+extern const SerialFraming serial_framing_modbus_rtu;
+
+/**
+ * @brief Get a framing by its name
+ *
+ * @param name "length", "cobs" or "modbus"
+ *
+ * @return The framing, or NULL if there is none by that name
+ */
+const SerialFraming* serial_framing_find(const gchar* name);
+
+/**
+ * @brief Called with each received frame
+ *
+ * @param payload Payload of the frame, valid until the callback returns
+ * @param size Size of the payload
+ * @param user_data User data given to serial_protocol_new()
+ */
+typedef void (*SerialFrameFunc)(const guint8* payload, gsize size, gpointer user_data);
+
+typedef struct SerialProtocol {
+    GIOChannel* channel;
+    gint fd;
+    const SerialFraming* framing;
+    SerialFrameFunc frame_func;
+    gpointer user_data;
+
+    guint read_watch;
+    guint8 read_buffer[SERIAL_PROTOCOL_READ_BUFFER_SIZE];
+    gsize read_start;
+    gsize read_end;
+
+    guint write_watch;
+    GByteArray* send_queue;
+    gsize send_offset;
+
+    guint64 frames_received;
+    guint64 bytes_dropped;
+    guint64 frames_sent;
+    guint64 frames_rejected;
+} SerialProtocol;
+
+/**
+ * @brief Start the protocol on a channel of a serial port
+ *
+ * @param channel Channel of the port, which is set to non-blocking
+ * @param framing Framing of the frames
+ * @param frame_func Function called with each received frame
+ * @param user_data Data passed to frame_func
+ * @param error Set if the channel could not be set up
+ *
+ * @return The protocol, or NULL on error
+ */
+SerialProtocol* serial_protocol_new(GIOChannel* channel,
+                                    const SerialFraming* framing,
+                                    SerialFrameFunc frame_func,
+                                    gpointer user_data,
+                                    GError** error);
+
+/**
+ * @brief Stop the protocol, dropping the frames not yet written
+ *
+ * @param protocol Protocol to free
+ */
+void serial_protocol_free(SerialProtocol* protocol);
+
+/**
+ * @brief Queue a frame to be sent
+ *
+ * @param protocol Protocol to send with
+ * @param payload Payload of the frame
+ * @param size Size of the payload, at most SERIAL_PROTOCOL_MAX_PAYLOAD
+ *
+ * @return FALSE if the frame is too large or the send queue is full
+ */
+gboolean serial_protocol_send(SerialProtocol* protocol, const guint8* payload, gsize size);
@@ -14,36 +14,53 @@
  * limitations under the License.
  */
 
-#include <errno.h>
 #include <glib-unix.h>
 #include <glib.h>
-#include <glib/gstdio.h>
 #include <signal.h>
-#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <syslog.h>
 
-/* AX Storage library. */
+/* AX Event and AX Storage library. */
+#include <axsdk/axevent.h>
 #include <axsdk/axstorage.h>
 
+#include "disk_writer.h"
+#include "recorder.h"
+#include "storage_stats.h"
+
+/* Seconds of video before and after a trigger to record. */
+#define PRE_EVENT_SECONDS  10
+#define POST_EVENT_SECONDS 10
+/* Room in RAM for the pre-event video and the video not yet written. */
+#define RING_SIZE (32 * 1024 * 1024)
+/* The virtual input port that triggers a recording. */
+#define TRIGGER_PORT 1
+/* Seconds a record can wait in the buffer of a disk writer. */
+#define FLUSH_INTERVAL_SECONDS 5
+
 /**
  * disk_item_t represents one storage device and its values.
  */
 typedef struct {
-    AXStorage* storage;         /** AXStorage reference. */
-    AXStorageType storage_type; /** Storage type */
-    gchar* storage_id;          /** Storage device name. */
-    gchar* storage_path;        /** Storage path. */
-    guint subscription_id;      /** Subscription ID for storage events. */
-    gboolean setup;             /** TRUE: storage was set up async, FALSE otherwise. */
-    gboolean writable;          /** Storage is writable or not. */
-    gboolean available;         /** Storage is available or not. */
-    gboolean full;              /** Storage device is full or not. */
-    gboolean exiting;           /** Storage is exiting (going to disappear) or not. */
+    AXStorage* storage;          /** AXStorage reference. */
+    AXStorageType storage_type;  /** Storage type */
+    gchar* storage_id;           /** Storage device name. */
+    gchar* storage_path;         /** Storage path. */
+    guint subscription_id;       /** Subscription ID for storage events. */
+    gboolean setup;              /** TRUE: storage was set up async, FALSE otherwise. */
+    gboolean writable;           /** Storage is writable or not. */
+    gboolean available;          /** Storage is available or not. */
+    gboolean full;               /** Storage device is full or not. */
+    gboolean exiting;            /** Storage is exiting (going to disappear) or not. */
+    GHashTable* writers;         /** Open files of the storage, disk_writer_t by name. */
+    storage_stats_t stats;       /** Write throughput and sync latency of the storage. */
+    storage_throttle_t throttle; /** How much less is written since the storage is behind. */
 } disk_item_t;
 
-static GList* disks_list = NULL;
+static GList* disks_list          = NULL;
+static recorder_t* recorder       = NULL;
+static disk_item_t* recorder_disk = NULL;
 
 /**
  * @brief Handles the signals.
@@ -56,6 +73,58 @@ static gboolean signal_handler(gpointer loop) {
     return G_SOURCE_REMOVE;
 }
 
+/**
+ * @brief Get the writer of a file on a disk, the file is opened the first time
+ *
+ * @param item The disk
+ * @param name Name of the file, without the .log extension
+ *
+ * @return The writer, or NULL if the file could not be opened
+ */
+static disk_writer_t* get_disk_writer(disk_item_t* item, const gchar* name) {
+    disk_writer_t* writer = g_hash_table_lookup(item->writers, name);
+    if (writer == NULL) {
+        gchar* filename = g_strdup_printf("%s/%s.log", item->storage_path, name);
+        writer          = disk_writer_open(filename, &item->stats);
+        g_free(filename);
+        if (writer != NULL) {
+            g_hash_table_insert(item->writers, g_strdup(name), writer);
+        }
+    }
+    return writer;
+}
+
+/**
+ * @brief Format a record with less detail the more the storage is behind
+ *
+ * @param item The disk
+ * @param counter Number of the record
+ *
+ * @return The record
+ */
+static gchar* format_record(disk_item_t* item, guint counter) {
+    if (item->throttle == STORAGE_THROTTLE_MINIMAL) {
+        return g_strdup_printf("counter: %u\n", counter);
+    }
+
+    GDateTime* now = g_date_time_new_now_local();
+    gchar* time    = g_date_time_format(now, "%Y-%m-%dT%H:%M:%S");
+    gchar* record  = NULL;
+    g_date_time_unref(now);
+    if (item->throttle == STORAGE_THROTTLE_REDUCED) {
+        record = g_strdup_printf("counter: %u, time: %s\n", counter, time);
+    } else {
+        gchar* stats = storage_stats_to_string(&item->stats);
+        record       = g_strdup_printf("counter: %u, time: %s, storage: %s\n",
+                                 counter,
+                                 time,
+                                 stats);
+        g_free(stats);
+    }
+    g_free(time);
+    return record;
+}
+
 /**
  * @brief Callback function registered by g_timeout_add_seconds(),
  *        which is triggered every 10th second and writes data to disk
@@ -74,23 +143,98 @@ static gboolean write_data(const gchar* data) {
         /* Write data to disk when it is available, writable and has disk space
            and the setup has been done. */
         if (item->available && item->writable && !item->full && item->setup) {
-            gchar* filename = g_strdup_printf("%s/%s.log", item->storage_path, data);
+            disk_writer_t* writer = get_disk_writer(item, data);
+            if (writer == NULL) {
+                ret = FALSE;
+                continue;
+            }
 
-            FILE* file = g_fopen(filename, "a");
-            if (file == NULL) {
-                syslog(LOG_WARNING, "Failed to open %s. Error %s.", filename, g_strerror(errno));
+            /* The record is only added to the buffer of the writer, the file
+               is written by its thread after flush_disk_writers() or when the
+               buffer is full. */
+            gchar* record    = format_record(item, ++counter);
+            gboolean written = disk_writer_append(writer, record, strlen(record));
+            g_free(record);
+            if (!written) {
+                /* The file is opened again at the next record. */
+                g_hash_table_remove(item->writers, data);
                 ret = FALSE;
-            } else {
-                g_fprintf(file, "counter: %d\n", ++counter);
-                fclose(file);
-                syslog(LOG_INFO, "Writing to %s", filename);
             }
-            g_free(filename);
         }
     }
     return ret;
 }
 
+/**
+ * @brief Callback function registered by g_timeout_add_seconds(),
+ *        which is triggered every second and writes the records that have
+ *        waited long enough in the buffers of the disk writers
+ *
+ * @param user_data Unused
+ *
+ * @return G_SOURCE_CONTINUE
+ */
+static gboolean flush_disk_writers(gpointer user_data) {
+    GList* node = NULL;
+    (void)user_data;
+
+    for (node = g_list_first(disks_list); node != NULL; node = g_list_next(node)) {
+        disk_item_t* item = node->data;
+        GHashTableIter iter;
+        gpointer writer;
+
+        if (!item->writable || item->full) {
+            continue;
+        }
+        g_hash_table_iter_init(&iter, item->writers);
+        while (g_hash_table_iter_next(&iter, NULL, &writer)) {
+            if (!disk_writer_flush_if_due(writer, FLUSH_INTERVAL_SECONDS)) {
+                g_hash_table_iter_remove(&iter);
+            }
+        }
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+/**
+ * @brief Callback function registered by g_timeout_add_seconds(),
+ *        which is triggered every second and throttles the writes to the
+ *        disks that fall behind
+ *
+ * Less detail is written to the log files of a disk that is behind, and only
+ * the key frames are recorded to a disk that is far behind.
+ *
+ * @param user_data Unused
+ *
+ * @return G_SOURCE_CONTINUE
+ */
+static gboolean update_throttling(gpointer user_data) {
+    GList* node = NULL;
+    (void)user_data;
+
+    for (node = g_list_first(disks_list); node != NULL; node = g_list_next(node)) {
+        disk_item_t* item           = node->data;
+        storage_throttle_t throttle = storage_stats_update_throttle(&item->stats);
+
+        if (throttle == item->throttle) {
+            continue;
+        }
+        gchar* stats = storage_stats_to_string(&item->stats);
+        syslog(throttle > item->throttle ? LOG_WARNING : LOG_INFO,
+               "Throttling of %s is %s: %s",
+               item->storage_id,
+               storage_throttle_name(throttle),
+               stats);
+        g_free(stats);
+
+        item->throttle = throttle;
+        if (item == recorder_disk) {
+            recorder_set_key_frames_only(recorder, throttle == STORAGE_THROTTLE_MINIMAL);
+        }
+    }
+    return G_SOURCE_CONTINUE;
+}
+
 /**
  * @brief Find disk item in disks_list
  *
@@ -112,6 +256,38 @@ static disk_item_t* find_disk_item_t(gchar* storage_id) {
     return NULL;
 }
 
+/**
+ * @brief Let the recorder record to the first disk that is set up, writable
+ *        and not full, nor exiting.
+ *
+ * The recording in progress is stopped and closed when its disk is no longer
+ * ready, so the disk can be released after the call.
+ */
+static void update_recorder_storage(void) {
+    GList* node       = NULL;
+    disk_item_t* disk = NULL;
+
+    if (recorder == NULL) {
+        return;
+    }
+
+    for (node = g_list_first(disks_list); node != NULL; node = g_list_next(node)) {
+        disk_item_t* item = node->data;
+
+        if (item->setup && item->available && item->writable && !item->full && !item->exiting) {
+            disk = item;
+            break;
+        }
+    }
+    recorder_disk = disk;
+    if (disk != NULL) {
+        recorder_set_storage(recorder, disk->storage_path, &disk->stats);
+        recorder_set_key_frames_only(recorder, disk->throttle == STORAGE_THROTTLE_MINIMAL);
+    } else {
+        recorder_set_storage(recorder, NULL, NULL);
+    }
+}
+
 /**
  * @brief Callback function registered by ax_storage_release_async(),
  *        which is triggered to release the disk
@@ -140,6 +316,7 @@ static void free_disk_item_t(void) {
         if (item->setup) {
             /* NOTE: It is advised to finish all your reading/writing operations
                before releasing the storage device. */
+            g_hash_table_remove_all(item->writers);
             ax_storage_release_async(item->storage, release_disk_cb, item->storage_id, &error);
             if (error != NULL) {
                 syslog(LOG_WARNING,
@@ -163,6 +340,8 @@ static void free_disk_item_t(void) {
         } else {
             syslog(LOG_INFO, "Unsubscribed events of %s", item->storage_id);
         }
+        g_hash_table_destroy(item->writers);
+        storage_stats_destroy(&item->stats);
         g_free(item->storage_id);
         g_free(item->storage_path);
     }
@@ -220,6 +399,7 @@ static void setup_disk_cb(AXStorage* storage, gpointer user_data, GError* error)
     disk->setup        = TRUE;
 
     syslog(LOG_INFO, "Disk: %s has been setup in %s", storage_id, path);
+    update_recorder_storage();
 free_variables:
     g_free(storage_id);
     g_free(path);
@@ -303,10 +483,15 @@ static void subscribe_cb(gchar* storage_id, gpointer user_data, GError* error) {
            exiting ? "" : "not ",
            full ? "" : "not ");
 
+    /* Stop recording to the disk before it is released. */
+    update_recorder_storage();
+
     /* If exiting, and the disk was set up before, release it. */
     if (exiting && disk->setup) {
         /* NOTE: It is advised to finish all your reading/writing operations before
-           releasing the storage device. */
+           releasing the storage device. The writers are closed, which writes
+           their buffers and syncs the files. */
+        g_hash_table_remove_all(disk->writers);
         ax_storage_release_async(disk->storage, release_disk_cb, storage_id, &ax_error);
 
         if (ax_error != NULL) {
@@ -359,21 +544,99 @@ static disk_item_t* new_disk_item_t(gchar* storage_id) {
     item->subscription_id = subscription_id;
     item->storage_id      = g_strdup(storage_id);
     item->setup           = FALSE;
+    item->writers         = g_hash_table_new_full(g_str_hash,
+                                                  g_str_equal,
+                                                  g_free,
+                                                  (GDestroyNotify)disk_writer_close);
+    storage_stats_init(&item->stats);
 
     return item;
 }
 
+/**
+ * @brief Callback function registered by ax_event_handler_subscribe(),
+ *        which is triggered when the state of the virtual input port changes
+ *
+ * @param subscription Subscription ID
+ * @param event The event
+ * @param user_data The recorder
+ */
+static void trigger_cb(guint subscription, AXEvent* event, gpointer user_data) {
+    const AXEventKeyValueSet* key_value_set = ax_event_get_key_value_set(event);
+    gboolean state                          = FALSE;
+    (void)subscription;
+
+    if (ax_event_key_value_set_get_boolean(key_value_set, "state", NULL, &state, NULL) && state) {
+        syslog(LOG_INFO, "Recording triggered");
+        recorder_trigger(user_data);
+    }
+    ax_event_free(event);
+}
+
+/**
+ * @brief Subscribe to the state of the virtual input port that triggers a recording
+ *
+ * @param event_handler The event handler
+ *
+ * @return Subscription ID, 0 on failure
+ */
+static guint subscribe_to_trigger(AXEventHandler* event_handler) {
+    GError* error                     = NULL;
+    AXEventKeyValueSet* key_value_set = ax_event_key_value_set_new();
+    gint port                         = TRIGGER_PORT;
+    guint subscription                = 0;
+
+    ax_event_key_value_set_add_key_values(key_value_set,
+                                          NULL,
+                                          "topic0",
+                                          "tns1",
+                                          "Device",
+                                          AX_VALUE_TYPE_STRING,
+                                          "topic1",
+                                          "tnsaxis",
+                                          "IO",
+                                          AX_VALUE_TYPE_STRING,
+                                          "topic2",
+                                          "tnsaxis",
+                                          "VirtualPort",
+                                          AX_VALUE_TYPE_STRING,
+                                          "port",
+                                          NULL,
+                                          &port,
+                                          AX_VALUE_TYPE_INT,
+                                          "state",
+                                          NULL,
+                                          NULL,
+                                          AX_VALUE_TYPE_BOOL,
+                                          NULL);
+
+    if (!ax_event_handler_subscribe(event_handler,
+                                    key_value_set,
+                                    &subscription,
+                                    trigger_cb,
+                                    recorder,
+                                    &error)) {
+        syslog(LOG_WARNING, "Failed to subscribe to the trigger. Error: %s", error->message);
+        g_clear_error(&error);
+        subscription = 0;
+    }
+    ax_event_key_value_set_free(key_value_set);
+    return subscription;
+}
+
 /**
  * @brief Main function
  *
  * @return Result
  */
 gint main(void) {
-    GList* disks    = NULL;
-    GList* node     = NULL;
-    GError* error   = NULL;
-    GMainLoop* loop = NULL;
-    gint ret        = EXIT_SUCCESS;
+    GList* disks                  = NULL;
+    GList* node                   = NULL;
+    GError* error                 = NULL;
+    GMainLoop* loop               = NULL;
+    AXEventHandler* event_handler = NULL;
+    guint trigger_subscription    = 0;
+    gint ret                      = EXIT_SUCCESS;
 
     syslog(LOG_INFO, "Start AXStorage application");
 
@@ -390,6 +653,16 @@ gint main(void) {
     g_unix_signal_add(SIGTERM, signal_handler, loop);
     g_unix_signal_add(SIGINT, signal_handler, loop);
 
+    /* Keep the last seconds of video in RAM and record it on triggers. The
+       storage is set when a disk has been set up. */
+    recorder = recorder_new(PRE_EVENT_SECONDS, POST_EVENT_SECONDS, RING_SIZE);
+    if (recorder == NULL) {
+        syslog(LOG_WARNING, "Pre-event recording is not available");
+    } else {
+        event_handler        = ax_event_handler_new();
+        trigger_subscription = subscribe_to_trigger(event_handler);
+    }
+
     /* Loop through the retrieved disks and subscribe to their events. */
     for (node = g_list_first(disks); node != NULL; node = g_list_next(node)) {
         gchar* disk_name  = (gchar*)node->data;
@@ -409,10 +682,22 @@ gint main(void) {
     gchar* file2 = g_strdup("file2");
     g_timeout_add_seconds(10, (GSourceFunc)write_data, file1);
     g_timeout_add_seconds(10, (GSourceFunc)write_data, file2);
+    g_timeout_add_seconds(1, flush_disk_writers, NULL);
+    g_timeout_add_seconds(1, update_throttling, NULL);
 
     /* start the main loop */
     g_main_loop_run(loop);
 
+    if (trigger_subscription != 0) {
+        ax_event_handler_unsubscribe(event_handler, trigger_subscription, NULL);
+    }
+    if (event_handler != NULL) {
+        ax_event_handler_free(event_handler);
+    }
+    /* Finish the recording before the disks are released. */
+    recorder_free(recorder);
+    recorder = NULL;
+
     free_disk_item_t();
     g_free(file1);
     g_free(file2);
@@ -0,0 +1,216 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "disk_writer.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <syslog.h>
+#include <unistd.h>
+
+#include "checksum.h"
+
+static gboolean write_all(disk_writer_t* writer, const gchar* data, gsize size) {
+    while (size > 0) {
+        gint64 start_us = g_get_monotonic_time();
+        ssize_t written = write(writer->fd, data, size);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written < 0) {
+            syslog(LOG_WARNING,
+                   "Failed to write to %s. Error %s.",
+                   writer->path,
+                   g_strerror(errno));
+            return FALSE;
+        }
+        storage_stats_add_write(writer->stats, written, g_get_monotonic_time() - start_us);
+        writer->crc = checksum_crc32(writer->crc, data, (gsize)written);
+        writer->appended += (gsize)written;
+        data += written;
+        size -= (gsize)written;
+        writer->unsynced += (gsize)written;
+    }
+    return TRUE;
+}
+
+static gboolean sync_file(disk_writer_t* writer) {
+    if (writer->unsynced == 0) {
+        return TRUE;
+    }
+    writer->unsynced = 0;
+    gint64 start_us  = g_get_monotonic_time();
+    if (fdatasync(writer->fd) != 0) {
+        syslog(LOG_WARNING, "Failed to sync %s. Error %s.", writer->path, g_strerror(errno));
+        return FALSE;
+    }
+    storage_stats_add_sync(writer->stats, g_get_monotonic_time() - start_us);
+    return TRUE;
+}
+
+/**
+ * @brief Write the buffers handed over until the writer is closed.
+ */
+static void* writer_thread(void* data) {
+    disk_writer_t* writer = data;
+
+    pthread_mutex_lock(&writer->mutex);
+    while (TRUE) {
+        while (writer->pending == NULL && !writer->closing) {
+            pthread_cond_wait(&writer->cond, &writer->mutex);
+        }
+        if (writer->pending == NULL) {
+            break;
+        }
+
+        /* The pending buffer is not touched by the caller until it is written. */
+        const gchar* buffer = writer->pending;
+        gsize size          = writer->pending_size;
+        pthread_mutex_unlock(&writer->mutex);
+        gboolean written = write_all(writer, buffer, size);
+        if (written && writer->unsynced >= DISK_WRITER_SYNC_SIZE) {
+            written = sync_file(writer);
+        }
+        pthread_mutex_lock(&writer->mutex);
+
+        writer->pending = NULL;
+        writer->failed |= !written;
+        pthread_cond_broadcast(&writer->cond);
+    }
+    gboolean failed = writer->failed;
+    pthread_mutex_unlock(&writer->mutex);
+
+    /* A failure is already logged. */
+    if (!failed) {
+        sync_file(writer);
+    }
+    return NULL;
+}
+
+disk_writer_t* disk_writer_open(const gchar* path, storage_stats_t* stats) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        syslog(LOG_WARNING, "Failed to open %s. Error %s.", path, g_strerror(errno));
+        return NULL;
+    }
+
+    disk_writer_t* writer = g_new0(disk_writer_t, 1);
+    writer->path          = g_strdup(path);
+    writer->fd            = fd;
+    writer->stats         = stats;
+    pthread_mutex_init(&writer->mutex, NULL);
+    pthread_cond_init(&writer->cond, NULL);
+
+    if (pthread_create(&writer->thread, NULL, writer_thread, writer) != 0) {
+        syslog(LOG_WARNING, "Failed to create the writer thread of %s", path);
+        pthread_cond_destroy(&writer->cond);
+        pthread_mutex_destroy(&writer->mutex);
+        close(fd);
+        g_free(writer->path);
+        g_free(writer);
+        return NULL;
+    }
+    syslog(LOG_INFO, "Writing to %s", path);
+    return writer;
+}
+
+/**
+ * @brief Hand the active buffer to the thread, unless the thread is busy.
+ *
+ * @return FALSE if a buffer could not be written.
+ */
+static gboolean hand_over(disk_writer_t* writer) {
+    pthread_mutex_lock(&writer->mutex);
+    gboolean failed = writer->failed;
+    if (!failed && writer->pending == NULL && writer->used > 0) {
+        writer->pending      = writer->buffers[writer->active];
+        writer->pending_size = writer->used;
+        writer->active       = !writer->active;
+        writer->used         = 0;
+        pthread_cond_broadcast(&writer->cond);
+    }
+    pthread_mutex_unlock(&writer->mutex);
+    return !failed;
+}
+
+gboolean disk_writer_append(disk_writer_t* writer, const gchar* record, gsize size) {
+    if (writer->used + size > DISK_WRITER_BUFFER_SIZE && !hand_over(writer)) {
+        return FALSE;
+    }
+    if (writer->used + size > DISK_WRITER_BUFFER_SIZE) {
+        if (writer->records_dropped++ == 0) {
+            syslog(LOG_WARNING, "The storage is too slow, records to %s are dropped", writer->path);
+        }
+        return TRUE;
+    }
+
+    if (writer->used == 0) {
+        writer->oldest_record_us = g_get_monotonic_time();
+    }
+    memcpy(writer->buffers[writer->active] + writer->used, record, size);
+    writer->used += size;
+    return TRUE;
+}
+
+gboolean disk_writer_flush_if_due(disk_writer_t* writer, guint max_age_s) {
+    if (writer->used == 0 ||
+        g_get_monotonic_time() - writer->oldest_record_us < (gint64)max_age_s * G_USEC_PER_SEC) {
+        return TRUE;
+    }
+    return hand_over(writer);
+}
+
+void disk_writer_close(disk_writer_t* writer) {
+    if (writer == NULL) {
+        return;
+    }
+
+    /* Wait for the buffer being written, then hand over the last one. */
+    pthread_mutex_lock(&writer->mutex);
+    while (writer->pending != NULL) {
+        pthread_cond_wait(&writer->cond, &writer->mutex);
+    }
+    pthread_mutex_unlock(&writer->mutex);
+    hand_over(writer);
+
+    pthread_mutex_lock(&writer->mutex);
+    writer->closing = TRUE;
+    pthread_cond_broadcast(&writer->cond);
+    pthread_mutex_unlock(&writer->mutex);
+    pthread_join(writer->thread, NULL);
+
+    if (writer->records_dropped > 0) {
+        syslog(LOG_WARNING,
+               "%" G_GUINT64_FORMAT " records to %s were dropped since the storage was too slow",
+               writer->records_dropped,
+               writer->path);
+    }
+    if (close(writer->fd) != 0) {
+        syslog(LOG_WARNING, "Failed to close %s. Error %s.", writer->path, g_strerror(errno));
+    } else {
+        /* The thread is joined, so its fields can be read. */
+        syslog(LOG_INFO,
+               "Appended %" G_GUINT64_FORMAT " bytes to %s, CRC-32 %08X",
+               writer->appended,
+               writer->path,
+               writer->crc);
+    }
+    pthread_cond_destroy(&writer->cond);
+    pthread_mutex_destroy(&writer->mutex);
+    g_free(writer->path);
+    g_free(writer);
+}
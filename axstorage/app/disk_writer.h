@@ -0,0 +1,110 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Appending of records to a file on a storage.
+ *
+ * The file is kept open, and the records are collected in a buffer that is
+ * written when it is full or when its oldest record has waited long enough.
+ * Opening and closing the file for every record costs more than writing it,
+ * and on SD cards every small write can wear a whole erase block.
+ *
+ * The buffers are written by a thread of the writer, so the GLib main loop
+ * never waits for the storage. While one buffer is written the records are
+ * collected in the other, and if the storage falls so far behind that both
+ * are full, new records are dropped until a buffer is written.
+ *
+ * The written data is synced to the storage with fdatasync() every
+ * DISK_WRITER_SYNC_SIZE bytes and when the file is closed. The writes and
+ * syncs are reported to the statistics of the storage. The CRC-32 of the data
+ * appended while the file is open is logged when it is closed.
+ */
+
+#pragma once
+
+#include <glib.h>
+#include <pthread.h>
+
+#include "storage_stats.h"
+
+#define DISK_WRITER_BUFFER_SIZE (64 * 1024)
+#define DISK_WRITER_SYNC_SIZE   (1024 * 1024)
+
+typedef struct disk_writer {
+    gchar* path;
+    int fd;
+    storage_stats_t* stats;
+    pthread_t thread;
+    gchar buffers[2][DISK_WRITER_BUFFER_SIZE];
+
+    /* Only used by the caller */
+    guint active;
+    gsize used;
+    /* Time when the oldest record in the active buffer was added. */
+    gint64 oldest_record_us;
+    guint64 records_dropped;
+
+    /* The fields below are protected by mutex */
+    pthread_mutex_t mutex;
+    /* Signaled when a buffer is handed to the thread, and when it is written */
+    pthread_cond_t cond;
+    /* Buffer handed to the thread, NULL when the thread is idle */
+    const gchar* pending;
+    gsize pending_size;
+    gboolean failed;
+    gboolean closing;
+
+    /* Only used by the thread: bytes written since the last fdatasync(). */
+    gsize unsynced;
+    /* Only used by the thread: bytes appended since the file was opened, and
+       their CRC-32, to check the end of the file against. */
+    guint64 appended;
+    guint32 crc;
+} disk_writer_t;
+
+/**
+ * @brief Open a file to append records to.
+ *
+ * @param stats Statistics of the storage of the file.
+ *
+ * @return The writer, or NULL if the file could not be opened.
+ */
+disk_writer_t* disk_writer_open(const gchar* path, storage_stats_t* stats);
+
+/**
+ * @brief Add a record, the buffer is handed to the thread first if the record
+ *        does not fit.
+ *
+ * The record is dropped if it does not fit while the thread still writes the
+ * other buffer, and if it is larger than a buffer.
+ *
+ * @return FALSE if a buffer could not be written.
+ */
+gboolean disk_writer_append(disk_writer_t* writer, const gchar* record, gsize size);
+
+/**
+ * @brief Hand the buffer to the thread if its oldest record is at least
+ *        max_age_s seconds old.
+ *
+ * @return FALSE if a buffer could not be written.
+ */
+gboolean disk_writer_flush_if_due(disk_writer_t* writer, guint max_age_s);
+
+/**
+ * @brief Write the buffers, sync the file to the storage, close it and free the
+ *        writer. Waits for the storage.
+ */
+void disk_writer_close(disk_writer_t* writer);
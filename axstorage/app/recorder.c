@@ -0,0 +1,551 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "recorder.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <syslog.h>
+#include <unistd.h>
+
+#include "checksum.h"
+#include "vdo-error.h"
+#include "vdo-map.h"
+
+/* Frames per second of the captured video, for the size of the frame index. */
+#define MAX_FPS 60
+/* The writer waits until this many bytes, or a quarter of the ring or of the
+   frame index, can be written at once. */
+#define MIN_WRITE_SIZE (1024 * 1024)
+#define MAX_WRITE_SIZE (8 * 1024 * 1024)
+/* A recording is synced to the storage every SYNC_SIZE bytes, so the dirty
+   pages do not pile up until the file is closed. */
+#define SYNC_SIZE (16 * 1024 * 1024)
+
+static recorder_frame_t* frame_at(recorder_t* recorder, uint64_t seq) {
+    return &recorder->frames[seq % recorder->max_frames];
+}
+
+/**
+ * @brief Find room for a frame at the tail of the ring.
+ *
+ * @param offset Set to the offset of the room.
+ *
+ * @return FALSE if the frame does not fit.
+ */
+static gboolean find_room(recorder_t* recorder, size_t size, size_t* offset) {
+    if (recorder->count == 0) {
+        recorder->tail = 0;
+    } else if (recorder->count == recorder->max_frames) {
+        return FALSE;
+    }
+    if (size > recorder->capacity) {
+        return FALSE;
+    }
+    if (recorder->count == 0) {
+        *offset = 0;
+        return TRUE;
+    }
+
+    /* A frame is never split, if it does not fit at the end it is put at the
+       start of the ring. The tail never reaches the head, so a tail equal to
+       the head means an empty ring. */
+    size_t head = frame_at(recorder, recorder->head_seq)->offset;
+    if (recorder->tail > head) {
+        if (recorder->capacity - recorder->tail >= size) {
+            *offset = recorder->tail;
+            return TRUE;
+        }
+        if (size < head) {
+            *offset = 0;
+            return TRUE;
+        }
+        return FALSE;
+    }
+    if (head - recorder->tail > size) {
+        *offset = recorder->tail;
+        return TRUE;
+    }
+    return FALSE;
+}
+
+/**
+ * @brief Add a frame to the ring, dropping the oldest frames that are not
+ *        needed for the pre-event video or the recording in progress.
+ */
+static void add_frame(recorder_t* recorder, const uint8_t* data, size_t size, gboolean key_frame) {
+    gint64 now_us = g_get_monotonic_time();
+    size_t offset = 0;
+
+    pthread_mutex_lock(&recorder->mutex);
+
+    if (recorder->wait_for_key_frame && !key_frame) {
+        recorder->frames_dropped++;
+        goto unlock;
+    }
+    /* Once a frame is skipped, the frames after it cannot be decoded until the
+       next key frame. */
+    recorder->skipping = !key_frame && (recorder->key_frames_only || recorder->skipping);
+    if (recorder->skipping) {
+        recorder->frames_skipped++;
+        goto unlock;
+    }
+
+    gint64 window_start_us = now_us - (gint64)recorder->pre_event_s * G_USEC_PER_SEC;
+    while (recorder->count > 0) {
+        recorder_frame_t* oldest = frame_at(recorder, recorder->head_seq);
+        if (recorder->recording && recorder->head_seq >= recorder->write_seq) {
+            break;
+        }
+        if (oldest->capture_time_us >= window_start_us && find_room(recorder, size, &offset)) {
+            break;
+        }
+        recorder->head_seq++;
+        recorder->count--;
+    }
+
+    if (!find_room(recorder, size, &offset)) {
+        /* The frames after a dropped frame cannot be decoded until the next key frame. */
+        if (!recorder->wait_for_key_frame) {
+            syslog(LOG_WARNING, "The storage is too slow, frames are dropped");
+        }
+        recorder->wait_for_key_frame = TRUE;
+        recorder->frames_dropped++;
+        goto unlock;
+    }
+    recorder->wait_for_key_frame = FALSE;
+
+    uint64_t seq           = recorder->head_seq + recorder->count;
+    recorder_frame_t* slot = frame_at(recorder, seq);
+    memcpy(recorder->data + offset, data, size);
+    slot->offset          = offset;
+    slot->size            = size;
+    slot->capture_time_us = now_us;
+    slot->key_frame       = key_frame;
+    recorder->tail        = offset + size;
+    recorder->count++;
+
+    if (recorder->recording) {
+        /* A recording without a key frame in the ring starts at the next one. */
+        if (recorder->start_at_key_frame) {
+            recorder->start_at_key_frame = !key_frame;
+            recorder->write_seq          = key_frame ? seq : seq + 1;
+        }
+        if (recorder->end_seq == G_MAXUINT64 && now_us >= recorder->stop_at_us) {
+            recorder->end_seq = seq + 1;
+        }
+        pthread_cond_signal(&recorder->cond);
+    }
+
+unlock:
+    pthread_mutex_unlock(&recorder->mutex);
+}
+
+static void* capture_thread(void* data) {
+    recorder_t* recorder = data;
+
+    while (!g_atomic_int_get(&recorder->stopping)) {
+        GError* error     = NULL;
+        VdoBuffer* buffer = vdo_stream_get_buffer(recorder->stream, &error);
+        if (buffer == NULL) {
+            if (g_error_matches(error, VDO_ERROR, VDO_ERROR_NO_DATA)) {
+                g_clear_error(&error);
+                continue;
+            }
+            if (!g_atomic_int_get(&recorder->stopping)) {
+                syslog(LOG_ERR, "Failed to get a frame. Error: %s", error->message);
+            }
+            g_clear_error(&error);
+            break;
+        }
+
+        /* The lifetime of the frame is linked to the buffer. */
+        VdoFrame* frame        = vdo_buffer_get_frame(buffer);
+        VdoFrameType type      = vdo_frame_get_frame_type(frame);
+        const uint8_t* payload = vdo_buffer_get_data(buffer);
+        if (payload != NULL) {
+            add_frame(recorder,
+                      payload,
+                      vdo_frame_get_size(frame),
+                      type == VDO_FRAME_TYPE_H264_IDR || type == VDO_FRAME_TYPE_H264_I);
+        }
+
+        if (!vdo_stream_buffer_unref(recorder->stream, &buffer, &error)) {
+            syslog(LOG_WARNING, "Failed to release a frame. Error: %s", error->message);
+            g_clear_error(&error);
+        }
+    }
+    return NULL;
+}
+
+static gboolean write_all(recorder_t* recorder, const uint8_t* data, size_t size) {
+    while (size > 0) {
+        gint64 start_us = g_get_monotonic_time();
+        ssize_t written = write(recorder->fd, data, size);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written < 0) {
+            return FALSE;
+        }
+        storage_stats_add_write(recorder->stats, written, g_get_monotonic_time() - start_us);
+        recorder->crc = checksum_crc32(recorder->crc, data, (size_t)written);
+        data += written;
+        size -= (size_t)written;
+        recorder->unsynced += (size_t)written;
+    }
+    return TRUE;
+}
+
+static gboolean sync_file(recorder_t* recorder) {
+    gint64 start_us = g_get_monotonic_time();
+    if (fdatasync(recorder->fd) != 0) {
+        return FALSE;
+    }
+    storage_stats_add_sync(recorder->stats, g_get_monotonic_time() - start_us);
+    recorder->unsynced = 0;
+    return TRUE;
+}
+
+/**
+ * @brief Write the CRC-32 of a recording next to it, in the SFV format that
+ *        is checked with e.g. `cksfv -f event_20250101_120000.h264.sfv`.
+ */
+static void write_checksum_file(recorder_t* recorder, const gchar* file_path) {
+    GError* error   = NULL;
+    gchar* name     = g_path_get_basename(file_path);
+    gchar* path     = g_strdup_printf("%s.sfv", file_path);
+    gchar* contents = g_strdup_printf("%s %08X\n", name, recorder->crc);
+
+    if (!g_file_set_contents(path, contents, -1, &error)) {
+        syslog(LOG_WARNING, "Failed to write %s. Error: %s", path, error->message);
+        g_error_free(error);
+    }
+    g_free(contents);
+    g_free(path);
+    g_free(name);
+}
+
+static void close_file(recorder_t* recorder, const gchar* file_path) {
+    if (recorder->fd < 0) {
+        return;
+    }
+    /* Make sure the recording is on the storage before it can be released. */
+    gboolean synced = sync_file(recorder);
+    if (close(recorder->fd) != 0 || !synced) {
+        syslog(LOG_WARNING, "Failed to close %s. Error: %s", file_path, g_strerror(errno));
+    } else {
+        syslog(LOG_INFO,
+               "Recorded %" G_GUINT64_FORMAT " bytes to %s, CRC-32 %08X",
+               recorder->bytes_written,
+               file_path,
+               recorder->crc);
+        write_checksum_file(recorder, file_path);
+    }
+    recorder->fd            = -1;
+    recorder->bytes_written = 0;
+    recorder->unsynced      = 0;
+    recorder->crc           = 0;
+}
+
+/**
+ * @brief Write the frames of the recording in progress, in runs of frames that
+ *        are next to each other in the ring.
+ */
+static void* writer_thread(void* data) {
+    recorder_t* recorder = data;
+
+    pthread_mutex_lock(&recorder->mutex);
+    while (TRUE) {
+        if (!recorder->recording) {
+            if (g_atomic_int_get(&recorder->stopping)) {
+                break;
+            }
+            pthread_cond_wait(&recorder->cond, &recorder->mutex);
+            continue;
+        }
+
+        /* The file path and the statistics are only replaced when no recording
+           is in progress. */
+        const gchar* file_path = recorder->file_path;
+        if (recorder->write_seq >= recorder->end_seq) {
+            pthread_mutex_unlock(&recorder->mutex);
+            close_file(recorder, file_path);
+            pthread_mutex_lock(&recorder->mutex);
+            recorder->recording = FALSE;
+            pthread_cond_broadcast(&recorder->closed_cond);
+            continue;
+        }
+
+        uint64_t end        = MIN(recorder->end_seq, recorder->head_seq + recorder->count);
+        uint64_t num_frames = 0;
+        size_t offset       = 0;
+        size_t size         = 0;
+        while (recorder->write_seq + num_frames < end && size < MAX_WRITE_SIZE) {
+            recorder_frame_t* frame = frame_at(recorder, recorder->write_seq + num_frames);
+            if (num_frames == 0) {
+                offset = frame->offset;
+            } else if (frame->offset != offset + size) {
+                break;
+            }
+            size += frame->size;
+            num_frames++;
+        }
+
+        /* Wait for more data unless the run is cut by the end of the ring or
+           of the recording. */
+        gboolean more   = recorder->write_seq + num_frames < end;
+        gboolean enough = size >= MIN(MIN_WRITE_SIZE, recorder->capacity / 4) ||
+                          num_frames >= recorder->max_frames / 4;
+        if (num_frames == 0 || (!enough && !more && recorder->end_seq == G_MAXUINT64)) {
+            pthread_cond_wait(&recorder->cond, &recorder->mutex);
+            continue;
+        }
+
+        /* The frames from write_seq are not dropped from the ring, so they can
+           be written without the lock. */
+        pthread_mutex_unlock(&recorder->mutex);
+        gboolean written = TRUE;
+        if (recorder->fd < 0) {
+            recorder->fd = open(file_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (recorder->fd < 0) {
+                syslog(LOG_WARNING, "Failed to open %s. Error: %s", file_path, g_strerror(errno));
+                written = FALSE;
+            } else {
+                syslog(LOG_INFO, "Recording to %s", file_path);
+            }
+        }
+        if (written && !write_all(recorder, recorder->data + offset, size)) {
+            syslog(LOG_WARNING, "Failed to write to %s. Error: %s", file_path, g_strerror(errno));
+            written = FALSE;
+        }
+        if (written && recorder->unsynced >= SYNC_SIZE && !sync_file(recorder)) {
+            syslog(LOG_WARNING, "Failed to sync %s. Error: %s", file_path, g_strerror(errno));
+            written = FALSE;
+        }
+        pthread_mutex_lock(&recorder->mutex);
+
+        if (written) {
+            recorder->write_seq += num_frames;
+            recorder->bytes_written += size;
+        } else {
+            /* Stop the recording, e.g. when the storage is full. */
+            recorder->end_seq = recorder->write_seq;
+        }
+    }
+    pthread_mutex_unlock(&recorder->mutex);
+    return NULL;
+}
+
+recorder_t* recorder_new(guint pre_event_s, guint post_event_s, size_t ring_size) {
+    GError* error        = NULL;
+    VdoMap* settings     = vdo_map_new();
+    recorder_t* recorder = g_new0(recorder_t, 1);
+
+    recorder->pre_event_s  = pre_event_s;
+    recorder->post_event_s = post_event_s;
+    recorder->capacity     = ring_size;
+    recorder->data         = g_malloc(ring_size);
+    /* Room for the pre-event video and as long a backlog of the writer. */
+    recorder->max_frames = 2 * (pre_event_s + 1) * MAX_FPS;
+    recorder->frames     = g_new0(recorder_frame_t, recorder->max_frames);
+    recorder->end_seq    = G_MAXUINT64;
+    recorder->fd         = -1;
+
+    pthread_mutex_init(&recorder->mutex, NULL);
+    pthread_cond_init(&recorder->cond, NULL);
+    pthread_cond_init(&recorder->closed_cond, NULL);
+
+    vdo_map_set_uint32(settings, "format", VDO_FORMAT_H264);
+    VdoPair32u resolution = {
+        .w = 1280,
+        .h = 720,
+    };
+    vdo_map_set_pair32u(settings, "resolution", resolution);
+
+    recorder->stream = vdo_stream_new(settings, NULL, &error);
+    g_object_unref(settings);
+    if (recorder->stream == NULL) {
+        syslog(LOG_ERR, "Failed to create the video stream. Error: %s", error->message);
+        g_clear_error(&error);
+        goto error;
+    }
+    if (!vdo_stream_start(recorder->stream, &error)) {
+        syslog(LOG_ERR, "Failed to start the video stream. Error: %s", error->message);
+        g_clear_error(&error);
+        goto error;
+    }
+
+    if (pthread_create(&recorder->writer_thread, NULL, writer_thread, recorder) != 0) {
+        syslog(LOG_ERR, "Failed to create the writer thread");
+        goto error;
+    }
+    if (pthread_create(&recorder->capture_thread, NULL, capture_thread, recorder) != 0) {
+        syslog(LOG_ERR, "Failed to create the capture thread");
+        g_atomic_int_set(&recorder->stopping, TRUE);
+        pthread_mutex_lock(&recorder->mutex);
+        pthread_cond_signal(&recorder->cond);
+        pthread_mutex_unlock(&recorder->mutex);
+        pthread_join(recorder->writer_thread, NULL);
+        goto error;
+    }
+
+    syslog(LOG_INFO,
+           "Keeping %u s of video before and %u s after a trigger",
+           pre_event_s,
+           post_event_s);
+    return recorder;
+
+error:
+    if (recorder->stream != NULL) {
+        g_object_unref(recorder->stream);
+    }
+    pthread_cond_destroy(&recorder->closed_cond);
+    pthread_cond_destroy(&recorder->cond);
+    pthread_mutex_destroy(&recorder->mutex);
+    g_free(recorder->frames);
+    g_free(recorder->data);
+    g_free(recorder);
+    return NULL;
+}
+
+/**
+ * @brief Stop the recording in progress after the frames captured so far,
+ *        and wait until its file is closed.
+ *
+ * Called with the mutex locked.
+ */
+static void stop_recording(recorder_t* recorder) {
+    if (!recorder->recording) {
+        return;
+    }
+    recorder->end_seq = MIN(recorder->end_seq, recorder->head_seq + recorder->count);
+    pthread_cond_signal(&recorder->cond);
+    while (recorder->recording) {
+        pthread_cond_wait(&recorder->closed_cond, &recorder->mutex);
+    }
+}
+
+void recorder_set_storage(recorder_t* recorder, const gchar* path, storage_stats_t* stats) {
+    pthread_mutex_lock(&recorder->mutex);
+    if (g_strcmp0(path, recorder->storage_path) != 0) {
+        stop_recording(recorder);
+        g_free(recorder->storage_path);
+        recorder->storage_path = g_strdup(path);
+        recorder->stats        = stats;
+        if (path != NULL) {
+            syslog(LOG_INFO, "Recording to %s on triggers", path);
+        } else {
+            syslog(LOG_INFO, "No storage to record to");
+        }
+    }
+    pthread_mutex_unlock(&recorder->mutex);
+}
+
+void recorder_set_key_frames_only(recorder_t* recorder, gboolean key_frames_only) {
+    pthread_mutex_lock(&recorder->mutex);
+    if (key_frames_only != recorder->key_frames_only) {
+        recorder->key_frames_only = key_frames_only;
+        syslog(LOG_INFO,
+               "Recording %s frames",
+               key_frames_only ? "only the key" : "all the");
+    }
+    pthread_mutex_unlock(&recorder->mutex);
+}
+
+void recorder_trigger(recorder_t* recorder) {
+    pthread_mutex_lock(&recorder->mutex);
+
+    if (recorder->storage_path == NULL) {
+        syslog(LOG_WARNING, "No storage is ready, the trigger is ignored");
+        goto unlock;
+    }
+
+    recorder->stop_at_us = g_get_monotonic_time() + (gint64)recorder->post_event_s * G_USEC_PER_SEC;
+    if (recorder->recording) {
+        if (recorder->write_seq < recorder->end_seq) {
+            recorder->end_seq = G_MAXUINT64;
+        } else {
+            syslog(LOG_WARNING, "The previous recording is being closed, the trigger is ignored");
+        }
+        goto unlock;
+    }
+
+    /* Start at the first key frame in the ring, all frames after it are kept
+       until they are written. */
+    recorder->start_at_key_frame = TRUE;
+    recorder->write_seq          = recorder->head_seq + recorder->count;
+    for (uint64_t seq = recorder->head_seq; seq < recorder->head_seq + recorder->count; seq++) {
+        if (frame_at(recorder, seq)->key_frame) {
+            recorder->start_at_key_frame = FALSE;
+            recorder->write_seq          = seq;
+            break;
+        }
+    }
+
+    GDateTime* now = g_date_time_new_now_local();
+    gchar* time    = g_date_time_format(now, "%Y%m%d_%H%M%S");
+    g_free(recorder->file_path);
+    recorder->file_path = g_strdup_printf("%s/event_%s.h264", recorder->storage_path, time);
+    g_free(time);
+    g_date_time_unref(now);
+
+    recorder->end_seq   = G_MAXUINT64;
+    recorder->recording = TRUE;
+    pthread_cond_signal(&recorder->cond);
+
+unlock:
+    pthread_mutex_unlock(&recorder->mutex);
+}
+
+void recorder_free(recorder_t* recorder) {
+    if (recorder == NULL) {
+        return;
+    }
+
+    g_atomic_int_set(&recorder->stopping, TRUE);
+    /* Makes a waiting vdo_stream_get_buffer() return. */
+    vdo_stream_stop(recorder->stream);
+    pthread_join(recorder->capture_thread, NULL);
+
+    pthread_mutex_lock(&recorder->mutex);
+    stop_recording(recorder);
+    pthread_cond_signal(&recorder->cond);
+    pthread_mutex_unlock(&recorder->mutex);
+    pthread_join(recorder->writer_thread, NULL);
+
+    if (recorder->frames_dropped > 0) {
+        syslog(LOG_WARNING,
+               "%" G_GUINT64_FORMAT " frames were dropped since the storage was too slow",
+               recorder->frames_dropped);
+    }
+    if (recorder->frames_skipped > 0) {
+        syslog(LOG_INFO,
+               "%" G_GUINT64_FORMAT " frames that were not key frames were skipped",
+               recorder->frames_skipped);
+    }
+
+    g_object_unref(recorder->stream);
+    pthread_cond_destroy(&recorder->closed_cond);
+    pthread_cond_destroy(&recorder->cond);
+    pthread_mutex_destroy(&recorder->mutex);
+    g_free(recorder->file_path);
+    g_free(recorder->storage_path);
+    g_free(recorder->frames);
+    g_free(recorder->data);
+    g_free(recorder);
+}
@@ -0,0 +1,145 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Pre-event recording of H.264 video to a storage.
+ *
+ * The last seconds of video are kept in a ring in RAM. When the recording is
+ * triggered, the video in the ring from its first key frame is written to the
+ * storage, followed by the video until some seconds after the last trigger.
+ *
+ * The frames are captured by a thread of their own and written by another
+ * thread, in large sequential writes to one file per recording, so neither the
+ * GLib main loop nor the capture waits for the storage. The frames that are
+ * not yet written are kept in the ring, and if the storage falls so far
+ * behind that the ring is full, new frames are dropped until the next key
+ * frame.
+ *
+ * The CRC-32 of each recording is computed as it is written, and stored next
+ * to it in a file in the SFV format when it is closed.
+ *
+ * The writes and syncs are reported to the statistics of the storage. When the
+ * storage falls behind, the recorder can be set to skip the frames that are
+ * not key frames, until it has caught up.
+ */
+
+#pragma once
+
+#include <glib.h>
+#include <pthread.h>
+#include <stdint.h>
+
+#include "storage_stats.h"
+#include "vdo-stream.h"
+
+typedef struct recorder_frame {
+    size_t offset;
+    size_t size;
+    gint64 capture_time_us;
+    gboolean key_frame;
+} recorder_frame_t;
+
+typedef struct recorder {
+    guint pre_event_s;
+    guint post_event_s;
+    VdoStream* stream;
+    pthread_t capture_thread;
+    pthread_t writer_thread;
+    gint stopping;
+
+    /* The fields below are protected by mutex */
+    pthread_mutex_t mutex;
+    /* Signaled for the writer thread on new frames and triggers */
+    pthread_cond_t cond;
+    /* Signaled by the writer thread when a recording is closed */
+    pthread_cond_t closed_cond;
+
+    /* Ring of frames, the frame with sequence number seq is in frames[seq % max_frames] */
+    uint8_t* data;
+    size_t capacity;
+    size_t tail;
+    recorder_frame_t* frames;
+    guint max_frames;
+    uint64_t head_seq;
+    guint count;
+    gboolean wait_for_key_frame;
+    guint64 frames_dropped;
+    /* Skipping of the frames that are not key frames, which ends at a key frame */
+    gboolean key_frames_only;
+    gboolean skipping;
+    guint64 frames_skipped;
+
+    /* Storage to record to and its statistics, NULL when no storage is ready */
+    gchar* storage_path;
+    storage_stats_t* stats;
+    /* From the trigger until the file is closed */
+    gboolean recording;
+    gboolean start_at_key_frame;
+    /* The frames from write_seq are kept in the ring until they are written */
+    uint64_t write_seq;
+    /* End of the recording, G_MAXUINT64 until the post-event time has passed */
+    uint64_t end_seq;
+    gint64 stop_at_us;
+    gchar* file_path;
+
+    /* Only used by the writer thread */
+    int fd;
+    guint64 bytes_written;
+    size_t unsynced;
+    /* CRC-32 of the recording so far */
+    guint32 crc;
+} recorder_t;
+
+/**
+ * @brief Start the capture of H.264 video into the ring.
+ *
+ * @param pre_event_s  Seconds of video before the trigger to record.
+ * @param post_event_s Seconds of video after the last trigger to record.
+ * @param ring_size    Bytes of video to keep in RAM, for the pre-event video and
+ *                     the video not yet written.
+ *
+ * @return The recorder, or NULL on failure.
+ */
+recorder_t* recorder_new(guint pre_event_s, guint post_event_s, size_t ring_size);
+
+/**
+ * @brief Set the directory to record to, or NULL when no storage is ready.
+ *
+ * A recording to the previous storage is stopped, and the call waits until its
+ * file is closed, so the previous storage can be released after the call.
+ *
+ * @param stats Statistics of the storage, kept until the storage is replaced.
+ */
+void recorder_set_storage(recorder_t* recorder, const gchar* path, storage_stats_t* stats);
+
+/**
+ * @brief Skip the frames that are not key frames, or keep all frames again from
+ *        the next key frame.
+ *
+ * The skipped frames are neither kept for the pre-event video nor recorded, the
+ * video that is left can still be decoded.
+ */
+void recorder_set_key_frames_only(recorder_t* recorder, gboolean key_frames_only);
+
+/**
+ * @brief Start a recording, or extend the recording in progress.
+ */
+void recorder_trigger(recorder_t* recorder);
+
+/**
+ * @brief Stop the capture, close any recording and free the recorder.
+ */
+void recorder_free(recorder_t* recorder);
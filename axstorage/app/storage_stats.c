@@ -0,0 +1,125 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "storage_stats.h"
+
+#define MB (1024.0 * 1024.0)
+
+/* The storage is behind when it is busy or syncs take longer than this, by
+   throttling level. It has caught up when it is below half of it. */
+static const gdouble busy_limit[]   = {0.0, 0.5, 0.8};
+static const gint64 sync_limit_us[] = {0, 500 * 1000, 2 * G_USEC_PER_SEC};
+
+void storage_stats_init(storage_stats_t* stats) {
+    *stats = (storage_stats_t){
+        .window_start_us = g_get_monotonic_time(),
+        .throttle        = STORAGE_THROTTLE_NONE,
+    };
+    pthread_mutex_init(&stats->mutex, NULL);
+}
+
+void storage_stats_destroy(storage_stats_t* stats) {
+    pthread_mutex_destroy(&stats->mutex);
+}
+
+void storage_stats_add_write(storage_stats_t* stats, gsize bytes, gint64 duration_us) {
+    pthread_mutex_lock(&stats->mutex);
+    stats->window_bytes += bytes;
+    stats->window_busy_us += duration_us;
+    stats->bytes_written += bytes;
+    pthread_mutex_unlock(&stats->mutex);
+}
+
+void storage_stats_add_sync(storage_stats_t* stats, gint64 duration_us) {
+    pthread_mutex_lock(&stats->mutex);
+    stats->window_busy_us += duration_us;
+    stats->window_sync_us      = MAX(stats->window_sync_us, duration_us);
+    stats->max_sync_latency_us = MAX(stats->max_sync_latency_us, duration_us);
+    pthread_mutex_unlock(&stats->mutex);
+}
+
+static gboolean is_behind(storage_stats_t* stats, storage_throttle_t level) {
+    return stats->busy_fraction >= busy_limit[level] ||
+           stats->sync_latency_us >= sync_limit_us[level];
+}
+
+static gboolean has_caught_up(storage_stats_t* stats, storage_throttle_t level) {
+    return stats->busy_fraction < busy_limit[level] / 2 &&
+           stats->sync_latency_us < sync_limit_us[level] / 2;
+}
+
+storage_throttle_t storage_stats_update_throttle(storage_stats_t* stats) {
+    gint64 now_us = g_get_monotonic_time();
+    storage_throttle_t throttle;
+
+    pthread_mutex_lock(&stats->mutex);
+    gint64 elapsed_us = now_us - stats->window_start_us;
+    if (elapsed_us < STORAGE_STATS_WINDOW_S * G_USEC_PER_SEC) {
+        goto unlock;
+    }
+
+    /* Writers in parallel can together be busy for longer than the window. */
+    stats->rate          = stats->window_bytes * (gdouble)G_USEC_PER_SEC / elapsed_us;
+    stats->busy_fraction = MIN(1.0, (gdouble)stats->window_busy_us / elapsed_us);
+    if (stats->window_busy_us > 0) {
+        stats->throughput =
+            stats->window_bytes * (gdouble)G_USEC_PER_SEC / stats->window_busy_us;
+    }
+    stats->sync_latency_us = stats->window_sync_us;
+    stats->window_start_us = now_us;
+    stats->window_bytes    = 0;
+    stats->window_busy_us  = 0;
+    stats->window_sync_us  = 0;
+
+    storage_throttle_t level = stats->throttle;
+    while (level < STORAGE_THROTTLE_MINIMAL && is_behind(stats, level + 1)) {
+        level++;
+    }
+    if (level == stats->throttle && level > STORAGE_THROTTLE_NONE && has_caught_up(stats, level)) {
+        level--;
+    }
+    stats->throttle = level;
+
+unlock:
+    throttle = stats->throttle;
+    pthread_mutex_unlock(&stats->mutex);
+    return throttle;
+}
+
+gchar* storage_stats_to_string(storage_stats_t* stats) {
+    pthread_mutex_lock(&stats->mutex);
+    gchar* string = g_strdup_printf("%.2f MB/s, %.1f MB/s while writing, busy %.0f%%, "
+                                    "sync %" G_GINT64_FORMAT " ms, longest %" G_GINT64_FORMAT " ms",
+                                    stats->rate / MB,
+                                    stats->throughput / MB,
+                                    stats->busy_fraction * 100,
+                                    stats->sync_latency_us / 1000,
+                                    stats->max_sync_latency_us / 1000);
+    pthread_mutex_unlock(&stats->mutex);
+    return string;
+}
+
+const gchar* storage_throttle_name(storage_throttle_t throttle) {
+    switch (throttle) {
+        case STORAGE_THROTTLE_NONE:
+            return "none";
+        case STORAGE_THROTTLE_REDUCED:
+            return "reduced";
+        case STORAGE_THROTTLE_MINIMAL:
+            return "minimal";
+    }
+    return "unknown";
+}
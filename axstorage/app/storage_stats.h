@@ -0,0 +1,98 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Accounting of the writes to a storage, to tell when it is too slow for the
+ * data rate written to it.
+ *
+ * The writers report the duration of each write() and fdatasync(). Over
+ * windows of STORAGE_STATS_WINDOW_S seconds the statistics give the
+ * throughput of the storage while it writes, the fraction of the time it is
+ * busy and the latency of the syncs. A storage that is busy most of the time,
+ * or that takes long to sync, is falling behind, and the throttling level
+ * tells the producers to write less.
+ */
+
+#pragma once
+
+#include <glib.h>
+#include <pthread.h>
+
+#define STORAGE_STATS_WINDOW_S 10
+
+typedef enum {
+    /* Everything is written. */
+    STORAGE_THROTTLE_NONE,
+    /* Less detail is written. */
+    STORAGE_THROTTLE_REDUCED,
+    /* Only what is needed is written, such as the key frames of a recording. */
+    STORAGE_THROTTLE_MINIMAL,
+} storage_throttle_t;
+
+typedef struct storage_stats {
+    /* The writers report from threads of their own. */
+    pthread_mutex_t mutex;
+
+    gint64 window_start_us;
+    guint64 window_bytes;
+    gint64 window_busy_us;
+    gint64 window_sync_us;
+
+    /* From the last window: bytes per second written, bytes per second while
+       writing, the fraction of the time spent writing and the longest sync. */
+    gdouble rate;
+    gdouble throughput;
+    gdouble busy_fraction;
+    gint64 sync_latency_us;
+
+    /* Since the start. */
+    guint64 bytes_written;
+    gint64 max_sync_latency_us;
+
+    storage_throttle_t throttle;
+} storage_stats_t;
+
+void storage_stats_init(storage_stats_t* stats);
+void storage_stats_destroy(storage_stats_t* stats);
+
+/**
+ * @brief Report a write() of bytes that took duration_us.
+ */
+void storage_stats_add_write(storage_stats_t* stats, gsize bytes, gint64 duration_us);
+
+/**
+ * @brief Report an fdatasync() that took duration_us.
+ */
+void storage_stats_add_sync(storage_stats_t* stats, gint64 duration_us);
+
+/**
+ * @brief Update the statistics when a window has passed, and the throttling
+ *        level from them. Called every second.
+ *
+ * The level is raised as soon as the storage is busy or slow to sync, and
+ * lowered one step per window when it has well caught up, so the level does
+ * not flap.
+ *
+ * @return The new level.
+ */
+storage_throttle_t storage_stats_update_throttle(storage_stats_t* stats);
+
+/**
+ * @brief Format the statistics for a log message.
+ */
+gchar* storage_stats_to_string(storage_stats_t* stats);
+
+const gchar* storage_throttle_name(storage_throttle_t throttle);
@@ -17,6 +17,7 @@
 #include <bbox.h>
 
 #include <errno.h>
+#include <math.h>
 #include <signal.h>
 #include <stdarg.h>
 #include <stdatomic.h>
@@ -27,6 +28,8 @@
 #include <syslog.h>
 #include <unistd.h>
 
+#include "track_store.h"
+
 // Select scene or frame normalized coordinates.
 //
 // Scene coordinate system is normalized to [0,0]-[1,1] and follows the filmed scene,
@@ -218,6 +221,85 @@ static void example_clear(void) {
     bbox_destroy(bbox);
 }
 
+// Draw all tracks of the store, but only when something has changed since the last commit.
+//
+// The bbox API replaces all geometry on each commit, so when anything has changed all tracks are
+// drawn again. Tracks that have not moved beyond the tolerance keep their drawn geometry.
+static bool render_tracks(bbox_t* bbox, const track_store_t* store, const track_diff_t* diff) {
+    if (!track_diff_changed(diff))
+        return false;
+
+    bbox_clear(bbox);
+
+    size_t position = 0;
+    const track_t* track;
+    while ((track = track_store_next(store, &position)))
+        bbox_rectangle(bbox, track->box.x1, track->box.y1, track->box.x2, track->box.y2);
+
+    if (!bbox_commit(bbox, 0u))
+        panic("Failed committing: %s", strerror(errno));
+
+    return true;
+}
+
+// This example illustrates drawing tracked objects at video frame rate.
+//
+// Most objects in a scene are stationary, but the positions reported by analytics jitter a
+// little from frame to frame. The track store compares each frame with the drawn geometry and
+// only reports objects that moved more than the pixel tolerance, so nothing is committed while
+// all objects are still.
+static void example_tracked_objects(void) {
+    const unsigned int w       = 1920u;
+    const unsigned int h       = 1080u;
+    const float tolerance_px   = 2.f;
+    const unsigned int fps     = 30u;
+    const unsigned int nframes = 5u * fps;
+    const size_t nobjects      = 4u;
+    unsigned int ncommits      = 0u;
+
+    bbox_t* bbox = bbox_view_new(1u);
+    if (!bbox)
+        panic("Failed creating: %s", strerror(errno));
+
+    track_store_t* store = track_store_create(nobjects, w, h, tolerance_px);
+    if (!store)
+        panic("Failed creating track store: %s", strerror(errno));
+
+    bbox_coordinates_frame_normalized(bbox);
+    bbox_style_outline(bbox);
+    bbox_thickness_medium(bbox);
+    bbox_color(bbox, bbox_color_from_rgb(0xff, 0xff, 0x00));
+
+    for (unsigned int frame = 0u; frame < nframes && running; ++frame) {
+        track_store_begin_frame(store);
+
+        for (size_t i = 0; i < nobjects; ++i) {
+            // Sub-pixel jitter for all objects, only the last object moves across the view
+            const float jitter = 0.5f * sinf((float)(frame + 7u * i)) / (float)w;
+            const float x      = 0.1f + 0.2f * (float)i + jitter;
+            const float y      = 0.4f + (i == nobjects - 1u ? 0.002f * (float)frame : 0.f);
+
+            // The moving object leaves the view after half of the frames
+            if (i == nobjects - 1u && frame >= nframes / 2u)
+                continue;
+
+            const track_box_t box = {x, y, x + 0.1f, y + 0.15f};
+            if (!track_store_update(store, (uint32_t)i + 1u, 0, &box))
+                panic("Track store is full");
+        }
+
+        if (render_tracks(bbox, store, track_store_end_frame(store)))
+            ++ncommits;
+
+        usleep(1000000u / fps);
+    }
+
+    syslog(LOG_INFO, "Committed %u of %u frames with tracked objects", ncommits, nframes);
+
+    track_store_destroy(store);
+    bbox_destroy(bbox);
+}
+
 static void init_signals(void) {
     const struct sigaction sa = {
         .sa_handler = shutdown,
@@ -244,6 +326,8 @@ int main(void) {
 
         example_multiple_channels();
 
+        example_tracked_objects();
+
         if (once)
             syslog(LOG_INFO, "All examples succeeded.");
     }
@@ -0,0 +1,215 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * - containerExample -
+ *
+ * This application starts the containers of docker-compose.yml and stops them again when it
+ * exits. While they run it writes frames and detection results to a frame ring, see
+ * frame-ring/frame_ring.h, that the ring-consumer container reads.
+ *
+ * To keep the example free of a camera dependency the frames are synthetic: a gray NV12 frame
+ * with a bright square that moves across it, and one detection record per frame that boxes the
+ * square. A real application would copy or scale the buffers of a VDO stream into the ring.
+ */
+
+#include <errno.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <syslog.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "frame_ring.h"
+
+#define APP_DIR "/usr/local/packages/containerExample"
+// Bind mounted into the ring-consumer container as /frame-ring, see docker-compose.yml
+#define SOCKET_DIR  APP_DIR "/localdata"
+#define SOCKET_PATH SOCKET_DIR "/frames.sock"
+
+#define FRAME_WIDTH  640
+#define FRAME_HEIGHT 360
+#define FRAME_RATE   30
+#define NUM_SLOTS    8
+
+#define BACKGROUND_LUMA 64
+#define SQUARE_LUMA     235
+#define SQUARE_SIZE     120
+
+static volatile sig_atomic_t running = 1;
+
+// Print an error to syslog and exit the application if a fatal error occurs
+__attribute__((noreturn)) __attribute__((format(printf, 1, 2))) static void
+panic(const char* format, ...) {
+    va_list arg;
+    va_start(arg, format);
+    vsyslog(LOG_ERR, format, arg);
+    va_end(arg);
+    exit(1);
+}
+
+static void shutdown(int status) {
+    (void)status;
+    running = 0;
+}
+
+/**
+ * brief Run "docker compose" with the given command in the application directory.
+ *
+ * return The process id of the command, or -1 if it could not be started.
+ */
+static pid_t start_compose(const char* command) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        execlp("docker", "docker", "compose", command, (char*)NULL);
+        _exit(127);
+    }
+    if (pid < 0) {
+        syslog(LOG_ERR, "Failed to start docker compose %s: %s", command, strerror(errno));
+    }
+    return pid;
+}
+
+/**
+ * brief Draw the frame and return the position of the square, relative to the frame.
+ */
+static void draw_frame(unsigned char* frame, uint64_t frame_id, float* x, float* y) {
+    // The square crosses the frame in four seconds and bounces between the top and the bottom
+    const unsigned int x_range = FRAME_WIDTH - SQUARE_SIZE;
+    const unsigned int y_range = FRAME_HEIGHT - SQUARE_SIZE;
+    const unsigned int left    = (unsigned int)(frame_id * x_range / (4 * FRAME_RATE) % x_range);
+    const unsigned int phase   = (unsigned int)(frame_id * 2 % (2 * y_range));
+    const unsigned int top     = phase < y_range ? phase : 2 * y_range - phase;
+
+    unsigned char* luma = frame;
+    for (unsigned int row = 0; row < FRAME_HEIGHT; row++) {
+        unsigned char* line = luma + (size_t)row * FRAME_WIDTH;
+        memset(line, BACKGROUND_LUMA, FRAME_WIDTH);
+        if (row >= top && row < top + SQUARE_SIZE) {
+            memset(line + left, SQUARE_LUMA, SQUARE_SIZE);
+        }
+    }
+    // No color, the interleaved chroma plane of NV12 is neutral
+    memset(luma + FRAME_WIDTH * FRAME_HEIGHT, 128, FRAME_WIDTH * FRAME_HEIGHT / 2);
+
+    *x = (float)left / FRAME_WIDTH;
+    *y = (float)top / FRAME_HEIGHT;
+}
+
+static void write_frame(frame_ring_writer_t* ring, uint64_t frame_id, int64_t timestamp_us) {
+    uint32_t size;
+    float x;
+    float y;
+    draw_frame(frame_ring_writer_reserve(ring, &size), frame_id, &x, &y);
+    const frame_ring_info_t frame_info = {
+        .kind         = FRAME_RING_KIND_FRAME,
+        .format       = FRAME_RING_FORMAT_NV12,
+        .width        = FRAME_WIDTH,
+        .height       = FRAME_HEIGHT,
+        .stride       = FRAME_WIDTH,
+        .size         = FRAME_WIDTH * FRAME_HEIGHT * 3 / 2,
+        .frame_id     = frame_id,
+        .timestamp_us = timestamp_us,
+    };
+    frame_ring_writer_publish(ring, &frame_info);
+
+    frame_ring_detection_t* detection = frame_ring_writer_reserve(ring, &size);
+    detection->x                      = x;
+    detection->y                      = y;
+    detection->width                  = (float)SQUARE_SIZE / FRAME_WIDTH;
+    detection->height                 = (float)SQUARE_SIZE / FRAME_HEIGHT;
+    detection->score                  = 0.9f;
+    detection->label                  = 0;
+
+    const frame_ring_info_t detections_info = {
+        .kind         = FRAME_RING_KIND_DETECTIONS,
+        .size         = sizeof(frame_ring_detection_t),
+        .frame_id     = frame_id,
+        .timestamp_us = timestamp_us,
+    };
+    frame_ring_writer_publish(ring, &detections_info);
+}
+
+/***** Main function *********************************************************/
+
+/**
+ * brief Main function.
+ *
+ * Starts the containers, writes a frame to the ring at the frame rate until the application is
+ * stopped, and then stops the containers.
+ */
+int main(void) {
+    struct sigaction action = {.sa_handler = shutdown};
+    sigaction(SIGTERM, &action, NULL);
+    sigaction(SIGINT, &action, NULL);
+
+    // docker-compose.yml is found in the working directory
+    if (chdir(APP_DIR)) {
+        panic("Failed to change directory to %s: %s", APP_DIR, strerror(errno));
+    }
+    // The containers run as another user, which must be able to reach the socket
+    if (chmod(SOCKET_DIR, 0755)) {
+        panic("Failed to make %s accessible: %s", SOCKET_DIR, strerror(errno));
+    }
+
+    // Both records of a frame are in the ring at the same time, and the frame is the larger one
+    frame_ring_writer_t* ring = frame_ring_writer_create(SOCKET_PATH,
+                                                         NUM_SLOTS,
+                                                         FRAME_WIDTH * FRAME_HEIGHT * 3 / 2,
+                                                         FRAME_RING_ANY_UID);
+    if (!ring) {
+        panic("Failed to create the frame ring on %s: %s", SOCKET_PATH, strerror(errno));
+    }
+
+    pid_t compose = start_compose("up");
+
+    int num_readers = 0;
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    for (uint64_t frame_id = 0; running; frame_id++) {
+        int readers = frame_ring_writer_accept(ring);
+        if (readers != num_readers) {
+            syslog(LOG_INFO, "%d readers of the frame ring", readers);
+            num_readers = readers;
+        }
+        write_frame(ring, frame_id, (int64_t)next.tv_sec * 1000000 + next.tv_nsec / 1000);
+
+        next.tv_nsec += 1000000000 / FRAME_RATE;
+        if (next.tv_nsec >= 1000000000) {
+            next.tv_nsec -= 1000000000;
+            next.tv_sec++;
+        }
+        // Interrupted by the signal that stops the application
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+    }
+
+    // Stopping the containers also ends "docker compose up"
+    pid_t down = start_compose("down");
+    if (down > 0) {
+        waitpid(down, NULL, 0);
+    }
+    if (compose > 0) {
+        waitpid(compose, NULL, 0);
+    }
+    frame_ring_writer_destroy(ring);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,491 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define _GNU_SOURCE
+
+#include "frame_ring.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// The slots and the payloads start on a cache line
+#define FRAME_RING_ALIGNMENT 64
+
+struct frame_ring_writer {
+    int memory_fd;
+    int socket_fd;
+    // Unlinked again when the writer is destroyed
+    char* socket_path;
+    uid_t allowed_uid;
+    void* memory;
+    size_t size;
+    frame_ring_header_t* header;
+    frame_ring_slot_t* slots;
+    unsigned char* payloads;
+    bool reserved;
+
+    // Per reader the connection, to tell when it has gone, and the eventfd it waits on
+    int reader_fds[FRAME_RING_MAX_READERS];
+    int event_fds[FRAME_RING_MAX_READERS];
+    int num_readers;
+};
+
+struct frame_ring_reader {
+    int socket_fd;
+    int event_fd;
+    void* memory;
+    size_t size;
+    const frame_ring_header_t* header;
+    const frame_ring_slot_t* slots;
+    const unsigned char* payloads;
+};
+
+static size_t align_up(size_t size) {
+    return (size + FRAME_RING_ALIGNMENT - 1) / FRAME_RING_ALIGNMENT * FRAME_RING_ALIGNMENT;
+}
+
+static size_t slots_offset(void) {
+    return align_up(sizeof(frame_ring_header_t));
+}
+
+static size_t payloads_offset(uint32_t num_slots) {
+    return slots_offset() + align_up((size_t)num_slots * sizeof(frame_ring_slot_t));
+}
+
+static bool socket_address(const char* socket_path, struct sockaddr_un* address) {
+    memset(address, 0, sizeof(*address));
+    address->sun_family = AF_UNIX;
+    size_t path_size    = strlen(socket_path);
+    if (path_size >= sizeof(address->sun_path)) {
+        errno = ENAMETOOLONG;
+        return false;
+    }
+    memcpy(address->sun_path, socket_path, path_size);
+    return true;
+}
+
+static void close_reader(frame_ring_writer_t* writer, int index) {
+    close(writer->reader_fds[index]);
+    close(writer->event_fds[index]);
+    writer->num_readers--;
+    writer->reader_fds[index] = writer->reader_fds[writer->num_readers];
+    writer->event_fds[index]  = writer->event_fds[writer->num_readers];
+}
+
+frame_ring_writer_t* frame_ring_writer_create(const char* socket_path,
+                                              uint32_t num_slots,
+                                              uint32_t slot_size,
+                                              uid_t allowed_uid) {
+    if (num_slots == 0 || slot_size == 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    frame_ring_writer_t* writer = calloc(1, sizeof(frame_ring_writer_t));
+    if (!writer) {
+        return NULL;
+    }
+    writer->memory_fd   = -1;
+    writer->socket_fd   = -1;
+    writer->memory      = MAP_FAILED;
+    writer->allowed_uid = allowed_uid;
+    slot_size           = (uint32_t)align_up(slot_size);
+    writer->size        = payloads_offset(num_slots) + (size_t)num_slots * slot_size;
+
+    // Sealed to its size, so a reader never sees the memory shrink under its mapping
+    writer->memory_fd = memfd_create("frame_ring", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (writer->memory_fd < 0 || ftruncate(writer->memory_fd, (off_t)writer->size) ||
+        fcntl(writer->memory_fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL)) {
+        goto error;
+    }
+    writer->memory =
+        mmap(NULL, writer->size, PROT_READ | PROT_WRITE, MAP_SHARED, writer->memory_fd, 0);
+    if (writer->memory == MAP_FAILED) {
+        goto error;
+    }
+
+    // The memfd is zeroed, so all slots start out empty
+    writer->header            = writer->memory;
+    writer->header->magic     = FRAME_RING_MAGIC;
+    writer->header->version   = FRAME_RING_VERSION;
+    writer->header->num_slots = num_slots;
+    writer->header->slot_size = slot_size;
+    writer->slots    = (frame_ring_slot_t*)((unsigned char*)writer->memory + slots_offset());
+    writer->payloads = (unsigned char*)writer->memory + payloads_offset(num_slots);
+
+    struct sockaddr_un address;
+    if (!socket_address(socket_path, &address)) {
+        goto error;
+    }
+    writer->socket_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (writer->socket_fd < 0) {
+        goto error;
+    }
+    // The socket of an earlier writer that did not exit cleanly would make bind() fail
+    (void)unlink(socket_path);
+    if (bind(writer->socket_fd, (struct sockaddr*)&address, sizeof(address))) {
+        goto error;
+    }
+    writer->socket_path = strdup(socket_path);
+    // Connecting needs write permission, the readers are told apart by SO_PEERCRED instead
+    if (!writer->socket_path || chmod(socket_path, 0666) ||
+        listen(writer->socket_fd, FRAME_RING_MAX_READERS)) {
+        goto error;
+    }
+
+    return writer;
+
+error:;
+    int error = errno;
+    frame_ring_writer_destroy(writer);
+    errno = error;
+    return NULL;
+}
+
+void frame_ring_writer_destroy(frame_ring_writer_t* writer) {
+    if (!writer) {
+        return;
+    }
+    while (writer->num_readers > 0) {
+        close_reader(writer, 0);
+    }
+    if (writer->socket_fd >= 0) {
+        close(writer->socket_fd);
+    }
+    if (writer->socket_path) {
+        (void)unlink(writer->socket_path);
+        free(writer->socket_path);
+    }
+    // The readers keep their own mappings of the memory
+    if (writer->memory != MAP_FAILED) {
+        munmap(writer->memory, writer->size);
+    }
+    if (writer->memory_fd >= 0) {
+        close(writer->memory_fd);
+    }
+    free(writer);
+}
+
+int frame_ring_writer_socket_fd(const frame_ring_writer_t* writer) {
+    return writer->socket_fd;
+}
+
+static bool is_allowed(const frame_ring_writer_t* writer, int client_fd) {
+    if (writer->allowed_uid == FRAME_RING_ANY_UID) {
+        return true;
+    }
+    struct ucred credentials = {0};
+    socklen_t size           = sizeof(credentials);
+    return !getsockopt(client_fd, SOL_SOCKET, SO_PEERCRED, &credentials, &size) &&
+           credentials.uid == writer->allowed_uid;
+}
+
+/**
+ * @brief Send a read-only descriptor of the ring and a new eventfd, return the eventfd.
+ */
+static int send_ring(const frame_ring_writer_t* writer, int client_fd) {
+    // Reopened, since a descriptor opened for reading can only be mapped for reading
+    char path[32];
+    snprintf(path, sizeof(path), "/proc/self/fd/%d", writer->memory_fd);
+    int read_only_fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (read_only_fd < 0) {
+        return -1;
+    }
+    int event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (event_fd < 0) {
+        close(read_only_fd);
+        return -1;
+    }
+
+    int fds[2]        = {read_only_fd, event_fd};
+    char byte         = 0;
+    struct iovec data = {.iov_base = &byte, .iov_len = sizeof(byte)};
+    union {
+        struct cmsghdr header;
+        char buffer[CMSG_SPACE(sizeof(fds))];
+    } control = {0};
+    struct msghdr message = {
+        .msg_iov        = &data,
+        .msg_iovlen     = 1,
+        .msg_control    = control.buffer,
+        .msg_controllen = sizeof(control.buffer),
+    };
+    struct cmsghdr* header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level     = SOL_SOCKET;
+    header->cmsg_type      = SCM_RIGHTS;
+    header->cmsg_len       = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(header), fds, sizeof(fds));
+
+    ssize_t sent = sendmsg(client_fd, &message, MSG_NOSIGNAL);
+    close(read_only_fd);
+    if (sent < 0) {
+        close(event_fd);
+        return -1;
+    }
+    return event_fd;
+}
+
+int frame_ring_writer_accept(frame_ring_writer_t* writer) {
+    // A reader that has gone closes its connection, which then polls as readable
+    for (int i = writer->num_readers - 1; i >= 0; i--) {
+        struct pollfd reader = {.fd = writer->reader_fds[i], .events = POLLIN};
+        if (poll(&reader, 1, 0) > 0) {
+            close_reader(writer, i);
+        }
+    }
+
+    while (true) {
+        int client_fd = accept4(writer->socket_fd, NULL, NULL, SOCK_CLOEXEC);
+        if (client_fd < 0) {
+            break;
+        }
+        int event_fd = -1;
+        if (writer->num_readers < FRAME_RING_MAX_READERS && is_allowed(writer, client_fd)) {
+            event_fd = send_ring(writer, client_fd);
+        }
+        if (event_fd < 0) {
+            // The reader sees the connection closed without a descriptor
+            close(client_fd);
+            continue;
+        }
+        writer->reader_fds[writer->num_readers] = client_fd;
+        writer->event_fds[writer->num_readers]  = event_fd;
+        writer->num_readers++;
+    }
+    return writer->num_readers;
+}
+
+void* frame_ring_writer_reserve(frame_ring_writer_t* writer, uint32_t* size) {
+    uint64_t sequence = atomic_load_explicit(&writer->header->next_sequence, memory_order_relaxed);
+    uint32_t index    = (uint32_t)(sequence % writer->header->num_slots);
+    if (!writer->reserved) {
+        // The readers see the slot as being written from here on
+        atomic_store_explicit(&writer->slots[index].lock, 2 * sequence + 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+        writer->reserved = true;
+    }
+    *size = writer->header->slot_size;
+    return writer->payloads + (size_t)index * writer->header->slot_size;
+}
+
+uint64_t frame_ring_writer_publish(frame_ring_writer_t* writer, const frame_ring_info_t* info) {
+    uint32_t size;
+    frame_ring_writer_reserve(writer, &size);
+    uint64_t sequence = atomic_load_explicit(&writer->header->next_sequence, memory_order_relaxed);
+    frame_ring_slot_t* slot = &writer->slots[sequence % writer->header->num_slots];
+
+    slot->info = *info;
+    if (slot->info.size > size) {
+        slot->info.size = size;
+    }
+    atomic_store_explicit(&slot->lock, 2 * sequence + 2, memory_order_release);
+    atomic_store_explicit(&writer->header->next_sequence, sequence + 1, memory_order_release);
+    writer->reserved = false;
+
+    // Only fails for a reader that is far behind, which catches up from the ring anyway
+    const uint64_t one = 1;
+    for (int i = 0; i < writer->num_readers; i++) {
+        (void)!write(writer->event_fds[i], &one, sizeof(one));
+    }
+    return sequence;
+}
+
+/**
+ * @brief Receive the descriptors of the ring and the eventfd from the writer.
+ */
+static int receive_ring(int socket_fd, int* memory_fd, int* event_fd) {
+    int fds[2];
+    char byte         = 0;
+    struct iovec data = {.iov_base = &byte, .iov_len = sizeof(byte)};
+    union {
+        struct cmsghdr header;
+        char buffer[CMSG_SPACE(sizeof(fds))];
+    } control = {0};
+    struct msghdr message = {
+        .msg_iov        = &data,
+        .msg_iovlen     = 1,
+        .msg_control    = control.buffer,
+        .msg_controllen = sizeof(control.buffer),
+    };
+
+    ssize_t received = recvmsg(socket_fd, &message, MSG_CMSG_CLOEXEC);
+    if (received < 0) {
+        return -errno;
+    }
+    struct cmsghdr* header = CMSG_FIRSTHDR(&message);
+    if (received == 0 || !header || header->cmsg_level != SOL_SOCKET ||
+        header->cmsg_type != SCM_RIGHTS || header->cmsg_len != CMSG_LEN(sizeof(fds))) {
+        // Refused by the writer
+        return -EACCES;
+    }
+    memcpy(fds, CMSG_DATA(header), sizeof(fds));
+    *memory_fd = fds[0];
+    *event_fd  = fds[1];
+    return 0;
+}
+
+frame_ring_reader_t* frame_ring_reader_connect(const char* socket_path) {
+    frame_ring_reader_t* reader = calloc(1, sizeof(frame_ring_reader_t));
+    if (!reader) {
+        return NULL;
+    }
+    reader->socket_fd = -1;
+    reader->event_fd  = -1;
+    reader->memory    = MAP_FAILED;
+    int memory_fd     = -1;
+    int error         = 0;
+
+    struct sockaddr_un address;
+    if (!socket_address(socket_path, &address)) {
+        error = errno;
+        goto error;
+    }
+    reader->socket_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (reader->socket_fd < 0 ||
+        connect(reader->socket_fd, (struct sockaddr*)&address, sizeof(address))) {
+        error = errno;
+        goto error;
+    }
+    error = -receive_ring(reader->socket_fd, &memory_fd, &reader->event_fd);
+    if (error) {
+        goto error;
+    }
+
+    struct stat status;
+    if (fstat(memory_fd, &status)) {
+        error = errno;
+        goto error;
+    }
+    reader->size = (size_t)status.st_size;
+    if (reader->size < sizeof(frame_ring_header_t)) {
+        error = EPROTO;
+        goto error;
+    }
+    reader->memory = mmap(NULL, reader->size, PROT_READ, MAP_SHARED, memory_fd, 0);
+    if (reader->memory == MAP_FAILED) {
+        error = errno;
+        goto error;
+    }
+    // The mapping keeps the memory
+    close(memory_fd);
+    memory_fd = -1;
+
+    reader->header           = reader->memory;
+    const uint32_t num_slots = reader->header->num_slots;
+    const uint32_t slot_size = reader->header->slot_size;
+    if (reader->header->magic != FRAME_RING_MAGIC ||
+        reader->header->version != FRAME_RING_VERSION || num_slots == 0 ||
+        payloads_offset(num_slots) + (size_t)num_slots * slot_size > reader->size) {
+        error = EPROTO;
+        goto error;
+    }
+    const unsigned char* memory = reader->memory;
+    reader->slots               = (const frame_ring_slot_t*)(memory + slots_offset());
+    reader->payloads            = memory + payloads_offset(num_slots);
+    return reader;
+
+error:
+    if (memory_fd >= 0) {
+        close(memory_fd);
+    }
+    frame_ring_reader_destroy(reader);
+    errno = error;
+    return NULL;
+}
+
+void frame_ring_reader_destroy(frame_ring_reader_t* reader) {
+    if (!reader) {
+        return;
+    }
+    if (reader->memory != MAP_FAILED) {
+        munmap(reader->memory, reader->size);
+    }
+    if (reader->event_fd >= 0) {
+        close(reader->event_fd);
+    }
+    if (reader->socket_fd >= 0) {
+        close(reader->socket_fd);
+    }
+    free(reader);
+}
+
+int frame_ring_reader_wait(frame_ring_reader_t* reader, int timeout_ms) {
+    struct pollfd fds[2] = {
+        {.fd = reader->event_fd, .events = POLLIN},
+        {.fd = reader->socket_fd, .events = POLLIN},
+    };
+    int ready = poll(fds, 2, timeout_ms);
+    if (ready < 0) {
+        return -errno;
+    }
+    if (fds[1].revents) {
+        // The writer never sends anything after the descriptors, so this is its exit
+        return -EPIPE;
+    }
+    if (ready == 0) {
+        return 0;
+    }
+    uint64_t count;
+    if (read(reader->event_fd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+        return -errno;
+    }
+    return 1;
+}
+
+uint64_t frame_ring_reader_next_sequence(const frame_ring_reader_t* reader) {
+    return atomic_load_explicit(&reader->header->next_sequence, memory_order_acquire);
+}
+
+uint32_t frame_ring_reader_num_slots(const frame_ring_reader_t* reader) {
+    return reader->header->num_slots;
+}
+
+frame_ring_result_t frame_ring_reader_begin(const frame_ring_reader_t* reader,
+                                            uint64_t sequence,
+                                            frame_ring_info_t* info,
+                                            const void** payload) {
+    if (sequence >= frame_ring_reader_next_sequence(reader)) {
+        return FRAME_RING_NOT_WRITTEN;
+    }
+    uint32_t index                = (uint32_t)(sequence % reader->header->num_slots);
+    const frame_ring_slot_t* slot = &reader->slots[index];
+    if (atomic_load_explicit(&slot->lock, memory_order_acquire) != 2 * sequence + 2) {
+        return FRAME_RING_OVERWRITTEN;
+    }
+
+    *info = slot->info;
+    if (info->size > reader->header->slot_size) {
+        info->size = reader->header->slot_size;
+    }
+    *payload = reader->payloads + (size_t)index * reader->header->slot_size;
+    return FRAME_RING_OK;
+}
+
+bool frame_ring_reader_end(const frame_ring_reader_t* reader, uint64_t sequence) {
+    const frame_ring_slot_t* slot = &reader->slots[sequence % reader->header->num_slots];
+    atomic_thread_fence(memory_order_acquire);
+    return atomic_load_explicit(&slot->lock, memory_order_relaxed) == 2 * sequence + 2;
+}
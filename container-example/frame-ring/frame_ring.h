@@ -0,0 +1,202 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * This header file handles a ring of frames and detection results in shared memory, written by a
+ * native ACAP application and read by the services in its containers.
+ *
+ * The ring is a memfd that the writer hands to each reader over a Unix socket, together with an
+ * eventfd that the writer signals for every new record. The socket is a file in a directory that
+ * is bind mounted into the containers, which works with a rootless container runtime where the
+ * containers have their own network namespace, and a frame is never copied over a TCP connection.
+ *
+ * Record n is kept in slot n % num_slots until the writer wraps around to it. Each slot is a
+ * seqlock, its lock is 2n + 1 while record n is written and 2n + 2 once it is complete. A reader
+ * checks the lock before and after it has used a record in place, so the writer never waits for a
+ * slow reader and a reader can tell that a record was overwritten while it was used.
+ *
+ * The functions return NULL or a negative errno on failure and do not log, since the containers
+ * have no syslog.
+ */
+
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define FRAME_RING_MAGIC   0x474e4952  // "RING"
+#define FRAME_RING_VERSION 1
+
+#define FRAME_RING_MAX_READERS 4
+/// Allowed uid of frame_ring_writer_create() that lets any user read the ring.
+#define FRAME_RING_ANY_UID ((uid_t)-1)
+
+/// Fourcc of a VDO frame in the YUV format.
+#define FRAME_RING_FORMAT_NV12 0x3231564e  // "NV12"
+
+typedef enum frame_ring_kind {
+    FRAME_RING_KIND_FRAME      = 1,
+    FRAME_RING_KIND_DETECTIONS = 2,
+} frame_ring_kind_t;
+
+/**
+ * @brief Description of a record.
+ *
+ * A frame has its format, size and stride. A detection record holds an array of
+ * frame_ring_detection_t, for the frame with the same frame_id.
+ */
+typedef struct frame_ring_info {
+    uint32_t kind;
+    uint32_t format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t stride;
+    // Bytes of the payload that are used
+    uint32_t size;
+    uint64_t frame_id;
+    int64_t timestamp_us;
+} frame_ring_info_t;
+
+typedef struct frame_ring_detection {
+    // Relative to the frame, from 0 to 1
+    float x;
+    float y;
+    float width;
+    float height;
+    float score;
+    uint32_t label;
+} frame_ring_detection_t;
+
+typedef struct frame_ring_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t num_slots;
+    uint32_t slot_size;
+    // Sequence number of the next record to be written
+    _Atomic uint64_t next_sequence;
+} frame_ring_header_t;
+
+typedef struct frame_ring_slot {
+    _Atomic uint64_t lock;
+    frame_ring_info_t info;
+} frame_ring_slot_t;
+
+typedef enum frame_ring_result {
+    FRAME_RING_OK = 0,
+    // The record has not been written yet
+    FRAME_RING_NOT_WRITTEN,
+    // The writer has wrapped around and reused the slot of the record
+    FRAME_RING_OVERWRITTEN,
+} frame_ring_result_t;
+
+typedef struct frame_ring_writer frame_ring_writer_t;
+typedef struct frame_ring_reader frame_ring_reader_t;
+
+/**
+ * @brief Create a ring and listen for readers on a Unix socket.
+ *
+ * @param socket_path  Path of the socket, replaced if it exists and removed by
+ *                     frame_ring_writer_destroy(). Anyone that can reach it may connect.
+ * @param num_slots    Number of records the ring holds.
+ * @param slot_size    Bytes of a record, e.g. the size of a frame.
+ * @param allowed_uid  The user that may read the ring, or FRAME_RING_ANY_UID. A container that
+ *                     runs as root maps to the user of the container runtime on the device.
+ *
+ * @return Pointer to a new writer, or NULL with errno set.
+ */
+frame_ring_writer_t* frame_ring_writer_create(const char* socket_path,
+                                              uint32_t num_slots,
+                                              uint32_t slot_size,
+                                              uid_t allowed_uid);
+
+void frame_ring_writer_destroy(frame_ring_writer_t* writer);
+
+/**
+ * @brief The listening socket, readable when a reader is waiting for frame_ring_writer_accept().
+ */
+int frame_ring_writer_socket_fd(const frame_ring_writer_t* writer);
+
+/**
+ * @brief Hand the ring to the waiting readers and forget the readers that have gone.
+ *
+ * Does not block, so it can be called once per frame or when the socket is readable.
+ *
+ * @return The number of connected readers.
+ */
+int frame_ring_writer_accept(frame_ring_writer_t* writer);
+
+/**
+ * @brief The payload of the next record, to be written in place before frame_ring_writer_publish().
+ *
+ * @param size  Set to the bytes available.
+ */
+void* frame_ring_writer_reserve(frame_ring_writer_t* writer, uint32_t* size);
+
+/**
+ * @brief Complete the reserved record and wake the readers.
+ *
+ * @return The sequence number of the record.
+ */
+uint64_t frame_ring_writer_publish(frame_ring_writer_t* writer, const frame_ring_info_t* info);
+
+/**
+ * @brief Connect to a writer and map its ring read-only.
+ *
+ * @return Pointer to a new reader, or NULL with errno set.
+ */
+frame_ring_reader_t* frame_ring_reader_connect(const char* socket_path);
+
+void frame_ring_reader_destroy(frame_ring_reader_t* reader);
+
+/**
+ * @brief Wait for new records.
+ *
+ * @param timeout_ms  Longest time to wait, -1 for no limit.
+ *
+ * @return 1 if there are new records, 0 at the timeout, or a negative errno, -EPIPE when the
+ *         writer has gone.
+ */
+int frame_ring_reader_wait(frame_ring_reader_t* reader, int timeout_ms);
+
+/**
+ * @brief Sequence number of the next record the writer will publish.
+ */
+uint64_t frame_ring_reader_next_sequence(const frame_ring_reader_t* reader);
+
+uint32_t frame_ring_reader_num_slots(const frame_ring_reader_t* reader);
+
+/**
+ * @brief Start using a record in place.
+ *
+ * @param info     Set to the description of the record.
+ * @param payload  Set to the payload of the record.
+ *
+ * @return FRAME_RING_OK if the record can be used until frame_ring_reader_end().
+ */
+frame_ring_result_t frame_ring_reader_begin(const frame_ring_reader_t* reader,
+                                            uint64_t sequence,
+                                            frame_ring_info_t* info,
+                                            const void** payload);
+
+/**
+ * @brief Stop using a record.
+ *
+ * @return False if the writer changed the record while it was used, then anything computed from
+ *         it must be thrown away.
+ */
+bool frame_ring_reader_end(const frame_ring_reader_t* reader, uint64_t sequence);
@@ -0,0 +1,169 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * A containerized service that reads the frames and detection results of a native ACAP
+ * application from its frame ring, see frame_ring.h.
+ *
+ * The frames are used in place. As an example of the analysis a heavier model would do, the mean
+ * luma of each frame is computed, and once per second the rate and the last results are printed
+ * to the container log. The path of the socket is taken from FRAME_RING_SOCKET.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "frame_ring.h"
+
+#define DEFAULT_SOCKET_PATH "/frame-ring/frames.sock"
+#define REPORT_INTERVAL_S   1
+
+typedef struct report {
+    unsigned int frames;
+    unsigned int dropped;
+    uint64_t frame_id;
+    unsigned int mean_luma;
+    unsigned int detections;
+} report_t;
+
+static volatile sig_atomic_t running = 1;
+
+static void shutdown(int status) {
+    (void)status;
+    running = 0;
+}
+
+static unsigned int mean_luma(const frame_ring_info_t* info, const unsigned char* frame) {
+    // The luma plane of NV12 comes first, one byte per pixel
+    uint64_t sum = 0;
+    for (uint32_t y = 0; y < info->height; y++) {
+        const unsigned char* row = frame + (size_t)y * info->stride;
+        for (uint32_t x = 0; x < info->width; x++) {
+            sum += row[x];
+        }
+    }
+    uint64_t num_pixels = (uint64_t)info->width * info->height;
+    return num_pixels ? (unsigned int)(sum / num_pixels) : 0;
+}
+
+static void read_record(const frame_ring_reader_t* reader, uint64_t sequence, report_t* report) {
+    frame_ring_info_t info;
+    const void* payload;
+    if (frame_ring_reader_begin(reader, sequence, &info, &payload) != FRAME_RING_OK) {
+        report->dropped++;
+        return;
+    }
+
+    unsigned int luma       = 0;
+    unsigned int detections = 0;
+    if (info.kind == FRAME_RING_KIND_FRAME && info.format == FRAME_RING_FORMAT_NV12 &&
+        info.width <= info.stride && (uint64_t)info.stride * info.height <= info.size) {
+        luma = mean_luma(&info, payload);
+    } else if (info.kind == FRAME_RING_KIND_DETECTIONS) {
+        detections = info.size / sizeof(frame_ring_detection_t);
+    }
+
+    // The results only count if the writer did not reuse the slot meanwhile
+    if (!frame_ring_reader_end(reader, sequence)) {
+        report->dropped++;
+        return;
+    }
+    if (info.kind == FRAME_RING_KIND_FRAME) {
+        report->frames++;
+        report->frame_id  = info.frame_id;
+        report->mean_luma = luma;
+    } else if (info.kind == FRAME_RING_KIND_DETECTIONS) {
+        report->detections = detections;
+    }
+}
+
+static void consume(frame_ring_reader_t* reader) {
+    report_t report   = {0};
+    uint64_t next     = frame_ring_reader_next_sequence(reader);
+    time_t next_print = time(NULL) + REPORT_INTERVAL_S;
+
+    while (running) {
+        int status = frame_ring_reader_wait(reader, 500);
+        if (status < 0 && status != -EINTR) {
+            printf("The frame ring is closed: %s\n", strerror(-status));
+            return;
+        }
+
+        uint64_t newest = frame_ring_reader_next_sequence(reader);
+        // Records the writer has already overwritten are skipped
+        if (newest - next > frame_ring_reader_num_slots(reader)) {
+            uint64_t first = newest - frame_ring_reader_num_slots(reader);
+            report.dropped += (unsigned int)(first - next);
+            next = first;
+        }
+        for (; next < newest; next++) {
+            read_record(reader, next, &report);
+        }
+
+        if (time(NULL) >= next_print) {
+            printf("%u frames/s, %u dropped, frame %" PRIu64 " has mean luma %u and %u detections\n",
+                   report.frames / REPORT_INTERVAL_S,
+                   report.dropped,
+                   report.frame_id,
+                   report.mean_luma,
+                   report.detections);
+            fflush(stdout);
+            report.frames  = 0;
+            report.dropped = 0;
+            next_print     = time(NULL) + REPORT_INTERVAL_S;
+        }
+    }
+}
+
+int main(void) {
+    const char* socket_path = getenv("FRAME_RING_SOCKET");
+    if (!socket_path || !*socket_path) {
+        socket_path = DEFAULT_SOCKET_PATH;
+    }
+
+    struct sigaction action = {.sa_handler = shutdown};
+    sigaction(SIGTERM, &action, NULL);
+    sigaction(SIGINT, &action, NULL);
+
+    // The native application may start after the container, or be restarted
+    int last_error = 0;
+    while (running) {
+        frame_ring_reader_t* reader = frame_ring_reader_connect(socket_path);
+        if (!reader) {
+            if (errno != last_error) {
+                printf("Waiting for the frame ring on %s: %s\n", socket_path, strerror(errno));
+                fflush(stdout);
+                last_error = errno;
+            }
+            sleep(1);
+            continue;
+        }
+        printf("Reading the frame ring on %s\n", socket_path);
+        fflush(stdout);
+        last_error = 0;
+
+        consume(reader);
+        frame_ring_reader_destroy(reader);
+    }
+
+    return EXIT_SUCCESS;
+}
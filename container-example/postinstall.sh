@@ -1,2 +1,3 @@
 #!/bin/sh
 docker load -i alpine.tar
+docker load -i ring-consumer.tar
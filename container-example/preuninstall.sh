@@ -1,2 +1,3 @@
 #!/bin/sh
 docker image rm alpine:3.19.1
+docker image rm ring-consumer:1.0
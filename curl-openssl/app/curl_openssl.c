@@ -20,6 +20,11 @@
 #include <stdio.h>
 #include <syslog.h>
 
+#include "download.h"
+
+#define CA_CERT_FILE  "/usr/local/packages/curl_openssl/cacert.pem"
+#define DOWNLOAD_FILE "/usr/local/packages/curl_openssl/localdata/www.example.com.download.txt"
+
 /***** Struct declarations ****************************************************/
 
 struct File {
@@ -54,55 +59,17 @@ static size_t write_to_file(void* buffer, size_t size, size_t nmemb, void* strea
  *
  * param curl   − The curl handle managing the callback
  * param sslctx − A pointer to a OpenSSL context.
- * param parm   − The pointer set by CURLOPT_SSL_CTX_DATA to pass a certificate
- *                in memory to the callback. Is not used here.
+ * param parm   − The pointer set by CURLOPT_SSL_CTX_DATA, the X509 certificate
+ *                store with the CA certificate. The certificate is parsed once
+ *                and the store is shared by every connection, instead of
+ *                reading the PEM file for each of them.
  */
 static CURLcode sslctx_function(CURL* curl, void* sslctx, void* parm) {
-    FILE* fp;
-    CURLcode rv = CURLE_ABORTED_BY_CALLBACK;
-    X509_STORE* store;
-    STACK_OF(X509_INFO) * inf;
-    int i;
     (void)curl;
-    (void)parm;
-
-    // Get a pointer to the X509 certificate store
-    store = SSL_CTX_get_cert_store((SSL_CTX*)sslctx);
-    if (!store) {
-        return rv;
-    }
-
-    // Open PEM formatted certificate file
-    fp = fopen("/usr/local/packages/curl_openssl/cacert.pem", "r");
-    if (fp == NULL) {
-        syslog(LOG_INFO, "*** Open CA-cert file failed ***");
-        return rv;
-    }
-
-    // Read the certificate in to a X509_INFO object
-    inf = PEM_X509_INFO_read(fp, NULL, NULL, NULL);
-    if (!inf) {
-        fclose(fp);
-        return rv;
-    }
-
-    // Add the certificate and CRL to the store
-    for (i = 0; i < sk_X509_INFO_num(inf); i++) {
-        X509_INFO* itmp = sk_X509_INFO_value(inf, i);
-        if (itmp->x509) {
-            X509_STORE_add_cert(store, itmp->x509);
-        }
-        if (itmp->crl) {
-            X509_STORE_add_crl(store, itmp->crl);
-        }
-    }
-
-    // Cleanup
-    sk_X509_INFO_pop_free(inf, X509_INFO_free);
-    fclose(fp);
 
-    rv = CURLE_OK;
-    return rv;
+    // Replace the certificate store of the context, which takes a reference to it
+    SSL_CTX_set1_cert_store((SSL_CTX*)sslctx, (X509_STORE*)parm);
+    return CURLE_OK;
 }
 
 /***** Main *******************************************************************/
@@ -126,6 +93,11 @@ int main(void) {
     // This function sets up the program environment that libcurl needs
     curl_global_init(CURL_GLOBAL_DEFAULT);
 
+    // Parse the CA certificate once, for all connections
+    X509_STORE* ca_store = load_ca_store(CA_CERT_FILE);
+    if (!ca_store)
+        syslog(LOG_INFO, "*** Failed to load the CA-cert ***");
+
     /**
      * This function must be the first function to be called, and it returns a
      * CURL easy handle that you must use as input to other functions in the easy
@@ -206,6 +178,7 @@ int main(void) {
          * "modifications" to the SSL CONTEXT just before link init
          */
         curl_easy_setopt(curl, CURLOPT_SSL_CTX_FUNCTION, sslctx_function);
+        curl_easy_setopt(curl, CURLOPT_SSL_CTX_DATA, ca_store);
 
         syslog(LOG_INFO, "*** 2. Transfer requested with CA-cert ***");
         rv = curl_easy_perform(curl);
@@ -221,6 +194,22 @@ int main(void) {
             fclose(fetch_file.stream);
         curl_easy_cleanup(curl);
     }
+
+    /**
+     * Third try: Download the page with the download engine, which fetches
+     * large files in parallel ranges and resumes interrupted downloads
+     */
+    struct Downloader* downloader = ca_store ? downloader_new(ca_store) : NULL;
+    if (downloader) {
+        syslog(LOG_INFO, "*** 3. Download requested with the download engine ***");
+        if (downloader_fetch(downloader, "https://www.example.com/", DOWNLOAD_FILE))
+            syslog(LOG_INFO, "*** 3. Download Succeeded ***");
+        else
+            syslog(LOG_INFO, "*** 3. Download Failed ***");
+        downloader_free(downloader);
+    }
+
+    X509_STORE_free(ca_store);
     // Cleanup of curl global environment
     curl_global_cleanup();
 }
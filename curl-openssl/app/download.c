@@ -0,0 +1,567 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define _GNU_SOURCE
+
+#include "download.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <openssl/pem.h>
+#include <openssl/ssl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <syslog.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MIN(a, b) ((a) < (b) ? (a) : (b))
+
+/***** Struct declarations ****************************************************/
+
+struct Download;
+
+struct Part {
+    struct Download* download;
+    CURL* handle;
+    bool active;
+    // The bytes [start, end) of the file, end is -1 for the rest of the file
+    curl_off_t start;
+    curl_off_t end;
+    // Bytes from start that are written to the file, and were when the
+    // transfer was started
+    curl_off_t written;
+    curl_off_t written_at_start;
+    // Response status that the data is expected with
+    long expected_status;
+    char* buffer;
+    size_t used;
+    int retries;
+};
+
+struct Download {
+    char* part_path;
+    char* state_path;
+    int fd;
+    // Size of the file, or -1 if not known
+    curl_off_t size;
+    // If the server can send ranges of the file, which makes it resumable
+    bool ranges;
+    int num_parts;
+    struct Part parts[DOWNLOAD_MAX_PARALLEL];
+    long num_connections;
+};
+
+/***** Certificates ***********************************************************/
+
+X509_STORE* load_ca_store(const char* path) {
+    FILE* fp = fopen(path, "r");
+    if (fp == NULL) {
+        syslog(LOG_INFO, "*** Open CA-cert file failed ***");
+        return NULL;
+    }
+
+    STACK_OF(X509_INFO)* inf = PEM_X509_INFO_read(fp, NULL, NULL, NULL);
+    fclose(fp);
+    if (!inf) {
+        return NULL;
+    }
+
+    X509_STORE* store = X509_STORE_new();
+    for (int i = 0; store && i < sk_X509_INFO_num(inf); i++) {
+        X509_INFO* itmp = sk_X509_INFO_value(inf, i);
+        if (itmp->x509) {
+            X509_STORE_add_cert(store, itmp->x509);
+        }
+        if (itmp->crl) {
+            X509_STORE_add_crl(store, itmp->crl);
+        }
+    }
+    sk_X509_INFO_pop_free(inf, X509_INFO_free);
+    return store;
+}
+
+/**
+ * brief SSL context callback that makes a new connection use the parsed store.
+ *
+ * param parm − The X509_STORE set by CURLOPT_SSL_CTX_DATA.
+ */
+static CURLcode use_ca_store(CURL* curl, void* sslctx, void* parm) {
+    (void)curl;
+    // Takes a reference, the certificates are not parsed again
+    SSL_CTX_set1_cert_store((SSL_CTX*)sslctx, (X509_STORE*)parm);
+    return CURLE_OK;
+}
+
+/***** Downloader *************************************************************/
+
+struct Downloader* downloader_new(X509_STORE* ca_store) {
+    struct Downloader* downloader = calloc(1, sizeof(*downloader));
+    if (!downloader) {
+        return NULL;
+    }
+    downloader->share = curl_share_init();
+    downloader->multi = curl_multi_init();
+    if (!downloader->share || !downloader->multi || !X509_STORE_up_ref(ca_store)) {
+        curl_share_cleanup(downloader->share);
+        curl_multi_cleanup(downloader->multi);
+        free(downloader);
+        return NULL;
+    }
+    downloader->ca_store = ca_store;
+
+    // All transfers are made from this thread, so the share needs no locks
+    curl_share_setopt(downloader->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(downloader->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    curl_share_setopt(downloader->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+    curl_multi_setopt(downloader->multi, CURLMOPT_PIPELINING, (long)CURLPIPE_MULTIPLEX);
+    return downloader;
+}
+
+void downloader_free(struct Downloader* downloader) {
+    if (!downloader) {
+        return;
+    }
+    curl_multi_cleanup(downloader->multi);
+    curl_share_cleanup(downloader->share);
+    X509_STORE_free(downloader->ca_store);
+    free(downloader);
+}
+
+static CURL* new_handle(struct Downloader* downloader, const char* url) {
+    CURL* handle = curl_easy_init();
+    if (!handle) {
+        return NULL;
+    }
+    curl_easy_setopt(handle, CURLOPT_URL, url);
+#ifdef APP_DEBUG
+    curl_easy_setopt(handle, CURLOPT_VERBOSE, 1L);
+#endif
+    curl_easy_setopt(handle, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(handle, CURLOPT_SHARE, downloader->share);
+    curl_easy_setopt(handle, CURLOPT_SSL_VERIFYHOST, 2L);
+    curl_easy_setopt(handle, CURLOPT_SSL_VERIFYPEER, 1L);
+    curl_easy_setopt(handle, CURLOPT_CAINFO, NULL);
+    curl_easy_setopt(handle, CURLOPT_CAPATH, NULL);
+    curl_easy_setopt(handle, CURLOPT_SSL_CTX_FUNCTION, use_ca_store);
+    curl_easy_setopt(handle, CURLOPT_SSL_CTX_DATA, downloader->ca_store);
+    curl_easy_setopt(handle, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(handle, CURLOPT_PIPEWAIT, 1L);
+    curl_easy_setopt(handle, CURLOPT_BUFFERSIZE, 256L * 1024);
+    return handle;
+}
+
+/***** Probing the file *******************************************************/
+
+static size_t read_header(char* buffer, size_t size, size_t nitems, void* userdata) {
+    static const char accept_ranges[] = "Accept-Ranges: bytes";
+    size_t length                     = size * nitems;
+    if (length >= sizeof(accept_ranges) - 1 &&
+        strncasecmp(buffer, accept_ranges, sizeof(accept_ranges) - 1) == 0) {
+        *(bool*)userdata = true;
+    }
+    return length;
+}
+
+/**
+ * brief Ask the server for the size of the file and if it can send ranges.
+ */
+static bool probe(struct Downloader* downloader, const char* url, struct Download* download) {
+    CURL* handle = new_handle(downloader, url);
+    if (!handle) {
+        return false;
+    }
+    curl_easy_setopt(handle, CURLOPT_NOBODY, 1L);
+    curl_easy_setopt(handle, CURLOPT_HEADERFUNCTION, read_header);
+    curl_easy_setopt(handle, CURLOPT_HEADERDATA, &download->ranges);
+
+    long status     = 0;
+    long connects   = 0;
+    CURLcode rv     = curl_easy_perform(handle);
+    download->size  = -1;
+    curl_easy_getinfo(handle, CURLINFO_RESPONSE_CODE, &status);
+    curl_easy_getinfo(handle, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &download->size);
+    curl_easy_getinfo(handle, CURLINFO_NUM_CONNECTS, &connects);
+    download->num_connections += connects;
+    curl_easy_cleanup(handle);
+
+    if (rv != CURLE_OK || status != 200) {
+        syslog(LOG_ERR, "Failed to probe %s: %s, status %ld", url, curl_easy_strerror(rv), status);
+        return false;
+    }
+    // Without a size the file can not be split
+    download->ranges = download->ranges && download->size > 0;
+    return true;
+}
+
+/***** Progress ***************************************************************/
+
+/**
+ * brief Store the progress of the parts, if the download can be resumed.
+ */
+static bool save_state(struct Download* download) {
+    if (!download->ranges) {
+        return true;
+    }
+    FILE* fp = fopen(download->state_path, "w");
+    if (!fp) {
+        syslog(LOG_ERR, "Failed to open %s: %s", download->state_path, strerror(errno));
+        return false;
+    }
+    fprintf(fp, "%" CURL_FORMAT_CURL_OFF_T " %d\n", download->size, download->num_parts);
+    for (int i = 0; i < download->num_parts; i++) {
+        const struct Part* part = &download->parts[i];
+        fprintf(fp,
+                "%" CURL_FORMAT_CURL_OFF_T " %" CURL_FORMAT_CURL_OFF_T " %" CURL_FORMAT_CURL_OFF_T
+                "\n",
+                part->start,
+                part->end,
+                part->written);
+    }
+    return fclose(fp) == 0;
+}
+
+/**
+ * brief Read the progress of an earlier download of the same file.
+ *
+ * return true if there is one, with the parts set from it.
+ */
+static bool load_state(struct Download* download) {
+    FILE* fp = fopen(download->state_path, "r");
+    if (!fp) {
+        return false;
+    }
+    curl_off_t size = -1;
+    int num_parts   = 0;
+    bool valid      = fscanf(fp, "%" CURL_FORMAT_CURL_OFF_T " %d", &size, &num_parts) == 2 &&
+                 size == download->size && num_parts > 0 && num_parts <= DOWNLOAD_MAX_PARALLEL;
+    for (int i = 0; valid && i < num_parts; i++) {
+        struct Part* part = &download->parts[i];
+        valid             = fscanf(fp,
+                           "%" CURL_FORMAT_CURL_OFF_T " %" CURL_FORMAT_CURL_OFF_T
+                           " %" CURL_FORMAT_CURL_OFF_T,
+                           &part->start,
+                           &part->end,
+                           &part->written) == 3 &&
+                part->start >= 0 && part->start <= part->end && part->end <= size &&
+                part->written >= 0 && part->written <= part->end - part->start;
+    }
+    fclose(fp);
+    if (valid) {
+        download->num_parts = num_parts;
+    }
+    return valid;
+}
+
+/**
+ * brief Split the file in parts of at least DOWNLOAD_MIN_PART_SIZE.
+ */
+static void plan_parts(struct Download* download) {
+    if (!download->ranges) {
+        download->num_parts = 1;
+        download->parts[0]  = (struct Part){.start = 0, .end = -1};
+        return;
+    }
+    curl_off_t num_parts = download->size / DOWNLOAD_MIN_PART_SIZE;
+    download->num_parts  = (int)MIN(DOWNLOAD_MAX_PARALLEL, num_parts > 1 ? num_parts : 1);
+    curl_off_t part_size = download->size / download->num_parts;
+    for (int i = 0; i < download->num_parts; i++) {
+        curl_off_t end = i == download->num_parts - 1 ? download->size : (i + 1) * part_size;
+        download->parts[i] = (struct Part){.start = i * part_size, .end = end};
+    }
+}
+
+/**
+ * brief Open the file to fetch to, resuming an earlier download if there is one.
+ *
+ * return The number of bytes already fetched, or -1 on failure.
+ */
+static curl_off_t open_part_file(struct Download* download) {
+    if (download->ranges && load_state(download)) {
+        download->fd = open(download->part_path, O_WRONLY | O_CLOEXEC);
+        if (download->fd >= 0) {
+            curl_off_t fetched = 0;
+            for (int i = 0; i < download->num_parts; i++) {
+                fetched += download->parts[i].written;
+            }
+            return fetched;
+        }
+    }
+
+    plan_parts(download);
+    download->fd = open(download->part_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (download->fd < 0) {
+        syslog(LOG_ERR, "Failed to open %s: %s", download->part_path, strerror(errno));
+        return -1;
+    }
+    if (download->ranges && ftruncate(download->fd, download->size) != 0) {
+        syslog(LOG_ERR, "Failed to allocate %s: %s", download->part_path, strerror(errno));
+        return -1;
+    }
+    return save_state(download) ? 0 : -1;
+}
+
+/***** Transfers **************************************************************/
+
+/**
+ * brief Write the buffered data of a part at its offset in the file.
+ */
+static bool flush_part(struct Part* part) {
+    size_t done = 0;
+    while (done < part->used) {
+        ssize_t written = pwrite(part->download->fd,
+                                 part->buffer + done,
+                                 part->used - done,
+                                 part->start + part->written + (curl_off_t)done);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written < 0) {
+            syslog(LOG_ERR, "Failed to write %s: %s", part->download->part_path, strerror(errno));
+            return false;
+        }
+        done += (size_t)written;
+    }
+    part->written += (curl_off_t)part->used;
+    part->used = 0;
+    return save_state(part->download);
+}
+
+/**
+ * brief Callback function called when there is data of a part, which is
+ *       collected in the buffer of the part.
+ */
+static size_t write_to_part(char* data, size_t size, size_t nmemb, void* userdata) {
+    struct Part* part = userdata;
+    size_t length     = size * nmemb;
+
+    // E.g. an error page, or the whole file when a range was asked for
+    long status = 0;
+    curl_easy_getinfo(part->handle, CURLINFO_RESPONSE_CODE, &status);
+    if (status != part->expected_status) {
+        syslog(LOG_ERR, "Got status %ld, expected %ld", status, part->expected_status);
+        return 0;
+    }
+    if (part->end >= 0 &&
+        part->start + part->written + (curl_off_t)(part->used + length) > part->end) {
+        syslog(LOG_ERR, "Got more data than asked for");
+        return 0;
+    }
+
+    size_t copied = 0;
+    while (copied < length) {
+        if (part->used == DOWNLOAD_BUFFER_SIZE && !flush_part(part)) {
+            return 0;
+        }
+        size_t n = MIN(length - copied, DOWNLOAD_BUFFER_SIZE - part->used);
+        memcpy(part->buffer + part->used, data + copied, n);
+        part->used += n;
+        copied += n;
+    }
+    return length;
+}
+
+/**
+ * brief Start the transfer of the rest of a part.
+ */
+static void start_part(struct Downloader* downloader, struct Part* part) {
+    struct Download* download = part->download;
+    curl_off_t offset         = part->start + part->written;
+
+    part->written_at_start = part->written;
+    part->expected_status  = 200;
+    if (download->ranges && part->end == download->size) {
+        // The rest of the file, which is the whole file from offset 0
+        curl_easy_setopt(part->handle, CURLOPT_RESUME_FROM_LARGE, offset);
+        part->expected_status = offset > 0 ? 206 : 200;
+    } else if (download->ranges) {
+        char range[64];
+        snprintf(range,
+                 sizeof(range),
+                 "%" CURL_FORMAT_CURL_OFF_T "-%" CURL_FORMAT_CURL_OFF_T,
+                 offset,
+                 part->end - 1);
+        curl_easy_setopt(part->handle, CURLOPT_RANGE, range);
+        part->expected_status = 206;
+    }
+    curl_multi_add_handle(downloader->multi, part->handle);
+    part->active = true;
+}
+
+static bool part_is_complete(const struct Part* part) {
+    return part->end >= 0 && part->written == part->end - part->start;
+}
+
+/**
+ * brief Handle a finished transfer of a part.
+ *
+ * return false if the part failed and can not be resumed.
+ */
+static bool finish_part(struct Downloader* downloader, struct Part* part, CURLcode rv) {
+    long connects = 0;
+    curl_easy_getinfo(part->handle, CURLINFO_NUM_CONNECTS, &connects);
+    part->download->num_connections += connects;
+    curl_multi_remove_handle(downloader->multi, part->handle);
+    part->active = false;
+
+    // The data received is valid also when the transfer failed
+    if (!flush_part(part)) {
+        return false;
+    }
+    if (rv == CURLE_OK && (part->end < 0 || part_is_complete(part))) {
+        return true;
+    }
+    // Only transfers in a row that fail without any data count as retries
+    if (part->written > part->written_at_start) {
+        part->retries = 0;
+    }
+    if (!part->download->ranges || part->retries == DOWNLOAD_RETRIES) {
+        syslog(LOG_ERR, "Transfer failed: %s", curl_easy_strerror(rv));
+        return false;
+    }
+
+    part->retries++;
+    syslog(LOG_WARNING,
+           "Transfer failed: %s, resuming at %" CURL_FORMAT_CURL_OFF_T,
+           curl_easy_strerror(rv),
+           part->start + part->written);
+    start_part(downloader, part);
+    return true;
+}
+
+static bool transfer(struct Downloader* downloader, const char* url, struct Download* download) {
+    for (int i = 0; i < download->num_parts; i++) {
+        struct Part* part = &download->parts[i];
+        part->download    = download;
+        part->buffer      = malloc(DOWNLOAD_BUFFER_SIZE);
+        part->handle      = new_handle(downloader, url);
+        if (!part->buffer || !part->handle) {
+            return false;
+        }
+        curl_easy_setopt(part->handle, CURLOPT_WRITEFUNCTION, write_to_part);
+        curl_easy_setopt(part->handle, CURLOPT_WRITEDATA, part);
+        curl_easy_setopt(part->handle, CURLOPT_PRIVATE, part);
+        if (!part_is_complete(part)) {
+            start_part(downloader, part);
+        }
+    }
+
+    int running = 1;
+    while (running > 0) {
+        CURLMcode mrv = curl_multi_perform(downloader->multi, &running);
+        if (mrv != CURLM_OK) {
+            syslog(LOG_ERR, "curl_multi_perform failed: %s", curl_multi_strerror(mrv));
+            return false;
+        }
+
+        CURLMsg* msg;
+        int queued;
+        while ((msg = curl_multi_info_read(downloader->multi, &queued))) {
+            if (msg->msg != CURLMSG_DONE) {
+                continue;
+            }
+            struct Part* part;
+            CURLcode rv = msg->data.result;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &part);
+            if (!finish_part(downloader, part, rv)) {
+                return false;
+            }
+            // A resumed part is running again
+            running += part->active;
+        }
+
+        if (running > 0) {
+            mrv = curl_multi_poll(downloader->multi, NULL, 0, 1000, NULL);
+            if (mrv != CURLM_OK) {
+                syslog(LOG_ERR, "curl_multi_poll failed: %s", curl_multi_strerror(mrv));
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static void cleanup_parts(struct Downloader* downloader, struct Download* download) {
+    for (int i = 0; i < download->num_parts; i++) {
+        struct Part* part = &download->parts[i];
+        if (part->active) {
+            curl_multi_remove_handle(downloader->multi, part->handle);
+        }
+        curl_easy_cleanup(part->handle);
+        free(part->buffer);
+    }
+}
+
+static double seconds_since(const struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+bool downloader_fetch(struct Downloader* downloader, const char* url, const char* path) {
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    struct Download download = {.fd = -1};
+    bool complete            = false;
+    curl_off_t fetched       = -1;
+    if (asprintf(&download.part_path, "%s.part", path) < 0 ||
+        asprintf(&download.state_path, "%s.part.state", path) < 0) {
+        goto out;
+    }
+    if (!probe(downloader, url, &download)) {
+        goto out;
+    }
+    fetched = open_part_file(&download);
+    if (fetched < 0) {
+        goto out;
+    }
+    if (fetched > 0) {
+        syslog(LOG_INFO, "Resuming %s at %" CURL_FORMAT_CURL_OFF_T " bytes", path, fetched);
+    }
+
+    complete = transfer(downloader, url, &download) && fdatasync(download.fd) == 0;
+    cleanup_parts(downloader, &download);
+    if (complete) {
+        complete = rename(download.part_path, path) == 0;
+        unlink(download.state_path);
+    }
+
+out:
+    if (download.fd >= 0) {
+        close(download.fd);
+    }
+    if (complete) {
+        struct stat st;
+        double seconds = seconds_since(&start);
+        stat(path, &st);
+        syslog(LOG_INFO,
+               "Downloaded %lld bytes to %s in %d parts over %ld connections, %.1f MB/s",
+               (long long)st.st_size,
+               path,
+               download.num_parts,
+               download.num_connections,
+               (double)(st.st_size - (fetched > 0 ? fetched : 0)) / seconds / (1024 * 1024));
+    } else {
+        syslog(LOG_ERR, "Failed to download %s", url);
+    }
+    free(download.part_path);
+    free(download.state_path);
+    return complete;
+}
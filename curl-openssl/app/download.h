@@ -0,0 +1,82 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Download engine for large files, e.g. model files and firmware assets.
+ *
+ * A file that the server can send in ranges is split in up to
+ * DOWNLOAD_MAX_PARALLEL parts that are fetched in parallel with a curl multi
+ * handle. The data of each part is collected in a buffer of
+ * DOWNLOAD_BUFFER_SIZE and written at its offset in the file when the buffer
+ * is full, so the storage gets few large writes.
+ *
+ * The file is fetched to <path>.part and renamed to <path> when it is
+ * complete. The progress of the parts is kept in <path>.part.state, so an
+ * interrupted download is resumed where it stopped, both when a transfer
+ * fails and the next time the file is fetched.
+ *
+ * The CA certificates are parsed once into an X509_STORE that is shared by
+ * all connections, and the connections, TLS sessions and DNS cache are shared
+ * by all transfers of the downloader.
+ */
+
+#pragma once
+
+#include <curl/curl.h>
+#include <openssl/x509.h>
+#include <stdbool.h>
+
+#define DOWNLOAD_MAX_PARALLEL 4
+// Files smaller than two parts of this size are fetched with one request
+#define DOWNLOAD_MIN_PART_SIZE (8 * 1024 * 1024)
+#define DOWNLOAD_BUFFER_SIZE   (1024 * 1024)
+// Times a part is resumed after transfers that failed without any data
+#define DOWNLOAD_RETRIES 3
+
+struct Downloader {
+    X509_STORE* ca_store;
+    CURLSH* share;
+    CURLM* multi;
+};
+
+/**
+ * brief Parse the certificates and CRLs of a PEM file into a new store.
+ *
+ * param path − The path of the PEM file.
+ *
+ * return The store, freed with X509_STORE_free(), or NULL on failure.
+ */
+X509_STORE* load_ca_store(const char* path);
+
+/**
+ * brief Create a downloader that verifies the servers with the certificates
+ *       of a store. The downloader keeps a reference to the store.
+ *
+ * return The downloader, or NULL on failure.
+ */
+struct Downloader* downloader_new(X509_STORE* ca_store);
+
+void downloader_free(struct Downloader* downloader);
+
+/**
+ * brief Fetch a file, resuming an earlier download of it if there is one.
+ *
+ * param url  − The URL of the file.
+ * param path − The path to store the file at.
+ *
+ * return true if the whole file is stored at path.
+ */
+bool downloader_fetch(struct Downloader* downloader, const char* url, const char* path);
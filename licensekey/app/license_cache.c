@@ -0,0 +1,159 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "license_cache.h"
+
+#include <licensekey.h>
+#include <syslog.h>
+
+typedef struct license_change {
+    // The listeners are referenced, so a change still pending when the cache is destroyed is safe
+    GArray* listeners;
+    license_state_t state;
+    uint32_t features;
+} license_change_t;
+
+static gboolean notify_listeners(gpointer data) {
+    license_change_t* change = data;
+    for (guint i = 0; i < change->listeners->len; i++) {
+        license_listener_entry_t* entry =
+            &g_array_index(change->listeners, license_listener_entry_t, i);
+        entry->func(change->state, change->features, entry->user_data);
+    }
+    return G_SOURCE_REMOVE;
+}
+
+static void free_change(gpointer data) {
+    license_change_t* change = data;
+    g_array_unref(change->listeners);
+    g_free(change);
+}
+
+static void verify(license_cache_t* cache) {
+    bool valid = licensekey_verify(cache->app_name,
+                                   cache->app_id,
+                                   cache->major_version,
+                                   cache->minor_version) == 1;
+    license_state_t state = valid ? LICENSE_STATE_VALID : LICENSE_STATE_INVALID;
+    uint32_t features     = valid ? cache->licensed_features : cache->unlicensed_features;
+
+    atomic_store_explicit(&cache->features, features, memory_order_relaxed);
+    license_state_t previous =
+        (license_state_t)atomic_exchange_explicit(&cache->state, state, memory_order_relaxed);
+    if (previous == state) {
+        return;
+    }
+
+    license_change_t* change = g_new0(license_change_t, 1);
+    change->listeners        = g_array_ref(cache->listeners);
+    change->state            = state;
+    change->features         = features;
+
+    // Always queued, never run here, so the listeners are only called and added in the context
+    // of the creator, and the ones added right after the cache is created see the first state
+    GSource* source = g_idle_source_new();
+    g_source_set_priority(source, G_PRIORITY_DEFAULT);
+    g_source_set_callback(source, notify_listeners, change, free_change);
+    g_source_attach(source, cache->context);
+    g_source_unref(source);
+}
+
+static gpointer verify_thread(gpointer data) {
+    license_cache_t* cache = data;
+
+    g_mutex_lock(&cache->mutex);
+    while (!cache->stop) {
+        cache->verify_now = false;
+        g_mutex_unlock(&cache->mutex);
+
+        // The hot paths keep reading the previous state meanwhile
+        verify(cache);
+
+        g_mutex_lock(&cache->mutex);
+        gint64 deadline =
+            g_get_monotonic_time() + (gint64)cache->interval_secs * G_TIME_SPAN_SECOND;
+        while (!cache->stop && !cache->verify_now) {
+            if (!g_cond_wait_until(&cache->wake, &cache->mutex, deadline)) {
+                break;
+            }
+        }
+    }
+    g_mutex_unlock(&cache->mutex);
+
+    return NULL;
+}
+
+license_cache_t* license_cache_create(const char* app_name,
+                                      int app_id,
+                                      int major_version,
+                                      int minor_version,
+                                      guint interval_secs,
+                                      uint32_t licensed_features,
+                                      uint32_t unlicensed_features) {
+    license_cache_t* cache = g_new0(license_cache_t, 1);
+    atomic_init(&cache->state, LICENSE_STATE_UNKNOWN);
+    atomic_init(&cache->features, unlicensed_features);
+
+    cache->app_name            = g_strdup(app_name);
+    cache->app_id              = app_id;
+    cache->major_version       = major_version;
+    cache->minor_version       = minor_version;
+    cache->interval_secs       = interval_secs;
+    cache->licensed_features   = licensed_features;
+    cache->unlicensed_features = unlicensed_features;
+    cache->context             = g_main_context_ref_thread_default();
+    cache->listeners           = g_array_new(FALSE, FALSE, sizeof(license_listener_entry_t));
+
+    g_mutex_init(&cache->mutex);
+    g_cond_init(&cache->wake);
+    cache->thread = g_thread_new("license", verify_thread, cache);
+
+    return cache;
+}
+
+void license_cache_destroy(license_cache_t* cache) {
+    if (!cache) {
+        return;
+    }
+
+    g_mutex_lock(&cache->mutex);
+    cache->stop = true;
+    g_cond_signal(&cache->wake);
+    g_mutex_unlock(&cache->mutex);
+    g_thread_join(cache->thread);
+
+    g_cond_clear(&cache->wake);
+    g_mutex_clear(&cache->mutex);
+    g_array_unref(cache->listeners);
+    g_main_context_unref(cache->context);
+    g_free(cache->app_name);
+    g_free(cache);
+}
+
+void license_cache_add_listener(license_cache_t* cache,
+                                license_listener_t listener,
+                                void* user_data) {
+    license_listener_entry_t entry = {.func = listener, .user_data = user_data};
+    // The listeners are only read in the main context, where they are also added
+    g_array_append_val(cache->listeners, entry);
+}
+
+void license_cache_verify_now(license_cache_t* cache) {
+    g_mutex_lock(&cache->mutex);
+    cache->verify_now = true;
+    g_cond_signal(&cache->wake);
+    g_mutex_unlock(&cache->mutex);
+}
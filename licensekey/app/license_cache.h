@@ -0,0 +1,134 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * This header file handles a cached license state for gating features.
+ *
+ * Verifying the license key reads and checks a signed file, which is too slow to do for every
+ * frame or request. The cache verifies the license on a thread of its own, at start and then
+ * periodically, and publishes the result as a set of feature flags in one atomic word. Reading
+ * the flags is a single load, so the hot paths can gate a feature for free.
+ *
+ * The listeners are told when the state changes. They are called in the main context of the
+ * thread that created the cache, so they run on its main loop like any other GLib callback.
+ */
+
+#pragma once
+
+#include <glib.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum license_state {
+    // Not verified yet, the features of an invalid license are enabled meanwhile
+    LICENSE_STATE_UNKNOWN = 0,
+    LICENSE_STATE_VALID,
+    LICENSE_STATE_INVALID,
+} license_state_t;
+
+/**
+ * @brief Called when the license state has changed.
+ *
+ * @param state     The new state.
+ * @param features  The feature flags enabled in the new state.
+ */
+typedef void (*license_listener_t)(license_state_t state, uint32_t features, void* user_data);
+
+typedef struct license_listener_entry {
+    license_listener_t func;
+    void* user_data;
+} license_listener_entry_t;
+
+typedef struct license_cache {
+    // Read without a lock by the hot paths
+    atomic_uint state;
+    atomic_uint features;
+
+    gchar* app_name;
+    int app_id;
+    int major_version;
+    int minor_version;
+    guint interval_secs;
+    // Features enabled with a valid license, and the ones enabled without it
+    uint32_t licensed_features;
+    uint32_t unlicensed_features;
+
+    GMainContext* context;
+    GArray* listeners;
+
+    // Wakes the thread to verify at once or to stop
+    GMutex mutex;
+    GCond wake;
+    bool verify_now;
+    bool stop;
+    GThread* thread;
+} license_cache_t;
+
+/**
+ * @brief Create a cache and start verifying the license in the background.
+ *
+ * @param app_name             Name of the application, as given to licensekey_verify().
+ * @param app_id               Application id.
+ * @param major_version        Major version of the application.
+ * @param minor_version        Minor version of the application.
+ * @param interval_secs        Time between the verifications.
+ * @param licensed_features    Feature flags enabled by a valid license.
+ * @param unlicensed_features  Feature flags enabled without a valid license.
+ *
+ * @return Pointer to a new cache.
+ */
+license_cache_t* license_cache_create(const char* app_name,
+                                      int app_id,
+                                      int major_version,
+                                      int minor_version,
+                                      guint interval_secs,
+                                      uint32_t licensed_features,
+                                      uint32_t unlicensed_features);
+
+/**
+ * @brief Stop the verification and release the cache, NULL is ignored.
+ */
+void license_cache_destroy(license_cache_t* cache);
+
+/**
+ * @brief Add a listener for the changes of the state, e.g. to start or stop a premium pipeline.
+ *
+ * Should be added before the main loop runs, so no change is missed.
+ */
+void license_cache_add_listener(license_cache_t* cache,
+                                license_listener_t listener,
+                                void* user_data);
+
+/**
+ * @brief Verify the license now instead of at the next interval, e.g. after a new key is installed.
+ */
+void license_cache_verify_now(license_cache_t* cache);
+
+static inline license_state_t license_cache_state(const license_cache_t* cache) {
+    return (license_state_t)atomic_load_explicit(&cache->state, memory_order_relaxed);
+}
+
+static inline uint32_t license_cache_features(const license_cache_t* cache) {
+    return atomic_load_explicit(&cache->features, memory_order_relaxed);
+}
+
+/**
+ * @brief Check whether all the given features are enabled, without blocking.
+ */
+static inline bool license_cache_has_features(const license_cache_t* cache, uint32_t features) {
+    return (license_cache_features(cache) & features) == features;
+}
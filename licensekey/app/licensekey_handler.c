@@ -21,14 +21,18 @@
  * a license key check for a specific application name, application id,
  * major and minor application version.
  *
+ * The license is verified in the background by a license cache, and the
+ * frames only read the cached feature flags to decide which features to run.
+ *
  */
 #include <glib-unix.h>
 #include <glib.h>
-#include <licensekey.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <syslog.h>
 
+#include "license_cache.h"
+
 #define APP_ID        0
 #define MAJOR_VERSION 1
 #define MINOR_VERSION 0
@@ -36,8 +40,18 @@
 // This is a very simplistic example, checking every 5 minutes
 #define CHECK_SECS 300
 
+// The frames of a simulated 10 fps stream
+#define FRAME_MS 100
+
+// Feature flags of the application
+#define FEATURE_BASIC   (1u << 0)
+#define FEATURE_PREMIUM (1u << 1)
+
 static gchar* glob_app_name = NULL;
 
+static guint64 num_frames         = 0;
+static guint64 num_premium_frames = 0;
+
 /**
  * @brief Handles the signals.
  *
@@ -49,13 +63,25 @@ static gboolean signal_handler(gpointer loop) {
     return G_SOURCE_REMOVE;
 }
 
-// Checks licensekey status every 5th minute
-static gboolean check_license_status(void* data) {
-    (void)data;
-    if (licensekey_verify(glob_app_name, APP_ID, MAJOR_VERSION, MINOR_VERSION) != 1) {
-        syslog(LOG_INFO, "Licensekey is invalid");
-    } else {
-        syslog(LOG_INFO, "Licensekey is valid");
+// Called when the cache has verified the license and the state has changed
+static void license_changed(license_state_t state, uint32_t features, void* user_data) {
+    (void)user_data;
+    syslog(LOG_INFO,
+           "Licensekey is %s, premium features %s (%" G_GUINT64_FORMAT " of %" G_GUINT64_FORMAT
+           " frames used them so far)",
+           state == LICENSE_STATE_VALID ? "valid" : "invalid",
+           (features & FEATURE_PREMIUM) ? "enabled" : "disabled",
+           num_premium_frames,
+           num_frames);
+}
+
+// Runs for every frame, the license is never verified here
+static gboolean process_frame(void* data) {
+    license_cache_t* cache = data;
+    num_frames++;
+    if (license_cache_has_features(cache, FEATURE_PREMIUM)) {
+        // The premium analysis of the frame would run here
+        num_premium_frames++;
     }
     return TRUE;
 }
@@ -71,13 +97,22 @@ int main(int argc, char* argv[]) {
     glob_app_name = g_path_get_basename(argv[0]);
     loop          = g_main_loop_new(NULL, FALSE);
 
-    check_license_status(NULL);
-    g_timeout_add_seconds(CHECK_SECS, check_license_status, NULL);
+    // Checks licensekey status every 5th minute, the basic features never need a license
+    license_cache_t* cache = license_cache_create(glob_app_name,
+                                                  APP_ID,
+                                                  MAJOR_VERSION,
+                                                  MINOR_VERSION,
+                                                  CHECK_SECS,
+                                                  FEATURE_BASIC | FEATURE_PREMIUM,
+                                                  FEATURE_BASIC);
+    license_cache_add_listener(cache, license_changed, NULL);
+    g_timeout_add(FRAME_MS, process_frame, cache);
 
     g_unix_signal_add(SIGTERM, signal_handler, loop);
     g_unix_signal_add(SIGINT, signal_handler, loop);
     g_main_loop_run(loop);
 
+    license_cache_destroy(cache);
     g_main_loop_unref(loop);
     g_free(glob_app_name);
 
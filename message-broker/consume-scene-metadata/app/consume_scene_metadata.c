@@ -18,8 +18,15 @@
  * This example creates a Message Broker subscriber for the
  * analytics_scene_description topic. Streamed messages are received in the
  * Analytics Data Format (ADF) and is logged to syslog.
+ *
+ * The subscriber callback only copies each message into a preallocated ring,
+ * and a worker thread takes the messages in batches. In this way the callback
+ * returns quickly also at full frame rate. The worker parses each message into
+ * fixed-size structs, updates a table of the tracked objects and logs them.
  */
 
+#include <inttypes.h>
+#include <pthread.h>
 #include <signal.h>
 #include <stdio.h>
 #include <string.h>
@@ -32,11 +39,26 @@
 #include <mdb/error.h>
 #include <mdb/subscriber.h>
 
+#include "message_ring.h"
+#include "scene_metadata.h"
+
+// Room for about two seconds of messages at 30 fps
+#define RING_CAPACITY 64
+#define MAX_PAYLOAD_SIZE (32 * 1024)
+#define MAX_BATCH_SIZE 16
+#define MAX_TRACKS 256
+
 typedef struct channel_identifier {
     char* topic;
     char* source;
 } channel_identifier_t;
 
+typedef struct consumer {
+    channel_identifier_t* channel_identifier;
+    message_ring_t* ring;
+    scene_track_table_t* tracks;
+} consumer_t;
+
 static void on_connection_error(const mdb_error_t* error, void* user_data) {
     (void)user_data;
 
@@ -49,17 +71,86 @@ static void on_message(const mdb_message_t* message, void* user_data) {
     const struct timespec* timestamp     = mdb_message_get_timestamp(message);
     const mdb_message_payload_t* payload = mdb_message_get_payload(message);
 
-    channel_identifier_t* channel_identifier = (channel_identifier_t*)user_data;
+    consumer_t* consumer = (consumer_t*)user_data;
+
+    // Dropped messages are reported by the worker, never log in the callback
+    message_ring_push(consumer->ring, timestamp, payload->data, payload->size);
+}
 
+static void log_frame(const struct timespec* timestamp,
+                      const scene_frame_t* frame,
+                      const scene_track_table_t* tracks) {
     syslog(LOG_INFO,
-           "message received from topic: %s on source: %s: Monotonic time - "
-           "%lld.%.9ld. Data - %.*s",
-           channel_identifier->topic,
-           channel_identifier->source,
+           "Frame at monotonic time %lld.%.9ld: %zu observations, %zu deleted, %zu tracks",
            (long long)timestamp->tv_sec,
            timestamp->tv_nsec,
-           (int)payload->size,
-           (char*)payload->data);
+           frame->num_observations,
+           frame->num_deleted,
+           tracks->num_tracks);
+
+    for (size_t i = 0; i < frame->num_observations; i++) {
+        // The class is taken from the track, since not every observation has it
+        const char* track_id       = frame->observations[i].track_id;
+        const scene_track_t* track = scene_track_table_find(tracks, track_id);
+        if (track == NULL) {
+            continue;
+        }
+        syslog(LOG_INFO,
+               "Track %s: %s %.2f, box (left %.4f, top %.4f, right %.4f, bottom %.4f)",
+               track->track_id,
+               track->has_class ? track->class_type : "Unknown",
+               track->score,
+               track->box.left,
+               track->box.top,
+               track->box.right,
+               track->box.bottom);
+    }
+}
+
+static void* consume_messages(void* user_data) {
+    consumer_t* consumer            = (consumer_t*)user_data;
+    uint64_t reported_dropped_count = 0;
+    message_slot_t* batch           = NULL;
+    uint64_t dropped_count          = 0;
+    size_t num_messages             = 0;
+    // Reused for every message, so nothing is allocated per message
+    scene_frame_t frame;
+
+    while ((num_messages = message_ring_wait_batch(consumer->ring,
+                                                   MAX_BATCH_SIZE,
+                                                   &batch,
+                                                   &dropped_count)) > 0) {
+        if (dropped_count != reported_dropped_count) {
+            syslog(LOG_WARNING,
+                   "Dropped %" PRIu64 " messages, the consumer is too slow or the "
+                   "messages are larger than %d bytes",
+                   dropped_count - reported_dropped_count,
+                   MAX_PAYLOAD_SIZE);
+            reported_dropped_count = dropped_count;
+        }
+
+        for (size_t i = 0; i < num_messages; i++) {
+            if (!scene_frame_parse(batch[i].data, batch[i].size, &frame)) {
+                syslog(LOG_WARNING,
+                       "Failed to parse message from topic: %s on source: %s",
+                       consumer->channel_identifier->topic,
+                       consumer->channel_identifier->source);
+                continue;
+            }
+            size_t num_not_added = scene_track_table_update(consumer->tracks, &frame);
+            if (frame.num_skipped > 0 || num_not_added > 0) {
+                syslog(LOG_WARNING,
+                       "Skipped %zu observations and operations, %zu tracks did not fit",
+                       frame.num_skipped,
+                       num_not_added);
+            }
+            log_frame(&batch[i].timestamp, &frame, consumer->tracks);
+        }
+
+        message_ring_release(consumer->ring, num_messages);
+    }
+
+    return NULL;
 }
 
 static void on_done_subscriber_create(const mdb_error_t* error, void* user_data) {
@@ -91,8 +182,31 @@ int main(void) {
     mdb_error_t* error                         = NULL;
     mdb_subscriber_config_t* subscriber_config = NULL;
     mdb_subscriber_t* subscriber               = NULL;
+    mdb_connection_t* connection               = NULL;
+
+    consumer_t consumer = {.channel_identifier = &channel_identifier, .ring = NULL, .tracks = NULL};
+    pthread_t worker;
+    bool worker_started = false;
+
+    consumer.ring = message_ring_create(RING_CAPACITY, MAX_PAYLOAD_SIZE);
+    if (consumer.ring == NULL) {
+        syslog(LOG_ERR, "Failed to allocate the message ring");
+        goto end;
+    }
+
+    consumer.tracks = scene_track_table_create(MAX_TRACKS);
+    if (consumer.tracks == NULL) {
+        syslog(LOG_ERR, "Failed to allocate the track table");
+        goto end;
+    }
 
-    mdb_connection_t* connection = mdb_connection_create(on_connection_error, NULL, &error);
+    if (pthread_create(&worker, NULL, consume_messages, &consumer) != 0) {
+        syslog(LOG_ERR, "Failed to start the worker thread");
+        goto end;
+    }
+    worker_started = true;
+
+    connection = mdb_connection_create(on_connection_error, NULL, &error);
     if (error != NULL) {
         goto end;
     }
@@ -100,7 +214,7 @@ int main(void) {
     subscriber_config = mdb_subscriber_config_create(channel_identifier.topic,
                                                      channel_identifier.source,
                                                      on_message,
-                                                     &channel_identifier,
+                                                     &consumer,
                                                      &error);
     if (error != NULL) {
         goto end;
@@ -130,5 +244,13 @@ end:
     mdb_subscriber_destroy(&subscriber);
     mdb_connection_destroy(&connection);
 
+    // The subscriber is destroyed, so no more messages are pushed to the ring
+    if (worker_started) {
+        message_ring_stop(consumer.ring);
+        pthread_join(worker, NULL);
+    }
+    message_ring_destroy(consumer.ring);
+    scene_track_table_destroy(consumer.tracks);
+
     syslog(LOG_INFO, "Subscriber closed...");
 }
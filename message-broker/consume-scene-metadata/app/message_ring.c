@@ -0,0 +1,122 @@
+/**
+ * Copyright (C) 2025 Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     <http://www.apache.org/licenses/LICENSE-2.0>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "message_ring.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+message_ring_t* message_ring_create(size_t capacity, size_t max_payload_size) {
+    message_ring_t* ring = calloc(1, sizeof(message_ring_t));
+    if (ring == NULL) {
+        return NULL;
+    }
+
+    ring->slots    = calloc(capacity, sizeof(message_slot_t));
+    ring->payloads = malloc(capacity * max_payload_size);
+    if (ring->slots == NULL || ring->payloads == NULL) {
+        free(ring->slots);
+        free(ring->payloads);
+        free(ring);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < capacity; i++) {
+        ring->slots[i].data = ring->payloads + i * max_payload_size;
+    }
+    ring->capacity         = capacity;
+    ring->max_payload_size = max_payload_size;
+
+    pthread_mutex_init(&ring->mutex, NULL);
+    pthread_cond_init(&ring->cond, NULL);
+
+    return ring;
+}
+
+void message_ring_destroy(message_ring_t* ring) {
+    if (ring == NULL) {
+        return;
+    }
+
+    pthread_cond_destroy(&ring->cond);
+    pthread_mutex_destroy(&ring->mutex);
+    free(ring->payloads);
+    free(ring->slots);
+    free(ring);
+}
+
+bool message_ring_push(message_ring_t* ring,
+                       const struct timespec* timestamp,
+                       const void* data,
+                       size_t size) {
+    pthread_mutex_lock(&ring->mutex);
+
+    if (size > ring->max_payload_size || ring->write_count - ring->read_count == ring->capacity) {
+        ring->dropped_count++;
+        pthread_mutex_unlock(&ring->mutex);
+        return false;
+    }
+
+    // The slot is free, and the consumer only reads slots below write_count
+    message_slot_t* slot = &ring->slots[ring->write_count % ring->capacity];
+    slot->timestamp      = *timestamp;
+    slot->size           = size;
+    memcpy(slot->data, data, size);
+    ring->write_count++;
+
+    pthread_cond_signal(&ring->cond);
+    pthread_mutex_unlock(&ring->mutex);
+    return true;
+}
+
+size_t message_ring_wait_batch(message_ring_t* ring,
+                               size_t max_messages,
+                               message_slot_t** batch,
+                               uint64_t* dropped_count) {
+    pthread_mutex_lock(&ring->mutex);
+
+    while (ring->write_count == ring->read_count && !ring->stopped) {
+        pthread_cond_wait(&ring->cond, &ring->mutex);
+    }
+
+    size_t first       = ring->read_count % ring->capacity;
+    size_t num_queued  = ring->write_count - ring->read_count;
+    size_t num_in_turn = ring->capacity - first;
+
+    size_t num_messages = num_queued < max_messages ? num_queued : max_messages;
+    if (num_messages > num_in_turn) {
+        num_messages = num_in_turn;
+    }
+
+    *batch         = &ring->slots[first];
+    *dropped_count = ring->dropped_count;
+
+    pthread_mutex_unlock(&ring->mutex);
+    return num_messages;
+}
+
+void message_ring_release(message_ring_t* ring, size_t num_messages) {
+    pthread_mutex_lock(&ring->mutex);
+    ring->read_count += num_messages;
+    pthread_mutex_unlock(&ring->mutex);
+}
+
+void message_ring_stop(message_ring_t* ring) {
+    pthread_mutex_lock(&ring->mutex);
+    ring->stopped = true;
+    pthread_cond_broadcast(&ring->cond);
+    pthread_mutex_unlock(&ring->mutex);
+}
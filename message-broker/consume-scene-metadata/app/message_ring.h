@@ -0,0 +1,105 @@
+/**
+ * Copyright (C) 2025 Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     <http://www.apache.org/licenses/LICENSE-2.0>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * A preallocated ring of message payloads, handed from the Message Broker
+ * callback to a worker thread in batches.
+ *
+ * The callback only copies the payload into a free slot, so it returns quickly
+ * also when the worker is busy. All memory is allocated when the ring is
+ * created. When the ring is full, or a payload does not fit in a slot, the
+ * message is dropped and counted instead of blocking the callback.
+ */
+
+#pragma once
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+typedef struct message_slot {
+    struct timespec timestamp;
+    size_t size;
+    char* data;
+} message_slot_t;
+
+typedef struct message_ring {
+    message_slot_t* slots;
+    char* payloads;
+    size_t capacity;
+    size_t max_payload_size;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+
+    // Free running counters, the slot of a counter is counter % capacity
+    uint64_t read_count;
+    uint64_t write_count;
+    uint64_t dropped_count;
+    bool stopped;
+} message_ring_t;
+
+/**
+ * Create a ring with capacity slots of max_payload_size bytes each.
+ *
+ * Returns NULL if the memory could not be allocated.
+ */
+message_ring_t* message_ring_create(size_t capacity, size_t max_payload_size);
+
+/**
+ * Destroy a ring created by message_ring_create(). No thread may use the ring
+ * when it is destroyed.
+ */
+void message_ring_destroy(message_ring_t* ring);
+
+/**
+ * Copy a message into the next free slot and wake up the consumer.
+ *
+ * Returns false if the message was dropped because the ring is full or the
+ * payload is larger than the slots.
+ */
+bool message_ring_push(message_ring_t* ring,
+                       const struct timespec* timestamp,
+                       const void* data,
+                       size_t size);
+
+/**
+ * Wait for at least one message and get a batch of up to max_messages
+ * consecutive messages.
+ *
+ * The messages are owned by the consumer until message_ring_release() is
+ * called, and are processed without holding the lock. The batch may be shorter
+ * than the number of queued messages when it wraps around the end of the ring.
+ *
+ * Returns the number of messages in the batch, 0 once the ring is stopped.
+ */
+size_t message_ring_wait_batch(message_ring_t* ring,
+                               size_t max_messages,
+                               message_slot_t** batch,
+                               uint64_t* dropped_count);
+
+/**
+ * Give the slots of a batch back to the producer.
+ */
+void message_ring_release(message_ring_t* ring, size_t num_messages);
+
+/**
+ * Wake up the consumer and make message_ring_wait_batch() return 0 once the
+ * already queued messages have been consumed.
+ */
+void message_ring_stop(message_ring_t* ring);
@@ -0,0 +1,510 @@
+/**
+ * Copyright (C) 2025 Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     <http://www.apache.org/licenses/LICENSE-2.0>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "scene_metadata.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Longer keys are truncated, which is fine since no key we look for is that long
+#define KEY_SIZE 32
+#define NUMBER_SIZE 32
+
+typedef struct cursor {
+    const char* pos;
+    const char* end;
+} cursor_t;
+
+static void skip_whitespace(cursor_t* cursor) {
+    while (cursor->pos < cursor->end && (*cursor->pos == ' ' || *cursor->pos == '\t' ||
+                                         *cursor->pos == '\n' || *cursor->pos == '\r')) {
+        cursor->pos++;
+    }
+}
+
+static bool peek(cursor_t* cursor, char c) {
+    skip_whitespace(cursor);
+    return cursor->pos < cursor->end && *cursor->pos == c;
+}
+
+static bool consume(cursor_t* cursor, char c) {
+    if (!peek(cursor, c)) {
+        return false;
+    }
+    cursor->pos++;
+    return true;
+}
+
+/**
+ * Parse a string into out, truncated to out_size - 1 characters. Escaped
+ * characters are copied without the backslash, \u escapes are replaced by '?'.
+ */
+static bool parse_string(cursor_t* cursor, char* out, size_t out_size) {
+    if (!consume(cursor, '"')) {
+        return false;
+    }
+
+    size_t length = 0;
+    while (cursor->pos < cursor->end && *cursor->pos != '"') {
+        char c = *cursor->pos++;
+        if (c == '\\') {
+            if (cursor->pos == cursor->end) {
+                return false;
+            }
+            c = *cursor->pos++;
+            if (c == 'u') {
+                if (cursor->end - cursor->pos < 4) {
+                    return false;
+                }
+                cursor->pos += 4;
+                c = '?';
+            }
+        }
+        if (length + 1 < out_size) {
+            out[length++] = c;
+        }
+    }
+    if (out_size > 0) {
+        out[length] = '\0';
+    }
+    return consume(cursor, '"');
+}
+
+static bool parse_number(cursor_t* cursor, float* value) {
+    skip_whitespace(cursor);
+
+    // The payload is not NUL terminated, so copy the number before converting it
+    char number[NUMBER_SIZE];
+    size_t length = 0;
+    while (cursor->pos < cursor->end && length + 1 < sizeof(number) &&
+           strchr("+-.0123456789eE", *cursor->pos) != NULL) {
+        number[length++] = *cursor->pos++;
+    }
+    number[length] = '\0';
+
+    char* number_end = NULL;
+    *value           = strtof(number, &number_end);
+    return length > 0 && number_end == number + length;
+}
+
+/**
+ * Skip a value of any type without decoding it. Nested containers are skipped
+ * by counting the depth, so deep documents do not use any stack.
+ */
+static bool skip_value(cursor_t* cursor) {
+    size_t depth = 0;
+
+    skip_whitespace(cursor);
+    do {
+        if (cursor->pos == cursor->end) {
+            return false;
+        }
+
+        char c = *cursor->pos;
+        if (c == '"') {
+            if (!parse_string(cursor, NULL, 0)) {
+                return false;
+            }
+        } else if (c == '{' || c == '[') {
+            depth++;
+            cursor->pos++;
+        } else if (c == '}' || c == ']') {
+            if (depth == 0) {
+                return false;
+            }
+            depth--;
+            cursor->pos++;
+        } else if (c == ',' || c == ':') {
+            if (depth == 0) {
+                return false;
+            }
+            cursor->pos++;
+        } else {
+            // Numbers and literals, validated only as far as needed to find their end
+            const char* start = cursor->pos;
+            while (cursor->pos < cursor->end && strchr(",:]} \t\n\r\"", *cursor->pos) == NULL) {
+                cursor->pos++;
+            }
+            if (cursor->pos == start) {
+                return false;
+            }
+        }
+        skip_whitespace(cursor);
+    } while (depth > 0);
+
+    return true;
+}
+
+/**
+ * Iterate over the members of an object. Call with *first set to true, each
+ * call parses the next key into key and returns false at the end of the object
+ * or on error, which is told apart by *error.
+ */
+static bool next_member(cursor_t* cursor, bool* first, char* key, bool* error) {
+    if (*first) {
+        *first = false;
+        if (!consume(cursor, '{')) {
+            *error = true;
+            return false;
+        }
+        if (consume(cursor, '}')) {
+            return false;
+        }
+    } else if (consume(cursor, '}')) {
+        return false;
+    } else if (!consume(cursor, ',')) {
+        *error = true;
+        return false;
+    }
+
+    if (!parse_string(cursor, key, KEY_SIZE) || !consume(cursor, ':')) {
+        *error = true;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Iterate over the elements of an array, like next_member() but without key.
+ */
+static bool next_element(cursor_t* cursor, bool* first, bool* error) {
+    if (*first) {
+        *first = false;
+        if (!consume(cursor, '[')) {
+            *error = true;
+            return false;
+        }
+        return !consume(cursor, ']');
+    }
+    if (consume(cursor, ']')) {
+        return false;
+    }
+    if (!consume(cursor, ',')) {
+        *error = true;
+        return false;
+    }
+    return true;
+}
+
+static bool parse_box(cursor_t* cursor, scene_box_t* box) {
+    char key[KEY_SIZE];
+    bool first = true;
+    bool error = false;
+
+    while (next_member(cursor, &first, key, &error)) {
+        float* value = NULL;
+        if (strcmp(key, "left") == 0) {
+            value = &box->left;
+        } else if (strcmp(key, "top") == 0) {
+            value = &box->top;
+        } else if (strcmp(key, "right") == 0) {
+            value = &box->right;
+        } else if (strcmp(key, "bottom") == 0) {
+            value = &box->bottom;
+        }
+
+        if (value != NULL ? !parse_number(cursor, value) : !skip_value(cursor)) {
+            return false;
+        }
+    }
+    return !error;
+}
+
+static bool parse_class(cursor_t* cursor, scene_observation_t* observation) {
+    char key[KEY_SIZE];
+    bool first = true;
+    bool error = false;
+
+    while (next_member(cursor, &first, key, &error)) {
+        bool ok;
+        if (strcmp(key, "type") == 0) {
+            ok = parse_string(cursor, observation->class_type, sizeof(observation->class_type));
+        } else if (strcmp(key, "score") == 0) {
+            ok = parse_number(cursor, &observation->score);
+        } else {
+            ok = skip_value(cursor);
+        }
+        if (!ok) {
+            return false;
+        }
+    }
+    observation->has_class = !error;
+    return !error;
+}
+
+static bool parse_observation(cursor_t* cursor, scene_observation_t* observation) {
+    char key[KEY_SIZE];
+    bool first = true;
+    bool error = false;
+
+    memset(observation, 0, sizeof(*observation));
+    while (next_member(cursor, &first, key, &error)) {
+        bool ok;
+        if (strcmp(key, "track_id") == 0) {
+            ok = parse_string(cursor, observation->track_id, sizeof(observation->track_id));
+        } else if (strcmp(key, "bounding_box") == 0) {
+            ok = parse_box(cursor, &observation->box);
+        } else if (strcmp(key, "class") == 0) {
+            ok = parse_class(cursor, observation);
+        } else {
+            ok = skip_value(cursor);
+        }
+        if (!ok) {
+            return false;
+        }
+    }
+    return !error;
+}
+
+static bool parse_operation(cursor_t* cursor, char* id, bool* is_delete) {
+    char key[KEY_SIZE];
+    char type[KEY_SIZE] = "";
+    bool first          = true;
+    bool error          = false;
+
+    id[0] = '\0';
+    while (next_member(cursor, &first, key, &error)) {
+        bool ok;
+        if (strcmp(key, "id") == 0) {
+            ok = parse_string(cursor, id, SCENE_ID_SIZE);
+        } else if (strcmp(key, "type") == 0) {
+            ok = parse_string(cursor, type, sizeof(type));
+        } else {
+            ok = skip_value(cursor);
+        }
+        if (!ok) {
+            return false;
+        }
+    }
+    *is_delete = strcmp(type, "DeleteOperation") == 0;
+    return !error;
+}
+
+static bool parse_observations(cursor_t* cursor, scene_frame_t* frame) {
+    bool first = true;
+    bool error = false;
+
+    while (next_element(cursor, &first, &error)) {
+        bool ok;
+        if (frame->num_observations < SCENE_MAX_OBSERVATIONS) {
+            ok = parse_observation(cursor, &frame->observations[frame->num_observations]);
+            frame->num_observations++;
+        } else {
+            ok = skip_value(cursor);
+            frame->num_skipped++;
+        }
+        if (!ok) {
+            return false;
+        }
+    }
+    return !error;
+}
+
+static bool parse_operations(cursor_t* cursor, scene_frame_t* frame) {
+    bool first = true;
+    bool error = false;
+
+    while (next_element(cursor, &first, &error)) {
+        char id[SCENE_ID_SIZE];
+        bool is_delete = false;
+        if (!parse_operation(cursor, id, &is_delete)) {
+            return false;
+        }
+        if (!is_delete) {
+            continue;
+        }
+        if (frame->num_deleted < SCENE_MAX_DELETES) {
+            memcpy(frame->deleted_ids[frame->num_deleted++], id, SCENE_ID_SIZE);
+        } else {
+            frame->num_skipped++;
+        }
+    }
+    return !error;
+}
+
+static bool parse_frame(cursor_t* cursor, scene_frame_t* frame) {
+    char key[KEY_SIZE];
+    bool first = true;
+    bool error = false;
+
+    while (next_member(cursor, &first, key, &error)) {
+        bool ok;
+        if (strcmp(key, "observations") == 0) {
+            ok = parse_observations(cursor, frame);
+        } else if (strcmp(key, "operations") == 0) {
+            ok = parse_operations(cursor, frame);
+        } else {
+            ok = skip_value(cursor);
+        }
+        if (!ok) {
+            return false;
+        }
+    }
+    return !error;
+}
+
+bool scene_frame_parse(const char* json, size_t size, scene_frame_t* frame) {
+    cursor_t cursor = {.pos = json, .end = json + size};
+    char key[KEY_SIZE];
+    bool first       = true;
+    bool error       = false;
+    bool found_frame = false;
+
+    frame->num_observations = 0;
+    frame->num_deleted      = 0;
+    frame->num_skipped      = 0;
+
+    while (next_member(&cursor, &first, key, &error)) {
+        bool ok;
+        if (strcmp(key, "frame") == 0) {
+            ok          = parse_frame(&cursor, frame);
+            found_frame = true;
+        } else {
+            ok = skip_value(&cursor);
+        }
+        if (!ok) {
+            return false;
+        }
+    }
+    return !error && found_frame;
+}
+
+static uint32_t hash_id(const char* id) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (; *id != '\0'; id++) {
+        hash = (hash ^ (uint8_t)*id) * 16777619u;
+    }
+    return hash;
+}
+
+scene_track_table_t* scene_track_table_create(size_t max_tracks) {
+    // Keep the load factor at or below one half so probe sequences stay short
+    size_t capacity = 16;
+    while (capacity < 2 * max_tracks) {
+        capacity *= 2;
+    }
+
+    scene_track_table_t* table = calloc(1, sizeof(scene_track_table_t));
+    if (table == NULL) {
+        return NULL;
+    }
+    table->tracks = calloc(capacity, sizeof(scene_track_t));
+    table->used   = calloc(capacity, sizeof(bool));
+    if (table->tracks == NULL || table->used == NULL) {
+        scene_track_table_destroy(table);
+        return NULL;
+    }
+    table->capacity = capacity;
+    return table;
+}
+
+void scene_track_table_destroy(scene_track_table_t* table) {
+    if (table == NULL) {
+        return;
+    }
+    free(table->tracks);
+    free(table->used);
+    free(table);
+}
+
+/**
+ * Find the slot of an id, or the empty slot where it would be inserted.
+ */
+static size_t find_slot(const scene_track_table_t* table, const char* track_id) {
+    size_t mask = table->capacity - 1;
+    size_t slot = hash_id(track_id) & mask;
+    while (table->used[slot] && strcmp(table->tracks[slot].track_id, track_id) != 0) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+/**
+ * Remove the track in slot and shift later tracks of the probe sequence back,
+ * so no tombstones are needed.
+ */
+static void remove_slot(scene_track_table_t* table, size_t slot) {
+    size_t mask = table->capacity - 1;
+    size_t next = (slot + 1) & mask;
+
+    while (table->used[next]) {
+        size_t home = hash_id(table->tracks[next].track_id) & mask;
+        // Move the track if its home slot is not in the cyclic range (slot, next]
+        if (((next - home) & mask) >= ((next - slot) & mask)) {
+            table->tracks[slot] = table->tracks[next];
+            slot                = next;
+        }
+        next = (next + 1) & mask;
+    }
+    table->used[slot] = false;
+    table->num_tracks--;
+}
+
+size_t scene_track_table_update(scene_track_table_t* table, const scene_frame_t* frame) {
+    size_t num_not_added = 0;
+
+    table->frame_count++;
+
+    for (size_t i = 0; i < frame->num_deleted; i++) {
+        size_t slot = find_slot(table, frame->deleted_ids[i]);
+        if (table->used[slot]) {
+            remove_slot(table, slot);
+        }
+    }
+
+    for (size_t i = 0; i < frame->num_observations; i++) {
+        const scene_observation_t* observation = &frame->observations[i];
+        size_t slot                            = find_slot(table, observation->track_id);
+        scene_track_t* track                   = &table->tracks[slot];
+
+        if (!table->used[slot]) {
+            if (2 * (table->num_tracks + 1) > table->capacity) {
+                num_not_added++;
+                continue;
+            }
+            memset(track, 0, sizeof(*track));
+            memcpy(track->track_id, observation->track_id, SCENE_ID_SIZE);
+            table->used[slot] = true;
+            table->num_tracks++;
+        }
+
+        track->box       = observation->box;
+        track->last_seen = table->frame_count;
+        if (observation->has_class) {
+            track->has_class = true;
+            memcpy(track->class_type, observation->class_type, SCENE_CLASS_SIZE);
+            track->score = observation->score;
+        }
+    }
+
+    return num_not_added;
+}
+
+const scene_track_t* scene_track_table_find(const scene_track_table_t* table,
+                                            const char* track_id) {
+    size_t slot = find_slot(table, track_id);
+    return table->used[slot] ? &table->tracks[slot] : NULL;
+}
+
+const scene_track_t* scene_track_table_next(const scene_track_table_t* table, size_t* position) {
+    for (; *position < table->capacity; (*position)++) {
+        if (table->used[*position]) {
+            return &table->tracks[(*position)++];
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,134 @@
+/**
+ * Copyright (C) 2025 Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     <http://www.apache.org/licenses/LICENSE-2.0>
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Parser for AXIS Scene Metadata frames and a table of the tracked objects.
+ *
+ * Only the fields used by the application are decoded: the track id, bounding
+ * box and class of each observation and the ids of the delete operations. All
+ * other fields are skipped without being decoded. The parsed frame is stored in
+ * fixed-size structs, so no memory is allocated per message. The track table is
+ * allocated once and is updated incrementally with each parsed frame, so
+ * consumers such as overlays or rules read the current state of all tracks
+ * instead of parsing JSON.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Track ids are short numbers today, but leave room for a UUID
+#define SCENE_ID_SIZE 40
+#define SCENE_CLASS_SIZE 24
+#define SCENE_MAX_OBSERVATIONS 64
+#define SCENE_MAX_DELETES 64
+
+typedef struct scene_box {
+    float left;
+    float top;
+    float right;
+    float bottom;
+} scene_box_t;
+
+typedef struct scene_observation {
+    char track_id[SCENE_ID_SIZE];
+    scene_box_t box;
+    // Observations do not always have a class, then has_class is false
+    bool has_class;
+    char class_type[SCENE_CLASS_SIZE];
+    float score;
+} scene_observation_t;
+
+typedef struct scene_frame {
+    scene_observation_t observations[SCENE_MAX_OBSERVATIONS];
+    size_t num_observations;
+    char deleted_ids[SCENE_MAX_DELETES][SCENE_ID_SIZE];
+    size_t num_deleted;
+    // Observations and delete operations that did not fit in the frame
+    size_t num_skipped;
+} scene_frame_t;
+
+typedef struct scene_track {
+    char track_id[SCENE_ID_SIZE];
+    scene_box_t box;
+    // The last class seen for the track, kept when later observations lack it
+    bool has_class;
+    char class_type[SCENE_CLASS_SIZE];
+    float score;
+    // Number of the frame the track was last observed in
+    uint64_t last_seen;
+} scene_track_t;
+
+typedef struct scene_track_table {
+    // Open addressing with linear probing, capacity is a power of two
+    scene_track_t* tracks;
+    bool* used;
+    size_t capacity;
+    size_t num_tracks;
+    uint64_t frame_count;
+} scene_track_table_t;
+
+/**
+ * @brief Parse one Scene Metadata message.
+ *
+ * The payload does not need to be NUL terminated. Strings that do not fit in
+ * the fixed-size fields are truncated.
+ *
+ * @param json  Payload of the message.
+ * @param size  Size of the payload in bytes.
+ * @param frame Frame to fill in, all previous content is overwritten.
+ *
+ * @return False if the payload is not a valid Scene Metadata frame.
+ */
+bool scene_frame_parse(const char* json, size_t size, scene_frame_t* frame);
+
+/**
+ * @brief Create a track table with room for at least max_tracks tracks.
+ *
+ * @return Pointer to a new table, or NULL if the memory could not be allocated.
+ */
+scene_track_table_t* scene_track_table_create(size_t max_tracks);
+
+void scene_track_table_destroy(scene_track_table_t* table);
+
+/**
+ * @brief Update the table with a parsed frame.
+ *
+ * The observed tracks are added or updated and the deleted tracks are removed.
+ * Tracks that do not fit in the table are counted but not added.
+ *
+ * @return Number of observations that did not fit in the table.
+ */
+size_t scene_track_table_update(scene_track_table_t* table, const scene_frame_t* frame);
+
+/**
+ * @brief Find a track by id.
+ *
+ * @return Pointer to the track, valid until the next update, or NULL if the id is unknown.
+ */
+const scene_track_t* scene_track_table_find(const scene_track_table_t* table,
+                                            const char* track_id);
+
+/**
+ * @brief Iterate over the tracks of the table.
+ *
+ * Start with *position set to 0.
+ *
+ * @return The next track, or NULL when all tracks have been visited.
+ */
+const scene_track_t* scene_track_table_next(const scene_track_table_t* table, size_t* position);
@@ -0,0 +1,244 @@
+// Copyright (C) 2025 Axis Communications AB, Lund, Sweden
+// Licensed under the MIT License. See LICENSE file for details.
+
+#pragma once
+
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <nlohmann/json.hpp>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <variant>
+#include <vector>
+
+// A scalar value found by JsonFieldExtractor. Strings are only valid during the callback.
+using JsonFieldValue =
+    std::variant<std::nullptr_t, bool, std::int64_t, std::uint64_t, double, std::string_view>;
+
+// Get an integer field value, nullopt if the value is not an integer or does not fit in T
+template <class T>
+std::optional<T> JsonFieldAsInteger(const JsonFieldValue& value) {
+    if (auto signed_value = std::get_if<std::int64_t>(&value)) {
+        if (std::in_range<T>(*signed_value)) {
+            return static_cast<T>(*signed_value);
+        }
+    } else if (auto unsigned_value = std::get_if<std::uint64_t>(&value)) {
+        if (std::in_range<T>(*unsigned_value)) {
+            return static_cast<T>(*unsigned_value);
+        }
+    }
+    return std::nullopt;
+}
+
+// Extracts selected scalar fields from a JSON document without building a DOM.
+//
+// The fields are given as JSON pointers (RFC 6901), e.g. "/total_utilization", which are compiled
+// once when the extractor is created. As an extension, "*" matches every index of an array, e.g.
+// "/objects/*/distance". The document is streamed through the nlohmann SAX parser and the callback
+// is invoked for each matching scalar in document order, with the field index in the list given
+// to the constructor and the array indices matched by the wildcards. Without wildcards, parsing
+// stops as soon as every field has been found, so the tail of the document is not validated.
+//
+// Pointers to objects or arrays never match. Extract() is const and may be called concurrently.
+class JsonFieldExtractor {
+  public:
+    explicit JsonFieldExtractor(const std::vector<std::string>& pointers) {
+        m_fields.reserve(pointers.size());
+        for (const auto& pointer : pointers) {
+            m_fields.push_back(Compile(pointer));
+            m_has_wildcard = m_has_wildcard || m_fields.back().num_wildcards > 0;
+        }
+    }
+
+    // Throws std::runtime_error if the document is not valid JSON
+    template <class Callback>
+    void Extract(std::string_view json, Callback&& on_field) const {
+        Handler<Callback> handler(*this, on_field);
+        bool completed = nlohmann::json::sax_parse(json, &handler);
+        if (!completed && !handler.stopped_early) {
+            throw std::runtime_error(handler.error);
+        }
+    }
+
+  private:
+    struct Token {
+        std::string key;
+        // Set if the token is also a valid array index
+        std::optional<std::size_t> index;
+        bool wildcard = false;
+    };
+
+    struct Field {
+        std::vector<Token> tokens;
+        std::size_t num_wildcards = 0;
+    };
+
+    // A container on the path from the root to the current value
+    struct Frame {
+        bool is_array;
+        std::size_t index;
+        std::string key;
+    };
+
+    static Field Compile(const std::string& pointer) {
+        if (pointer.empty() || pointer.front() != '/') {
+            throw std::invalid_argument("JSON pointer must start with '/': " + pointer);
+        }
+
+        Field field;
+        std::size_t begin = 1;
+        while (true) {
+            std::size_t end = pointer.find('/', begin);
+            std::size_t length = end == std::string::npos ? end : end - begin;
+            std::string_view raw = std::string_view(pointer).substr(begin, length);
+
+            Token token;
+            for (std::size_t i = 0; i < raw.size(); i++) {
+                bool escaped = raw[i] == '~' && i + 1 < raw.size();
+                if (escaped && (raw[i + 1] == '0' || raw[i + 1] == '1')) {
+                    token.key.push_back(raw[i + 1] == '0' ? '~' : '/');
+                    i++;
+                } else {
+                    token.key.push_back(raw[i]);
+                }
+            }
+
+            std::size_t index = 0;
+            auto result = std::from_chars(raw.data(), raw.data() + raw.size(), index);
+            if (!raw.empty() && result.ec == std::errc() && result.ptr == raw.data() + raw.size() &&
+                (raw.size() == 1 || raw.front() != '0')) {
+                token.index = index;
+            }
+            if (raw == "*") {
+                token.wildcard = true;
+                field.num_wildcards++;
+            }
+            field.tokens.push_back(std::move(token));
+
+            if (end == std::string::npos) {
+                return field;
+            }
+            begin = end + 1;
+        }
+    }
+
+    template <class Callback>
+    class Handler : public nlohmann::json_sax<nlohmann::json> {
+      public:
+        Handler(const JsonFieldExtractor& extractor, Callback& on_field)
+            : m_extractor(extractor),
+              m_on_field(on_field),
+              m_remaining(extractor.m_fields.size()),
+              m_found(extractor.m_fields.size(), false) {
+            m_path.reserve(8);
+        }
+
+        bool null() override { return Value(nullptr); }
+        bool boolean(bool value) override { return Value(value); }
+        bool number_integer(number_integer_t value) override {
+            return Value(static_cast<std::int64_t>(value));
+        }
+        bool number_unsigned(number_unsigned_t value) override {
+            return Value(static_cast<std::uint64_t>(value));
+        }
+        bool number_float(number_float_t value, const string_t&) override {
+            return Value(static_cast<double>(value));
+        }
+        bool string(string_t& value) override { return Value(std::string_view(value)); }
+        bool binary(binary_t&) override { return Value(nullptr); }
+
+        bool start_object(std::size_t) override {
+            m_path.push_back({false, 0, {}});
+            return true;
+        }
+        bool key(string_t& value) override {
+            m_path.back().key = value;
+            return true;
+        }
+        bool end_object() override { return EndContainer(); }
+
+        bool start_array(std::size_t) override {
+            m_path.push_back({true, 0, {}});
+            return true;
+        }
+        bool end_array() override { return EndContainer(); }
+
+        bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception& ex)
+            override {
+            error = ex.what();
+            return false;
+        }
+
+        bool stopped_early = false;
+        std::string error;
+
+      private:
+        bool Matches(const Field& field) {
+            if (field.tokens.size() != m_path.size()) {
+                return false;
+            }
+            m_indices.clear();
+            for (std::size_t depth = 0; depth < m_path.size(); depth++) {
+                const Token& token = field.tokens[depth];
+                const Frame& frame = m_path[depth];
+                if (!frame.is_array) {
+                    if (token.key != frame.key) {
+                        return false;
+                    }
+                } else if (token.wildcard) {
+                    m_indices.push_back(frame.index);
+                } else if (token.index != frame.index) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        bool Value(const JsonFieldValue& value) {
+            const auto& fields = m_extractor.m_fields;
+            for (std::size_t i = 0; i < fields.size(); i++) {
+                if (m_found[i] || !Matches(fields[i])) {
+                    continue;
+                }
+                m_on_field(i, std::span<const std::size_t>(m_indices), value);
+                if (fields[i].num_wildcards == 0) {
+                    m_found[i] = true;
+                    m_remaining--;
+                }
+            }
+            if (m_remaining == 0 && !m_extractor.m_has_wildcard) {
+                stopped_early = true;
+                return false;
+            }
+            NextElement();
+            return true;
+        }
+
+        bool EndContainer() {
+            m_path.pop_back();
+            NextElement();
+            return true;
+        }
+
+        void NextElement() {
+            if (!m_path.empty() && m_path.back().is_array) {
+                m_path.back().index++;
+            }
+        }
+
+        const JsonFieldExtractor& m_extractor;
+        Callback& m_on_field;
+        std::size_t m_remaining;
+        std::vector<bool> m_found;
+        std::vector<Frame> m_path;
+        std::vector<std::size_t> m_indices;
+    };
+
+    std::vector<Field> m_fields;
+    bool m_has_wildcard = false;
+};
@@ -3,8 +3,16 @@
 
 #include <csignal>
 #include <cstdarg>
+#include <cstddef>
+#include <mutex>
 #include <nexus/client.hpp>
+#include <optional>
+#include <string>
 #include <syslog.h>
+#include <vector>
+
+#include "json_field_extractor.hpp"
+#include "shared_ring_reader.hpp"
 
 using namespace axis_os_nexus;
 using namespace std;
@@ -24,11 +32,126 @@ static void sig_handler(int signum) {
     // Do nothing, just let pause() in main() return.
 }
 
+// Logs the objects of each batch. The crops of the objects are read in place from the shared ring
+// of the detector, which is mapped when the first batch that refers to it arrives.
 class ObjectLogger : public TopicDataSubscriberListener {
+  public:
+    ObjectLogger()
+        : m_fields({"/objects/*/object",
+                    "/objects/*/distance",
+                    "/objects/*/crop",
+                    "/ring/socket",
+                    "/ring/id"}) {}
+
     virtual void OnData(unique_ptr<TopicSample> sample) override {
-        string data = sample->topic_data.ToJson();
-        syslog(LOG_INFO, "Received data: %s", data.c_str());
+        struct Object {
+            string name      = "unknown";
+            int64_t distance = -1;
+            optional<uint64_t> crop;
+        };
+
+        // Objects are indexed by their position in the array, the keys may come in any order
+        vector<Object> objects;
+        string ring_socket;
+        uint64_t ring_id = 0;
+        auto on_field = [&](size_t field, span<const size_t> indices, const JsonFieldValue& value) {
+            if (field == ring_socket_field) {
+                ring_socket = get<string_view>(value);
+                return;
+            }
+            if (field == ring_id_field) {
+                ring_id = JsonFieldAsInteger<uint64_t>(value).value();
+                return;
+            }
+
+            size_t index = indices[0];
+            if (index >= objects.size()) {
+                objects.resize(index + 1);
+            }
+            if (field == object_field) {
+                objects[index].name = get<string_view>(value);
+            } else if (field == distance_field) {
+                objects[index].distance = JsonFieldAsInteger<int64_t>(value).value();
+            } else if (field == crop_field) {
+                objects[index].crop = JsonFieldAsInteger<uint64_t>(value).value();
+            }
+        };
+
+        try {
+            m_fields.Extract(sample->topic_data.ToJson(), on_field);
+        } catch (const exception& exc) {
+            panic("Error when handling received data: %s", exc.what());
+        }
+
+        lock_guard lock(m_mutex);
+        bool has_ring = !ring_socket.empty() && MapRing(ring_socket, ring_id);
+
+        string message;
+        for (const auto& object : objects) {
+            message += (message.empty() ? "" : ", ") + object.name + " at " +
+                       to_string(object.distance);
+            if (has_ring && object.crop) {
+                message += DescribeCrop(*object.crop);
+            }
+        }
+        syslog(LOG_INFO, "Received %zu objects: %s", objects.size(), message.c_str());
+    }
+
+  private:
+    enum : size_t { object_field, distance_field, crop_field, ring_socket_field, ring_id_field };
+
+    // Maps the ring the batch refers to, a restarted detector has a new one
+    bool MapRing(const string& socket, uint64_t ring_id) {
+        if (m_ring && m_ring->RingId() == ring_id) {
+            return true;
+        }
+        if (ring_id == m_failed_ring_id) {
+            return false;
+        }
+        m_ring = SharedRingReader::Connect(socket);
+        if (!m_ring) {
+            // Not retried until the detector has a new ring, the warning is already logged
+            m_failed_ring_id = ring_id;
+            return false;
+        }
+        syslog(LOG_INFO, "Mapped the shared ring on socket %s", socket.c_str());
+        return true;
     }
+
+    // The crop is used in place, here by taking the mean of its pixels
+    string DescribeCrop(uint64_t crop) const {
+        uint32_t width  = 0;
+        uint32_t height = 0;
+        uint64_t sum    = 0;
+        size_t size     = 0;
+        auto result =
+            m_ring->Read(crop, [&](const SharedRecordInfo& info, span<const byte> payload) {
+                if (info.kind != SharedRecordKind::Frame || info.format != shared_format_gray8) {
+                    return;
+                }
+                width  = info.dims[0];
+                height = info.dims[1];
+                size   = payload.size();
+                for (byte pixel : payload) {
+                    sum += to_integer<uint64_t>(pixel);
+                }
+            });
+
+        if (result == SharedRingReader::ReadResult::Overwritten) {
+            return " (crop overwritten)";
+        }
+        if (result == SharedRingReader::ReadResult::NotWritten || size == 0) {
+            return " (no crop)";
+        }
+        return " (crop " + to_string(width) + "x" + to_string(height) + ", mean " +
+               to_string(sum / size) + ")";
+    }
+
+    const JsonFieldExtractor m_fields;
+
+    mutex m_mutex;
+    unique_ptr<SharedRingReader> m_ring;
+    uint64_t m_failed_ring_id = 0;
 };
 
 static auto initialize_nexus(const string& client_name) {
@@ -0,0 +1,161 @@
+// Copyright (C) 2025 Axis Communications AB, Lund, Sweden
+// Licensed under the MIT License. See LICENSE file for details.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <string>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <syslog.h>
+#include <unistd.h>
+
+#include "shared_ring.hpp"
+
+// Maps the ring of another application and reads its records in place, see shared_ring.hpp.
+//
+// The ring is read-only to the reader. A record can be overwritten by the writer while it is
+// used, which Read() tells afterwards, so anything computed from such a record is thrown away.
+class SharedRingReader {
+  public:
+    enum class ReadResult {
+        Ok,
+        // The record has not been written yet
+        NotWritten,
+        // The writer has wrapped around and reused the slot of the record
+        Overwritten
+    };
+
+    // Connect to the writer on the abstract socket and map its ring, nullptr on failure
+    static std::unique_ptr<SharedRingReader> Connect(const std::string& socket_name) {
+        int memory_fd = ReceiveRing(socket_name);
+        if (memory_fd < 0) {
+            return nullptr;
+        }
+
+        struct stat status = {};
+        void* memory       = MAP_FAILED;
+        std::size_t size   = 0;
+        if (fstat(memory_fd, &status) == 0 && status.st_size >= 0) {
+            size   = static_cast<std::size_t>(status.st_size);
+            memory = size >= sizeof(SharedRingHeader)
+                         ? mmap(nullptr, size, PROT_READ, MAP_SHARED, memory_fd, 0)
+                         : MAP_FAILED;
+        }
+        // The mapping keeps the memory
+        close(memory_fd);
+        if (memory == MAP_FAILED) {
+            syslog(LOG_WARNING, "Could not map the shared ring: %s", std::strerror(errno));
+            return nullptr;
+        }
+
+        const auto* header = static_cast<const SharedRingHeader*>(memory);
+        if (header->magic != shared_ring_magic || header->version != shared_ring_version ||
+            header->num_slots == 0 || SharedRingSize(header->num_slots, header->slot_size) > size) {
+            syslog(LOG_WARNING, "The shared ring on socket %s is not valid", socket_name.c_str());
+            munmap(memory, size);
+            return nullptr;
+        }
+        return std::unique_ptr<SharedRingReader>(new SharedRingReader(memory, size));
+    }
+
+    SharedRingReader(const SharedRingReader&)            = delete;
+    SharedRingReader& operator=(const SharedRingReader&) = delete;
+
+    ~SharedRingReader() { munmap(m_memory, m_size); }
+
+    std::uint64_t RingId() const { return m_header->ring_id; }
+
+    // Call use(info, payload) with a record in place. The result is only valid if Ok is returned,
+    // otherwise the writer may have changed the payload during the call.
+    template <class F>
+    ReadResult Read(std::uint64_t sequence, F&& use) const {
+        if (sequence >= m_header->next_sequence.load(std::memory_order_acquire)) {
+            return ReadResult::NotWritten;
+        }
+        const SharedRingSlot& slot = m_slots[sequence % m_header->num_slots];
+        const std::uint64_t lock   = slot.lock.load(std::memory_order_acquire);
+        if (lock != 2 * sequence + 2) {
+            return ReadResult::Overwritten;
+        }
+
+        const SharedRecordInfo info = slot.info;
+        const std::size_t size      = std::min(info.size, m_header->slot_size);
+        use(info,
+            std::span<const std::byte>(
+                m_payloads + (sequence % m_header->num_slots) * m_header->slot_size,
+                size));
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return slot.lock.load(std::memory_order_relaxed) == lock ? ReadResult::Ok
+                                                                 : ReadResult::Overwritten;
+    }
+
+  private:
+    SharedRingReader(void* memory, std::size_t size)
+        : m_memory(memory),
+          m_size(size),
+          m_header(static_cast<const SharedRingHeader*>(memory)),
+          m_slots(reinterpret_cast<const SharedRingSlot*>(m_header + 1)),
+          m_payloads(static_cast<const std::byte*>(memory) +
+                     SharedRingPayloadOffset(m_header->num_slots)) {}
+
+    static int ReceiveRing(const std::string& socket_name) {
+        sockaddr_un address  = {};
+        address.sun_family   = AF_UNIX;
+        const auto name_size = std::min(socket_name.size(), sizeof(address.sun_path) - 1);
+        std::memcpy(address.sun_path + 1, socket_name.data(), name_size);
+        const auto address_size =
+            static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + 1 + name_size);
+
+        int socket_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+        if (socket_fd < 0) {
+            return -1;
+        }
+        // The writer answers at once, unless this user is not allowed
+        timeval timeout = {.tv_sec = 1, .tv_usec = 0};
+        setsockopt(socket_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        char byte  = 0;
+        iovec data = {.iov_base = &byte, .iov_len = sizeof(byte)};
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+        msghdr message                                         = {};
+        message.msg_iov                                        = &data;
+        message.msg_iovlen                                     = 1;
+        message.msg_control                                    = control;
+        message.msg_controllen                                 = sizeof(control);
+
+        int memory_fd = -1;
+        if (connect(socket_fd, reinterpret_cast<sockaddr*>(&address), address_size) ||
+            recvmsg(socket_fd, &message, MSG_CMSG_CLOEXEC) < 0) {
+            syslog(LOG_WARNING,
+                   "Could not receive the shared ring on socket %s: %s",
+                   socket_name.c_str(),
+                   std::strerror(errno));
+        } else if (cmsghdr* header = CMSG_FIRSTHDR(&message);
+                   header && header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_RIGHTS) {
+            std::memcpy(&memory_fd, CMSG_DATA(header), sizeof(int));
+        } else {
+            // A writer that refuses the user closes the connection without a descriptor
+            syslog(LOG_WARNING, "Refused by the shared ring on socket %s", socket_name.c_str());
+        }
+        close(socket_fd);
+        return memory_fd;
+    }
+
+    void* const m_memory;
+    const std::size_t m_size;
+    const SharedRingHeader* const m_header;
+    const SharedRingSlot* const m_slots;
+    const std::byte* const m_payloads;
+};
@@ -2,10 +2,22 @@
 // Licensed under the MIT License. See LICENSE file for details.
 
 #include <atomic>
+#include <charconv>
+#include <chrono>
 #include <csignal>
 #include <cstdarg>
+#include <cstring>
+#include <limits>
+#include <mutex>
 #include <nexus/client.hpp>
+#include <string_view>
 #include <syslog.h>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "production_scheduler.hpp"
+#include "shared_ring_writer.hpp"
 
 using namespace axis_os_nexus;
 using namespace std;
@@ -18,22 +30,61 @@ const string topic_definition = R"(
 {
     "topic_name": ")" + topic_name +
                                 R"(",
-    "description": "Detected objects are written to this topic",
-    "version": "1.0.0",
+    "description": "The objects detected in a frame are written to this topic as one batch",
+    "version": "2.1.0",
     "data_schema": {
         "type": "object",
         "properties": {
-            "object": {
-                "type": "string"
+            "objects": {
+                "type": "array",
+                "items": {
+                    "type": "object",
+                    "properties": {
+                        "object": {
+                            "type": "string"
+                        },
+                        "distance": {
+                            "type": "integer"
+                        },
+                        "crop": {
+                            "description": "Sequence number of the crop in the shared ring",
+                            "type": "integer"
+                        }
+                    },
+                    "required": ["object"]
+                }
             },
-            "distance": {
-                "type": "integer"
+            "ring": {
+                "description": "The shared memory ring holding the crops",
+                "type": "object",
+                "properties": {
+                    "socket": {
+                        "type": "string"
+                    },
+                    "id": {
+                        "type": "integer"
+                    }
+                },
+                "required": ["socket", "id"]
             }
         },
-        "required": ["object"]
+        "required": ["objects"]
     }
 })";
 
+// The update intervals offered to consumers, shortest first
+const vector<ProductionScheduler::Interval> update_intervals = {
+    ProductionScheduler::Interval(500),
+    ProductionScheduler::Interval(1000),
+    ProductionScheduler::Interval(2000)};
+
+// The crops of the objects are shared in memory with the consumers, only their sequence numbers
+// are written to the topic. The users are the ones given read access to the topic in the manifest.
+const string ring_socket_name           = topic_name + ".ring";
+const vector<string> ring_allowed_users = {"acap-object_consumer"};
+constexpr uint32_t ring_slots           = 32;
+constexpr uint32_t crop_size            = 64;
+
 // Print an error to syslog and exit the application if a fatal error occurs
 __attribute__((noreturn)) __attribute__((format(printf, 1, 2))) static void
 panic(const char* format, ...) {
@@ -49,27 +100,131 @@ static void sig_handler(int signum) {
     terminate_application = true;
 }
 
+// Forwards the consumer match status of each registered production to the scheduler. Each
+// production offers one update interval of the scheduler.
 class ConsumerMatchListener : public TopicDataWriterListener {
   public:
-    ConsumerMatchListener(shared_ptr<atomic<bool>> consumers_exist)
-        : m_consumers_exist(move(consumers_exist)) {}
+    ConsumerMatchListener(shared_ptr<ProductionScheduler> scheduler)
+        : m_scheduler(move(scheduler)) {}
+
+    // A match update may arrive before RegisterProduction() has returned the id, so updates for
+    // unknown ids are kept until the production is added
+    void AddProduction(ProductionId id, size_t interval_index) {
+        lock_guard lock(m_mutex);
+        m_productions.push_back({id, interval_index});
+        for (auto it = m_pending.begin(); it != m_pending.end(); ++it) {
+            if (it->first == id) {
+                m_scheduler->SetDemand(interval_index, it->second);
+                m_pending.erase(it);
+                break;
+            }
+        }
+    }
 
-    virtual void OnConsumerMatchUpdate([[maybe_unused]] ProductionId id,
-                                       ConsumerMatchStatus& status) override {
+    virtual void OnConsumerMatchUpdate(ProductionId id, ConsumerMatchStatus& status) override {
+        bool matched;
         if (status == ConsumerMatchStatus::MATCH) {
-            syslog(LOG_INFO, "Consumers exist");
-            *m_consumers_exist = true;
+            matched = true;
         } else if (status == ConsumerMatchStatus::NO_MATCH) {
-            syslog(LOG_INFO, "Consumers do not exist");
-            *m_consumers_exist = false;
+            matched = false;
         } else {
             // We should never come here
             syslog(LOG_WARNING, "Received invalid ConsumerMatchStatus");
+            return;
+        }
+
+        lock_guard lock(m_mutex);
+        for (const auto& [production_id, interval_index] : m_productions) {
+            if (production_id == id) {
+                syslog(LOG_INFO,
+                       "Consumers %s for updates every %lld ms",
+                       matched ? "exist" : "do not exist",
+                       static_cast<long long>(m_scheduler->Intervals()[interval_index].count()));
+                m_scheduler->SetDemand(interval_index, matched);
+                return;
+            }
+        }
+        m_pending.push_back({id, matched});
+    }
+
+  private:
+    shared_ptr<ProductionScheduler> m_scheduler;
+    mutex m_mutex;
+    vector<pair<ProductionId, size_t>> m_productions;
+    vector<pair<ProductionId, bool>> m_pending;
+};
+
+// Serializes all detections of a frame into one JSON message. The buffer keeps its capacity
+// between frames, so no memory is allocated once it has grown to the largest batch.
+class DetectionBatchEncoder {
+  public:
+    explicit DetectionBatchEncoder(size_t reserved_objects) {
+        m_json.reserve(batch_overhead + reserved_objects * object_size);
+    }
+
+    void Begin(string_view ring_socket, uint64_t ring_id) {
+        m_json.assign(R"({"ring":{"socket":")");
+        AppendEscaped(ring_socket);
+        m_json += R"(","id":)";
+        AppendInteger(ring_id);
+        m_json += R"(},"objects":[)";
+        m_num_objects = 0;
+    }
+
+    void Add(string_view type, int distance, uint64_t crop) {
+        if (m_num_objects++ > 0) {
+            m_json += ',';
         }
+        m_json += R"({"object":")";
+        AppendEscaped(type);
+        m_json += R"(","distance":)";
+        AppendInteger(distance);
+        m_json += R"(,"crop":)";
+        AppendInteger(crop);
+        m_json += '}';
+    }
+
+    const string& Finish() {
+        m_json += "]}";
+        return m_json;
     }
 
   private:
-    shared_ptr<atomic<bool>> m_consumers_exist;
+    // Room for the enclosing object with the ring and one typical detection
+    static constexpr size_t batch_overhead = 80;
+    static constexpr size_t object_size    = 64;
+
+    void AppendEscaped(string_view text) {
+        static constexpr char hex_digits[] = "0123456789abcdef";
+        for (char c : text) {
+            auto byte = static_cast<unsigned char>(c);
+            if (c == '"' || c == '\\') {
+                m_json += '\\';
+                m_json += c;
+            } else if (byte < 0x20) {
+                // Control characters are not allowed raw in a JSON string
+                m_json += "\\u00";
+                m_json += hex_digits[byte >> 4];
+                m_json += hex_digits[byte & 0xf];
+            } else {
+                m_json += c;
+            }
+        }
+    }
+
+    template <class T>
+    void AppendInteger(T value) {
+        // digits10 is one short of the longest value, and a signed value needs its sign
+        char buffer[numeric_limits<T>::digits10 + 3];
+        auto result = to_chars(buffer, buffer + sizeof(buffer), value);
+        if (result.ec != errc()) {
+            throw system_error(make_error_code(result.ec), "Could not format an integer");
+        }
+        m_json.append(buffer, result.ptr);
+    }
+
+    string m_json;
+    size_t m_num_objects = 0;
 };
 
 class Application {
@@ -92,10 +247,13 @@ class Application {
 
         CreateTopicAndWriter("Data writer for object-detector");
 
-        m_consumersExist = make_shared<atomic<bool>>(false);
-        auto listener    = make_shared<ConsumerMatchListener>(m_consumersExist);
+        m_scheduler = make_shared<ProductionScheduler>(update_intervals);
+        auto listener = make_shared<ConsumerMatchListener>(m_scheduler);
 
-        SetListenerAndRegisterProduction(listener);
+        SetListenerAndRegisterProductions(listener);
+
+        m_ring = make_unique<SharedRingWriter>(
+            ring_socket_name, ring_slots, crop_size * crop_size, ring_allowed_users);
     }
 
     void Run() { PublishFakeObjectDetections(); }
@@ -119,14 +277,24 @@ class Application {
         m_writer->Initialize(topic->GetName()).value();  // Throws bad_expected_access on failure
     }
 
-    void SetListenerAndRegisterProduction(shared_ptr<TopicDataWriterListener> listener) {
+    // One production is registered per update interval, so the match status tells which
+    // intervals the consumers want
+    void SetListenerAndRegisterProductions(shared_ptr<ConsumerMatchListener> listener) {
         m_writer->SetListener(listener);
 
-        auto topic_data = TopicData::FromJson("{}").value();
-        m_writer->RegisterProduction(topic_data).value();  // Throws bad_expected_access on failure
+        const auto& intervals = m_scheduler->Intervals();
+        for (size_t i = 0; i < intervals.size(); i++) {
+            string production =
+                R"({"update_interval_ms":)" + to_string(intervals[i].count()) + "}";
+            auto topic_data = TopicData::FromJson(production).value();
+            // Throws bad_expected_access on failure
+            ProductionId id = m_writer->RegisterProduction(topic_data).value();
+            listener->AddProduction(id, i);
+        }
 
-        // The production will be unregistered when the client disconnects.
-        // It is also possible to explicitly unregister it with the UnregisterProduction() function.
+        // The productions will be unregistered when the client disconnects.
+        // It is also possible to explicitly unregister them with the UnregisterProduction()
+        // function.
     }
 
     void PublishFakeObjectDetections() {
@@ -140,34 +308,63 @@ class Application {
                                      {.type = "bird", .distance = 100, .speed = +5},
                                      {.type = "dog", .distance = 100, .speed = +2}}};
 
-        while (!terminate_application) {
-            for (auto& obj : objects) {
-                obj.distance += obj.speed;
+        DetectionBatchEncoder encoder(objects.size());
+        uint64_t frame_id = 0;
 
-                if (obj.distance <= 50 || obj.distance >= 1000) {
-                    obj.speed *= -1;
-                }
-            }
+        // Nothing is computed while there are no consumers. The objects move one step per
+        // shortest offered interval, so their speed does not depend on the demanded interval.
+        while (size_t elapsed = m_scheduler->WaitForNextUpdate(terminate_application)) {
+            auto interval = m_scheduler->DemandedInterval().value_or(update_intervals.front());
+            size_t steps  = elapsed * static_cast<size_t>(interval / update_intervals.front());
 
-            if (*m_consumersExist) {
+            for (size_t step = 0; step < steps; step++) {
                 for (auto& obj : objects) {
-                    string json = "{ \"object\": \"" + obj.type +
-                                  "\", \"distance\": " + to_string(obj.distance) + "}";
+                    obj.distance += obj.speed;
 
-                    TopicData topic_data = TopicData::FromJson(json).value();
-                    m_writer->WriteData(topic_data, nullopt)
-                        .value();  // Throws bad_expected_access on failure
+                    if (obj.distance <= 50 || obj.distance >= 1000) {
+                        obj.speed *= -1;
+                    }
                 }
             }
 
-            sleep(2);
+            // All objects of the frame are sent in one message, with their crops in the ring
+            frame_id++;
+            encoder.Begin(m_ring->SocketName(), m_ring->RingId());
+            for (auto& obj : objects) {
+                encoder.Add(obj.type, obj.distance, WriteFakeCrop(frame_id, obj.distance));
+            }
+
+            TopicData topic_data = TopicData::FromJson(encoder.Finish()).value();
+            m_writer->WriteData(topic_data, nullopt)
+                .value();  // Throws bad_expected_access on failure
         }
     }
 
+    // A real detector would scale the box of the object from the frame into the ring here. The
+    // fake crop is darker the farther away the object is.
+    uint64_t WriteFakeCrop(uint64_t frame_id, int distance) {
+        auto now           = chrono::steady_clock::now().time_since_epoch();
+        span<byte> payload = m_ring->Reserve();
+        memset(payload.data(), 255 - distance * 255 / 1000, crop_size * crop_size);
+
+        SharedRecordInfo info = {};
+        info.kind             = SharedRecordKind::Frame;
+        info.format           = shared_format_gray8;
+        info.num_dims         = 3;
+        info.dims[0]          = crop_size;  // Width
+        info.dims[1]          = crop_size;  // Height
+        info.dims[2]          = crop_size;  // Stride
+        info.size             = crop_size * crop_size;
+        info.frame_id         = frame_id;
+        info.timestamp_us     = chrono::duration_cast<chrono::microseconds>(now).count();
+        return m_ring->Publish(info);
+    }
+
   private:
     unique_ptr<Client> m_client;
     unique_ptr<TopicDataWriter> m_writer;
-    shared_ptr<atomic<bool>> m_consumersExist;
+    shared_ptr<ProductionScheduler> m_scheduler;
+    unique_ptr<SharedRingWriter> m_ring;
 };
 
 int main() {
@@ -180,6 +377,8 @@ int main() {
         app.Run();
     } catch (const bad_expected_access<ApiError>& exc) {
         panic("Failed during Nexus operation: %s", exc.error().GetMessage().c_str());
+    } catch (const system_error& exc) {
+        panic("Failed to share memory: %s", exc.what());
     }
 
     syslog(LOG_INFO, "Application terminated");
@@ -0,0 +1,97 @@
+// Copyright (C) 2025 Axis Communications AB, Lund, Sweden
+// Licensed under the MIT License. See LICENSE file for details.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+// Decides when a producer should compute and publish a new update, based on consumer demand.
+//
+// The producer offers a number of update intervals, typically one Nexus production per interval,
+// and reports for each of them whether consumers are matched. While no interval is demanded,
+// WaitForNextUpdate() blocks, so the producer skips all work. Otherwise it paces the producer at
+// the shortest demanded interval. If the producer falls behind, the missed updates are skipped
+// instead of being produced back to back, so the work never exceeds what the consumers asked for.
+//
+// SetDemand() may be called from any thread, e.g. from a TopicDataWriterListener.
+class ProductionScheduler {
+  public:
+    using Clock    = std::chrono::steady_clock;
+    using Interval = std::chrono::milliseconds;
+
+    explicit ProductionScheduler(std::vector<Interval> intervals)
+        : m_intervals(std::move(intervals)), m_demanded(m_intervals.size(), false) {}
+
+    const std::vector<Interval>& Intervals() const { return m_intervals; }
+
+    void SetDemand(std::size_t interval_index, bool demanded) {
+        {
+            std::lock_guard lock(m_mutex);
+            m_demanded.at(interval_index) = demanded;
+        }
+        m_demand_changed.notify_all();
+    }
+
+    // The shortest demanded interval, nullopt if there is no demand
+    std::optional<Interval> DemandedInterval() const {
+        std::lock_guard lock(m_mutex);
+        return DemandedIntervalLocked();
+    }
+
+    // Blocks until the next update should be produced and returns the number of intervals that
+    // have passed since the previous update, at least one. Returns 0 once stop is set, which is
+    // polled every stop_poll_interval since it is typically set from a signal handler.
+    std::size_t WaitForNextUpdate(const std::atomic_bool& stop,
+                                  Interval stop_poll_interval = Interval(500)) {
+        std::unique_lock lock(m_mutex);
+        while (!stop) {
+            auto interval = DemandedIntervalLocked();
+            auto now      = Clock::now();
+            if (!interval) {
+                // Restart the pacing when demand comes back
+                m_last_update.reset();
+                m_demand_changed.wait_for(lock, stop_poll_interval);
+                continue;
+            }
+            if (!m_last_update) {
+                m_last_update = now;
+                return 1;
+            }
+
+            auto deadline = *m_last_update + *interval;
+            if (now >= deadline) {
+                auto elapsed = static_cast<std::size_t>((now - *m_last_update) / *interval);
+                // Skip the missed updates but keep the phase of the schedule
+                m_last_update = *m_last_update + elapsed * *interval;
+                return elapsed;
+            }
+            m_demand_changed.wait_until(lock, std::min(deadline, now + stop_poll_interval));
+        }
+        return 0;
+    }
+
+  private:
+    std::optional<Interval> DemandedIntervalLocked() const {
+        std::optional<Interval> shortest;
+        for (std::size_t i = 0; i < m_intervals.size(); i++) {
+            if (m_demanded[i] && (!shortest || m_intervals[i] < *shortest)) {
+                shortest = m_intervals[i];
+            }
+        }
+        return shortest;
+    }
+
+    const std::vector<Interval> m_intervals;
+    std::vector<bool> m_demanded;
+    std::optional<Clock::time_point> m_last_update;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_demand_changed;
+};
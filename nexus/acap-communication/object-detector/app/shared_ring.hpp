@@ -0,0 +1,70 @@
+// Copyright (C) 2025 Axis Communications AB, Lund, Sweden
+// Licensed under the MIT License. See LICENSE file for details.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Layout of a ring of records in shared memory, written by one application and read in place by
+// the others. Nexus only carries the control plane: the messages refer to the records by their
+// sequence numbers, so frames, tensors and detection arrays are never copied into the topic data.
+//
+// The ring is a memfd that starts with a SharedRingHeader, followed by one SharedRingSlot
+// descriptor per slot and then the payloads of slot_size bytes each. Record n is kept in slot
+// n % num_slots until the writer wraps around to it. Each slot is a seqlock: its lock is 2n + 1
+// while record n is written and 2n + 2 once it is complete, so a reader checks before and after
+// it has used a payload that the slot still holds the record it asked for.
+//
+// The file is the same in the writing and the reading application.
+
+constexpr std::uint32_t shared_ring_magic   = 0x474e4952;  // "RING"
+constexpr std::uint32_t shared_ring_version = 1;
+
+// Fourcc of a frame with one byte per pixel
+constexpr std::uint32_t shared_format_gray8 = 0x59455247;  // "GREY"
+
+enum class SharedRecordKind : std::uint32_t { Frame = 1, Tensor = 2, Detections = 3 };
+
+// For a frame the dims are width, height and stride and the format is a fourcc. For a tensor they
+// are the dimensions of the tensor and the format is the element type.
+struct SharedRecordInfo {
+    SharedRecordKind kind;
+    std::uint32_t format;
+    std::uint32_t num_dims;
+    std::uint32_t dims[4];
+    // Bytes of the payload that are used
+    std::uint32_t size;
+    std::uint64_t frame_id;
+    std::int64_t timestamp_us;
+};
+
+struct alignas(64) SharedRingHeader {
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint32_t num_slots;
+    std::uint32_t slot_size;
+    // Tells the ring of a restarted writer from the previous one
+    std::uint64_t ring_id;
+    // Sequence number of the next record to be written
+    std::atomic<std::uint64_t> next_sequence;
+};
+
+struct alignas(64) SharedRingSlot {
+    std::atomic<std::uint64_t> lock;
+    SharedRecordInfo info;
+};
+
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free,
+              "The ring is shared between processes, which needs lock-free atomics");
+
+constexpr std::size_t shared_ring_alignment = 64;
+
+constexpr std::size_t SharedRingPayloadOffset(std::uint32_t num_slots) {
+    return sizeof(SharedRingHeader) + std::size_t{num_slots} * sizeof(SharedRingSlot);
+}
+
+constexpr std::size_t SharedRingSize(std::uint32_t num_slots, std::uint32_t slot_size) {
+    return SharedRingPayloadOffset(num_slots) + std::size_t{num_slots} * slot_size;
+}
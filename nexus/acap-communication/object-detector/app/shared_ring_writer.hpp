@@ -0,0 +1,241 @@
+// Copyright (C) 2025 Axis Communications AB, Lund, Sweden
+// Licensed under the MIT License. See LICENSE file for details.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <new>
+#include <poll.h>
+#include <pwd.h>
+#include <span>
+#include <string>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <syslog.h>
+#include <system_error>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+#include "shared_ring.hpp"
+
+// Owns a ring in shared memory and writes records to it, see shared_ring.hpp.
+//
+// A thread accepts the readers on an abstract Unix socket and sends each of them a read-only file
+// descriptor of the ring. Since any process can connect to an abstract socket, the peer must run
+// as one of the allowed users, typically the same ones that may read the Nexus topic. The ring has
+// a fixed size, sealed so that a reader can never see it shrink under its mapping.
+//
+// Reserve() and Publish() are called from one thread only. The records are written in place, so
+// producing a record is the only copy of its data.
+class SharedRingWriter {
+  public:
+    SharedRingWriter(std::string socket_name,
+                     std::uint32_t num_slots,
+                     std::uint32_t slot_size,
+                     std::vector<std::string> allowed_users)
+        : m_socket_name(std::move(socket_name)), m_allowed_users(std::move(allowed_users)) {
+        slot_size = (slot_size + shared_ring_alignment - 1) / shared_ring_alignment *
+                    shared_ring_alignment;
+        m_size = SharedRingSize(num_slots, slot_size);
+
+        CreateMemory();
+        m_header            = new (m_memory) SharedRingHeader();
+        m_header->magic     = shared_ring_magic;
+        m_header->version   = shared_ring_version;
+        m_header->num_slots = num_slots;
+        m_header->slot_size = slot_size;
+        m_header->ring_id   = static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::system_clock::now().time_since_epoch())
+                .count());
+        m_slots = reinterpret_cast<SharedRingSlot*>(m_header + 1);
+        for (std::uint32_t i = 0; i < num_slots; i++) {
+            new (&m_slots[i]) SharedRingSlot();
+        }
+        m_payloads = static_cast<std::byte*>(m_memory) + SharedRingPayloadOffset(num_slots);
+
+        CreateSocket();
+        m_acceptor = std::thread([this] { AcceptReaders(); });
+        syslog(LOG_INFO,
+               "Sharing %u records of %u bytes on socket %s",
+               num_slots,
+               slot_size,
+               m_socket_name.c_str());
+    }
+
+    SharedRingWriter(const SharedRingWriter&)            = delete;
+    SharedRingWriter& operator=(const SharedRingWriter&) = delete;
+
+    ~SharedRingWriter() {
+        m_stop = true;
+        m_acceptor.join();
+        close(m_socket_fd);
+        // The readers keep their own mappings of the memory
+        munmap(m_memory, m_size);
+        close(m_memory_fd);
+    }
+
+    const std::string& SocketName() const { return m_socket_name; }
+
+    std::uint64_t RingId() const { return m_header->ring_id; }
+
+    // The payload of the next record, to be written in place before Publish()
+    std::span<std::byte> Reserve() {
+        const std::uint64_t sequence = m_header->next_sequence.load(std::memory_order_relaxed);
+        const std::uint32_t index    = sequence % m_header->num_slots;
+        if (!m_reserved) {
+            // The readers see the slot as being written from here on
+            m_slots[index].lock.store(2 * sequence + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            m_reserved = true;
+        }
+        return {m_payloads + std::size_t{index} * m_header->slot_size, m_header->slot_size};
+    }
+
+    // Complete the reserved record and return its sequence number
+    std::uint64_t Publish(const SharedRecordInfo& info) {
+        Reserve();
+        const std::uint64_t sequence = m_header->next_sequence.load(std::memory_order_relaxed);
+        SharedRingSlot& slot         = m_slots[sequence % m_header->num_slots];
+
+        slot.info      = info;
+        slot.info.size = std::min(info.size, m_header->slot_size);
+        slot.lock.store(2 * sequence + 2, std::memory_order_release);
+        m_header->next_sequence.store(sequence + 1, std::memory_order_release);
+        m_reserved = false;
+        return sequence;
+    }
+
+  private:
+    [[noreturn]] static void ThrowError(const char* what) {
+        throw std::system_error(errno, std::generic_category(), what);
+    }
+
+    void CreateMemory() {
+        m_memory_fd = memfd_create("shared_ring", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+        if (m_memory_fd < 0) {
+            ThrowError("memfd_create");
+        }
+        if (ftruncate(m_memory_fd, static_cast<off_t>(m_size)) ||
+            fcntl(m_memory_fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL)) {
+            ThrowError("Sizing the shared ring");
+        }
+        m_memory = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_memory_fd, 0);
+        if (m_memory == MAP_FAILED) {
+            ThrowError("mmap");
+        }
+    }
+
+    void CreateSocket() {
+        sockaddr_un address  = {};
+        address.sun_family   = AF_UNIX;
+        const auto name_size = std::min(m_socket_name.size(), sizeof(address.sun_path) - 1);
+        // A leading zero makes the name abstract, so no file is left behind
+        std::memcpy(address.sun_path + 1, m_socket_name.data(), name_size);
+        const auto address_size =
+            static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + 1 + name_size);
+
+        m_socket_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+        if (m_socket_fd < 0) {
+            ThrowError("socket");
+        }
+        if (bind(m_socket_fd, reinterpret_cast<sockaddr*>(&address), address_size) ||
+            listen(m_socket_fd, 4)) {
+            ThrowError("Binding the shared ring socket");
+        }
+    }
+
+    bool IsAllowed(int client_fd) const {
+        ucred credentials   = {};
+        socklen_t cred_size = sizeof(credentials);
+        if (getsockopt(client_fd, SOL_SOCKET, SO_PEERCRED, &credentials, &cred_size)) {
+            return false;
+        }
+        passwd entry;
+        passwd* result = nullptr;
+        char buffer[1024];
+        if (getpwuid_r(credentials.uid, &entry, buffer, sizeof(buffer), &result) || !result) {
+            return false;
+        }
+        return std::find(m_allowed_users.begin(), m_allowed_users.end(), result->pw_name) !=
+               m_allowed_users.end();
+    }
+
+    void SendRing(int client_fd) const {
+        // The readers get a descriptor that can only be mapped for reading
+        char path[32];
+        std::snprintf(path, sizeof(path), "/proc/self/fd/%d", m_memory_fd);
+        int read_only_fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (read_only_fd < 0) {
+            syslog(LOG_WARNING, "Could not reopen the shared ring: %s", std::strerror(errno));
+            return;
+        }
+
+        char byte  = 0;
+        iovec data = {.iov_base = &byte, .iov_len = sizeof(byte)};
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+        msghdr message                                         = {};
+        message.msg_iov                                        = &data;
+        message.msg_iovlen                                     = 1;
+        message.msg_control                                    = control;
+        message.msg_controllen                                 = sizeof(control);
+
+        cmsghdr* header    = CMSG_FIRSTHDR(&message);
+        header->cmsg_level = SOL_SOCKET;
+        header->cmsg_type  = SCM_RIGHTS;
+        header->cmsg_len   = CMSG_LEN(sizeof(int));
+        std::memcpy(CMSG_DATA(header), &read_only_fd, sizeof(int));
+
+        if (sendmsg(client_fd, &message, MSG_NOSIGNAL) < 0) {
+            syslog(LOG_WARNING, "Could not send the shared ring: %s", std::strerror(errno));
+        }
+        close(read_only_fd);
+    }
+
+    void AcceptReaders() {
+        pollfd listener = {.fd = m_socket_fd, .events = POLLIN, .revents = 0};
+        while (!m_stop) {
+            // The stop flag is polled, like in ProductionScheduler
+            if (poll(&listener, 1, 500) <= 0) {
+                continue;
+            }
+            int client_fd = accept4(m_socket_fd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (client_fd < 0) {
+                continue;
+            }
+            if (IsAllowed(client_fd)) {
+                SendRing(client_fd);
+            } else {
+                syslog(LOG_WARNING, "Refused a shared ring reader that is not an allowed user");
+            }
+            close(client_fd);
+        }
+    }
+
+    const std::string m_socket_name;
+    const std::vector<std::string> m_allowed_users;
+
+    std::size_t m_size = 0;
+    int m_memory_fd    = -1;
+    void* m_memory     = nullptr;
+    int m_socket_fd    = -1;
+
+    SharedRingHeader* m_header = nullptr;
+    SharedRingSlot* m_slots    = nullptr;
+    std::byte* m_payloads      = nullptr;
+    bool m_reserved            = false;
+
+    std::atomic_bool m_stop = false;
+    std::thread m_acceptor;
+};
@@ -1,12 +1,15 @@
 // Copyright (C) 2025 Axis Communications AB, Lund, Sweden
 // Licensed under the MIT License. See LICENSE file for details.
 
+#include <atomic>
 #include <csignal>
 #include <cstdarg>
 #include <nexus/client.hpp>
-#include <nlohmann/json.hpp>
 #include <syslog.h>
 
+#include "json_field_extractor.hpp"
+#include "resource_governor.hpp"
+
 using namespace axis_os_nexus;
 using namespace std;
 
@@ -25,23 +28,75 @@ static void sig_handler(int signum) {
     // Do nothing, just let pause() in main() return.
 }
 
+// A policy that lowers the rate of the utilization logging of this application with the CPU
+// pressure, the same way a video analytics pipeline would lower its inference rate. The samples are
+// still handed to the governor, only the logging of them is skipped.
+class LogIntervalPolicy : public ResourcePolicy {
+  public:
+    void OnMemoryPressure(PressureLevel level, const MemorySample& sample) override {
+        syslog(LOG_INFO,
+               "Memory pressure %s, %lld of %lld kB available",
+               PressureLevelName(level),
+               static_cast<long long>(sample.available),
+               static_cast<long long>(sample.total));
+    }
+
+    void OnCpuPressure(PressureLevel level, int utilization_pct) override {
+        const unsigned int interval = level == PressureLevel::Critical ? 4
+                                      : level == PressureLevel::High   ? 2
+                                                                       : 1;
+        m_interval.store(interval);
+        syslog(LOG_INFO,
+               "CPU pressure %s, smoothed utilization %d%%, logging every %u messages",
+               PressureLevelName(level),
+               utilization_pct,
+               interval);
+    }
+
+    // Log only every Nth received message
+    unsigned int Interval() const { return m_interval.load(); }
+
+  private:
+    atomic<unsigned int> m_interval = 1;
+};
+
 class ResourceUtilizationLogger : public TopicDataSubscriberListener {
   public:
-    ResourceUtilizationLogger(string memory_topic, string cpu_topic)
-        : m_memory_topic(move(memory_topic)), m_cpu_topic(move(cpu_topic)) {}
+    ResourceUtilizationLogger(string memory_topic,
+                              string cpu_topic,
+                              shared_ptr<ResourceGovernor> governor,
+                              shared_ptr<const LogIntervalPolicy> log_interval)
+        : m_memory_topic(move(memory_topic)),
+          m_cpu_topic(move(cpu_topic)),
+          m_governor(move(governor)),
+          m_log_interval(move(log_interval)),
+          m_memory_fields({"/mem_total", "/mem_used", "/mem_used_pct", "/mem_available"}),
+          m_cpu_fields({"/total_utilization"}) {}
 
     virtual void OnData(unique_ptr<TopicSample> sample) override {
+        const bool log = m_received++ % m_log_interval->Interval() == 0;
         if (sample->topic_name == m_memory_topic) {
-            syslog(LOG_INFO,
-                   "Received memory utilization message: %s",
-                   sample->topic_data.ToJson().c_str());
+            // Index 0-3 match the pointers given to m_memory_fields
+            int64_t memory[4] = {-1, -1, -1, -1};
+            Extract("memory", sample->topic_data, m_memory_fields, memory);
+            if (log) {
+                syslog(LOG_INFO,
+                       "Received memory utilization message. Used memory: %lld of %lld (%lld%%)",
+                       static_cast<long long>(memory[1]),
+                       static_cast<long long>(memory[0]),
+                       static_cast<long long>(memory[2]));
+            }
+            m_governor->AddMemorySample({memory[0], memory[3]});
         } else if (sample->topic_name == m_cpu_topic) {
-            try {
-                nlohmann::json value = nlohmann::json::parse(sample->topic_data.ToJson());
-                int total            = value["total_utilization"].get<int>();
-                syslog(LOG_INFO, "Received CPU utilization message. Total utilization: %d", total);
-            } catch (const exception& ex) {
-                panic("Error when handling received CPU data: %s", ex.what());
+            int64_t total = -1;
+            Extract("CPU", sample->topic_data, m_cpu_fields, &total);
+            if (log) {
+                syslog(LOG_INFO,
+                       "Received CPU utilization message. Total utilization: %lld",
+                       static_cast<long long>(total));
+            }
+            if (total >= 0) {
+                m_governor->AddCpuSample(static_cast<int>(total));
             }
         } else {
             panic("Received unexpected topic: %s", sample->topic_name.c_str());
@@ -49,8 +104,27 @@ class ResourceUtilizationLogger : public TopicDataSubscriberListener {
     }
 
   private:
+    // Pull the integer fields out of the sample without parsing it into a JSON document
+    static void Extract(const char* kind,
+                        TopicData& data,
+                        const JsonFieldExtractor& extractor,
+                        int64_t* values) {
+        try {
+            extractor.Extract(data.ToJson(), [&](size_t field, auto, const JsonFieldValue& value) {
+                values[field] = JsonFieldAsInteger<int64_t>(value).value();
+            });
+        } catch (const exception& ex) {
+            panic("Error when handling received %s data: %s", kind, ex.what());
+        }
+    }
+
     const string m_memory_topic;
     const string m_cpu_topic;
+    const shared_ptr<ResourceGovernor> m_governor;
+    const shared_ptr<const LogIntervalPolicy> m_log_interval;
+    atomic<unsigned int> m_received = 0;
+    const JsonFieldExtractor m_memory_fields;
+    const JsonFieldExtractor m_cpu_fields;
 };
 
 static auto initialize_nexus(const string& client_name) {
@@ -85,7 +159,12 @@ int main() {
     try {
         auto client = initialize_nexus("Client for memory-cpu-utilization");
 
-        auto logger = make_shared<ResourceUtilizationLogger>(memory_topic, cpu_topic);
+        auto governor     = make_shared<ResourceGovernor>();
+        auto log_interval = make_shared<LogIntervalPolicy>();
+        governor->AddPolicy(log_interval);
+
+        auto logger =
+            make_shared<ResourceUtilizationLogger>(memory_topic, cpu_topic, governor, log_interval);
 
         auto subscriber =
             create_subscriber_and_subscribe(*client,
@@ -0,0 +1,137 @@
+// Copyright (C) 2025 Axis Communications AB, Lund, Sweden
+// Licensed under the MIT License. See LICENSE file for details.
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+enum class PressureLevel { Normal, High, Critical };
+
+inline const char* PressureLevelName(PressureLevel level) {
+    switch (level) {
+        case PressureLevel::Normal:
+            return "normal";
+        case PressureLevel::High:
+            return "high";
+        case PressureLevel::Critical:
+            return "critical";
+    }
+    return "unknown";
+}
+
+struct MemorySample {
+    // In kB, as published on axis.device.memory_utilization_v1
+    std::int64_t total     = 0;
+    std::int64_t available = 0;
+};
+
+struct GovernorThresholds {
+    // Percent of the memory that is not available to enter the high and critical levels
+    int memory_high_pct     = 80;
+    int memory_critical_pct = 90;
+    // Smoothed total CPU utilization in percent to enter the high and critical levels
+    int cpu_high_pct     = 85;
+    int cpu_critical_pct = 95;
+    // A level is left when the value is this many percent below the threshold of the level
+    int hysteresis_pct = 5;
+    // Weight of the newest CPU sample in the moving average, the CPU topic is noisy
+    double cpu_smoothing = 0.5;
+};
+
+// Implemented by the parts of an application that can trade quality for resources, e.g. by
+// shrinking the VDO buffer count or evicting caches under memory pressure, or by lowering the
+// inference rate or resolution under CPU pressure. Called only when a level changes.
+class ResourcePolicy {
+  public:
+    virtual ~ResourcePolicy() = default;
+
+    virtual void OnMemoryPressure(PressureLevel level, const MemorySample& sample) = 0;
+    virtual void OnCpuPressure(PressureLevel level, int utilization_pct) = 0;
+};
+
+// Turns the memory and CPU utilization samples of the device into pressure levels and tells the
+// registered policies when a level changes.
+//
+// Each resource is in one of three levels. A level is entered as soon as its threshold is reached
+// but only left when the value has dropped hysteresis_pct below the threshold, so a device that
+// hovers around a threshold does not make the policies flap. The CPU utilization is smoothed with
+// an exponentially weighted moving average first, since a single busy sample says little about
+// the load. The policies are called on the thread that adds the sample, with no lock held.
+class ResourceGovernor {
+  public:
+    explicit ResourceGovernor(GovernorThresholds thresholds = {}) : m_thresholds(thresholds) {}
+
+    void AddPolicy(std::shared_ptr<ResourcePolicy> policy) {
+        std::lock_guard lock(m_mutex);
+        m_policies.push_back(std::move(policy));
+    }
+
+    void AddMemorySample(const MemorySample& sample) {
+        if (sample.total <= 0 || sample.available < 0) {
+            return;
+        }
+        const int used_pct = static_cast<int>(100 - sample.available * 100 / sample.total);
+
+        std::unique_lock lock(m_mutex);
+        auto level = NextLevel(m_memory_level,
+                               used_pct,
+                               m_thresholds.memory_high_pct,
+                               m_thresholds.memory_critical_pct);
+        if (level == m_memory_level) {
+            return;
+        }
+        m_memory_level = level;
+        auto policies  = m_policies;
+        lock.unlock();
+
+        for (auto& policy : policies) {
+            policy->OnMemoryPressure(level, sample);
+        }
+    }
+
+    void AddCpuSample(int utilization_pct) {
+        std::unique_lock lock(m_mutex);
+        m_cpu_mean = m_cpu_mean ? *m_cpu_mean + m_thresholds.cpu_smoothing *
+                                                    (utilization_pct - *m_cpu_mean)
+                                : utilization_pct;
+        const int mean = static_cast<int>(*m_cpu_mean + 0.5);
+        auto level =
+            NextLevel(m_cpu_level, mean, m_thresholds.cpu_high_pct, m_thresholds.cpu_critical_pct);
+        if (level == m_cpu_level) {
+            return;
+        }
+        m_cpu_level   = level;
+        auto policies = m_policies;
+        lock.unlock();
+
+        for (auto& policy : policies) {
+            policy->OnCpuPressure(level, mean);
+        }
+    }
+
+  private:
+    PressureLevel NextLevel(PressureLevel current, int value, int high, int critical) const {
+        // The thresholds of the current level and the ones below it are lowered by the hysteresis
+        const int hysteresis = m_thresholds.hysteresis_pct;
+        if (value >= (current == PressureLevel::Critical ? critical - hysteresis : critical)) {
+            return PressureLevel::Critical;
+        }
+        if (value >= (current != PressureLevel::Normal ? high - hysteresis : high)) {
+            return PressureLevel::High;
+        }
+        return PressureLevel::Normal;
+    }
+
+    const GovernorThresholds m_thresholds;
+
+    std::mutex m_mutex;
+    std::vector<std::shared_ptr<ResourcePolicy>> m_policies;
+    PressureLevel m_memory_level = PressureLevel::Normal;
+    PressureLevel m_cpu_level    = PressureLevel::Normal;
+    std::optional<double> m_cpu_mean;
+};
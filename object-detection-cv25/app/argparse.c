@@ -23,7 +23,12 @@
 #include <argp.h>
 #include <stdlib.h>
 
-#define KEY_USAGE (127)
+#define KEY_USAGE         (127)
+#define KEY_RECORD        (128)
+#define KEY_RECORD_FRAMES (129)
+
+// Number of output tensors recorded when --record-frames is not given
+#define DEFAULT_RECORD_FRAMES (20)
 
 static int parsePosInt(char* arg, unsigned long long* i, unsigned long long limit);
 static int parseOpt(int key, char* arg, struct argp_state* state);
@@ -37,6 +42,42 @@ const struct argp_option opts[] = {
      "from the library. If not specified, the default chip for a new "
      "connection will be used.",
      0},
+    {"frame-ring",
+     'r',
+     NULL,
+     0,
+     "Hands frames from the VDO fetcher thread to the application through a "
+     "lock-free ring instead of mutex protected queues.",
+     0},
+    {"vdo-snapshot",
+     'j',
+     NULL,
+     0,
+     "Cuts the detection snapshots from jpeg snapshots encoded by VDO instead "
+     "of encoding them on the CPU, which is still used if VDO fails.",
+     0},
+    {"record",
+     KEY_RECORD,
+     "FILE",
+     0,
+     "Records the output tensors of the model to FILE, to be replayed by "
+     "postprocessingbenchmark.",
+     0},
+    {"record-frames",
+     KEY_RECORD_FRAMES,
+     "COUNT",
+     0,
+     "Number of output tensors to record, 20 if not specified.",
+     0},
+    {"thread",
+     't',
+     "ROLE=SETTINGS",
+     0,
+     "Sets the CPU affinity and scheduling of the threads of ROLE, which is "
+     "capture, inference or worker. SETTINGS is a comma separated list of "
+     "cpus:FIRST[-LAST], fifo:PRIORITY (1-99) and nice:LEVEL (-20-19), e.g. "
+     "inference=cpus:1,fifo:10. Can be given once per role.",
+     0},
     {"help", 'h', NULL, 0, "Print this help text and exit.", 0},
     {"usage", KEY_USAGE, NULL, 0, "Print short usage message and exit.", 0},
     {0}};
@@ -82,6 +123,26 @@ int parseOpt(int key, char* arg, struct argp_state* state) {
             args->chip = arg;
             break;
         }
+        case 'r':
+            args->frameRing = true;
+            break;
+        case 'j':
+            args->vdoSnapshot = true;
+            break;
+        case KEY_RECORD:
+            args->recordFile = arg;
+            break;
+        case KEY_RECORD_FRAMES:
+            args->recordFrames = (unsigned int)strtoul(arg, NULL, 10);
+            if (args->recordFrames == 0) {
+                argp_error(state, "invalid number of frames to record '%s'", arg);
+            }
+            break;
+        case 't':
+            if (!parseThreadConfig(arg, args->threadConfigs)) {
+                argp_error(state, "invalid thread configuration '%s'", arg);
+            }
+            break;
         case 'h':
             argp_state_help(state, stdout, ARGP_HELP_STD_HELP);
             break;
@@ -176,6 +237,11 @@ int parseOpt(int key, char* arg, struct argp_state* state) {
             args->anchorsFile   = NULL;
             args->numLabels     = 0;
             args->numDetections = 0;
+            args->frameRing     = false;
+            args->vdoSnapshot   = false;
+            args->recordFile    = NULL;
+            args->recordFrames  = DEFAULT_RECORD_FRAMES;
+            initThreadConfigs(args->threadConfigs);
             break;
         case ARGP_KEY_END:
             if (state->arg_num != 12) {
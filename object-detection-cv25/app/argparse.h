@@ -20,9 +20,11 @@
 
 #pragma once
 
+#include <stdbool.h>
 #include <stddef.h>
 
 #include "larod.h"
+#include "threadconfig.h"
 
 typedef struct args_t {
     unsigned quality;
@@ -38,6 +40,12 @@ typedef struct args_t {
     unsigned numDetections;
     char* chip;
     char* anchorsFile;
+    bool frameRing;
+    bool vdoSnapshot;
+    // File to record the output tensors to, NULL to not record
+    char* recordFile;
+    unsigned recordFrames;
+    ThreadConfig_t threadConfigs[THREAD_NUM_ROLES];
 } args_t;
 
 bool parseArgs(int argc, char** argv, args_t* args);
@@ -85,16 +85,22 @@ static void releaseVdoBuffers(ImgProvider_t* provider);
  *    there is at least numAppFrames buffers available to the client to
  *    fetch. If there are more than numAppFrames in deliveredFrames we
  *    pick the first buffer (oldest) in the list and enqueue it to VDO.
+ * With useFrameRing the same flow is used, but the queues are replaced by
+ * deliveredRing and returnedRing and no lock is taken, see deliverToRing().
 
  * param data Pointer to ImgProvider owning thread.
  * return Pointer to unused return data.
  */
 static void* threadEntry(void* data);
 
-ImgProvider_t*
-createImgProvider(unsigned int w, unsigned int h, unsigned int numFrames, VdoFormat format) {
+ImgProvider_t* createImgProvider(unsigned int w,
+                                 unsigned int h,
+                                 unsigned int numFrames,
+                                 VdoFormat format,
+                                 bool useFrameRing) {
     bool mtxInitialized  = false;
     bool condInitialized = false;
+    bool semInitialized  = false;
 
     ImgProvider_t* provider = calloc(1, sizeof(ImgProvider_t));
     if (!provider) {
@@ -104,6 +110,7 @@ createImgProvider(unsigned int w, unsigned int h, unsigned int numFrames, VdoFor
 
     provider->vdoFormat    = format;
     provider->numAppFrames = numFrames;
+    provider->useFrameRing = useFrameRing;
 
     if (pthread_mutex_init(&provider->frameMutex, NULL)) {
         syslog(LOG_ERR, "%s: Unable to initialize mutex: %s", __func__, strerror(errno));
@@ -120,6 +127,12 @@ createImgProvider(unsigned int w, unsigned int h, unsigned int numFrames, VdoFor
     }
     condInitialized = true;
 
+    if (sem_init(&provider->frameDeliverSem, 0, 0)) {
+        syslog(LOG_ERR, "%s: Unable to initialize semaphore: %s", __func__, strerror(errno));
+        goto errorExit;
+    }
+    semInitialized = true;
+
     provider->deliveredFrames = g_queue_new();
     if (!provider->deliveredFrames) {
         syslog(LOG_ERR, "%s: Unable to create deliveredFrames queue!", __func__);
@@ -146,6 +159,9 @@ errorExit:
     if (condInitialized) {
         pthread_cond_destroy(&provider->frameDeliverCond);
     }
+    if (semInitialized) {
+        sem_destroy(&provider->frameDeliverSem);
+    }
     if (provider->deliveredFrames) {
         g_queue_free(provider->deliveredFrames);
     }
@@ -168,6 +184,7 @@ void destroyImgProvider(ImgProvider_t* provider) {
 
     pthread_mutex_destroy(&provider->frameMutex);
     pthread_cond_destroy(&provider->frameDeliverCond);
+    sem_destroy(&provider->frameDeliverSem);
 
     g_queue_free(provider->deliveredFrames);
     g_queue_free(provider->processedFrames);
@@ -260,7 +277,9 @@ bool chooseStreamResolution(unsigned int reqWidth,
         goto end;
     }
 
-    // Find smallest VDO stream resolution that fits the requested size.
+    // Find smallest VDO stream resolution that fits the requested size. Only YUV is offered
+    // here and the preprocessing cost of one format grows with the area, so the smallest
+    // stream is also the cheapest one and no measured cost is needed to choose it.
     ssize_t bestResolutionIdx       = -1;
     unsigned int bestResolutionArea = UINT_MAX;
     for (ssize_t i = 0; (gsize)i < set->count; ++i) {
@@ -376,8 +395,95 @@ static void releaseVdoBuffers(ImgProvider_t* provider) {
     }
 }
 
+/**
+ * brief Push a frame to a ring.
+ *
+ * Only one thread may push to a ring. There is always room since a ring can
+ * hold all VDO buffers and a buffer is only in one place at a time.
+ *
+ * param ring Ring to push the frame to.
+ * param buffer Frame to push.
+ */
+static void ringPush(FrameRing_t* ring, VdoBuffer* buffer) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+    atomic_store_explicit(&ring->slots[head % FRAME_RING_SIZE], buffer, memory_order_relaxed);
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+/**
+ * brief Take ownership of the frames in a ring from tail up to end.
+ *
+ * The frames are read before tail is moved since the pushing thread may reuse
+ * the slots as soon as tail has moved past them.
+ *
+ * param ring Ring to claim the frames from.
+ * param tail Value of tail that the frames were read from.
+ * param end Counter value after the last frame to claim.
+ * param buffers Set to the claimed frames, oldest first.
+ * return False if another thread claimed frames first, otherwise true.
+ */
+static bool ringClaim(FrameRing_t* ring, size_t tail, size_t end, VdoBuffer** buffers) {
+    for (size_t i = tail; i < end; i++) {
+        buffers[i - tail] =
+            atomic_load_explicit(&ring->slots[i % FRAME_RING_SIZE], memory_order_relaxed);
+    }
+    return atomic_compare_exchange_strong_explicit(&ring->tail,
+                                                   &tail,
+                                                   end,
+                                                   memory_order_acq_rel,
+                                                   memory_order_relaxed);
+}
+
+static void enqueueToVdo(ImgProvider_t* provider, VdoBuffer* buffer) {
+    GError* error = NULL;
+
+    if (!vdo_stream_buffer_enqueue(provider->vdoStream, buffer, &error)) {
+        // Fail but we continue anyway hoping for the best.
+        syslog(LOG_WARNING,
+               "%s: Failed enqueueing buffer to vdo: %s",
+               __func__,
+               (error != NULL) ? error->message : "N/A");
+        g_clear_error(&error);
+    }
+}
+
+static VdoBuffer* getLastFrameFromRing(ImgProvider_t* provider) {
+    FrameRing_t* ring = &provider->deliveredRing;
+    VdoBuffer* claimed[FRAME_RING_SIZE];
+
+    while (true) {
+        size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+        if (head == tail) {
+            if (sem_wait(&provider->frameDeliverSem) && errno != EINTR) {
+                syslog(LOG_ERR, "%s: Failed to wait on semaphore: %s", __func__, strerror(errno));
+                return NULL;
+            }
+            continue;
+        }
+        if (!ringClaim(ring, tail, head, claimed)) {
+            // The fetcher thread dropped old frames, try again
+            continue;
+        }
+
+        // Only the latest frame is used, hand the older ones back directly
+        size_t numClaimed = head - tail;
+        for (size_t i = 0; i + 1 < numClaimed; i++) {
+            ringPush(&provider->returnedRing, claimed[i]);
+        }
+        return claimed[numClaimed - 1];
+    }
+}
+
 VdoBuffer* getLastFrameBlocking(ImgProvider_t* provider) {
     VdoBuffer* returnBuf = NULL;
+
+    if (provider->useFrameRing) {
+        return getLastFrameFromRing(provider);
+    }
+
     pthread_mutex_lock(&provider->frameMutex);
 
     while (g_queue_get_length(provider->deliveredFrames) < 1) {
@@ -396,6 +502,11 @@ errorExit:
 }
 
 void returnFrame(ImgProvider_t* provider, VdoBuffer* buffer) {
+    if (provider->useFrameRing) {
+        ringPush(&provider->returnedRing, buffer);
+        return;
+    }
+
     pthread_mutex_lock(&provider->frameMutex);
 
     g_queue_push_tail(provider->processedFrames, buffer);
@@ -403,10 +514,85 @@ void returnFrame(ImgProvider_t* provider, VdoBuffer* buffer) {
     pthread_mutex_unlock(&provider->frameMutex);
 }
 
+/**
+ * brief Deliver a new frame through the queues.
+ *
+ * param provider Pointer to ImgProvider owning the queues.
+ * param newBuffer The frame fetched from VDO.
+ */
+static void deliverToQueues(ImgProvider_t* provider, VdoBuffer* newBuffer) {
+    pthread_mutex_lock(&provider->frameMutex);
+
+    g_queue_push_tail(provider->deliveredFrames, newBuffer);
+
+    VdoBuffer* oldBuffer = NULL;
+
+    // First check if there are any frames returned from app
+    // processing
+    if (g_queue_get_length(provider->processedFrames) > 0) {
+        oldBuffer = g_queue_pop_head(provider->processedFrames);
+    } else {
+        // Client specifies the number-of-recent-frames it needs to collect
+        // in one chunk (numAppFrames). Thus only enqueue buffers back to
+        // VDO if we have collected more buffers than numAppFrames.
+        if (g_queue_get_length(provider->deliveredFrames) > provider->numAppFrames) {
+            oldBuffer = g_queue_pop_head(provider->deliveredFrames);
+        }
+    }
+
+    if (oldBuffer) {
+        enqueueToVdo(provider, oldBuffer);
+    }
+    pthread_cond_signal(&provider->frameDeliverCond);
+    pthread_mutex_unlock(&provider->frameMutex);
+}
+
+/**
+ * brief Deliver a new frame through the lock-free rings.
+ *
+ * All frames handed back by the client are enqueued to VDO, and if the
+ * client has not picked up the delivered frames the oldest are dropped so
+ * that at most numAppFrames are kept.
+ *
+ * param provider Pointer to ImgProvider owning the rings.
+ * param newBuffer The frame fetched from VDO.
+ */
+static void deliverToRing(ImgProvider_t* provider, VdoBuffer* newBuffer) {
+    FrameRing_t* delivered = &provider->deliveredRing;
+    FrameRing_t* returned  = &provider->returnedRing;
+    VdoBuffer* claimed[FRAME_RING_SIZE];
+
+    ringPush(delivered, newBuffer);
+    sem_post(&provider->frameDeliverSem);
+
+    // This thread is the only one claiming from the returned ring
+    size_t tail = atomic_load_explicit(&returned->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&returned->head, memory_order_acquire);
+    if (head != tail && ringClaim(returned, tail, head, claimed)) {
+        for (size_t i = 0; i < head - tail; i++) {
+            enqueueToVdo(provider, claimed[i]);
+        }
+    }
+
+    // A failed claim means that the client just took the frames
+    tail = atomic_load_explicit(&delivered->tail, memory_order_acquire);
+    head = atomic_load_explicit(&delivered->head, memory_order_relaxed);
+    if (head - tail > provider->numAppFrames) {
+        size_t end = head - provider->numAppFrames;
+        if (ringClaim(delivered, tail, end, claimed)) {
+            for (size_t i = 0; i < end - tail; i++) {
+                enqueueToVdo(provider, claimed[i]);
+            }
+        }
+    }
+}
+
 static void* threadEntry(void* data) {
     GError* error           = NULL;
     ImgProvider_t* provider = (ImgProvider_t*)data;
 
+    applyThreadConfig(&provider->threadConfig);
+
     while (!provider->shutDown) {
         // Block waiting for a frame from VDO
         VdoBuffer* newBuffer = vdo_stream_get_buffer(provider->vdoStream, &error);
@@ -420,43 +606,19 @@ static void* threadEntry(void* data) {
             g_clear_error(&error);
             continue;
         }
-        pthread_mutex_lock(&provider->frameMutex);
-
-        g_queue_push_tail(provider->deliveredFrames, newBuffer);
-
-        VdoBuffer* oldBuffer = NULL;
 
-        // First check if there are any frames returned from app
-        // processing
-        if (g_queue_get_length(provider->processedFrames) > 0) {
-            oldBuffer = g_queue_pop_head(provider->processedFrames);
+        if (provider->useFrameRing) {
+            deliverToRing(provider, newBuffer);
         } else {
-            // Client specifies the number-of-recent-frames it needs to collect
-            // in one chunk (numAppFrames). Thus only enqueue buffers back to
-            // VDO if we have collected more buffers than numAppFrames.
-            if (g_queue_get_length(provider->deliveredFrames) > provider->numAppFrames) {
-                oldBuffer = g_queue_pop_head(provider->deliveredFrames);
-            }
-        }
-
-        if (oldBuffer) {
-            if (!vdo_stream_buffer_enqueue(provider->vdoStream, oldBuffer, &error)) {
-                // Fail but we continue anyway hoping for the best.
-                syslog(LOG_WARNING,
-                       "%s: Failed enqueueing buffer to vdo: %s",
-                       __func__,
-                       (error != NULL) ? error->message : "N/A");
-                g_clear_error(&error);
-            }
+            deliverToQueues(provider, newBuffer);
         }
         g_object_unref(newBuffer);  // Release the ref from vdo_stream_get_buffer
-        pthread_cond_signal(&provider->frameDeliverCond);
-        pthread_mutex_unlock(&provider->frameMutex);
     }
     return provider;
 }
 
-bool startFrameFetch(ImgProvider_t* provider) {
+bool startFrameFetch(ImgProvider_t* provider, const ThreadConfig_t* threadConfig) {
+    provider->threadConfig = *threadConfig;
     if (pthread_create(&provider->fetcherThread, NULL, threadEntry, provider)) {
         syslog(LOG_ERR,
                "%s: Failed to start thread fetching frames from vdo: %s",
@@ -21,14 +21,33 @@
 #pragma once
 
 #include <pthread.h>
+#include <semaphore.h>
 #include <stdatomic.h>
 #include <stdbool.h>
 
+#include "threadconfig.h"
 #include "vdo-stream.h"
 #include "vdo-types.h"
 
 #define NUM_VDO_BUFFERS (8)
 
+/// Must be a power of two and able to hold all VDO buffers.
+#define FRAME_RING_SIZE (NUM_VDO_BUFFERS)
+
+/**
+ * brief A lock-free ring of frames.
+ *
+ * head and tail are free running counters, the slot of a counter value is
+ * counter % FRAME_RING_SIZE. Only one thread pushes at head while the entries
+ * between tail and head are claimed with a compare-and-swap on tail, which
+ * lets both threads drop old frames without taking a lock.
+ */
+typedef struct FrameRing {
+    _Atomic(VdoBuffer*) slots[FRAME_RING_SIZE];
+    atomic_size_t head;
+    atomic_size_t tail;
+} FrameRing_t;
+
 /**
  * brief A type representing a provider of frames from VDO.
  *
@@ -55,6 +74,16 @@ typedef struct ImgProvider {
     pthread_cond_t frameDeliverCond;
     pthread_t fetcherThread;
     atomic_bool shutDown;
+    /// Affinity and scheduling applied by the fetcher thread.
+    ThreadConfig_t threadConfig;
+
+    /// Lock-free backend used instead of the queues above if useFrameRing is set.
+    /// deliveredRing holds frames from VDO where the client always gets the
+    /// latest, returnedRing holds frames handed back by the client.
+    bool useFrameRing;
+    FrameRing_t deliveredRing;
+    FrameRing_t returnedRing;
+    sem_t frameDeliverSem;
 } ImgProvider_t;
 
 /**
@@ -86,10 +115,15 @@ bool chooseStreamResolution(unsigned int reqWidth,
  * param h Requested ouput image height.
  * param numFrames Number of fetched frames to keep.
  * param vdoFormat Image format to be output by stream.
+ * param useFrameRing Hand over frames through lock-free rings instead of
+ *                    mutex protected queues.
  * return Pointer to new ImgProvider, or NULL if failed.
  */
-ImgProvider_t*
-createImgProvider(unsigned int w, unsigned int h, unsigned int numFrames, VdoFormat vdoFormat);
+ImgProvider_t* createImgProvider(unsigned int w,
+                                 unsigned int h,
+                                 unsigned int numFrames,
+                                 VdoFormat vdoFormat,
+                                 bool useFrameRing);
 
 /**
  * brief Release VDO buffers and deallocate provider.
@@ -102,9 +136,10 @@ void destroyImgProvider(ImgProvider_t* provider);
  * brief Create the thread and start fetching frames.
  *
  * param provider Pointer to ImgProvider whose thread to be started.
+ * param threadConfig Affinity and scheduling of the fetcher thread.
  * return False if any errors occur, otherwise true.
  */
-bool startFrameFetch(ImgProvider_t* provider);
+bool startFrameFetch(ImgProvider_t* provider, const ThreadConfig_t* threadConfig);
 
 /**
  * brief Stop fetching frames by closing thread.
@@ -35,22 +35,106 @@ void buffer_to_jpeg(unsigned char* image_buffer,
                     struct jpeg_compress_struct* jpeg_conf,
                     unsigned long* jpeg_size,
                     unsigned char** jpeg_buffer) {
+    image_view_t view = crop_view(image_buffer,
+                                  jpeg_conf->image_width,
+                                  jpeg_conf->image_height,
+                                  jpeg_conf->input_components,
+                                  0,
+                                  0,
+                                  jpeg_conf->image_width,
+                                  jpeg_conf->image_height);
+    view_to_jpeg(&view, jpeg_conf, jpeg_size, jpeg_buffer);
+}
+
+/**
+ * @brief Encode an image view as jpeg and store it in memory
+ *
+ * @param view A view of an image with interleaved (if RGB) channel layout, matching the size and
+ * channels of jpeg_conf
+ * @param jpeg_conf A struct defining how the image is to be encoded
+ * @param jpeg_size The output size of the jpeg
+ * @param jpeg_buffer The output buffer of the jpeg
+ */
+void view_to_jpeg(const image_view_t* view,
+                  struct jpeg_compress_struct* jpeg_conf,
+                  unsigned long* jpeg_size,
+                  unsigned char** jpeg_buffer) {
     struct jpeg_error_mgr jerr;
-    JSAMPROW row_pointer[1];
 
     jpeg_conf->err = jpeg_std_error(&jerr);
 
+    compress_view_to_jpeg(view, jpeg_conf, jpeg_size, jpeg_buffer);
+    jpeg_destroy_compress(jpeg_conf);
+}
+
+/**
+ * @brief Encode an image view as jpeg and store it in memory, keeping the jpeg_conf
+ *
+ * The rows are passed to libjpeg as pointers into the viewed image, so nothing is copied. If
+ * *jpeg_buffer is not NULL it is used as output buffer of *jpeg_size bytes, libjpeg replaces it
+ * with a new allocation if it is too small.
+ *
+ * @param view A view of an image with interleaved (if RGB) channel layout, matching the size and
+ * channels of jpeg_conf
+ * @param jpeg_conf A struct defining how the image is to be encoded, with an error manager set
+ * @param jpeg_size The output size of the jpeg
+ * @param jpeg_buffer The output buffer of the jpeg
+ */
+void compress_view_to_jpeg(const image_view_t* view,
+                           struct jpeg_compress_struct* jpeg_conf,
+                           unsigned long* jpeg_size,
+                           unsigned char** jpeg_buffer) {
+    JSAMPROW row_pointers[JPEG_ROWS_PER_WRITE];
+
     jpeg_mem_dest(jpeg_conf, jpeg_buffer, jpeg_size);
     jpeg_start_compress(jpeg_conf, TRUE);
 
-    int stride = jpeg_conf->image_width * jpeg_conf->input_components;
     while (jpeg_conf->next_scanline < jpeg_conf->image_height) {
-        row_pointer[0] = &image_buffer[jpeg_conf->next_scanline * stride];
-        jpeg_write_scanlines(jpeg_conf, row_pointer, 1);
+        JDIMENSION first = jpeg_conf->next_scanline;
+        JDIMENSION rows  = jpeg_conf->image_height - first;
+        if (rows > JPEG_ROWS_PER_WRITE) {
+            rows = JPEG_ROWS_PER_WRITE;
+        }
+        // libjpeg only reads the rows even though JSAMPROW is not const
+        for (JDIMENSION row = 0; row < rows; row++) {
+            row_pointers[row] = (JSAMPROW)(view->origin + (first + row) * view->stride);
+        }
+        jpeg_write_scanlines(jpeg_conf, row_pointers, rows);
     }
 
     jpeg_finish_compress(jpeg_conf);
-    jpeg_destroy_compress(jpeg_conf);
+}
+
+/**
+ * @brief Creates a view of a rectangular patch of an image buffer without copying it.
+ *       The image channels are expected to be interleaved.
+ *
+ * @param image_buffer A buffer holding an uint8 image
+ * @param image_w The input image's width in pixels
+ * @param image_h The input image's height in pixels
+ * @param channels The input image's number of channels
+ * @param crop_x The leftmost pixel coordinate of the desired crop
+ * @param crop_y The top pixel coordinate of the desired crop
+ * @param crop_w The width of the desired crop in pixels
+ * @param crop_h The height of the desired crop in pixels
+ * @return A view that is valid as long as image_buffer is
+ */
+image_view_t crop_view(const unsigned char* image_buffer,
+                       int image_w,
+                       int image_h,
+                       int channels,
+                       int crop_x,
+                       int crop_y,
+                       int crop_w,
+                       int crop_h) {
+    (void)image_h;
+    size_t stride     = (size_t)image_w * channels;
+    image_view_t view = {.origin   = image_buffer + crop_y * stride + (size_t)crop_x * channels,
+                         .width    = crop_w,
+                         .height   = crop_h,
+                         .channels = channels,
+                         .stride   = stride};
+    return view;
 }
 
 /**
@@ -67,8 +151,25 @@ void set_jpeg_configuration(int width,
                             int channels,
                             int quality,
                             struct jpeg_compress_struct* jpeg_conf) {
-    // Only supports RGB and grayscale
     jpeg_create_compress(jpeg_conf);
+    set_jpeg_parameters(width, height, channels, quality, jpeg_conf);
+}
+
+/**
+ * @brief Inserts common values into an already created jpeg configuration struct
+ *
+ * @param width The width of the image
+ * @param height The height of the image
+ * @param channels The number of channels of the image
+ * @param quality The desired jpeg quality (0-100)
+ * @param jpeg_conf The jpeg configuration struct to modify
+ */
+void set_jpeg_parameters(int width,
+                         int height,
+                         int channels,
+                         int quality,
+                         struct jpeg_compress_struct* jpeg_conf) {
+    // Only supports RGB and grayscale
     jpeg_conf->image_width      = width;
     jpeg_conf->image_height     = height;
     jpeg_conf->input_components = channels;
@@ -128,6 +229,41 @@ unsigned char* crop_interleaved(unsigned char* image_buffer,
     // (x, y, x + w, x + h).
     // The input buffer channel layout is assumed to be interleaved
     unsigned char* crop_buffer = (unsigned char*)malloc(crop_w * crop_h * channels);
+    copy_crop_interleaved(image_buffer,
+                          image_w,
+                          image_h,
+                          channels,
+                          crop_x,
+                          crop_y,
+                          crop_w,
+                          crop_h,
+                          crop_buffer);
+    return crop_buffer;
+}
+
+/**
+ * @brief Copies a rectangular patch from an image buffer into a crop buffer.
+ *       The image channels are expected to be interleaved.
+ *
+ * @param image_buffer A buffer holding an uint8 image
+ * @param image_w The input image's width in pixels
+ * @param image_h The input image's height in pixels
+ * @param channels The input image's number of channels
+ * @param crop_x The leftmost pixel coordinate of the desired crop
+ * @param crop_y The top pixel coordinate of the desired crop
+ * @param crop_w The width of the desired crop in pixels
+ * @param crop_h The height of the desired crop in pixels
+ * @param crop_buffer A buffer of at least crop_w * crop_h * channels bytes
+ */
+void copy_crop_interleaved(const unsigned char* image_buffer,
+                           int image_w,
+                           int image_h,
+                           int channels,
+                           int crop_x,
+                           int crop_y,
+                           int crop_w,
+                           int crop_h,
+                           unsigned char* crop_buffer) {
     (void)image_h;
     // We go over each row affected by the crop and copy a contiguous
     // crop_buffer_width sized block of memory
@@ -138,7 +274,6 @@ unsigned char* crop_interleaved(unsigned char* image_buffer,
         int crop_buffer_pos  = crop_buffer_width * (row - crop_y);
         memcpy(crop_buffer + crop_buffer_pos, image_buffer + image_buffer_pos, crop_buffer_width);
     }
-    return crop_buffer;
 }
 
 /**
@@ -147,7 +282,7 @@ unsigned char* crop_interleaved(unsigned char* image_buffer,
  */
 void test_buffer_to_jpeg_file(void) {
     // An example of how to use the various utility functions
-    // Generates an image buffer, crops a section of it, encodes the crop to jpeg
+    // Generates an image buffer, views a section of it, encodes the crop to jpeg
     // and saves the jpeg to file
     int width                   = 1920;
     int height                  = 1080;
@@ -170,21 +305,20 @@ void test_buffer_to_jpeg_file(void) {
     int crop_y = 0;
     int crop_w = 100;
     int crop_h = height;
-    unsigned char* crop_buffer =
-        crop_interleaved(image_buffer, width, height, channels, crop_x, crop_y, crop_w, crop_h);
+    image_view_t crop =
+        crop_view(image_buffer, width, height, channels, crop_x, crop_y, crop_w, crop_h);
 
     // Encode buffer to jpeg in memory
     unsigned long jpeg_size    = 0;
     unsigned char* jpeg_buffer = NULL;
     struct jpeg_compress_struct jpeg_conf;
     set_jpeg_configuration(crop_w, crop_h, channels, 80, &jpeg_conf);
-    buffer_to_jpeg(crop_buffer, &jpeg_conf, &jpeg_size, &jpeg_buffer);
+    view_to_jpeg(&crop, &jpeg_conf, &jpeg_size, &jpeg_buffer);
 
     // Write jpeg buffer to file
     jpeg_to_file("/tmp/test.jpg", jpeg_buffer, jpeg_size);
 
     // Release memory
     free(image_buffer);
-    free(crop_buffer);
     free(jpeg_buffer);
 }
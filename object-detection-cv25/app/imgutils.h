@@ -20,6 +20,22 @@
 
 #include <jpeglib.h>
 
+// Number of rows handed to libjpeg per jpeg_write_scanlines() call
+#define JPEG_ROWS_PER_WRITE (16)
+
+/**
+ * @brief A rectangular patch of an interleaved image buffer, referenced without copying
+ */
+typedef struct image_view {
+    // The top-left pixel of the patch
+    const unsigned char* origin;
+    int width;
+    int height;
+    int channels;
+    // Number of bytes between the start of two rows
+    size_t stride;
+} image_view_t;
+
 /**
  * @brief Encode an image buffer as jpeg and store it in memory
  *
@@ -33,6 +49,61 @@ void buffer_to_jpeg(unsigned char* image_buffer,
                     unsigned long* jpeg_size,
                     unsigned char** jpeg_buffer);
 
+/**
+ * @brief Encode an image view as jpeg and store it in memory
+ *
+ * @param view A view of an image with interleaved (if RGB) channel layout, matching the size and
+ * channels of jpeg_conf
+ * @param jpeg_conf A struct defining how the image is to be encoded
+ * @param jpeg_size The output size of the jpeg
+ * @param jpeg_buffer The output buffer of the jpeg
+ */
+void view_to_jpeg(const image_view_t* view,
+                  struct jpeg_compress_struct* jpeg_conf,
+                  unsigned long* jpeg_size,
+                  unsigned char** jpeg_buffer);
+
+/**
+ * @brief Encode an image view as jpeg and store it in memory, keeping the jpeg_conf
+ *
+ * The rows are passed to libjpeg as pointers into the viewed image, so nothing is copied. If
+ * *jpeg_buffer is not NULL it is used as output buffer of *jpeg_size bytes, libjpeg replaces it
+ * with a new allocation if it is too small.
+ *
+ * @param view A view of an image with interleaved (if RGB) channel layout, matching the size and
+ * channels of jpeg_conf
+ * @param jpeg_conf A struct defining how the image is to be encoded, with an error manager set
+ * @param jpeg_size The output size of the jpeg
+ * @param jpeg_buffer The output buffer of the jpeg
+ */
+void compress_view_to_jpeg(const image_view_t* view,
+                           struct jpeg_compress_struct* jpeg_conf,
+                           unsigned long* jpeg_size,
+                           unsigned char** jpeg_buffer);
+
+/**
+ * @brief Creates a view of a rectangular patch of an image buffer without copying it.
+ *       The image channels are expected to be interleaved.
+ *
+ * @param image_buffer A buffer holding an uint8 image
+ * @param image_w The input image's width in pixels
+ * @param image_h The input image's height in pixels
+ * @param channels The input image's number of channels
+ * @param crop_x The leftmost pixel coordinate of the desired crop
+ * @param crop_y The top pixel coordinate of the desired crop
+ * @param crop_w The width of the desired crop in pixels
+ * @param crop_h The height of the desired crop in pixels
+ * @return A view that is valid as long as image_buffer is
+ */
+image_view_t crop_view(const unsigned char* image_buffer,
+                       int image_w,
+                       int image_h,
+                       int channels,
+                       int crop_x,
+                       int crop_y,
+                       int crop_w,
+                       int crop_h);
+
 /**
  * @brief Inserts common values into a jpeg configuration struct
  *
@@ -48,6 +119,21 @@ void set_jpeg_configuration(int width,
                             int quality,
                             struct jpeg_compress_struct* jpeg_conf);
 
+/**
+ * @brief Inserts common values into an already created jpeg configuration struct
+ *
+ * @param width The width of the image
+ * @param height The height of the image
+ * @param channels The number of channels of the image
+ * @param quality The desired jpeg quality (0-100)
+ * @param jpeg_conf The jpeg configuration struct to modify
+ */
+void set_jpeg_parameters(int width,
+                         int height,
+                         int channels,
+                         int quality,
+                         struct jpeg_compress_struct* jpeg_conf);
+
 /**
  * @brief Writes a memory buffer to a file
  *
@@ -79,6 +165,30 @@ unsigned char* crop_interleaved(unsigned char* image_buffer,
                                 int crop_w,
                                 int crop_h);
 
+/**
+ * @brief Copies a rectangular patch from an image buffer into a crop buffer.
+ *       The image channels are expected to be interleaved.
+ *
+ * @param image_buffer A buffer holding an uint8 image
+ * @param image_w The input image's width in pixels
+ * @param image_h The input image's height in pixels
+ * @param channels The input image's number of channels
+ * @param crop_x The leftmost pixel coordinate of the desired crop
+ * @param crop_y The top pixel coordinate of the desired crop
+ * @param crop_w The width of the desired crop in pixels
+ * @param crop_h The height of the desired crop in pixels
+ * @param crop_buffer A buffer of at least crop_w * crop_h * channels bytes
+ */
+void copy_crop_interleaved(const unsigned char* image_buffer,
+                           int image_w,
+                           int image_h,
+                           int channels,
+                           int crop_x,
+                           int crop_y,
+                           int crop_w,
+                           int crop_h,
+                           unsigned char* crop_buffer);
+
 /**
  * @brief An example of how to use the supplied utility functions
  *
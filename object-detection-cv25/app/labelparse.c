@@ -0,0 +1,140 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "labelparse.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <syslog.h>
+#include <unistd.h>
+
+// We cut off every label at 60 characters
+#define LABEL_MAX_LEN 60
+// We will not encounter larger label files, and the offsets of the table fit in 32 bits
+#define LABEL_FILE_MAX_SIZE (10 * 1024 * 1024)
+
+/**
+ * @brief Count the lines of the file, a last line without newline included.
+ */
+static size_t count_lines(const char* data, size_t size) {
+    size_t num_lines = 0;
+    const char* end  = data + size;
+
+    for (const char* line = data; line < end; num_lines++) {
+        const char* newline = memchr(line, '\n', (size_t)(end - line));
+        line                = newline ? newline + 1 : end;
+    }
+    return num_lines;
+}
+
+label_table_t* label_table_open(const char* labels_path, bool skip_unused) {
+    label_table_t* table = calloc(1, sizeof(label_table_t));
+    if (!table) {
+        syslog(LOG_ERR, "%s: Unable to allocate label table", __func__);
+        return NULL;
+    }
+
+    int labels_fd = open(labels_path, O_RDONLY);
+    if (labels_fd < 0) {
+        syslog(LOG_ERR,
+               "%s: Could not open labels file %s: %s",
+               __func__,
+               labels_path,
+               strerror(errno));
+        goto error;
+    }
+
+    struct stat file_stats = {0};
+    if (fstat(labels_fd, &file_stats) < 0) {
+        syslog(LOG_ERR,
+               "%s: Unable to get stats for label file %s: %s",
+               __func__,
+               labels_path,
+               strerror(errno));
+        goto error;
+    }
+    if (file_stats.st_size > LABEL_FILE_MAX_SIZE) {
+        syslog(LOG_ERR, "%s: failed sanity check on labels file size", __func__);
+        goto error;
+    }
+
+    table->size = (size_t)file_stats.st_size;
+    if (table->size > 0) {
+        void* map = mmap(NULL, table->size, PROT_READ, MAP_PRIVATE, labels_fd, 0);
+        if (map == MAP_FAILED) {
+            syslog(LOG_ERR, "%s: Could not map labels file: %s", __func__, strerror(errno));
+            goto error;
+        }
+        table->data = map;
+    }
+    // The mapping stays valid after the file is closed
+    close(labels_fd);
+    labels_fd = -1;
+    if (!table->data) {
+        // An empty file has no labels
+        return table;
+    }
+
+    size_t num_lines = count_lines(table->data, table->size);
+    table->entries   = calloc(num_lines, sizeof(label_entry_t));
+    if (!table->entries) {
+        syslog(LOG_ERR, "%s: Unable to allocate labels array: %s", __func__, strerror(errno));
+        goto error;
+    }
+
+    const char* end = table->data + table->size;
+    for (const char* line = table->data; line < end;) {
+        const char* newline = memchr(line, '\n', (size_t)(end - line));
+        const char* next    = newline ? newline + 1 : end;
+        size_t length       = (size_t)((newline ? newline : end) - line);
+
+        if (length > 0 && line[length - 1] == '\r') {
+            length--;
+        }
+        if (length > LABEL_MAX_LEN) {
+            length = LABEL_MAX_LEN;
+        }
+        if (!(skip_unused && length == 3 && memcmp(line, "n/a", 3) == 0)) {
+            label_entry_t* entry = &table->entries[table->num_labels++];
+            entry->offset        = (uint32_t)(line - table->data);
+            entry->length        = (uint32_t)length;
+        }
+        line = next;
+    }
+    return table;
+
+error:
+    if (labels_fd >= 0) {
+        close(labels_fd);
+    }
+    label_table_close(table);
+    return NULL;
+}
+
+void label_table_close(label_table_t* table) {
+    if (!table) {
+        return;
+    }
+    if (table->data) {
+        munmap((void*)table->data, table->size);
+    }
+    free(table->entries);
+    free(table);
+}
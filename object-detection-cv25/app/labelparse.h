@@ -0,0 +1,81 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * The labels of a model, one per line of a label file.
+ *
+ * The file is mapped read-only into memory, and a table with the offset and
+ * length of each label is built once when the file is opened. A label is handed
+ * out as a view into the mapping, a pointer and a length without terminating
+ * NUL, so looking up a label in the frame loop costs neither strlen nor a copy.
+ * Print a label with "%.*s", (int)label.length, label.data.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct label_view {
+    // Not NUL-terminated
+    const char* data;
+    size_t length;
+} label_view_t;
+
+typedef struct label_entry {
+    uint32_t offset;
+    uint32_t length;
+} label_entry_t;
+
+typedef struct label_table {
+    // The mapped file, NULL for an empty file
+    const char* data;
+    size_t size;
+    label_entry_t* entries;
+    size_t num_labels;
+} label_table_t;
+
+/**
+ * @brief Map a label file and build the table of its labels.
+ *
+ * Each line is a label, a trailing carriage return is not part of it, and labels are cut off at
+ * 60 characters.
+ *
+ * @param labels_path  Path to the label file.
+ * @param skip_unused  Leave out the lines "n/a", which some label files use for unused class ids.
+ *
+ * @return Pointer to a new label table, or NULL on failure, which is logged.
+ */
+label_table_t* label_table_open(const char* labels_path, bool skip_unused);
+
+/**
+ * @brief Unmap the label file and free the table, no label view may be used after this.
+ */
+void label_table_close(label_table_t* table);
+
+/**
+ * @brief Get a label.
+ *
+ * @return View of the label, an empty view if there is no label with the index.
+ */
+static inline label_view_t label_table_get(const label_table_t* table, size_t index) {
+    if (!table || index >= table->num_labels) {
+        return (label_view_t){"", 0};
+    }
+    const label_entry_t* entry = &table->entries[index];
+    return (label_view_t){table->data + entry->offset, entry->length};
+}
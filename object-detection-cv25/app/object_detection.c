@@ -64,177 +64,43 @@
 #include "argparse.h"
 #include "imgprovider.h"
 #include "imgutils.h"
+#include "labelparse.h"
 #include "larod.h"
 #include "postprocessing.h"
+#include "snapshotpool.h"
+#include "taskpool.h"
+#include "tensorrecording.h"
+#include "vdosnapshot.h"
 #include "vdo-frame.h"
 #include "vdo-types.h"
 
 /**
- * @brief Free up resources held by an array of labels.
+ * @brief Copy a planar RGB image to a buffer with padding to the right of each row.
  *
- * @param labels An array of label string pointers.
- * @param labelFileBuffer Heap buffer containing the actual string data.
+ * The rows are copied one at a time. The padding bytes are never written, so
+ * they keep the zeros from when the buffer was created.
+ *
+ * @param srcimage Planar RGB image of width x height pixels.
+ * @param dstimage Planar RGB buffer of (width + padding) x height pixels.
+ * @param width Width of the image in pixels.
+ * @param height Height of the image in pixels.
+ * @param padding Number of padding pixels after each row.
  */
-static void freeLabels(char** labelsArray, char* labelFileBuffer) {
-    free(labelsArray);
-    free(labelFileBuffer);
-}
-
-static void padImageWidth(uint8_t* srcimage,
+static void padImageWidth(const uint8_t* srcimage,
                           uint8_t* dstimage,
                           unsigned int width,
                           unsigned int height,
                           unsigned int padding) {
-    for (size_t k = 0; k < 3; k++) {
-        for (size_t i = 0; i < height; i++) {
-            for (size_t j = 0; j < width; j++) {
-                dstimage[k * ((width + padding) * height) + i * (width + padding) + j] =
-                    srcimage[k * (width * height) + i * width + j];
-            }
-        }
-    }
-}
-
-/**
- * @brief Reads a file of labels into an array.
- *
- * An array filled by this function should be freed using freeLabels.
- *
- * @param labelsPtr Pointer to a string array.
- * @param labelFileBuffer Pointer to the labels file contents.
- * @param labelsPath String containing the path to the labels file to be read.
- * @param numLabelsPtr Pointer to number which will store number of labels read.
- * @return False if any errors occur, otherwise true.
- */
-static bool parseLabels(char*** labelsPtr,
-                        char** labelFileBuffer,
-                        const char* labelsPath,
-                        size_t* numLabelsPtr) {
-    // We cut off every row at 60 characters.
-    const size_t LINE_MAX_LEN = 60;
-    bool ret                  = false;
-    char* labelsData          = NULL;  // Buffer containing the label file contents.
-    char** labelArray         = NULL;  // Pointers to each line in the labels text.
-
-    struct stat fileStats = {0};
-    if (stat(labelsPath, &fileStats) < 0) {
-        syslog(LOG_ERR,
-               "%s: Unable to get stats for label file %s: %s",
-               __func__,
-               labelsPath,
-               strerror(errno));
-        return false;
-    }
-
-    // Sanity checking on the file size - we use size_t to keep track of file
-    // size and to iterate over the contents. off_t is signed and 32-bit or
-    // 64-bit depending on architecture. We just check toward 10 MByte as we
-    // will not encounter larger label files and both off_t and size_t should be
-    // able to represent 10 megabytes on both 32-bit and 64-bit systems.
-    if (fileStats.st_size > (10 * 1024 * 1024)) {
-        syslog(LOG_ERR, "%s: failed sanity check on labels file size", __func__);
-        return false;
-    }
-
-    int labelsFd = open(labelsPath, O_RDONLY);
-    if (labelsFd < 0) {
-        syslog(LOG_ERR,
-               "%s: Could not open labels file %s: %s",
-               __func__,
-               labelsPath,
-               strerror(errno));
-        return false;
-    }
+    const size_t dstPitch = width + padding;
+    const size_t rows     = 3 * (size_t)height;
 
-    size_t labelsFileSize = (size_t)fileStats.st_size;
-    // Allocate room for a terminating NULL char after the last line.
-    labelsData = malloc(labelsFileSize + 1);
-    if (labelsData == NULL) {
-        syslog(LOG_ERR, "%s: Failed allocating labels text buffer: %s", __func__, strerror(errno));
-        goto end;
+    if (padding == 0) {
+        memcpy(dstimage, srcimage, rows * width);
+        return;
     }
-
-    ssize_t numBytesRead  = -1;
-    size_t totalBytesRead = 0;
-    char* fileReadPtr     = labelsData;
-    while (totalBytesRead < labelsFileSize) {
-        numBytesRead = read(labelsFd, fileReadPtr, labelsFileSize - totalBytesRead);
-
-        if (numBytesRead < 1) {
-            syslog(LOG_ERR, "%s: Failed reading from labels file: %s", __func__, strerror(errno));
-            goto end;
-        }
-        totalBytesRead += (size_t)numBytesRead;
-        fileReadPtr += numBytesRead;
+    for (size_t row = 0; row < rows; row++) {
+        memcpy(dstimage + row * dstPitch, srcimage + row * width, width);
     }
-
-    // Now count number of lines in the file - check all bytes except the last
-    // one in the file.
-    size_t numLines = 0;
-    for (size_t i = 0; i < (labelsFileSize - 1); i++) {
-        if (labelsData[i] == '\n') {
-            numLines++;
-        }
-    }
-
-    // We assume that there is always a line at the end of the file, possibly
-    // terminated by newline char. Either way add this line as well to the
-    // counter.
-    numLines++;
-
-    labelArray = malloc(numLines * sizeof(char*));
-    if (!labelArray) {
-        syslog(LOG_ERR, "%s: Unable to allocate labels array: %s", __func__, strerror(errno));
-        ret = false;
-        goto end;
-    }
-
-    size_t labelIdx      = 0;
-    labelArray[labelIdx] = labelsData;
-    labelIdx++;
-    for (size_t i = 0; i < labelsFileSize; i++) {
-        if (labelsData[i] == '\n') {
-            // Register the string start in the list of labels.
-            labelArray[labelIdx] = labelsData + i + 1;
-            labelIdx++;
-            // Replace the newline char with string-ending NULL char.
-            labelsData[i] = '\0';
-        }
-    }
-
-    // If the very last byte in the labels file was a new-line we just
-    // replace that with a NULL-char. Refer previous for loop skipping looking
-    // for new-line at the end of file.
-    if (labelsData[labelsFileSize - 1] == '\n') {
-        labelsData[labelsFileSize - 1] = '\0';
-    }
-
-    // Make sure we always have a terminating NULL char after the label file
-    // contents.
-    labelsData[labelsFileSize] = '\0';
-
-    // Now go through the list of strings and cap if strings too long.
-    for (size_t i = 0; i < numLines; i++) {
-        size_t stringLen = strnlen(labelArray[i], LINE_MAX_LEN);
-        if (stringLen >= LINE_MAX_LEN) {
-            // Just insert capping NULL terminator to limit the string len.
-            *(labelArray[i] + LINE_MAX_LEN + 1) = '\0';
-        }
-    }
-
-    *labelsPtr       = labelArray;
-    *numLabelsPtr    = numLines;
-    *labelFileBuffer = labelsData;
-
-    ret = true;
-
-end:
-    if (!ret) {
-        freeLabels(labelArray, labelsData);
-    }
-    close(labelsFd);
-
-    return ret;
 }
 
 /// Set by signal handler if an interrupt signal sent to process.
@@ -413,6 +279,10 @@ int main(int argc, char** argv) {
     const unsigned int FLOATSIZE   = 4;
     const unsigned int TENSOR1SIZE = 1917 * 4 * FLOATSIZE;
     const unsigned int TENSOR2SIZE = 1917 * 91 * FLOATSIZE;
+    // Snapshots are encoded as tasks on a worker per spare core, with room
+    // to queue the snapshots of a busy frame.
+    const unsigned int TASK_QUEUE_SIZE     = 16;
+    const unsigned int SNAPSHOT_QUEUE_SIZE = 16;
 
     // Name patterns for the temp file we will create.
 
@@ -472,10 +342,13 @@ int main(int argc, char** argv) {
     int larodOutput1Fd              = -1;
     int larodOutput2Fd              = -1;
     box* boxes                      = NULL;
-    char** labels                   = NULL;  // This is the array of label strings. The label
-                                             // entries points into the large labelFileData buffer.
-    size_t numLabels    = 0;                 // Number of entries in the labels array.
-    char* labelFileData = NULL;  // Buffer holding the complete collection of label strings.
+    AnchorTable_t* anchors          = NULL;
+    TaskPool_t* taskPool            = NULL;
+    SnapshotPool_t* snapshotPool    = NULL;
+    VdoSnapshot_t* vdoSnapshot      = NULL;
+    SnapshotJob_t* snapshotJobs     = NULL;
+    label_table_t* labels           = NULL;  // Views into the mapped label file.
+    TensorRecorder_t* recorder      = NULL;
 
     args_t args;
     if (!parseArgs(argc, argv, &args)) {
@@ -525,7 +398,8 @@ int main(int argc, char** argv) {
             inputHeight);
         goto end;
     }
-    sdImageProvider = createImgProvider(streamWidth, streamHeight, 2, VDO_FORMAT_YUV);
+    sdImageProvider =
+        createImgProvider(streamWidth, streamHeight, 2, VDO_FORMAT_YUV, args.frameRing);
     if (!sdImageProvider) {
         syslog(LOG_ERR, "%s: Could not create image provider", __func__);
         goto end;
@@ -544,7 +418,8 @@ int main(int argc, char** argv) {
            "Creating VDO High resolution image provider and stream %d x %d",
            widthFrameHD,
            heightFrameHD);
-    hdImageProvider = createImgProvider(widthFrameHD, heightFrameHD, 2, VDO_FORMAT_YUV);
+    hdImageProvider =
+        createImgProvider(widthFrameHD, heightFrameHD, 2, VDO_FORMAT_YUV, args.frameRing);
     if (!hdImageProvider) {
         syslog(LOG_ERR, "%s: Could not create high resolution image provider", __func__);
     }
@@ -853,7 +728,8 @@ int main(int argc, char** argv) {
     }
 
     if (labelsFile) {
-        if (!parseLabels(&labels, &labelFileData, labelsFile, &numLabels)) {
+        labels = label_table_open(labelsFile, false);
+        if (!labels) {
             syslog(LOG_ERR, "Failed creating parsing labels file");
             goto end;
         }
@@ -861,19 +737,81 @@ int main(int argc, char** argv) {
 
     syslog(LOG_INFO, "Found %zu input tensors and %zu output tensors", numInputs, numOutputs);
     syslog(LOG_INFO, "Start fetching video frames from VDO");
-    if (!startFrameFetch(sdImageProvider)) {
+    if (!startFrameFetch(sdImageProvider, &args.threadConfigs[THREAD_ROLE_CAPTURE])) {
         syslog(LOG_ERR, "Stuck in provider");
         goto end;
     }
 
-    if (!startFrameFetch(hdImageProvider)) {
+    if (!startFrameFetch(hdImageProvider, &args.threadConfigs[THREAD_ROLE_CAPTURE])) {
         syslog(LOG_ERR, "Stuck in provider high resolution");
         goto end;
     }
 
+    anchors = createAnchorTable(anchorFile, numberOfDetections);
+    if (!anchors) {
+        syslog(LOG_ERR, "Failed loading anchors");
+        goto end;
+    }
+
+    taskPool = createTaskPool(0, TASK_QUEUE_SIZE, &args.threadConfigs[THREAD_ROLE_WORKER]);
+    if (!taskPool) {
+        syslog(LOG_ERR, "Failed creating task pool");
+        goto end;
+    }
+
+    snapshotPool = createSnapshotPool(taskPool, SNAPSHOT_QUEUE_SIZE, quality);
+    if (!snapshotPool) {
+        syslog(LOG_ERR, "Failed creating snapshot pool");
+        goto end;
+    }
+
+    if (args.vdoSnapshot) {
+        vdoSnapshot = createVdoSnapshot(taskPool,
+                                        widthFrameHD,
+                                        heightFrameHD,
+                                        SNAPSHOT_QUEUE_SIZE,
+                                        (unsigned int)numberOfDetections);
+        if (!vdoSnapshot) {
+            syslog(LOG_WARNING, "Failed creating VDO snapshots, encoding snapshots on the CPU");
+        }
+    }
+    snapshotJobs = malloc(sizeof(SnapshotJob_t) * numberOfDetections);
+    if (!snapshotJobs) {
+        syslog(LOG_ERR, "Failed allocating snapshot jobs");
+        goto end;
+    }
+
     // This contains the box coordinates and class scores for each detected object.
     boxes = (box*)malloc(sizeof(box) * numberOfDetections);
 
+    // hyperparameters depend on the model used. For the model used in this example
+    // the values come from the config file used to train the model.
+    // https://github.com/tensorflow/models/blob/master/research/object_detection/samples/configs/ssd_mobilenet_v2_coco.config#L11
+    float confidenceThreshold = threshold / 100.0f;
+    float iouThreshold        = 0.5f;
+    int maxBoxes              = 100;
+    int yScale                = 10;
+    int xScale                = 10;
+    int hScale                = 5;
+    int wScale                = 5;
+
+    if (args.recordFile) {
+        const TensorRecordingHeader_t recordingHeader = {.numDetections  = numberOfDetections,
+                                                         .numClasses     = numberOfClasses,
+                                                         .scoreThreshold = confidenceThreshold,
+                                                         .nmsThreshold   = iouThreshold,
+                                                         .maxBoxes       = maxBoxes,
+                                                         .yScale         = yScale,
+                                                         .xScale         = xScale,
+                                                         .hScale         = hScale,
+                                                         .wScale         = wScale};
+        recorder =
+            createTensorRecorder(args.recordFile, &recordingHeader, anchors, args.recordFrames);
+    }
+
+    // The main thread runs the preprocessing, inference and postprocessing of every frame
+    applyThreadConfig(&args.threadConfigs[THREAD_ROLE_INFERENCE]);
+
     while (true) {
         struct timeval startTs, endTs;
         unsigned int elapsedMs = 0;
@@ -909,15 +847,6 @@ int main(int argc, char** argv) {
 
         padImageWidth(ppOutputAddr, larodInputAddr, inputWidth, inputHeight, padding);
 
-        memcpy(ppInputAddrHD, nv12Data_hq, widthFrameHD * heightFrameHD * CHANNELS / 2);
-        if (!larodRunJob(conn, ppReqHD, &error)) {
-            syslog(LOG_ERR,
-                   "Unable to run job to preprocess model: %s (%d)",
-                   error->msg,
-                   error->code);
-            goto end;
-        }
-
         gettimeofday(&endTs, NULL);
 
         elapsedMs = (unsigned int)(((endTs.tv_sec - startTs.tv_sec) * 1000) +
@@ -954,26 +883,18 @@ int main(int argc, char** argv) {
 
         float* locations = (float*)larodOutput1Addr;
         float* classes   = (float*)larodOutput2Addr;
-
-        // hyperparameters depend on the model used. For the model used in this example
-        // the values come from the config file used to train the model.
-        // https://github.com/tensorflow/models/blob/master/research/object_detection/samples/configs/ssd_mobilenet_v2_coco.config#L11
-        int confidenceThreshold = threshold / 100.0;
-        int iouThreshold        = 0.5;
-        int yScale              = 10;
-        int xScale              = 10;
-        int hScale              = 5;
-        int wScale              = 5;
+        tensorRecorderWrite(recorder, locations, classes);
 
         gettimeofday(&startTs, NULL);
         // postprocessing the output of the network. This will fill the boxes array.
         postProcessing(locations,
                        classes,
                        numberOfDetections,
-                       anchorFile,
+                       anchors,
                        numberOfClasses,
                        confidenceThreshold,
                        iouThreshold,
+                       maxBoxes,
                        yScale,
                        xScale,
                        hScale,
@@ -984,6 +905,8 @@ int main(int argc, char** argv) {
         elapsedMs = (unsigned int)(((endTs.tv_sec - startTs.tv_sec) * 1000) +
                                    ((endTs.tv_usec - startTs.tv_usec) / 1000));
         syslog(LOG_INFO, "Postprocesing in %u ms", elapsedMs);
+
+        unsigned int numSnapshotJobs = 0;
         for (int i = 0; i < numberOfDetections; i++) {
             float top    = boxes[i].y_min;
             float left   = boxes[i].x_min;
@@ -997,36 +920,63 @@ int main(int argc, char** argv) {
             unsigned int crop_w = (right - left) * croppedWidthHD;
             unsigned int crop_h = (bottom - top) * heightFrameHD;
 
-            if (boxes[i].score >= threshold / 100.0 && boxes[i].label != 0) {
+            if (boxes[i].score >= threshold / 100.0 && boxes[i].label != 0 && crop_w > 0 &&
+                crop_h > 0) {
+                const label_view_t label =
+                    label_table_get(labels, (size_t)boxes[i].label - 1);
                 syslog(LOG_INFO,
-                       "Object %d: Classes: %s - Scores: %f - Locations: [%f,%f,%f,%f]",
+                       "Object %d: Classes: %.*s - Scores: %f - Locations: [%f,%f,%f,%f]",
                        i,
-                       labels[boxes[i].label - 1],
+                       (int)label.length,
+                       label.data,
                        boxes[i].score,
                        top,
                        left,
                        bottom,
                        right);
 
-                unsigned char* crop_buffer = crop_interleaved(ppOutputAddrHD,
-                                                              widthFrameHD,
-                                                              heightFrameHD,
-                                                              CHANNELS,
-                                                              crop_x,
-                                                              crop_y,
-                                                              crop_w,
-                                                              crop_h);
-
-                unsigned long jpeg_size    = 0;
-                unsigned char* jpeg_buffer = NULL;
-                struct jpeg_compress_struct jpeg_conf;
-                set_jpeg_configuration(crop_w, crop_h, CHANNELS, quality, &jpeg_conf);
-                buffer_to_jpeg(crop_buffer, &jpeg_conf, &jpeg_size, &jpeg_buffer);
-                char file_name[32];
-                snprintf(file_name, sizeof(char) * 32, "/tmp/detection_%i.jpg", i);
-                jpeg_to_file(file_name, jpeg_buffer, jpeg_size);
-                free(crop_buffer);
-                free(jpeg_buffer);
+                SnapshotJob_t* job = &snapshotJobs[numSnapshotJobs++];
+                *job               = (SnapshotJob_t){.image       = ppOutputAddrHD,
+                                                     .imageWidth  = widthFrameHD,
+                                                     .imageHeight = heightFrameHD,
+                                                     .channels    = CHANNELS,
+                                                     .cropX       = crop_x,
+                                                     .cropY       = crop_y,
+                                                     .cropWidth   = crop_w,
+                                                     .cropHeight  = crop_h};
+                snprintf(job->fileName, sizeof(job->fileName), "/tmp/detection_%i.jpg", i);
+            }
+        }
+
+        // The VDO snapshot is of a later frame, when it would be too late or is
+        // busy the crops are encoded from the analyzed frame on the CPU
+        if (numSnapshotJobs > 0 &&
+            (!vdoSnapshot ||
+             !vdoSnapshotSubmitCrops(vdoSnapshot,
+                                     snapshotJobs,
+                                     numSnapshotJobs,
+                                     vdo_frame_get_timestamp(vdo_buffer_get_frame(buf_hq))))) {
+            // The snapshot tasks read the high resolution frame of the previous
+            // snapshots, so they must be done before it is overwritten.
+            gettimeofday(&startTs, NULL);
+            snapshotPoolWait(snapshotPool);
+            memcpy(ppInputAddrHD, nv12Data_hq, widthFrameHD * heightFrameHD * CHANNELS / 2);
+            if (!larodRunJob(conn, ppReqHD, &error)) {
+                syslog(LOG_ERR,
+                       "Unable to run job to preprocess model: %s (%d)",
+                       error->msg,
+                       error->code);
+                goto end;
+            }
+            gettimeofday(&endTs, NULL);
+
+            elapsedMs = (unsigned int)(((endTs.tv_sec - startTs.tv_sec) * 1000) +
+                                       ((endTs.tv_usec - startTs.tv_usec) / 1000));
+            syslog(LOG_INFO, "Converted high resolution image in %u ms", elapsedMs);
+
+            // Crop and encode on the task pool workers
+            for (unsigned int i = 0; i < numSnapshotJobs; i++) {
+                snapshotPoolSubmit(snapshotPool, &snapshotJobs[i]);
             }
         }
 
@@ -1043,6 +993,13 @@ int main(int argc, char** argv) {
     ret = true;
 
 end:
+    // Stop the task workers, after their queued tasks are run, before the frame they read is
+    // unmapped and the pools whose groups and buffers they use are destroyed
+    destroyTaskPool(taskPool);
+    destroySnapshotPool(snapshotPool);
+    destroyVdoSnapshot(vdoSnapshot);
+    destroyTensorRecorder(recorder);
+    free(snapshotJobs);
     if (sdImageProvider) {
         destroyImgProvider(sdImageProvider);
     }
@@ -1120,12 +1077,11 @@ end:
     larodDestroyTensors(conn, &outputTensors, numOutputs, &error);
     larodClearError(&error);
 
-    if (labels) {
-        freeLabels(labels, labelFileData);
-    }
+    label_table_close(labels);
     if (boxes) {
         free(boxes);
     }
+    destroyAnchorTable(anchors);
 
 earlyend:
     syslog(LOG_INFO, "Exit %s", argv[0]);
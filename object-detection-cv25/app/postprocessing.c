@@ -15,207 +15,414 @@
  */
 
 #include "postprocessing.h"
+#include <errno.h>
+#include <fcntl.h>
 #include <math.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <syslog.h>
+#include <unistd.h>
 
-// structure detection
-typedef struct {
-    float dy;
-    float dx;
-    float dh;
-    float dw;
-    float score;
-    int label;
-    float anchor_ymin;
-    float anchor_xmin;
-    float anchor_ymax;
-    float anchor_xmax;
-} detection;
+#if defined(__ARM_NEON) && !defined(POSTPROCESSING_SCALAR)
+#include <arm_neon.h>
+#define POSTPROCESSING_USE_NEON
+#endif
 
-/*
- * This function loads the data structure reading the anchors from file, and the detections from
- * parameter. It expects detections in he format [dy,dx,dh,dw] and the anchors in the format
- * [xmin,ymin,xmax,ymax]
- *
- */
-static int loadDetectionStruct(const float* locations,
-                               float* classes,
-                               int num_of_detections,
-                               int num_of_classes,
-                               const char* anchor_file,
-                               detection* dets) {
-    // Open anchor file
-    FILE* fp;
-    fp = fopen(anchor_file, "rb");
-    if (fp == NULL) {
-        printf("Error opening anchor file");
-        return 1;
+// Number of floats stored per anchor in the anchor file
+#define ANCHOR_SIZE (4)
+
+AnchorTable_t* createAnchorTable(const char* anchor_file, size_t num_of_anchors) {
+    AnchorTable_t* anchors = NULL;
+    const float* data      = MAP_FAILED;
+    size_t dataSize        = num_of_anchors * ANCHOR_SIZE * sizeof(float);
+    struct stat fileStat;
+
+    int fd = open(anchor_file, O_RDONLY);
+    if (fd < 0) {
+        syslog(LOG_ERR, "Unable to open anchor file %s: %s", anchor_file, strerror(errno));
+        goto errorExit;
+    }
+    if (fstat(fd, &fileStat)) {
+        syslog(LOG_ERR, "Unable to get size of anchor file: %s", strerror(errno));
+        goto errorExit;
+    }
+    if ((size_t)fileStat.st_size < dataSize) {
+        syslog(LOG_ERR,
+               "Anchor file holds %lld bytes but %zu anchors need %zu bytes",
+               (long long)fileStat.st_size,
+               num_of_anchors,
+               dataSize);
+        goto errorExit;
+    }
+    data = mmap(NULL, dataSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+        syslog(LOG_ERR, "Unable to map anchor file: %s", strerror(errno));
+        goto errorExit;
+    }
+
+    anchors = calloc(1, sizeof(AnchorTable_t));
+    if (!anchors) {
+        syslog(LOG_ERR, "Unable to allocate anchor table: %s", strerror(errno));
+        goto errorExit;
+    }
+    // All fields share one allocation owned by centerY
+    anchors->numAnchors = num_of_anchors;
+    anchors->centerY    = malloc(dataSize);
+    if (!anchors->centerY) {
+        syslog(LOG_ERR, "Unable to allocate anchor table: %s", strerror(errno));
+        goto errorExit;
     }
+    anchors->centerX = anchors->centerY + num_of_anchors;
+    anchors->height  = anchors->centerX + num_of_anchors;
+    anchors->width   = anchors->height + num_of_anchors;
 
-    // Load detections and anchors in struct array
+    for (size_t i = 0; i < num_of_anchors; i++) {
+        float xmin = data[i * ANCHOR_SIZE];
+        float ymin = data[i * ANCHOR_SIZE + 1];
+        float xmax = data[i * ANCHOR_SIZE + 2];
+        float ymax = data[i * ANCHOR_SIZE + 3];
+
+        anchors->centerY[i] = (ymin + ymax) / 2.0f;
+        anchors->centerX[i] = (xmin + xmax) / 2.0f;
+        anchors->height[i]  = ymax - ymin;
+        anchors->width[i]   = xmax - xmin;
+    }
+
+    munmap((void*)data, dataSize);
+    close(fd);
+
+    return anchors;
+
+errorExit:
+    if (data != MAP_FAILED) {
+        munmap((void*)data, dataSize);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    destroyAnchorTable(anchors);
+
+    return NULL;
+}
+
+void destroyAnchorTable(AnchorTable_t* anchors) {
+    if (!anchors) {
+        return;
+    }
+    free(anchors->centerY);
+    free(anchors);
+}
+
+// Pick the class with the highest score for each detection
+static void selectClasses(const float* classes,
+                          int num_of_detections,
+                          int num_of_classes,
+                          box* boxes) {
     for (int i = 0; i < num_of_detections; i++) {
-        dets[i].dy    = locations[i * 4];
-        dets[i].dx    = locations[i * 4 + 1];
-        dets[i].dh    = locations[i * 4 + 2];
-        dets[i].dw    = locations[i * 4 + 3];
-        dets[i].score = 0;
+        const float* scores = &classes[i * num_of_classes];
+
+        boxes[i].score = 0;
+        boxes[i].label = 0;
         for (int j = 0; j < num_of_classes; j++) {
-            if (classes[i * num_of_classes + j] > dets[i].score) {
-                dets[i].score = classes[i * num_of_classes + j];
-                dets[i].label = j;
+            if (scores[j] > boxes[i].score) {
+                boxes[i].score = scores[j];
+                boxes[i].label = j;
             }
         }
-        if (fread(&dets[i].anchor_xmin, sizeof(float), 1, fp) != 1) {
-            syslog(LOG_ERR, "Error when reading anchor file");
-            return 1;
-        }
-        if (fread(&dets[i].anchor_ymin, sizeof(float), 1, fp) != 1) {
-            syslog(LOG_ERR, "Error when reading anchor file");
-            return 1;
-        }
-        if (fread(&dets[i].anchor_xmax, sizeof(float), 1, fp) != 1) {
-            syslog(LOG_ERR, "Error when reading anchor file");
-            return 1;
-        }
-        if (fread(&dets[i].anchor_ymax, sizeof(float), 1, fp) != 1) {
-            syslog(LOG_ERR, "Error when reading anchor file");
-            return 1;
-        }
     }
+}
 
-    // Close anchor file
-    fclose(fp);
-    return 0;
+// Decode the boxes of detections first to last - 1
+static void decodeBoxes(const float* locations,
+                        const AnchorTable_t* anchors,
+                        int first,
+                        int last,
+                        box* boxes,
+                        const float scales[4]) {
+    float center_y, center_x, height, width;
+    for (int i = first; i < last; i++) {
+        const float* location = &locations[i * 4];
+
+        center_y = location[0] * anchors->height[i] / scales[0] + anchors->centerY[i];
+        center_x = location[1] * anchors->width[i] / scales[1] + anchors->centerX[i];
+        height   = expf(location[2] / scales[2]) * anchors->height[i];
+        width    = expf(location[3] / scales[3]) * anchors->width[i];
+
+        // Limit boxes from 0 to 1
+        boxes[i].x_min = fmaxf(0, center_x - width / 2.0f);
+        boxes[i].y_min = fmaxf(0, center_y - height / 2.0f);
+        boxes[i].x_max = fminf(1, center_x + width / 2.0f);
+        boxes[i].y_max = fminf(1, center_y + height / 2.0f);
+    }
+}
+
+#ifdef POSTPROCESSING_USE_NEON
+/*
+ * Approximate expf() of four values. The argument is split as n * ln(2) + r with |r| <= ln(2) / 2,
+ * e^r is evaluated with a degree 5 polynomial and 2^n is built directly in the float exponent.
+ * The relative error is below 5e-6, which is far below what is visible in a decoded box.
+ */
+static float32x4_t fastExp(float32x4_t x) {
+    x = vminq_f32(vmaxq_f32(x, vdupq_n_f32(-87.0f)), vdupq_n_f32(88.0f));
+
+    // n = floor(x / ln(2) + 0.5), the rounding must not depend on vrndmq which is ARMv8 only
+    float32x4_t t   = vmlaq_n_f32(vdupq_n_f32(0.5f), x, 1.44269504f);
+    float32x4_t n   = vcvtq_f32_s32(vcvtq_s32_f32(t));
+    uint32x4_t over = vcgtq_f32(n, t);
+    n = vsubq_f32(n, vreinterpretq_f32_u32(vandq_u32(over, vreinterpretq_u32_f32(vdupq_n_f32(1)))));
+
+    float32x4_t r = vmlsq_n_f32(x, n, 0.693147181f);
+
+    float32x4_t p = vdupq_n_f32(1.0f / 120.0f);
+    p             = vmlaq_f32(vdupq_n_f32(1.0f / 24.0f), p, r);
+    p             = vmlaq_f32(vdupq_n_f32(1.0f / 6.0f), p, r);
+    p             = vmlaq_f32(vdupq_n_f32(0.5f), p, r);
+    p             = vmlaq_f32(vdupq_n_f32(1.0f), p, r);
+    p             = vmlaq_f32(vdupq_n_f32(1.0f), p, r);
+
+    int32x4_t exponent = vshlq_n_s32(vaddq_s32(vcvtq_s32_f32(n), vdupq_n_s32(127)), 23);
+    return vmulq_f32(p, vreinterpretq_f32_s32(exponent));
 }
 
+/*
+ * Decode the boxes of four detections at a time. The locations are deinterleaved on load and the
+ * corners are interleaved again on store, since the first four fields of a box are the corners.
+ *
+ * Returns the number of decoded detections, a multiple of four.
+ */
+static int decodeBoxesNeon(const float* locations,
+                           const AnchorTable_t* anchors,
+                           int num_of_detections,
+                           box* boxes,
+                           const float scales[4]) {
+    const float32x4_t zero = vdupq_n_f32(0);
+    const float32x4_t one  = vdupq_n_f32(1);
+    const float invScaleY  = 1.0f / scales[0];
+    const float invScaleX  = 1.0f / scales[1];
+    const float invScaleH  = 1.0f / scales[2];
+    const float invScaleW  = 1.0f / scales[3];
+    float corners[16];
+    int i = 0;
+
+    for (; i + 4 <= num_of_detections; i += 4) {
+        float32x4x4_t location = vld4q_f32(&locations[i * 4]);
+        float32x4_t priorY     = vld1q_f32(&anchors->centerY[i]);
+        float32x4_t priorX     = vld1q_f32(&anchors->centerX[i]);
+        float32x4_t priorH     = vld1q_f32(&anchors->height[i]);
+        float32x4_t priorW     = vld1q_f32(&anchors->width[i]);
+
+        float32x4_t centerY = vmlaq_f32(priorY, vmulq_n_f32(location.val[0], invScaleY), priorH);
+        float32x4_t centerX = vmlaq_f32(priorX, vmulq_n_f32(location.val[1], invScaleX), priorW);
+        float32x4_t halfH   = vmulq_f32(fastExp(vmulq_n_f32(location.val[2], invScaleH)),
+                                      vmulq_n_f32(priorH, 0.5f));
+        float32x4_t halfW   = vmulq_f32(fastExp(vmulq_n_f32(location.val[3], invScaleW)),
+                                      vmulq_n_f32(priorW, 0.5f));
+
+        // Limit boxes from 0 to 1, stored in the field order of box
+        float32x4x4_t corner;
+        corner.val[0] = vmaxq_f32(zero, vsubq_f32(centerY, halfH));
+        corner.val[1] = vmaxq_f32(zero, vsubq_f32(centerX, halfW));
+        corner.val[2] = vminq_f32(one, vaddq_f32(centerY, halfH));
+        corner.val[3] = vminq_f32(one, vaddq_f32(centerX, halfW));
+        vst4q_f32(corners, corner);
+
+        for (int k = 0; k < 4; k++) {
+            memcpy(&boxes[i + k].y_min, &corners[k * 4], 4 * sizeof(float));
+        }
+    }
+    return i;
+}
+#endif
+
 // Apply anchors to detections to obtain boxes
-static void applyAnchors(detection* dets,
+static void applyAnchors(const float* locations,
+                         const float* classes,
                          int num_of_detections,
+                         int num_of_classes,
+                         const AnchorTable_t* anchors,
                          box* boxes,
                          float y_scale,
                          float x_scale,
                          float h_scale,
                          float w_scale) {
-    float prior_center_y, prior_center_x, prior_height, prior_width;
-    float center_y, center_x, height, width;
-    for (int i = 0; i < num_of_detections; i++) {
-        prior_center_x = (dets[i].anchor_xmin + dets[i].anchor_xmax) / 2.0;
-        prior_center_y = (dets[i].anchor_ymin + dets[i].anchor_ymax) / 2.0;
-        prior_width    = dets[i].anchor_xmax - dets[i].anchor_xmin;
-        prior_height   = dets[i].anchor_ymax - dets[i].anchor_ymin;
-
-        center_x = dets[i].dx * prior_width / x_scale + prior_center_x;
-        center_y = dets[i].dy * prior_height / y_scale + prior_center_y;
-        width    = exp(dets[i].dw / w_scale) * prior_width;
-        height   = exp(dets[i].dh / h_scale) * prior_height;
-
-        boxes[i].x_min = center_x - width / 2.0;
-        boxes[i].y_min = center_y - height / 2.0;
-        boxes[i].x_max = center_x + width / 2.0;
-        boxes[i].y_max = center_y + height / 2.0;
-        boxes[i].score = dets[i].score;
-        boxes[i].label = dets[i].label;
+    const float scales[4] = {y_scale, x_scale, h_scale, w_scale};
+    int decoded           = 0;
 
-        // Limit boxes from 0 to 1
-        boxes[i].x_min = fmaxf(0, boxes[i].x_min);
-        boxes[i].y_min = fmaxf(0, boxes[i].y_min);
-        boxes[i].x_max = fminf(1, boxes[i].x_max);
-        boxes[i].y_max = fminf(1, boxes[i].y_max);
-    }
+    selectClasses(classes, num_of_detections, num_of_classes, boxes);
+#ifdef POSTPROCESSING_USE_NEON
+    decoded = decodeBoxesNeon(locations, anchors, num_of_detections, boxes, scales);
+#endif
+    decodeBoxes(locations, anchors, decoded, num_of_detections, boxes, scales);
+}
+
+static void swapBoxes(box* a, box* b) {
+    box temp = *a;
+    *a       = *b;
+    *b       = temp;
 }
 
-// Suppress low score boxes
-static void suppressLowScoreBoxes(box* boxes, int num_of_detections, float score_threshold) {
+// Move the boxes with a score of at least score_threshold to the front, the rest get score 0.
+// Label 0 is the background class of the SSD model, those boxes are never detections and would
+// otherwise take the places of the real ones in the top-K selection
+static int compactBoxes(box* boxes, int num_of_detections, float score_threshold) {
+    int num_of_boxes = 0;
     for (int i = 0; i < num_of_detections; i++) {
-        if (boxes[i].score < score_threshold) {
-            boxes[i].score = 0;
+        if (boxes[i].score >= score_threshold && boxes[i].score > 0 && boxes[i].label != 0) {
+            swapBoxes(&boxes[num_of_boxes++], &boxes[i]);
+        }
+    }
+    for (int i = num_of_boxes; i < num_of_detections; i++) {
+        boxes[i].score = 0;
+    }
+    return num_of_boxes;
+}
+
+// Restore the min-heap on score below index i
+static void siftDown(box* heap, int size, int i) {
+    while (true) {
+        int smallest = i;
+        int left     = 2 * i + 1;
+        int right    = left + 1;
+        if (left < size && heap[left].score < heap[smallest].score) {
+            smallest = left;
         }
+        if (right < size && heap[right].score < heap[smallest].score) {
+            smallest = right;
+        }
+        if (smallest == i) {
+            return;
+        }
+        swapBoxes(&heap[i], &heap[smallest]);
+        i = smallest;
     }
 }
 
-// Sort boxes by score efficiently
-static void sortBoxesEfficient(box* boxes, int num_of_detections) {
-    box temp;
-    int i       = 0;
-    int j       = num_of_detections - 1;
-    float pivot = boxes[num_of_detections / 2].score;
-    while (i <= j) {
-        while (boxes[i].score > pivot) i++;
-        while (boxes[j].score < pivot) j--;
-        if (i <= j) {
-            temp     = boxes[i];
-            boxes[i] = boxes[j];
-            boxes[j] = temp;
-            i++;
-            j--;
+/*
+ * Keep the max_boxes highest scoring of the compacted boxes at the front using a min-heap of
+ * size max_boxes, so the boxes are never fully sorted. The dropped boxes get score 0.
+ */
+static int selectTopBoxes(box* boxes, int num_of_boxes, int max_boxes) {
+    if (max_boxes <= 0 || num_of_boxes <= max_boxes) {
+        return num_of_boxes;
+    }
+
+    for (int i = max_boxes / 2 - 1; i >= 0; i--) {
+        siftDown(boxes, max_boxes, i);
+    }
+    for (int i = max_boxes; i < num_of_boxes; i++) {
+        if (boxes[i].score > boxes[0].score) {
+            swapBoxes(&boxes[i], &boxes[0]);
+            siftDown(boxes, max_boxes, 0);
         }
+        boxes[i].score = 0;
+    }
+    return max_boxes;
+}
+
+// Order boxes by descending score
+static int compareScores(const void* a, const void* b) {
+    const box* box1 = a;
+    const box* box2 = b;
+    return (box1->score < box2->score) - (box1->score > box2->score);
+}
+
+// Order boxes by label, and by descending score within a label
+static int compareLabelsAndScores(const void* a, const void* b) {
+    const box* box1 = a;
+    const box* box2 = b;
+    if (box1->label != box2->label) {
+        return box1->label < box2->label ? -1 : 1;
     }
-    if (j > 0)
-        sortBoxesEfficient(boxes, j + 1);
-    if (i < num_of_detections - 1)
-        sortBoxesEfficient(boxes + i, num_of_detections - i);
+    return compareScores(a, b);
 }
 
 // Calculate IOU
-static float calculateIOU(box box1, box box2) {
-    float intersection_xmin = fmaxf(box1.x_min, box2.x_min);
-    float intersection_ymin = fmaxf(box1.y_min, box2.y_min);
-    float intersection_xmax = fminf(box1.x_max, box2.x_max);
-    float intersection_ymax = fminf(box1.y_max, box2.y_max);
+static float calculateIOU(const box* box1, const box* box2) {
+    float intersection_xmin = fmaxf(box1->x_min, box2->x_min);
+    float intersection_ymin = fmaxf(box1->y_min, box2->y_min);
+    float intersection_xmax = fminf(box1->x_max, box2->x_max);
+    float intersection_ymax = fminf(box1->y_max, box2->y_max);
     float intersection_area = fmaxf(intersection_xmax - intersection_xmin, 0) *
                               fmaxf(intersection_ymax - intersection_ymin, 0);
-    float union_area = (box1.x_max - box1.x_min) * (box1.y_max - box1.y_min) +
-                       (box2.x_max - box2.x_min) * (box2.y_max - box2.y_min) - intersection_area;
+    float union_area = (box1->x_max - box1->x_min) * (box1->y_max - box1->y_min) +
+                       (box2->x_max - box2->x_min) * (box2->y_max - box2->y_min) -
+                       intersection_area;
     return intersection_area / union_area;
 }
 
-// Suppress overlapping boxes (non-maxima-suppression) return sorted boxes by score, without
-// overlapping
-static void suppressOverlappingBoxes(box* boxes, int num_of_detections, float iou_threshold) {
-    sortBoxesEfficient(boxes, num_of_detections);
-    float iou;
-    for (int i = 0; i < num_of_detections; i++) {
-        for (int j = i + 1; j < num_of_detections; j++) {
-            iou = calculateIOU(boxes[i], boxes[j]);
-            if (iou > iou_threshold && boxes[i].label == boxes[j].label) {
+// Greedy non-maximum suppression within one label, the boxes must be sorted by descending score
+static void suppressOverlappingBucket(box* boxes, int num_of_boxes, float iou_threshold) {
+    for (int i = 0; i < num_of_boxes; i++) {
+        if (boxes[i].score <= 0) {
+            continue;
+        }
+        for (int j = i + 1; j < num_of_boxes; j++) {
+            if (boxes[j].score > 0 && calculateIOU(&boxes[i], &boxes[j]) > iou_threshold) {
                 boxes[j].score = 0;
             }
         }
     }
 }
 
+/*
+ * Suppress overlapping boxes (non-maxima-suppression) of the same label. The boxes are bucketed
+ * per label so IOU is only calculated within a label, and are then returned sorted by score with
+ * the suppressed boxes, having score 0, last.
+ */
+static void suppressOverlappingBoxes(box* boxes, int num_of_boxes, float iou_threshold) {
+    qsort(boxes, num_of_boxes, sizeof(box), compareLabelsAndScores);
+
+    int start = 0;
+    while (start < num_of_boxes) {
+        int end = start + 1;
+        while (end < num_of_boxes && boxes[end].label == boxes[start].label) {
+            end++;
+        }
+        suppressOverlappingBucket(&boxes[start], end - start, iou_threshold);
+        start = end;
+    }
+
+    qsort(boxes, num_of_boxes, sizeof(box), compareScores);
+}
+
 int postProcessing(float* locations,
                    float* classes,
                    int num_of_detections,
-                   const char* anchor_file,
+                   const AnchorTable_t* anchors,
                    int num_of_classes,
                    float score_threshold,
                    float nms_threshold,
+                   int max_boxes,
                    float y_scale,
                    float x_scale,
                    float h_scale,
                    float w_scale,
                    box* boxes) {
-    // Load detections and anchors in struct array
-    detection* dets = (detection*)malloc(num_of_detections * sizeof(detection));
-    if (loadDetectionStruct(locations,
-                            classes,
-                            num_of_detections,
-                            num_of_classes,
-                            anchor_file,
-                            dets) != 0) {
-        printf("Error loading detection struct");
-        free(dets);
+    if (anchors->numAnchors < (size_t)num_of_detections) {
+        syslog(LOG_ERR,
+               "Anchor table holds %zu anchors but there are %d detections",
+               anchors->numAnchors,
+               num_of_detections);
         return 1;
     }
 
     // Convert detections to boxes
-    applyAnchors(dets, num_of_detections, boxes, y_scale, x_scale, h_scale, w_scale);
-    free(dets);
-    suppressLowScoreBoxes(boxes, num_of_detections, score_threshold);
-    suppressOverlappingBoxes(boxes, num_of_detections, nms_threshold);
+    applyAnchors(locations,
+                 classes,
+                 num_of_detections,
+                 num_of_classes,
+                 anchors,
+                 boxes,
+                 y_scale,
+                 x_scale,
+                 h_scale,
+                 w_scale);
+    int num_of_boxes = compactBoxes(boxes, num_of_detections, score_threshold);
+    num_of_boxes     = selectTopBoxes(boxes, num_of_boxes, max_boxes);
+    suppressOverlappingBoxes(boxes, num_of_boxes, nms_threshold);
 
     return 0;
 }
@@ -14,6 +14,9 @@
  * limitations under the License.
  */
 
+#pragma once
+
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -28,6 +31,37 @@ typedef struct {
     int label;
 } box;
 
+/**
+ * @brief Anchors of the model, stored as precomputed priors in one array per field
+ *
+ * The table is loaded once from the anchor file, so no file I/O or anchor arithmetic is needed
+ * when applying the anchors to the detections of a frame.
+ */
+typedef struct AnchorTable {
+    size_t numAnchors;
+    float* centerY;
+    float* centerX;
+    float* height;
+    float* width;
+} AnchorTable_t;
+
+/**
+ * @brief Load the anchors from a file
+ *
+ * @param anchor_file path to file containing num_of_anchors anchors, each stored as four floats
+ * in the format [xmin, ymin, xmax, ymax]
+ * @param num_of_anchors number of anchors, one per detection of the model
+ * @return Pointer to the anchor table or NULL if the file could not be loaded
+ */
+AnchorTable_t* createAnchorTable(const char* anchor_file, size_t num_of_anchors);
+
+/**
+ * @brief Release an anchor table created by createAnchorTable
+ *
+ * @param anchors Pointer to the anchor table, may be NULL
+ */
+void destroyAnchorTable(AnchorTable_t* anchors);
+
 /**
  * @brief convert output from model into detection boxes
  *
@@ -36,23 +70,28 @@ typedef struct {
  * @param classes output from the model of size num_of_detections*num_of_classes containing the
  * confidence for each class
  * @param num_of_detections number of detections
- * @param anchors_file path to file containing anchors
+ * @param anchors anchor table with at least num_of_detections anchors
  * @param num_of_classes number of classes
- * @param score_threshold minimum threshold for a box to be considered a detection
+ * @param score_threshold minimum threshold for a box to be considered a detection, boxes of label 0,
+ * the background class, are never kept
  * @param nms_threshold threshold for the iou non-maximum suppression
+ * @param max_boxes maximum number of highest scoring boxes passed to the non-maximum suppression,
+ * 0 means no limit
  * @param y_scale scale factor for the y coordinate
  * @param x_scale scale factor for the x coordinate
  * @param h_scale scale factor for the height
  * @param w_scale scale factor for the width
- * @param boxes output array of boxes
+ * @param boxes output array of num_of_detections boxes, the boxes kept are first sorted by
+ * descending score and all other boxes have score 0
  */
 int postProcessing(float* locations,
                    float* classes,
                    int num_of_detections,
-                   const char* anchor_file,
+                   const AnchorTable_t* anchors,
                    int num_of_classes,
                    float score_threshold,
                    float nms_threshold,
+                   int max_boxes,
                    float y_scale,
                    float x_scale,
                    float h_scale,
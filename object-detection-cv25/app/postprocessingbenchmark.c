@@ -0,0 +1,176 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * - postprocessingbenchmark -
+ *
+ * Replays the output tensors of a recording, made by the application with the --record option,
+ * through the postprocessing and reports the time and the number of allocations per frame. It
+ * does not use larod or vdo, so it can be built for the host as well as for the device.
+ *
+ * The program expects the path to the recording as first argument, and optionally the number of
+ * times to replay it as second argument.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <syslog.h>
+#include <time.h>
+
+#include "postprocessing.h"
+#include "tensorrecording.h"
+
+#define DEFAULT_ITERATIONS (100)
+
+// The allocation functions are wrapped by the linker, see the Makefile
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+void* __wrap_malloc(size_t size);
+void* __wrap_calloc(size_t count, size_t size);
+void* __wrap_realloc(void* ptr, size_t size);
+
+static unsigned long long numAllocations;
+
+void* __wrap_malloc(size_t size) {
+    numAllocations++;
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+    numAllocations++;
+    return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+    numAllocations++;
+    return __real_realloc(ptr, size);
+}
+
+static unsigned long long nowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ull + (unsigned long long)ts.tv_nsec;
+}
+
+static int compareNs(const void* a, const void* b) {
+    unsigned long long lhs = *(const unsigned long long*)a;
+    unsigned long long rhs = *(const unsigned long long*)b;
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+// Run the postprocessing of a frame with the parameters the application used
+static void runFrame(const TensorRecording_t* recording, size_t frame, box* boxes) {
+    const TensorRecordingHeader_t* header = &recording->header;
+    postProcessing((float*)tensorRecordingLocations(recording, frame),
+                   (float*)tensorRecordingClasses(recording, frame),
+                   (int)header->numDetections,
+                   &recording->anchors,
+                   (int)header->numClasses,
+                   header->scoreThreshold,
+                   header->nmsThreshold,
+                   header->maxBoxes,
+                   header->yScale,
+                   header->xScale,
+                   header->hScale,
+                   header->wScale,
+                   boxes);
+}
+
+// The kept boxes are first, sorted by descending score, the others have score 0
+static unsigned int countBoxes(const box* boxes, unsigned int numDetections) {
+    unsigned int numBoxes = 0;
+    while (numBoxes < numDetections && boxes[numBoxes].score > 0) {
+        numBoxes++;
+    }
+    return numBoxes;
+}
+
+int main(int argc, char** argv) {
+    // Errors of the postprocessing go to the system log, show them on stderr too
+    openlog(NULL, LOG_PERROR, LOG_USER);
+
+    if (argc < 2 || argc > 3) {
+        fprintf(stderr, "Usage: %s RECORDING [ITERATIONS]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    unsigned int iterations =
+        argc == 3 ? (unsigned int)strtoul(argv[2], NULL, 10) : DEFAULT_ITERATIONS;
+    if (iterations == 0) {
+        fprintf(stderr, "Invalid number of iterations %s\n", argv[2]);
+        return EXIT_FAILURE;
+    }
+    TensorRecording_t* recording = loadTensorRecording(argv[1]);
+    if (!recording) {
+        return EXIT_FAILURE;
+    }
+    const TensorRecordingHeader_t* header = &recording->header;
+    const size_t numFrames                = recording->numFrames;
+
+    // The same boxes array as the application, one box per detection
+    box* boxes                  = malloc(sizeof(box) * header->numDetections);
+    size_t numSamples           = numFrames * iterations;
+    unsigned long long* samples = calloc(numSamples, sizeof(unsigned long long));
+    if (!boxes || !samples) {
+        fprintf(stderr, "Could not allocate %zu samples\n", numSamples);
+        return EXIT_FAILURE;
+    }
+
+    // Warm up the caches and the branch predictors with one pass
+    for (size_t i = 0; i < numFrames; i++) {
+        runFrame(recording, i, boxes);
+    }
+
+    unsigned long long totalBoxes = 0;
+    numAllocations                = 0;
+    for (unsigned int iteration = 0; iteration < iterations; iteration++) {
+        for (size_t i = 0; i < numFrames; i++) {
+            unsigned long long startNs = nowNs();
+            runFrame(recording, i, boxes);
+            unsigned long long timeNs = nowNs() - startNs;
+
+            totalBoxes += countBoxes(boxes, header->numDetections);
+            samples[iteration * numFrames + i] = timeNs;
+        }
+    }
+    unsigned long long allocations = numAllocations;
+
+    unsigned long long sumNs = 0;
+    for (size_t i = 0; i < numSamples; i++) {
+        sumNs += samples[i];
+    }
+    qsort(samples, numSamples, sizeof(unsigned long long), compareNs);
+
+    printf("Model: %u detections of %u classes, score threshold %.2f, IoU threshold %.2f\n",
+           header->numDetections,
+           header->numClasses,
+           (double)header->scoreThreshold,
+           (double)header->nmsThreshold);
+    printf("Replayed %zu frames %u times\n", numFrames, iterations);
+    printf("Boxes per frame: %.1f\n", (double)totalBoxes / (double)numSamples);
+    printf("ns/frame: mean %llu, p50 %llu, p99 %llu, min %llu, max %llu\n",
+           sumNs / numSamples,
+           samples[numSamples / 2],
+           samples[(numSamples * 99) / 100],
+           samples[0],
+           samples[numSamples - 1]);
+    printf("Allocations per frame: %.2f\n", (double)allocations / (double)numSamples);
+
+    free(samples);
+    free(boxes);
+    destroyTensorRecording(recording);
+    return EXIT_SUCCESS;
+}
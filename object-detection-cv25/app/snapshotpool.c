@@ -0,0 +1,157 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * This file handles cropping and jpeg encoding of detection snapshots on the
+ * workers of a task pool.
+ *
+ * The crops are encoded straight from the borrowed image. Each task worker has
+ * an encoder with a jpeg output buffer and a jpeg configuration that are
+ * reused for all jobs it runs, so no memory is allocated per snapshot once the
+ * output buffer has grown to the largest jpeg.
+ */
+
+#include "snapshotpool.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+
+#include "imgutils.h"
+
+/**
+ * brief Crop, encode and write the snapshot of one job.
+ *
+ * param arg The SnapshotTask of the job.
+ * param workerIndex Index of the task worker, whose encoder is used.
+ */
+static void processJob(void* arg, unsigned int workerIndex) {
+    const SnapshotTask_t* task = (const SnapshotTask_t*)arg;
+    const SnapshotJob_t* job   = &task->job;
+    SnapshotEncoder_t* encoder = &task->pool->encoders[workerIndex];
+
+    if (job->cropWidth == 0 || job->cropHeight == 0) {
+        return;
+    }
+    // libjpeg reads the rows straight from the borrowed image
+    image_view_t view = crop_view(job->image,
+                                  job->imageWidth,
+                                  job->imageHeight,
+                                  job->channels,
+                                  job->cropX,
+                                  job->cropY,
+                                  job->cropWidth,
+                                  job->cropHeight);
+
+    set_jpeg_parameters(job->cropWidth,
+                        job->cropHeight,
+                        job->channels,
+                        task->pool->quality,
+                        &encoder->jpegConf);
+
+    // libjpeg replaces the buffer if it is too small, the old one is then ours to free
+    unsigned char* jpegBuffer = encoder->jpegBuffer;
+    unsigned long jpegSize    = encoder->jpegBufferSize;
+    compress_view_to_jpeg(&view, &encoder->jpegConf, &jpegSize, &jpegBuffer);
+    if (jpegBuffer != encoder->jpegBuffer) {
+        free(encoder->jpegBuffer);
+        encoder->jpegBuffer     = jpegBuffer;
+        encoder->jpegBufferSize = jpegSize;
+    }
+
+    jpeg_to_file((char*)job->fileName, jpegBuffer, jpegSize);
+}
+
+SnapshotPool_t* createSnapshotPool(TaskPool_t* taskPool, unsigned int capacity, int quality) {
+    if (capacity == 0) {
+        syslog(LOG_ERR, "%s: A snapshot pool needs at least one queue slot", __func__);
+        return NULL;
+    }
+
+    SnapshotPool_t* pool = calloc(1, sizeof(SnapshotPool_t));
+    if (!pool) {
+        syslog(LOG_ERR, "%s: Unable to allocate SnapshotPool: %s", __func__, strerror(errno));
+        return NULL;
+    }
+    pool->taskPool = taskPool;
+    pool->quality  = quality;
+    pool->capacity = capacity;
+
+    pool->tasks    = calloc(capacity, sizeof(SnapshotTask_t));
+    pool->encoders = calloc(taskPool->numWorkers, sizeof(SnapshotEncoder_t));
+    if (!pool->tasks || !pool->encoders) {
+        syslog(LOG_ERR, "%s: Unable to allocate SnapshotPool: %s", __func__, strerror(errno));
+        goto errorExit;
+    }
+
+    if (!initTaskGroup(&pool->group)) {
+        goto errorExit;
+    }
+    pool->groupInitialized = true;
+
+    for (unsigned int i = 0; i < taskPool->numWorkers; i++) {
+        SnapshotEncoder_t* encoder = &pool->encoders[i];
+
+        encoder->jpegConf.err = jpeg_std_error(&encoder->jpegErr);
+        jpeg_create_compress(&encoder->jpegConf);
+        pool->numEncoders++;
+    }
+
+    return pool;
+
+errorExit:
+    destroySnapshotPool(pool);
+
+    return NULL;
+}
+
+void destroySnapshotPool(SnapshotPool_t* pool) {
+    if (!pool) {
+        return;
+    }
+
+    if (pool->groupInitialized) {
+        taskGroupWait(&pool->group);
+        destroyTaskGroup(&pool->group);
+    }
+
+    for (unsigned int i = 0; i < pool->numEncoders; i++) {
+        jpeg_destroy_compress(&pool->encoders[i].jpegConf);
+        free(pool->encoders[i].jpegBuffer);
+    }
+
+    free(pool->tasks);
+    free(pool->encoders);
+    free(pool);
+}
+
+void snapshotPoolSubmit(SnapshotPool_t* pool, const SnapshotJob_t* job) {
+    // The slots are reused once all jobs using them are done
+    if (pool->numSubmitted == pool->capacity) {
+        snapshotPoolWait(pool);
+    }
+
+    SnapshotTask_t* task = &pool->tasks[pool->numSubmitted++];
+    task->pool           = pool;
+    task->job            = *job;
+    taskPoolSubmit(pool->taskPool, TASK_LANE_BULK, &pool->group, processJob, task);
+}
+
+void snapshotPoolWait(SnapshotPool_t* pool) {
+    taskGroupWait(&pool->group);
+    pool->numSubmitted = 0;
+}
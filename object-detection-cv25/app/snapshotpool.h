@@ -0,0 +1,124 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * This header file handles cropping and jpeg encoding of detection snapshots
+ * on the workers of a task pool.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include <jpeglib.h>
+
+#include "taskpool.h"
+
+#define SNAPSHOT_FILE_NAME_SIZE (32)
+
+/**
+ * brief A crop of an image to be encoded as jpeg and written to a file.
+ *
+ * The image is borrowed, it must not be changed until snapshotPoolWait()
+ * has returned.
+ */
+typedef struct SnapshotJob {
+    const unsigned char* image;
+    unsigned int imageWidth;
+    unsigned int imageHeight;
+    unsigned int channels;
+    unsigned int cropX;
+    unsigned int cropY;
+    unsigned int cropWidth;
+    unsigned int cropHeight;
+    char fileName[SNAPSHOT_FILE_NAME_SIZE];
+} SnapshotJob_t;
+
+struct SnapshotPool;
+
+/**
+ * brief Buffers of a task worker that are reused between jobs.
+ */
+typedef struct SnapshotEncoder {
+    unsigned char* jpegBuffer;
+    unsigned long jpegBufferSize;
+    struct jpeg_compress_struct jpegConf;
+    struct jpeg_error_mgr jpegErr;
+} SnapshotEncoder_t;
+
+/**
+ * brief A submitted job and the pool it belongs to, the argument of its task.
+ */
+typedef struct SnapshotTask {
+    struct SnapshotPool* pool;
+    SnapshotJob_t job;
+} SnapshotTask_t;
+
+/**
+ * brief Snapshot jobs run as bulk tasks on the workers of a task pool.
+ */
+typedef struct SnapshotPool {
+    TaskPool_t* taskPool;
+    int quality;
+
+    /// One encoder per task worker.
+    SnapshotEncoder_t* encoders;
+    unsigned int numEncoders;
+
+    /// Jobs submitted since the last wait.
+    SnapshotTask_t* tasks;
+    unsigned int capacity;
+    unsigned int numSubmitted;
+    TaskGroup_t group;
+    bool groupInitialized;
+} SnapshotPool_t;
+
+/**
+ * brief Create a pool of snapshot encoders running on a task pool.
+ *
+ * param taskPool The task pool to run the jobs on, must outlive the SnapshotPool.
+ * param capacity Number of jobs that can be submitted before submitting blocks.
+ * param quality The jpeg quality (0-100) of the snapshots.
+ * return Pointer to new SnapshotPool or NULL if failed.
+ */
+SnapshotPool_t* createSnapshotPool(TaskPool_t* taskPool, unsigned int capacity, int quality);
+
+/**
+ * brief Finish all submitted jobs and release the pool.
+ *
+ * param pool Pointer to the SnapshotPool to destroy, may be NULL.
+ */
+void destroySnapshotPool(SnapshotPool_t* pool);
+
+/**
+ * brief Queue a snapshot job, waiting for the submitted jobs if capacity jobs are pending.
+ *
+ * The jobs are submitted from one thread.
+ *
+ * param pool Pointer to SnapshotPool.
+ * param job The job, which is copied into the queue.
+ */
+void snapshotPoolSubmit(SnapshotPool_t* pool, const SnapshotJob_t* job);
+
+/**
+ * brief Block until all submitted jobs are done.
+ *
+ * After this the images of the submitted jobs are no longer used by the pool.
+ *
+ * param pool Pointer to SnapshotPool.
+ */
+void snapshotPoolWait(SnapshotPool_t* pool);
@@ -0,0 +1,357 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * This file handles a pool of worker threads that runs the background tasks
+ * of the application.
+ *
+ * Each deque has its own mutex, so the workers only contend when one steals
+ * from another. The pool mutex is only taken to put idle workers to sleep and
+ * to wake them, a worker sleeps when the queued tasks of all lanes are taken.
+ */
+
+#include "taskpool.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <unistd.h>
+
+/// The worker running on this thread, NULL outside the pools.
+static __thread TaskWorker_t* currentWorker = NULL;
+
+static void runTask(const Task_t* task, unsigned int workerIndex) {
+    task->func(task->arg, workerIndex);
+
+    // Counted down under the mutex, so taskGroupWait() can not return, and the group be
+    // destroyed, until the worker is done with it
+    TaskGroup_t* group = task->group;
+    if (group) {
+        pthread_mutex_lock(&group->mutex);
+        if (atomic_fetch_sub(&group->numPending, 1) == 1) {
+            pthread_cond_broadcast(&group->done);
+        }
+        pthread_mutex_unlock(&group->mutex);
+    }
+}
+
+/**
+ * brief Push a task to the bottom of the first deque of the lane with room,
+ * starting with the deque of worker first.
+ */
+static bool pushTask(TaskPool_t* pool, unsigned int first, TaskLane_t lane, const Task_t* task) {
+    for (unsigned int i = 0; i < pool->numWorkers; i++) {
+        TaskWorker_t* worker = &pool->workers[(first + i) % pool->numWorkers];
+        TaskDeque_t* deque   = &worker->deques[lane];
+
+        pthread_mutex_lock(&worker->mutex);
+        if (deque->count < pool->dequeCapacity) {
+            deque->tasks[(deque->top + deque->count) % pool->dequeCapacity] = *task;
+            deque->count++;
+            // Counted before the task can be taken, so the count never wraps
+            atomic_fetch_add(&pool->numQueued[lane], 1);
+            pthread_mutex_unlock(&worker->mutex);
+            return true;
+        }
+        pthread_mutex_unlock(&worker->mutex);
+    }
+    return false;
+}
+
+/**
+ * brief Take a task, the newest from the own deques or the oldest from the
+ * deques of the other workers, emptying the lanes in order of priority.
+ */
+static bool takeTask(TaskWorker_t* self, Task_t* task) {
+    TaskPool_t* pool = self->pool;
+
+    for (int lane = 0; lane < TASK_NUM_LANES; lane++) {
+        if (atomic_load(&pool->numQueued[lane]) == 0) {
+            continue;
+        }
+        for (unsigned int i = 0; i < pool->numWorkers; i++) {
+            TaskWorker_t* victim = &pool->workers[(self->index + i) % pool->numWorkers];
+            TaskDeque_t* deque   = &victim->deques[lane];
+            bool found           = false;
+
+            pthread_mutex_lock(&victim->mutex);
+            if (deque->count > 0) {
+                deque->count--;
+                if (victim == self) {
+                    *task = deque->tasks[(deque->top + deque->count) % pool->dequeCapacity];
+                } else {
+                    *task      = deque->tasks[deque->top];
+                    deque->top = (deque->top + 1) % pool->dequeCapacity;
+                }
+                found = true;
+            }
+            pthread_mutex_unlock(&victim->mutex);
+
+            if (found) {
+                atomic_fetch_sub(&pool->numQueued[lane], 1);
+                if (victim != self) {
+                    atomic_fetch_add(&pool->numStolen, 1);
+                }
+                if (atomic_load(&pool->numBlocked) > 0) {
+                    pthread_mutex_lock(&pool->mutex);
+                    pthread_cond_broadcast(&pool->taskTaken);
+                    pthread_mutex_unlock(&pool->mutex);
+                }
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+static bool hasQueuedTasks(TaskPool_t* pool) {
+    for (int lane = 0; lane < TASK_NUM_LANES; lane++) {
+        if (atomic_load(&pool->numQueued[lane]) > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void* workerEntry(void* data) {
+    TaskWorker_t* worker = (TaskWorker_t*)data;
+    TaskPool_t* pool     = worker->pool;
+
+    applyThreadConfig(&pool->threadConfig);
+    currentWorker = worker;
+
+    while (true) {
+        Task_t task;
+        if (takeTask(worker, &task)) {
+            runTask(&task, worker->index);
+            atomic_fetch_add(&pool->numRun, 1);
+            continue;
+        }
+
+        pthread_mutex_lock(&pool->mutex);
+        while (!hasQueuedTasks(pool) && !pool->shutDown) {
+            pthread_cond_wait(&pool->taskQueued, &pool->mutex);
+        }
+        // Queued tasks are finished before shutting down
+        bool done = pool->shutDown && !hasQueuedTasks(pool);
+        pthread_mutex_unlock(&pool->mutex);
+
+        if (done) {
+            break;
+        }
+    }
+
+    return worker;
+}
+
+TaskPool_t* createTaskPool(unsigned int numWorkers,
+                           unsigned int dequeCapacity,
+                           const ThreadConfig_t* threadConfig) {
+    bool mtxInitialized  = false;
+    bool condInitialized = false;
+
+    if (numWorkers == 0) {
+        long numCores = sysconf(_SC_NPROCESSORS_ONLN);
+        numWorkers    = numCores > 1 ? (unsigned int)(numCores - 1) : 1;
+    }
+    if (dequeCapacity == 0) {
+        syslog(LOG_ERR, "%s: A task pool needs at least one queue slot", __func__);
+        return NULL;
+    }
+
+    TaskPool_t* pool = calloc(1, sizeof(TaskPool_t));
+    if (!pool) {
+        syslog(LOG_ERR, "%s: Unable to allocate TaskPool: %s", __func__, strerror(errno));
+        return NULL;
+    }
+    pool->numWorkers    = numWorkers;
+    pool->dequeCapacity = dequeCapacity;
+    pool->threadConfig  = *threadConfig;
+
+    pool->workers = calloc(numWorkers, sizeof(TaskWorker_t));
+    if (!pool->workers) {
+        syslog(LOG_ERR, "%s: Unable to allocate TaskPool: %s", __func__, strerror(errno));
+        goto errorExit;
+    }
+
+    if (pthread_mutex_init(&pool->mutex, NULL)) {
+        syslog(LOG_ERR, "%s: Unable to initialize mutex: %s", __func__, strerror(errno));
+        goto errorExit;
+    }
+    mtxInitialized = true;
+
+    if (pthread_cond_init(&pool->taskQueued, NULL) || pthread_cond_init(&pool->taskTaken, NULL)) {
+        syslog(LOG_ERR,
+               "%s: Unable to initialize condition variable: %s",
+               __func__,
+               strerror(errno));
+        goto errorExit;
+    }
+    condInitialized = true;
+
+    // All workers get their deques before any thread can steal from them
+    for (unsigned int i = 0; i < numWorkers; i++) {
+        TaskWorker_t* worker = &pool->workers[i];
+
+        if (pthread_mutex_init(&worker->mutex, NULL)) {
+            syslog(LOG_ERR, "%s: Unable to initialize mutex: %s", __func__, strerror(errno));
+            goto errorExit;
+        }
+        worker->pool  = pool;
+        worker->index = i;
+        for (int lane = 0; lane < TASK_NUM_LANES; lane++) {
+            worker->deques[lane].tasks = calloc(dequeCapacity, sizeof(Task_t));
+            if (!worker->deques[lane].tasks) {
+                syslog(LOG_ERR, "%s: Unable to allocate task deque", __func__);
+                goto errorExit;
+            }
+        }
+    }
+
+    for (unsigned int i = 0; i < numWorkers; i++) {
+        TaskWorker_t* worker = &pool->workers[i];
+
+        if (pthread_create(&worker->thread, NULL, workerEntry, worker)) {
+            syslog(LOG_ERR, "%s: Failed to start worker thread: %s", __func__, strerror(errno));
+            goto errorExit;
+        }
+        worker->threadCreated = true;
+    }
+    syslog(LOG_INFO, "Started %u task workers", numWorkers);
+
+    return pool;
+
+errorExit:
+    if (condInitialized) {
+        destroyTaskPool(pool);
+        return NULL;
+    }
+    if (mtxInitialized) {
+        pthread_mutex_destroy(&pool->mutex);
+    }
+    free(pool->workers);
+    free(pool);
+
+    return NULL;
+}
+
+void destroyTaskPool(TaskPool_t* pool) {
+    if (!pool) {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->shutDown = true;
+    pthread_cond_broadcast(&pool->taskQueued);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (unsigned int i = 0; i < pool->numWorkers; i++) {
+        if (pool->workers[i].threadCreated) {
+            pthread_join(pool->workers[i].thread, NULL);
+        }
+    }
+    syslog(LOG_INFO,
+           "Task pool ran %llu tasks, %llu stolen from another worker",
+           atomic_load(&pool->numRun),
+           atomic_load(&pool->numStolen));
+
+    for (unsigned int i = 0; i < pool->numWorkers; i++) {
+        TaskWorker_t* worker = &pool->workers[i];
+
+        // Workers are set up in order, the rest were never initialized
+        if (!worker->pool) {
+            break;
+        }
+        for (int lane = 0; lane < TASK_NUM_LANES; lane++) {
+            free(worker->deques[lane].tasks);
+        }
+        pthread_mutex_destroy(&worker->mutex);
+    }
+
+    pthread_cond_destroy(&pool->taskQueued);
+    pthread_cond_destroy(&pool->taskTaken);
+    pthread_mutex_destroy(&pool->mutex);
+
+    free(pool->workers);
+    free(pool);
+}
+
+void taskPoolSubmit(TaskPool_t* pool,
+                    TaskLane_t lane,
+                    TaskGroup_t* group,
+                    TaskFunc_t func,
+                    void* arg) {
+    const Task_t task  = {.func = func, .arg = arg, .group = group};
+    TaskWorker_t* self = (currentWorker && currentWorker->pool == pool) ? currentWorker : NULL;
+
+    if (group) {
+        atomic_fetch_add(&group->numPending, 1);
+    }
+
+    unsigned int first =
+        self ? self->index : atomic_fetch_add(&pool->nextWorker, 1) % pool->numWorkers;
+    while (!pushTask(pool, first, lane, &task)) {
+        if (self) {
+            // Blocking a worker on its own pool could stall all of them
+            runTask(&task, self->index);
+            atomic_fetch_add(&pool->numRun, 1);
+            return;
+        }
+
+        pthread_mutex_lock(&pool->mutex);
+        atomic_fetch_add(&pool->numBlocked, 1);
+        while (atomic_load(&pool->numQueued[lane]) >= pool->numWorkers * pool->dequeCapacity) {
+            pthread_cond_wait(&pool->taskTaken, &pool->mutex);
+        }
+        atomic_fetch_sub(&pool->numBlocked, 1);
+        pthread_mutex_unlock(&pool->mutex);
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+    pthread_cond_signal(&pool->taskQueued);
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+bool initTaskGroup(TaskGroup_t* group) {
+    atomic_init(&group->numPending, 0);
+    if (pthread_mutex_init(&group->mutex, NULL)) {
+        syslog(LOG_ERR, "%s: Unable to initialize mutex: %s", __func__, strerror(errno));
+        return false;
+    }
+    if (pthread_cond_init(&group->done, NULL)) {
+        syslog(LOG_ERR,
+               "%s: Unable to initialize condition variable: %s",
+               __func__,
+               strerror(errno));
+        pthread_mutex_destroy(&group->mutex);
+        return false;
+    }
+    return true;
+}
+
+void destroyTaskGroup(TaskGroup_t* group) {
+    pthread_cond_destroy(&group->done);
+    pthread_mutex_destroy(&group->mutex);
+}
+
+void taskGroupWait(TaskGroup_t* group) {
+    pthread_mutex_lock(&group->mutex);
+    while (atomic_load(&group->numPending) > 0) {
+        pthread_cond_wait(&group->done, &group->mutex);
+    }
+    pthread_mutex_unlock(&group->mutex);
+}
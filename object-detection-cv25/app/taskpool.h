@@ -0,0 +1,178 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * This header file handles a pool of worker threads that runs the background
+ * tasks of the application.
+ *
+ * The pool has one worker per core that is not running the frame loop, so the
+ * background work uses the remaining cores without competing with itself.
+ * Every worker has its own deque of tasks per lane. A task submitted from
+ * outside the pool goes to the workers in turn, and a task submitted from a
+ * task goes to the deque of its worker. A worker takes the newest task from
+ * its own deque and, when that is empty, steals the oldest task from the
+ * other workers, so no worker idles while another has a backlog.
+ *
+ * The latency critical lane is always emptied on all workers before a bulk
+ * task is started, so work the next frame waits for overtakes e.g. snapshot
+ * encoding that has piled up.
+ */
+
+#pragma once
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+
+#include "threadconfig.h"
+
+typedef enum TaskLane {
+    TASK_LANE_CRITICAL = 0,
+    TASK_LANE_BULK,
+    TASK_NUM_LANES
+} TaskLane_t;
+
+/**
+ * brief Function of a task.
+ *
+ * param arg The argument given when the task was submitted.
+ * param workerIndex Index of the worker running the task, from 0 to the number
+ *                   of workers - 1, e.g. to use buffers owned by the worker.
+ */
+typedef void (*TaskFunc_t)(void* arg, unsigned int workerIndex);
+
+/**
+ * brief A set of tasks that can be waited for.
+ */
+typedef struct TaskGroup {
+    atomic_uint numPending;
+    pthread_mutex_t mutex;
+    pthread_cond_t done;
+} TaskGroup_t;
+
+typedef struct Task {
+    TaskFunc_t func;
+    void* arg;
+    TaskGroup_t* group;
+} Task_t;
+
+/**
+ * brief A bounded deque of tasks, the owner takes from the bottom and thieves from the top.
+ */
+typedef struct TaskDeque {
+    Task_t* tasks;
+    unsigned int top;
+    unsigned int count;
+} TaskDeque_t;
+
+struct TaskPool;
+
+typedef struct TaskWorker {
+    struct TaskPool* pool;
+    unsigned int index;
+    pthread_t thread;
+    bool threadCreated;
+
+    /// Protects the deques, which are shared with the thieves.
+    pthread_mutex_t mutex;
+    TaskDeque_t deques[TASK_NUM_LANES];
+} TaskWorker_t;
+
+typedef struct TaskPool {
+    TaskWorker_t* workers;
+    unsigned int numWorkers;
+    unsigned int dequeCapacity;
+    ThreadConfig_t threadConfig;
+
+    /// Tasks in all deques per lane.
+    atomic_uint numQueued[TASK_NUM_LANES];
+    /// Worker to get the next task submitted from outside the pool.
+    atomic_uint nextWorker;
+    /// Threads outside the pool waiting for room in the deques.
+    atomic_uint numBlocked;
+
+    /// Idle workers and blocked submitters sleep on the conditions.
+    pthread_mutex_t mutex;
+    pthread_cond_t taskQueued;
+    pthread_cond_t taskTaken;
+    bool shutDown;
+
+    atomic_ullong numRun;
+    atomic_ullong numStolen;
+} TaskPool_t;
+
+/**
+ * brief Create a pool of worker threads.
+ *
+ * param numWorkers Number of worker threads, 0 for one per online core except
+ *                  the one left for the frame loop.
+ * param dequeCapacity Number of tasks each worker can queue per lane.
+ * param threadConfig Affinity and scheduling of the worker threads.
+ * return Pointer to new TaskPool or NULL if failed.
+ */
+TaskPool_t* createTaskPool(unsigned int numWorkers,
+                           unsigned int dequeCapacity,
+                           const ThreadConfig_t* threadConfig);
+
+/**
+ * brief Finish all queued tasks, stop the workers and release the pool.
+ *
+ * param pool Pointer to the TaskPool to destroy, may be NULL.
+ */
+void destroyTaskPool(TaskPool_t* pool);
+
+/**
+ * brief Queue a task.
+ *
+ * Outside the pool this blocks while the deques of the lane are full. Within a
+ * task the new task is run right away if the deque of the worker is full.
+ *
+ * param pool Pointer to TaskPool.
+ * param lane The lane to queue the task in.
+ * param group The group the task belongs to, or NULL.
+ * param func The function to run.
+ * param arg The argument to the function, which must be valid until the task has run.
+ */
+void taskPoolSubmit(TaskPool_t* pool,
+                    TaskLane_t lane,
+                    TaskGroup_t* group,
+                    TaskFunc_t func,
+                    void* arg);
+
+/**
+ * brief Initialize an empty group.
+ *
+ * param group Pointer to the TaskGroup to initialize.
+ * return False if any errors occur, otherwise true.
+ */
+bool initTaskGroup(TaskGroup_t* group);
+
+/**
+ * brief Release a group without pending tasks.
+ *
+ * param group Pointer to the TaskGroup to release.
+ */
+void destroyTaskGroup(TaskGroup_t* group);
+
+/**
+ * brief Block until all tasks submitted to the group have run.
+ *
+ * Must not be called from a task, since the worker it blocks could be the one
+ * to run the tasks.
+ *
+ * param group Pointer to TaskGroup.
+ */
+void taskGroupWait(TaskGroup_t* group);
@@ -0,0 +1,194 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "tensorrecording.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+
+TensorRecorder_t* createTensorRecorder(const char* path,
+                                       const TensorRecordingHeader_t* header,
+                                       const AnchorTable_t* anchors,
+                                       unsigned int maxFrames) {
+    TensorRecordingHeader_t fileHeader = *header;
+    fileHeader.magic                   = TENSOR_RECORDING_MAGIC;
+    fileHeader.version                 = TENSOR_RECORDING_VERSION;
+    const size_t numAnchors            = fileHeader.numDetections;
+
+    if (anchors->numAnchors < numAnchors) {
+        syslog(LOG_ERR,
+               "%s: %zu anchors for %zu detections",
+               __func__,
+               anchors->numAnchors,
+               numAnchors);
+        return NULL;
+    }
+
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        syslog(LOG_ERR, "%s: Unable to open %s: %s", __func__, path, strerror(errno));
+        return NULL;
+    }
+    if (fwrite(&fileHeader, sizeof(fileHeader), 1, file) != 1 ||
+        fwrite(anchors->centerY, sizeof(float), numAnchors, file) != numAnchors ||
+        fwrite(anchors->centerX, sizeof(float), numAnchors, file) != numAnchors ||
+        fwrite(anchors->height, sizeof(float), numAnchors, file) != numAnchors ||
+        fwrite(anchors->width, sizeof(float), numAnchors, file) != numAnchors) {
+        syslog(LOG_ERR, "%s: Unable to write to %s: %s", __func__, path, strerror(errno));
+        fclose(file);
+        return NULL;
+    }
+
+    TensorRecorder_t* recorder = calloc(1, sizeof(TensorRecorder_t));
+    char* pathCopy             = strdup(path);
+    if (!recorder || !pathCopy) {
+        syslog(LOG_ERR, "%s: Unable to allocate TensorRecorder: %s", __func__, strerror(errno));
+        free(recorder);
+        free(pathCopy);
+        fclose(file);
+        return NULL;
+    }
+    recorder->file           = file;
+    recorder->path           = pathCopy;
+    recorder->numLocations   = 4 * numAnchors;
+    recorder->numClassScores = numAnchors * fileHeader.numClasses;
+    recorder->maxFrames      = maxFrames;
+    syslog(LOG_INFO, "Recording %u output tensors to %s", maxFrames, path);
+    return recorder;
+}
+
+static void closeRecorderFile(TensorRecorder_t* recorder) {
+    if (!recorder->file) {
+        return;
+    }
+    if (fclose(recorder->file) != 0) {
+        syslog(LOG_ERR, "%s: Unable to write to %s: %s", __func__, recorder->path, strerror(errno));
+    }
+    recorder->file = NULL;
+    syslog(LOG_INFO, "Recorded %u output tensors to %s", recorder->numFrames, recorder->path);
+}
+
+void tensorRecorderWrite(TensorRecorder_t* recorder, const float* locations, const float* classes) {
+    if (!recorder || !recorder->file) {
+        return;
+    }
+    if (fwrite(locations, sizeof(float), recorder->numLocations, recorder->file) !=
+            recorder->numLocations ||
+        fwrite(classes, sizeof(float), recorder->numClassScores, recorder->file) !=
+            recorder->numClassScores) {
+        syslog(LOG_ERR, "%s: Unable to write to %s: %s", __func__, recorder->path, strerror(errno));
+        closeRecorderFile(recorder);
+        return;
+    }
+    if (++recorder->numFrames == recorder->maxFrames) {
+        closeRecorderFile(recorder);
+    }
+}
+
+void destroyTensorRecorder(TensorRecorder_t* recorder) {
+    if (!recorder) {
+        return;
+    }
+    closeRecorderFile(recorder);
+    free(recorder->path);
+    free(recorder);
+}
+
+TensorRecording_t* loadTensorRecording(const char* path) {
+    TensorRecording_t* recording = NULL;
+
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        syslog(LOG_ERR, "%s: Unable to open %s: %s", __func__, path, strerror(errno));
+        return NULL;
+    }
+
+    recording = calloc(1, sizeof(TensorRecording_t));
+    if (!recording) {
+        syslog(LOG_ERR, "%s: Unable to allocate TensorRecording: %s", __func__, strerror(errno));
+        goto errorExit;
+    }
+    TensorRecordingHeader_t* header = &recording->header;
+    if (fread(header, sizeof(*header), 1, file) != 1 || header->magic != TENSOR_RECORDING_MAGIC ||
+        header->version != TENSOR_RECORDING_VERSION || header->numDetections == 0 ||
+        header->numClasses == 0) {
+        syslog(LOG_ERR, "%s: %s is not a tensor recording", __func__, path);
+        goto errorExit;
+    }
+
+    if (fseek(file, 0, SEEK_END) != 0) {
+        syslog(LOG_ERR, "%s: Unable to seek in %s: %s", __func__, path, strerror(errno));
+        goto errorExit;
+    }
+    long fileSize = ftell(file);
+    if (fileSize < 0 || fseek(file, (long)sizeof(*header), SEEK_SET) != 0) {
+        syslog(LOG_ERR, "%s: Unable to seek in %s: %s", __func__, path, strerror(errno));
+        goto errorExit;
+    }
+
+    // A frame cut off at the end of the file is ignored
+    const size_t anchorsSize = 4 * (size_t)header->numDetections;
+    const size_t frameSize   = tensorRecordingFrameSize(header);
+    const size_t numFloats   = ((size_t)fileSize - sizeof(*header)) / sizeof(float);
+    if (numFloats < anchorsSize + frameSize) {
+        syslog(LOG_ERR, "%s: No tensors in %s", __func__, path);
+        goto errorExit;
+    }
+    const size_t numFrames = (numFloats - anchorsSize) / frameSize;
+    const size_t dataSize  = anchorsSize + numFrames * frameSize;
+
+    recording->data = malloc(dataSize * sizeof(float));
+    if (!recording->data) {
+        syslog(LOG_ERR,
+               "%s: Unable to allocate %zu frames: %s",
+               __func__,
+               numFrames,
+               strerror(errno));
+        goto errorExit;
+    }
+    if (fread(recording->data, sizeof(float), dataSize, file) != dataSize) {
+        syslog(LOG_ERR, "%s: Unable to read %s", __func__, path);
+        goto errorExit;
+    }
+    fclose(file);
+
+    const size_t numAnchors       = header->numDetections;
+    recording->anchors.numAnchors = numAnchors;
+    recording->anchors.centerY    = recording->data;
+    recording->anchors.centerX    = recording->data + numAnchors;
+    recording->anchors.height     = recording->data + 2 * numAnchors;
+    recording->anchors.width      = recording->data + 3 * numAnchors;
+    recording->frames             = recording->data + anchorsSize;
+    recording->numFrames          = numFrames;
+
+    return recording;
+
+errorExit:
+    fclose(file);
+    destroyTensorRecording(recording);
+
+    return NULL;
+}
+
+void destroyTensorRecording(TensorRecording_t* recording) {
+    if (!recording) {
+        return;
+    }
+    free(recording->data);
+    free(recording);
+}
@@ -0,0 +1,138 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * This header file handles recording of the output tensors of the model, to replay them
+ * through the postprocessing.
+ *
+ * A recording starts with a header with the model and postprocessing parameters and the anchor
+ * table, followed by the locations and class scores of each frame. The file is written with the
+ * byte order of the device, which is little endian on the device and on a x86_64 host.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "postprocessing.h"
+
+#define TENSOR_RECORDING_MAGIC   (0x54353256)  // "V25T"
+#define TENSOR_RECORDING_VERSION (1)
+
+/**
+ * brief The parameters of postProcessing() for the recorded frames.
+ */
+typedef struct TensorRecordingHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t numDetections;
+    uint32_t numClasses;
+    float scoreThreshold;
+    float nmsThreshold;
+    int32_t maxBoxes;
+    float yScale;
+    float xScale;
+    float hScale;
+    float wScale;
+} TensorRecordingHeader_t;
+
+typedef struct TensorRecorder {
+    FILE* file;
+    char* path;
+    size_t numLocations;
+    size_t numClassScores;
+    unsigned int maxFrames;
+    unsigned int numFrames;
+} TensorRecorder_t;
+
+/**
+ * brief A loaded recording, the anchors and frames point into one block of memory.
+ */
+typedef struct TensorRecording {
+    TensorRecordingHeader_t header;
+    AnchorTable_t anchors;
+    const float* frames;
+    size_t numFrames;
+    float* data;
+} TensorRecording_t;
+
+/**
+ * brief Create a recording, the file is replaced if it exists
+ *
+ * param path Path of the recording.
+ * param header Parameters of the postprocessing, magic and version are filled in.
+ * param anchors Anchor table of the model, with header->numDetections anchors.
+ * param maxFrames Number of frames to record, the later ones are ignored.
+ * return The recorder, or NULL if the file could not be written.
+ */
+TensorRecorder_t* createTensorRecorder(const char* path,
+                                       const TensorRecordingHeader_t* header,
+                                       const AnchorTable_t* anchors,
+                                       unsigned int maxFrames);
+
+/**
+ * brief Add the output tensors of a frame, the file is closed when maxFrames have been added
+ *
+ * param recorder The recorder, may be NULL to not record.
+ * param locations numDetections * 4 locations of the frame.
+ * param classes numDetections * numClasses class scores of the frame.
+ */
+void tensorRecorderWrite(TensorRecorder_t* recorder, const float* locations, const float* classes);
+
+/**
+ * brief Close the recording and free the recorder
+ *
+ * param recorder The recorder, may be NULL.
+ */
+void destroyTensorRecorder(TensorRecorder_t* recorder);
+
+/**
+ * brief Read all frames of a recording
+ *
+ * param path Path of the recording.
+ * return The recording, or NULL if the file could not be read or is not a recording.
+ */
+TensorRecording_t* loadTensorRecording(const char* path);
+
+/**
+ * brief Release a recording loaded by loadTensorRecording
+ *
+ * param recording The recording, may be NULL.
+ */
+void destroyTensorRecording(TensorRecording_t* recording);
+
+/**
+ * brief Number of floats of a recorded frame
+ */
+static inline size_t tensorRecordingFrameSize(const TensorRecordingHeader_t* header) {
+    return (size_t)header->numDetections * (4 + header->numClasses);
+}
+
+/**
+ * brief The locations of a loaded frame, followed by its class scores
+ */
+static inline const float* tensorRecordingLocations(const TensorRecording_t* recording,
+                                                    size_t frame) {
+    return recording->frames + frame * tensorRecordingFrameSize(&recording->header);
+}
+
+static inline const float* tensorRecordingClasses(const TensorRecording_t* recording,
+                                                  size_t frame) {
+    return tensorRecordingLocations(recording, frame) + 4 * recording->header.numDetections;
+}
@@ -0,0 +1,185 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * This file handles the CPU affinity and scheduling of the threads of the
+ * application.
+ */
+
+#include "threadconfig.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <syslog.h>
+#include <unistd.h>
+
+static const char* const roleNames[THREAD_NUM_ROLES] = {"capture", "inference", "worker"};
+
+void initThreadConfigs(ThreadConfig_t* configs) {
+    for (int i = 0; i < THREAD_NUM_ROLES; i++) {
+        memset(&configs[i], 0, sizeof(ThreadConfig_t));
+        configs[i].role = (ThreadRole_t)i;
+    }
+}
+
+/**
+ * brief Parse an integer in [min, max] that makes up all of str.
+ */
+static bool parseInt(const char* str, int min, int max, int* value) {
+    char* end;
+    errno     = 0;
+    long temp = strtol(str, &end, 10);
+    if (errno || end == str || *end != '\0' || temp < min || temp > max) {
+        return false;
+    }
+    *value = (int)temp;
+    return true;
+}
+
+static bool parseCpus(char* range, cpu_set_t* cpus) {
+    int first;
+    int last;
+    char* dash = strchr(range, '-');
+
+    if (dash) {
+        *dash = '\0';
+        if (!parseInt(range, 0, CPU_SETSIZE - 1, &first) ||
+            !parseInt(dash + 1, 0, CPU_SETSIZE - 1, &last) || last < first) {
+            return false;
+        }
+    } else {
+        if (!parseInt(range, 0, CPU_SETSIZE - 1, &first)) {
+            return false;
+        }
+        last = first;
+    }
+
+    CPU_ZERO(cpus);
+    for (int cpu = first; cpu <= last; cpu++) {
+        CPU_SET(cpu, cpus);
+    }
+    return true;
+}
+
+bool parseThreadConfig(const char* spec, ThreadConfig_t* configs) {
+    bool ret   = false;
+    char* copy = strdup(spec);
+    if (!copy) {
+        return false;
+    }
+
+    char* settings = strchr(copy, '=');
+    if (!settings) {
+        goto end;
+    }
+    *settings++ = '\0';
+
+    ThreadConfig_t* config = NULL;
+    for (int i = 0; i < THREAD_NUM_ROLES; i++) {
+        if (strcmp(copy, roleNames[i]) == 0) {
+            config = &configs[i];
+        }
+    }
+    if (!config) {
+        goto end;
+    }
+
+    char* savePtr = NULL;
+    for (char* setting = strtok_r(settings, ",", &savePtr); setting;
+         setting       = strtok_r(NULL, ",", &savePtr)) {
+        char* value = strchr(setting, ':');
+        if (!value) {
+            goto end;
+        }
+        *value++ = '\0';
+
+        if (strcmp(setting, "cpus") == 0) {
+            if (!parseCpus(value, &config->cpus)) {
+                goto end;
+            }
+            config->hasCpus = true;
+        } else if (strcmp(setting, "fifo") == 0) {
+            if (!parseInt(value, 1, 99, &config->fifoPriority)) {
+                goto end;
+            }
+            config->useFifo = true;
+        } else if (strcmp(setting, "nice") == 0) {
+            if (!parseInt(value, -20, 19, &config->nice)) {
+                goto end;
+            }
+            config->hasNice = true;
+        } else {
+            goto end;
+        }
+    }
+    ret = true;
+
+end:
+    free(copy);
+    return ret;
+}
+
+void applyThreadConfig(const ThreadConfig_t* config) {
+    const char* name = roleNames[config->role];
+    pthread_t self   = pthread_self();
+    int err;
+
+    // The name shows up in top and ps, thread names are limited to 15 characters
+    pthread_setname_np(self, name);
+
+    if (config->hasCpus) {
+        err = pthread_setaffinity_np(self, sizeof(cpu_set_t), &config->cpus);
+        if (err) {
+            syslog(LOG_WARNING, "%s: Could not pin %s thread: %s", __func__, name, strerror(err));
+        }
+    }
+
+    if (config->useFifo) {
+        // Needs CAP_SYS_NICE or an RLIMIT_RTPRIO of at least the priority
+        struct sched_param param = {.sched_priority = config->fifoPriority};
+        err                      = pthread_setschedparam(self, SCHED_FIFO, &param);
+        if (err) {
+            syslog(LOG_WARNING,
+                   "%s: Could not run %s thread with SCHED_FIFO: %s",
+                   __func__,
+                   name,
+                   strerror(err));
+        }
+    } else if (config->hasNice) {
+        // The nice level is per thread on Linux, set through the thread id
+        pid_t tid = (pid_t)syscall(SYS_gettid);
+        if (setpriority(PRIO_PROCESS, (id_t)tid, config->nice) < 0) {
+            syslog(LOG_WARNING,
+                   "%s: Could not set nice level of %s thread: %s",
+                   __func__,
+                   name,
+                   strerror(errno));
+        }
+    }
+
+    if (config->hasCpus || config->useFifo || config->hasNice) {
+        syslog(LOG_INFO,
+               "Configured %s thread: %d cpus, %s %d",
+               name,
+               config->hasCpus ? CPU_COUNT(&config->cpus) : 0,
+               config->useFifo ? "SCHED_FIFO priority" : "nice",
+               config->useFifo ? config->fifoPriority : config->nice);
+    }
+}
@@ -0,0 +1,85 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * This header file handles the CPU affinity and scheduling of the threads of
+ * the application.
+ *
+ * Each thread role, the VDO fetcher threads, the inference loop on the main
+ * thread and the task pool workers, can be pinned to a range of cores and run
+ * either with the real-time policy SCHED_FIFO or with a nice level. A thread
+ * applies the configuration of its role itself when it starts, so a setting
+ * that is not permitted, like SCHED_FIFO without the privilege to use it, is
+ * logged and the thread continues with what it has. A role without
+ * configuration keeps the default attributes.
+ */
+
+#pragma once
+
+#include <sched.h>
+#include <stdbool.h>
+
+typedef enum ThreadRole {
+    THREAD_ROLE_CAPTURE = 0,
+    THREAD_ROLE_INFERENCE,
+    THREAD_ROLE_WORKER,
+    THREAD_NUM_ROLES
+} ThreadRole_t;
+
+/**
+ * brief Affinity and scheduling of the threads of a role.
+ */
+typedef struct ThreadConfig {
+    ThreadRole_t role;
+    /// Pin the threads to cpus if set.
+    bool hasCpus;
+    cpu_set_t cpus;
+    /// Run with SCHED_FIFO at fifoPriority (1-99) if set.
+    bool useFifo;
+    int fifoPriority;
+    /// Run at this nice level (-20-19) if set, only used without SCHED_FIFO.
+    bool hasNice;
+    int nice;
+} ThreadConfig_t;
+
+/**
+ * brief Set all roles to the default attributes.
+ *
+ * param configs Array of THREAD_NUM_ROLES configurations, indexed by role.
+ */
+void initThreadConfigs(ThreadConfig_t* configs);
+
+/**
+ * brief Parse the configuration of a role.
+ *
+ * The format is ROLE=SETTING[,SETTING...], where ROLE is capture, inference or
+ * worker and SETTING is cpus:FIRST[-LAST], fifo:PRIORITY or nice:LEVEL, e.g.
+ * "inference=cpus:2-3,fifo:10".
+ *
+ * param spec The configuration to parse.
+ * param configs Array of THREAD_NUM_ROLES configurations, the one of the role is updated.
+ * return False if the configuration is invalid.
+ */
+bool parseThreadConfig(const char* spec, ThreadConfig_t* configs);
+
+/**
+ * brief Apply a configuration to the calling thread and name the thread after its role.
+ *
+ * Settings that fail are logged and skipped.
+ *
+ * param config The configuration of the role of the thread.
+ */
+void applyThreadConfig(const ThreadConfig_t* config);
@@ -0,0 +1,274 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * This file handles detection snapshots encoded by the VDO jpeg encoder.
+ *
+ * A single jpeg snapshot of the full frame is requested from VDO for all
+ * detections of a frame, and turbojpeg cuts every crop from it losslessly in
+ * one transform. Both run in a task on the workers. Only one frame is cropped
+ * at a time, the frame loop encodes the crops of the next frame on the CPU if
+ * the task is still running.
+ */
+
+#include "vdosnapshot.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+
+#include "imgutils.h"
+#include "vdo-frame.h"
+#include "vdo-stream.h"
+
+VdoSnapshot_t* createVdoSnapshot(TaskPool_t* taskPool,
+                                 unsigned int width,
+                                 unsigned int height,
+                                 unsigned int maxCrops,
+                                 unsigned int maxJobs) {
+    if (maxCrops == 0) {
+        syslog(LOG_ERR, "%s: At least one crop per transform is needed", __func__);
+        return NULL;
+    }
+
+    VdoSnapshot_t* snapshot = calloc(1, sizeof(VdoSnapshot_t));
+    if (!snapshot) {
+        syslog(LOG_ERR, "%s: Unable to allocate VdoSnapshot: %s", __func__, strerror(errno));
+        return NULL;
+    }
+    snapshot->width    = width;
+    snapshot->height   = height;
+    snapshot->maxCrops = maxCrops;
+    snapshot->taskPool = taskPool;
+    snapshot->maxJobs  = maxJobs;
+    atomic_init(&snapshot->busy, false);
+    atomic_init(&snapshot->numSkewed, 0);
+
+    snapshot->transforms    = calloc(maxCrops, sizeof(tjtransform));
+    snapshot->cropJpegs     = calloc(maxCrops, sizeof(unsigned char*));
+    snapshot->cropJpegSizes = calloc(maxCrops, sizeof(size_t));
+    snapshot->jobs          = calloc(maxJobs, sizeof(SnapshotJob_t));
+    if (!snapshot->transforms || !snapshot->cropJpegs || !snapshot->cropJpegSizes ||
+        !snapshot->jobs) {
+        syslog(LOG_ERR, "%s: Unable to allocate VdoSnapshot: %s", __func__, strerror(errno));
+        goto errorExit;
+    }
+
+    snapshot->transformer = tj3Init(TJINIT_TRANSFORM);
+    if (!snapshot->transformer) {
+        syslog(LOG_ERR,
+               "%s: Unable to create jpeg transformer: %s",
+               __func__,
+               tj3GetErrorStr(NULL));
+        goto errorExit;
+    }
+
+    if (!initTaskGroup(&snapshot->group)) {
+        goto errorExit;
+    }
+    snapshot->groupInitialized = true;
+
+    snapshot->settings = vdo_map_new();
+    vdo_map_set_uint32(snapshot->settings, "format", VDO_FORMAT_JPEG);
+    vdo_map_set_pair32u(snapshot->settings, "resolution", (VdoPair32u){.w = width, .h = height});
+
+    return snapshot;
+
+errorExit:
+    destroyVdoSnapshot(snapshot);
+
+    return NULL;
+}
+
+void destroyVdoSnapshot(VdoSnapshot_t* snapshot) {
+    if (!snapshot) {
+        return;
+    }
+
+    if (snapshot->groupInitialized) {
+        taskGroupWait(&snapshot->group);
+        destroyTaskGroup(&snapshot->group);
+    }
+    if (atomic_load(&snapshot->numSkewed) > 0) {
+        syslog(LOG_INFO,
+               "Dropped %u VDO snapshot crops taken too long after the analyzed frame",
+               atomic_load(&snapshot->numSkewed));
+    }
+    if (snapshot->cropJpegs) {
+        for (unsigned int i = 0; i < snapshot->maxCrops; i++) {
+            tj3Free(snapshot->cropJpegs[i]);
+        }
+    }
+    if (snapshot->transformer) {
+        tj3Destroy(snapshot->transformer);
+    }
+    if (snapshot->settings) {
+        g_object_unref(snapshot->settings);
+    }
+
+    free(snapshot->transforms);
+    free(snapshot->cropJpegs);
+    free(snapshot->cropJpegSizes);
+    free(snapshot->jobs);
+    free(snapshot);
+}
+
+/**
+ * brief Set a lossless crop transform for the crop of a job.
+ *
+ * param transform The transform to set.
+ * param job The job holding the crop.
+ * param mcuWidth Width of a jpeg block of the snapshot.
+ * param mcuHeight Height of a jpeg block of the snapshot.
+ * param width Width of the snapshot.
+ * param height Height of the snapshot.
+ */
+static void setCropTransform(tjtransform* transform,
+                             const SnapshotJob_t* job,
+                             unsigned int mcuWidth,
+                             unsigned int mcuHeight,
+                             unsigned int width,
+                             unsigned int height) {
+    unsigned int x = job->cropX - job->cropX % mcuWidth;
+    unsigned int y = job->cropY - job->cropY % mcuHeight;
+    unsigned int w = job->cropWidth + (job->cropX - x);
+    unsigned int h = job->cropHeight + (job->cropY - y);
+
+    memset(transform, 0, sizeof(tjtransform));
+    transform->op      = TJXOP_NONE;
+    transform->options = TJXOPT_CROP;
+    transform->r.x     = (int)x;
+    transform->r.y     = (int)y;
+    transform->r.w     = (int)(x + w > width ? width - x : w);
+    transform->r.h     = (int)(y + h > height ? height - y : h);
+}
+
+/**
+ * brief Take a snapshot and write the crops of the copied jobs, run as a task.
+ *
+ * Errors are logged, the crops of the frame are then lost.
+ *
+ * param snapshot The VdoSnapshot.
+ */
+static void writeCrops(VdoSnapshot_t* snapshot) {
+    const SnapshotJob_t* jobs = snapshot->jobs;
+    unsigned int numJobs      = snapshot->numJobs;
+    GError* error             = NULL;
+
+    VdoBuffer* buffer = vdo_stream_snapshot(snapshot->settings, &error);
+    if (!buffer) {
+        syslog(LOG_WARNING,
+               "%s: Failed to get jpeg snapshot: %s",
+               __func__,
+               (error != NULL) ? error->message : "N/A");
+        g_clear_error(&error);
+        return;
+    }
+
+    // Lifetimes of buffer and frame are linked, no need to free frame
+    VdoFrame* frame = vdo_buffer_get_frame(buffer);
+    if (vdo_frame_get_timestamp(frame) > snapshot->frameTimestamp + VDO_SNAPSHOT_MAX_SKEW_US) {
+        // The boxes would be applied to a too different frame
+        atomic_fetch_add(&snapshot->numSkewed, numJobs);
+        goto end;
+    }
+
+    const unsigned char* jpeg = vdo_buffer_get_data(buffer);
+    size_t jpegSize           = vdo_frame_get_size(frame);
+    tjhandle transformer      = snapshot->transformer;
+    if (!jpeg || tj3DecompressHeader(transformer, jpeg, jpegSize)) {
+        syslog(LOG_WARNING, "%s: Invalid jpeg snapshot: %s", __func__, tj3GetErrorStr(transformer));
+        goto end;
+    }
+
+    int subsampling = tj3Get(transformer, TJPARAM_SUBSAMP);
+    int jpegWidth   = tj3Get(transformer, TJPARAM_JPEGWIDTH);
+    int jpegHeight  = tj3Get(transformer, TJPARAM_JPEGHEIGHT);
+    if (subsampling < 0 || (unsigned int)jpegWidth != snapshot->width ||
+        (unsigned int)jpegHeight != snapshot->height) {
+        syslog(LOG_WARNING, "%s: Unexpected jpeg snapshot layout", __func__);
+        goto end;
+    }
+
+    for (unsigned int first = 0; first < numJobs; first += snapshot->maxCrops) {
+        unsigned int numCrops = numJobs - first;
+        if (numCrops > snapshot->maxCrops) {
+            numCrops = snapshot->maxCrops;
+        }
+        for (unsigned int i = 0; i < numCrops; i++) {
+            setCropTransform(&snapshot->transforms[i],
+                             &jobs[first + i],
+                             tjMCUWidth[subsampling],
+                             tjMCUHeight[subsampling],
+                             snapshot->width,
+                             snapshot->height);
+        }
+
+        if (tj3Transform(transformer,
+                         jpeg,
+                         jpegSize,
+                         (int)numCrops,
+                         snapshot->cropJpegs,
+                         snapshot->cropJpegSizes,
+                         snapshot->transforms)) {
+            syslog(LOG_WARNING,
+                   "%s: Failed to crop snapshot: %s",
+                   __func__,
+                   tj3GetErrorStr(transformer));
+            goto end;
+        }
+        for (unsigned int i = 0; i < numCrops; i++) {
+            jpeg_to_file((char*)jobs[first + i].fileName,
+                         snapshot->cropJpegs[i],
+                         snapshot->cropJpegSizes[i]);
+        }
+    }
+
+end:
+    g_object_unref(buffer);
+}
+
+static void writeCropsTask(void* arg, unsigned int workerIndex) {
+    (void)workerIndex;
+    VdoSnapshot_t* snapshot = arg;
+
+    writeCrops(snapshot);
+    atomic_store(&snapshot->busy, false);
+}
+
+bool vdoSnapshotSubmitCrops(VdoSnapshot_t* snapshot,
+                            const SnapshotJob_t* jobs,
+                            unsigned int numJobs,
+                            uint64_t frameTimestamp) {
+    if (numJobs > snapshot->maxJobs) {
+        return false;
+    }
+    // A snapshot is taken no earlier than now
+    if ((uint64_t)g_get_monotonic_time() > frameTimestamp + VDO_SNAPSHOT_MAX_SKEW_US) {
+        return false;
+    }
+    if (atomic_exchange(&snapshot->busy, true)) {
+        return false;
+    }
+
+    memcpy(snapshot->jobs, jobs, numJobs * sizeof(SnapshotJob_t));
+    snapshot->numJobs        = numJobs;
+    snapshot->frameTimestamp = frameTimestamp;
+    taskPoolSubmit(snapshot->taskPool, TASK_LANE_BULK, &snapshot->group, writeCropsTask, snapshot);
+
+    return true;
+}
@@ -0,0 +1,121 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * This header file handles detection snapshots encoded by the VDO jpeg
+ * encoder.
+ */
+
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <turbojpeg.h>
+
+#include "snapshotpool.h"
+#include "taskpool.h"
+#include "vdo-map.h"
+
+/// Longest time a snapshot may be taken after the analyzed frame for its crops to be used.
+#define VDO_SNAPSHOT_MAX_SKEW_US (100 * 1000)
+
+/**
+ * brief A source of jpeg snapshots of the full frame from VDO.
+ *
+ * The crops are cut from the hardware encoded snapshot with a lossless
+ * transform, so the image data is only entropy decoded and encoded again.
+ * The crop jpeg buffers are reused between frames.
+ *
+ * VDO can only encode a new frame, never the analyzed one, so the boxes are
+ * applied to a frame up to VDO_SNAPSHOT_MAX_SKEW_US later than the one they
+ * were detected in. Objects moving within that time are cropped slightly off.
+ */
+typedef struct VdoSnapshot {
+    VdoMap* settings;
+    unsigned int width;
+    unsigned int height;
+
+    tjhandle transformer;
+    /// Number of crops cut in one transform.
+    unsigned int maxCrops;
+    tjtransform* transforms;
+    unsigned char** cropJpegs;
+    size_t* cropJpegSizes;
+
+    /// The crops are cut by a task on the workers, off the frame loop.
+    TaskPool_t* taskPool;
+    TaskGroup_t group;
+    bool groupInitialized;
+    /// Set while the task runs, the jobs and buffers then belong to the task.
+    atomic_bool busy;
+    SnapshotJob_t* jobs;
+    unsigned int maxJobs;
+    unsigned int numJobs;
+    /// Capture time of the analyzed frame, in microseconds on the monotonic clock.
+    uint64_t frameTimestamp;
+    /// Crops dropped since the snapshot was taken too long after the analyzed frame.
+    atomic_uint numSkewed;
+} VdoSnapshot_t;
+
+/**
+ * brief Create a VDO snapshot source.
+ *
+ * param taskPool The task pool to cut the crops on, must outlive the VdoSnapshot.
+ * param width Width of the snapshots, the crops are given in this resolution.
+ * param height Height of the snapshots.
+ * param maxCrops Number of crops cut from the snapshot in one transform.
+ * param maxJobs Number of crops of one frame.
+ * return Pointer to new VdoSnapshot or NULL if failed.
+ */
+VdoSnapshot_t* createVdoSnapshot(TaskPool_t* taskPool,
+                                 unsigned int width,
+                                 unsigned int height,
+                                 unsigned int maxCrops,
+                                 unsigned int maxJobs);
+
+/**
+ * brief Wait for the crops being cut and release a VDO snapshot source.
+ *
+ * param snapshot Pointer to the VdoSnapshot to destroy, may be NULL.
+ */
+void destroyVdoSnapshot(VdoSnapshot_t* snapshot);
+
+/**
+ * brief Cut the crops of all jobs from a jpeg snapshot and write them to their files.
+ *
+ * The jobs are copied and the snapshot is taken and cropped by a task on the
+ * workers, so the frame loop does not wait for it. The image of the jobs is
+ * not used. The crops are extended up and to the left to the closest jpeg
+ * block boundary since a lossless crop can only start at a block boundary.
+ *
+ * If the snapshot turns out to be more than VDO_SNAPSHOT_MAX_SKEW_US later
+ * than the analyzed frame, the crops are dropped and counted in numSkewed.
+ *
+ * param snapshot Pointer to VdoSnapshot.
+ * param jobs The crops to write, with a width and height of at least 1 pixel.
+ * param numJobs Number of jobs, at most maxJobs.
+ * param frameTimestamp Capture time of the analyzed frame, from vdo_frame_get_timestamp().
+ * return False if the crops of the previous frame are still being cut, or if
+ *        the analyzed frame is already too old for a snapshot to match it. The
+ *        crops should then be encoded on the CPU from the analyzed frame instead.
+ */
+bool vdoSnapshotSubmitCrops(VdoSnapshot_t* snapshot,
+                            const SnapshotJob_t* jobs,
+                            unsigned int numJobs,
+                            uint64_t frameTimestamp);
@@ -24,6 +24,9 @@ typedef struct args_t {
     char* model_file;
     char* labels_file;
     char* device_name;
+    // File to record the output tensors to, NULL to not record
+    char* record_file;
+    unsigned int record_frames;
 } args_t;
 
 void parse_args(int argc, char** argv, args_t* args);
@@ -0,0 +1,233 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "detection_renderer.h"
+
+#include <bbox.h>
+#include <stdlib.h>
+#include <syslog.h>
+
+#include "panic.h"
+#include "track_store.h"
+
+// The labels share these colors, label N gets color N modulo the number of colors
+static const uint8_t palette_rgb[][3] = {
+    {0xff, 0x00, 0x00},
+    {0x00, 0xff, 0x00},
+    {0x00, 0x00, 0xff},
+    {0xff, 0xff, 0x00},
+    {0xff, 0x00, 0xff},
+    {0x00, 0xff, 0xff},
+    {0xff, 0x80, 0x00},
+    {0xff, 0xff, 0xff},
+};
+#define NUM_COLORS (sizeof(palette_rgb) / sizeof(palette_rgb[0]))
+
+struct detection_renderer {
+    bbox_t* bbox;
+    bbox_color_t colors[NUM_COLORS];
+    track_store_t* tracks;
+    // The tracks of a commit, grouped by color, max_boxes entries
+    const track_t** draw_order;
+    size_t max_boxes;
+
+    // Kept to create a larger track store
+    unsigned int width;
+    unsigned int height;
+    float tolerance_px;
+
+    uint64_t frames;
+    uint64_t commits;
+    uint64_t boxes;
+};
+
+static size_t color_of(const track_t* track) {
+    return (size_t)track->label % NUM_COLORS;
+}
+
+detection_renderer_t* detection_renderer_create(uint32_t view,
+                                                size_t max_boxes,
+                                                unsigned int width,
+                                                unsigned int height,
+                                                float tolerance_px) {
+    detection_renderer_t* renderer = calloc(1, sizeof(detection_renderer_t));
+    if (!renderer) {
+        panic("%s: Unable to allocate renderer", __func__);
+    }
+
+    renderer->bbox = bbox_view_new(view);
+    if (!renderer->bbox) {
+        panic("Failed to create box drawer");
+    }
+    bbox_clear(renderer->bbox);
+    bbox_style_outline(renderer->bbox);   // Switch to outline style
+    bbox_thickness_thin(renderer->bbox);  // Switch to thin lines
+
+    // Create all colors once [These operations are slow!]
+    for (size_t i = 0; i < NUM_COLORS; i++) {
+        renderer->colors[i] =
+            bbox_color_from_rgb(palette_rgb[i][0], palette_rgb[i][1], palette_rgb[i][2]);
+    }
+
+    renderer->tracks = track_store_create(max_boxes, width, height, tolerance_px);
+    if (!renderer->tracks) {
+        panic("%s: Could not create track store", __func__);
+    }
+    renderer->draw_order = calloc(max_boxes > 0 ? max_boxes : 1, sizeof(const track_t*));
+    if (!renderer->draw_order) {
+        panic("%s: Unable to allocate draw order", __func__);
+    }
+    renderer->max_boxes    = max_boxes;
+    renderer->width        = width;
+    renderer->height       = height;
+    renderer->tolerance_px = tolerance_px;
+    return renderer;
+}
+
+void detection_renderer_reserve(detection_renderer_t* renderer, size_t max_boxes) {
+    if (max_boxes <= renderer->max_boxes) {
+        return;
+    }
+    track_store_t* tracks =
+        track_store_create(max_boxes, renderer->width, renderer->height, renderer->tolerance_px);
+    if (!tracks) {
+        panic("%s: Could not create track store", __func__);
+    }
+    const track_t** draw_order = calloc(max_boxes, sizeof(const track_t*));
+    if (!draw_order) {
+        panic("%s: Unable to allocate draw order", __func__);
+    }
+    track_store_destroy(renderer->tracks);
+    free(renderer->draw_order);
+    renderer->tracks     = tracks;
+    renderer->draw_order = draw_order;
+    renderer->max_boxes  = max_boxes;
+
+    // The new store has drawn nothing, so the boxes on screen are cleared to match it
+    bbox_clear(renderer->bbox);
+    if (!bbox_commit(renderer->bbox, 0u)) {
+        panic("Failed to commit box drawer");
+    }
+}
+
+void detection_renderer_destroy(detection_renderer_t* renderer) {
+    if (!renderer) {
+        return;
+    }
+
+    syslog(LOG_INFO,
+           "Drew %llu boxes in %llu commits for %llu frames",
+           (unsigned long long)renderer->boxes,
+           (unsigned long long)renderer->commits,
+           (unsigned long long)renderer->frames);
+    bbox_destroy(renderer->bbox);
+    track_store_destroy(renderer->tracks);
+    free(renderer->draw_order);
+    free(renderer);
+}
+
+/**
+ * @brief Sort the tracks by color, with a counting sort since there are few colors.
+ *
+ * @return Number of tracks in the draw order.
+ */
+static size_t group_by_color(detection_renderer_t* renderer) {
+    size_t starts[NUM_COLORS] = {0};
+    size_t position           = 0;
+    const track_t* track;
+
+    while ((track = track_store_next(renderer->tracks, &position))) {
+        starts[color_of(track)]++;
+    }
+    size_t total = 0;
+    for (size_t i = 0; i < NUM_COLORS; i++) {
+        size_t count = starts[i];
+        starts[i]    = total;
+        total += count;
+    }
+
+    position = 0;
+    while ((track = track_store_next(renderer->tracks, &position))) {
+        renderer->draw_order[starts[color_of(track)]++] = track;
+    }
+    return total;
+}
+
+/**
+ * @brief End the frame of the track store and commit all boxes if anything has changed.
+ */
+static bool commit_frame(detection_renderer_t* renderer) {
+    if (!track_diff_changed(track_store_end_frame(renderer->tracks))) {
+        return false;
+    }
+
+    size_t num_boxes = group_by_color(renderer);
+    bbox_clear(renderer->bbox);
+
+    // No need to compensate for rotation since bbox will handle this
+    bbox_coordinates_frame_normalized(renderer->bbox);
+
+    size_t current_color = NUM_COLORS;
+    for (size_t i = 0; i < num_boxes; i++) {
+        const track_t* track = renderer->draw_order[i];
+        if (color_of(track) != current_color) {
+            current_color = color_of(track);
+            // Switch color [This operation is fast!]
+            bbox_color(renderer->bbox, renderer->colors[current_color]);
+        }
+        bbox_rectangle(renderer->bbox, track->box.x1, track->box.y1, track->box.x2, track->box.y2);
+    }
+
+    if (!bbox_commit(renderer->bbox, 0u)) {
+        panic("Failed to commit box drawer");
+    }
+    renderer->commits++;
+    renderer->boxes += num_boxes;
+    return true;
+}
+
+bool detection_renderer_draw(detection_renderer_t* renderer,
+                             const detection_t* detections,
+                             size_t num_detections) {
+    track_store_t* tracks = renderer->tracks;
+
+    renderer->frames++;
+    track_store_begin_frame(tracks);
+    for (size_t i = 0; i < num_detections; i++) {
+        const detection_t* d  = &detections[i];
+        const track_box_t box = {d->x1, d->y1, d->x2, d->y2};
+        if (track_store_update_untracked(tracks, d->label_idx, &box) == 0) {
+            syslog(LOG_WARNING, "Too many boxes, object %zu is not drawn", i + 1);
+        }
+    }
+    return commit_frame(renderer);
+}
+
+bool detection_renderer_draw_tracks(detection_renderer_t* renderer, const tracker_t* tracker) {
+    track_store_t* tracks = renderer->tracks;
+    size_t position       = 0;
+    tracker_object_t object;
+
+    renderer->frames++;
+    track_store_begin_frame(tracks);
+    while (tracker_next(tracker, &position, &object)) {
+        const track_box_t box = {object.x1, object.y1, object.x2, object.y2};
+        if (!track_store_update(tracks, object.id, object.label, &box)) {
+            syslog(LOG_WARNING, "Too many boxes, track %u is not drawn", object.id);
+        }
+    }
+    return commit_frame(renderer);
+}
@@ -0,0 +1,91 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Draws the detections of each frame with the Bounding Box API.
+ *
+ * The detections are passed as they come out of the post-processing, or as the
+ * tracks of a tracker. They are associated with the drawn boxes in a track
+ * store, and nothing is drawn for a frame where no box has been added, moved or
+ * removed. When something has
+ * changed, all boxes are drawn in one commit, since a commit replaces all
+ * geometry of the bbox handle.
+ *
+ * The label of a box is shown by its color. The colors are created once, since
+ * bbox_color_from_rgb() is slow, and the boxes are drawn grouped by color, so
+ * the color is switched once per label in the frame and not once per box.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "postprocessing.h"
+#include "tracker.h"
+
+typedef struct detection_renderer detection_renderer_t;
+
+/**
+ * @brief Create a renderer drawing on a view.
+ *
+ * @param view          The view to draw on.
+ * @param max_boxes     Maximum number of drawn boxes, more detections are not drawn.
+ * @param width         Width in pixels of the image the detections refer to.
+ * @param height        Height in pixels of the image the detections refer to.
+ * @param tolerance_px  A box is only redrawn when an edge moves more than this.
+ *
+ * @return Pointer to a new renderer, the application panics on failure.
+ */
+detection_renderer_t* detection_renderer_create(uint32_t view,
+                                                size_t max_boxes,
+                                                unsigned int width,
+                                                unsigned int height,
+                                                float tolerance_px);
+
+/**
+ * @brief Let the renderer draw up to max_boxes boxes, if it draws fewer.
+ *
+ * The boxes on screen are cleared and drawn again from the next frame.
+ */
+void detection_renderer_reserve(detection_renderer_t* renderer, size_t max_boxes);
+
+/**
+ * @brief Free the renderer and its bbox handle.
+ */
+void detection_renderer_destroy(detection_renderer_t* renderer);
+
+/**
+ * @brief Draw the detections of a frame, replacing those of the previous frame.
+ *
+ * @param detections      Detections of the frame.
+ * @param num_detections  Number of detections.
+ *
+ * @return True if the boxes were committed, false if nothing had changed.
+ */
+bool detection_renderer_draw(detection_renderer_t* renderer,
+                             const detection_t* detections,
+                             size_t num_detections);
+
+/**
+ * @brief Draw the reported tracks of a tracker, replacing those of the previous frame.
+ *
+ * The boxes are associated with the drawn boxes by track id.
+ *
+ * @return True if the boxes were committed, false if nothing had changed.
+ */
+bool detection_renderer_draw_tracks(detection_renderer_t* renderer, const tracker_t* tracker);
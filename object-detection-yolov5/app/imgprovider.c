@@ -38,61 +38,23 @@ G_DEFINE_AUTOPTR_CLEANUP_FUNC(VdoResolutionSet, g_free);
 // Use the first input channel
 #define VDO_INPUT_CHANNEL (1)
 
-#define IMG_PROVIDER_ANALYSIS_MAX (10)
+static void update_framerate(img_provider_t* provider, unsigned int analysis_time) {
+    g_autoptr(GError) error = NULL;
+    double old_framerate    = provider->framerate;
 
-/**
- * @brief Calculate a new img provider framerate based on inference time
- *
- * @param provider        The img provider to be used
- * @param analysis_time   Time in ms for the analysis
- *
- * @return void
- */
-static void calculate_new_framerate(img_provider_t* provider, unsigned int analysis_time) {
-    if (analysis_time > 201) {
-        provider->framerate = 1.0;
-        provider->frametime = 1001;
+    if (!framerate_controller_update(&provider->framerate_controller, analysis_time)) {
         return;
     }
-    if (analysis_time < 34) {
-        provider->framerate = 30.0;
-        provider->frametime = 34;
-    } else if (analysis_time < 41) {
-        provider->framerate = 25.0;
-        provider->frametime = 41;
-    } else if (analysis_time < 51) {
-        provider->framerate = 20.0;
-        provider->frametime = 51;
-    } else if (analysis_time < 67) {
-        provider->framerate = 15.0;
-        provider->frametime = 67;
-    } else if (analysis_time < 101) {
-        provider->framerate = 10.0;
-        provider->frametime = 101;
-    } else if (analysis_time < 201) {
-        provider->framerate = 5.0;
-        provider->frametime = 201;
-    }
-    if (provider->framerate > provider->requested_framerate) {
-        provider->framerate = provider->requested_framerate;
-        provider->frametime = (unsigned int)((1 / provider->framerate) * 1000);
+    provider->framerate = provider->framerate_controller.framerate;
+    if (!vdo_stream_set_framerate(provider->vdo_stream, provider->framerate, &error)) {
+        panic("%s: Failed to change framerate: %s", __func__, error->message);
     }
-}
-
-static void update_framerate(img_provider_t* provider, unsigned analysis_time) {
-    g_autoptr(GError) error    = NULL;
-    unsigned int old_frametime = provider->frametime;
-
-    calculate_new_framerate(provider, analysis_time);
-    if (old_frametime != provider->frametime) {
-        if (!vdo_stream_set_framerate(provider->vdo_stream, provider->framerate, &error)) {
-            panic("%s: Failed to change framerate: %s", __func__, error->message);
-        }
-        syslog(LOG_INFO,
-               "Change VDO stream framerate because of the mean analysis time %u ms",
-               analysis_time);
-        syslog(LOG_INFO, "New framerate is %f", provider->framerate);
-        // Flush all frames in vdo so the latest is used
+    syslog(LOG_INFO,
+           "Change VDO stream framerate because of the mean analysis time %.1f ms",
+           provider->framerate_controller.mean_analysis_time);
+    syslog(LOG_INFO, "New framerate is %f", provider->framerate);
+    // Only a lower framerate leaves old frames in vdo, flush them so the latest is used
+    if (provider->framerate < old_framerate) {
         img_provider_flush_all_frames(provider);
     }
 }
@@ -174,11 +136,14 @@ img_provider_t* create_img_provider(unsigned int width,
     provider->channel             = vdo_map_get_uint32(vdo_info, "channel", 0);
     provider->requested_framerate = framerate;
 
-    // Calculate the time between the images from vdo
-    provider->frametime            = (unsigned int)((1 / provider->framerate) * 1000);
-    provider->mean_analysis_time   = 0;
-    provider->analysis_frame_count = 0;
-    provider->tot_analysis_time    = 0;
+    const char* buffer_type = vdo_map_get_string(vdo_info, "buffer.type", NULL, "memfd");
+    provider->dmabuf        = g_strcmp0(buffer_type, "vmem") != 0;
+
+    framerate_controller_params_t framerate_params;
+    framerate_controller_default_params(framerate, &framerate_params);
+    framerate_controller_init(&provider->framerate_controller,
+                              &framerate_params,
+                              provider->framerate);
 
     provider->vdo_stream = g_steal_pointer(&vdo_stream);
 
@@ -196,26 +161,20 @@ void destroy_img_provider(img_provider_t* provider) {
 bool img_provider_update_framerate(img_provider_t* provider, unsigned analysis_time) {
     assert(provider);
 
-    provider->analysis_frame_count++;
-    provider->tot_analysis_time += analysis_time;
-    if (provider->analysis_frame_count == IMG_PROVIDER_ANALYSIS_MAX) {
-        provider->mean_analysis_time = provider->tot_analysis_time / provider->analysis_frame_count;
-
-        // If the analysis time is higher or lower than the time between frames from
-        // vdo change the framerate so the latest frame will be fetched from vdo
-        if (provider->frametime < provider->mean_analysis_time && provider->frametime < 201) {
-            update_framerate(provider, provider->mean_analysis_time);
-        } else if (provider->frametime > provider->mean_analysis_time) {
-            update_framerate(provider, provider->mean_analysis_time);
-        }
-        provider->mean_analysis_time   = 0;
-        provider->analysis_frame_count = 0;
-        provider->tot_analysis_time    = 0;
-    }
+    update_framerate(provider, analysis_time);
 
     return true;
 }
 
+void img_provider_set_latency_budget(img_provider_t* provider, double latency_budget) {
+    assert(provider);
+
+    if (latency_budget <= 0.0 || latency_budget > 1.0) {
+        panic("%s: Invalid latency budget %f", __func__, latency_budget);
+    }
+    provider->framerate_controller.params.latency_budget = latency_budget;
+}
+
 bool img_provider_start(img_provider_t* provider) {
     g_autoptr(GError) error = NULL;
     assert(provider);
@@ -297,6 +256,44 @@ void img_provider_flush_all_frames(img_provider_t* provider) {
     }
 }
 
+size_t list_stream_resolutions(VdoFormat format,
+                               const char* aspect_ratio,
+                               VdoResolution* resolutions,
+                               size_t max_resolutions) {
+    g_autoptr(VdoResolutionSet) set     = NULL;
+    g_autoptr(VdoChannel) channel       = NULL;
+    g_autoptr(GError) error             = NULL;
+    g_autoptr(VdoMap) resolution_filter = vdo_map_new();
+    g_autoptr(VdoMap) ch_desc           = vdo_map_new();
+
+    vdo_map_set_uint32(ch_desc, "input", VDO_INPUT_CHANNEL);
+    channel = vdo_channel_get_ex(ch_desc, &error);
+    if (!channel) {
+        panic("%s: Failed vdo_channel_get(): %s", __func__, error->message);
+    }
+
+    vdo_map_set_uint32(resolution_filter, "format", format);
+    vdo_map_set_string(resolution_filter, "select", "all");
+    if (aspect_ratio) {
+        vdo_map_set_string(resolution_filter, "aspect_ratio", aspect_ratio);
+    }
+    set = vdo_channel_get_resolutions(channel, resolution_filter, &error);
+    if (!set) {
+        syslog(LOG_WARNING,
+               "%s: Failed vdo_channel_get_resolutions() for format %u: %s",
+               __func__,
+               format,
+               error->message);
+        return 0;
+    }
+
+    size_t count = MIN(set->count, max_resolutions);
+    for (size_t i = 0; i < count; i++) {
+        resolutions[i] = set->resolutions[i];
+    }
+    return count;
+}
+
 bool choose_stream_resolution(unsigned int req_width,
                               unsigned int req_height,
                               VdoFormat format,
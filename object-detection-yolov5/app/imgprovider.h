@@ -21,8 +21,10 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+#include "framerate_controller.h"
 #include "vdo-error.h"
 #include "vdo-stream.h"
 #include "vdo-types.h"
@@ -55,12 +57,11 @@ typedef struct img_provider {
     double requested_framerate;
     unsigned int rotation;
     unsigned int channel;
+    // True if the buffers are dma-bufs, otherwise they are vmem and need converting for larod
+    bool dmabuf;
 
     // Used for chaging framerate if needed
-    unsigned int frametime;
-    unsigned int mean_analysis_time;
-    unsigned int analysis_frame_count;
-    unsigned int tot_analysis_time;
+    framerate_controller_t framerate_controller;
 
     int fd;
 } img_provider_t;
@@ -76,6 +77,14 @@ typedef struct img_provider {
  */
 bool img_provider_update_framerate(img_provider_t* provider, unsigned int analysis_time);
 
+/**
+ * @brief Set how large part of the time between frames the analysis may use
+ *
+ * @param provider        The imageprovider to be used
+ * @param latency_budget  Fraction of the time between two frames, in (0, 1]
+ */
+void img_provider_set_latency_budget(img_provider_t* provider, double latency_budget);
+
 /**
  * @brief Start the imgProvider and get fd for this imgprovider
  *
@@ -127,6 +136,21 @@ bool choose_stream_resolution(unsigned int req_width,
                               unsigned int* chosen_width,
                               unsigned int* chosen_height);
 
+/**
+ * @brief List the stream resolutions that VDO supports for a format.
+ *
+ * @param format           Format of the stream.
+ * @param aspect_ratio     Only list resolutions of this aspect ratio, can be NULL.
+ * @param resolutions      Filled with the resolutions.
+ * @param max_resolutions  Size of resolutions.
+ *
+ * @return The number of resolutions listed, 0 if VDO reports none.
+ */
+size_t list_stream_resolutions(VdoFormat format,
+                               const char* aspect_ratio,
+                               VdoResolution* resolutions,
+                               size_t max_resolutions);
+
 /**
  * @brief Initializes an ImgProvider.
  *
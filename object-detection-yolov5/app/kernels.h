@@ -0,0 +1,119 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * This header file contains the compute kernels used on quantized model outputs.
+ *
+ * The kernels use NEON when the compiler targets it and fall back to plain C otherwise. Define
+ * KERNELS_SCALAR to force the plain C versions. They are always inlined, so a count that is a
+ * constant in the caller, as in the decoders specialized per model, lets the compiler unroll them.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__ARM_NEON) && !defined(KERNELS_SCALAR)
+#include <arm_neon.h>
+#define KERNELS_USE_NEON
+#endif
+
+#define KERNEL_INLINE static inline __attribute__((always_inline))
+
+#ifdef KERNELS_USE_NEON
+KERNEL_INLINE uint8_t kernel_horizontal_max_u8(uint8x16_t values) {
+#ifdef __aarch64__
+    return vmaxvq_u8(values);
+#else
+    uint8x8_t max = vmax_u8(vget_low_u8(values), vget_high_u8(values));
+    max           = vpmax_u8(max, max);
+    max           = vpmax_u8(max, max);
+    max           = vpmax_u8(max, max);
+    return vget_lane_u8(max, 0);
+#endif
+}
+#endif
+
+/**
+ * @brief Find the first index of the largest value in an array of quantized values.
+ *
+ * Since dequantization with a positive scale is monotonic, the argmax of the raw values is the
+ * argmax of the dequantized values, and only the winner needs to be dequantized.
+ *
+ * @param values    Quantized values.
+ * @param count     Number of values, must be larger than 0.
+ * @param max_value Set to the largest value.
+ *
+ * @return Index of the first occurrence of the largest value.
+ */
+KERNEL_INLINE size_t kernel_argmax_u8(const uint8_t* values, size_t count, uint8_t* max_value) {
+    uint8_t max = 0;
+    size_t i    = 0;
+
+#ifdef KERNELS_USE_NEON
+    if (count >= 16) {
+        uint8x16_t max_vec = vld1q_u8(values);
+        for (i = 16; i + 16 <= count; i += 16) {
+            max_vec = vmaxq_u8(max_vec, vld1q_u8(values + i));
+        }
+        max = kernel_horizontal_max_u8(max_vec);
+    }
+#endif
+    for (; i < count; i++) {
+        if (values[i] > max) {
+            max = values[i];
+        }
+    }
+
+    // The first occurrence gives the same label as a scalar scan with a strict comparison
+    const uint8_t* first = memchr(values, max, count);
+
+    *max_value = max;
+    return (size_t)(first - values);
+}
+
+/**
+ * @brief Dequantize an array of quantized values as (value - zero_point) * scale.
+ *
+ * @param values     Quantized values.
+ * @param count      Number of values.
+ * @param zero_point Quantization zero point.
+ * @param scale      Quantization scale.
+ * @param output     Array of at least count floats receiving the dequantized values.
+ */
+KERNEL_INLINE void kernel_dequantize_u8(const uint8_t* values,
+                                        size_t count,
+                                        float zero_point,
+                                        float scale,
+                                        float* output) {
+    size_t i = 0;
+
+#ifdef KERNELS_USE_NEON
+    const float32x4_t zero_point_vec = vdupq_n_f32(zero_point);
+    for (; i + 4 <= count; i += 4) {
+        uint32_t packed;
+        memcpy(&packed, values + i, sizeof(packed));
+        uint16x8_t wide    = vmovl_u8(vreinterpret_u8_u32(vdup_n_u32(packed)));
+        float32x4_t floats = vcvtq_f32_u32(vmovl_u16(vget_low_u16(wide)));
+        vst1q_f32(output + i, vmulq_n_f32(vsubq_f32(floats, zero_point_vec), scale));
+    }
+#endif
+    for (; i < count; i++) {
+        output[i] = (values[i] - zero_point) * scale;
+    }
+}
@@ -17,38 +17,194 @@
 #include "model.h"
 
 #include "larod.h"
+#include "model_cache.h"
 #include "panic.h"
 
 #include <errno.h>
 #include <fcntl.h>
-#include <math.h>
 #include <stdio.h>
 #include <string.h>
 #include <sys/mman.h>
 #include <syslog.h>
 #include <unistd.h>
 
-bool model_get_tensor_output_info(model_provider_t* provider,
-                                  unsigned int tensor_output_index,
-                                  model_tensor_output_t* tensor_output) {
+#define MODEL_CACHE_APP_NAME "object_detection_yolov5"
+
+bool model_get_job_output_info(model_provider_t* provider,
+                               unsigned int job_index,
+                               unsigned int tensor_output_index,
+                               model_tensor_output_t* tensor_output) {
+    if (job_index >= provider->num_jobs) {
+        panic("%s: Invalid job index %u", __func__, job_index);
+    }
     if (tensor_output_index > (provider->num_outputs)) {
         panic("%s: Invalid output index %u", __func__, tensor_output_index);
     }
-    *tensor_output = provider->model_output_tensors[tensor_output_index];
+    *tensor_output = provider->jobs[job_index].model_output_tensors[tensor_output_index];
     return true;
 }
 
-bool model_run_preprocessing(model_provider_t* provider, VdoBuffer* vdo_buf) {
+bool model_get_tensor_output_info(model_provider_t* provider,
+                                  unsigned int tensor_output_index,
+                                  model_tensor_output_t* tensor_output) {
+    return model_get_job_output_info(provider, 0, tensor_output_index, tensor_output);
+}
+
+/**
+ * @brief Create an input tensor referring to the memory of a VDO buffer and track it in larod.
+ *
+ * Tracking lets larod keep the mapping of the buffer between jobs, so the frames in it are used
+ * by the preprocessing or inference without any copy.
+ */
+static larodTensor** track_image_buffer(model_provider_t* provider, VdoBuffer* vdo_buf) {
+    larodError* error = NULL;
+
+    if (provider->num_image_tensors == MAX_NBR_IMG_PROVIDER_BUFFERS) {
+        panic("%s: More than %d VDO buffers received", __func__, MAX_NBR_IMG_PROVIDER_BUFFERS);
+    }
+    size_t idx = provider->num_image_tensors;
+
+    larodTensor** tensors = larodCreateTensors(1, &error);
+    if (!tensors) {
+        panic("%s: Failed to create image tensor: %s", __func__, error->msg);
+    }
+    if (!larodSetTensorDataType(tensors[0], LAROD_TENSOR_DATA_TYPE_UINT8, &error)) {
+        panic("%s: Failed to set data type: %s", __func__, error->msg);
+    }
+    if (!larodSetTensorLayout(tensors[0], provider->image_layout, &error)) {
+        panic("%s: Failed to set tensor layout: %s", __func__, error->msg);
+    }
+    if (!larodBuildTensorDims(tensors[0],
+                              provider->image_layout,
+                              provider->image_width,
+                              provider->image_height,
+                              3,
+                              &error)) {
+        panic("%s: Failed to build tensor dims: %s", __func__, error->msg);
+    }
+    if (!larodBuildTensorPitches(tensors[0],
+                                 provider->image_layout,
+                                 provider->image_pitch,
+                                 provider->image_height,
+                                 3,
+                                 &error)) {
+        panic("%s: Failed to build tensor pitches: %s", __func__, error->msg);
+    }
+    if (!larodSetTensorFdProps(tensors[0], LAROD_FD_PROP_MAP | LAROD_FD_PROP_DMABUF, &error)) {
+        panic("%s: Failed to set fd props: %s", __func__, error->msg);
+    }
+
+    int vdo_buf_fd         = vdo_buffer_get_fd(vdo_buf);
+    int64_t vdo_buf_offset = vdo_buffer_get_offset(vdo_buf);
+    int64_t tensor_offset  = vdo_buf_offset;
+    int tensor_fd          = -1;
+    if (provider->image_dmabuf) {
+        // The tensor owns its fd so it stays valid as long as the tensor exists
+        tensor_fd = dup(vdo_buf_fd);
+        if (tensor_fd < 0) {
+            panic("%s: Failed to dup fd: %s", __func__, strerror(errno));
+        }
+    } else {
+        tensor_fd = larodConvertVmemFdToDmabuf(vdo_buf_fd, vdo_buf_offset, &error);
+        if (tensor_fd == LAROD_INVALID_FD) {
+            panic("%s: Failed to convert vmem fd to dma-buf: %s", __func__, error->msg);
+        }
+        tensor_offset = 0;
+    }
+    if (!larodSetTensorFd(tensors[0], tensor_fd, &error)) {
+        panic("%s: Failed to set fd for tensor: %s", __func__, error->msg);
+    }
+    if (!larodSetTensorFdOffset(tensors[0], tensor_offset, &error)) {
+        panic("%s: Failed to set offset for tensor: %s", __func__, error->msg);
+    }
+    if (!larodSetTensorFdSize(tensors[0], vdo_buffer_get_capacity(vdo_buf), &error)) {
+        panic("%s: Failed to set size for tensor: %s", __func__, error->msg);
+    }
+    if (!larodTrackTensor(provider->conn, tensors[0], &error)) {
+        panic("%s: Failed to track tensor: %s", __func__, error->msg);
+    }
+
+    provider->image_tensors[idx]        = tensors;
+    provider->image_buffer_fds[idx]     = vdo_buf_fd;
+    provider->image_buffer_offsets[idx] = vdo_buf_offset;
+    provider->image_tensor_fds[idx]     = tensor_fd;
+    provider->num_image_tensors++;
+    syslog(LOG_INFO, "Tracking VDO buffer %zu as larod input tensor", idx);
+
+    return tensors;
+}
+
+static larodTensor** get_image_tensors(model_provider_t* provider, VdoBuffer* vdo_buf) {
+    int vdo_buf_fd = vdo_buffer_get_fd(vdo_buf);
+    if (vdo_buf_fd < 0) {
+        panic("%s: fd from vdo_buffer_get_fd is negative", __func__);
+    }
+    int64_t vdo_buf_offset = vdo_buffer_get_offset(vdo_buf);
+
+    // Several vmem buffers may share one fd, so the offset is part of the identity
+    for (size_t i = 0; i < provider->num_image_tensors; i++) {
+        if (provider->image_buffer_fds[i] == vdo_buf_fd &&
+            provider->image_buffer_offsets[i] == vdo_buf_offset) {
+            return provider->image_tensors[i];
+        }
+    }
+    return track_image_buffer(provider, vdo_buf);
+}
+
+/**
+ * @brief Use the tracked tensor of a VDO buffer as input to the first job request of a job.
+ *
+ * The input job request is created here the first time since larod needs the input tensors
+ * when the request is created.
+ */
+static void set_job_input(model_provider_t* provider, model_job_t* job, VdoBuffer* vdo_buf) {
     larodError* error            = NULL;
-    static int nbr_power_retries = 0;
+    larodTensor** input_tensors  = get_image_tensors(provider, vdo_buf);
+    larodJobRequest** input_req  = &job->inf_req;
+    larodModel* input_model      = provider->model;
+    larodTensor** output_tensors = job->output_tensors;
+    size_t num_outputs           = provider->num_outputs;
+    larodMap* params             = NULL;
+
+    if (provider->use_preprocessing) {
+        input_req      = &job->pp_req;
+        input_model    = provider->pp_model;
+        output_tensors = job->pp_output_tensors;
+        num_outputs    = provider->pp_num_outputs;
+        params         = job->crop_map ? job->crop_map : provider->crop_map;
+    }
+
+    if (*input_req) {
+        if (!larodSetJobRequestInputs(*input_req, input_tensors, 1, &error)) {
+            panic("%s: Failed to set input job request: %s", __func__, error->msg);
+        }
+        return;
+    }
+    *input_req = larodCreateJobRequest(input_model,
+                                       input_tensors,
+                                       1,
+                                       output_tensors,
+                                       num_outputs,
+                                       params,
+                                       &error);
+    if (!*input_req) {
+        panic("%s: Failed creating input job request: %s", __func__, error->msg);
+    }
+}
+
+bool model_run_preprocessing(model_provider_t* provider, VdoBuffer* vdo_buf) {
+    larodError* error = NULL;
+    model_job_t* job  = &provider->jobs[0];
 
     if (!provider->use_preprocessing) {
         return true;
     }
-    uint8_t* data = vdo_buffer_get_data(vdo_buf);
+    if (!power_backoff_ready(&provider->power_backoff)) {
+        return false;
+    }
+    set_job_input(provider, job, vdo_buf);
 
-    memcpy(provider->image_input_addr, data, provider->image_buffer_size);
-    if (!larodRunJob(provider->conn, provider->pp_req, &error)) {
+    if (!larodRunJob(provider->conn, job->pp_req, &error)) {
         if (error->code != LAROD_ERROR_POWER_NOT_AVAILABLE) {
             panic("%s: Unable to run preprocessing job: %s (%d)",
                   __func__,
@@ -56,34 +212,25 @@ bool model_run_preprocessing(model_provider_t* provider, VdoBuffer* vdo_buf) {
                   error->code);
         }
         larodClearError(&error);
-        // Currently this will only happen when there is no power
-        //  Just a number but if no power available after 50 retries it is time to give up
-        if (nbr_power_retries == 50) {
-            panic("Still no power available when running larod job %u, giving up",
-                  nbr_power_retries);
-        }
-        syslog(LOG_INFO,
-               "No power available when running larod job, try nbr %u",
-               nbr_power_retries);
-        nbr_power_retries++;
-        usleep(250 * 1000 * nbr_power_retries);
+        power_backoff_failed(&provider->power_backoff);
         return false;
     }
-    nbr_power_retries = 0;
+    power_backoff_succeeded(&provider->power_backoff);
     return true;
 }
 
 bool model_run_inference(model_provider_t* provider, VdoBuffer* vdo_buf) {
-    larodError* error            = NULL;
-    static int nbr_power_retries = 0;
+    larodError* error = NULL;
+    model_job_t* job  = &provider->jobs[0];
 
     if (!provider->use_preprocessing) {
-        uint8_t* data = vdo_buffer_get_data(vdo_buf);
-
-        memcpy(provider->image_input_addr, data, provider->image_buffer_size);
+        if (!power_backoff_ready(&provider->power_backoff)) {
+            return false;
+        }
+        set_job_input(provider, job, vdo_buf);
     }
 
-    if (!larodRunJob(provider->conn, provider->inf_req, &error)) {
+    if (!larodRunJob(provider->conn, job->inf_req, &error)) {
         if (error->code != LAROD_ERROR_POWER_NOT_AVAILABLE) {
             panic("%s: Unable to run inference on model: %s (%d)",
                   __func__,
@@ -91,63 +238,167 @@ bool model_run_inference(model_provider_t* provider, VdoBuffer* vdo_buf) {
                   error->code);
         }
         larodClearError(&error);
-        // Currently this will only happen when there is no power
-        //  Just a number but if no power available after 50 retries it is time to give up
-        if (nbr_power_retries == 50) {
-            panic("Still no power available when running larod job %u, giving up",
-                  nbr_power_retries);
-        }
-        syslog(LOG_INFO,
-               "No power available when running larod job, try nbr %u",
-               nbr_power_retries);
-        nbr_power_retries++;
-        usleep(250 * 1000 * nbr_power_retries);
+        power_backoff_failed(&provider->power_backoff);
         return false;
     }
-    nbr_power_retries = 0;
+    power_backoff_succeeded(&provider->power_backoff);
     return true;
 }
 
-static bool setup_input_tensor_metadata(unsigned int pitch,
-                                        unsigned int height,
-                                        larodTensorLayout model_layout,
-                                        larodTensor* tensor) {
-    larodError* error          = NULL;
-    larodTensorPitches pitches = {0};
-
-    // Update the pitch dependent on the layout used
-    switch (model_layout) {
-        case LAROD_TENSOR_LAYOUT_420SP:
-            pitches.len        = 3;
-            pitches.pitches[2] = pitch;
-            pitches.pitches[1] = height * pitches.pitches[2];
-            pitches.pitches[0] = 3 * pitches.pitches[1] / 2;
-            break;
-        case LAROD_TENSOR_LAYOUT_NHWC:
-            pitches.len        = 4;
-            pitches.pitches[3] = 3;
-            pitches.pitches[2] = pitch;
-            pitches.pitches[1] = height * pitches.pitches[2];
-            pitches.pitches[0] = 1 * pitches.pitches[1];
-            break;
-        case LAROD_TENSOR_LAYOUT_NCHW:
-            pitches.len        = 4;
-            pitches.pitches[3] = pitch;
-            pitches.pitches[2] = height * pitches.pitches[3];
-            pitches.pitches[1] = 3 * pitches.pitches[2];
-            pitches.pitches[0] = 1 * pitches.pitches[1];
-            break;
-        default:
-            break;
+static model_job_t* get_job(model_provider_t* provider, unsigned int job_index) {
+    if (job_index >= provider->num_jobs) {
+        panic("%s: Invalid job index %u", __func__, job_index);
+    }
+    return &provider->jobs[job_index];
+}
+
+/**
+ * @brief Mark an asynchronous job as finished and wake up the waiting thread.
+ *
+ * Called from the larod callback thread or directly if the job could not be started.
+ */
+static void finish_job(model_job_t* job, larodError* error) {
+    if (error && error->code != LAROD_ERROR_POWER_NOT_AVAILABLE) {
+        panic("%s: Unable to run larod job: %s (%d)", __func__, error->msg, error->code);
+    }
+
+    pthread_mutex_lock(&job->mutex);
+    job->error_code = error ? error->code : LAROD_ERROR_NONE;
+    job->finish_us  = g_get_monotonic_time();
+    job->running    = false;
+    pthread_cond_signal(&job->cond);
+    pthread_mutex_unlock(&job->mutex);
+}
+
+static void inference_done(void* user_data, larodError* error) {
+    finish_job(user_data, error);
+}
+
+static void run_inference_async(model_job_t* job) {
+    larodError* error = NULL;
+
+    if (!larodRunJobAsync(job->provider->conn, job->inf_req, inference_done, job, &error)) {
+        finish_job(job, error);
+        larodClearError(&error);
+    }
+}
+
+static void preprocessing_done(void* user_data, larodError* error) {
+    model_job_t* job = user_data;
+
+    if (error) {
+        finish_job(job, error);
+        return;
+    }
+    // Chain the inference here, the two jobs run on different devices and larod does not
+    // keep the order between them
+    run_inference_async(job);
+}
+
+bool model_start_job(model_provider_t* provider, unsigned int job_index, VdoBuffer* vdo_buf) {
+    larodError* error = NULL;
+    model_job_t* job  = get_job(provider, job_index);
+
+    pthread_mutex_lock(&job->mutex);
+    if (job->running) {
+        panic("%s: Job %u is already running", __func__, job_index);
+    }
+    if (!power_backoff_ready(&provider->power_backoff)) {
+        // The job is not run, model_wait_job() returns false without waiting
+        job->skipped = true;
+        pthread_mutex_unlock(&job->mutex);
+        return false;
     }
+    job->running    = true;
+    job->error_code = LAROD_ERROR_NONE;
+    job->start_us   = g_get_monotonic_time();
+    pthread_mutex_unlock(&job->mutex);
 
-    if (!larodSetTensorPitches(tensor, &pitches, &error)) {
-        panic("%s: Failed to set tensor pitches: %s", __func__, error->msg);
+    set_job_input(provider, job, vdo_buf);
+
+    if (!provider->use_preprocessing) {
+        run_inference_async(job);
+        return true;
+    }
+    if (!larodRunJobAsync(provider->conn, job->pp_req, preprocessing_done, job, &error)) {
+        finish_job(job, error);
+        larodClearError(&error);
     }
+    return true;
+}
+
+void model_set_job_crop(model_provider_t* provider,
+                        unsigned int job_index,
+                        unsigned int x,
+                        unsigned int y,
+                        unsigned int width,
+                        unsigned int height) {
+    larodError* error = NULL;
+    model_job_t* job  = get_job(provider, job_index);
 
+    if (!provider->use_preprocessing) {
+        panic("%s: A crop needs preprocessing", __func__);
+    }
+    if (!job->crop_map) {
+        job->crop_map = larodCreateMap(&error);
+        if (!job->crop_map) {
+            panic("%s: Could not create crop larodMap: %s", __func__, error->msg);
+        }
+    }
+    if (!larodMapSetIntArr4(job->crop_map, "image.input.crop", x, y, width, height, &error)) {
+        panic("%s: Failed setting crop: %s", __func__, error->msg);
+    }
+    // The map is copied into the job request, so an existing request is updated
+    if (job->pp_req && !larodSetJobRequestParams(job->pp_req, job->crop_map, &error)) {
+        panic("%s: Failed setting crop of job request: %s", __func__, error->msg);
+    }
+}
+
+bool model_wait_job(model_provider_t* provider, unsigned int job_index) {
+    model_job_t* job = get_job(provider, job_index);
+
+    pthread_mutex_lock(&job->mutex);
+    while (job->running) {
+        pthread_cond_wait(&job->cond, &job->mutex);
+    }
+    larodErrorCode error_code = job->error_code;
+    bool skipped              = job->skipped;
+    job->skipped              = false;
+    pthread_mutex_unlock(&job->mutex);
+
+    if (skipped) {
+        return false;
+    }
+    if (error_code == LAROD_ERROR_POWER_NOT_AVAILABLE) {
+        power_backoff_failed(&provider->power_backoff);
+        return false;
+    }
+    power_backoff_succeeded(&provider->power_backoff);
     return true;
 }
 
+uint64_t model_job_latency_us(model_provider_t* provider, unsigned int job_index) {
+    model_job_t* job = get_job(provider, job_index);
+
+    pthread_mutex_lock(&job->mutex);
+    gint64 latency_us = job->finish_us - job->start_us;
+    pthread_mutex_unlock(&job->mutex);
+    return (uint64_t)latency_us;
+}
+
+static larodTensorLayout get_image_layout(VdoFormat format) {
+    switch (format) {
+        case VDO_FORMAT_YUV:
+            return LAROD_TENSOR_LAYOUT_420SP;
+        case VDO_FORMAT_RGB:
+            return LAROD_TENSOR_LAYOUT_NHWC;
+        case VDO_FORMAT_PLANAR_RGB:
+            return LAROD_TENSOR_LAYOUT_NCHW;
+        default:
+            panic("%s: Tensor layout unspecified for format %u", __func__, format);
+    }
+}
+
 static void setup_tensors(larodConnection* conn,
                           larodModel* model,
                           larodTensor*** input_tensors,
@@ -156,9 +407,12 @@ static void setup_tensors(larodConnection* conn,
                           size_t* num_outputs) {
     larodError* error = NULL;
 
-    *input_tensors = larodAllocModelInputs(conn, model, 0, num_inputs, NULL, &error);
-    if (!*input_tensors) {
-        panic("%s: Failed retrieving input tensors: %s", __func__, error->msg);
+    // The input tensors are optional since the inputs of a job normally are the VDO buffers
+    if (input_tensors) {
+        *input_tensors = larodAllocModelInputs(conn, model, 0, num_inputs, NULL, &error);
+        if (!*input_tensors) {
+            panic("%s: Failed retrieving input tensors: %s", __func__, error->msg);
+        }
     }
     *output_tensors = larodAllocModelOutputs(conn, model, 0, num_outputs, NULL, &error);
     if (!*output_tensors) {
@@ -178,13 +432,31 @@ create_inference_model(model_provider_t* provider, char* model_file, char* devic
 
     syslog(LOG_INFO, "Setting up larod connection with device %s", device_name);
     const larodDevice* device = larodGetDevice(provider->conn, device_name, 0, &error);
+    // A model compiled by an earlier run of the application is used if larod still has it
+    char cache_name[MODEL_CACHE_NAME_SIZE];
+    bool use_cache = model_cache_name(MODEL_CACHE_APP_NAME,
+                                      provider->larod_model_fd,
+                                      device_name,
+                                      cache_name,
+                                      sizeof(cache_name));
+    if (use_cache) {
+        larodModel* cached =
+            model_cache_lookup(provider->conn, MODEL_CACHE_APP_NAME, device_name, cache_name);
+        if (cached) {
+            syslog(LOG_INFO, "Using cached model %s", cache_name);
+            return cached;
+        }
+    }
+    larodAccess access     = use_cache ? LAROD_ACCESS_PUBLIC : LAROD_ACCESS_PRIVATE;
+    const char* model_name = use_cache ? cache_name : "object_detection";
+
     syslog(LOG_INFO,
            "Loading the model... This might take up to 5 minutes depending on your device model.");
     larodModel* model = larodLoadModel(provider->conn,
                                        provider->larod_model_fd,
                                        device,
-                                       LAROD_ACCESS_PRIVATE,
-                                       "object_detection",
+                                       access,
+                                       model_name,
                                        NULL,
                                        &error);
     if (!model && error->code != LAROD_ERROR_POWER_NOT_AVAILABLE) {
@@ -197,8 +469,8 @@ create_inference_model(model_provider_t* provider, char* model_file, char* devic
         model = larodLoadModel(provider->conn,
                                provider->larod_model_fd,
                                device,
-                               LAROD_ACCESS_PRIVATE,
-                               "object_detection",
+                               access,
+                               model_name,
                                NULL,
                                &error);
         // Sleep between retries
@@ -337,54 +609,169 @@ static larodModel* create_preprocessing_model(model_provider_t* provider,
     return model;
 }
 
+static void destroy_job(model_provider_t* provider, model_job_t* job) {
+    larodError* error = NULL;
+
+    for (size_t i = 0; job->model_output_tensors && i < provider->num_outputs; i++) {
+        if (job->model_output_tensors[i].data != MAP_FAILED) {
+            munmap(job->model_output_tensors[i].data, job->model_output_tensors[i].size);
+        }
+
+        if (job->model_output_tensors[i].fd >= 0) {
+            close(job->model_output_tensors[i].fd);
+        }
+    }
+    free(job->model_output_tensors);
+
+    larodDestroyTensors(provider->conn,
+                        &job->pp_output_tensors,
+                        provider->pp_num_outputs,
+                        &error);
+    larodDestroyTensors(provider->conn, &job->output_tensors, provider->num_outputs, &error);
+
+    larodDestroyJobRequest(&(job->pp_req));
+    larodDestroyJobRequest(&(job->inf_req));
+    larodDestroyMap(&job->crop_map);
+
+    pthread_cond_destroy(&job->cond);
+    pthread_mutex_destroy(&job->mutex);
+}
+
 void destroy_model_provider(model_provider_t* provider) {
     larodError* error = NULL;
     if (!provider) {
         panic("%s: Invalid pointer to model_provider_t", __func__);
     }
 
-    // Only the model handle is released here. We count on larod service to
-    // release the privately loaded model when the session is disconnected in
+    // Make sure that no callback is running when the jobs are destroyed
+    for (unsigned int i = 0; i < provider->num_jobs; i++) {
+        model_job_t* job = &provider->jobs[i];
+        pthread_mutex_lock(&job->mutex);
+        while (job->running) {
+            pthread_cond_wait(&job->cond, &job->mutex);
+        }
+        pthread_mutex_unlock(&job->mutex);
+    }
+
+    larodDestroyModel(&provider->pp_model);
+    larodDestroyModel(&provider->model);
+    larodDestroyMap(&provider->crop_map);
+    // Only the model handles are released here. The inference model is loaded
+    // public, see model_cache.h, so larod keeps it for the next start. The
+    // private models, the preprocessing model and an inference model that could
+    // not be cached, are released by larod when the session is disconnected in
     // larodDisconnect().
     larodDisconnect(&(provider->conn), NULL);
 
     if (provider->larod_model_fd >= 0) {
         close(provider->larod_model_fd);
     }
-    if (provider->image_input_addr != MAP_FAILED) {
-        munmap(provider->image_input_addr, provider->image_buffer_size);
+    for (unsigned int i = 0; i < provider->num_jobs; i++) {
+        destroy_job(provider, &provider->jobs[i]);
     }
-    if (provider->image_input_fd >= 0) {
-        close(provider->image_input_fd);
+    for (size_t i = 0; i < provider->num_image_tensors; i++) {
+        larodDestroyTensors(provider->conn, &provider->image_tensors[i], 1, &error);
+        close(provider->image_tensor_fds[i]);
+    }
+
+    free(provider);
+}
+
+static void map_output_tensors(model_provider_t* provider, model_job_t* job) {
+    larodError* error = NULL;
+
+    job->model_output_tensors = calloc(provider->num_outputs, sizeof(model_tensor_output_t));
+    if (!job->model_output_tensors) {
+        panic("%s: Unable to allocate model output tensors: %s", __func__, strerror(errno));
     }
+    // To be able to get the data from the output tensors get the fd and mmap the memory
     for (size_t i = 0; i < provider->num_outputs; i++) {
-        if (provider->model_output_tensors[i].data != MAP_FAILED) {
-            munmap(provider->model_output_tensors[i].data, provider->model_output_tensors[i].size);
+        int fd = larodGetTensorFd(job->output_tensors[i], &error);
+        if (fd == LAROD_INVALID_FD) {
+            panic("%s: Could not get tensor fd: %s", __func__, error->msg);
         }
+        size_t output_size           = 0;
+        void* data                   = NULL;
+        larodTensorDataType datatype = LAROD_TENSOR_DATA_TYPE_INVALID;
 
-        if (provider->model_output_tensors[i].fd >= 0) {
-            close(provider->model_output_tensors[i].fd);
+        job->model_output_tensors[i].fd = fd;
+        if (!larodGetTensorFdSize(job->output_tensors[i], &output_size, &error)) {
+            panic("%s: Could not get byte size of tensor: %s", __func__, error->msg);
+        }
+        job->model_output_tensors[i].size = output_size;
+        data = mmap(NULL, output_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (data == MAP_FAILED) {
+            panic("%s: Could not map inference output tensors fd: %s", __func__, strerror(errno));
+        }
+        job->model_output_tensors[i].data = data;
+        datatype = larodGetTensorDataType(job->output_tensors[i], &error);
+        if (datatype == LAROD_TENSOR_DATA_TYPE_INVALID) {
+            panic("%s: Could not get output tensor data type: %s", __func__, error->msg);
         }
+        job->model_output_tensors[i].datatype = datatype;
+        syslog(LOG_INFO, "Created mmaped model output %zu with size %zu", i, output_size);
     }
-    if (provider->model_output_tensors) {
-        free(provider->model_output_tensors);
+}
+
+/**
+ * @brief Allocate the output tensors and create the job requests of one job.
+ *
+ * The inference outputs of the first job are allocated before this is called since they are
+ * needed to validate the model. The job request taking a VDO buffer as input is created when the
+ * first frame is set, see set_job_input().
+ */
+static void setup_job(model_provider_t* provider, model_job_t* job) {
+    larodError* error = NULL;
+
+    job->provider   = provider;
+    job->running    = false;
+    job->error_code = LAROD_ERROR_NONE;
+    if (pthread_mutex_init(&job->mutex, NULL)) {
+        panic("%s: Unable to initialize job mutex", __func__);
+    }
+    if (pthread_cond_init(&job->cond, NULL)) {
+        panic("%s: Unable to initialize job condition", __func__);
     }
 
-    larodDestroyTensors(provider->conn,
-                        &provider->pp_input_tensors,
-                        provider->pp_num_inputs,
-                        &error);
-    larodDestroyTensors(provider->conn,
-                        &provider->pp_output_tensors,
-                        provider->pp_num_outputs,
-                        &error);
-    larodDestroyTensors(provider->conn, &provider->input_tensors, provider->num_inputs, &error);
-    larodDestroyTensors(provider->conn, &provider->output_tensors, provider->num_outputs, &error);
+    if (!job->output_tensors) {
+        size_t num_outputs = 0;
+        setup_tensors(provider->conn,
+                      provider->model,
+                      NULL,
+                      NULL,
+                      &job->output_tensors,
+                      &num_outputs);
+    }
+
+    if (provider->use_preprocessing) {
+        setup_tensors(provider->conn,
+                      provider->pp_model,
+                      NULL,
+                      NULL,
+                      &job->pp_output_tensors,
+                      &provider->pp_num_outputs);
+        if (provider->pp_num_outputs > 1) {
+            panic("%s Currently only 1 pp output tensor is supported but %zu was received",
+                  __func__,
+                  provider->pp_num_outputs);
+        }
+    }
 
-    larodDestroyJobRequest(&(provider->pp_req));
-    larodDestroyJobRequest(&(provider->inf_req));
+    map_output_tensors(provider, job);
 
-    free(provider);
+    if (provider->use_preprocessing) {
+        // App supports only one input/output tensor.
+        job->inf_req = larodCreateJobRequest(provider->model,
+                                             job->pp_output_tensors,
+                                             provider->pp_num_outputs,
+                                             job->output_tensors,
+                                             provider->num_outputs,
+                                             NULL,
+                                             &error);
+        if (!job->inf_req) {
+            panic("%s: Failed creating inference job request: %s", __func__, error->msg);
+        }
+    }
 }
 
 model_provider_t* create_model_provider(unsigned int input_width,
@@ -393,11 +780,17 @@ model_provider_t* create_model_provider(unsigned int input_width,
                                         unsigned int stream_height,
                                         unsigned int stream_pitch,
                                         VdoFormat image_format,
+                                        bool image_dmabuf,
                                         VdoFormat model_format,
                                         char* model_file,
                                         char* device_name,
                                         bool allow_input_crop,
+                                        unsigned int num_jobs,
                                         size_t* num_output_tensors) {
+    if (num_jobs == 0 || num_jobs > MODEL_MAX_NBR_JOBS) {
+        panic("%s: Invalid number of jobs %u", __func__, num_jobs);
+    }
+
     model_provider_t* provider = calloc(1, sizeof(model_provider_t));
     if (!provider) {
         panic("%s: Unable to allocate model_provider_t: %s", __func__, strerror(errno));
@@ -409,14 +802,22 @@ model_provider_t* create_model_provider(unsigned int input_width,
         panic("%s: Could not connect to larod: %s", __func__, error->msg);
     }
 
-    provider->crop_map   = NULL;
-    larodModel* pp_model = NULL;
-    larodModel* model    = create_inference_model(provider, model_file, device_name);
+    provider->num_jobs     = num_jobs;
+    provider->crop_map     = NULL;
+    provider->pp_model     = NULL;
+    provider->model        = create_inference_model(provider, model_file, device_name);
+    provider->image_layout = get_image_layout(image_format);
+    provider->image_width  = stream_width;
+    provider->image_height = stream_height;
+    provider->image_pitch  = stream_pitch;
+    provider->image_dmabuf = image_dmabuf;
+
+    larodTensor** input_tensors = NULL;
     setup_tensors(provider->conn,
-                  model,
-                  &provider->input_tensors,
+                  provider->model,
+                  &input_tensors,
                   &provider->num_inputs,
-                  &provider->output_tensors,
+                  &provider->jobs[0].output_tensors,
                   &provider->num_outputs);
     if (provider->num_inputs > 1) {
         panic("%s Currently only 1 input tensor is supported but %zu was received",
@@ -424,21 +825,18 @@ model_provider_t* create_model_provider(unsigned int input_width,
               provider->num_inputs);
     }
 
-    const larodTensorDims* input_dims = larodGetTensorDims(provider->input_tensors[0], &error);
+    const larodTensorDims* input_dims = larodGetTensorDims(input_tensors[0], &error);
     if (!input_dims) {
         panic("%s: Failed retrieving dim for input tensor: %s", __func__, error->msg);
     }
     uint32_t expected_input_width  = 0;
     uint32_t expected_input_height = 0;
-    larodTensorLayout model_layout = LAROD_TENSOR_LAYOUT_UNSPECIFIED;
     if (model_format == VDO_FORMAT_RGB) {
         expected_input_width  = input_dims->dims[2];
         expected_input_height = input_dims->dims[1];
-        model_layout          = LAROD_TENSOR_LAYOUT_NHWC;
     } else if (model_format == VDO_FORMAT_PLANAR_RGB) {
         expected_input_width  = input_dims->dims[3];
         expected_input_height = input_dims->dims[2];
-        model_layout          = LAROD_TENSOR_LAYOUT_NCHW;
     } else {
         panic("%s Invalid model format %u", __func__, model_format);
     }
@@ -450,8 +848,7 @@ model_provider_t* create_model_provider(unsigned int input_width,
               expected_input_width,
               expected_input_height);
     }
-    const larodTensorPitches* input_pitches =
-        larodGetTensorPitches(provider->input_tensors[0], &error);
+    const larodTensorPitches* input_pitches = larodGetTensorPitches(input_tensors[0], &error);
     if (!input_pitches) {
         panic("%s: Failed retrieving pitches for input tensor: %s", __func__, error->msg);
     }
@@ -471,158 +868,34 @@ model_provider_t* create_model_provider(unsigned int input_width,
     }
 
     if (provider->use_preprocessing) {
-        pp_model = create_preprocessing_model(provider,
-                                              device_name,
-                                              allow_input_crop,
-                                              image_format,
-                                              model_format,
-                                              input_width,
-                                              input_height,
-                                              expected_input_pitch,
-                                              stream_width,
-                                              stream_pitch,
-                                              stream_height);
-        setup_tensors(provider->conn,
-                      pp_model,
-                      &provider->pp_input_tensors,
-                      &provider->pp_num_inputs,
-                      &provider->pp_output_tensors,
-                      &provider->pp_num_outputs);
-        if (provider->pp_num_inputs > 1) {
+        provider->pp_model = create_preprocessing_model(provider,
+                                                        device_name,
+                                                        allow_input_crop,
+                                                        image_format,
+                                                        model_format,
+                                                        input_width,
+                                                        input_height,
+                                                        expected_input_pitch,
+                                                        stream_width,
+                                                        stream_pitch,
+                                                        stream_height);
+        provider->pp_num_inputs = larodGetModelNumInputs(provider->pp_model, &error);
+        if (provider->pp_num_inputs != 1) {
             panic("%s Currently only 1 pp input tensor is supported but %zu was received",
                   __func__,
                   provider->pp_num_inputs);
         }
-        if (provider->pp_num_outputs > 1) {
-            panic("%s Currently only 1 pp output tensor is supported but %zu was received",
-                  __func__,
-                  provider->pp_num_outputs);
-        }
-
-        // Needed to be used for copying data
-        // No need to setup input tensor metadata since it will all be handled by the map
-        // that is setup in the create_preprocessing_model function.
-        provider->image_input_fd = larodGetTensorFd(provider->pp_input_tensors[0], &error);
-        if (provider->image_input_fd != LAROD_INVALID_FD) {
-            // Determine tensor buffer sizes
-            if (!larodGetTensorFdSize(provider->pp_input_tensors[0],
-                                      &provider->image_buffer_size,
-                                      &error)) {
-                panic("%s: Could not get byte size of tensor: %s", __func__, error->msg);
-            }
-            provider->image_input_addr = mmap(NULL,
-                                              provider->image_buffer_size,
-                                              PROT_READ | PROT_WRITE,
-                                              MAP_SHARED,
-                                              provider->image_input_fd,
-                                              0);
-            if (provider->image_input_addr == MAP_FAILED) {
-                panic("%s: Could not map pp input tensors fd: %s", __func__, strerror(errno));
-            }
-        }
-    } else {
-        if (expected_input_pitch != stream_pitch) {
-            panic("%s: Incorrect stream pitch %u != %u",
-                  __func__,
-                  stream_pitch,
-                  expected_input_pitch);
-        }
-        setup_input_tensor_metadata(stream_pitch,
-                                    stream_height,
-                                    model_layout,
-                                    provider->input_tensors[0]);
-        // Needed to be used for copying data
-        provider->image_input_fd = larodGetTensorFd(provider->input_tensors[0], &error);
-        if (provider->image_input_fd != LAROD_INVALID_FD) {
-            // Determine tensor buffer sizes
-            if (!larodGetTensorFdSize(provider->input_tensors[0],
-                                      &provider->image_buffer_size,
-                                      &error)) {
-                panic("%s: Could not get byte size of tensor: %s", __func__, error->msg);
-            }
-            provider->image_input_addr = mmap(NULL,
-                                              provider->image_buffer_size,
-                                              PROT_READ | PROT_WRITE,
-                                              MAP_SHARED,
-                                              provider->image_input_fd,
-                                              0);
-            if (provider->image_input_addr == MAP_FAILED) {
-                panic("%s: Could not map input tensors fd: %s", __func__, strerror(errno));
-            }
-        }
+    } else if (expected_input_pitch != stream_pitch) {
+        panic("%s: Incorrect stream pitch %u != %u", __func__, stream_pitch, expected_input_pitch);
     }
+    // The model inputs were only needed for validation, the VDO buffers are used as inputs
+    larodDestroyTensors(provider->conn, &input_tensors, provider->num_inputs, &error);
 
-    provider->model_output_tensors = calloc(provider->num_outputs, sizeof(model_tensor_output_t));
-    // To be able to get the data from the output tensors get the fd and mmap the memory
-    for (size_t i = 0; i < provider->num_outputs; i++) {
-        int fd = larodGetTensorFd(provider->output_tensors[i], &error);
-        if (fd == LAROD_INVALID_FD) {
-            panic("%s: Could not get tensor fd: %s", __func__, error->msg);
-        }
-        size_t output_size           = 0;
-        void* data                   = NULL;
-        larodTensorDataType datatype = LAROD_TENSOR_DATA_TYPE_INVALID;
-
-        provider->model_output_tensors[i].fd = fd;
-        if (!larodGetTensorFdSize(provider->output_tensors[i], &output_size, &error)) {
-            panic("%s: Could not get byte size of tensor: %s", __func__, error->msg);
-        }
-        provider->model_output_tensors[i].size = output_size;
-        data = mmap(NULL, output_size, PROT_READ, MAP_SHARED, fd, 0);
-        if (data == MAP_FAILED) {
-            panic("%s: Could not map inference output tensors fd: %s", __func__, strerror(errno));
-        }
-        provider->model_output_tensors[i].data = data;
-        datatype = larodGetTensorDataType(provider->output_tensors[i], &error);
-        if (datatype == LAROD_TENSOR_DATA_TYPE_INVALID) {
-            panic("%s: Could not get output tensor data type: %s", __func__, error->msg);
-        }
-        provider->model_output_tensors[i].datatype = datatype;
-        syslog(LOG_INFO, "Created mmaped model output %zu with size %zu", i, output_size);
-    }
-
-    if (provider->use_preprocessing) {
-        // Create job requests
-        provider->pp_req = larodCreateJobRequest(pp_model,
-                                                 provider->pp_input_tensors,
-                                                 provider->pp_num_inputs,
-                                                 provider->pp_output_tensors,
-                                                 provider->pp_num_outputs,
-                                                 provider->crop_map,
-                                                 &error);
-        if (!provider->pp_req) {
-            panic("%s: Failed creating preprocessing job request: %s", __func__, error->msg);
-        }
-        larodDestroyMap(&provider->crop_map);
-
-        // App supports only one input/output tensor.
-        provider->inf_req = larodCreateJobRequest(model,
-                                                  provider->pp_output_tensors,
-                                                  provider->pp_num_outputs,
-                                                  provider->output_tensors,
-                                                  provider->num_outputs,
-                                                  NULL,
-                                                  &error);
-        if (!provider->inf_req) {
-            panic("%s: Failed creating inference job request: %s", __func__, error->msg);
-        }
-    } else {
-        // App supports only one input/output tensor.
-        provider->inf_req = larodCreateJobRequest(model,
-                                                  provider->input_tensors,
-                                                  provider->num_inputs,
-                                                  provider->output_tensors,
-                                                  provider->num_outputs,
-                                                  NULL,
-                                                  &error);
-        if (!provider->inf_req) {
-            panic("%s: Failed creating inference job request: %s", __func__, error->msg);
-        }
+    for (unsigned int i = 0; i < num_jobs; i++) {
+        setup_job(provider, &provider->jobs[i]);
     }
 
     *num_output_tensors = provider->num_outputs;
-    larodDestroyModel(&pp_model);
-    larodDestroyModel(&model);
 
     return provider;
 }
@@ -16,7 +16,11 @@
 
 #pragma once
 
+#include <pthread.h>
+
+#include "imgprovider.h"
 #include "larod.h"
+#include "power_backoff.h"
 #include "vdo-buffer.h"
 #include "vdo-error.h"
 #include "vdo-frame.h"
@@ -29,30 +33,68 @@ typedef struct model_tensor_output {
     larodTensorDataType datatype;
 } model_tensor_output_t;
 
-typedef struct model_provider {
-    larodConnection* conn;
+// Number of jobs that can be in flight at the same time when running asynchronously
+#define MODEL_MAX_NBR_JOBS 8
+
+struct model_provider;
+
+typedef struct model_job {
     larodJobRequest* pp_req;
     larodJobRequest* inf_req;
 
-    larodTensor** pp_input_tensors;
-    size_t pp_num_inputs;
     larodTensor** pp_output_tensors;
+    larodTensor** output_tensors;
+
+    model_tensor_output_t* model_output_tensors;
+
+    // Crop of the preprocessing of this job, NULL to use the crop of the provider
+    larodMap* crop_map;
+
+    // State of an asynchronous run, protected by mutex
+    struct model_provider* provider;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    bool running;
+    // Set when the job was not started because of the power backoff
+    bool skipped;
+    larodErrorCode error_code;
+    // Monotonic times in us when the job was started and when larod finished it
+    gint64 start_us;
+    gint64 finish_us;
+} model_job_t;
+
+typedef struct model_provider {
+    larodConnection* conn;
+
+    size_t pp_num_inputs;
     size_t pp_num_outputs;
-    larodTensor** input_tensors;
     size_t num_inputs;
-    larodTensor** output_tensors;
     size_t num_outputs;
     larodMap* crop_map;
+    larodModel* model;
+    larodModel* pp_model;
 
-    size_t image_buffer_size;
-
-    int image_input_fd;
-    void* image_input_addr;
     int larod_model_fd;
 
     bool use_preprocessing;
 
-    model_tensor_output_t* model_output_tensors;
+    // The VDO buffers are used as input tensors without copying. Each buffer is tracked by
+    // larod the first time it is seen and the tensor is then reused for every frame in it.
+    larodTensorLayout image_layout;
+    unsigned int image_width;
+    unsigned int image_height;
+    unsigned int image_pitch;
+    bool image_dmabuf;
+    larodTensor** image_tensors[MAX_NBR_IMG_PROVIDER_BUFFERS];
+    int image_buffer_fds[MAX_NBR_IMG_PROVIDER_BUFFERS];
+    int64_t image_buffer_offsets[MAX_NBR_IMG_PROVIDER_BUFFERS];
+    int image_tensor_fds[MAX_NBR_IMG_PROVIDER_BUFFERS];
+    size_t num_image_tensors;
+
+    // Each job has its own set of tensors so that several frames can be in flight
+    model_job_t jobs[MODEL_MAX_NBR_JOBS];
+    unsigned int num_jobs;
+    power_backoff_t power_backoff;
 } model_provider_t;
 
 bool model_run_preprocessing(model_provider_t* provider, VdoBuffer* vdo_buf);
@@ -63,16 +105,43 @@ bool model_get_tensor_output_info(model_provider_t* provider,
                                   unsigned int tensor_output_index,
                                   model_tensor_output_t* tensor_output);
 
+// Set the frame as input of a job and start preprocessing and inference without
+// waiting for them to finish. The job must not already be running. Returns false if the job is
+// not started because of an earlier failure with no power, see power_backoff.h.
+bool model_start_job(model_provider_t* provider, unsigned int job_index, VdoBuffer* vdo_buf);
+
+// Wait for a started job to finish, returns false if there was no power to run it
+bool model_wait_job(model_provider_t* provider, unsigned int job_index);
+
+// Time from the start of a job until larod finished it, valid after model_wait_job() returned true
+uint64_t model_job_latency_us(model_provider_t* provider, unsigned int job_index);
+
+// Let the preprocessing of a job only use a part of the frame, given in stream pixels. This is
+// used to run the jobs on different tiles of the same frame. The job must not be running.
+void model_set_job_crop(model_provider_t* provider,
+                        unsigned int job_index,
+                        unsigned int x,
+                        unsigned int y,
+                        unsigned int width,
+                        unsigned int height);
+
+bool model_get_job_output_info(model_provider_t* provider,
+                               unsigned int job_index,
+                               unsigned int tensor_output_index,
+                               model_tensor_output_t* tensor_output);
+
 model_provider_t* create_model_provider(unsigned int input_width,
                                         unsigned int input_height,
                                         unsigned int stream_width,
                                         unsigned int stream_height,
                                         unsigned int stream_pitch,
                                         VdoFormat image_format,
+                                        bool image_dmabuf,
                                         VdoFormat model_format,
                                         char* model_file,
                                         char* device_name,
                                         bool allow_input_crop,
+                                        unsigned int num_jobs,
                                         size_t* num_output_tensors);
 
 void destroy_model_provider(model_provider_t* provider);
@@ -0,0 +1,91 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "model_cache.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <syslog.h>
+
+bool model_cache_name(const char* app_name,
+                      int model_fd,
+                      const char* device_name,
+                      char* name,
+                      size_t size) {
+    struct stat model_stat;
+    if (fstat(model_fd, &model_stat) != 0) {
+        syslog(LOG_WARNING, "%s: Unable to stat model file: %s", __func__, strerror(errno));
+        return false;
+    }
+    // A new version of the file gets another name even if it has the same size
+    int length = snprintf(name,
+                          size,
+                          "%s:%s:%lld:%lld:%llu",
+                          app_name,
+                          device_name,
+                          (long long)model_stat.st_size,
+                          (long long)model_stat.st_mtime,
+                          (unsigned long long)model_stat.st_ino);
+    return length > 0 && (size_t)length < size;
+}
+
+larodModel* model_cache_lookup(larodConnection* conn,
+                               const char* app_name,
+                               const char* device_name,
+                               const char* name) {
+    larodError* error  = NULL;
+    larodModel* cached = NULL;
+    size_t num_models  = 0;
+
+    larodModel** models = larodGetModels(conn, &num_models, &error);
+    if (!models) {
+        syslog(LOG_WARNING, "%s: Unable to list models: %s", __func__, error->msg);
+        larodClearError(&error);
+        return NULL;
+    }
+
+    char prefix[MODEL_CACHE_NAME_SIZE];
+    snprintf(prefix, sizeof(prefix), "%s:%s:", app_name, device_name);
+    for (size_t i = 0; i < num_models; i++) {
+        const char* model_name = larodGetModelName(models[i], &error);
+        if (!model_name) {
+            larodClearError(&error);
+            continue;
+        }
+        if (strncmp(model_name, prefix, strlen(prefix)) != 0) {
+            continue;
+        }
+        if (!cached && !strcmp(model_name, name)) {
+            // The list is freed below, so a new handle is made for the model
+            uint64_t id = larodGetModelId(models[i], &error);
+            cached      = larodGetModel(conn, id, &error);
+            if (!cached) {
+                syslog(LOG_WARNING, "%s: Unable to get model %s: %s", __func__, name, error->msg);
+                larodClearError(&error);
+            }
+            continue;
+        }
+        syslog(LOG_INFO, "Deleting stale cached model %s", model_name);
+        if (!larodDeleteModel(conn, models[i], &error)) {
+            syslog(LOG_WARNING, "%s: Unable to delete model: %s", __func__, error->msg);
+            larodClearError(&error);
+        }
+    }
+    larodDestroyModels(&models, num_models);
+    return cached;
+}
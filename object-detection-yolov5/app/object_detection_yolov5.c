@@ -31,222 +31,427 @@
  */
 
 #include "argparse.h"
+#include "detection_renderer.h"
 #include "imgprovider.h"
 #include "labelparse.h"
 #include "model.h"
 #include "model_params.h"  //Generated at build time
 #include "panic.h"
+#include "param_cache.h"
+#include "postprocessing.h"
+#include "stage_stats.h"
+#include "stats_endpoint.h"
+#include "stream_selector.h"
+#include "tensor_recording.h"
+#include "tiling.h"
+#include "tracker.h"
 #include "vdo-error.h"
 #include "vdo-frame.h"
 #include "vdo-types.h"
-#include <axsdk/axparameter.h>
-#include <bbox.h>
 
 #include <math.h>
 #include <signal.h>
 #include <stdio.h>
-#include <sys/time.h>
 #include <syslog.h>
 
 #define APP_NAME "object_detection_yolov5"
 
+// Measured preprocessing times of the streams, kept between runs
+#define STREAM_COST_CACHE "/usr/local/packages/" APP_NAME "/localdata/stream_costs.txt"
+
+// Boxes are only redrawn when an edge moves more than this, in model input pixels
+#define BBOX_TOLERANCE_PX 2.0f
+// Number of drawn boxes when MaxDetections does not limit the detections
+#define MAX_DRAWN_BOXES 100
+// Number of larod jobs in flight in pipelined mode, one running while the other is post-processed
+#define PIPELINE_NBR_JOBS 2
+// Share of the smaller of two boxes from different tiles that they must overlap to be merged
+#define TILE_MERGE_THRESHOLD 0.5f
+// A track is drawn from its second detection, and kept while it misses up to three in a row
+#define TRACKER_MIN_HITS   2
+#define TRACKER_MAX_MISSES 3
+// Minimum IoU of a detection and the predicted box of a track to follow the track
+#define TRACKER_IOU_THRESHOLD 0.3f
+
 volatile sig_atomic_t running = 1;
 
+// Latencies of the stages of the frame loop, served by the stats endpoint
+static stage_stats_t stage_stats;
+
+// Records the output tensors when the application is started with --record, NULL otherwise
+static tensor_recorder_t* recorder;
+
+// The parameters of the application, read in the frame loop without a D-Bus call
+static param_cache_t* param_cache;
+// Generation of the parameter snapshot that was last applied
+static unsigned int param_generation;
+
+// Follows the detections between frames and predicts the boxes of the frames without detection
+static tracker_t* tracker;
+static const tracker_params_t tracker_params = {TRACKER_MIN_HITS,
+                                                TRACKER_MAX_MISSES,
+                                                TRACKER_IOU_THRESHOLD};
+// Number of boxes the tracker and the renderer are sized for
+static size_t max_drawn_boxes;
+// The detection runs on every detection_interval frame, counted by frame_count
+static unsigned int detection_interval = 1;
+static unsigned int frame_count;
+
 static void shutdown(int status) {
     (void)status;
     running = 0;
 }
 
-typedef struct model_params {
-    int input_width;
-    int input_height;
-    float quantization_scale;
-    float quantization_zero_point;
-    int num_classes;
-    int num_detections;
-    int size_per_detection;
-} model_params_t;
-
-static int ax_parameter_get_int(AXParameter* handle, const char* name) {
-    gchar* str_value = NULL;
-    GError* error    = NULL;
-    int value;
-
-    // Get the value of the parameter
-    if (!ax_parameter_get(handle, name, &str_value, &error)) {
-        panic("%s", error->message);
+static void read_postprocessing_params(const param_snapshot_t* snapshot,
+                                       postprocessing_params_t* params) {
+    params->conf_threshold  = param_snapshot_get_int(snapshot, "ConfThresholdPercent") / 100.0;
+    params->iou_threshold   = param_snapshot_get_int(snapshot, "IouThresholdPercent") / 100.0;
+    params->class_aware_nms = param_snapshot_get_bool(snapshot, "ClassAwareNms");
+    params->max_detections  = (size_t)param_snapshot_get_int(snapshot, "MaxDetections");
+}
+
+static size_t drawn_boxes_of(const postprocessing_params_t* params) {
+    return params->max_detections > 0 ? params->max_detections : MAX_DRAWN_BOXES;
+}
+
+/**
+ * @brief Grow the tracker and the renderer when MaxDetections is raised.
+ *
+ * The tracker is recreated, so the tracks start over. They are never shrunk, since a lowered
+ * MaxDetections already limits the detections.
+ */
+static void reserve_drawn_boxes(detection_renderer_t* renderer, size_t max_boxes) {
+    if (max_boxes <= max_drawn_boxes) {
+        return;
     }
+    tracker_destroy(tracker);
+    tracker = tracker_create(max_boxes, &tracker_params);
+    if (!tracker) {
+        panic("%s: Could not create tracker", __func__);
+    }
+    detection_renderer_reserve(renderer, max_boxes);
+    max_drawn_boxes = max_boxes;
+    syslog(LOG_INFO, "Tracking and drawing up to %zu boxes", max_boxes);
+}
 
-    // Convert the parameter value to int
-    if (sscanf(str_value, "%d", &value) != 1) {
-        panic("Axparameter %s was not an int", name);
+/**
+ * @brief Apply the parameters that can change while running, if any has changed.
+ *
+ * Getting the snapshot is an atomic load, so this is done every frame. The parameters that
+ * decide the stream, the tiles and the larod jobs are only read at start.
+ */
+static void update_parameters(postprocessor_t* postprocessor,
+                              img_provider_t* image_provider,
+                              detection_renderer_t* renderer) {
+    const param_snapshot_t* snapshot = param_cache_snapshot(param_cache);
+    if (snapshot->generation == param_generation) {
+        return;
     }
+    param_generation = snapshot->generation;
+
+    postprocessing_params_t params = postprocessor->params;
+    read_postprocessing_params(snapshot, &params);
+    postprocessor_update_params(postprocessor, &params);
+    reserve_drawn_boxes(renderer, drawn_boxes_of(&params));
+    double latency_budget = param_snapshot_get_int(snapshot, "LatencyBudgetPercent") / 100.0;
+    img_provider_set_latency_budget(image_provider, latency_budget);
+    detection_interval = (unsigned int)param_snapshot_get_int(snapshot, "DetectionInterval");
+    syslog(LOG_INFO, "Applied parameters of generation %u", param_generation);
+}
 
-    syslog(LOG_INFO, "Axparameter %s: %s", name, str_value);
+/**
+ * @brief Fetch the next frame from VDO and time the wait for it.
+ */
+static VdoBuffer* get_frame(img_provider_t* image_provider) {
+    uint64_t start_us  = stage_timer_start();
+    VdoBuffer* vdo_buf = img_provider_get_frame(image_provider);
+    stage_timer_stop(&stage_stats, STAGE_CAPTURE_WAIT, start_us);
+    return vdo_buf;
+}
 
-    g_free(str_value);
+/**
+ * @brief Check if the detection runs on the next frame, all tracks are predicted one frame ahead.
+ *
+ * The tracks are predicted on every frame, so the drawn boxes move at the full frame rate also
+ * when the detection only runs on every DetectionInterval frame.
+ */
+static bool start_frame(void) {
+    tracker_predict(tracker);
+    return frame_count++ % detection_interval == 0;
+}
 
-    return value;
+/**
+ * @brief Draw the reported tracks of the tracker.
+ */
+static void render_tracks(detection_renderer_t* renderer) {
+    uint64_t start_us = stage_timer_start();
+    detection_renderer_draw_tracks(renderer, tracker);
+    stage_timer_stop(&stage_stats, STAGE_RENDER, start_us);
 }
 
-static bbox_t* setup_bbox(void) {
-    // Create box drawers
-    bbox_t* bbox = bbox_view_new(1u);
-    if (!bbox) {
-        panic("Failed to create box drawer");
+static void track_detections(const detection_t* detections,
+                             size_t num_detections,
+                             const label_table_t* labels,
+                             detection_renderer_t* renderer) {
+    for (size_t i = 0; i < num_detections; i++) {
+        const detection_t* detection = &detections[i];
+        const label_view_t label     = label_table_get(labels, (size_t)detection->label_idx);
+
+        // Log info about object
+        syslog(LOG_INFO,
+               "Object %zu: Label=%.*s, Object Likelihood=%.2f, Class Likelihood=%.2f, ",
+               i + 1,
+               (int)label.length,
+               label.data,
+               detection->object_likelihood,
+               detection->class_likelihood);
+        syslog(LOG_INFO,
+               "Bounding Box: [%.2f, %.2f, %.2f, %.2f]",
+               detection->x1,
+               detection->y1,
+               detection->x2,
+               detection->y2);
+
+        const tracker_detection_t input = {detection->x1,
+                                           detection->y1,
+                                           detection->x2,
+                                           detection->y2,
+                                           detection->object_likelihood,
+                                           detection->label_idx};
+        if (!tracker_add_detection(tracker, &input)) {
+            syslog(LOG_WARNING, "Too many boxes, object %zu is not tracked", i + 1);
+        }
     }
+    tracker_update(tracker);
 
-    bbox_clear(bbox);
-    const bbox_color_t red = bbox_color_from_rgb(0xff, 0x00, 0x00);
+    render_tracks(renderer);
+}
 
-    bbox_style_outline(bbox);   // Switch to outline style
-    bbox_thickness_thin(bbox);  // Switch to thin lines
-    bbox_color(bbox, red);      // Switch to red
+static void draw_detections(postprocessor_t* postprocessor,
+                            uint8_t* tensor_data,
+                            const label_table_t* labels,
+                            detection_renderer_t* renderer) {
+    tensor_recorder_write(recorder, tensor_data);
 
-    return bbox;
-}
+    // Parse the output
+    const detection_t* detections = NULL;
+    uint64_t start_us             = stage_timer_start();
+    size_t num_detections = postprocessor_run(postprocessor, tensor_data, &detections);
+    uint64_t parsing_us   = stage_timer_stop(&stage_stats, STAGE_POSTPROCESSING, start_us);
+    syslog(LOG_INFO, "Ran parsing for %llu ms", (unsigned long long)(parsing_us / 1000));
 
-static unsigned int elapsed_ms(struct timeval* start_ts, struct timeval* end_ts) {
-    return (unsigned int)(((end_ts->tv_sec - start_ts->tv_sec) * 1000) +
-                          ((end_ts->tv_usec - start_ts->tv_usec) / 1000));
+    track_detections(detections, num_detections, labels, renderer);
 }
 
-static float intersection_over_union(float x1,
-                                     float y1,
-                                     float w1,
-                                     float h1,
-                                     float x2,
-                                     float y2,
-                                     float w2,
-                                     float h2) {
-    float xx1 = fmax(x1 - (w1 / 2), x2 - (w2 / 2));
-    float yy1 = fmax(y1 - (h1 / 2), y2 - (h2 / 2));
-    float xx2 = fmin(x1 + (w1 / 2), x2 + (w2 / 2));
-    float yy2 = fmin(y1 + (h1 / 2), y2 + (h2 / 2));
-
-    float inter_area = fmax(0, xx2 - xx1) * fmax(0, yy2 - yy1);
-    float union_area = w1 * h1 + w2 * h2 - inter_area;
-
-    return inter_area / union_area;
+static void unref_buffer(img_provider_t* image_provider, VdoBuffer** vdo_buf) {
+    g_autoptr(GError) vdo_error = NULL;
+    uint64_t start_us           = stage_timer_start();
+
+    // This will allow vdo to fill this buffer with data again
+    if (!vdo_stream_buffer_unref(image_provider->vdo_stream, vdo_buf, &vdo_error)) {
+        if (!vdo_error_is_expected(&vdo_error)) {
+            panic("%s: Unexpexted error: %s", __func__, vdo_error->message);
+        }
+    }
+    stage_timer_stop(&stage_stats, STAGE_UNREF, start_us);
 }
 
-static void non_maximum_suppression(uint8_t* tensor,
-                                    float iou_threshold,
-                                    model_params_t* model_params,
-                                    int* invalid_detections) {
-    int size_per_detection = model_params->size_per_detection;
-    int num_detections     = model_params->num_detections;
-    float qt_zero_point    = model_params->quantization_zero_point;
-    float qt_scale         = model_params->quantization_scale;
-
-    for (int i = 0; i < num_detections; i++) {
-        if (invalid_detections[i])  // Skip comparison if detection is already invalid
+/**
+ * @brief Run the main loop with two larod jobs in flight.
+ *
+ * While the preprocessing and inference of one frame run asynchronously in larod, the
+ * detections of the previous frame are post-processed and drawn. Each job keeps a reference to
+ * its VDO buffer until the job has finished.
+ */
+static void run_pipelined(img_provider_t* image_provider,
+                          model_provider_t* model_provider,
+                          model_tensor_output_t* tensor_outputs,
+                          size_t number_output_tensors,
+                          postprocessor_t* postprocessor,
+                          const label_table_t* labels,
+                          detection_renderer_t* renderer) {
+    VdoBuffer* job_buffers[PIPELINE_NBR_JOBS] = {NULL};
+    unsigned int next_job                     = 0;
+
+    while (running) {
+        VdoBuffer* vdo_buf = get_frame(image_provider);
+        if (!vdo_buf) {
+            // This can only happen if it is global rotation then
+            // the stream has to be restarted because rotation has been changed.
+            syslog(
+                LOG_INFO,
+                "No buffer because of changed global rotation. Application needs to be restarted");
+            break;
+        }
+        update_parameters(postprocessor, image_provider, renderer);
+        // Every frame is detected when pipelined, DetectionInterval is not used
+        tracker_predict(tracker);
+
+        uint64_t start_us = stage_timer_start();
+        model_start_job(model_provider, next_job, vdo_buf);
+        job_buffers[next_job] = vdo_buf;
+
+        // Handle the job that was started for the previous frame
+        unsigned int done_job = (next_job + 1) % PIPELINE_NBR_JOBS;
+        next_job              = done_job;
+        if (!job_buffers[done_job]) {
             continue;
+        }
+        bool has_output = model_wait_job(model_provider, done_job);
+        if (has_output) {
+            stage_stats_record(&stage_stats,
+                               STAGE_INFERENCE,
+                               model_job_latency_us(model_provider, done_job));
+            for (size_t i = 0; i < number_output_tensors; i++) {
+                if (!model_get_job_output_info(model_provider,
+                                               done_job,
+                                               i,
+                                               &tensor_outputs[i])) {
+                    panic("Failed to get output tensor info for %zu", i);
+                }
+            }
+            draw_detections(postprocessor, tensor_outputs[0].data, labels, renderer);
+        }
+        unref_buffer(image_provider, &job_buffers[done_job]);
+        job_buffers[done_job] = NULL;
+        if (!has_output) {
+            // No power
+            img_provider_flush_all_frames(image_provider);
+            continue;
+        }
 
-        float x1                 = (tensor[size_per_detection * i + 0] - qt_zero_point) * qt_scale;
-        float y1                 = (tensor[size_per_detection * i + 1] - qt_zero_point) * qt_scale;
-        float w1                 = (tensor[size_per_detection * i + 2] - qt_zero_point) * qt_scale;
-        float h1                 = (tensor[size_per_detection * i + 3] - qt_zero_point) * qt_scale;
-        float object1_likelihood = (tensor[size_per_detection * i + 4] - qt_zero_point) * qt_scale;
+        // The time the pipeline needs per frame, the larod jobs overlap the post-processing
+        unsigned int frame_ms = (unsigned int)((stage_timer_start() - start_us) / 1000);
+        syslog(LOG_INFO, "Ran pipelined frame for %u ms", frame_ms);
 
-        for (int j = i + 1; j < num_detections; j++) {
-            if (invalid_detections[j])  // Skip comparison if detection is already invalid
-                continue;
+        // Check if the framerate from vdo should be changed
+        img_provider_update_framerate(image_provider, frame_ms);
+    }
 
-            float x2 = (tensor[size_per_detection * j + 0] - qt_zero_point) * qt_scale;
-            float y2 = (tensor[size_per_detection * j + 1] - qt_zero_point) * qt_scale;
-            float w2 = (tensor[size_per_detection * j + 2] - qt_zero_point) * qt_scale;
-            float h2 = (tensor[size_per_detection * j + 3] - qt_zero_point) * qt_scale;
-            float object2_likelihood =
-                (tensor[size_per_detection * j + 4] - qt_zero_point) * qt_scale;
-
-            if (intersection_over_union(x1, y1, w1, h1, x2, y2, w2, h2) > iou_threshold) {
-                // invalidates the detection with lowest object likelihood score
-                if (object1_likelihood > object2_likelihood) {
-                    invalid_detections[j] = 1;
-                } else {
-                    invalid_detections[i] = 1;
-                    break;
-                }
-            }
+    for (unsigned int i = 0; i < PIPELINE_NBR_JOBS; i++) {
+        if (job_buffers[i]) {
+            model_wait_job(model_provider, i);
+            unref_buffer(image_provider, &job_buffers[i]);
         }
     }
 }
 
-static void filter_detections(uint8_t* tensor,
-                              float conf_threshold,
-                              float iou_threshold,
-                              model_params_t* model_params,
-                              int* invalid_detections) {
-    // Filter boxes by confidence
-    for (int i = 0; i < model_params->num_detections; i++) {
-        float object_likelihood = (tensor[model_params->size_per_detection * i + 4] -
-                                   model_params->quantization_zero_point) *
-                                  model_params->quantization_scale;
-
-        if (object_likelihood < conf_threshold) {
-            invalid_detections[i] = 1;
-        } else {
-            invalid_detections[i] = 0;
+/**
+ * @brief Run the main loop with one larod job per tile of the frame.
+ *
+ * All tile jobs of a frame are started at once, so larod can run the preprocessing of a tile
+ * while the model runs on the previous one and the DLPU always has a job queued. The candidates
+ * of each tile are filtered as soon as its job is done, while the following tiles still run,
+ * and all tiles are then merged with one NMS over the frame.
+ */
+static void run_tiled(img_provider_t* image_provider,
+                      model_provider_t* model_provider,
+                      const tile_t* tiles,
+                      unsigned int num_tiles,
+                      model_tensor_output_t* tensor_outputs,
+                      size_t number_output_tensors,
+                      postprocessor_t* postprocessor,
+                      const label_table_t* labels,
+                      detection_renderer_t* renderer) {
+    while (running) {
+        VdoBuffer* vdo_buf = get_frame(image_provider);
+        if (!vdo_buf) {
+            // This can only happen if it is global rotation then
+            // the stream has to be restarted because rotation has been changed.
+            syslog(
+                LOG_INFO,
+                "No buffer because of changed global rotation. Application needs to be restarted");
+            break;
+        }
+        update_parameters(postprocessor, image_provider, renderer);
+        if (!start_frame()) {
+            unref_buffer(image_provider, &vdo_buf);
+            render_tracks(renderer);
+            continue;
         }
-    }
 
-    non_maximum_suppression(tensor, iou_threshold, model_params, invalid_detections);
-}
+        uint64_t start_us = stage_timer_start();
+        for (unsigned int i = 0; i < num_tiles; i++) {
+            model_start_job(model_provider, i, vdo_buf);
+        }
 
-static void determine_class_and_object_likelihood(uint8_t* tensor,
-                                                  int detection_idx,
-                                                  int size_per_detection,
-                                                  float qt_zero_point,
-                                                  float qt_scale,
-                                                  float* highest_class_likelihood,
-                                                  int* label_idx,
-                                                  float* object_likelihood) {
-    // Find what class this object is
-    for (int j = 5; j < size_per_detection; j++) {
-        float class_likelihood =
-            (tensor[size_per_detection * detection_idx + j] - qt_zero_point) * qt_scale;
-        if (class_likelihood > *highest_class_likelihood) {
-            *highest_class_likelihood = class_likelihood;
-            *label_idx                = j - 5;
+        // The post-processing of the tiles is summed into one sample per frame
+        uint64_t postprocessing_us = 0;
+        bool has_output            = true;
+        postprocessor_begin_tiles(postprocessor);
+        for (unsigned int i = 0; i < num_tiles; i++) {
+            // Every job is waited for, since they all use the buffer
+            if (!model_wait_job(model_provider, i)) {
+                has_output = false;
+            }
+            if (!has_output) {
+                continue;
+            }
+            stage_stats_record(&stage_stats,
+                               STAGE_INFERENCE,
+                               model_job_latency_us(model_provider, i));
+            for (size_t k = 0; k < number_output_tensors; k++) {
+                if (!model_get_job_output_info(model_provider, i, k, &tensor_outputs[k])) {
+                    panic("Failed to get output tensor info for %zu", k);
+                }
+            }
+            const postprocessing_tile_t region = {
+                (float)tiles[i].x / (float)image_provider->width,
+                (float)tiles[i].y / (float)image_provider->height,
+                (float)tiles[i].width / (float)image_provider->width,
+                (float)tiles[i].height / (float)image_provider->height,
+            };
+            tensor_recorder_write(recorder, tensor_outputs[0].data);
+            uint64_t tile_start_us = stage_timer_start();
+            postprocessor_add_tile(postprocessor, tensor_outputs[0].data, &region);
+            postprocessing_us += stage_timer_start() - tile_start_us;
+        }
+        unref_buffer(image_provider, &vdo_buf);
+        if (!has_output) {
+            // No power
+            img_provider_flush_all_frames(image_provider);
+            continue;
         }
-    }
 
-    *object_likelihood =
-        (tensor[size_per_detection * detection_idx + 4] - qt_zero_point) * qt_scale;
-}
+        const detection_t* detections = NULL;
+        uint64_t finish_start_us      = stage_timer_start();
+        size_t num_detections         = postprocessor_finish_tiles(postprocessor, &detections);
+        postprocessing_us += stage_timer_start() - finish_start_us;
+        stage_stats_record(&stage_stats, STAGE_POSTPROCESSING, postprocessing_us);
+        track_detections(detections, num_detections, labels, renderer);
+
+        unsigned int frame_ms = (unsigned int)((stage_timer_start() - start_us) / 1000);
+        syslog(LOG_INFO, "Ran %u tiles for %u ms", num_tiles, frame_ms);
 
-static void
-find_corners(float x, float y, float w, float h, float* x1, float* y1, float* x2, float* y2) {
-    *x1 = fmax(0.0, x - (w / 2));
-    *y1 = fmax(0.0, y - (h / 2));
-    *x2 = fmin(1.0, x + (w / 2));
-    *y2 = fmin(1.0, y + (h / 2));
+        // Check if the framerate from vdo should be changed, the time is shared by the frames
+        // until the next detection
+        img_provider_update_framerate(image_provider, frame_ms / detection_interval);
+    }
 }
 
-static void determine_bbox_coordinates(uint8_t* tensor,
-                                       int detection_idx,
-                                       int size_per_detection,
-                                       float qt_zero_point,
-                                       float qt_scale,
-                                       float* x1,
-                                       float* y1,
-                                       float* x2,
-                                       float* y2) {
-    // Get coordinates for the object
-    float x = (tensor[size_per_detection * detection_idx + 0] - qt_zero_point) * qt_scale;
-    float y = (tensor[size_per_detection * detection_idx + 1] - qt_zero_point) * qt_scale;
-    float w = (tensor[size_per_detection * detection_idx + 2] - qt_zero_point) * qt_scale;
-    float h = (tensor[size_per_detection * detection_idx + 3] - qt_zero_point) * qt_scale;
-    find_corners(x, y, w, h, x1, y1, x2, y2);
+/**
+ * @brief Add the native aspect ratio resolutions of a format that fit the requested size.
+ */
+static void add_stream_candidates(stream_selector_t* selector,
+                                  VdoFormat format,
+                                  unsigned int min_width,
+                                  unsigned int min_height) {
+    VdoResolution resolutions[STREAM_SELECTOR_MAX_CANDIDATES];
+    size_t num_resolutions =
+        list_stream_resolutions(format, "native", resolutions, STREAM_SELECTOR_MAX_CANDIDATES);
+    stream_selector_add_candidates(
+        selector, format, resolutions, num_resolutions, min_width, min_height);
 }
 
 int main(int argc, char** argv) {
-    g_autoptr(GError) vdo_error           = NULL;
     img_provider_t* image_provider        = NULL;
     model_provider_t* model_provider      = NULL;
     model_tensor_output_t* tensor_outputs = NULL;
-    bbox_t* bbox                          = NULL;
+    postprocessor_t* postprocessor        = NULL;
+    detection_renderer_t* renderer        = NULL;
+    label_table_t* labels                 = NULL;
+    stream_selector_t* stream_selector    = NULL;
+    stream_config_t stream                = {0};
 
     // Stop main loop at signal
     signal(SIGTERM, shutdown);
@@ -267,9 +472,8 @@ int main(int argc, char** argv) {
     model_params->quantization_zero_point = QUANTIZATION_ZERO_POINT;
     model_params->num_classes             = NUM_CLASSES;
     model_params->num_detections          = NUM_DETECTIONS;
-    model_params->size_per_detection =
-        5 + NUM_CLASSES;  // Each detection consists of [x, y, w, h, object_likelihood,
-                          // class1_likelihood, class2_likelihood, class3_likelihood, ... ]
+    // Each detection consists of [x, y, w, h, object_likelihood, class1_likelihood, ... ]
+    model_params->size_per_detection = SIZE_PER_DETECTION;
 
     syslog(LOG_INFO,
            "Model input size w/h: %d x %d",
@@ -280,50 +484,147 @@ int main(int argc, char** argv) {
     syslog(LOG_INFO, "Number of classes: %d", model_params->num_classes);
     syslog(LOG_INFO, "Number of detections: %d", model_params->num_detections);
 
-    int invalid_detections[model_params->num_detections];
-
-    // Create a new axparameter instance
-    GError* axparameter_error       = NULL;
-    AXParameter* axparameter_handle = ax_parameter_new(APP_NAME, &axparameter_error);
-    if (axparameter_handle == NULL) {
-        panic("%s", axparameter_error->message);
-    }
-
-    float conf_threshold = ax_parameter_get_int(axparameter_handle, "ConfThresholdPercent") / 100.0;
-    float iou_threshold  = ax_parameter_get_int(axparameter_handle, "IouThresholdPercent") / 100.0;
+    // All parameters are read once here, and the cache follows their changes
+    param_cache                        = param_cache_create(APP_NAME);
+    const param_snapshot_t* parameters = param_cache_snapshot(param_cache);
+    param_generation                   = parameters->generation;
 
-    ax_parameter_free(axparameter_handle);
+    postprocessing_params_t postprocessing_params = {0};
+    read_postprocessing_params(parameters, &postprocessing_params);
+    bool pipelined = param_snapshot_get_bool(parameters, "PipelinedInference");
+    double latency_budget = param_snapshot_get_int(parameters, "LatencyBudgetPercent") / 100.0;
+    unsigned int tile_columns = (unsigned int)param_snapshot_get_int(parameters, "TileColumns");
+    float tile_overlap = param_snapshot_get_int(parameters, "TileOverlapPercent") / 100.0f;
+    detection_interval = (unsigned int)param_snapshot_get_int(parameters, "DetectionInterval");
 
-    VdoFormat vdo_format = VDO_FORMAT_YUV;
     double vdo_framerate = 30.0;
+    // Possible to run RGB on ARTPEC-9
+    const bool rgb_stream = !g_strcmp0(args.device_name, "a9-dlpu-tflite");
+
+    unsigned int requested_width  = model_params->input_width;
+    unsigned int requested_height = model_params->input_height;
+    if (tile_columns > 0) {
+        if (pipelined) {
+            syslog(LOG_INFO, "The tiles are pipelined, PipelinedInference is not used");
+            pipelined = false;
+        }
 
-    if (!g_strcmp0(args.device_name, "a9-dlpu-tflite")) {
-        // Possible to run RGB on ARTPEC-9
-        vdo_format = VDO_FORMAT_RGB;
-    }
-
-    // Choose a valid stream resolution since only certain resolutions are allowed
-    unsigned int stream_width  = 0;
-    unsigned int stream_height = 0;
-    if (!choose_stream_resolution(model_params->input_width,
-                                  model_params->input_height,
-                                  vdo_format,
-                                  "native",
-                                  "all",
-                                  &stream_width,
-                                  &stream_height)) {
-        syslog(LOG_ERR, "%s: Failed choosing stream resolution", __func__);
-        goto end;
+        // A larger stream of the sensor's aspect ratio is fetched so each tile is close to the
+        // model input size, the largest native resolution gives the aspect ratio
+        stream.format = rgb_stream ? VDO_FORMAT_RGB : VDO_FORMAT_YUV;
+        VdoResolution resolutions[STREAM_SELECTOR_MAX_CANDIDATES];
+        size_t num_resolutions = list_stream_resolutions(
+            stream.format, "native", resolutions, STREAM_SELECTOR_MAX_CANDIDATES);
+        VdoResolution largest = {0};
+        for (size_t i = 0; i < num_resolutions; i++) {
+            if (resolutions[i].width * resolutions[i].height > largest.width * largest.height) {
+                largest = resolutions[i];
+            }
+        }
+        tiling_stream_size(model_params->input_width,
+                           model_params->input_height,
+                           tile_columns,
+                           tile_overlap,
+                           largest.width,
+                           largest.height,
+                           &requested_width,
+                           &requested_height);
+
+        // The tiles are cropped from the stream, so the smallest valid resolution is used
+        if (!choose_stream_resolution(requested_width,
+                                      requested_height,
+                                      stream.format,
+                                      "native",
+                                      "all",
+                                      &stream.width,
+                                      &stream.height)) {
+            syslog(LOG_ERR, "%s: Failed choosing stream resolution", __func__);
+            goto end;
+        }
+    } else {
+        // Choose the valid stream with the cheapest preprocessing, measured on earlier runs
+        stream_selector = stream_selector_create(STREAM_COST_CACHE,
+                                                 args.device_name,
+                                                 model_params->input_width,
+                                                 model_params->input_height,
+                                                 VDO_FORMAT_RGB);
+        add_stream_candidates(stream_selector, VDO_FORMAT_YUV, requested_width, requested_height);
+        if (rgb_stream) {
+            add_stream_candidates(
+                stream_selector, VDO_FORMAT_RGB, requested_width, requested_height);
+        }
+        if (!stream_selector_choose(stream_selector, &stream)) {
+            syslog(LOG_ERR, "%s: Failed choosing stream resolution", __func__);
+            goto end;
+        }
     }
     syslog(LOG_INFO,
-           "Creating VDO image provider and creating stream %u x %u",
-           stream_width,
-           stream_height);
-
-    image_provider = create_img_provider(stream_width, stream_height, 2, vdo_format, vdo_framerate);
+           "Creating VDO image provider and creating stream %u x %u %s",
+           stream.width,
+           stream.height,
+           stream.format == VDO_FORMAT_RGB ? "RGB" : "YUV");
+
+    // In pipelined mode two buffers are held by the larod jobs while vdo fills the next one
+    unsigned int num_buffers = pipelined ? 3 : 2;
+    image_provider =
+        create_img_provider(stream.width, stream.height, num_buffers, stream.format, vdo_framerate);
     if (!image_provider) {
         panic("%s: Could not create image provider", __func__);
     }
+    img_provider_set_latency_budget(image_provider, latency_budget);
+
+    // Every tile has its own larod job, all running on the same frame
+    tile_t tiles[MODEL_MAX_NBR_JOBS];
+    unsigned int num_tiles = 0;
+    unsigned int num_jobs  = pipelined ? PIPELINE_NBR_JOBS : 1;
+    if (tile_columns > 0) {
+        // A stream taller than wide may need more rows than there are jobs, then the tiles are
+        // made larger with fewer columns
+        unsigned int columns = tile_columns + 1;
+        while (num_tiles == 0 && --columns > 0) {
+            num_tiles = tiling_layout(image_provider->width,
+                                      image_provider->height,
+                                      model_params->input_width,
+                                      model_params->input_height,
+                                      columns,
+                                      tile_overlap,
+                                      true,
+                                      tiles,
+                                      MODEL_MAX_NBR_JOBS);
+        }
+        if (num_tiles == 0) {
+            panic("%s: The stream needs more than %d tiles", __func__, MODEL_MAX_NBR_JOBS);
+        }
+        if (columns < tile_columns) {
+            syslog(LOG_WARNING,
+                   "%u tile columns give more than %d tiles, using %u columns",
+                   tile_columns,
+                   MODEL_MAX_NBR_JOBS,
+                   columns);
+        }
+        num_jobs = num_tiles;
+        for (unsigned int i = 0; i < num_tiles; i++) {
+            syslog(LOG_INFO,
+                   "Tile %u: X=%u Y=%u (%u x %u)",
+                   i,
+                   tiles[i].x,
+                   tiles[i].y,
+                   tiles[i].width,
+                   tiles[i].height);
+        }
+    }
+
+    // All post-processing buffers are allocated once here and reused for every frame
+    postprocessing_params.num_tiles            = num_tiles;
+    postprocessing_params.tile_merge_threshold = TILE_MERGE_THRESHOLD;
+    postprocessor = create_postprocessor(model_params, &postprocessing_params);
+
+    if (args.record_file) {
+        recorder = tensor_recorder_open(args.record_file,
+                                        model_params,
+                                        &postprocessing_params,
+                                        args.record_frames);
+    }
 
     size_t number_output_tensors = 0;
     model_provider               = create_model_provider(model_params->input_width,
@@ -332,44 +633,78 @@ int main(int argc, char** argv) {
                                            image_provider->height,
                                            image_provider->pitch,
                                            image_provider->format,
+                                           image_provider->dmabuf,
                                            VDO_FORMAT_RGB,
                                            args.model_file,
                                            args.device_name,
                                            false,
+                                           num_jobs,
                                            &number_output_tensors);
     if (!model_provider) {
         panic("%s: Could not create model provider", __func__);
     }
+    for (unsigned int i = 0; i < num_tiles; i++) {
+        model_set_job_crop(model_provider,
+                           i,
+                           tiles[i].x,
+                           tiles[i].y,
+                           tiles[i].width,
+                           tiles[i].height);
+    }
     tensor_outputs = calloc(number_output_tensors, sizeof(model_tensor_output_t));
     if (!tensor_outputs) {
         panic("%s: Could not allocate tensor outputs", __func__);
     }
 
-    char** labels = NULL;          // This is the array of label strings. The label
-                                   // entries points into the large label_file_data buffer.
-    size_t num_labels;             // Number of entries in the labels array.
-    char* label_file_data = NULL;  // Buffer holding the complete collection of label strings.
-
-    parse_labels(&labels, &label_file_data, args.labels_file, &num_labels);
+    // The labels are views into the mapped label file, the unused "n/a" lines are left out
+    labels = label_table_open(args.labels_file, true);
+    if (!labels) {
+        panic("%s: Could not read labels file %s", __func__, args.labels_file);
+    }
 
     syslog(LOG_INFO, "Start fetching video frames from VDO");
     if (!img_provider_start(image_provider)) {
         panic("%s: Could not start image provider", __func__);
     }
 
-    bbox = setup_bbox();
+    // The latencies are still logged at exit if the endpoint could not be started
+    stats_endpoint_start(&stage_stats);
 
-    int size_per_detection = model_params->size_per_detection;
-    float qt_zero_point    = model_params->quantization_zero_point;
-    float qt_scale         = model_params->quantization_scale;
+    // The drawn boxes are kept in a track store, so stationary objects are not committed again
+    max_drawn_boxes = drawn_boxes_of(&postprocessing_params);
+    renderer        = detection_renderer_create(1u,
+                                                max_drawn_boxes,
+                                                (unsigned int)model_params->input_width,
+                                                (unsigned int)model_params->input_height,
+                                                BBOX_TOLERANCE_PX);
 
-    while (running) {
-        struct timeval start_ts, end_ts;
-        unsigned int preprocessing_ms = 0;
-        unsigned int inference_ms     = 0;
-        unsigned int total_elapsed_ms = 0;
+    tracker = tracker_create(max_drawn_boxes, &tracker_params);
+    if (!tracker) {
+        panic("%s: Could not create tracker", __func__);
+    }
 
-        g_autoptr(VdoBuffer) vdo_buf = img_provider_get_frame(image_provider);
+    if (num_tiles > 0) {
+        run_tiled(image_provider,
+                  model_provider,
+                  tiles,
+                  num_tiles,
+                  tensor_outputs,
+                  number_output_tensors,
+                  postprocessor,
+                  labels,
+                  renderer);
+    } else if (pipelined) {
+        run_pipelined(image_provider,
+                      model_provider,
+                      tensor_outputs,
+                      number_output_tensors,
+                      postprocessor,
+                      labels,
+                      renderer);
+    }
+
+    while (running && !pipelined && num_tiles == 0) {
+        g_autoptr(VdoBuffer) vdo_buf = get_frame(image_provider);
         if (!vdo_buf) {
             // This can only happen if it is global rotation then
             // the stream has to be restarted because rotation has been changed.
@@ -378,51 +713,45 @@ int main(int argc, char** argv) {
                 "No buffer because of changed global rotation. Application needs to be restarted");
             goto end;
         }
+        update_parameters(postprocessor, image_provider, renderer);
+        if (!start_frame()) {
+            unref_buffer(image_provider, &vdo_buf);
+            render_tracks(renderer);
+            continue;
+        }
+
         // If needed convert and scale/crop to correct input format and resolution
         // Its up to the model provider to decide if needed or not
         // If not needed the model_run_preprocessing will return true without
         // any work
-        gettimeofday(&start_ts, NULL);
+        uint64_t start_us = stage_timer_start();
         if (!model_run_preprocessing(model_provider, vdo_buf)) {
             // No power
-            if (!vdo_stream_buffer_unref(image_provider->vdo_stream, &vdo_buf, &vdo_error)) {
-                if (!vdo_error_is_expected(&vdo_error)) {
-                    panic("%s: Unexpexted error: %s", __func__, vdo_error->message);
-                }
-                g_clear_error(&vdo_error);
-            }
+            unref_buffer(image_provider, &vdo_buf);
             img_provider_flush_all_frames(image_provider);
             continue;
         }
-        gettimeofday(&end_ts, NULL);
-
-        preprocessing_ms = (unsigned int)(((end_ts.tv_sec - start_ts.tv_sec) * 1000) +
-                                          ((end_ts.tv_usec - start_ts.tv_usec) / 1000));
+        unsigned int preprocessing_ms =
+            (unsigned int)(stage_timer_stop(&stage_stats, STAGE_PREPROCESSING, start_us) / 1000);
         syslog(LOG_INFO, "Ran pre-processing for %u ms", preprocessing_ms);
 
         // Retrieve detections from data
-        gettimeofday(&start_ts, NULL);
+        start_us = stage_timer_start();
         if (!model_run_inference(model_provider, vdo_buf)) {
             // No power
-            if (!vdo_stream_buffer_unref(image_provider->vdo_stream, &vdo_buf, &vdo_error)) {
-                if (!vdo_error_is_expected(&vdo_error)) {
-                    panic("%s: Unexpexted error: %s", __func__, vdo_error->message);
-                }
-                g_clear_error(&vdo_error);
-            }
+            unref_buffer(image_provider, &vdo_buf);
             img_provider_flush_all_frames(image_provider);
             continue;
         }
-        gettimeofday(&end_ts, NULL);
-
-        inference_ms = (unsigned int)(((end_ts.tv_sec - start_ts.tv_sec) * 1000) +
-                                      ((end_ts.tv_usec - start_ts.tv_usec) / 1000));
+        unsigned int inference_ms =
+            (unsigned int)(stage_timer_stop(&stage_stats, STAGE_INFERENCE, start_us) / 1000);
         syslog(LOG_INFO, "Ran inference for %u ms", inference_ms);
 
-        total_elapsed_ms = inference_ms + preprocessing_ms;
+        unsigned int total_elapsed_ms = inference_ms + preprocessing_ms;
 
-        // Check if the framerate from vdo should be changed
-        img_provider_update_framerate(image_provider, total_elapsed_ms);
+        // Check if the framerate from vdo should be changed, the time is shared by the frames
+        // until the next detection
+        img_provider_update_framerate(image_provider, total_elapsed_ms / detection_interval);
 
         for (size_t i = 0; i < number_output_tensors; i++) {
             if (!model_get_tensor_output_info(model_provider, i, &tensor_outputs[i])) {
@@ -430,79 +759,25 @@ int main(int argc, char** argv) {
             }
         }
 
-        uint8_t* tensor_data = tensor_outputs[0].data;
-        // Parse the output
-        gettimeofday(&start_ts, NULL);
-        filter_detections(tensor_data,
-                          conf_threshold,
-                          iou_threshold,
-                          model_params,
-                          invalid_detections);
-        gettimeofday(&end_ts, NULL);
-        syslog(LOG_INFO, "Ran parsing for %u ms", elapsed_ms(&start_ts, &end_ts));
-
-        bbox_clear(bbox);
-
-        int valid_detection_count = 0;
+        draw_detections(postprocessor, tensor_outputs[0].data, labels, renderer);
 
-        for (int i = 0; i < model_params->num_detections; i++) {
-            if (invalid_detections[i] == 1) {
-                continue;
-            }
-
-            valid_detection_count++;
-
-            float highest_class_likelihood = 0.0;
-            int label_idx                  = 0;
-            float object_likelihood        = 0.0;
-
-            determine_class_and_object_likelihood(tensor_data,
-                                                  i,
-                                                  size_per_detection,
-                                                  qt_zero_point,
-                                                  qt_scale,
-                                                  &highest_class_likelihood,
-                                                  &label_idx,
-                                                  &object_likelihood);
-            // Log info about object
-            syslog(LOG_INFO,
-                   "Object %d: Label=%s, Object Likelihood=%.2f, Class Likelihood=%.2f, ",
-                   valid_detection_count,
-                   labels[label_idx],
-                   object_likelihood,
-                   highest_class_likelihood);
-
-            float x1, y1, x2, y2;
-            determine_bbox_coordinates(tensor_data,
-                                       i,
-                                       size_per_detection,
-                                       qt_zero_point,
-                                       qt_scale,
-                                       &x1,
-                                       &y1,
-                                       &x2,
-                                       &y2);
-            syslog(LOG_INFO, "Bounding Box: [%.2f, %.2f, %.2f, %.2f]", x1, y1, x2, y2);
-
-            // No need to compensate for rotation since bbox will handle this
-            bbox_coordinates_frame_normalized(bbox);
-            bbox_rectangle(bbox, x1, y1, x2, y2);
-        }
-
-        if (!bbox_commit(bbox, 0u)) {
-            panic("Failed to commit box drawer");
-        }
-
-        // This will allow vdo to fill this buffer with data again
-        if (!vdo_stream_buffer_unref(image_provider->vdo_stream, &vdo_buf, &vdo_error)) {
-            if (!vdo_error_is_expected(&vdo_error)) {
-                panic("%s: Unexpexted error: %s", __func__, vdo_error->message);
-            }
-            g_clear_error(&vdo_error);
-        }
+        unref_buffer(image_provider, &vdo_buf);
     }
 
 end:
+    stage_stats_log(&stage_stats);
+
+    // Only sequential inference times the preprocessing on its own. In pipelined runs a job also
+    // waits behind the other job in flight, and tiled runs preprocess crops, so both record no
+    // preprocessing and leave the stored stream costs unchanged
+    if (stream_selector) {
+        stage_summary_t preprocessing;
+        stage_stats_summarize(&stage_stats, STAGE_PREPROCESSING, &preprocessing);
+        stream_selector_record(
+            stream_selector, &stream, preprocessing.mean_us, preprocessing.count);
+        stream_selector_destroy(stream_selector);
+    }
+
     // Cleanup
     free(model_params);
     if (image_provider) {
@@ -512,9 +787,12 @@ end:
         destroy_model_provider(model_provider);
     }
     free(tensor_outputs);
-    free(labels);
-    free(label_file_data);
-    bbox_destroy(bbox);
+    destroy_postprocessor(postprocessor);
+    tensor_recorder_close(recorder);
+    label_table_close(labels);
+    detection_renderer_destroy(renderer);
+    tracker_destroy(tracker);
+    param_cache_destroy(param_cache);
 
     syslog(LOG_INFO, "Exit %s", argv[0]);
 
@@ -0,0 +1,200 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "param_cache.h"
+
+#include <axsdk/axparameter.h>
+#include <glib.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <syslog.h>
+
+#include "panic.h"
+
+struct param_cache {
+    AXParameter* handle;
+    // The parameter callbacks are dispatched on this context, by the thread of the cache
+    GMainContext* context;
+    GMainLoop* loop;
+    GThread* thread;
+
+    _Atomic(const param_snapshot_t*) current;
+    // All snapshots, the current one included, only touched by the thread of the cache
+    GPtrArray* snapshots;
+};
+
+static param_snapshot_t* new_snapshot(size_t num_params, unsigned int generation) {
+    param_snapshot_t* snapshot = g_new0(param_snapshot_t, 1);
+    snapshot->generation       = generation;
+    snapshot->num_params       = num_params;
+    snapshot->params           = g_new0(param_entry_t, num_params);
+    return snapshot;
+}
+
+static void free_snapshot(gpointer data) {
+    param_snapshot_t* snapshot = data;
+
+    for (size_t i = 0; i < snapshot->num_params; i++) {
+        g_free(snapshot->params[i].name);
+        g_free(snapshot->params[i].value);
+    }
+    g_free(snapshot->params);
+    g_free(snapshot);
+}
+
+// Strip the qualifiers of a name given to a callback, e.g. "root.<app>.Name"
+static const char* unqualified_name(const gchar* name) {
+    const char* last_dot = strrchr(name, '.');
+    return last_dot ? last_dot + 1 : name;
+}
+
+// Registered with ax_parameter_register_callback(), so it must not call any ax_parameter_*
+// functions. It runs on the thread of the cache, which is the only writer of the snapshots.
+static void parameter_changed(const gchar* name, const gchar* value, gpointer user_data) {
+    param_cache_t* cache        = user_data;
+    const param_snapshot_t* old = atomic_load_explicit(&cache->current, memory_order_relaxed);
+    const char* changed_name    = unqualified_name(name);
+    param_snapshot_t* snapshot  = new_snapshot(old->num_params, old->generation + 1);
+
+    for (size_t i = 0; i < old->num_params; i++) {
+        snapshot->params[i].name = g_strdup(old->params[i].name);
+        snapshot->params[i].value =
+            g_strdup(strcmp(old->params[i].name, changed_name) == 0 ? value
+                                                                    : old->params[i].value);
+    }
+    g_ptr_array_add(cache->snapshots, snapshot);
+    atomic_store_explicit(&cache->current, snapshot, memory_order_release);
+
+    syslog(LOG_INFO, "Axparameter %s changed to %s", changed_name, value);
+}
+
+static gpointer run_loop(gpointer data) {
+    param_cache_t* cache = data;
+
+    g_main_context_push_thread_default(cache->context);
+    g_main_loop_run(cache->loop);
+    g_main_context_pop_thread_default(cache->context);
+    return NULL;
+}
+
+param_cache_t* param_cache_create(const char* app_name) {
+    param_cache_t* cache = g_new0(param_cache_t, 1);
+    GError* error        = NULL;
+
+    cache->context   = g_main_context_new();
+    cache->loop      = g_main_loop_new(cache->context, FALSE);
+    cache->snapshots = g_ptr_array_new_with_free_func(free_snapshot);
+
+    // The handle is created with the context of the cache as thread default, so its callbacks
+    // are dispatched by the thread of the cache
+    g_main_context_push_thread_default(cache->context);
+
+    cache->handle = ax_parameter_new(app_name, &error);
+    if (!cache->handle) {
+        panic("%s", error->message);
+    }
+
+    GList* names = ax_parameter_list(cache->handle, &error);
+    if (!names && error) {
+        panic("%s", error->message);
+    }
+
+    param_snapshot_t* snapshot = new_snapshot(g_list_length(names), 0);
+    size_t i                   = 0;
+    for (GList* x = names; x != NULL; x = g_list_next(x), i++) {
+        snapshot->params[i].name = x->data;
+        if (!ax_parameter_get(cache->handle,
+                              snapshot->params[i].name,
+                              &snapshot->params[i].value,
+                              &error)) {
+            panic("%s", error->message);
+        }
+        syslog(LOG_INFO,
+               "Axparameter %s: %s",
+               snapshot->params[i].name,
+               snapshot->params[i].value);
+
+        if (!ax_parameter_register_callback(cache->handle,
+                                            snapshot->params[i].name,
+                                            parameter_changed,
+                                            cache,
+                                            &error)) {
+            panic("%s", error->message);
+        }
+    }
+    // The names are owned by the snapshot
+    g_list_free(names);
+
+    g_ptr_array_add(cache->snapshots, snapshot);
+    atomic_store_explicit(&cache->current, snapshot, memory_order_release);
+
+    g_main_context_pop_thread_default(cache->context);
+
+    cache->thread = g_thread_new("param_cache", run_loop, cache);
+    return cache;
+}
+
+void param_cache_destroy(param_cache_t* cache) {
+    if (!cache) {
+        return;
+    }
+
+    g_main_loop_quit(cache->loop);
+    g_thread_join(cache->thread);
+
+    ax_parameter_free(cache->handle);
+    g_main_loop_unref(cache->loop);
+    g_main_context_unref(cache->context);
+    g_ptr_array_free(cache->snapshots, TRUE);
+    g_free(cache);
+}
+
+const param_snapshot_t* param_cache_snapshot(param_cache_t* cache) {
+    return atomic_load_explicit(&cache->current, memory_order_acquire);
+}
+
+const char* param_snapshot_get(const param_snapshot_t* snapshot, const char* name) {
+    // There are only a handful of parameters, a linear search is enough
+    for (size_t i = 0; i < snapshot->num_params; i++) {
+        if (strcmp(snapshot->params[i].name, name) == 0) {
+            return snapshot->params[i].value;
+        }
+    }
+    return NULL;
+}
+
+int param_snapshot_get_int(const param_snapshot_t* snapshot, const char* name) {
+    const char* str_value = param_snapshot_get(snapshot, name);
+    int value;
+
+    if (!str_value) {
+        panic("Axparameter %s was not found", name);
+    }
+    if (sscanf(str_value, "%d", &value) != 1) {
+        panic("Axparameter %s was not an int", name);
+    }
+    return value;
+}
+
+bool param_snapshot_get_bool(const param_snapshot_t* snapshot, const char* name) {
+    const char* str_value = param_snapshot_get(snapshot, name);
+
+    if (!str_value) {
+        panic("Axparameter %s was not found", name);
+    }
+    return strcmp(str_value, "yes") == 0;
+}
@@ -0,0 +1,96 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * A cache of the parameters of the application, so they can be read in the
+ * frame loop without a D-Bus call to the parameter service.
+ *
+ * All parameters are read once when the cache is created. A callback is then
+ * registered for each of them, and when a parameter changes a new snapshot of
+ * all values is built and published with an atomic pointer store. Readers get
+ * the current snapshot with an atomic load and never wait for the writer. The
+ * generation of the snapshot tells a reader cheaply whether anything changed
+ * since it last looked.
+ *
+ * The callbacks are dispatched by a thread of the cache, running a main loop
+ * of its own, since the application does not run a GLib main loop. The
+ * parameters change rarely, so a replaced snapshot is kept until the cache is
+ * destroyed instead of being freed while a reader may still use it.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct param_entry {
+    // Name without the application qualifier, e.g. "ConfThresholdPercent"
+    char* name;
+    char* value;
+} param_entry_t;
+
+typedef struct param_snapshot {
+    // Increased every time a parameter changes, 0 for the values read at start
+    unsigned int generation;
+    size_t num_params;
+    param_entry_t* params;
+} param_snapshot_t;
+
+typedef struct param_cache param_cache_t;
+
+/**
+ * @brief Read all parameters of the application and start following their changes.
+ *
+ * @param app_name Name of the application, whose parameters are cached.
+ *
+ * @return Pointer to a new cache, the application panics on failure.
+ */
+param_cache_t* param_cache_create(const char* app_name);
+
+/**
+ * @brief Stop following the changes and free the cache and all its snapshots.
+ *
+ * No snapshot of the cache may be used after this.
+ */
+void param_cache_destroy(param_cache_t* cache);
+
+/**
+ * @brief Get the current snapshot of the parameters, without locking.
+ *
+ * @return The snapshot, valid until the cache is destroyed.
+ */
+const param_snapshot_t* param_cache_snapshot(param_cache_t* cache);
+
+/**
+ * @brief Get the value of a parameter of a snapshot.
+ *
+ * @return The value, or NULL if the snapshot has no parameter with the name.
+ */
+const char* param_snapshot_get(const param_snapshot_t* snapshot, const char* name);
+
+/**
+ * @brief Get the value of a parameter of type int.
+ *
+ * @return The value, the application panics if it is missing or not an int.
+ */
+int param_snapshot_get_int(const param_snapshot_t* snapshot, const char* name);
+
+/**
+ * @brief Get the value of a parameter of type "bool:no,yes".
+ *
+ * @return True if the value is "yes", the application panics if it is missing.
+ */
+bool param_snapshot_get_bool(const param_snapshot_t* snapshot, const char* name);
@@ -27,7 +27,11 @@ else:
           "as a command-line argument.")
     exit(1)
 
-output_file = "model_params.h"
+# The header is written to model_params.h, unless another path is given
+if len(sys.argv) > 2:
+    output_file = sys.argv[2]
+else:
+    output_file = "model_params.h"
 interpreter = tf.lite.Interpreter(model_path)
 interpreter.allocate_tensors()
 output_details = interpreter.get_output_details()
@@ -42,6 +46,7 @@ quantization_scale, quantization_zero_point = output_details[0]['quantization']
 num_classes    = output_details[0]['shape'][2] - 5 # Removing 5 values that are
                                                    # x,y,w,h,obj_conf
 num_detections = output_details[0]['shape'][1]
+size_per_detection = output_details[0]['shape'][2]
 
 with open(output_file, "w") as f:
     f.write(f"#ifndef MODEL_PARAMS_H\n")
@@ -51,7 +56,8 @@ with open(output_file, "w") as f:
     f.write(f"#define QUANTIZATION_SCALE {quantization_scale}f\n")
     f.write(f"#define QUANTIZATION_ZERO_POINT {quantization_zero_point}\n\n")
     f.write(f"#define NUM_CLASSES {num_classes}\n")
-    f.write(f"#define NUM_DETECTIONS {num_detections}\n\n")
+    f.write(f"#define NUM_DETECTIONS {num_detections}\n")
+    f.write(f"#define SIZE_PER_DETECTION {size_per_detection}\n\n")
     f.write(f"#endif // MODEL_PARAMS_H\n")
 
 print(f"Model parameters have been saved to {output_file}.")
\ No newline at end of file
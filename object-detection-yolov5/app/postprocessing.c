@@ -0,0 +1,479 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * This file handles the YOLOv5 post-processing of the application.
+ */
+
+#include "postprocessing.h"
+
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "kernels.h"
+#include "panic.h"
+
+#ifdef SPECIALIZE_MODEL
+#include "model_params.h"  // Generated at build time
+#endif
+
+static void* alloc_buffer(size_t count, size_t size) {
+    void* buffer = calloc(count, size);
+    if (!buffer) {
+        panic("%s: Unable to allocate post-processing buffer: %s", __func__, strerror(errno));
+    }
+    return buffer;
+}
+
+// Smallest quantized value that dequantizes to at least threshold, 256 if there is none
+static int quantize_threshold(float threshold, float zero_point, float scale) {
+    // Start from the analytical value and adjust it so the comparison in quantized space gives
+    // exactly the same result as comparing the dequantized value to the threshold
+    float estimate = ceilf(threshold / scale + zero_point);
+    if (estimate < 0.0f) {
+        estimate = 0.0f;
+    } else if (estimate > UINT8_MAX + 1) {
+        estimate = UINT8_MAX + 1;
+    }
+    int quantized = (int)estimate;
+    while (quantized > 0 && ((quantized - 1) - zero_point) * scale >= threshold) {
+        quantized--;
+    }
+    while (quantized <= UINT8_MAX && (quantized - zero_point) * scale < threshold) {
+        quantized++;
+    }
+    return quantized;
+}
+
+// The decoding is inlined into one function per supported number of classes, so the class count
+// and the row stride are constants that the compiler can unroll the loops and hoist the address
+// math with. For the model in model_params.h, the number of rows and the quantization are constants
+// as well
+#define DECODER_INLINE static inline __attribute__((always_inline))
+
+/**
+ * @brief Store the index of every row whose object likelihood is at least the quantized threshold.
+ *
+ * @return Number of passing rows.
+ */
+DECODER_INLINE size_t filter_rows(const uint8_t* tensor,
+                                  size_t num_rows,
+                                  size_t size_per_detection,
+                                  int quantized_threshold,
+                                  uint32_t* passing_rows) {
+    const uint8_t* value = tensor + 4;
+    size_t count         = 0;
+
+    if (quantized_threshold > UINT8_MAX) {
+        return 0;
+    }
+
+    // Branchless compaction, the row index is always written and only kept if the row passes
+    for (size_t i = 0; i < num_rows; i++) {
+        passing_rows[count] = (uint32_t)i;
+        count += *value >= quantized_threshold;
+        value += size_per_detection;
+    }
+    return count;
+}
+
+DECODER_INLINE void determine_class(const uint8_t* detection,
+                                    size_t num_classes,
+                                    float qt_zero_point,
+                                    float qt_scale,
+                                    float* class_likelihood,
+                                    int* label_idx) {
+    uint8_t max_value = detection[5];
+    size_t max_idx    = 0;
+    if (num_classes > 1) {
+        max_idx = kernel_argmax_u8(detection + 5, num_classes, &max_value);
+    }
+
+    // Only the winning class is dequantized, a class needs a positive likelihood to be chosen
+    float likelihood = (max_value - qt_zero_point) * qt_scale;
+    if (likelihood > 0.0) {
+        *class_likelihood = likelihood;
+        *label_idx        = (int)max_idx;
+    } else {
+        *class_likelihood = 0.0;
+        *label_idx        = 0;
+    }
+}
+
+/**
+ * @brief Dequantize all detections passing the confidence threshold into the candidate buffers.
+ *
+ * The threshold is applied in the quantized domain so only the candidates are dequantized, and
+ * every value is dequantized exactly once. The candidates are appended after the ones already
+ * added, with the boxes moved from the tile to the frame.
+ */
+DECODER_INLINE void decode_candidates(postprocessor_t* postprocessor,
+                                      const uint8_t* tensor,
+                                      const postprocessing_tile_t* tile,
+                                      size_t num_detections,
+                                      size_t num_classes,
+                                      size_t size_per_detection,
+                                      float qt_zero_point,
+                                      float qt_scale) {
+    const uint32_t tile_idx = postprocessor->num_added_tiles++;
+
+    if (postprocessor->num_candidates + num_detections > postprocessor->capacity) {
+        panic("%s: More tiles added than the %u the post-processor was created for",
+              __func__,
+              postprocessor->params.num_tiles);
+    }
+
+    size_t num_rows = filter_rows(tensor,
+                                  num_detections,
+                                  size_per_detection,
+                                  postprocessor->quantized_conf_threshold,
+                                  postprocessor->rows);
+
+    for (size_t row = 0; row < num_rows; row++) {
+        const uint8_t* detection = tensor + size_per_detection * postprocessor->rows[row];
+        float object_likelihood  = (detection[4] - qt_zero_point) * qt_scale;
+        size_t count             = postprocessor->num_candidates + row;
+
+        float box[4];
+        kernel_dequantize_u8(detection, 4, qt_zero_point, qt_scale, box);
+        float x = tile->x + box[0] * tile->width;
+        float y = tile->y + box[1] * tile->height;
+        float w = box[2] * tile->width;
+        float h = box[3] * tile->height;
+
+        postprocessor->x1[count]                = x - (w / 2);
+        postprocessor->y1[count]                = y - (h / 2);
+        postprocessor->x2[count]                = x + (w / 2);
+        postprocessor->y2[count]                = y + (h / 2);
+        postprocessor->area[count]              = w * h;
+        postprocessor->object_likelihood[count] = object_likelihood;
+        postprocessor->tile_idx[count]          = tile_idx;
+        determine_class(detection,
+                        num_classes,
+                        qt_zero_point,
+                        qt_scale,
+                        &postprocessor->class_likelihood[count],
+                        &postprocessor->label_idx[count]);
+
+        postprocessor->order[count].score = object_likelihood;
+        postprocessor->order[count].idx   = (uint32_t)count;
+    }
+
+    postprocessor->num_candidates += num_rows;
+}
+
+// Fallback for any model, the shape and quantization are read from the model parameters
+static void decode_candidates_generic(postprocessor_t* postprocessor,
+                                      const uint8_t* tensor,
+                                      const postprocessing_tile_t* tile) {
+    const model_params_t* model_params = &postprocessor->model_params;
+    decode_candidates(postprocessor,
+                      tensor,
+                      tile,
+                      (size_t)model_params->num_detections,
+                      (size_t)model_params->num_classes,
+                      (size_t)model_params->size_per_detection,
+                      model_params->quantization_zero_point,
+                      model_params->quantization_scale);
+}
+
+// Each row is [x, y, w, h, object_likelihood, class1_likelihood, ...]
+#define DEFINE_DECODER(name, classes)                                         \
+    static void decode_candidates_##name(postprocessor_t* postprocessor,      \
+                                         const uint8_t* tensor,               \
+                                         const postprocessing_tile_t* tile) { \
+        const model_params_t* model_params = &postprocessor->model_params;    \
+        decode_candidates(postprocessor,                                      \
+                          tensor,                                             \
+                          tile,                                               \
+                          (size_t)model_params->num_detections,               \
+                          (classes),                                          \
+                          5 + (classes),                                      \
+                          model_params->quantization_zero_point,              \
+                          model_params->quantization_scale);                  \
+    }
+
+// Add a decoder, and an entry in decoders[], for a model with another number of classes
+DEFINE_DECODER(coco, 80)
+DEFINE_DECODER(single_class, 1)
+
+static const struct {
+    int num_classes;
+    candidate_decoder_t decode;
+} decoders[] = {
+    {80, decode_candidates_coco},
+    {1, decode_candidates_single_class},
+};
+
+#ifdef SPECIALIZE_MODEL
+// The model shipped with the application, every shape and quantization parameter is a constant
+static void decode_candidates_shipped(postprocessor_t* postprocessor,
+                                      const uint8_t* tensor,
+                                      const postprocessing_tile_t* tile) {
+    decode_candidates(postprocessor,
+                      tensor,
+                      tile,
+                      NUM_DETECTIONS,
+                      NUM_CLASSES,
+                      SIZE_PER_DETECTION,
+                      QUANTIZATION_ZERO_POINT,
+                      QUANTIZATION_SCALE);
+}
+
+// Compared bit for bit, the parameters are either the ones in model_params.h or another model's
+static bool same_float(float a, float b) {
+    return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+static bool is_shipped_model(const model_params_t* model_params) {
+    return model_params->num_detections == NUM_DETECTIONS &&
+           model_params->num_classes == NUM_CLASSES &&
+           model_params->size_per_detection == SIZE_PER_DETECTION &&
+           same_float(model_params->quantization_zero_point, QUANTIZATION_ZERO_POINT) &&
+           same_float(model_params->quantization_scale, QUANTIZATION_SCALE);
+}
+#endif
+
+static candidate_decoder_t select_decoder(const model_params_t* model_params) {
+#ifdef SPECIALIZE_MODEL
+    // Other models, e.g. in recorded tensors replayed by the benchmark, use the decoders below
+    if (is_shipped_model(model_params)) {
+        return decode_candidates_shipped;
+    }
+#endif
+    for (size_t i = 0; i < sizeof(decoders) / sizeof(decoders[0]); i++) {
+        if (decoders[i].num_classes == model_params->num_classes &&
+            model_params->size_per_detection == 5 + model_params->num_classes) {
+            return decoders[i].decode;
+        }
+    }
+    return decode_candidates_generic;
+}
+
+postprocessor_t* create_postprocessor(const model_params_t* model_params,
+                                      const postprocessing_params_t* params) {
+    postprocessor_t* postprocessor = alloc_buffer(1, sizeof(postprocessor_t));
+
+    postprocessor->model_params = *model_params;
+    postprocessor->params       = *params;
+    postprocessor->decode       = select_decoder(model_params);
+    postprocessor->capacity     = (size_t)model_params->num_detections;
+    if (params->num_tiles > 1) {
+        postprocessor->capacity *= params->num_tiles;
+    }
+
+    postprocessor->quantized_conf_threshold =
+        quantize_threshold(params->conf_threshold,
+                           model_params->quantization_zero_point,
+                           model_params->quantization_scale);
+
+    size_t capacity                  = postprocessor->capacity;
+    postprocessor->rows = alloc_buffer((size_t)model_params->num_detections, sizeof(uint32_t));
+    postprocessor->x1                = alloc_buffer(capacity, sizeof(float));
+    postprocessor->y1                = alloc_buffer(capacity, sizeof(float));
+    postprocessor->x2                = alloc_buffer(capacity, sizeof(float));
+    postprocessor->y2                = alloc_buffer(capacity, sizeof(float));
+    postprocessor->area              = alloc_buffer(capacity, sizeof(float));
+    postprocessor->object_likelihood = alloc_buffer(capacity, sizeof(float));
+    postprocessor->class_likelihood  = alloc_buffer(capacity, sizeof(float));
+    postprocessor->label_idx         = alloc_buffer(capacity, sizeof(int));
+    postprocessor->tile_idx          = alloc_buffer(capacity, sizeof(uint32_t));
+    postprocessor->order             = alloc_buffer(capacity, sizeof(candidate_order_t));
+    postprocessor->kept              = alloc_buffer(capacity, sizeof(uint32_t));
+    postprocessor->detections        = alloc_buffer(capacity, sizeof(detection_t));
+
+    return postprocessor;
+}
+
+void postprocessor_update_params(postprocessor_t* postprocessor,
+                                 const postprocessing_params_t* params) {
+    postprocessor->params.conf_threshold  = params->conf_threshold;
+    postprocessor->params.iou_threshold   = params->iou_threshold;
+    postprocessor->params.class_aware_nms = params->class_aware_nms;
+    postprocessor->params.max_detections  = params->max_detections;
+
+    postprocessor->quantized_conf_threshold =
+        quantize_threshold(params->conf_threshold,
+                           postprocessor->model_params.quantization_zero_point,
+                           postprocessor->model_params.quantization_scale);
+}
+
+void destroy_postprocessor(postprocessor_t* postprocessor) {
+    if (!postprocessor) {
+        return;
+    }
+    free(postprocessor->rows);
+    free(postprocessor->x1);
+    free(postprocessor->y1);
+    free(postprocessor->x2);
+    free(postprocessor->y2);
+    free(postprocessor->area);
+    free(postprocessor->object_likelihood);
+    free(postprocessor->class_likelihood);
+    free(postprocessor->label_idx);
+    free(postprocessor->tile_idx);
+    free(postprocessor->order);
+    free(postprocessor->kept);
+    free(postprocessor->detections);
+    free(postprocessor);
+}
+
+static int compare_candidates(const void* a, const void* b) {
+    const candidate_order_t* candidate_a = a;
+    const candidate_order_t* candidate_b = b;
+
+    // Sort on descending score, ties are resolved on tensor order to be deterministic
+    if (candidate_a->score > candidate_b->score) {
+        return -1;
+    }
+    if (candidate_a->score < candidate_b->score) {
+        return 1;
+    }
+    return (candidate_a->idx > candidate_b->idx) - (candidate_a->idx < candidate_b->idx);
+}
+
+static float intersection_over_union(const postprocessor_t* postprocessor, uint32_t a, uint32_t b) {
+    float xx1 = fmaxf(postprocessor->x1[a], postprocessor->x1[b]);
+    float yy1 = fmaxf(postprocessor->y1[a], postprocessor->y1[b]);
+    float xx2 = fminf(postprocessor->x2[a], postprocessor->x2[b]);
+    float yy2 = fminf(postprocessor->y2[a], postprocessor->y2[b]);
+
+    float inter_area = fmaxf(0, xx2 - xx1) * fmaxf(0, yy2 - yy1);
+    float union_area = postprocessor->area[a] + postprocessor->area[b] - inter_area;
+
+    return inter_area / union_area;
+}
+
+static float intersection_over_smaller(const postprocessor_t* postprocessor,
+                                       uint32_t a,
+                                       uint32_t b) {
+    float xx1 = fmaxf(postprocessor->x1[a], postprocessor->x1[b]);
+    float yy1 = fmaxf(postprocessor->y1[a], postprocessor->y1[b]);
+    float xx2 = fminf(postprocessor->x2[a], postprocessor->x2[b]);
+    float yy2 = fminf(postprocessor->y2[a], postprocessor->y2[b]);
+
+    float inter_area = fmaxf(0, xx2 - xx1) * fmaxf(0, yy2 - yy1);
+    float min_area   = fminf(postprocessor->area[a], postprocessor->area[b]);
+
+    return min_area > 0 ? inter_area / min_area : 0;
+}
+
+/**
+ * @brief Grow a kept box to also cover a merged box of another tile.
+ */
+static void merge_boxes(postprocessor_t* postprocessor, uint32_t kept, uint32_t merged) {
+    postprocessor->x1[kept]   = fminf(postprocessor->x1[kept], postprocessor->x1[merged]);
+    postprocessor->y1[kept]   = fminf(postprocessor->y1[kept], postprocessor->y1[merged]);
+    postprocessor->x2[kept]   = fmaxf(postprocessor->x2[kept], postprocessor->x2[merged]);
+    postprocessor->y2[kept]   = fmaxf(postprocessor->y2[kept], postprocessor->y2[merged]);
+    postprocessor->area[kept] = (postprocessor->x2[kept] - postprocessor->x1[kept]) *
+                                (postprocessor->y2[kept] - postprocessor->y1[kept]);
+}
+
+/**
+ * @brief Greedy NMS over the score-sorted candidates.
+ *
+ * Each candidate is only compared against the already kept detections, which are all stronger.
+ * Candidates of different tiles are compared with the intersection over the smaller box.
+ *
+ * @return Number of kept candidates.
+ */
+static size_t non_maximum_suppression(postprocessor_t* postprocessor) {
+    const postprocessing_params_t* params = &postprocessor->params;
+    const size_t max_kept =
+        params->max_detections > 0 ? params->max_detections : postprocessor->capacity;
+    size_t num_kept = 0;
+
+    for (size_t i = 0; i < postprocessor->num_candidates && num_kept < max_kept; i++) {
+        uint32_t candidate = postprocessor->order[i].idx;
+        bool suppressed    = false;
+
+        for (size_t k = 0; k < num_kept; k++) {
+            uint32_t kept = postprocessor->kept[k];
+            if (params->class_aware_nms &&
+                postprocessor->label_idx[kept] != postprocessor->label_idx[candidate]) {
+                continue;
+            }
+            if (postprocessor->tile_idx[kept] != postprocessor->tile_idx[candidate]) {
+                if (intersection_over_smaller(postprocessor, kept, candidate) >
+                    params->tile_merge_threshold) {
+                    merge_boxes(postprocessor, kept, candidate);
+                    suppressed = true;
+                    break;
+                }
+                continue;
+            }
+            if (intersection_over_union(postprocessor, kept, candidate) > params->iou_threshold) {
+                suppressed = true;
+                break;
+            }
+        }
+
+        if (!suppressed) {
+            postprocessor->kept[num_kept++] = candidate;
+        }
+    }
+
+    return num_kept;
+}
+
+void postprocessor_begin_tiles(postprocessor_t* postprocessor) {
+    postprocessor->num_candidates  = 0;
+    postprocessor->num_added_tiles = 0;
+}
+
+void postprocessor_add_tile(postprocessor_t* postprocessor,
+                            const uint8_t* tensor,
+                            const postprocessing_tile_t* tile) {
+    postprocessor->decode(postprocessor, tensor, tile);
+}
+
+size_t postprocessor_finish_tiles(postprocessor_t* postprocessor, const detection_t** detections) {
+    qsort(postprocessor->order,
+          postprocessor->num_candidates,
+          sizeof(candidate_order_t),
+          compare_candidates);
+
+    size_t num_kept = non_maximum_suppression(postprocessor);
+
+    for (size_t k = 0; k < num_kept; k++) {
+        uint32_t idx           = postprocessor->kept[k];
+        detection_t* detection = &postprocessor->detections[k];
+
+        detection->x1                = fmaxf(0.0, postprocessor->x1[idx]);
+        detection->y1                = fmaxf(0.0, postprocessor->y1[idx]);
+        detection->x2                = fminf(1.0, postprocessor->x2[idx]);
+        detection->y2                = fminf(1.0, postprocessor->y2[idx]);
+        detection->object_likelihood = postprocessor->object_likelihood[idx];
+        detection->class_likelihood  = postprocessor->class_likelihood[idx];
+        detection->label_idx         = postprocessor->label_idx[idx];
+    }
+
+    *detections = postprocessor->detections;
+    return num_kept;
+}
+
+size_t postprocessor_run(postprocessor_t* postprocessor,
+                         const uint8_t* tensor,
+                         const detection_t** detections) {
+    const postprocessing_tile_t frame = {0.0f, 0.0f, 1.0f, 1.0f};
+
+    postprocessor_begin_tiles(postprocessor);
+    postprocessor->decode(postprocessor, tensor, &frame);
+    return postprocessor_finish_tiles(postprocessor, detections);
+}
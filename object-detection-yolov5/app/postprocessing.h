@@ -0,0 +1,211 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * This header file handles the YOLOv5 post-processing of the application.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct model_params {
+    int input_width;
+    int input_height;
+    float quantization_scale;
+    float quantization_zero_point;
+    int num_classes;
+    int num_detections;
+    int size_per_detection;
+} model_params_t;
+
+typedef struct postprocessing_params {
+    float conf_threshold;
+    float iou_threshold;
+    // Only let detections of the same class suppress each other
+    bool class_aware_nms;
+    // Maximum number of detections kept after NMS, 0 means no limit
+    size_t max_detections;
+    // Number of tiles whose detections are merged, 0 for one tensor per frame
+    unsigned int num_tiles;
+    // Share of the smaller box that detections of different tiles must overlap to be merged
+    float tile_merge_threshold;
+} postprocessing_params_t;
+
+/**
+ * @brief The region of the frame that a tensor was inferred on, normalized to [0, 1].
+ */
+typedef struct postprocessing_tile {
+    float x;
+    float y;
+    float width;
+    float height;
+} postprocessing_tile_t;
+
+/**
+ * @brief A detection that survived the confidence filter and NMS.
+ *
+ * The coordinates are the normalized corners of the bounding box, clamped to [0, 1].
+ */
+typedef struct detection {
+    float x1;
+    float y1;
+    float x2;
+    float y2;
+    float object_likelihood;
+    float class_likelihood;
+    int label_idx;
+} detection_t;
+
+typedef struct candidate_order {
+    float score;
+    uint32_t idx;
+} candidate_order_t;
+
+struct postprocessor;
+
+/**
+ * @brief Decode the candidates of one output tensor, see postprocessing.c.
+ */
+typedef void (*candidate_decoder_t)(struct postprocessor* postprocessor,
+                                    const uint8_t* tensor,
+                                    const postprocessing_tile_t* tile);
+
+/**
+ * @brief A type holding the buffers used by the post-processing.
+ *
+ * All buffers are allocated once with room for all detections of the model, for every tile when
+ * tiles are merged, so no allocations are made per frame. Candidates passing the confidence
+ * threshold are dequantized once into the SoA buffers below and are then only referenced by index.
+ */
+typedef struct postprocessor {
+    model_params_t model_params;
+    postprocessing_params_t params;
+    // Decoder specialized for the number of classes of the model, chosen when it is created
+    candidate_decoder_t decode;
+
+    size_t capacity;
+    size_t num_candidates;
+
+    // The confidence threshold in the quantized domain of the output tensor
+    int quantized_conf_threshold;
+    // Tensor rows passing the confidence threshold
+    uint32_t* rows;
+
+    // Dequantized candidates, unclamped corners and area are used for IoU
+    float* x1;
+    float* y1;
+    float* x2;
+    float* y2;
+    float* area;
+    float* object_likelihood;
+    float* class_likelihood;
+    int* label_idx;
+    // Tile of each candidate, merging across tiles uses another overlap measure
+    uint32_t* tile_idx;
+    unsigned int num_added_tiles;
+
+    // Candidates sorted by descending object likelihood
+    candidate_order_t* order;
+
+    // Indices into the candidate buffers of the detections kept by NMS
+    uint32_t* kept;
+    detection_t* detections;
+} postprocessor_t;
+
+/**
+ * @brief Creates a post-processor for a YOLOv5 output tensor.
+ *
+ * @param model_params  Shape and quantization parameters of the model output.
+ * @param params        Thresholds and limits used when filtering detections.
+ *
+ * @return Pointer to a new postprocessor_t, the application panics on failure.
+ */
+postprocessor_t* create_postprocessor(const model_params_t* model_params,
+                                      const postprocessing_params_t* params);
+
+/**
+ * @brief Change the thresholds and limits used for the following tensors.
+ *
+ * Only the confidence and IoU thresholds, class aware NMS and max_detections are changed. The
+ * buffers are sized for the number of tiles, which therefore stays the same.
+ *
+ * @param postprocessor The post-processor to be updated.
+ * @param params        The new thresholds and limits.
+ */
+void postprocessor_update_params(postprocessor_t* postprocessor,
+                                 const postprocessing_params_t* params);
+
+/**
+ * @brief Release all buffers and deallocate the post-processor.
+ *
+ * @param postprocessor Pointer to postprocessor_t to be destroyed.
+ */
+void destroy_postprocessor(postprocessor_t* postprocessor);
+
+/**
+ * @brief Filter and decode the detections of one output tensor.
+ *
+ * Detections with an object likelihood below the confidence threshold are discarded, the rest
+ * are sorted by object likelihood and a greedy NMS keeps the strongest detection of each
+ * overlapping group. The NMS exits early once max_detections detections have been kept.
+ *
+ * @param postprocessor The post-processor to be used.
+ * @param tensor        Quantized YOLOv5 output tensor.
+ * @param detections    Set to an array of the kept detections, owned by the post-processor and
+ *                      valid until the next call.
+ *
+ * @return Number of detections in the detections array.
+ */
+size_t postprocessor_run(postprocessor_t* postprocessor,
+                         const uint8_t* tensor,
+                         const detection_t** detections);
+
+/**
+ * @brief Start merging the detections of the tiles of a frame.
+ */
+void postprocessor_begin_tiles(postprocessor_t* postprocessor);
+
+/**
+ * @brief Filter the detections of the output tensor of one tile and add them to the frame.
+ *
+ * The boxes are moved from the coordinates of the tile to the coordinates of the frame.
+ *
+ * @param postprocessor The post-processor to be used.
+ * @param tensor        Quantized YOLOv5 output tensor of the tile.
+ * @param tile          The region of the frame the tile covers.
+ */
+void postprocessor_add_tile(postprocessor_t* postprocessor,
+                            const uint8_t* tensor,
+                            const postprocessing_tile_t* tile);
+
+/**
+ * @brief Run NMS over the detections of all added tiles.
+ *
+ * Detections of the same tile are suppressed as in postprocessor_run(). An object cut by a
+ * tile border gives a partial box in one tile and a full box in the other, which have a low IoU.
+ * Detections of different tiles are therefore merged when they cover tile_merge_threshold of the
+ * smaller box, and the kept box grows to cover both.
+ *
+ * @param postprocessor The post-processor to be used.
+ * @param detections    Set to an array of the kept detections, owned by the post-processor and
+ *                      valid until the next call.
+ *
+ * @return Number of detections in the detections array.
+ */
+size_t postprocessor_finish_tiles(postprocessor_t* postprocessor, const detection_t** detections);
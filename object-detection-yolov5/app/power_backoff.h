@@ -0,0 +1,68 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Retry of larod jobs that fail because there is no power available.
+ *
+ * Instead of sleeping in the frame loop, a failed job starts a backoff period
+ * with a delay that doubles for every failure up to a cap. Until it has passed
+ * no jobs are run, and the frames that come in are released right away, so the
+ * stream keeps running and the first frame analyzed after the power is back is
+ * a fresh one. The job is retried on the first frame after the period.
+ *
+ * While jobs fail the application is in degraded mode, which is logged when it
+ * is entered and left.
+ */
+
+#pragma once
+
+#include <glib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define POWER_BACKOFF_INITIAL_DELAY_MS 250
+#define POWER_BACKOFF_MAX_DELAY_MS     4000
+// If there is still no power after this many failed jobs it is time to give up
+#define POWER_BACKOFF_MAX_FAILURES 50
+
+typedef struct power_backoff {
+    unsigned int failures;
+    // Monotonic time when the next job may be run
+    gint64 retry_at_us;
+    // Jobs skipped during the backoff periods of the current degraded mode
+    uint64_t skipped;
+} power_backoff_t;
+
+/**
+ * @brief Check if a job may be run now.
+ *
+ * @return False during a backoff period, the job is then counted as skipped
+ *         and the frame should be dropped.
+ */
+bool power_backoff_ready(power_backoff_t* backoff);
+
+/**
+ * @brief Tell that a job failed because there was no power, starting a new backoff period.
+ *
+ * A failure during the current backoff period, of a job that was already
+ * running when it started, is not counted.
+ */
+void power_backoff_failed(power_backoff_t* backoff);
+
+/**
+ * @brief Tell that a job has run, leaving degraded mode if it was entered.
+ */
+void power_backoff_succeeded(power_backoff_t* backoff);
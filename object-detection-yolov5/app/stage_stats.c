@@ -0,0 +1,146 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "stage_stats.h"
+
+#include <glib.h>
+#include <syslog.h>
+#include <time.h>
+
+static const char* stage_names[STAGE_COUNT] = {
+    "capture_wait",
+    "preprocessing",
+    "inference",
+    "postprocessing",
+    "render",
+    "unref",
+};
+
+const char* stage_name(stage_t stage) {
+    return stage_names[stage];
+}
+
+uint64_t stage_timer_start(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000 + (uint64_t)now.tv_nsec / 1000;
+}
+
+uint64_t stage_timer_stop(stage_stats_t* stats, stage_t stage, uint64_t start_us) {
+    uint64_t latency_us = stage_timer_start() - start_us;
+    stage_stats_record(stats, stage, latency_us);
+    return latency_us;
+}
+
+static unsigned int bucket_index(uint64_t value) {
+    if (value < STAGE_SUB_BUCKETS) {
+        return (unsigned int)value;
+    }
+    unsigned int exponent = 63 - (unsigned int)__builtin_clzll(value);
+    if (exponent > STAGE_MAX_EXPONENT) {
+        return STAGE_NUM_BUCKETS - 1;
+    }
+    // The bits below the leading one select the sub-bucket
+    unsigned int shift = exponent - STAGE_SUB_BUCKET_BITS;
+    unsigned int sub   = (unsigned int)(value >> shift) & (STAGE_SUB_BUCKETS - 1);
+    return (shift + 1) * STAGE_SUB_BUCKETS + sub;
+}
+
+static uint64_t bucket_midpoint(unsigned int index) {
+    if (index < STAGE_SUB_BUCKETS) {
+        return index;
+    }
+    unsigned int shift = index / STAGE_SUB_BUCKETS - 1;
+    uint64_t lower     = (uint64_t)(STAGE_SUB_BUCKETS + index % STAGE_SUB_BUCKETS) << shift;
+    return lower + ((1ull << shift) >> 1);
+}
+
+void stage_stats_record(stage_stats_t* stats, stage_t stage, uint64_t latency_us) {
+    stage_histogram_t* histogram = &stats->stages[stage];
+
+    atomic_fetch_add_explicit(&histogram->buckets[bucket_index(latency_us)],
+                              1,
+                              memory_order_relaxed);
+    atomic_fetch_add_explicit(&histogram->sum_us, latency_us, memory_order_relaxed);
+    // Only one thread records a stage, so the max does not need a compare and swap
+    if (latency_us > atomic_load_explicit(&histogram->max_us, memory_order_relaxed)) {
+        atomic_store_explicit(&histogram->max_us, latency_us, memory_order_relaxed);
+    }
+}
+
+void stage_stats_summarize(stage_stats_t* stats, stage_t stage, stage_summary_t* summary) {
+    stage_histogram_t* histogram = &stats->stages[stage];
+    uint64_t buckets[STAGE_NUM_BUCKETS];
+
+    // Copy the buckets once, so the percentiles agree with the count while recording goes on
+    uint64_t count = 0;
+    for (unsigned int i = 0; i < STAGE_NUM_BUCKETS; i++) {
+        buckets[i] = atomic_load_explicit(&histogram->buckets[i], memory_order_relaxed);
+        count += buckets[i];
+    }
+
+    *summary = (stage_summary_t){0};
+    if (count == 0) {
+        return;
+    }
+    summary->count   = count;
+    summary->mean_us = atomic_load_explicit(&histogram->sum_us, memory_order_relaxed) / count;
+    summary->max_us  = atomic_load_explicit(&histogram->max_us, memory_order_relaxed);
+
+    // Rank of each percentile, rounded up so p99 of 100 samples is the 99th
+    const uint64_t p50_rank = (count * 50 + 99) / 100;
+    const uint64_t p90_rank = (count * 90 + 99) / 100;
+    const uint64_t p99_rank = (count * 99 + 99) / 100;
+    uint64_t seen           = 0;
+    for (unsigned int i = 0; i < STAGE_NUM_BUCKETS && seen < p99_rank; i++) {
+        if (buckets[i] == 0) {
+            continue;
+        }
+        uint64_t before = seen;
+        seen += buckets[i];
+        if (before < p50_rank && seen >= p50_rank) {
+            summary->p50_us = bucket_midpoint(i);
+        }
+        if (before < p90_rank && seen >= p90_rank) {
+            summary->p90_us = bucket_midpoint(i);
+        }
+        if (seen >= p99_rank) {
+            summary->p99_us = bucket_midpoint(i);
+        }
+    }
+    // The midpoint of the last bucket may be above the largest latency in it
+    summary->p50_us = MIN(summary->p50_us, summary->max_us);
+    summary->p90_us = MIN(summary->p90_us, summary->max_us);
+    summary->p99_us = MIN(summary->p99_us, summary->max_us);
+}
+
+void stage_stats_log(stage_stats_t* stats) {
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        stage_summary_t summary;
+        stage_stats_summarize(stats, (stage_t)i, &summary);
+        if (summary.count == 0) {
+            continue;
+        }
+        syslog(LOG_INFO,
+               "Stage %s: %llu samples, mean %llu us, p50 %llu us, p99 %llu us, max %llu us",
+               stage_name((stage_t)i),
+               (unsigned long long)summary.count,
+               (unsigned long long)summary.mean_us,
+               (unsigned long long)summary.p50_us,
+               (unsigned long long)summary.p99_us,
+               (unsigned long long)summary.max_us);
+    }
+}
@@ -0,0 +1,109 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Latency histograms of the stages of the frame loop.
+ *
+ * A stage is timed with the monotonic clock and the latency is added to a
+ * histogram with log-linear buckets: latencies below 16 us have one bucket
+ * each, and every power of two above is split in 16 buckets, so a percentile
+ * is within about 6 % of the true value at any scale. Recording only does
+ * relaxed atomic increments, so the frame loop is never blocked, and the
+ * histograms can be read from another thread at the same time.
+ *
+ * Each stage should be recorded from one thread only.
+ */
+
+#pragma once
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#define STAGE_SUB_BUCKET_BITS 4
+#define STAGE_SUB_BUCKETS     (1 << STAGE_SUB_BUCKET_BITS)
+// Latencies from 2^STAGE_MAX_EXPONENT us, about 67 s, are counted in the last bucket
+#define STAGE_MAX_EXPONENT 26
+#define STAGE_NUM_BUCKETS  ((STAGE_MAX_EXPONENT - STAGE_SUB_BUCKET_BITS + 2) * STAGE_SUB_BUCKETS)
+
+typedef enum stage {
+    // Waiting for the next frame from VDO
+    STAGE_CAPTURE_WAIT = 0,
+    STAGE_PREPROCESSING,
+    // In the asynchronous modes this covers both the preprocessing and inference of a job
+    STAGE_INFERENCE,
+    STAGE_POSTPROCESSING,
+    STAGE_RENDER,
+    // Returning the buffer to VDO
+    STAGE_UNREF,
+    STAGE_COUNT,
+} stage_t;
+
+typedef struct stage_histogram {
+    atomic_uint_least64_t buckets[STAGE_NUM_BUCKETS];
+    atomic_uint_least64_t sum_us;
+    atomic_uint_least64_t max_us;
+} stage_histogram_t;
+
+typedef struct stage_stats {
+    stage_histogram_t stages[STAGE_COUNT];
+} stage_stats_t;
+
+typedef struct stage_summary {
+    uint64_t count;
+    uint64_t mean_us;
+    uint64_t p50_us;
+    uint64_t p90_us;
+    uint64_t p99_us;
+    uint64_t max_us;
+} stage_summary_t;
+
+/**
+ * @brief Get the name of a stage, as used in the log and the stats endpoint.
+ */
+const char* stage_name(stage_t stage);
+
+/**
+ * @brief Start timing a stage.
+ *
+ * @return The current monotonic time in us.
+ */
+uint64_t stage_timer_start(void);
+
+/**
+ * @brief Stop timing a stage and add the latency to its histogram.
+ *
+ * @param start_us Time returned by stage_timer_start().
+ *
+ * @return The latency in us.
+ */
+uint64_t stage_timer_stop(stage_stats_t* stats, stage_t stage, uint64_t start_us);
+
+/**
+ * @brief Add a latency to the histogram of a stage.
+ */
+void stage_stats_record(stage_stats_t* stats, stage_t stage, uint64_t latency_us);
+
+/**
+ * @brief Summarize the histogram of a stage.
+ *
+ * The percentiles are the midpoints of the buckets they fall in, at most the max.
+ */
+void stage_stats_summarize(stage_stats_t* stats, stage_t stage, stage_summary_t* summary);
+
+/**
+ * @brief Write the summary of every stage with any latencies to the system log.
+ */
+void stage_stats_log(stage_stats_t* stats);
@@ -0,0 +1,105 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "stats_endpoint.h"
+
+#include <fcgiapp.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <syslog.h>
+
+#define FCGI_SOCKET_NAME "FCGI_SOCKET_NAME"
+
+typedef struct stats_endpoint {
+    stage_stats_t* stats;
+    int socket;
+} stats_endpoint_t;
+
+static void write_stats(FCGX_Stream* out, stage_stats_t* stats) {
+    FCGX_FPrintF(out, "Content-Type: application/json\r\n\r\n");
+    FCGX_FPrintF(out, "{\"stages\":[");
+    for (int i = 0; i < STAGE_COUNT; i++) {
+        stage_summary_t summary;
+        stage_stats_summarize(stats, (stage_t)i, &summary);
+        FCGX_FPrintF(out,
+                     "%s{\"name\":\"%s\",\"count\":%llu,\"mean_us\":%llu,\"p50_us\":%llu,"
+                     "\"p90_us\":%llu,\"p99_us\":%llu,\"max_us\":%llu}",
+                     i > 0 ? "," : "",
+                     stage_name((stage_t)i),
+                     (unsigned long long)summary.count,
+                     (unsigned long long)summary.mean_us,
+                     (unsigned long long)summary.p50_us,
+                     (unsigned long long)summary.p90_us,
+                     (unsigned long long)summary.p99_us,
+                     (unsigned long long)summary.max_us);
+    }
+    FCGX_FPrintF(out, "]}\n");
+}
+
+static void* serve_thread(void* data) {
+    stats_endpoint_t* endpoint = data;
+    FCGX_Request request;
+
+    if (FCGX_InitRequest(&request, endpoint->socket, 0) != 0) {
+        syslog(LOG_ERR, "%s: FCGX_InitRequest failed", __func__);
+        free(endpoint);
+        return NULL;
+    }
+    while (FCGX_Accept_r(&request) == 0) {
+        write_stats(request.out, endpoint->stats);
+        FCGX_Finish_r(&request);
+    }
+    free(endpoint);
+    return NULL;
+}
+
+bool stats_endpoint_start(stage_stats_t* stats) {
+    const char* socket_path = getenv(FCGI_SOCKET_NAME);
+    if (!socket_path) {
+        syslog(LOG_WARNING, "No %s set, the stats endpoint is not started", FCGI_SOCKET_NAME);
+        return false;
+    }
+    if (FCGX_Init() != 0) {
+        syslog(LOG_ERR, "%s: FCGX_Init failed", __func__);
+        return false;
+    }
+    int socket = FCGX_OpenSocket(socket_path, 5);
+    if (socket < 0) {
+        syslog(LOG_ERR, "%s: Could not open socket %s", __func__, socket_path);
+        return false;
+    }
+    chmod(socket_path, S_IRWXU | S_IRWXG | S_IRWXO);
+
+    stats_endpoint_t* endpoint = malloc(sizeof(stats_endpoint_t));
+    if (!endpoint) {
+        syslog(LOG_ERR, "%s: Could not allocate endpoint", __func__);
+        return false;
+    }
+    endpoint->stats  = stats;
+    endpoint->socket = socket;
+
+    // The thread blocks in accept, so it is detached and ends with the application
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, serve_thread, endpoint) != 0) {
+        syslog(LOG_ERR, "%s: Could not create thread", __func__);
+        free(endpoint);
+        return false;
+    }
+    pthread_detach(thread);
+    syslog(LOG_INFO, "Serving stage latencies on %s", socket_path);
+    return true;
+}
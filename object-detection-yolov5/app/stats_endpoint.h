@@ -0,0 +1,39 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * FastCGI endpoint serving the stage latencies as JSON.
+ *
+ * The endpoint is declared in the httpConfig of the manifest, and the web
+ * server of the device passes its requests on the socket given in the
+ * FCGI_SOCKET_NAME environment variable. The requests are served by a thread
+ * of its own, which only reads the histograms.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+
+#include "stage_stats.h"
+
+/**
+ * @brief Start serving the stats, the thread runs until the application exits.
+ *
+ * @param stats The stats to serve, must outlive the application.
+ *
+ * @return False if the endpoint could not be set up, the application still runs without it.
+ */
+bool stats_endpoint_start(stage_stats_t* stats);
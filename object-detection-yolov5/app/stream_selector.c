@@ -0,0 +1,324 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "stream_selector.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+
+#include "panic.h"
+
+// Estimated time of the libyuv preprocessing per megapixel, before the calibration
+#define CONVERT_YUV_US_PER_MP 2000.0
+#define COPY_RGB_US_PER_MP    800.0
+#define SCALE_US_PER_MP       1200.0
+#define WRITE_US_PER_MP       600.0
+
+// Frames a mean is weighted as at most, so a device that got slower is followed
+#define MAX_MEAN_WEIGHT 1000
+
+static const char* format_name(VdoFormat format) {
+    return format == VDO_FORMAT_RGB ? "rgb" : format == VDO_FORMAT_YUV ? "yuv" : "other";
+}
+
+static bool has_scaler_only_path(unsigned int input_width,
+                                 unsigned int input_height,
+                                 const stream_config_t* stream) {
+    return stream->width == input_width && stream->height == input_height;
+}
+
+static double estimate_us(unsigned int input_width,
+                          unsigned int input_height,
+                          VdoFormat model_format,
+                          const stream_config_t* stream) {
+    const bool scaled    = !has_scaler_only_path(input_width, input_height, stream);
+    const bool converted = stream->format != model_format;
+    if (!scaled && !converted) {
+        return 0.0;
+    }
+
+    const double stream_mp = (double)stream->width * stream->height / 1e6;
+    const double input_mp  = (double)input_width * input_height / 1e6;
+    double cost            = input_mp * WRITE_US_PER_MP;
+    cost += stream_mp * (stream->format == VDO_FORMAT_YUV ? CONVERT_YUV_US_PER_MP
+                                                          : COPY_RGB_US_PER_MP);
+    if (scaled) {
+        cost += stream_mp * SCALE_US_PER_MP;
+    }
+    return cost;
+}
+
+/**
+ * @brief Index of the measurement of a stream on the device, num_entries if there is none.
+ */
+static size_t find_entry(const stream_selector_t* selector, const stream_config_t* stream) {
+    size_t i = 0;
+    for (; i < selector->num_entries; i++) {
+        const stream_cost_entry_t* entry = &selector->entries[i];
+        if (!strcmp(entry->device_name, selector->device_name) &&
+            entry->input_width == selector->input_width &&
+            entry->input_height == selector->input_height &&
+            entry->stream.width == stream->width && entry->stream.height == stream->height &&
+            entry->stream.format == stream->format) {
+            break;
+        }
+    }
+    return i;
+}
+
+/**
+ * @brief How much slower the device measured than estimated, over all its measured streams.
+ */
+static double calibration(const stream_selector_t* selector) {
+    double measured  = 0.0;
+    double estimated = 0.0;
+    for (size_t i = 0; i < selector->num_entries; i++) {
+        const stream_cost_entry_t* entry = &selector->entries[i];
+        if (strcmp(entry->device_name, selector->device_name)) {
+            continue;
+        }
+        double estimate = estimate_us(entry->input_width,
+                                      entry->input_height,
+                                      selector->model_format,
+                                      &entry->stream);
+        if (estimate > 0.0) {
+            measured += (double)entry->mean_us;
+            estimated += estimate;
+        }
+    }
+    return estimated > 0.0 ? measured / estimated : 1.0;
+}
+
+static void read_cache(stream_selector_t* selector) {
+    FILE* file = fopen(selector->cache_path, "r");
+    if (!file) {
+        if (errno != ENOENT) {
+            syslog(LOG_WARNING,
+                   "%s: Could not open %s: %s",
+                   __func__,
+                   selector->cache_path,
+                   strerror(errno));
+        }
+        return;
+    }
+
+    char line[128];
+    while (selector->num_entries < STREAM_SELECTOR_MAX_ENTRIES &&
+           fgets(line, sizeof(line), file)) {
+        stream_cost_entry_t* entry = &selector->entries[selector->num_entries];
+        unsigned int format;
+        unsigned long long mean_us;
+        unsigned long long count;
+        if (sscanf(line,
+                   "%31s %u %u %u %u %u %llu %llu",
+                   entry->device_name,
+                   &entry->input_width,
+                   &entry->input_height,
+                   &format,
+                   &entry->stream.width,
+                   &entry->stream.height,
+                   &mean_us,
+                   &count) != 8) {
+            // A broken line is dropped when the file is written again
+            continue;
+        }
+        entry->stream.format = (VdoFormat)format;
+        entry->mean_us       = mean_us;
+        entry->count         = count;
+        selector->num_entries++;
+    }
+    fclose(file);
+}
+
+static void write_cache(const stream_selector_t* selector) {
+    // Written next to the cache and renamed over it, so a crash never leaves half a file
+    size_t tmp_path_size = strlen(selector->cache_path) + sizeof(".tmp");
+    char* tmp_path       = malloc(tmp_path_size);
+    if (!tmp_path) {
+        panic("%s: Could not allocate path", __func__);
+    }
+    snprintf(tmp_path, tmp_path_size, "%s.tmp", selector->cache_path);
+
+    FILE* file = fopen(tmp_path, "w");
+    if (!file) {
+        syslog(LOG_WARNING, "%s: Could not open %s: %s", __func__, tmp_path, strerror(errno));
+        free(tmp_path);
+        return;
+    }
+    for (size_t i = 0; i < selector->num_entries; i++) {
+        const stream_cost_entry_t* entry = &selector->entries[i];
+        fprintf(file,
+                "%s %u %u %u %u %u %llu %llu\n",
+                entry->device_name,
+                entry->input_width,
+                entry->input_height,
+                (unsigned int)entry->stream.format,
+                entry->stream.width,
+                entry->stream.height,
+                (unsigned long long)entry->mean_us,
+                (unsigned long long)entry->count);
+    }
+    if (fclose(file) || rename(tmp_path, selector->cache_path)) {
+        syslog(LOG_WARNING,
+               "%s: Could not write %s: %s",
+               __func__,
+               selector->cache_path,
+               strerror(errno));
+        remove(tmp_path);
+    }
+    free(tmp_path);
+}
+
+stream_selector_t* stream_selector_create(const char* cache_path,
+                                          const char* device_name,
+                                          unsigned int input_width,
+                                          unsigned int input_height,
+                                          VdoFormat model_format) {
+    stream_selector_t* selector = calloc(1, sizeof(stream_selector_t));
+    if (!selector) {
+        panic("%s: Could not allocate stream selector", __func__);
+    }
+    selector->cache_path = strdup(cache_path);
+    if (!selector->cache_path) {
+        panic("%s: Could not allocate stream selector", __func__);
+    }
+    // The name is one word in the cache file
+    snprintf(selector->device_name,
+             sizeof(selector->device_name),
+             "%s",
+             device_name && *device_name ? device_name : "default");
+    selector->device_name[strcspn(selector->device_name, " \t\n")] = '\0';
+
+    selector->input_width  = input_width;
+    selector->input_height = input_height;
+    selector->model_format = model_format;
+
+    read_cache(selector);
+    return selector;
+}
+
+void stream_selector_destroy(stream_selector_t* selector) {
+    if (!selector) {
+        return;
+    }
+    free(selector->cache_path);
+    free(selector);
+}
+
+void stream_selector_add_candidates(stream_selector_t* selector,
+                                    VdoFormat format,
+                                    const VdoResolution* resolutions,
+                                    size_t num_resolutions,
+                                    unsigned int min_width,
+                                    unsigned int min_height) {
+    for (size_t i = 0; i < num_resolutions; i++) {
+        if (resolutions[i].width < min_width || resolutions[i].height < min_height) {
+            continue;
+        }
+        if (selector->num_candidates == STREAM_SELECTOR_MAX_CANDIDATES) {
+            syslog(LOG_WARNING, "%s: Too many stream candidates, the rest are skipped", __func__);
+            return;
+        }
+        selector->candidates[selector->num_candidates++] =
+            (stream_config_t){resolutions[i].width, resolutions[i].height, format};
+    }
+}
+
+bool stream_selector_choose(const stream_selector_t* selector, stream_config_t* chosen) {
+    const double scale = calibration(selector);
+    double best_us     = 0.0;
+    size_t best        = selector->num_candidates;
+
+    for (size_t i = 0; i < selector->num_candidates; i++) {
+        const stream_config_t* candidate = &selector->candidates[i];
+        const size_t entry_index         = find_entry(selector, candidate);
+        const stream_cost_entry_t* entry =
+            entry_index < selector->num_entries ? &selector->entries[entry_index] : NULL;
+        const double cost_us = entry ? (double)entry->mean_us
+                                     : scale * estimate_us(selector->input_width,
+                                                           selector->input_height,
+                                                           selector->model_format,
+                                                           candidate);
+        syslog(LOG_INFO,
+               "Stream candidate %u x %u %s: %s preprocessing %.0f us%s",
+               candidate->width,
+               candidate->height,
+               format_name(candidate->format),
+               entry ? "measured" : "estimated",
+               cost_us,
+               has_scaler_only_path(selector->input_width, selector->input_height, candidate)
+                   ? ", scaled by VDO"
+                   : "");
+
+        const bool smaller =
+            best < selector->num_candidates &&
+            (uint64_t)candidate->width * candidate->height <
+                (uint64_t)selector->candidates[best].width * selector->candidates[best].height;
+        if (best == selector->num_candidates || cost_us < best_us ||
+            (cost_us <= best_us && smaller)) {
+            best    = i;
+            best_us = cost_us;
+        }
+    }
+
+    if (best == selector->num_candidates) {
+        return false;
+    }
+    *chosen = selector->candidates[best];
+    return true;
+}
+
+void stream_selector_record(stream_selector_t* selector,
+                            const stream_config_t* stream,
+                            uint64_t mean_us,
+                            uint64_t count) {
+    if (count == 0) {
+        return;
+    }
+
+    const size_t entry_index   = find_entry(selector, stream);
+    stream_cost_entry_t* entry = NULL;
+    if (entry_index < selector->num_entries) {
+        entry = &selector->entries[entry_index];
+
+        const uint64_t weight = entry->count < MAX_MEAN_WEIGHT ? entry->count : MAX_MEAN_WEIGHT;
+        entry->mean_us        = (entry->mean_us * weight + mean_us * count) / (weight + count);
+        entry->count += count;
+    } else {
+        if (selector->num_entries < STREAM_SELECTOR_MAX_ENTRIES) {
+            entry = &selector->entries[selector->num_entries++];
+        } else {
+            // Replace the measurement with the fewest frames
+            entry = &selector->entries[0];
+            for (size_t i = 1; i < selector->num_entries; i++) {
+                if (selector->entries[i].count < entry->count) {
+                    entry = &selector->entries[i];
+                }
+            }
+        }
+        memcpy(entry->device_name, selector->device_name, sizeof(entry->device_name));
+        entry->input_width  = selector->input_width;
+        entry->input_height = selector->input_height;
+        entry->stream       = *stream;
+        entry->mean_us      = mean_us;
+        entry->count        = count;
+    }
+
+    write_cache(selector);
+}
@@ -0,0 +1,129 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Selection of the stream resolution and format with the cheapest preprocessing.
+ *
+ * Every stream resolution and format that VDO supports and that is at least
+ * the requested size is a candidate. A candidate is scored by the expected
+ * time of the larod preprocessing that converts and scales its frames to the
+ * model input. A candidate of exactly the model input size leaves the scaling
+ * to the VDO scaler, and one that also has the model format needs no
+ * preprocessing at all.
+ *
+ * The time is estimated from the number of pixels read and written, unless it
+ * has been measured for the candidate on this device. The measured times are
+ * kept in a cache file per larod device and model input size, and also
+ * calibrate the estimates of the candidates that have not been measured, so
+ * the estimates follow the speed of the device.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "vdo-types.h"
+
+#define STREAM_SELECTOR_MAX_CANDIDATES 32
+#define STREAM_SELECTOR_MAX_ENTRIES    64
+#define STREAM_SELECTOR_DEVICE_SIZE    32
+
+typedef struct stream_config {
+    unsigned int width;
+    unsigned int height;
+    VdoFormat format;
+} stream_config_t;
+
+typedef struct stream_cost_entry {
+    char device_name[STREAM_SELECTOR_DEVICE_SIZE];
+    unsigned int input_width;
+    unsigned int input_height;
+    stream_config_t stream;
+    // Mean preprocessing time of the frames measured so far
+    uint64_t mean_us;
+    uint64_t count;
+} stream_cost_entry_t;
+
+typedef struct stream_selector {
+    char* cache_path;
+    char device_name[STREAM_SELECTOR_DEVICE_SIZE];
+    unsigned int input_width;
+    unsigned int input_height;
+    VdoFormat model_format;
+
+    stream_config_t candidates[STREAM_SELECTOR_MAX_CANDIDATES];
+    size_t num_candidates;
+
+    // The measurements of all devices and model input sizes in the cache file
+    stream_cost_entry_t entries[STREAM_SELECTOR_MAX_ENTRIES];
+    size_t num_entries;
+} stream_selector_t;
+
+/**
+ * @brief Create a selector and read the measurements of the device from the cache file.
+ *
+ * A missing cache file is the same as one without measurements.
+ *
+ * @param cache_path    Path of the cache file.
+ * @param device_name   Name of the larod device running the preprocessing, can be NULL.
+ * @param input_width   Width of the model input.
+ * @param input_height  Height of the model input.
+ * @param model_format  Format of the model input.
+ *
+ * @return Pointer to a new selector.
+ */
+stream_selector_t* stream_selector_create(const char* cache_path,
+                                          const char* device_name,
+                                          unsigned int input_width,
+                                          unsigned int input_height,
+                                          VdoFormat model_format);
+
+void stream_selector_destroy(stream_selector_t* selector);
+
+/**
+ * @brief Add the resolutions of a format that are at least min_width x min_height as candidates.
+ */
+void stream_selector_add_candidates(stream_selector_t* selector,
+                                    VdoFormat format,
+                                    const VdoResolution* resolutions,
+                                    size_t num_resolutions,
+                                    unsigned int min_width,
+                                    unsigned int min_height);
+
+/**
+ * @brief Choose the candidate with the lowest expected preprocessing time.
+ *
+ * Of candidates with the same time the smallest one is chosen. The scores are logged.
+ *
+ * @param chosen  Set to the chosen candidate.
+ *
+ * @return False if there are no candidates.
+ */
+bool stream_selector_choose(const stream_selector_t* selector, stream_config_t* chosen);
+
+/**
+ * @brief Add measured preprocessing times of a stream to the cache file.
+ *
+ * @param stream   The stream that was used.
+ * @param mean_us  Mean preprocessing time of the frames.
+ * @param count    Number of frames measured.
+ */
+void stream_selector_record(stream_selector_t* selector,
+                            const stream_config_t* stream,
+                            uint64_t mean_us,
+                            uint64_t count);
@@ -0,0 +1,152 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "tensor_recording.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+
+#include "panic.h"
+
+tensor_recorder_t* tensor_recorder_open(const char* path,
+                                        const model_params_t* model_params,
+                                        const postprocessing_params_t* params,
+                                        unsigned int max_frames) {
+    tensor_recording_header_t header = {
+        .magic           = TENSOR_RECORDING_MAGIC,
+        .version         = TENSOR_RECORDING_VERSION,
+        .model_params    = *model_params,
+        .conf_threshold  = params->conf_threshold,
+        .iou_threshold   = params->iou_threshold,
+        .class_aware_nms = params->class_aware_nms,
+        .max_detections  = (uint32_t)params->max_detections,
+        .tensor_size =
+            (uint32_t)model_params->num_detections * (uint32_t)model_params->size_per_detection,
+    };
+
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        syslog(LOG_ERR, "%s: Could not open %s: %s", __func__, path, strerror(errno));
+        return NULL;
+    }
+    if (fwrite(&header, sizeof(header), 1, file) != 1) {
+        syslog(LOG_ERR, "%s: Could not write to %s: %s", __func__, path, strerror(errno));
+        fclose(file);
+        return NULL;
+    }
+
+    tensor_recorder_t* recorder = calloc(1, sizeof(tensor_recorder_t));
+    char* path_copy             = strdup(path);
+    if (!recorder || !path_copy) {
+        panic("%s: Could not allocate recorder", __func__);
+    }
+    recorder->file        = file;
+    recorder->path        = path_copy;
+    recorder->tensor_size = header.tensor_size;
+    recorder->max_frames  = max_frames;
+    syslog(LOG_INFO, "Recording %u output tensors to %s", max_frames, path);
+    return recorder;
+}
+
+static void close_file(tensor_recorder_t* recorder) {
+    if (!recorder->file) {
+        return;
+    }
+    if (fclose(recorder->file) != 0) {
+        syslog(LOG_ERR, "%s: Could not write to %s: %s", __func__, recorder->path, strerror(errno));
+    }
+    recorder->file = NULL;
+    syslog(LOG_INFO, "Recorded %u output tensors to %s", recorder->num_frames, recorder->path);
+}
+
+void tensor_recorder_write(tensor_recorder_t* recorder, const uint8_t* tensor) {
+    if (!recorder || !recorder->file) {
+        return;
+    }
+    if (fwrite(tensor, recorder->tensor_size, 1, recorder->file) != 1) {
+        syslog(LOG_ERR, "%s: Could not write to %s: %s", __func__, recorder->path, strerror(errno));
+        close_file(recorder);
+        return;
+    }
+    if (++recorder->num_frames == recorder->max_frames) {
+        close_file(recorder);
+    }
+}
+
+void tensor_recorder_close(tensor_recorder_t* recorder) {
+    if (!recorder) {
+        return;
+    }
+    close_file(recorder);
+    free(recorder->path);
+    free(recorder);
+}
+
+bool tensor_recording_load(const char* path,
+                           tensor_recording_header_t* header,
+                           uint8_t** tensors,
+                           size_t* num_frames) {
+    bool ret      = false;
+    uint8_t* data = NULL;
+
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        syslog(LOG_ERR, "%s: Could not open %s: %s", __func__, path, strerror(errno));
+        return false;
+    }
+    if (fread(header, sizeof(*header), 1, file) != 1 || header->magic != TENSOR_RECORDING_MAGIC ||
+        header->version != TENSOR_RECORDING_VERSION || header->tensor_size == 0) {
+        syslog(LOG_ERR, "%s: %s is not a tensor recording", __func__, path);
+        goto end;
+    }
+
+    if (fseek(file, 0, SEEK_END) != 0) {
+        syslog(LOG_ERR, "%s: Could not seek in %s: %s", __func__, path, strerror(errno));
+        goto end;
+    }
+    long file_size = ftell(file);
+    if (file_size < 0 || fseek(file, (long)sizeof(*header), SEEK_SET) != 0) {
+        syslog(LOG_ERR, "%s: Could not seek in %s: %s", __func__, path, strerror(errno));
+        goto end;
+    }
+    // A tensor cut off at the end of the file is ignored
+    size_t count = ((size_t)file_size - sizeof(*header)) / header->tensor_size;
+    if (count == 0) {
+        syslog(LOG_ERR, "%s: No tensors in %s", __func__, path);
+        goto end;
+    }
+
+    data = malloc(count * header->tensor_size);
+    if (!data) {
+        panic("%s: Could not allocate %zu tensors", __func__, count);
+    }
+    if (fread(data, header->tensor_size, count, file) != count) {
+        syslog(LOG_ERR, "%s: Could not read %s", __func__, path);
+        goto end;
+    }
+
+    *tensors    = data;
+    *num_frames = count;
+    data        = NULL;
+    ret         = true;
+
+end:
+    free(data);
+    fclose(file);
+    return ret;
+}
@@ -0,0 +1,90 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Recording of the output tensors of the model, to replay them through the post-processing.
+ *
+ * A recording starts with a header with the model and post-processing parameters, followed by the
+ * raw quantized output tensor of each frame. The file is written with the byte order of the
+ * device, which is little endian on all supported devices and on a x86_64 host.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "postprocessing.h"
+
+#define TENSOR_RECORDING_MAGIC   0x54564c59  // "YLVT"
+#define TENSOR_RECORDING_VERSION 1
+
+typedef struct tensor_recording_header {
+    uint32_t magic;
+    uint32_t version;
+    model_params_t model_params;
+    float conf_threshold;
+    float iou_threshold;
+    uint32_t class_aware_nms;
+    uint32_t max_detections;
+    uint32_t tensor_size;
+} tensor_recording_header_t;
+
+typedef struct tensor_recorder {
+    FILE* file;
+    char* path;
+    size_t tensor_size;
+    unsigned int max_frames;
+    unsigned int num_frames;
+} tensor_recorder_t;
+
+/**
+ * @brief Create a recording, the file is replaced if it exists.
+ *
+ * @param max_frames Number of tensors to record, the later ones are ignored.
+ *
+ * @return The recorder, or NULL if the file could not be written.
+ */
+tensor_recorder_t* tensor_recorder_open(const char* path,
+                                        const model_params_t* model_params,
+                                        const postprocessing_params_t* params,
+                                        unsigned int max_frames);
+
+/**
+ * @brief Add the output tensor of a frame, the file is closed when max_frames have been added.
+ */
+void tensor_recorder_write(tensor_recorder_t* recorder, const uint8_t* tensor);
+
+/**
+ * @brief Close the recording and free the recorder.
+ */
+void tensor_recorder_close(tensor_recorder_t* recorder);
+
+/**
+ * @brief Read all tensors of a recording.
+ *
+ * @param header     Set to the header of the recording.
+ * @param tensors    Set to the tensors one after the other, to be freed by the caller.
+ * @param num_frames Set to the number of tensors.
+ *
+ * @return False if the file could not be read or is not a recording.
+ */
+bool tensor_recording_load(const char* path,
+                           tensor_recording_header_t* header,
+                           uint8_t** tensors,
+                           size_t* num_frames);
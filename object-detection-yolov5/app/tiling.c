@@ -0,0 +1,116 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "tiling.h"
+
+#include <math.h>
+
+static unsigned int align_even(float value) {
+    return ((unsigned int)value) & ~1u;
+}
+
+void tiling_stream_size(unsigned int model_width,
+                        unsigned int model_height,
+                        unsigned int columns,
+                        float overlap,
+                        unsigned int aspect_width,
+                        unsigned int aspect_height,
+                        unsigned int* stream_width,
+                        unsigned int* stream_height) {
+    // Each column adds one tile width except for the overlap with the previous column
+    float span   = (float)columns - (float)(columns - 1) * overlap;
+    float width  = ceilf((float)model_width * span);
+    float height = (float)model_height;
+    if (aspect_width > 0 && aspect_height > 0) {
+        height = fmaxf(ceilf(width * (float)aspect_height / (float)aspect_width), height);
+    }
+    *stream_width  = (unsigned int)width;
+    *stream_height = (unsigned int)height;
+}
+
+/**
+ * @brief Spread the tiles of one dimension evenly, the first and last at the edges.
+ */
+static unsigned int tile_offset(unsigned int index,
+                                unsigned int count,
+                                unsigned int frame_size,
+                                unsigned int tile_size) {
+    if (count == 1) {
+        return (frame_size - tile_size) / 2;
+    }
+    return align_even((float)index * (float)(frame_size - tile_size) / (float)(count - 1));
+}
+
+unsigned int tiling_layout(unsigned int stream_width,
+                           unsigned int stream_height,
+                           unsigned int model_width,
+                           unsigned int model_height,
+                           unsigned int columns,
+                           float overlap,
+                           bool add_full_frame,
+                           tile_t* tiles,
+                           unsigned int max_tiles) {
+    if (columns == 0) {
+        return 0;
+    }
+    float span        = (float)columns - (float)(columns - 1) * overlap;
+    float tile_width  = fminf((float)stream_width / span, (float)stream_width);
+    float tile_height = tile_width * (float)model_height / (float)model_width;
+    unsigned int rows = 1;
+    if (tile_height < (float)stream_height) {
+        // Add rows, overlapping as much as the columns, until the frame is covered. A row that
+        // would only cover a small strip is left out and the tiles are made a bit taller instead.
+        float extra_rows = ceilf(((float)stream_height - tile_height) /
+                                     (tile_height * (1.0f - overlap)) -
+                                 overlap);
+        if (extra_rows > 0.0f) {
+            rows += (unsigned int)extra_rows;
+        }
+    }
+    float covered_height = tile_height * ((float)rows - (float)(rows - 1) * overlap);
+    if (covered_height < (float)stream_height) {
+        tile_height *= (float)stream_height / covered_height;
+    }
+    tile_height = fminf(tile_height, (float)stream_height);
+
+    // A single tile is stretched to the whole frame, a full frame tile would only repeat it
+    add_full_frame         = add_full_frame && rows * columns > 1;
+    unsigned int num_tiles = rows * columns + (add_full_frame ? 1 : 0);
+    if (num_tiles > max_tiles) {
+        return 0;
+    }
+
+    unsigned int width  = align_even(tile_width);
+    unsigned int height = align_even(tile_height);
+    unsigned int count  = 0;
+    for (unsigned int row = 0; row < rows; row++) {
+        for (unsigned int column = 0; column < columns; column++) {
+            tile_t* tile = &tiles[count++];
+            tile->x      = tile_offset(column, columns, stream_width, width);
+            tile->y      = tile_offset(row, rows, stream_height, height);
+            tile->width  = width;
+            tile->height = height;
+        }
+    }
+    if (add_full_frame) {
+        tile_t* tile = &tiles[count++];
+        tile->x      = 0;
+        tile->y      = 0;
+        tile->width  = stream_width;
+        tile->height = stream_height;
+    }
+    return count;
+}
@@ -0,0 +1,83 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Layout of the tiles that a high-resolution frame is split into, so small
+ * objects are detected at close to the native resolution of the stream.
+ *
+ * The tiles have the aspect ratio of the model input, so the preprocessing
+ * scales them without distortion, and neighbouring tiles overlap so an object
+ * on a border is seen whole in at least one of them when it is smaller than
+ * the overlap. A tile with the whole frame can be added for objects larger
+ * than a tile.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+
+typedef struct tile {
+    // Region of the stream in pixels, with even coordinates as needed for NV12 crops
+    unsigned int x;
+    unsigned int y;
+    unsigned int width;
+    unsigned int height;
+} tile_t;
+
+/**
+ * @brief Stream size that gives tiles of about the model input size.
+ *
+ * The width covers the columns, and the height follows from the aspect ratio of the sensor, so
+ * the tiles of every row are at about the model resolution too.
+ *
+ * @param columns       Number of tile columns.
+ * @param overlap       Share of a tile that overlaps its neighbour.
+ * @param aspect_width  Width of the aspect ratio of the stream, e.g. of its largest resolution.
+ * @param aspect_height Height of the aspect ratio of the stream.
+ */
+void tiling_stream_size(unsigned int model_width,
+                        unsigned int model_height,
+                        unsigned int columns,
+                        float overlap,
+                        unsigned int aspect_width,
+                        unsigned int aspect_height,
+                        unsigned int* stream_width,
+                        unsigned int* stream_height);
+
+/**
+ * @brief Lay out the tiles of a frame.
+ *
+ * The number of rows follows from the number of columns and the aspect ratio
+ * of the model input.
+ *
+ * @param columns        Number of tile columns.
+ * @param overlap        Share of a tile that overlaps its neighbour, in [0, 0.5].
+ * @param add_full_frame Also add a last tile with the whole frame, unless a single tile already
+ *                       covers it.
+ * @param tiles          Set to the tiles.
+ * @param max_tiles      Size of the tiles array.
+ *
+ * @return Number of tiles, 0 if they are more than max_tiles.
+ */
+unsigned int tiling_layout(unsigned int stream_width,
+                           unsigned int stream_height,
+                           unsigned int model_width,
+                           unsigned int model_height,
+                           unsigned int columns,
+                           float overlap,
+                           bool add_full_frame,
+                           tile_t* tiles,
+                           unsigned int max_tiles);
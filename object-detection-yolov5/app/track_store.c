@@ -0,0 +1,237 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "track_store.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Minimum overlap for an object without id to be associated with an existing track
+#define MIN_ASSOCIATION_IOU 0.3f
+
+track_store_t* track_store_create(size_t max_tracks,
+                                  unsigned int width,
+                                  unsigned int height,
+                                  float tolerance_px) {
+    // Keep the load factor at or below one half so probe sequences stay short
+    size_t capacity = 16;
+    while (capacity < 2 * max_tracks) {
+        capacity *= 2;
+    }
+
+    track_store_t* store = calloc(1, sizeof(track_store_t));
+    if (!store) {
+        return NULL;
+    }
+    store->tracks      = calloc(capacity, sizeof(track_t));
+    store->used        = calloc(capacity, sizeof(bool));
+    store->removed_ids = calloc(max_tracks > 0 ? max_tracks : 1, sizeof(uint32_t));
+    if (!store->tracks || !store->used || !store->removed_ids) {
+        track_store_destroy(store);
+        return NULL;
+    }
+
+    store->capacity         = capacity;
+    store->max_tracks       = max_tracks;
+    store->tolerance_x      = tolerance_px / (float)width;
+    store->tolerance_y      = tolerance_px / (float)height;
+    store->next_id          = 1;
+    store->diff.removed_ids = store->removed_ids;
+    return store;
+}
+
+void track_store_destroy(track_store_t* store) {
+    if (!store) {
+        return;
+    }
+    free(store->tracks);
+    free(store->used);
+    free(store->removed_ids);
+    free(store);
+}
+
+static size_t home_slot(const track_store_t* store, uint32_t id) {
+    // Knuth's multiplicative hash spreads consecutive ids over the table
+    return (size_t)(id * 2654435761u) & (store->capacity - 1);
+}
+
+/**
+ * @brief Find the slot of an id, or the empty slot where it would be inserted.
+ */
+static size_t find_slot(const track_store_t* store, uint32_t id) {
+    size_t mask = store->capacity - 1;
+    size_t slot = home_slot(store, id);
+    while (store->used[slot] && store->tracks[slot].id != id) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+/**
+ * @brief Remove the track in slot and shift later tracks of the probe sequence back.
+ */
+static void remove_slot(track_store_t* store, size_t slot) {
+    size_t mask = store->capacity - 1;
+    size_t next = (slot + 1) & mask;
+
+    while (store->used[next]) {
+        size_t home = home_slot(store, store->tracks[next].id);
+        // Move the track if its home slot is not in the cyclic range (slot, next]
+        if (((next - home) & mask) >= ((next - slot) & mask)) {
+            store->tracks[slot] = store->tracks[next];
+            slot                = next;
+        }
+        next = (next + 1) & mask;
+    }
+    store->used[slot] = false;
+    store->num_tracks--;
+}
+
+static bool box_moved(const track_store_t* store, const track_box_t* a, const track_box_t* b) {
+    return fabsf(a->x1 - b->x1) > store->tolerance_x || fabsf(a->x2 - b->x2) > store->tolerance_x ||
+           fabsf(a->y1 - b->y1) > store->tolerance_y || fabsf(a->y2 - b->y2) > store->tolerance_y;
+}
+
+static float intersection_over_union(const track_box_t* a, const track_box_t* b) {
+    float inter_w    = fmaxf(0.0f, fminf(a->x2, b->x2) - fmaxf(a->x1, b->x1));
+    float inter_h    = fmaxf(0.0f, fminf(a->y2, b->y2) - fmaxf(a->y1, b->y1));
+    float inter_area = inter_w * inter_h;
+    float union_area = (a->x2 - a->x1) * (a->y2 - a->y1) + (b->x2 - b->x1) * (b->y2 - b->y1) -
+                       inter_area;
+    return union_area > 0.0f ? inter_area / union_area : 0.0f;
+}
+
+void track_store_begin_frame(track_store_t* store) {
+    store->frame++;
+    store->diff.num_added   = 0;
+    store->diff.num_moved   = 0;
+    store->diff.num_removed = 0;
+}
+
+static void update_track(track_store_t* store, track_t* track, int label, const track_box_t* box) {
+    if (track->last_seen == store->frame) {
+        // Updated twice in the same frame, the last update wins
+        if (track->change == TRACK_MOVED) {
+            store->diff.num_moved--;
+        } else if (track->change == TRACK_ADDED) {
+            track->box   = *box;
+            track->label = label;
+            return;
+        }
+    }
+
+    track->last_seen = store->frame;
+    if (track->label != label || box_moved(store, &track->box, box)) {
+        track->box    = *box;
+        track->label  = label;
+        track->change = TRACK_MOVED;
+        store->diff.num_moved++;
+    } else {
+        track->change = TRACK_UNCHANGED;
+    }
+}
+
+static track_t* add_track(track_store_t* store,
+                          size_t slot,
+                          uint32_t id,
+                          int label,
+                          const track_box_t* box) {
+    if (store->num_tracks >= store->max_tracks) {
+        return NULL;
+    }
+
+    track_t* track   = &store->tracks[slot];
+    track->id        = id;
+    track->label     = label;
+    track->box       = *box;
+    track->change    = TRACK_ADDED;
+    track->last_seen = store->frame;
+    store->used[slot] = true;
+    store->num_tracks++;
+    store->diff.num_added++;
+    return track;
+}
+
+bool track_store_update(track_store_t* store, uint32_t id, int label, const track_box_t* box) {
+    size_t slot = find_slot(store, id);
+    if (store->used[slot]) {
+        update_track(store, &store->tracks[slot], label, box);
+        return true;
+    }
+    return add_track(store, slot, id, label, box) != NULL;
+}
+
+uint32_t track_store_update_untracked(track_store_t* store, int label, const track_box_t* box) {
+    track_t* best_track = NULL;
+    float best_iou      = MIN_ASSOCIATION_IOU;
+
+    for (size_t i = 0; i < store->capacity; i++) {
+        track_t* track = &store->tracks[i];
+        if (!store->used[i] || track->label != label || track->last_seen == store->frame) {
+            continue;
+        }
+        float iou = intersection_over_union(&track->box, box);
+        if (iou >= best_iou) {
+            best_iou   = iou;
+            best_track = track;
+        }
+    }
+
+    if (best_track) {
+        update_track(store, best_track, label, box);
+        return best_track->id;
+    }
+
+    if (store->num_tracks >= store->max_tracks) {
+        return 0;
+    }
+    // Find an unused id, 0 is reserved to tell that the store is full
+    while (true) {
+        uint32_t id = store->next_id++;
+        if (id == 0) {
+            continue;
+        }
+        size_t slot = find_slot(store, id);
+        if (!store->used[slot]) {
+            add_track(store, slot, id, label, box);
+            return id;
+        }
+    }
+}
+
+const track_diff_t* track_store_end_frame(track_store_t* store) {
+    size_t i = 0;
+    while (i < store->capacity) {
+        if (store->used[i] && store->tracks[i].last_seen != store->frame) {
+            store->removed_ids[store->diff.num_removed++] = store->tracks[i].id;
+            // A later track may be shifted into this slot, so check it again
+            remove_slot(store, i);
+        } else {
+            i++;
+        }
+    }
+    return &store->diff;
+}
+
+const track_t* track_store_next(const track_store_t* store, size_t* position) {
+    for (; *position < store->capacity; (*position)++) {
+        if (store->used[*position]) {
+            return &store->tracks[(*position)++];
+        }
+    }
+    return NULL;
+}
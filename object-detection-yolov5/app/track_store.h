@@ -0,0 +1,147 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * A store of the drawn objects, indexed by track id, that tells what changed
+ * since the previous frame.
+ *
+ * Each frame, all current objects are passed to the store, which compares them
+ * with the geometry that was drawn last. An object only counts as moved when
+ * one of its edges has moved more than the pixel tolerance, otherwise the drawn
+ * geometry is kept. The resulting diff tells a renderer whether anything needs
+ * to be drawn at all, so stationary objects do not cause a commit every frame.
+ * The store does not depend on any drawing API and can be used with bbox as
+ * well as with axoverlay.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct track_box {
+    float x1;
+    float y1;
+    float x2;
+    float y2;
+} track_box_t;
+
+typedef enum track_change {
+    TRACK_UNCHANGED = 0,
+    TRACK_ADDED,
+    TRACK_MOVED,
+} track_change_t;
+
+typedef struct track {
+    uint32_t id;
+    int label;
+    // The geometry to draw, only updated when the object moves beyond the tolerance
+    track_box_t box;
+    // How the track changed in the last frame
+    track_change_t change;
+    uint64_t last_seen;
+} track_t;
+
+typedef struct track_diff {
+    size_t num_added;
+    size_t num_moved;
+    size_t num_removed;
+    // Ids of the tracks removed in the last frame, num_removed entries
+    const uint32_t* removed_ids;
+} track_diff_t;
+
+typedef struct track_store {
+    // Open addressing with linear probing, capacity is a power of two
+    track_t* tracks;
+    bool* used;
+    size_t capacity;
+    size_t max_tracks;
+    size_t num_tracks;
+
+    float tolerance_x;
+    float tolerance_y;
+    uint64_t frame;
+    // Ids given to objects passed to track_store_update_untracked()
+    uint32_t next_id;
+
+    track_diff_t diff;
+    uint32_t* removed_ids;
+} track_store_t;
+
+/**
+ * @brief Create a track store.
+ *
+ * @param max_tracks    Maximum number of tracks in the store.
+ * @param width         Width in pixels of the image the normalized coordinates refer to.
+ * @param height        Height in pixels of the image the normalized coordinates refer to.
+ * @param tolerance_px  An object counts as moved when an edge moves more than this.
+ *
+ * @return Pointer to a new track store, or NULL if the memory could not be allocated.
+ */
+track_store_t* track_store_create(size_t max_tracks,
+                                  unsigned int width,
+                                  unsigned int height,
+                                  float tolerance_px);
+
+void track_store_destroy(track_store_t* store);
+
+/**
+ * @brief Start a new frame. All objects of the frame are then passed to the store.
+ */
+void track_store_begin_frame(track_store_t* store);
+
+/**
+ * @brief Update an object with a known track id.
+ *
+ * @param box Normalized coordinates of the object.
+ *
+ * @return False if the object is new and the store is full.
+ */
+bool track_store_update(track_store_t* store, uint32_t id, int label, const track_box_t* box);
+
+/**
+ * @brief Update an object without track id, e.g. a detection.
+ *
+ * The object is associated with the unseen track of the same label that
+ * overlaps it most, or is added as a new track if no track overlaps it enough.
+ *
+ * @return The track id of the object, 0 if the object is new and the store is full.
+ */
+uint32_t track_store_update_untracked(track_store_t* store, int label, const track_box_t* box);
+
+/**
+ * @brief End the frame and remove the tracks that were not updated in it.
+ *
+ * @return The changes since the previous frame, valid until the next frame is started.
+ */
+const track_diff_t* track_store_end_frame(track_store_t* store);
+
+/**
+ * @brief Check if a diff contains any change that needs to be drawn.
+ */
+static inline bool track_diff_changed(const track_diff_t* diff) {
+    return diff->num_added > 0 || diff->num_moved > 0 || diff->num_removed > 0;
+}
+
+/**
+ * @brief Iterate over the tracks of the store.
+ *
+ * Start with *position set to 0.
+ *
+ * @return The next track, or NULL when all tracks have been visited.
+ */
+const track_t* track_store_next(const track_store_t* store, size_t* position);
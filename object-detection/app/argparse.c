@@ -25,7 +25,11 @@
 #include <argp.h>
 #include <stdlib.h>
 
-#define KEY_USAGE (127)
+#define KEY_USAGE         (127)
+#define KEY_RECORD_FRAMES (128)
+
+// Number of output tensors recorded when --record-frames is not given
+#define DEFAULT_RECORD_FRAMES 20
 
 static int parse_pos_int(char* arg, unsigned long long* i, unsigned long long limit);
 static int parse_opt(int key, char* arg, struct argp_state* state);
@@ -37,6 +41,19 @@ const struct argp_option opts[] = {
      0,
      "Could be axis-a8-dlpu-tflite, a9-dlpu-tflite, google-edge-tpu-tflite or cpu-tflite",
      0},
+    {"record",
+     'r',
+     "FILE",
+     0,
+     "Record the output tensors of the model to FILE, to be replayed by "
+     "postprocessing_benchmark.",
+     0},
+    {"record-frames",
+     KEY_RECORD_FRAMES,
+     "COUNT",
+     0,
+     "Number of output tensors to record, 20 if not specified.",
+     0},
     {"help", 'h', NULL, 0, "Print this help text and exit.", 0},
     {"usage", KEY_USAGE, NULL, 0, "Print short usage message and exit.", 0},
     {0}};
@@ -70,6 +87,15 @@ int parse_opt(int key, char* arg, struct argp_state* state) {
         case 'd':
             args->device_name = arg;
             break;
+        case 'r':
+            args->record_file = arg;
+            break;
+        case KEY_RECORD_FRAMES:
+            args->record_frames = (unsigned int)strtoul(arg, NULL, 10);
+            if (args->record_frames == 0) {
+                argp_error(state, "Invalid number of frames to record %s", arg);
+            }
+            break;
         case 'h':
             argp_state_help(state, stdout, ARGP_HELP_STD_HELP);
             break;
@@ -93,10 +119,12 @@ int parse_opt(int key, char* arg, struct argp_state* state) {
             }
             break;
         case ARGP_KEY_INIT:
-            args->threshold   = 0;
-            args->device_name = NULL;
-            args->model_file  = NULL;
-            args->labels_file = NULL;
+            args->threshold     = 0;
+            args->device_name   = NULL;
+            args->model_file    = NULL;
+            args->labels_file   = NULL;
+            args->record_file   = NULL;
+            args->record_frames = DEFAULT_RECORD_FRAMES;
             break;
         case ARGP_KEY_END:
             if (state->arg_num < 1 || state->arg_num > 3) {
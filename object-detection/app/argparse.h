@@ -29,6 +29,9 @@ typedef struct args_t {
     char* labels_file;
     unsigned threshold;
     char* device_name;
+    // File to record the output tensors to, NULL to not record
+    char* record_file;
+    unsigned int record_frames;
 } args_t;
 
 void parse_args(int argc, char** argv, args_t* args);
@@ -0,0 +1,77 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * This file handles the memory of the data that only lives for one frame.
+ */
+
+#include "frame_arena.h"
+
+#include <stdalign.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <syslog.h>
+
+#define FRAME_ARENA_ALIGNMENT (alignof(max_align_t))
+
+frame_arena_t* frame_arena_create(size_t capacity) {
+    frame_arena_t* arena = calloc(1, sizeof(frame_arena_t));
+    if (!arena) {
+        return NULL;
+    }
+    // malloc aligns for any type, so the offsets only have to be aligned
+    arena->data = malloc(capacity > 0 ? capacity : 1);
+    if (!arena->data) {
+        free(arena);
+        return NULL;
+    }
+    arena->capacity = capacity;
+    return arena;
+}
+
+void frame_arena_destroy(frame_arena_t* arena) {
+    if (!arena) {
+        return;
+    }
+    syslog(LOG_INFO,
+           "Frame arena used at most %zu of %zu bytes in a frame",
+           arena->peak,
+           arena->capacity);
+    free(arena->data);
+    free(arena);
+}
+
+void* frame_arena_alloc(frame_arena_t* arena, size_t count, size_t size) {
+    if (size != 0 && count > SIZE_MAX / size) {
+        return NULL;
+    }
+    const size_t bytes = count * size;
+    const size_t start =
+        (arena->used + FRAME_ARENA_ALIGNMENT - 1) & ~(size_t)(FRAME_ARENA_ALIGNMENT - 1);
+    if (start > arena->capacity || bytes > arena->capacity - start) {
+        return NULL;
+    }
+
+    arena->used = start + bytes;
+    if (arena->used > arena->peak) {
+        arena->peak = arena->used;
+    }
+    return arena->data + start;
+}
+
+void frame_arena_reset(frame_arena_t* arena) {
+    arena->used = 0;
+}
@@ -0,0 +1,63 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * This header file handles the memory of the data that only lives for one frame.
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+/**
+ * @brief A bump allocator for the data of a frame.
+ *
+ * The memory is allocated once when the arena is created. An allocation takes the next bytes of
+ * it and the whole arena is released at once when the frame is done, so the frame loop never
+ * calls malloc and the heap does not fragment over the lifetime of the application.
+ */
+typedef struct frame_arena {
+    unsigned char* data;
+    size_t capacity;
+    size_t used;
+    // Most bytes used by a frame, logged when the arena is destroyed
+    size_t peak;
+} frame_arena_t;
+
+/**
+ * @brief Create an arena.
+ *
+ * @param capacity  Number of bytes a frame can allocate.
+ *
+ * @return Pointer to a new arena, or NULL if the memory could not be allocated.
+ */
+frame_arena_t* frame_arena_create(size_t capacity);
+
+void frame_arena_destroy(frame_arena_t* arena);
+
+/**
+ * @brief Allocate an array from the arena, valid until the next frame_arena_reset().
+ *
+ * The memory is aligned for any type and is not cleared.
+ *
+ * @return Pointer to the array, or NULL if the arena does not have room for it.
+ */
+void* frame_arena_alloc(frame_arena_t* arena, size_t count, size_t size);
+
+/**
+ * @brief Release everything allocated from the arena. Called when a frame is done.
+ */
+void frame_arena_reset(frame_arena_t* arena);
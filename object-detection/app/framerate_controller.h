@@ -0,0 +1,83 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * This header file handles the adaptive framerate calculation of the application.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+
+typedef struct framerate_controller_params {
+    // The framerate is kept within [min_framerate, max_framerate]
+    double min_framerate;
+    double max_framerate;
+    // Weight of the newest analysis time in the moving average, in (0, 1]
+    double smoothing;
+    // Fraction of the time between two frames that the analysis is allowed to use
+    double latency_budget;
+    // Relative change of the wanted framerate needed before the framerate is changed
+    double hysteresis;
+    // Minimum number of analyzed frames between two framerate changes
+    unsigned int hold_frames;
+} framerate_controller_params_t;
+
+/**
+ * @brief A type keeping track of the analysis time and the framerate to use.
+ *
+ * The analysis time is smoothed with an exponentially weighted moving average and the framerate
+ * is only changed when the framerate that fits the latency budget is outside a band around the
+ * current framerate. This keeps the framerate stable when the analysis time is close to the time
+ * between two frames.
+ */
+typedef struct framerate_controller {
+    framerate_controller_params_t params;
+    double framerate;
+    double mean_analysis_time;
+    bool has_analysis_time;
+    unsigned int frames_since_change;
+} framerate_controller_t;
+
+/**
+ * @brief Get the default parameters for the framerate controller.
+ *
+ * @param max_framerate  The highest framerate the controller may choose.
+ * @param params         Set to the default parameters.
+ */
+void framerate_controller_default_params(double max_framerate,
+                                         framerate_controller_params_t* params);
+
+/**
+ * @brief Initialize a framerate controller.
+ *
+ * @param controller  The controller to initialize.
+ * @param params      Parameters for the controller.
+ * @param framerate   The framerate currently used by the stream.
+ */
+void framerate_controller_init(framerate_controller_t* controller,
+                               const framerate_controller_params_t* params,
+                               double framerate);
+
+/**
+ * @brief Add the analysis time of a frame and calculate a new framerate if needed.
+ *
+ * @param controller     The controller to be used.
+ * @param analysis_time  Time in ms for the analysis of the latest frame.
+ *
+ * @return true if controller->framerate was changed and should be set for the stream.
+ */
+bool framerate_controller_update(framerate_controller_t* controller, double analysis_time);
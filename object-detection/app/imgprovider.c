@@ -35,61 +35,23 @@
 
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(VdoResolutionSet, g_free);
 
-#define IMG_PROVIDER_ANALYSIS_MAX (10)
+static void update_framerate(img_provider_t* provider, unsigned analysis_time) {
+    g_autoptr(GError) error = NULL;
+    double old_framerate    = provider->img_info->framerate;
 
-/**
- * @brief Calculate a new img provider framerate based on inference time
- *
- * @param provider        The img provider to be used
- * @param analysis_time   Time in ms for the analysis
- *
- */
-static void calculate_new_framerate(img_provider_t* provider, unsigned int analysis_time) {
-    if (analysis_time > 201) {
-        provider->img_info->framerate = 1.0;
-        provider->frametime           = 1001;
+    if (!framerate_controller_update(&provider->framerate_controller, analysis_time)) {
         return;
     }
-    if (analysis_time < 34) {
-        provider->img_info->framerate = 30.0;
-        provider->frametime           = 34;
-    } else if (analysis_time < 41) {
-        provider->img_info->framerate = 25.0;
-        provider->frametime           = 41;
-    } else if (analysis_time < 51) {
-        provider->img_info->framerate = 20.0;
-        provider->frametime           = 51;
-    } else if (analysis_time < 67) {
-        provider->img_info->framerate = 15.0;
-        provider->frametime           = 67;
-    } else if (analysis_time < 101) {
-        provider->img_info->framerate = 10.0;
-        provider->frametime           = 101;
-    } else if (analysis_time < 201) {
-        provider->img_info->framerate = 5.0;
-        provider->frametime           = 201;
+    provider->img_info->framerate = provider->framerate_controller.framerate;
+    if (!vdo_stream_set_framerate(provider->vdo_stream, provider->img_info->framerate, &error)) {
+        panic("%s: Failed to change framerate: %s", __func__, error->message);
     }
-    if (provider->img_info->framerate > provider->wanted_framerate) {
-        provider->img_info->framerate = provider->wanted_framerate;
-    }
-}
-
-static void update_framerate(img_provider_t* provider, unsigned analysis_time) {
-    g_autoptr(GError) error    = NULL;
-    unsigned int old_frametime = provider->frametime;
-
-    calculate_new_framerate(provider, analysis_time);
-    if (old_frametime != provider->frametime) {
-        if (!vdo_stream_set_framerate(provider->vdo_stream,
-                                      provider->img_info->framerate,
-                                      &error)) {
-            panic("%s: Failed to change framerate: %s", __func__, error->message);
-        }
-        syslog(LOG_INFO,
-               "Change VDO stream framerate to %f because of the mean analysis time %u ms",
-               provider->img_info->framerate,
-               analysis_time);
-        // Flush all frames in vdo so the latest is used
+    syslog(LOG_INFO,
+           "Change VDO stream framerate to %f because of the mean analysis time %.1f ms",
+           provider->img_info->framerate,
+           provider->framerate_controller.mean_analysis_time);
+    // Only a lower framerate leaves old frames in vdo, flush them so the latest is used
+    if (provider->img_info->framerate < old_framerate) {
         img_provider_flush_all_frames(provider);
     }
 }
@@ -307,13 +269,15 @@ img_provider_t* img_provider_new(unsigned int input_channel,
     provider->img_info->framerate = vdo_map_get_double(vdo_info, "framerate", framerate);
     provider->img_info->rotation  = vdo_map_get_uint32(vdo_info, "rotation", 0);
     provider->channel             = vdo_map_get_uint32(vdo_info, "channel", 0);
-    provider->wanted_framerate    = framerate;
 
-    // Calculate the time between the images from vdo
-    provider->frametime            = (unsigned int)((1 / provider->img_info->framerate) * 1000);
-    provider->mean_analysis_time   = 0;
-    provider->analysis_frame_count = 0;
-    provider->tot_analysis_time    = 0;
+    const char* buffer_type    = vdo_map_get_string(vdo_info, "buffer.type", NULL, "memfd");
+    provider->img_info->dmabuf = g_strcmp0(buffer_type, "vmem") != 0;
+
+    framerate_controller_params_t framerate_params;
+    framerate_controller_default_params(framerate, &framerate_params);
+    framerate_controller_init(&provider->framerate_controller,
+                              &framerate_params,
+                              provider->img_info->framerate);
 
     provider->vdo_stream = g_steal_pointer(&vdo_stream);
 
@@ -332,22 +296,7 @@ void img_provider_destroy(img_provider_t* provider) {
 bool img_provider_update_framerate(img_provider_t* provider, unsigned analysis_time) {
     assert(provider);
 
-    provider->analysis_frame_count++;
-    provider->tot_analysis_time += analysis_time;
-    if (provider->analysis_frame_count == IMG_PROVIDER_ANALYSIS_MAX) {
-        provider->mean_analysis_time = provider->tot_analysis_time / provider->analysis_frame_count;
-
-        // If the analysis time is higher or lower than the time between frames from
-        // vdo change the framerate so the latest frame will be fetched from vdo
-        if (provider->frametime < provider->mean_analysis_time && provider->frametime < 201) {
-            update_framerate(provider, provider->mean_analysis_time);
-        } else if (provider->frametime > provider->mean_analysis_time) {
-            update_framerate(provider, provider->mean_analysis_time);
-        }
-        provider->mean_analysis_time   = 0;
-        provider->analysis_frame_count = 0;
-        provider->tot_analysis_time    = 0;
-    }
+    update_framerate(provider, analysis_time);
 
     return true;
 }
@@ -23,6 +23,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "framerate_controller.h"
 #include "vdo-error.h"
 #include "vdo-stream.h"
 #include "vdo-types.h"
@@ -43,6 +44,8 @@ typedef struct img_info {
     unsigned int pitch;
     double framerate;
     unsigned int rotation;
+    // True if the buffers are dma-bufs, otherwise they are vmem and need converting for larod
+    bool dmabuf;
 } img_info_t;
 
 /**
@@ -67,13 +70,9 @@ typedef struct img_provider {
     img_info_t* img_info;
 
     // Used for chaging framerate if needed
-    unsigned int frametime;
-    unsigned int mean_analysis_time;
-    unsigned int analysis_frame_count;
-    unsigned int tot_analysis_time;
+    framerate_controller_t framerate_controller;
 
     int fd;
-    double wanted_framerate;
 } img_provider_t;
 
 /**
@@ -16,116 +16,125 @@
 
 #include "labelparse.h"
 
-#include "panic.h"
-
 #include <errno.h>
 #include <fcntl.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <syslog.h>
 #include <unistd.h>
 
-void parse_labels(char*** labels_ptr,
-                  char** label_file_buffer,
-                  const char* labels_path,
-                  size_t* num_labels_ptr) {
-    // We cut off every row at 60 characters.
-    const size_t LINE_MAX_LEN = 60;
-    char* labels_data         = NULL;  // Buffer containing the label file contents.
-    char** label_array        = NULL;  // Pointers to each line in the labels text.
+// We cut off every label at 60 characters
+#define LABEL_MAX_LEN 60
+// We will not encounter larger label files, and the offsets of the table fit in 32 bits
+#define LABEL_FILE_MAX_SIZE (10 * 1024 * 1024)
 
-    struct stat file_stats = {0};
-    if (stat(labels_path, &file_stats) < 0) {
-        panic("%s: Unable to get stats for label file %s: %s",
-              __func__,
-              labels_path,
-              strerror(errno));
+/**
+ * @brief Count the lines of the file, a last line without newline included.
+ */
+static size_t count_lines(const char* data, size_t size) {
+    size_t num_lines = 0;
+    const char* end  = data + size;
+
+    for (const char* line = data; line < end; num_lines++) {
+        const char* newline = memchr(line, '\n', (size_t)(end - line));
+        line                = newline ? newline + 1 : end;
     }
+    return num_lines;
+}
 
-    // Sanity checking on the file size - we use size_t to keep track of file
-    // size and to iterate over the contents. off_t is signed and 32-bit or
-    // 64-bit depending on architecture. We just check toward 10 MByte as we
-    // will not encounter larger label files and both off_t and size_t should be
-    // able to represent 10 megabytes on both 32-bit and 64-bit systems.
-    if (file_stats.st_size > (10 * 1024 * 1024)) {
-        panic("%s: failed sanity check on labels file size", __func__);
+label_table_t* label_table_open(const char* labels_path, bool skip_unused) {
+    label_table_t* table = calloc(1, sizeof(label_table_t));
+    if (!table) {
+        syslog(LOG_ERR, "%s: Unable to allocate label table", __func__);
+        return NULL;
     }
 
     int labels_fd = open(labels_path, O_RDONLY);
     if (labels_fd < 0) {
-        panic("%s: Could not open labels file %s: %s", __func__, labels_path, strerror(errno));
+        syslog(LOG_ERR,
+               "%s: Could not open labels file %s: %s",
+               __func__,
+               labels_path,
+               strerror(errno));
+        goto error;
     }
 
-    size_t labels_file_size = (size_t)file_stats.st_size;
-    // Allocate room for a terminating NULL char after the last line.
-    labels_data = malloc(labels_file_size + 1);
-    if (labels_data == NULL) {
-        panic("%s: Failed allocating labels text buffer: %s", __func__, strerror(errno));
+    struct stat file_stats = {0};
+    if (fstat(labels_fd, &file_stats) < 0) {
+        syslog(LOG_ERR,
+               "%s: Unable to get stats for label file %s: %s",
+               __func__,
+               labels_path,
+               strerror(errno));
+        goto error;
     }
-
-    ssize_t num_bytes_read  = -1;
-    size_t total_bytes_read = 0;
-    char* file_read_ptr     = labels_data;
-    while (total_bytes_read < labels_file_size) {
-        num_bytes_read = read(labels_fd, file_read_ptr, labels_file_size - total_bytes_read);
-
-        if (num_bytes_read < 1) {
-            panic("%s: Failed reading from labels file: %s", __func__, strerror(errno));
-        }
-        total_bytes_read += (size_t)num_bytes_read;
-        file_read_ptr += num_bytes_read;
+    if (file_stats.st_size > LABEL_FILE_MAX_SIZE) {
+        syslog(LOG_ERR, "%s: failed sanity check on labels file size", __func__);
+        goto error;
     }
 
-    // Now count number of lines in the file - check all bytes except the last
-    // one in the file.
-    size_t num_lines = 0;
-    for (size_t i = 0; i < (labels_file_size - 1); i++) {
-        if (labels_data[i] == '\n') {
-            num_lines++;
+    table->size = (size_t)file_stats.st_size;
+    if (table->size > 0) {
+        void* map = mmap(NULL, table->size, PROT_READ, MAP_PRIVATE, labels_fd, 0);
+        if (map == MAP_FAILED) {
+            syslog(LOG_ERR, "%s: Could not map labels file: %s", __func__, strerror(errno));
+            goto error;
         }
+        table->data = map;
     }
-
-    // We assume that there is always a line at the end of the file, possibly
-    // terminated by newline char. Either way add this line as well to the
-    // counter.
-    num_lines++;
-
-    label_array = malloc(num_lines * sizeof(char*));
-    if (!label_array) {
-        panic("%s: Unable to allocate labels array: %s", __func__, strerror(errno));
+    // The mapping stays valid after the file is closed
+    close(labels_fd);
+    labels_fd = -1;
+    if (!table->data) {
+        // An empty file has no labels
+        return table;
     }
 
-    size_t label_idx       = 0;
-    label_array[label_idx] = labels_data;
-    label_idx++;
-    for (size_t i = 0; i < labels_file_size; i++) {
-        if (labels_data[i] == '\n') {
-            if (i < (labels_file_size - 1)) {
-                // Register the string start in the list of labels.
-                label_array[label_idx] = labels_data + i + 1;
-                label_idx++;
-            }
-            // Replace the newline char with string-ending NULL char.
-            labels_data[i] = '\0';
-        }
+    size_t num_lines = count_lines(table->data, table->size);
+    table->entries   = calloc(num_lines, sizeof(label_entry_t));
+    if (!table->entries) {
+        syslog(LOG_ERR, "%s: Unable to allocate labels array: %s", __func__, strerror(errno));
+        goto error;
     }
 
-    // Make sure we always have a terminating NULL char after the label file
-    // contents.
-    labels_data[labels_file_size] = '\0';
+    const char* end = table->data + table->size;
+    for (const char* line = table->data; line < end;) {
+        const char* newline = memchr(line, '\n', (size_t)(end - line));
+        const char* next    = newline ? newline + 1 : end;
+        size_t length       = (size_t)((newline ? newline : end) - line);
 
-    // Now go through the list of strings and cap if strings too long.
-    for (size_t i = 0; i < num_lines; i++) {
-        size_t string_len = strnlen(label_array[i], LINE_MAX_LEN);
-        if (string_len >= LINE_MAX_LEN) {
-            // Just insert capping NULL terminator to limit the string len.
-            *(label_array[i] + LINE_MAX_LEN + 1) = '\0';
+        if (length > 0 && line[length - 1] == '\r') {
+            length--;
+        }
+        if (length > LABEL_MAX_LEN) {
+            length = LABEL_MAX_LEN;
+        }
+        if (!(skip_unused && length == 3 && memcmp(line, "n/a", 3) == 0)) {
+            label_entry_t* entry = &table->entries[table->num_labels++];
+            entry->offset        = (uint32_t)(line - table->data);
+            entry->length        = (uint32_t)length;
         }
+        line = next;
     }
+    return table;
 
-    *labels_ptr        = label_array;
-    *num_labels_ptr    = num_lines;
-    *label_file_buffer = labels_data;
+error:
+    if (labels_fd >= 0) {
+        close(labels_fd);
+    }
+    label_table_close(table);
+    return NULL;
+}
 
-    close(labels_fd);
+void label_table_close(label_table_t* table) {
+    if (!table) {
+        return;
+    }
+    if (table->data) {
+        munmap((void*)table->data, table->size);
+    }
+    free(table->entries);
+    free(table);
 }
@@ -17,6 +17,7 @@
 #include "model.h"
 
 #include "larod.h"
+#include "model_cache.h"
 #include "panic.h"
 
 #include <errno.h>
@@ -29,6 +30,7 @@
 #include <unistd.h>
 
 #define MAX_NBR_POWER_RETRIES 50
+#define MODEL_CACHE_APP_NAME "object_detection"
 
 bool model_get_tensor_output_info(model_provider_t* provider,
                                   unsigned int tensor_output_index,
@@ -40,23 +42,167 @@ bool model_get_tensor_output_info(model_provider_t* provider,
     return true;
 }
 
-static void model_job_handle_no_power(int* nbr_of_retries) {
-    // Currently this will only happen when there is no power
-    //  Just a number but if no power available after 50 retries it is time to give up
-    if (*nbr_of_retries == MAX_NBR_POWER_RETRIES) {
-        panic("Still no power available when running larod job %u, giving up", *nbr_of_retries);
+static larodTensorLayout get_image_layout(VdoFormat format) {
+    switch (format) {
+        case VDO_FORMAT_YUV:
+            return LAROD_TENSOR_LAYOUT_420SP;
+        case VDO_FORMAT_RGB:
+            return LAROD_TENSOR_LAYOUT_NHWC;
+        case VDO_FORMAT_PLANAR_RGB:
+            return LAROD_TENSOR_LAYOUT_NCHW;
+        default:
+            panic("%s: Tensor layout unspecified for format %u", __func__, format);
     }
-    syslog(LOG_INFO, "No power available when running larod job, try nbr %u", *nbr_of_retries);
-    *nbr_of_retries = *nbr_of_retries + 1;
-    usleep(250 * 1000 * *nbr_of_retries);
 }
 
-bool model_run_inference(model_provider_t* provider, VdoBuffer* vdo_buf) {
+/**
+ * @brief Create an input tensor referring to the memory of a VDO buffer and track it in larod.
+ *
+ * Tracking lets larod keep the mapping of the buffer between jobs, so the frames in it are used
+ * by the preprocessing or inference without any copy.
+ */
+static larodTensor** track_image_buffer(model_provider_t* provider, VdoBuffer* vdo_buf) {
+    larodError* error              = NULL;
+    larodTensorLayout image_layout = get_image_layout(provider->image_info.format);
+
+    if (provider->num_image_tensors == MAX_NBR_IMG_PROVIDER_BUFFERS) {
+        panic("%s: More than %d VDO buffers received", __func__, MAX_NBR_IMG_PROVIDER_BUFFERS);
+    }
+    size_t idx = provider->num_image_tensors;
+
+    larodTensor** tensors = larodCreateTensors(1, &error);
+    if (!tensors) {
+        panic("%s: Failed to create image tensor: %s", __func__, error->msg);
+    }
+    if (!larodSetTensorDataType(tensors[0], LAROD_TENSOR_DATA_TYPE_UINT8, &error)) {
+        panic("%s: Failed to set data type: %s", __func__, error->msg);
+    }
+    if (!larodSetTensorLayout(tensors[0], image_layout, &error)) {
+        panic("%s: Failed to set tensor layout: %s", __func__, error->msg);
+    }
+    if (!larodBuildTensorDims(tensors[0],
+                              image_layout,
+                              provider->image_info.width,
+                              provider->image_info.height,
+                              3,
+                              &error)) {
+        panic("%s: Failed to build tensor dims: %s", __func__, error->msg);
+    }
+    if (!larodBuildTensorPitches(tensors[0],
+                                 image_layout,
+                                 provider->image_info.pitch,
+                                 provider->image_info.height,
+                                 3,
+                                 &error)) {
+        panic("%s: Failed to build tensor pitches: %s", __func__, error->msg);
+    }
+    if (!larodSetTensorFdProps(tensors[0], LAROD_FD_PROP_MAP | LAROD_FD_PROP_DMABUF, &error)) {
+        panic("%s: Failed to set fd props: %s", __func__, error->msg);
+    }
+
+    int vdo_buf_fd         = vdo_buffer_get_fd(vdo_buf);
+    int64_t vdo_buf_offset = vdo_buffer_get_offset(vdo_buf);
+    int64_t tensor_offset  = vdo_buf_offset;
+    int tensor_fd          = -1;
+    if (provider->image_info.dmabuf) {
+        // The tensor owns its fd so it stays valid as long as the tensor exists
+        tensor_fd = dup(vdo_buf_fd);
+        if (tensor_fd < 0) {
+            panic("%s: Failed to dup fd: %s", __func__, strerror(errno));
+        }
+    } else {
+        tensor_fd = larodConvertVmemFdToDmabuf(vdo_buf_fd, vdo_buf_offset, &error);
+        if (tensor_fd == LAROD_INVALID_FD) {
+            panic("%s: Failed to convert vmem fd to dma-buf: %s", __func__, error->msg);
+        }
+        tensor_offset = 0;
+    }
+    if (!larodSetTensorFd(tensors[0], tensor_fd, &error)) {
+        panic("%s: Failed to set fd for tensor: %s", __func__, error->msg);
+    }
+    if (!larodSetTensorFdOffset(tensors[0], tensor_offset, &error)) {
+        panic("%s: Failed to set offset for tensor: %s", __func__, error->msg);
+    }
+    if (!larodSetTensorFdSize(tensors[0], vdo_buffer_get_capacity(vdo_buf), &error)) {
+        panic("%s: Failed to set size for tensor: %s", __func__, error->msg);
+    }
+    if (!larodTrackTensor(provider->conn, tensors[0], &error)) {
+        panic("%s: Failed to track tensor: %s", __func__, error->msg);
+    }
+
+    provider->image_tensors[idx]        = tensors;
+    provider->image_buffer_fds[idx]     = vdo_buf_fd;
+    provider->image_buffer_offsets[idx] = vdo_buf_offset;
+    provider->image_tensor_fds[idx]     = tensor_fd;
+    provider->num_image_tensors++;
+    syslog(LOG_INFO, "Tracking VDO buffer %zu as larod input tensor", idx);
+
+    return tensors;
+}
+
+static larodTensor** get_image_tensors(model_provider_t* provider, VdoBuffer* vdo_buf) {
+    int vdo_buf_fd = vdo_buffer_get_fd(vdo_buf);
+    if (vdo_buf_fd < 0) {
+        panic("%s: fd from vdo_buffer_get_fd is negative", __func__);
+    }
+    int64_t vdo_buf_offset = vdo_buffer_get_offset(vdo_buf);
+
+    // Several vmem buffers may share one fd, so the offset is part of the identity
+    for (size_t i = 0; i < provider->num_image_tensors; i++) {
+        if (provider->image_buffer_fds[i] == vdo_buf_fd &&
+            provider->image_buffer_offsets[i] == vdo_buf_offset) {
+            return provider->image_tensors[i];
+        }
+    }
+    return track_image_buffer(provider, vdo_buf);
+}
+
+/**
+ * @brief Use the tracked tensor of a VDO buffer as input to the first job request.
+ *
+ * The input job request is created here the first time since larod needs the input tensors
+ * when the request is created.
+ */
+static void set_input(model_provider_t* provider, VdoBuffer* vdo_buf) {
     larodError* error            = NULL;
-    static int nbr_power_retries = 0;
+    larodTensor** input_tensors  = get_image_tensors(provider, vdo_buf);
+    larodJobRequest** input_req  = &provider->inf_req;
+    larodModel* input_model      = provider->model;
+    larodTensor** output_tensors = provider->output_tensors;
+    size_t num_outputs           = provider->num_outputs;
+
+    if (provider->use_preprocessing) {
+        input_req      = &provider->pp_req;
+        input_model    = provider->pp_model;
+        output_tensors = provider->pp_output_tensors;
+        num_outputs    = provider->pp_num_outputs;
+    }
 
-    uint8_t* data = vdo_buffer_get_data(vdo_buf);
-    memcpy(provider->image_input_addr, data, provider->image_buffer_size);
+    if (*input_req) {
+        if (!larodSetJobRequestInputs(*input_req, input_tensors, 1, &error)) {
+            panic("%s: Failed to set input job request: %s", __func__, error->msg);
+        }
+        return;
+    }
+    *input_req = larodCreateJobRequest(input_model,
+                                       input_tensors,
+                                       1,
+                                       output_tensors,
+                                       num_outputs,
+                                       NULL,
+                                       &error);
+    if (!*input_req) {
+        panic("%s: Failed creating input job request: %s", __func__, error->msg);
+    }
+}
+
+bool model_run_inference(model_provider_t* provider, VdoBuffer* vdo_buf) {
+    larodError* error = NULL;
+
+    if (!power_backoff_ready(&provider->power_backoff)) {
+        return false;
+    }
+    set_input(provider, vdo_buf);
     // If the inference failed because of no power no need to run
     // the preprocssing job again
     if (provider->use_preprocessing) {
@@ -68,10 +214,9 @@ bool model_run_inference(model_provider_t* provider, VdoBuffer* vdo_buf) {
                       error->code);
             }
             larodClearError(&error);
-            model_job_handle_no_power(&nbr_power_retries);
+            power_backoff_failed(&provider->power_backoff);
             return false;
         }
-        nbr_power_retries = 0;
     }
 
     if (!larodRunJob(provider->conn, provider->inf_req, &error)) {
@@ -82,50 +227,10 @@ bool model_run_inference(model_provider_t* provider, VdoBuffer* vdo_buf) {
                   error->code);
         }
         larodClearError(&error);
-        model_job_handle_no_power(&nbr_power_retries);
+        power_backoff_failed(&provider->power_backoff);
         return false;
     }
-    nbr_power_retries = 0;
-    return true;
-}
-
-static bool setup_input_tensor_metadata(unsigned int pitch,
-                                        unsigned int height,
-                                        larodTensorLayout model_layout,
-                                        larodTensor* tensor) {
-    larodError* error          = NULL;
-    larodTensorPitches pitches = {0};
-
-    // Update the pitch dependent on the layout used
-    switch (model_layout) {
-        case LAROD_TENSOR_LAYOUT_420SP:
-            pitches.len        = 3;
-            pitches.pitches[2] = pitch;
-            pitches.pitches[1] = height * pitches.pitches[2];
-            pitches.pitches[0] = 3 * pitches.pitches[1] / 2;
-            break;
-        case LAROD_TENSOR_LAYOUT_NHWC:
-            pitches.len        = 4;
-            pitches.pitches[3] = 3;
-            pitches.pitches[2] = pitch;
-            pitches.pitches[1] = height * pitches.pitches[2];
-            pitches.pitches[0] = 1 * pitches.pitches[1];
-            break;
-        case LAROD_TENSOR_LAYOUT_NCHW:
-            pitches.len        = 4;
-            pitches.pitches[3] = pitch;
-            pitches.pitches[2] = height * pitches.pitches[3];
-            pitches.pitches[1] = 3 * pitches.pitches[2];
-            pitches.pitches[0] = 1 * pitches.pitches[1];
-            break;
-        default:
-            break;
-    }
-
-    if (!larodSetTensorPitches(tensor, &pitches, &error)) {
-        panic("%s: Failed to set tensor pitches: %s", __func__, error->msg);
-    }
-
+    power_backoff_succeeded(&provider->power_backoff);
     return true;
 }
 
@@ -137,9 +242,12 @@ static void setup_tensors(larodConnection* conn,
                           size_t* num_outputs) {
     larodError* error = NULL;
 
-    *input_tensors = larodAllocModelInputs(conn, model, 0, num_inputs, NULL, &error);
-    if (!*input_tensors) {
-        panic("%s: Failed retrieving input tensors: %s", __func__, error->msg);
+    // The input tensors are optional since the inputs of a job normally are the VDO buffers
+    if (input_tensors) {
+        *input_tensors = larodAllocModelInputs(conn, model, 0, num_inputs, NULL, &error);
+        if (!*input_tensors) {
+            panic("%s: Failed retrieving input tensors: %s", __func__, error->msg);
+        }
     }
     *output_tensors = larodAllocModelOutputs(conn, model, 0, num_outputs, NULL, &error);
     if (!*output_tensors) {
@@ -189,13 +297,31 @@ static larodModel* create_inference_model(model_provider_t* provider,
            labels_file);
 
     const larodDevice* device = larodGetDevice(provider->conn, device_name, 0, &error);
+    // A model compiled by an earlier run of the application is used if larod still has it
+    char cache_name[MODEL_CACHE_NAME_SIZE];
+    bool use_cache = model_cache_name(MODEL_CACHE_APP_NAME,
+                                      provider->larod_model_fd,
+                                      device_name,
+                                      cache_name,
+                                      sizeof(cache_name));
+    if (use_cache) {
+        larodModel* cached =
+            model_cache_lookup(provider->conn, MODEL_CACHE_APP_NAME, device_name, cache_name);
+        if (cached) {
+            syslog(LOG_INFO, "Using cached model %s", cache_name);
+            return cached;
+        }
+    }
+    larodAccess access     = use_cache ? LAROD_ACCESS_PUBLIC : LAROD_ACCESS_PRIVATE;
+    const char* model_name = use_cache ? cache_name : "Object detection model";
+
     syslog(LOG_INFO,
            "Loading the model... This might take up to 5 minutes depending on your device model.");
     larodModel* model = larodLoadModel(provider->conn,
                                        provider->larod_model_fd,
                                        device,
-                                       LAROD_ACCESS_PRIVATE,
-                                       "Object detection model",
+                                       access,
+                                       model_name,
                                        NULL,
                                        &error);
     if (!model && error->code != LAROD_ERROR_POWER_NOT_AVAILABLE) {
@@ -208,8 +334,8 @@ static larodModel* create_inference_model(model_provider_t* provider,
         model = larodLoadModel(provider->conn,
                                provider->larod_model_fd,
                                device,
-                               LAROD_ACCESS_PRIVATE,
-                               "Object detection model",
+                               access,
+                               model_name,
                                NULL,
                                &error);
         // Sleep between retries
@@ -318,21 +444,18 @@ void model_provider_destroy(model_provider_t* provider) {
         panic("%s: Invalid pointer to model_provider_t", __func__);
     }
 
+    larodDestroyModel(&provider->pp_model);
     larodDestroyModel(&provider->model);
-    // Only the model handle is released here. We count on larod service to
-    // release the privately loaded model when the session is disconnected in
+    // Only the model handles are released here. The inference model is loaded
+    // public, see model_cache.h, so larod keeps it for the next start. The
+    // private models, the preprocessing model and an inference model that could
+    // not be cached, are released by larod when the session is disconnected in
     // larodDisconnect().
     larodDisconnect(&(provider->conn), NULL);
 
     if (provider->larod_model_fd >= 0) {
         close(provider->larod_model_fd);
     }
-    if (provider->image_input_addr != MAP_FAILED) {
-        munmap(provider->image_input_addr, provider->image_buffer_size);
-    }
-    if (provider->image_input_fd >= 0) {
-        close(provider->image_input_fd);
-    }
     for (size_t i = 0; i < provider->num_outputs; i++) {
         if (provider->model_output_tensors[i].data != MAP_FAILED) {
             munmap(provider->model_output_tensors[i].data, provider->model_output_tensors[i].size);
@@ -349,10 +472,10 @@ void model_provider_destroy(model_provider_t* provider) {
         free(provider->img_info);
     }
 
-    larodDestroyTensors(provider->conn,
-                        &provider->pp_input_tensors,
-                        provider->pp_num_inputs,
-                        &error);
+    for (size_t i = 0; i < provider->num_image_tensors; i++) {
+        larodDestroyTensors(provider->conn, &provider->image_tensors[i], 1, &error);
+        close(provider->image_tensor_fds[i]);
+    }
     larodDestroyTensors(provider->conn,
                         &provider->pp_output_tensors,
                         provider->pp_num_outputs,
@@ -457,23 +580,24 @@ img_info_t model_provider_get_model_metadata(model_provider_t* provider) {
 bool model_provider_update_image_metadata(model_provider_t* provider, img_info_t* img_info) {
     larodError* error = NULL;
 
-    larodModel* pp_model        = NULL;
     provider->use_preprocessing = false;
     if (img_info->format != provider->img_info->format ||
         provider->img_info->width != img_info->width ||
         provider->img_info->height != img_info->height) {
         provider->use_preprocessing = true;
     }
+    provider->image_info = *img_info;
 
     if (provider->use_preprocessing) {
-        pp_model = create_preprocessing_model(provider, img_info);
+        provider->pp_model = create_preprocessing_model(provider, img_info);
         setup_tensors(provider->conn,
-                      pp_model,
-                      &provider->pp_input_tensors,
-                      &provider->pp_num_inputs,
+                      provider->pp_model,
+                      NULL,
+                      NULL,
                       &provider->pp_output_tensors,
                       &provider->pp_num_outputs);
-        if (provider->pp_num_inputs > 1) {
+        provider->pp_num_inputs = larodGetModelNumInputs(provider->pp_model, &error);
+        if (provider->pp_num_inputs != 1) {
             panic("%s Currently only 1 pp input tensor is supported but %zu was received",
                   __func__,
                   provider->pp_num_inputs);
@@ -484,83 +608,8 @@ bool model_provider_update_image_metadata(model_provider_t* provider, img_info_t
                   provider->pp_num_outputs);
         }
 
-        // Needed to be used for copying data
-        // No need to setup input tensor metadata since it will all be handled by the map
-        // that is setup in the create_preprocessing_model function.
-        provider->image_input_fd = larodGetTensorFd(provider->pp_input_tensors[0], &error);
-        if (provider->image_input_fd != LAROD_INVALID_FD) {
-            // Determine tensor buffer sizes
-            if (!larodGetTensorFdSize(provider->pp_input_tensors[0],
-                                      &provider->image_buffer_size,
-                                      &error)) {
-                panic("%s: Could not get byte size of tensor: %s", __func__, error->msg);
-            }
-            provider->image_input_addr = mmap(NULL,
-                                              provider->image_buffer_size,
-                                              PROT_READ | PROT_WRITE,
-                                              MAP_SHARED,
-                                              provider->image_input_fd,
-                                              0);
-            if (provider->image_input_addr == MAP_FAILED) {
-                panic("%s: Could not map pp input tensors fd: %s", __func__, strerror(errno));
-            }
-        }
-    } else {
-        if (provider->img_info->pitch != img_info->pitch) {
-            panic("%s: Incorrect stream pitch %u != %u",
-                  __func__,
-                  img_info->pitch,
-                  provider->img_info->pitch);
-        }
-        larodTensorLayout model_layout = LAROD_TENSOR_LAYOUT_UNSPECIFIED;
-        if (provider->img_info->format == VDO_FORMAT_RGB) {
-            model_layout = LAROD_TENSOR_LAYOUT_NHWC;
-        } else if (provider->img_info->format == VDO_FORMAT_PLANAR_RGB) {
-            model_layout = LAROD_TENSOR_LAYOUT_NCHW;
-        }
-        if (model_layout == LAROD_TENSOR_LAYOUT_UNSPECIFIED) {
-            panic("%s Model layout unspecified for format %u",
-                  __func__,
-                  provider->img_info->format);
-        }
-        setup_input_tensor_metadata(img_info->pitch,
-                                    img_info->height,
-                                    model_layout,
-                                    provider->input_tensors[0]);
-        // Needed to be used for copying data
-        provider->image_input_fd = larodGetTensorFd(provider->input_tensors[0], &error);
-        if (provider->image_input_fd != LAROD_INVALID_FD) {
-            // Determine tensor buffer sizes
-            if (!larodGetTensorFdSize(provider->input_tensors[0],
-                                      &provider->image_buffer_size,
-                                      &error)) {
-                panic("%s: Could not get byte size of tensor: %s", __func__, error->msg);
-            }
-            provider->image_input_addr = mmap(NULL,
-                                              provider->image_buffer_size,
-                                              PROT_READ | PROT_WRITE,
-                                              MAP_SHARED,
-                                              provider->image_input_fd,
-                                              0);
-            if (provider->image_input_addr == MAP_FAILED) {
-                panic("%s: Could not map input tensors fd: %s", __func__, strerror(errno));
-            }
-        }
-    }
-
-    if (provider->use_preprocessing) {
-        // Create job requests
-        provider->pp_req = larodCreateJobRequest(pp_model,
-                                                 provider->pp_input_tensors,
-                                                 provider->pp_num_inputs,
-                                                 provider->pp_output_tensors,
-                                                 provider->pp_num_outputs,
-                                                 NULL,
-                                                 &error);
-        if (!provider->pp_req) {
-            panic("%s: Failed creating preprocessing job request: %s", __func__, error->msg);
-        }
-
+        // No need to setup input tensor metadata for the preprocessing since it will all be
+        // handled by the map that is setup in the create_preprocessing_model function.
         // App supports only one input/output tensor.
         provider->inf_req = larodCreateJobRequest(provider->model,
                                                   provider->pp_output_tensors,
@@ -572,21 +621,13 @@ bool model_provider_update_image_metadata(model_provider_t* provider, img_info_t
         if (!provider->inf_req) {
             panic("%s: Failed creating inference job request: %s", __func__, error->msg);
         }
-    } else {
-        // App supports only one input/output tensor.
-        provider->inf_req = larodCreateJobRequest(provider->model,
-                                                  provider->input_tensors,
-                                                  provider->num_inputs,
-                                                  provider->output_tensors,
-                                                  provider->num_outputs,
-                                                  NULL,
-                                                  &error);
-        if (!provider->inf_req) {
-            panic("%s: Failed creating inference job request: %s", __func__, error->msg);
-        }
+    } else if (provider->img_info->pitch != img_info->pitch) {
+        panic("%s: Incorrect stream pitch %u != %u",
+              __func__,
+              img_info->pitch,
+              provider->img_info->pitch);
     }
-
-    larodDestroyModel(&pp_model);
+    // The job request taking the VDO buffers as input is created on the first frame
 
     return true;
 }
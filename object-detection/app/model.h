@@ -18,6 +18,7 @@
 
 #include "imgprovider.h"
 #include "larod.h"
+#include "power_backoff.h"
 #include "vdo-buffer.h"
 #include "vdo-error.h"
 #include "vdo-frame.h"
@@ -35,7 +36,6 @@ typedef struct model_provider {
     larodJobRequest* pp_req;
     larodJobRequest* inf_req;
 
-    larodTensor** pp_input_tensors;
     size_t pp_num_inputs;
     larodTensor** pp_output_tensors;
     size_t pp_num_outputs;
@@ -44,10 +44,6 @@ typedef struct model_provider {
     larodTensor** output_tensors;
     size_t num_outputs;
 
-    size_t image_buffer_size;
-
-    int image_input_fd;
-    void* image_input_addr;
     int larod_model_fd;
 
     bool use_preprocessing;
@@ -56,6 +52,18 @@ typedef struct model_provider {
     model_tensor_output_t* model_output_tensors;
     const char* device_name;
     larodModel* model;
+    larodModel* pp_model;
+
+    // The VDO buffers are used as input tensors without copying. Each buffer is tracked by
+    // larod the first time it is seen and the tensor is then reused for every frame in it.
+    img_info_t image_info;
+    larodTensor** image_tensors[MAX_NBR_IMG_PROVIDER_BUFFERS];
+    int image_buffer_fds[MAX_NBR_IMG_PROVIDER_BUFFERS];
+    int64_t image_buffer_offsets[MAX_NBR_IMG_PROVIDER_BUFFERS];
+    int image_tensor_fds[MAX_NBR_IMG_PROVIDER_BUFFERS];
+    size_t num_image_tensors;
+
+    power_backoff_t power_backoff;
 } model_provider_t;
 
 bool model_run_inference(model_provider_t* provider, VdoBuffer* vdo_buf);
@@ -0,0 +1,64 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Warm start of the inference model.
+ *
+ * Loading a model compiles it for the device, which takes several seconds on a
+ * DLPU. The model is instead loaded as a public larod model, which larod keeps
+ * after the application has exited, with a name made from the device and the
+ * size, modification time and inode of the model file. At the next start the
+ * compiled model is found by its name and used right away.
+ *
+ * Models cached by the application for an older model file on the same device
+ * are deleted, so at most one compiled model per device is kept.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "larod.h"
+
+#define MODEL_CACHE_NAME_SIZE 128
+
+/**
+ * @brief Make the cache name of a model file.
+ *
+ * @param app_name    Prefix of the names of all models cached by the application.
+ * @param model_fd    The opened model file.
+ * @param device_name Device the model is compiled for.
+ * @param name        Set to the name.
+ * @param size        Size of name, MODEL_CACHE_NAME_SIZE is enough for the device names of larod.
+ *
+ * @return False if the model file could not be read.
+ */
+bool model_cache_name(const char* app_name,
+                      int model_fd,
+                      const char* device_name,
+                      char* name,
+                      size_t size);
+
+/**
+ * @brief Find the cached model with a name, and delete the stale ones of the application.
+ *
+ * @return The model, to be destroyed with larodDestroyModel(), or NULL if it is not cached.
+ */
+larodModel* model_cache_lookup(larodConnection* conn,
+                               const char* app_name,
+                               const char* device_name,
+                               const char* name);
@@ -49,9 +49,10 @@
 
 #include "argparse.h"
 #include "imgprovider.h"
-#include "labelparse.h"
 #include "model.h"
 #include "panic.h"
+#include "postprocessing.h"
+#include "tensor_recording.h"
 #include "vdo-error.h"
 #include "vdo-frame.h"
 #include "vdo-types.h"
@@ -59,15 +60,8 @@
 
 volatile sig_atomic_t running = 1;
 
-// define box struct
-typedef struct {
-    float y_min;
-    float x_min;
-    float y_max;
-    float x_max;
-    float score;
-    int label;
-} box;
+// Records the output tensors when the application is started with --record, NULL otherwise
+static tensor_recorder_t* recorder;
 
 static void shutdown(int status) {
     (void)status;
@@ -91,38 +85,42 @@ static bbox_t* setup_bbox(uint32_t channel) {
     return bbox;
 }
 
+/**
+ * @brief Draw the reported tracks of the tracker, replacing the boxes of the previous frame.
+ */
+static void draw_tracks(bbox_t* bbox, const tracker_t* tracker) {
+    size_t position = 0;
+    tracker_object_t object;
+
+    bbox_clear(bbox);
+    bbox_coordinates_frame_normalized(bbox);
+    while (tracker_next(tracker, &position, &object)) {
+        bbox_rectangle(bbox, object.x1, object.y1, object.x2, object.y2);
+    }
+    if (!bbox_commit(bbox, 0u)) {
+        panic("Failed to commit box drawer");
+    }
+}
+
 static bool parse_and_postprocess_output_tensors(bbox_t* bbox,
+                                                 tracker_t* tracker,
+                                                 frame_arena_t* arena,
                                                  model_tensor_output_t* tensor_outputs,
                                                  float confidence_threshold,
-                                                 char** labels,
+                                                 const label_table_t* labels,
                                                  unsigned int* post_processing_ms) {
-    box* boxes = NULL;
     struct timeval start_ts, end_ts;
 
     // From here this is different dependent on model
-    float* locations = (float*)tensor_outputs[0].data;
-    float* classes   = (float*)tensor_outputs[1].data;
-
-    bbox_clear(bbox);
+    const ssd_output_t output = {(const float*)tensor_outputs[0].data,
+                                 (const float*)tensor_outputs[1].data,
+                                 (const float*)tensor_outputs[2].data,
+                                 (const float*)tensor_outputs[3].data,
+                                 tensor_outputs[2].size / sizeof(float)};
+    tensor_recorder_write(recorder, &output);
 
     gettimeofday(&start_ts, NULL);
-
-    float* scores            = (float*)tensor_outputs[2].data;
-    float* nbr_detections    = (float*)tensor_outputs[3].data;
-    int number_of_detections = (int)nbr_detections[0];
-    if (number_of_detections == 0) {
-        syslog(LOG_INFO, "No object is detected");
-        return true;
-    }
-    boxes = (box*)malloc(sizeof(box) * number_of_detections);
-    for (int i = 0; i < number_of_detections; i++) {
-        boxes[i].y_min = locations[4 * i];
-        boxes[i].x_min = locations[4 * i + 1];
-        boxes[i].y_max = locations[4 * i + 2];
-        boxes[i].x_max = locations[4 * i + 3];
-        boxes[i].score = scores[i];
-        boxes[i].label = classes[i];
-    }
+    ssd_postprocess(&output, confidence_threshold, arena, tracker, labels);
     gettimeofday(&end_ts, NULL);
 
     *post_processing_ms = (unsigned int)(((end_ts.tv_sec - start_ts.tv_sec) * 1000) +
@@ -131,33 +129,8 @@ static bool parse_and_postprocess_output_tensors(bbox_t* bbox,
         syslog(LOG_INFO, "Postprocessing in %u ms", *post_processing_ms);
     }
 
-    for (int i = 0; i < number_of_detections; i++) {
-        if (boxes[i].score >= confidence_threshold) {
-            float top    = boxes[i].y_min;
-            float left   = boxes[i].x_min;
-            float bottom = boxes[i].y_max;
-            float right  = boxes[i].x_max;
-
-            syslog(LOG_INFO,
-                   "Object %d: Classes: %s - Scores: %f - Locations: [%f,%f,%f,%f]",
-                   i,
-                   labels[boxes[i].label],
-                   boxes[i].score,
-                   top,
-                   left,
-                   bottom,
-                   right);
-            bbox_coordinates_frame_normalized(bbox);
-            bbox_rectangle(bbox, left, top, right, bottom);
-        }
-    }
+    draw_tracks(bbox, tracker);
 
-    if (!bbox_commit(bbox, 0u)) {
-        panic("Failed to commit box drawer");
-    }
-    if (boxes) {
-        free(boxes);
-    }
     return true;
 }
 
@@ -170,6 +143,8 @@ int main(int argc, char** argv) {
     model_tensor_output_t* tensor_outputs = NULL;
     g_autoptr(GError) vdo_error           = NULL;
     bbox_t* bbox                          = NULL;
+    tracker_t* tracker                    = NULL;
+    frame_arena_t* frame_arena            = NULL;
     img_info_t model_metadata             = {0};
     img_info_t image_metadata             = {0};
 
@@ -184,7 +159,6 @@ int main(int argc, char** argv) {
     char* model_file           = args.model_file;
     const char* labels_file    = args.labels_file;
     const int threshold        = args.threshold;
-    size_t number_of_classes   = 0;
     double vdo_framerate       = 30.0;
     uint32_t vdo_input_channel = 1;
     bool parse_tensors         = true;
@@ -218,13 +192,37 @@ int main(int argc, char** argv) {
         parse_tensors = false;
     }
 
-    char** labels = NULL;          // This is the array of label strings. The label
-                                   // entries points into the large label_file_data buffer.
-    char* label_file_data = NULL;  // Buffer holding the complete collection of label strings.
+    // The labels are views into the mapped label file
+    label_table_t* labels = NULL;
 
     if (parse_tensors) {
-        parse_labels(&labels, &label_file_data, labels_file, &number_of_classes);
+        labels = label_table_open(labels_file, false);
+        if (!labels) {
+            panic("%s: Could not read labels file %s", __func__, labels_file);
+        }
         bbox = setup_bbox(vdo_input_channel);
+
+        const tracker_params_t tracker_params = {TRACKER_MIN_HITS,
+                                                 TRACKER_MAX_MISSES,
+                                                 TRACKER_IOU_THRESHOLD};
+        tracker = tracker_create(TRACKER_MAX_TRACKS, &tracker_params);
+        if (!tracker) {
+            panic("%s: Could not create tracker", __func__);
+        }
+
+        frame_arena = frame_arena_create(FRAME_ARENA_SIZE);
+        if (!frame_arena) {
+            panic("%s: Could not create frame arena", __func__);
+        }
+
+        // The output tensors are mapped when the model is loaded, so their size is known here
+        model_tensor_output_t scores;
+        if (args.record_file && model_get_tensor_output_info(model_provider, 2, &scores)) {
+            recorder = tensor_recorder_open(args.record_file,
+                                            (float)(threshold / 100.0),
+                                            scores.size / sizeof(float),
+                                            args.record_frames);
+        }
     }
 
     // Get the fd here instead so it possible to select on them in main loop instead
@@ -247,6 +245,11 @@ int main(int argc, char** argv) {
                 "restarted",
                 __func__);
         }
+        if (parse_tensors) {
+            // The tracks are predicted for every analyzed frame
+            tracker_predict(tracker);
+        }
+
         gettimeofday(&start_ts, NULL);
         if (!model_run_inference(model_provider, vdo_buf)) {
             // No power
@@ -256,8 +259,8 @@ int main(int argc, char** argv) {
                 }
                 g_clear_error(&vdo_error);
             }
-            // All buffers in vdo should be flushed since the call to run_inference may
-            // have taken a lot of time so the buffers in vdo may be old
+            // All buffers in vdo are flushed, so the first frame analyzed when the
+            // power is back is a fresh one
             img_provider_flush_all_frames(image_provider);
             continue;
         }
@@ -278,11 +281,14 @@ int main(int argc, char** argv) {
             unsigned int post_processing_ms = 0;
             float confidence_threshold      = (float)(threshold / 100.0);
             parse_and_postprocess_output_tensors(bbox,
+                                                 tracker,
+                                                 frame_arena,
                                                  tensor_outputs,
                                                  confidence_threshold,
                                                  labels,
                                                  &post_processing_ms);
             total_elapsed_ms += post_processing_ms;
+            frame_arena_reset(frame_arena);
         }
 
         // Check if the framerate from vdo should be changed
@@ -305,15 +311,13 @@ int main(int argc, char** argv) {
     }
     free(tensor_outputs);
 
-    if (labels) {
-        free(labels);
-    }
-    if (label_file_data) {
-        free(label_file_data);
-    }
+    label_table_close(labels);
     if (parse_tensors) {
         bbox_destroy(bbox);
+        tracker_destroy(tracker);
+        frame_arena_destroy(frame_arena);
     }
+    tensor_recorder_close(recorder);
 
     syslog(LOG_INFO, "Exit %s", argv[0]);
     return 0;
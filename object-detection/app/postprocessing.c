@@ -0,0 +1,100 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/**
+ * This file handles the post-processing of the SSD model output.
+ */
+
+#include "postprocessing.h"
+
+#include <syslog.h>
+
+size_t ssd_postprocess(const ssd_output_t* output,
+                       float confidence_threshold,
+                       frame_arena_t* arena,
+                       tracker_t* tracker,
+                       const label_table_t* labels) {
+    box* boxes               = NULL;
+    int number_of_detections = (int)output->num_detections[0];
+    // Never read past the scores, whatever count the model reports
+    const int max_detections = (int)output->max_detections;
+    if (number_of_detections > max_detections) {
+        number_of_detections = max_detections;
+    }
+    if (number_of_detections <= 0) {
+        if (labels) {
+            syslog(LOG_INFO, "No object is detected");
+        }
+        number_of_detections = 0;
+    } else {
+        // Released with the rest of the frame, so the frame loop never calls malloc
+        boxes = frame_arena_alloc(arena, (size_t)number_of_detections, sizeof(box));
+        if (!boxes) {
+            syslog(LOG_WARNING, "No room for %d detections in the frame", number_of_detections);
+            number_of_detections = 0;
+        }
+    }
+    for (int i = 0; i < number_of_detections; i++) {
+        boxes[i].y_min = output->locations[4 * i];
+        boxes[i].x_min = output->locations[4 * i + 1];
+        boxes[i].y_max = output->locations[4 * i + 2];
+        boxes[i].x_max = output->locations[4 * i + 3];
+        boxes[i].score = output->scores[i];
+        boxes[i].label = (int)output->classes[i];
+    }
+
+    size_t num_passing = 0;
+    for (int i = 0; i < number_of_detections; i++) {
+        if (boxes[i].score >= confidence_threshold) {
+            float top    = boxes[i].y_min;
+            float left   = boxes[i].x_min;
+            float bottom = boxes[i].y_max;
+            float right  = boxes[i].x_max;
+            num_passing++;
+
+            if (labels) {
+                const label_view_t label = label_table_get(labels, (size_t)boxes[i].label);
+                syslog(LOG_INFO,
+                       "Object %d: Classes: %.*s - Scores: %f - Locations: [%f,%f,%f,%f]",
+                       i,
+                       (int)label.length,
+                       label.data,
+                       boxes[i].score,
+                       top,
+                       left,
+                       bottom,
+                       right);
+            }
+
+            // The detections are ordered by score, so only the weakest ones are left out
+            const tracker_detection_t detection = {left,
+                                                   top,
+                                                   right,
+                                                   bottom,
+                                                   boxes[i].score,
+                                                   boxes[i].label};
+            if (!tracker_add_detection(tracker, &detection)) {
+                syslog(LOG_WARNING, "Too many objects, object %d is not tracked", i);
+            }
+        }
+    }
+
+    // The boxes follow the tracks, so an object missed in a single frame does not flicker
+    tracker_update(tracker);
+
+    return num_passing;
+}
@@ -0,0 +1,84 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * This header file handles the post-processing of the SSD model output.
+ *
+ * The post-processing only uses plain memory, no larod or vdo, so it can also be run off the
+ * device by the post-processing benchmark.
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+#include "frame_arena.h"
+#include "labelparse.h"
+#include "tracker.h"
+
+// Maximum number of followed objects, more detections of a frame are not drawn
+#define TRACKER_MAX_TRACKS 100
+// A track is drawn from its second detection, and kept while it misses up to three in a row
+#define TRACKER_MIN_HITS   2
+#define TRACKER_MAX_MISSES 3
+// Minimum IoU of a detection and the predicted box of a track to follow the track
+#define TRACKER_IOU_THRESHOLD 0.3f
+// Memory for the data of a frame, the boxes of the SSD model take 24 bytes per detection
+#define FRAME_ARENA_SIZE (64 * 1024)
+
+// define box struct
+typedef struct {
+    float y_min;
+    float x_min;
+    float y_max;
+    float x_max;
+    float score;
+    int label;
+} box;
+
+/**
+ * @brief The four output tensors of the SSD model.
+ */
+typedef struct ssd_output {
+    // [y_min, x_min, y_max, x_max] of each detection
+    const float* locations;
+    const float* classes;
+    const float* scores;
+    // The number of detections the model reports, as a float
+    const float* num_detections;
+    // Number of detections the tensors have room for
+    size_t max_detections;
+} ssd_output_t;
+
+/**
+ * @brief Parse the output of a frame and follow the detections passing the threshold.
+ *
+ * The boxes are allocated from the arena, which the caller resets when the frame is done. The
+ * tracker is updated, its reported tracks are the objects of the frame.
+ *
+ * @param output                The output tensors of the frame.
+ * @param confidence_threshold  Minimum score of a detection.
+ * @param arena                 Memory of the frame.
+ * @param tracker               Tracker that the detections are added to.
+ * @param labels                Labels to log the detections with, NULL to not log them.
+ *
+ * @return Number of detections passing the threshold.
+ */
+size_t ssd_postprocess(const ssd_output_t* output,
+                       float confidence_threshold,
+                       frame_arena_t* arena,
+                       tracker_t* tracker,
+                       const label_table_t* labels);
@@ -0,0 +1,167 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * - postprocessing_benchmark -
+ *
+ * Replays the output tensors of a recording, made by the application with the --record option,
+ * through the post-processing and the tracker and reports the time and the number of allocations
+ * per frame. It does not use larod, vdo or bbox, so it can be built for the host as well as for
+ * the device.
+ *
+ * The program expects the path to the recording as first argument, and optionally the number of
+ * times to replay it as second argument.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <syslog.h>
+#include <time.h>
+
+#include "frame_arena.h"
+#include "postprocessing.h"
+#include "panic.h"
+#include "tensor_recording.h"
+#include "tracker.h"
+
+#define DEFAULT_ITERATIONS 100
+
+// The allocation functions are wrapped by the linker, see the Makefile
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+void* __wrap_malloc(size_t size);
+void* __wrap_calloc(size_t count, size_t size);
+void* __wrap_realloc(void* ptr, size_t size);
+
+static unsigned long long num_allocations;
+
+void* __wrap_malloc(size_t size) {
+    num_allocations++;
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+    num_allocations++;
+    return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+    num_allocations++;
+    return __real_realloc(ptr, size);
+}
+
+static unsigned long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ull + (unsigned long long)ts.tv_nsec;
+}
+
+static int compare_ns(const void* a, const void* b) {
+    unsigned long long lhs = *(const unsigned long long*)a;
+    unsigned long long rhs = *(const unsigned long long*)b;
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+int main(int argc, char** argv) {
+    tensor_recording_header_t header;
+    float* frames = NULL;
+    size_t num_frames;
+
+    // Errors of the post-processing go to the system log, show them on stderr too
+    openlog(NULL, LOG_PERROR, LOG_USER);
+
+    if (argc < 2 || argc > 3) {
+        fprintf(stderr, "Usage: %s RECORDING [ITERATIONS]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    unsigned int iterations =
+        argc == 3 ? (unsigned int)strtoul(argv[2], NULL, 10) : DEFAULT_ITERATIONS;
+    if (iterations == 0) {
+        fprintf(stderr, "Invalid number of iterations %s\n", argv[2]);
+        return EXIT_FAILURE;
+    }
+    if (!tensor_recording_load(argv[1], &header, &frames, &num_frames)) {
+        return EXIT_FAILURE;
+    }
+
+    // The same tracker and frame memory as the application
+    const tracker_params_t tracker_params = {TRACKER_MIN_HITS,
+                                             TRACKER_MAX_MISSES,
+                                             TRACKER_IOU_THRESHOLD};
+    tracker_t* tracker = tracker_create(TRACKER_MAX_TRACKS, &tracker_params);
+    frame_arena_t* arena = frame_arena_create(FRAME_ARENA_SIZE);
+    if (!tracker || !arena) {
+        panic("%s: Could not create tracker", __func__);
+    }
+
+    size_t num_samples          = num_frames * iterations;
+    unsigned long long* samples = calloc(num_samples, sizeof(unsigned long long));
+    if (!samples) {
+        fprintf(stderr, "Could not allocate %zu samples\n", num_samples);
+        return EXIT_FAILURE;
+    }
+
+    // Warm up the caches and the branch predictors with one pass
+    for (size_t i = 0; i < num_frames; i++) {
+        const ssd_output_t output = tensor_recording_frame(&header, frames, i);
+        tracker_predict(tracker);
+        ssd_postprocess(&output, header.conf_threshold, arena, tracker, NULL);
+        frame_arena_reset(arena);
+    }
+
+    unsigned long long total_detections = 0;
+    num_allocations                     = 0;
+    for (unsigned int iteration = 0; iteration < iterations; iteration++) {
+        for (size_t i = 0; i < num_frames; i++) {
+            const ssd_output_t output   = tensor_recording_frame(&header, frames, i);
+            unsigned long long start_ns = now_ns();
+            tracker_predict(tracker);
+            size_t count = ssd_postprocess(&output, header.conf_threshold, arena, tracker, NULL);
+            frame_arena_reset(arena);
+            unsigned long long time_ns = now_ns() - start_ns;
+
+            total_detections += count;
+            samples[iteration * num_frames + i] = time_ns;
+        }
+    }
+    unsigned long long allocations = num_allocations;
+
+    unsigned long long sum_ns = 0;
+    for (size_t i = 0; i < num_samples; i++) {
+        sum_ns += samples[i];
+    }
+    qsort(samples, num_samples, sizeof(unsigned long long), compare_ns);
+
+    printf("Model: %u detections, confidence threshold %.2f\n",
+           header.max_detections,
+           (double)header.conf_threshold);
+    printf("Replayed %zu frames %u times\n", num_frames, iterations);
+    printf("Detections per frame: %.1f\n", (double)total_detections / (double)num_samples);
+    printf("ns/frame: mean %llu, p50 %llu, p99 %llu, min %llu, max %llu\n",
+           sum_ns / num_samples,
+           samples[num_samples / 2],
+           samples[(num_samples * 99) / 100],
+           samples[0],
+           samples[num_samples - 1]);
+    printf("Allocations per frame: %.2f\n", (double)allocations / (double)num_samples);
+
+    free(samples);
+    frame_arena_destroy(arena);
+    tracker_destroy(tracker);
+    free(frames);
+    return EXIT_SUCCESS;
+}
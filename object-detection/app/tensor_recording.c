@@ -0,0 +1,162 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "tensor_recording.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+
+#include "panic.h"
+
+tensor_recorder_t* tensor_recorder_open(const char* path,
+                                        float conf_threshold,
+                                        size_t max_detections,
+                                        unsigned int max_frames) {
+    tensor_recording_header_t header = {
+        .magic          = TENSOR_RECORDING_MAGIC,
+        .version        = TENSOR_RECORDING_VERSION,
+        .conf_threshold = conf_threshold,
+        .max_detections = (uint32_t)max_detections,
+    };
+
+    FILE* file = fopen(path, "wb");
+    if (!file) {
+        syslog(LOG_ERR, "%s: Could not open %s: %s", __func__, path, strerror(errno));
+        return NULL;
+    }
+    if (fwrite(&header, sizeof(header), 1, file) != 1) {
+        syslog(LOG_ERR, "%s: Could not write to %s: %s", __func__, path, strerror(errno));
+        fclose(file);
+        return NULL;
+    }
+
+    tensor_recorder_t* recorder = calloc(1, sizeof(tensor_recorder_t));
+    char* path_copy             = strdup(path);
+    if (!recorder || !path_copy) {
+        panic("%s: Could not allocate recorder", __func__);
+    }
+    recorder->file           = file;
+    recorder->path           = path_copy;
+    recorder->max_detections = max_detections;
+    recorder->max_frames     = max_frames;
+    syslog(LOG_INFO, "Recording %u output tensors to %s", max_frames, path);
+    return recorder;
+}
+
+static void close_file(tensor_recorder_t* recorder) {
+    if (!recorder->file) {
+        return;
+    }
+    if (fclose(recorder->file) != 0) {
+        syslog(LOG_ERR, "%s: Could not write to %s: %s", __func__, recorder->path, strerror(errno));
+    }
+    recorder->file = NULL;
+    syslog(LOG_INFO, "Recorded %u output tensors to %s", recorder->num_frames, recorder->path);
+}
+
+void tensor_recorder_write(tensor_recorder_t* recorder, const ssd_output_t* output) {
+    if (!recorder || !recorder->file) {
+        return;
+    }
+    const size_t max = recorder->max_detections;
+    if (fwrite(output->locations, sizeof(float), 4 * max, recorder->file) != 4 * max ||
+        fwrite(output->classes, sizeof(float), max, recorder->file) != max ||
+        fwrite(output->scores, sizeof(float), max, recorder->file) != max ||
+        fwrite(output->num_detections, sizeof(float), 1, recorder->file) != 1) {
+        syslog(LOG_ERR, "%s: Could not write to %s: %s", __func__, recorder->path, strerror(errno));
+        close_file(recorder);
+        return;
+    }
+    if (++recorder->num_frames == recorder->max_frames) {
+        close_file(recorder);
+    }
+}
+
+void tensor_recorder_close(tensor_recorder_t* recorder) {
+    if (!recorder) {
+        return;
+    }
+    close_file(recorder);
+    free(recorder->path);
+    free(recorder);
+}
+
+bool tensor_recording_load(const char* path,
+                           tensor_recording_header_t* header,
+                           float** frames,
+                           size_t* num_frames) {
+    bool ret    = false;
+    float* data = NULL;
+
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        syslog(LOG_ERR, "%s: Could not open %s: %s", __func__, path, strerror(errno));
+        return false;
+    }
+    if (fread(header, sizeof(*header), 1, file) != 1 || header->magic != TENSOR_RECORDING_MAGIC ||
+        header->version != TENSOR_RECORDING_VERSION || header->max_detections == 0) {
+        syslog(LOG_ERR, "%s: %s is not a tensor recording", __func__, path);
+        goto end;
+    }
+    const size_t frame_size = tensor_recording_frame_floats(header->max_detections) * sizeof(float);
+
+    if (fseek(file, 0, SEEK_END) != 0) {
+        syslog(LOG_ERR, "%s: Could not seek in %s: %s", __func__, path, strerror(errno));
+        goto end;
+    }
+    long file_size = ftell(file);
+    if (file_size < 0 || fseek(file, (long)sizeof(*header), SEEK_SET) != 0) {
+        syslog(LOG_ERR, "%s: Could not seek in %s: %s", __func__, path, strerror(errno));
+        goto end;
+    }
+    // A frame cut off at the end of the file is ignored
+    size_t count = ((size_t)file_size - sizeof(*header)) / frame_size;
+    if (count == 0) {
+        syslog(LOG_ERR, "%s: No tensors in %s", __func__, path);
+        goto end;
+    }
+
+    data = malloc(count * frame_size);
+    if (!data) {
+        panic("%s: Could not allocate %zu frames", __func__, count);
+    }
+    if (fread(data, frame_size, count, file) != count) {
+        syslog(LOG_ERR, "%s: Could not read %s", __func__, path);
+        goto end;
+    }
+
+    *frames     = data;
+    *num_frames = count;
+    data        = NULL;
+    ret         = true;
+
+end:
+    free(data);
+    fclose(file);
+    return ret;
+}
+
+ssd_output_t tensor_recording_frame(const tensor_recording_header_t* header,
+                                    const float* frames,
+                                    size_t frame) {
+    const size_t max   = header->max_detections;
+    const float* start = frames + frame * tensor_recording_frame_floats(max);
+    const ssd_output_t output = {start, start + 4 * max, start + 5 * max, start + 6 * max, max};
+    return output;
+}
@@ -0,0 +1,103 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+/**
+ * Recording of the output tensors of the model, to replay them through the post-processing.
+ *
+ * A recording starts with a header with the post-processing parameters, followed by the
+ * locations, classes, scores and number of detections of each frame as floats. The file is
+ * written with the byte order of the device, which is little endian on all supported devices and
+ * on a x86_64 host.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "postprocessing.h"
+
+#define TENSOR_RECORDING_MAGIC   0x54445353  // "SSDT"
+#define TENSOR_RECORDING_VERSION 1
+
+typedef struct tensor_recording_header {
+    uint32_t magic;
+    uint32_t version;
+    float conf_threshold;
+    uint32_t max_detections;
+} tensor_recording_header_t;
+
+typedef struct tensor_recorder {
+    FILE* file;
+    char* path;
+    size_t max_detections;
+    unsigned int max_frames;
+    unsigned int num_frames;
+} tensor_recorder_t;
+
+/**
+ * @brief Number of floats of a recorded frame.
+ */
+static inline size_t tensor_recording_frame_floats(size_t max_detections) {
+    return 6 * max_detections + 1;
+}
+
+/**
+ * @brief Create a recording, the file is replaced if it exists.
+ *
+ * @param max_detections Number of detections the output tensors have room for.
+ * @param max_frames     Number of frames to record, the later ones are ignored.
+ *
+ * @return The recorder, or NULL if the file could not be written.
+ */
+tensor_recorder_t* tensor_recorder_open(const char* path,
+                                        float conf_threshold,
+                                        size_t max_detections,
+                                        unsigned int max_frames);
+
+/**
+ * @brief Add the output tensors of a frame, the file is closed when max_frames have been added.
+ */
+void tensor_recorder_write(tensor_recorder_t* recorder, const ssd_output_t* output);
+
+/**
+ * @brief Close the recording and free the recorder.
+ */
+void tensor_recorder_close(tensor_recorder_t* recorder);
+
+/**
+ * @brief Read all frames of a recording.
+ *
+ * @param header     Set to the header of the recording.
+ * @param frames     Set to the frames one after the other, to be freed by the caller.
+ * @param num_frames Set to the number of frames.
+ *
+ * @return False if the file could not be read or is not a recording.
+ */
+bool tensor_recording_load(const char* path,
+                           tensor_recording_header_t* header,
+                           float** frames,
+                           size_t* num_frames);
+
+/**
+ * @brief The output tensors of a loaded frame.
+ */
+ssd_output_t tensor_recording_frame(const tensor_recording_header_t* header,
+                                    const float* frames,
+                                    size_t frame);
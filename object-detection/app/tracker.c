@@ -0,0 +1,419 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "tracker.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+// The filtered coordinates of a box: center x, center y, width and height
+#define NUM_DIMS 4
+
+// Standard deviations of the filters, in normalized coordinates per frame
+#define MEASUREMENT_STD      0.01f
+#define POSITION_STD         0.005f
+#define VELOCITY_STD         0.002f
+#define INITIAL_VELOCITY_STD 0.05f
+
+// Cost of an assignment that is not allowed, larger than any 1 - IoU
+#define NO_MATCH_COST 2.0f
+
+struct tracker {
+    tracker_params_t params;
+    size_t capacity;
+    size_t num_tracks;
+    uint32_t next_id;
+
+    // The track table, one array per field, capacity entries each
+    uint32_t* ids;
+    int* labels;
+    float* scores;
+    unsigned int* hits;
+    unsigned int* misses;
+    // Kalman state per coordinate: position, velocity and the covariance [[p00, p01], [p01, p11]]
+    float* position[NUM_DIMS];
+    float* velocity[NUM_DIMS];
+    float* p00[NUM_DIMS];
+    float* p01[NUM_DIMS];
+    float* p11[NUM_DIMS];
+
+    // Detections added for the next update, capacity entries
+    tracker_detection_t* detections;
+    size_t num_detections;
+
+    // Work buffers of the assignment
+    float* cost;
+    float* u;
+    float* v;
+    float* min_slack;
+    size_t* row_of;
+    size_t* way;
+    bool* visited;
+    bool* track_assigned;
+    bool* detection_assigned;
+};
+
+tracker_t* tracker_create(size_t max_tracks, const tracker_params_t* params) {
+    tracker_t* tracker = calloc(1, sizeof(tracker_t));
+    if (!tracker) {
+        return NULL;
+    }
+    size_t capacity = max_tracks > 0 ? max_tracks : 1;
+
+    tracker->params   = *params;
+    tracker->capacity = capacity;
+    tracker->next_id  = 1;
+
+    tracker->ids    = calloc(capacity, sizeof(uint32_t));
+    tracker->labels = calloc(capacity, sizeof(int));
+    tracker->scores = calloc(capacity, sizeof(float));
+    tracker->hits   = calloc(capacity, sizeof(unsigned int));
+    tracker->misses = calloc(capacity, sizeof(unsigned int));
+
+    bool allocated =
+        tracker->ids && tracker->labels && tracker->scores && tracker->hits && tracker->misses;
+    for (size_t d = 0; d < NUM_DIMS; d++) {
+        tracker->position[d] = calloc(capacity, sizeof(float));
+        tracker->velocity[d] = calloc(capacity, sizeof(float));
+        tracker->p00[d]      = calloc(capacity, sizeof(float));
+        tracker->p01[d]      = calloc(capacity, sizeof(float));
+        tracker->p11[d]      = calloc(capacity, sizeof(float));
+
+        allocated = allocated && tracker->position[d] && tracker->velocity[d] && tracker->p00[d] &&
+                    tracker->p01[d] && tracker->p11[d];
+    }
+
+    tracker->detections = calloc(capacity, sizeof(tracker_detection_t));
+
+    // The assignment is solved on a square matrix, with 1-based indices in the potentials
+    tracker->cost               = calloc(capacity * capacity, sizeof(float));
+    tracker->u                  = calloc(capacity + 1, sizeof(float));
+    tracker->v                  = calloc(capacity + 1, sizeof(float));
+    tracker->min_slack          = calloc(capacity + 1, sizeof(float));
+    tracker->row_of             = calloc(capacity + 1, sizeof(size_t));
+    tracker->way                = calloc(capacity + 1, sizeof(size_t));
+    tracker->visited            = calloc(capacity + 1, sizeof(bool));
+    tracker->track_assigned     = calloc(capacity, sizeof(bool));
+    tracker->detection_assigned = calloc(capacity, sizeof(bool));
+    if (!allocated || !tracker->detections || !tracker->cost || !tracker->u || !tracker->v ||
+        !tracker->min_slack || !tracker->row_of || !tracker->way || !tracker->visited ||
+        !tracker->track_assigned || !tracker->detection_assigned) {
+        tracker_destroy(tracker);
+        return NULL;
+    }
+    return tracker;
+}
+
+void tracker_destroy(tracker_t* tracker) {
+    if (!tracker) {
+        return;
+    }
+    free(tracker->ids);
+    free(tracker->labels);
+    free(tracker->scores);
+    free(tracker->hits);
+    free(tracker->misses);
+    for (size_t d = 0; d < NUM_DIMS; d++) {
+        free(tracker->position[d]);
+        free(tracker->velocity[d]);
+        free(tracker->p00[d]);
+        free(tracker->p01[d]);
+        free(tracker->p11[d]);
+    }
+    free(tracker->detections);
+    free(tracker->cost);
+    free(tracker->u);
+    free(tracker->v);
+    free(tracker->min_slack);
+    free(tracker->row_of);
+    free(tracker->way);
+    free(tracker->visited);
+    free(tracker->track_assigned);
+    free(tracker->detection_assigned);
+    free(tracker);
+}
+
+static void measure(const tracker_detection_t* detection, float z[NUM_DIMS]) {
+    z[0] = (detection->x1 + detection->x2) / 2.0f;
+    z[1] = (detection->y1 + detection->y2) / 2.0f;
+    z[2] = detection->x2 - detection->x1;
+    z[3] = detection->y2 - detection->y1;
+}
+
+static void predicted_box(const tracker_t* tracker, size_t i, float box[4]) {
+    float half_w = fmaxf(tracker->position[2][i], 0.0f) / 2.0f;
+    float half_h = fmaxf(tracker->position[3][i], 0.0f) / 2.0f;
+    box[0]       = tracker->position[0][i] - half_w;
+    box[1]       = tracker->position[1][i] - half_h;
+    box[2]       = tracker->position[0][i] + half_w;
+    box[3]       = tracker->position[1][i] + half_h;
+}
+
+void tracker_predict(tracker_t* tracker) {
+    const float q_pos = POSITION_STD * POSITION_STD;
+    const float q_vel = VELOCITY_STD * VELOCITY_STD;
+    size_t n          = tracker->num_tracks;
+
+    for (size_t d = 0; d < NUM_DIMS; d++) {
+        float* position = tracker->position[d];
+        float* velocity = tracker->velocity[d];
+        float* p00      = tracker->p00[d];
+        float* p01      = tracker->p01[d];
+        float* p11      = tracker->p11[d];
+        for (size_t i = 0; i < n; i++) {
+            position[i] += velocity[i];
+            p00[i] += 2.0f * p01[i] + p11[i] + q_pos;
+            p01[i] += p11[i];
+            p11[i] += q_vel;
+        }
+    }
+}
+
+static void correct(tracker_t* tracker, size_t i, const tracker_detection_t* detection) {
+    const float r = MEASUREMENT_STD * MEASUREMENT_STD;
+    float z[NUM_DIMS];
+    measure(detection, z);
+
+    for (size_t d = 0; d < NUM_DIMS; d++) {
+        float p00 = tracker->p00[d][i];
+        float p01 = tracker->p01[d][i];
+        float k0  = p00 / (p00 + r);
+        float k1  = p01 / (p00 + r);
+        float y   = z[d] - tracker->position[d][i];
+
+        tracker->position[d][i] += k0 * y;
+        tracker->velocity[d][i] += k1 * y;
+        tracker->p00[d][i] = (1.0f - k0) * p00;
+        tracker->p01[d][i] = (1.0f - k0) * p01;
+        tracker->p11[d][i] -= k1 * p01;
+    }
+    tracker->labels[i] = detection->label;
+    tracker->scores[i] = detection->score;
+    tracker->hits[i]++;
+    tracker->misses[i] = 0;
+}
+
+static void add_track(tracker_t* tracker, const tracker_detection_t* detection) {
+    const float r = MEASUREMENT_STD * MEASUREMENT_STD;
+    size_t i      = tracker->num_tracks++;
+    float z[NUM_DIMS];
+    measure(detection, z);
+
+    // The ids wrap around, 0 is never used
+    tracker->ids[i] = tracker->next_id++;
+    if (tracker->next_id == 0) {
+        tracker->next_id = 1;
+    }
+    tracker->labels[i] = detection->label;
+    tracker->scores[i] = detection->score;
+    tracker->hits[i]   = 1;
+    tracker->misses[i] = 0;
+    for (size_t d = 0; d < NUM_DIMS; d++) {
+        tracker->position[d][i] = z[d];
+        tracker->velocity[d][i] = 0.0f;
+        tracker->p00[d][i]      = r;
+        tracker->p01[d][i]      = 0.0f;
+        tracker->p11[d][i]      = INITIAL_VELOCITY_STD * INITIAL_VELOCITY_STD;
+    }
+}
+
+/**
+ * @brief Move the last track into slot i, keeping the table dense.
+ */
+static void remove_track(tracker_t* tracker, size_t i) {
+    size_t last = --tracker->num_tracks;
+
+    tracker->ids[i]    = tracker->ids[last];
+    tracker->labels[i] = tracker->labels[last];
+    tracker->scores[i] = tracker->scores[last];
+    tracker->hits[i]   = tracker->hits[last];
+    tracker->misses[i] = tracker->misses[last];
+    for (size_t d = 0; d < NUM_DIMS; d++) {
+        tracker->position[d][i] = tracker->position[d][last];
+        tracker->velocity[d][i] = tracker->velocity[d][last];
+        tracker->p00[d][i]      = tracker->p00[d][last];
+        tracker->p01[d][i]      = tracker->p01[d][last];
+        tracker->p11[d][i]      = tracker->p11[d][last];
+    }
+}
+
+static float intersection_over_union(const float a[4], const tracker_detection_t* b) {
+    float inter_w    = fmaxf(0.0f, fminf(a[2], b->x2) - fmaxf(a[0], b->x1));
+    float inter_h    = fmaxf(0.0f, fminf(a[3], b->y2) - fmaxf(a[1], b->y1));
+    float inter_area = inter_w * inter_h;
+    float union_area = (a[2] - a[0]) * (a[3] - a[1]) + (b->x2 - b->x1) * (b->y2 - b->y1) -
+                       inter_area;
+    return union_area > 0.0f ? inter_area / union_area : 0.0f;
+}
+
+/**
+ * @brief Solve the assignment of the square n x n cost matrix with the Hungarian algorithm.
+ *
+ * The O(n^3) variant with potentials u of the rows and v of the columns. Afterwards row_of[j]
+ * is the 1-based row assigned to the 1-based column j.
+ */
+static void solve_assignment(tracker_t* tracker, size_t n) {
+    const float* cost = tracker->cost;
+    float* u          = tracker->u;
+    float* v          = tracker->v;
+    float* min_slack  = tracker->min_slack;
+    size_t* row_of    = tracker->row_of;
+    size_t* way       = tracker->way;
+    bool* visited     = tracker->visited;
+
+    for (size_t j = 0; j <= n; j++) {
+        u[j]      = 0.0f;
+        v[j]      = 0.0f;
+        row_of[j] = 0;
+        way[j]    = 0;
+    }
+
+    for (size_t row = 1; row <= n; row++) {
+        // Column 0 is a virtual column holding the row being added
+        row_of[0]  = row;
+        size_t col = 0;
+        for (size_t j = 0; j <= n; j++) {
+            min_slack[j] = INFINITY;
+            visited[j]   = false;
+        }
+
+        // Grow an alternating tree until it reaches a free column
+        do {
+            visited[col]    = true;
+            size_t i        = row_of[col];
+            float delta     = INFINITY;
+            size_t next_col = 0;
+            for (size_t j = 1; j <= n; j++) {
+                if (visited[j]) {
+                    continue;
+                }
+                float slack = cost[(i - 1) * n + (j - 1)] - u[i] - v[j];
+                if (slack < min_slack[j]) {
+                    min_slack[j] = slack;
+                    way[j]       = col;
+                }
+                if (min_slack[j] < delta) {
+                    delta    = min_slack[j];
+                    next_col = j;
+                }
+            }
+            for (size_t j = 0; j <= n; j++) {
+                if (visited[j]) {
+                    u[row_of[j]] += delta;
+                    v[j] -= delta;
+                } else {
+                    min_slack[j] -= delta;
+                }
+            }
+            col = next_col;
+        } while (row_of[col] != 0);
+
+        // Flip the augmenting path
+        do {
+            size_t prev_col = way[col];
+            row_of[col]     = row_of[prev_col];
+            col             = prev_col;
+        } while (col != 0);
+    }
+}
+
+bool tracker_add_detection(tracker_t* tracker, const tracker_detection_t* detection) {
+    if (tracker->num_detections >= tracker->capacity) {
+        return false;
+    }
+    tracker->detections[tracker->num_detections++] = *detection;
+    return true;
+}
+
+void tracker_update(tracker_t* tracker) {
+    const tracker_detection_t* detections = tracker->detections;
+    size_t num_detections                 = tracker->num_detections;
+    size_t num_tracks                     = tracker->num_tracks;
+
+    size_t n = num_tracks > num_detections ? num_tracks : num_detections;
+
+    // Rows are tracks and columns detections, the padding rows and columns never match
+    for (size_t i = 0; i < n; i++) {
+        float box[4] = {0};
+        if (i < num_tracks) {
+            predicted_box(tracker, i, box);
+            tracker->track_assigned[i] = false;
+        }
+        for (size_t j = 0; j < n; j++) {
+            float cost = NO_MATCH_COST;
+            if (i < num_tracks && j < num_detections &&
+                tracker->labels[i] == detections[j].label) {
+                float iou = intersection_over_union(box, &detections[j]);
+                if (iou >= tracker->params.iou_threshold) {
+                    cost = 1.0f - iou;
+                }
+            }
+            tracker->cost[i * n + j] = cost;
+        }
+    }
+    for (size_t j = 0; j < num_detections; j++) {
+        tracker->detection_assigned[j] = false;
+    }
+
+    if (n > 0) {
+        solve_assignment(tracker, n);
+    }
+    for (size_t j = 1; j <= n; j++) {
+        size_t i = tracker->row_of[j] - 1;
+        if (tracker->cost[i * n + (j - 1)] < NO_MATCH_COST) {
+            correct(tracker, i, &detections[j - 1]);
+            tracker->track_assigned[i]         = true;
+            tracker->detection_assigned[j - 1] = true;
+        }
+    }
+
+    // Backwards, since a removed track is replaced by the last one
+    for (size_t i = num_tracks; i-- > 0;) {
+        if (!tracker->track_assigned[i] && ++tracker->misses[i] > tracker->params.max_misses) {
+            remove_track(tracker, i);
+        }
+    }
+
+    // The detections are ordered by score, so the best ones get the free tracks
+    for (size_t j = 0; j < num_detections && tracker->num_tracks < tracker->capacity; j++) {
+        if (!tracker->detection_assigned[j]) {
+            add_track(tracker, &detections[j]);
+        }
+    }
+    tracker->num_detections = 0;
+}
+
+bool tracker_next(const tracker_t* tracker, size_t* position, tracker_object_t* object) {
+    for (; *position < tracker->num_tracks; (*position)++) {
+        size_t i = *position;
+        if (tracker->hits[i] < tracker->params.min_hits) {
+            continue;
+        }
+
+        float box[4];
+        predicted_box(tracker, i, box);
+        object->id    = tracker->ids[i];
+        object->label = tracker->labels[i];
+        object->score = tracker->scores[i];
+        object->x1    = fminf(fmaxf(box[0], 0.0f), 1.0f);
+        object->y1    = fminf(fmaxf(box[1], 0.0f), 1.0f);
+        object->x2    = fminf(fmaxf(box[2], 0.0f), 1.0f);
+        object->y2    = fminf(fmaxf(box[3], 0.0f), 1.0f);
+        (*position)++;
+        return true;
+    }
+    return false;
+}
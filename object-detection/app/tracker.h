@@ -0,0 +1,122 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * A multi-object tracker in the style of SORT, run on the detections after NMS.
+ *
+ * Every track follows the center, width and height of its box with a constant
+ * velocity Kalman filter per coordinate. Each frame the tracks are predicted
+ * one frame ahead, and on frames with detections the detections are assigned
+ * to the tracks with the Hungarian algorithm, minimizing 1 - IoU over the pairs
+ * of the same label that overlap enough. Assigned tracks are corrected with
+ * their detection, unassigned detections start new tracks, and tracks that
+ * have missed too many detections are removed.
+ *
+ * A track is reported once it has been detected min_hits times, so a single
+ * false detection is never shown, and it is still reported at its predicted
+ * position while it misses detections, so a box does not flicker when the
+ * object is missed in a frame. Since the tracks are predicted every frame, the
+ * detection can run on every Nth frame only while the boxes still move at the
+ * full frame rate.
+ *
+ * The tracks are kept in a table with one array per field, so the prediction
+ * of all tracks runs over contiguous arrays. All memory is allocated when the
+ * tracker is created.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct tracker_params {
+    // Detections a track must have had before it is reported
+    unsigned int min_hits;
+    // Detections in a row a track may miss before it is removed
+    unsigned int max_misses;
+    // Minimum IoU of a detection and the predicted box of a track to assign them
+    float iou_threshold;
+} tracker_params_t;
+
+typedef struct tracker_detection {
+    // Normalized corners of the box
+    float x1;
+    float y1;
+    float x2;
+    float y2;
+    float score;
+    int label;
+} tracker_detection_t;
+
+typedef struct tracker_object {
+    uint32_t id;
+    int label;
+    // Score of the last detection of the track
+    float score;
+    // Normalized corners of the predicted box, clamped to [0, 1]
+    float x1;
+    float y1;
+    float x2;
+    float y2;
+} tracker_object_t;
+
+typedef struct tracker tracker_t;
+
+/**
+ * @brief Create a tracker.
+ *
+ * @param max_tracks  Maximum number of tracks, also the maximum number of detections used per
+ *                    frame.
+ * @param params      Parameters of the tracker.
+ *
+ * @return Pointer to a new tracker, or NULL if the memory could not be allocated.
+ */
+tracker_t* tracker_create(size_t max_tracks, const tracker_params_t* params);
+
+void tracker_destroy(tracker_t* tracker);
+
+/**
+ * @brief Predict all tracks one frame ahead. Called once for every frame.
+ */
+void tracker_predict(tracker_t* tracker);
+
+/**
+ * @brief Add a detection of the frame, used by the next tracker_update().
+ *
+ * The detections should be added in order of descending score.
+ *
+ * @return False if max_tracks detections have already been added, the detection is not used.
+ */
+bool tracker_add_detection(tracker_t* tracker, const tracker_detection_t* detection);
+
+/**
+ * @brief Correct the tracks with the added detections, after the frame has been predicted.
+ *
+ * Called for the frames that ran the detection, also when nothing was detected.
+ */
+void tracker_update(tracker_t* tracker);
+
+/**
+ * @brief Iterate over the reported tracks.
+ *
+ * Start with *position set to 0.
+ *
+ * @param object Filled with the next track.
+ *
+ * @return False when all tracks have been visited.
+ */
+bool tracker_next(const tracker_t* tracker, size_t* position, tracker_object_t* object);
@@ -14,13 +14,7 @@
  * limitations under the License.
  */
 
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wfloat-equal"
-#include <opencv2/imgproc.hpp>
-#pragma GCC diagnostic pop
-#include <opencv2/video.hpp>
 #include <stdlib.h>
-#include <sys/time.h>
 #include <syslog.h>
 
 #include <vdo-error.h>
@@ -28,23 +22,85 @@
 
 #include <cerrno>
 #include <cstdint>
+#include <cstdio>
 #include <cstdlib>
+#include <memory>
 
+#include <getopt.h>
 #include <poll.h>
 #include <unistd.h>
 
+#include "frame_replay.hpp"
+#include "latency_histogram.hpp"
+#include "motion_engine.hpp"
+#include "motion_event.hpp"
 #include "panic.h"
 
 using namespace cv;
 
-volatile sig_atomic_t running = 1;
+volatile sig_atomic_t running      = 1;
+volatile sig_atomic_t log_latency = 0;
 
 static void shutdown(int status) {
     (void)status;
     running = 0;
 }
 
-int main(void) {
+static void request_latency(int status) {
+    (void)status;
+    log_latency = 1;
+}
+
+struct Options {
+    // Frames to process instead of the VDO stream
+    const char* replay_file    = nullptr;
+    double replay_fps          = 0.0;
+    unsigned int replay_width  = 0;
+    unsigned int replay_height = 0;
+    // File to record the frames of the VDO stream to
+    const char* record_file    = nullptr;
+    unsigned int record_frames = 100;
+};
+
+static void parse_options(int argc, char** argv, Options& options) {
+    enum { OPT_REPLAY = 1, OPT_REPLAY_FPS, OPT_REPLAY_SIZE, OPT_RECORD, OPT_RECORD_FRAMES };
+    const option long_options[] = {
+        {"replay", required_argument, nullptr, OPT_REPLAY},
+        {"replay-fps", required_argument, nullptr, OPT_REPLAY_FPS},
+        {"replay-size", required_argument, nullptr, OPT_REPLAY_SIZE},
+        {"record", required_argument, nullptr, OPT_RECORD},
+        {"record-frames", required_argument, nullptr, OPT_RECORD_FRAMES},
+        {nullptr, 0, nullptr, 0},
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "", long_options, nullptr)) != -1) {
+        switch (opt) {
+            case OPT_REPLAY:
+                options.replay_file = optarg;
+                break;
+            case OPT_REPLAY_FPS:
+                options.replay_fps = strtod(optarg, nullptr);
+                break;
+            case OPT_REPLAY_SIZE:
+                if (sscanf(optarg, "%ux%u", &options.replay_width, &options.replay_height) != 2)
+                    panic("Invalid replay size %s, expected WIDTHxHEIGHT", optarg);
+                break;
+            case OPT_RECORD:
+                options.record_file = optarg;
+                break;
+            case OPT_RECORD_FRAMES:
+                options.record_frames = static_cast<unsigned int>(strtoul(optarg, nullptr, 10));
+                break;
+            default:
+                panic("Usage: %s [--replay FILE [--replay-fps FPS] [--replay-size WxH]] "
+                      "[--record FILE [--record-frames COUNT]]",
+                      argv[0]);
+        }
+    }
+}
+
+int main(int argc, char** argv) {
     g_autoptr(GError) vdo_error = nullptr;
     auto failed                 = [&vdo_error] {
         // Maintenance/Installation in progress (e.g. Global-Rotation)
@@ -59,120 +115,196 @@ int main(void) {
     // Stop main loop at signal
     signal(SIGTERM, shutdown);
     signal(SIGINT, shutdown);
+    // Log the latency histogram on demand, e.g. with: kill -USR1 $(pidof opencv_app)
+    signal(SIGUSR1, request_latency);
+
+    Options options;
+    parse_options(argc, argv, options);
 
     // The desired width and height of the Y800 frame
     unsigned int width         = 1024;
     unsigned int height        = 576;
+    unsigned int pitch         = width;
     unsigned int input_channel = 1;
 
-    syslog(LOG_INFO, "Running OpenCV example with VDO as video source");
-
-    // From vdo-stream.h
-    // AXIS OS 12.8+
-    // Unlike vdo_stream_new(), this API enables automatic framerate adjustment
-    // (to disable this feature, you need to explicitly specify the framerate).
-    // In addition, it applies several other defaults suitable for video analytics.
-    // It's still possible to override options such as 'buffer.count' or 'image.fit'.
-    // This convenience API is roughly equivalent to:
-    // vdo_map_set_boolean(settings, "socket.blocking", false);
-    // vdo_map_set_string(settings,  "image.fit", "scale");
-    // vdo_map_set_uint32(settings,  "buffer.count", 2u);
-    // vdo_map_set_uint32(settings,  "format", VDO_FORMAT_YUV);
-    // vdo_map_set_string(settings,  "subformat", "Y800");
-    // vdo_map_set_uint32(settings,  "input", ...);
-    // vdo_map_set_pair32u(settings, "resolution", ...);
-    //
-    // "image.fit"  "crop" clips to cover the frame and "scale" shrinks to contain the image (AXIS
-    // OS 12.7+ and Artpec-7+) "crop" works on all platforms. On Ambarella CV25, only YUV and RGB
-    // work with "scale".
-    g_autoptr(VdoStream) vdo_stream =
-        vdo_stream_y800_new(nullptr, input_channel, {width, height}, &vdo_error);
-    if (!vdo_stream)
-        return failed();
-
-    g_autoptr(VdoMap) vdo_info = vdo_stream_get_info(vdo_stream, &vdo_error);
-    if (!vdo_info)
-        return failed();
-
-    syslog(LOG_INFO, "Creating VDO image provider and creating stream %u x %u", width, height);
-
-    int fd = vdo_stream_get_fd(vdo_stream, &vdo_error);
-    if (fd < 0)
-        return failed();
-
-    pollfd fds = {
-        .fd     = fd,
-        .events = POLL_IN,
-    };
+    g_autoptr(VdoStream) vdo_stream = nullptr;
+    g_autoptr(VdoMap) vdo_info      = nullptr;
+    pollfd fds                      = {};
+    std::unique_ptr<FrameReplay> replay;
+    std::unique_ptr<FrameRecorder> recorder;
+
+    if (options.replay_file) {
+        // The recording has no header, its frames must have the size given here
+        if (options.replay_width > 0) {
+            width  = options.replay_width;
+            height = options.replay_height;
+            pitch  = width;
+        }
+        syslog(LOG_INFO,
+               "Running OpenCV example with a recording of %u x %u frames",
+               width,
+               height);
+        replay.reset(new FrameReplay(options.replay_file, width * height, options.replay_fps));
+    } else {
+        syslog(LOG_INFO, "Running OpenCV example with VDO as video source");
+
+        // From vdo-stream.h
+        // AXIS OS 12.8+
+        // Unlike vdo_stream_new(), this API enables automatic framerate adjustment
+        // (to disable this feature, you need to explicitly specify the framerate).
+        // In addition, it applies several other defaults suitable for video analytics.
+        // It's still possible to override options such as 'buffer.count' or 'image.fit'.
+        // This convenience API is roughly equivalent to:
+        // vdo_map_set_boolean(settings, "socket.blocking", false);
+        // vdo_map_set_string(settings,  "image.fit", "scale");
+        // vdo_map_set_uint32(settings,  "buffer.count", 2u);
+        // vdo_map_set_uint32(settings,  "format", VDO_FORMAT_YUV);
+        // vdo_map_set_string(settings,  "subformat", "Y800");
+        // vdo_map_set_uint32(settings,  "input", ...);
+        // vdo_map_set_pair32u(settings, "resolution", ...);
+        //
+        // "image.fit"  "crop" clips to cover the frame and "scale" shrinks to contain the image
+        // (AXIS OS 12.7+ and Artpec-7+) "crop" works on all platforms. On Ambarella CV25, only YUV
+        // and RGB work with "scale".
+        vdo_stream = vdo_stream_y800_new(nullptr, input_channel, {width, height}, &vdo_error);
+        if (!vdo_stream)
+            return failed();
 
-    syslog(LOG_INFO, "Start fetching video frames from VDO");
-    if (!vdo_stream_start(vdo_stream, &vdo_error))
-        return failed();
+        vdo_info = vdo_stream_get_info(vdo_stream, &vdo_error);
+        if (!vdo_info)
+            return failed();
 
-    // Create the background subtractor
-    Ptr<BackgroundSubtractorMOG2> bgsub = createBackgroundSubtractorMOG2();
+        syslog(LOG_INFO, "Creating VDO image provider and creating stream %u x %u", width, height);
 
-    // Create the filtering element. Its size influences what is considered
-    // noise, with a bigger size corresponding to more denoising
-    Mat kernel = getStructuringElement(MORPH_ELLIPSE, Size(9, 9));
+        int fd = vdo_stream_get_fd(vdo_stream, &vdo_error);
+        if (fd < 0)
+            return failed();
 
-    // Handle rotation 90/270, the width and height are swapped in the info map
-    // if rotation is 90/270.
-    width  = vdo_map_get_uint32(vdo_info, "width", width);
-    height = vdo_map_get_uint32(vdo_info, "height", height);
+        fds.fd     = fd;
+        fds.events = POLL_IN;
 
-    // Create OpenCV Mats for the camera frame (Y800)
-    // The foreground frame that is outputted by the background subtractor
-    Mat gray_image  = Mat(height, width, CV_8UC1);
-    gray_image.step = vdo_map_get_uint32(vdo_info, "pitch", width);
+        syslog(LOG_INFO, "Start fetching video frames from VDO");
+        if (!vdo_stream_start(vdo_stream, &vdo_error))
+            return failed();
 
-    Mat fg;
+        // Handle rotation 90/270, the width and height are swapped in the info map
+        // if rotation is 90/270.
+        width  = vdo_map_get_uint32(vdo_info, "width", width);
+        height = vdo_map_get_uint32(vdo_info, "height", height);
+        pitch  = vdo_map_get_uint32(vdo_info, "pitch", width);
 
-    while (running) {
-        struct timeval start_ts, end_ts;
-        unsigned int opencv_ms = 0;
+        if (options.record_file)
+            recorder.reset(new FrameRecorder(options.record_file, options.record_frames));
+    }
 
-        int status = TEMP_FAILURE_RETRY(poll(&fds, 1, -1));
-        if (status < 0)
-            panic("Failed to poll with status %d", status);
+    // Create the motion engine. Background subtraction runs on the frame halved
+    // once, which is plenty for motion detection and a quarter of the work.
+    // Add regions to config.rois, in frame coordinates, to only look for
+    // motion in parts of the image, e.g. config.rois.push_back(Rect(0, 288, 1024, 288)).
+    // The size of the filtering element influences what is considered noise,
+    // with a bigger size corresponding to more denoising.
+    MotionConfig config;
+    config.pyramid_level     = 1;
+    config.min_motion_pixels = 1;
+    config.filter_size       = 9;
+    config.learning_rate     = 0.005;
+    // Tiles where nothing has changed for a while only update the background
+    // model every 8th frame, which lets the camera idle when the scene is empty
+    config.gate_threshold = 4;
+    config.gate_interval  = 8;
+    MotionEngine motion(config, Size(width, height));
+    syslog(LOG_INFO,
+           "Analyzing motion at %d x %d in %zu tiles",
+           motion.analysis_size().width,
+           motion.analysis_size().height,
+           motion.num_tiles());
+
+    // Motion is reported with an event when it starts, and when no motion
+    // has been detected for a second
+    MotionEvent motion_event(1000);
+    LatencyHistogram latency;
+
+    // Create an OpenCV Mat for the camera frame (Y800)
+    Mat gray_image  = Mat(height, width, CV_8UC1);
+    gray_image.step = pitch;
 
-        // Get frame from vdo
-        g_autoptr(VdoBuffer) vdo_buf = vdo_stream_get_buffer(vdo_stream, &vdo_error);
-        if (!vdo_buf && g_error_matches(vdo_error, VDO_ERROR, VDO_ERROR_NO_DATA))
-            continue;  // Transient Error -> Retry!
+    gint64 replay_start_us = g_get_monotonic_time();
+    size_t num_frames      = 0;
 
-        if (!vdo_buf)
-            return failed();
+    while (running) {
+        g_autoptr(VdoBuffer) vdo_buf = nullptr;
+        gint64 start_us              = 0;
+
+        if (replay) {
+            const uint8_t* frame = replay->next();
+            if (!frame)
+                break;
+            start_us = g_get_monotonic_time();
+            // The frames are only read, the mapping of the recording is read-only
+            gray_image.data = const_cast<uint8_t*>(frame);
+        } else {
+            int status = TEMP_FAILURE_RETRY(poll(&fds, 1, -1));
+            if (status < 0)
+                panic("Failed to poll with status %d", status);
+
+            // Get frame from vdo
+            vdo_buf = vdo_stream_get_buffer(vdo_stream, &vdo_error);
+            if (!vdo_buf && g_error_matches(vdo_error, VDO_ERROR, VDO_ERROR_NO_DATA)) {
+                g_clear_error(&vdo_error);
+                continue;  // Transient Error -> Retry!
+            }
+
+            if (!vdo_buf)
+                return failed();
+
+            start_us = g_get_monotonic_time();
+            // Assign the VDO image buffer to the gray_image OpenCV Mat.
+            gray_image.data = static_cast<uint8_t*>(vdo_buffer_get_data(vdo_buf));
+
+            if (recorder)
+                recorder->write(gray_image.data, width, height, pitch);
+        }
+        num_frames++;
+
+        // Perform background subtraction and noise filtering on the parts of
+        // the image that are analyzed. We define movement in the image as at
+        // least min_motion_pixels pixels differing from the background.
+        bool motion_found = motion.process(gray_image);
+        latency.add(static_cast<uint64_t>(g_get_monotonic_time() - start_us));
+
+        // Only log and send an event when the motion state changes, instead
+        // of writing to the log every frame
+        if (motion_event.update(motion_found))
+            syslog(LOG_INFO, "Motion detected: %s", motion_event.active() ? "YES" : "NO");
+
+        if (log_latency) {
+            log_latency = 0;
+            latency.log();
+            syslog(LOG_INFO,
+                   "%d of %zu tiles idle in the last frame",
+                   motion.num_idle_tiles(),
+                   motion.num_tiles());
+        }
 
-        gettimeofday(&start_ts, nullptr);
-        // Assign the VDO image buffer to the gray_image OpenCV Mat.
-        gray_image.data = static_cast<uint8_t*>(vdo_buffer_get_data(vdo_buf));
-
-        // Perform background subtraction on the bgr image with
-        // learning rate 0.005. The resulting image should have
-        // pixel intensities > 0 only where changes have occurred
-        bgsub->apply(gray_image, fg, 0.005);
-
-        // Filter noise from the image with the filtering element
-        morphologyEx(fg, fg, MORPH_OPEN, kernel);
-
-        // We define movement in the image as any pixel being non-zero
-        int nonzero_pixels = countNonZero(fg);
-        if (nonzero_pixels > 0)
-            syslog(LOG_INFO, "Motion detected: YES");
-        else
-            syslog(LOG_INFO, "Motion detected: NO");
-
-        gettimeofday(&end_ts, nullptr);
-        opencv_ms = static_cast<unsigned int>(((end_ts.tv_sec - start_ts.tv_sec) * 1000) +
-                                              ((end_ts.tv_usec - start_ts.tv_usec) / 1000));
-        syslog(LOG_INFO, "Ran opencv for %u ms", opencv_ms);
+        // Dispatch the callbacks of the event system, which uses the default main context
+        while (g_main_context_pending(nullptr))
+            g_main_context_iteration(nullptr, FALSE);
         // Check if the framerate from vdo should be changed
 
         // This will allow vdo to fill this buffer with data again
-        if (!vdo_stream_buffer_unref(vdo_stream, &vdo_buf, &vdo_error))
+        if (vdo_buf && !vdo_stream_buffer_unref(vdo_stream, &vdo_buf, &vdo_error))
             return failed();
     }
+
+    if (replay) {
+        gint64 elapsed_us = g_get_monotonic_time() - replay_start_us;
+        syslog(LOG_INFO,
+               "Replayed %zu frames in %lld ms, %.1f frames per second",
+               num_frames,
+               static_cast<long long>(elapsed_us / 1000),
+               elapsed_us > 0 ? num_frames * 1e6 / elapsed_us : 0.0);
+        latency.log();
+    }
     syslog(LOG_INFO, "Exit opencv_app");
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,118 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "frame_replay.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <syslog.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <ctime>
+
+#include "panic.h"
+
+FrameRecorder::FrameRecorder(const char* path, unsigned int max_frames)
+    : file_(fopen(path, "wb")), max_frames_(max_frames) {
+    if (!file_)
+        panic("%s: Could not open %s: %m", __func__, path);
+    syslog(LOG_INFO, "Recording %u frames to %s", max_frames, path);
+}
+
+FrameRecorder::~FrameRecorder() {
+    close();
+}
+
+void FrameRecorder::close() {
+    if (!file_)
+        return;
+    if (fclose(file_) != 0)
+        syslog(LOG_ERR, "Could not write the recording: %m");
+    file_ = nullptr;
+    syslog(LOG_INFO, "Recorded %u frames", num_frames_);
+}
+
+void FrameRecorder::write(const uint8_t* data, size_t row_size, size_t rows, size_t pitch) {
+    if (!file_)
+        return;
+
+    // Like save_frame_to_file() in the vdostream example, but the rows are
+    // written one by one to leave out the padding
+    for (size_t row = 0; row < rows; row++) {
+        if (!fwrite(data + row * pitch, row_size, 1, file_))
+            panic("%s: Failed to write frame: %m", __func__);
+    }
+    if (++num_frames_ == max_frames_)
+        close();
+}
+
+FrameReplay::FrameReplay(const char* path, size_t frame_size, double fps)
+    : frame_size_(frame_size),
+      period_us_(fps > 0.0 ? static_cast<gint64>(G_USEC_PER_SEC / fps) : 0) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        panic("%s: Could not open %s: %m", __func__, path);
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+        panic("%s: Could not stat %s: %m", __func__, path);
+    file_size_  = static_cast<size_t>(st.st_size);
+    num_frames_ = frame_size_ > 0 ? file_size_ / frame_size_ : 0;
+    if (num_frames_ == 0)
+        panic("%s: %s holds no frames of %zu bytes", __func__, path, frame_size_);
+
+    void* data = mmap(nullptr, file_size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED)
+        panic("%s: Could not map %s: %m", __func__, path);
+    // The mapping keeps the file open
+    ::close(fd);
+
+    // The frames are read in order, let the kernel read ahead
+    madvise(data, file_size_, MADV_SEQUENTIAL);
+    data_ = static_cast<const uint8_t*>(data);
+
+    syslog(LOG_INFO, "Replaying %zu frames from %s", num_frames_, path);
+}
+
+FrameReplay::~FrameReplay() {
+    munmap(const_cast<uint8_t*>(data_), file_size_);
+}
+
+const uint8_t* FrameReplay::next() {
+    if (next_frame_ == num_frames_)
+        return nullptr;
+
+    if (next_frame_ == 0)
+        start_us_ = g_get_monotonic_time();
+
+    // Each frame is due one period after the previous one, so the rate does
+    // not drift when the processing of a frame takes a varying time
+    if (period_us_ > 0) {
+        gint64 due_us  = start_us_ + static_cast<gint64>(next_frame_) * period_us_;
+        gint64 wait_us = due_us - g_get_monotonic_time();
+        if (wait_us > 0) {
+            struct timespec ts = {
+                static_cast<time_t>(wait_us / G_USEC_PER_SEC),
+                static_cast<long>((wait_us % G_USEC_PER_SEC) * 1000),
+            };
+            while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+            }
+        }
+    }
+    return data_ + frame_size_ * next_frame_++;
+}
@@ -0,0 +1,102 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Recording of raw frames to a file, and replay of the file instead of a VDO
+ * stream.
+ *
+ * A recording is the frames one after the other with no header and no row
+ * padding, e.g. width * height bytes per frame for Y800, width * height * 3 / 2
+ * for NV12 and width * height * 3 for RGB. The same frames can then be
+ * processed again and again, independent of the sensor and the scene, which
+ * gives reproducible profiles and throughput benchmarks.
+ *
+ * The replay memory-maps the file, so the frames are read by the page cache
+ * and handed out without copies.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+#include <glib.h>
+
+class FrameRecorder {
+  public:
+    /**
+     * @brief Create a recording, the file is replaced if it exists.
+     *
+     * @param max_frames Number of frames to record, the later ones are ignored.
+     */
+    FrameRecorder(const char* path, unsigned int max_frames);
+    ~FrameRecorder();
+
+    FrameRecorder(const FrameRecorder&)            = delete;
+    FrameRecorder& operator=(const FrameRecorder&) = delete;
+
+    /**
+     * @brief Add a frame, without the padding at the end of each row.
+     *
+     * @param row_size Bytes of image data in each row.
+     * @param rows     Number of rows, all planes included.
+     * @param pitch    Bytes from the start of one row to the start of the next.
+     */
+    void write(const uint8_t* data, size_t row_size, size_t rows, size_t pitch);
+
+  private:
+    void close();
+
+    FILE* file_;
+    unsigned int max_frames_;
+    unsigned int num_frames_ = 0;
+};
+
+class FrameReplay {
+  public:
+    /**
+     * @brief Open a recording, the application panics if it cannot be mapped.
+     *
+     * @param frame_size Bytes of each frame in the recording.
+     * @param fps        Rate to hand out the frames at, 0 for as fast as they are processed.
+     */
+    FrameReplay(const char* path, size_t frame_size, double fps);
+    ~FrameReplay();
+
+    FrameReplay(const FrameReplay&)            = delete;
+    FrameReplay& operator=(const FrameReplay&) = delete;
+
+    /**
+     * @brief Wait until the next frame is due and return it.
+     *
+     * @return The frame, valid as long as the replay, or nullptr at the end of the recording.
+     */
+    const uint8_t* next();
+
+    size_t num_frames() const {
+        return num_frames_;
+    }
+
+  private:
+    const uint8_t* data_ = nullptr;
+    size_t file_size_    = 0;
+    size_t frame_size_;
+    size_t num_frames_ = 0;
+    size_t next_frame_ = 0;
+    gint64 period_us_;
+    gint64 start_us_ = 0;
+};
@@ -0,0 +1,84 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * An in-memory histogram of processing latencies.
+ *
+ * Adding a sample only increments a counter, so it can be done every frame.
+ * The buckets are powers of two in milliseconds: bucket 0 counts latencies
+ * below 1 ms, bucket i latencies from 2^(i-1) up to 2^i ms, and the last
+ * bucket everything above.
+ */
+
+#pragma once
+
+#include <syslog.h>
+
+#include <cstdint>
+
+class LatencyHistogram {
+  public:
+    static const int NUM_BUCKETS = 12;
+
+    void add(uint64_t latency_us) {
+        uint64_t ms = latency_us / 1000;
+        int bucket  = 0;
+        while (ms > 0 && bucket < NUM_BUCKETS - 1) {
+            ms >>= 1;
+            bucket++;
+        }
+        buckets_[bucket]++;
+        count_++;
+        sum_us_ += latency_us;
+        if (latency_us > max_us_)
+            max_us_ = latency_us;
+    }
+
+    /**
+     * @brief Write the histogram to the system log.
+     */
+    void log() const {
+        if (count_ == 0) {
+            syslog(LOG_INFO, "Latency: no frames processed");
+            return;
+        }
+        syslog(LOG_INFO,
+               "Latency of %llu frames: mean %llu us, max %llu us",
+               static_cast<unsigned long long>(count_),
+               static_cast<unsigned long long>(sum_us_ / count_),
+               static_cast<unsigned long long>(max_us_));
+        for (int i = 0; i < NUM_BUCKETS; i++) {
+            if (buckets_[i] == 0)
+                continue;
+            if (i == NUM_BUCKETS - 1)
+                syslog(LOG_INFO,
+                       "  >= %u ms: %llu",
+                       1u << (i - 1),
+                       static_cast<unsigned long long>(buckets_[i]));
+            else
+                syslog(LOG_INFO,
+                       "  < %u ms: %llu",
+                       1u << i,
+                       static_cast<unsigned long long>(buckets_[i]));
+        }
+    }
+
+  private:
+    uint64_t buckets_[NUM_BUCKETS] = {};
+    uint64_t count_                = 0;
+    uint64_t sum_us_               = 0;
+    uint64_t max_us_               = 0;
+};
@@ -0,0 +1,211 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "motion_engine.hpp"
+
+#include <algorithm>
+
+#include "panic.h"
+
+using namespace cv;
+
+// Number of mask rows counted between the checks against the threshold
+#define ROWS_PER_CHECK 16
+// How much the gate decimates the analyzed frame, and the size of its blocks in
+// decimated pixels. Each block covers 32 x 32 pixels of the analyzed frame.
+#define GATE_DECIMATION 4
+#define GATE_BLOCK_SIZE 8
+// Number of frames the blocks of a tile must be still before the tile is quiet
+#define GATE_STILL_FRAMES 5
+
+MotionEngine::MotionEngine(const MotionConfig& config, Size frame_size)
+    : learning_rate_(config.learning_rate),
+      count_(0),
+      gate_threshold_(config.gate_threshold),
+      gate_interval_(std::max(1, config.gate_interval)),
+      idle_count_(0) {
+    if (config.pyramid_level < 0 || frame_size.area() <= 0)
+        panic("Invalid motion engine pyramid level %d or frame size %d x %d",
+              config.pyramid_level,
+              frame_size.width,
+              frame_size.height);
+
+    // Each pyramid level rounds the size up when halving it
+    pyramid_.resize(config.pyramid_level);
+    analysis_size_ = frame_size;
+    for (int i = 0; i < config.pyramid_level; i++)
+        analysis_size_ = Size((analysis_size_.width + 1) / 2, (analysis_size_.height + 1) / 2);
+
+    Size decimated = decimated_size();
+    block_grid_    = Size((decimated.width + GATE_BLOCK_SIZE - 1) / GATE_BLOCK_SIZE,
+                          (decimated.height + GATE_BLOCK_SIZE - 1) / GATE_BLOCK_SIZE);
+
+    // Scale the threshold and the noise filter to the analysis resolution
+    int scale  = 1 << config.pyramid_level;
+    threshold_ = std::max(1, config.min_motion_pixels / (scale * scale));
+    int ksize  = std::max(3, (config.filter_size / scale) | 1);
+    kernel_    = getStructuringElement(MORPH_ELLIPSE, Size(ksize, ksize));
+
+    // Opening is an erosion followed by a dilation, so a filtered pixel
+    // depends on the mask pixels within twice the radius of the filter
+    int pad = 2 * (ksize / 2);
+
+    int num_tiles = config.tiles_per_roi > 0 ? config.tiles_per_roi : getNumberOfCPUs();
+    Rect frame_rect(Point(0, 0), analysis_size_);
+
+    if (config.rois.empty()) {
+        add_tiles(frame_rect, num_tiles, pad);
+        return;
+    }
+    for (const Rect& roi : config.rois) {
+        // Round outwards so that no part of the region is lost
+        Point tl(roi.x / scale, roi.y / scale);
+        Point br((roi.x + roi.width + scale - 1) / scale, (roi.y + roi.height + scale - 1) / scale);
+        Rect scaled = Rect(tl, br) & frame_rect;
+        if (scaled.area() <= 0)
+            panic("Motion ROI %d,%d %d x %d is outside of the frame",
+                  roi.x,
+                  roi.y,
+                  roi.width,
+                  roi.height);
+        add_tiles(scaled, num_tiles, pad);
+    }
+}
+
+void MotionEngine::add_tiles(const Rect& roi, int num_tiles, int pad) {
+    // Tiles thinner than the filter would mostly consist of overlap
+    num_tiles = std::max(1, std::min(num_tiles, roi.height / kernel_.rows));
+
+    for (int i = 0; i < num_tiles; i++) {
+        int top    = roi.y + roi.height * i / num_tiles;
+        int bottom = roi.y + roi.height * (i + 1) / num_tiles;
+        // The overlap is kept within the region, so tiling does not change the result
+        int padded_top    = std::max(roi.y, top - pad);
+        int padded_bottom = std::min(roi.y + roi.height, bottom + pad);
+
+        Tile tile;
+        tile.padded = Rect(roi.x, padded_top, roi.width, padded_bottom - padded_top);
+        tile.inner  = Rect(0, top - padded_top, roi.width, bottom - top);
+        tile.blocks = block_rect(Rect(roi.x, top, roi.width, bottom - top));
+        tile.bgsub  = createBackgroundSubtractorMOG2();
+        tiles_.push_back(tile);
+    }
+}
+
+Size MotionEngine::decimated_size() const {
+    return Size(std::max(1, analysis_size_.width / GATE_DECIMATION),
+                std::max(1, analysis_size_.height / GATE_DECIMATION));
+}
+
+Rect MotionEngine::block_rect(const Rect& area) const {
+    // Round outwards, so every block that overlaps the area is included
+    int width  = analysis_size_.width;
+    int height = analysis_size_.height;
+    Point tl(area.x * block_grid_.width / width, area.y * block_grid_.height / height);
+    Point br(((area.x + area.width) * block_grid_.width + width - 1) / width,
+             ((area.y + area.height) * block_grid_.height + height - 1) / height);
+    return Rect(tl, br) & Rect(Point(0, 0), block_grid_);
+}
+
+void MotionEngine::update_gate(const Mat& image) {
+    if (gate_threshold_ <= 0)
+        return;
+
+    // The averaging resize and absdiff are vectorized by OpenCV, with NEON on the camera
+    resize(image, decimated_, decimated_size(), 0, 0, INTER_AREA);
+    if (!prev_decimated_.empty()) {
+        absdiff(decimated_, prev_decimated_, diff_);
+        resize(diff_, block_diff_, block_grid_, 0, 0, INTER_AREA);
+    }
+    std::swap(decimated_, prev_decimated_);
+}
+
+bool MotionEngine::tile_still(const Tile& tile) const {
+    if (block_diff_.empty())
+        return false;
+
+    double max_diff = 0;
+    minMaxLoc(block_diff_(tile.blocks), nullptr, &max_diff);
+    return max_diff < gate_threshold_;
+}
+
+void MotionEngine::process_tile(Tile& tile, const Mat& image) {
+    if (!tile_still(tile))
+        tile.still_frames = 0;
+    else if (tile.still_frames <= GATE_STILL_FRAMES)
+        tile.still_frames++;
+
+    double learning_rate = learning_rate_;
+    if (tile.still_frames > GATE_STILL_FRAMES && !tile.motion) {
+        // Nothing moves and nothing differs from the background, so the
+        // model is only updated every gate_interval frames, with a learning
+        // rate that makes up for the skipped frames
+        if (++tile.idle_frames < gate_interval_) {
+            idle_count_.fetch_add(1);
+            return;
+        }
+        learning_rate = std::min(1.0, learning_rate_ * gate_interval_);
+    }
+    tile.idle_frames = 0;
+
+    // The background model is updated even if enough motion has been found,
+    // otherwise the tile would lag behind the scene
+    tile.bgsub->apply(image(tile.padded), tile.fg, learning_rate);
+    if (count_.load() >= threshold_) {
+        // The mask is not counted, so it can not be assumed to be free of motion
+        tile.motion = true;
+        return;
+    }
+
+    // Filter noise from the mask with the filtering element
+    morphologyEx(tile.fg, tile.fg, MORPH_OPEN, kernel_);
+
+    tile.motion = false;
+    Mat inner   = tile.fg(tile.inner);
+    for (int y = 0; y < inner.rows; y += ROWS_PER_CHECK) {
+        int nonzero = countNonZero(inner.rowRange(y, std::min(y + ROWS_PER_CHECK, inner.rows)));
+        if (nonzero == 0)
+            continue;
+        tile.motion = true;
+        if (count_.fetch_add(nonzero) + nonzero >= threshold_)
+            return;
+    }
+}
+
+bool MotionEngine::process(const Mat& frame) {
+    const Mat* image = &frame;
+    for (Mat& level : pyramid_) {
+        pyrDown(*image, level);
+        image = &level;
+    }
+
+    update_gate(*image);
+
+    count_.store(0);
+    idle_count_.store(0);
+    // One stripe per tile, a tile is never split between threads
+    parallel_for_(
+        Range(0, static_cast<int>(tiles_.size())),
+        [this, image](const Range& range) {
+            for (int i = range.start; i < range.end; i++)
+                process_tile(tiles_[i], *image);
+        },
+        static_cast<double>(tiles_.size()));
+
+    motion_pixels_ = count_.load();
+    idle_tiles_    = idle_count_.load();
+    return motion_pixels_ >= threshold_;
+}
@@ -0,0 +1,155 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Motion detection with MOG2 background subtraction on a downscaled frame.
+ *
+ * The frame is first downscaled a configurable number of pyramid levels, each
+ * level halving the width and height. Only the regions of interest are then
+ * analyzed. Each region is split into horizontal tiles that are processed in
+ * parallel with cv::parallel_for_, so all cores of the camera are used. Every
+ * tile has its own background subtractor, which gives the same result as one
+ * subtractor for the whole region since the model is per pixel. The tiles
+ * overlap by the reach of the noise filter, so filtering is not affected by
+ * the tile borders either.
+ *
+ * Before the background subtraction, a cheap gate compares the frame with the
+ * previous one. The frame is decimated further and the mean absolute
+ * difference of each block is computed. A tile whose blocks have all been
+ * still for a number of frames, and that had no motion, is quiet. Quiet tiles
+ * only update their background model every gate_interval frames, with the
+ * learning rate raised by the same factor so the model adapts as fast as
+ * before. A quiet tile wakes up as soon as any of its blocks changes.
+ *
+ * Once the motion pixel threshold is reached, the remaining tiles update their
+ * background model but skip filtering and counting.
+ */
+
+#pragma once
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wfloat-equal"
+#include <opencv2/imgproc.hpp>
+#pragma GCC diagnostic pop
+#include <opencv2/video.hpp>
+
+#include <atomic>
+#include <vector>
+
+struct MotionConfig {
+    // Number of times the frame is halved before the analysis
+    int pyramid_level = 1;
+    // Regions to analyze in full frame coordinates, the whole frame if empty.
+    // Regions should not overlap, since overlapping motion is counted twice.
+    std::vector<cv::Rect> rois;
+    // Number of motion pixels, at full resolution, that is reported as motion
+    int min_motion_pixels = 1;
+    // Size of the noise filter at full resolution
+    int filter_size = 9;
+    // How fast the background model adapts to changes in the scene
+    double learning_rate = 0.005;
+    // Number of tiles each region is split into, the number of cores if 0
+    int tiles_per_roi = 0;
+    // Mean absolute difference of a block, in gray levels, from which the
+    // block counts as changed. The gate is disabled if 0.
+    int gate_threshold = 4;
+    // How often quiet tiles update their background model, in frames
+    int gate_interval = 8;
+};
+
+class MotionEngine {
+  public:
+    MotionEngine(const MotionConfig& config, cv::Size frame_size);
+
+    /**
+     * @brief Update the background model with a frame and look for motion.
+     *
+     * @param frame Y800 frame of the size given to the constructor.
+     *
+     * @return True if at least the configured number of motion pixels were found.
+     */
+    bool process(const cv::Mat& frame);
+
+    /**
+     * @brief Number of motion pixels found in the last frame, at analysis resolution.
+     *
+     * When the analysis exits early, the count is only a lower bound.
+     */
+    int motion_pixels() const {
+        return motion_pixels_;
+    }
+
+    cv::Size analysis_size() const {
+        return analysis_size_;
+    }
+
+    size_t num_tiles() const {
+        return tiles_.size();
+    }
+
+    /**
+     * @brief Number of tiles that skipped the background subtraction in the last frame.
+     */
+    int num_idle_tiles() const {
+        return idle_tiles_;
+    }
+
+  private:
+    struct Tile {
+        // Area that is filtered, including the overlap with its neighbors
+        cv::Rect padded;
+        // Area that is counted, relative to padded
+        cv::Rect inner;
+        // Blocks of the gate that cover the counted area
+        cv::Rect blocks;
+        cv::Ptr<cv::BackgroundSubtractorMOG2> bgsub;
+        cv::Mat fg;
+        // Number of frames in a row that the blocks have been still, up to the limit
+        int still_frames = 0;
+        // Number of frames the update of the background model has been skipped
+        int idle_frames = 0;
+        // If the last mask had motion, or was not counted since the threshold was reached
+        bool motion = true;
+    };
+
+    void add_tiles(const cv::Rect& roi, int num_tiles, int pad);
+    cv::Size decimated_size() const;
+    cv::Rect block_rect(const cv::Rect& area) const;
+    void update_gate(const cv::Mat& image);
+    bool tile_still(const Tile& tile) const;
+    void process_tile(Tile& tile, const cv::Mat& image);
+
+    double learning_rate_;
+    int threshold_;
+    cv::Mat kernel_;
+    cv::Size analysis_size_;
+    std::vector<cv::Mat> pyramid_;
+    std::vector<Tile> tiles_;
+    std::atomic<int> count_;
+    int motion_pixels_ = 0;
+
+    int gate_threshold_;
+    int gate_interval_;
+    // The frame decimated for the gate, and the previous one
+    cv::Mat decimated_;
+    cv::Mat prev_decimated_;
+    cv::Mat diff_;
+    // Mean absolute difference of each block, empty until there is a previous frame
+    cv::Mat block_diff_;
+    cv::Size block_grid_;
+    std::atomic<int> idle_count_;
+    int idle_tiles_ = 0;
+};
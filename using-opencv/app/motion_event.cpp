@@ -0,0 +1,118 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "motion_event.hpp"
+
+#include <syslog.h>
+
+#include "panic.h"
+
+MotionEvent::MotionEvent(guint hold_ms)
+    : event_handler_(ax_event_handler_new()), hold_us_(static_cast<gint64>(hold_ms) * 1000) {
+    GError* error   = nullptr;
+    gboolean active = FALSE;
+
+    AXEventKeyValueSet* key_value_set = ax_event_key_value_set_new();
+    ax_event_key_value_set_add_key_value(key_value_set,
+                                         "topic0",
+                                         "tnsaxis",
+                                         "CameraApplicationPlatform",
+                                         AX_VALUE_TYPE_STRING,
+                                         nullptr);
+    ax_event_key_value_set_add_key_value(key_value_set,
+                                         "topic1",
+                                         "tnsaxis",
+                                         "opencv_app",
+                                         AX_VALUE_TYPE_STRING,
+                                         nullptr);
+    ax_event_key_value_set_add_key_value(key_value_set,
+                                         "topic2",
+                                         "tnsaxis",
+                                         "Motion",
+                                         AX_VALUE_TYPE_STRING,
+                                         nullptr);
+    ax_event_key_value_set_add_key_value(key_value_set,
+                                         "active",
+                                         nullptr,
+                                         &active,
+                                         AX_VALUE_TYPE_BOOL,
+                                         nullptr);
+    ax_event_key_value_set_mark_as_data(key_value_set, "active", nullptr, nullptr);
+
+    if (!ax_event_handler_declare(event_handler_,
+                                  key_value_set,
+                                  FALSE,  // Indicate a property state event
+                                  &declaration_,
+                                  declaration_complete,
+                                  this,
+                                  &error))
+        panic("Could not declare motion event: %s", error->message);
+
+    // The key/value set is no longer needed
+    ax_event_key_value_set_free(key_value_set);
+}
+
+MotionEvent::~MotionEvent() {
+    ax_event_handler_undeclare(event_handler_, declaration_, nullptr);
+    ax_event_handler_free(event_handler_);
+}
+
+void MotionEvent::declaration_complete(guint declaration, gpointer user_data) {
+    MotionEvent* motion_event = static_cast<MotionEvent*>(user_data);
+    syslog(LOG_INFO, "Declaration complete for: %u", declaration);
+
+    motion_event->declared_ = true;
+    // The event was declared inactive, send the state if motion was found meanwhile
+    if (motion_event->active_)
+        motion_event->send();
+}
+
+void MotionEvent::send() {
+    GError* error   = nullptr;
+    gboolean active = active_ ? TRUE : FALSE;
+
+    AXEventKeyValueSet* key_value_set = ax_event_key_value_set_new();
+    ax_event_key_value_set_add_key_value(key_value_set,
+                                         "active",
+                                         nullptr,
+                                         &active,
+                                         AX_VALUE_TYPE_BOOL,
+                                         nullptr);
+    AXEvent* event = ax_event_new2(key_value_set, nullptr);
+    ax_event_key_value_set_free(key_value_set);
+
+    if (!ax_event_handler_send_event(event_handler_, declaration_, event, &error)) {
+        syslog(LOG_WARNING, "Could not send motion event: %s", error->message);
+        g_error_free(error);
+    }
+    ax_event_free(event);
+}
+
+bool MotionEvent::update(bool motion) {
+    gint64 now = g_get_monotonic_time();
+    if (motion)
+        last_motion_us_ = now;
+
+    // Motion activates the event at once, but it is only deactivated after the hold time
+    bool active = motion || (active_ && now - last_motion_us_ < hold_us_);
+    if (active == active_)
+        return false;
+
+    active_ = active;
+    if (declared_)
+        send();
+    return true;
+}
@@ -0,0 +1,64 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * A stateful motion event that is only sent when the motion state changes.
+ *
+ * The event is declared with the topic
+ * tnsaxis:CameraApplicationPlatform/opencv_app/Motion and has the data item
+ * "active". It becomes active as soon as motion is detected, and inactive
+ * when no motion has been detected for the hold time, so a single quiet frame
+ * within a movement does not toggle the event.
+ *
+ * The event system calls back from the default GLib main context, which must
+ * be iterated for the declaration to complete.
+ */
+
+#pragma once
+
+#include <axsdk/axevent.h>
+#include <glib.h>
+
+class MotionEvent {
+  public:
+    explicit MotionEvent(guint hold_ms);
+    ~MotionEvent();
+
+    MotionEvent(const MotionEvent&)            = delete;
+    MotionEvent& operator=(const MotionEvent&) = delete;
+
+    /**
+     * @brief Update the state with the result of a frame.
+     *
+     * @return True if the state changed.
+     */
+    bool update(bool motion);
+
+    bool active() const {
+        return active_;
+    }
+
+  private:
+    static void declaration_complete(guint declaration, gpointer user_data);
+    void send();
+
+    AXEventHandler* event_handler_;
+    guint declaration_ = 0;
+    bool declared_     = false;
+    bool active_       = false;
+    gint64 hold_us_;
+    gint64 last_motion_us_ = 0;
+};
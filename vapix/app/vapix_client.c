@@ -0,0 +1,294 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "vapix_client.h"
+
+#include <syslog.h>
+
+#include "panic.h"
+
+#define VAPIX_URL "http://127.0.0.12/axis-cgi/"
+
+static void lock_share(CURL* handle, curl_lock_data data, curl_lock_access access, void* userptr) {
+    (void)handle;
+    (void)access;
+    g_mutex_lock(&((vapix_client_t*)userptr)->locks[data]);
+}
+
+static void unlock_share(CURL* handle, curl_lock_data data, void* userptr) {
+    (void)handle;
+    g_mutex_unlock(&((vapix_client_t*)userptr)->locks[data]);
+}
+
+static size_t append_to_gstring_callback(char* ptr, size_t size, size_t nmemb, void* userdata) {
+    size_t processed_bytes = size * nmemb;
+    g_string_append_len((GString*)userdata, ptr, processed_bytes);
+    return processed_bytes;
+}
+
+// Copy the credentials from the cache if they have been refreshed
+static void update_credentials(vapix_client_t* client) {
+    char* userpwd = vapix_credentials_get(client->credentials, &client->credentials_generation);
+    if (userpwd) {
+        g_free(client->userpwd);
+        client->userpwd = userpwd;
+    }
+}
+
+vapix_client_t* vapix_client_new(vapix_credentials_t* credentials) {
+    vapix_client_t* client = g_new0(vapix_client_t, 1);
+    client->credentials    = credentials;
+
+    for (int i = 0; i < CURL_LOCK_DATA_LAST; i++)
+        g_mutex_init(&client->locks[i]);
+
+    client->share = curl_share_init();
+    if (!client->share)
+        panic("curl_share_init failed");
+    curl_share_setopt(client->share, CURLSHOPT_LOCKFUNC, lock_share);
+    curl_share_setopt(client->share, CURLSHOPT_UNLOCKFUNC, unlock_share);
+    curl_share_setopt(client->share, CURLSHOPT_USERDATA, client);
+    curl_share_setopt(client->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(client->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    curl_share_setopt(client->share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+
+    client->multi = curl_multi_init();
+    if (!client->multi)
+        panic("curl_multi_init failed");
+    curl_multi_setopt(client->multi, CURLMOPT_PIPELINING, (long)CURLPIPE_MULTIPLEX);
+    curl_multi_setopt(client->multi, CURLMOPT_MAX_HOST_CONNECTIONS, (long)VAPIX_MAX_PARALLEL);
+
+    // The options that are the same for all requests are set once
+    for (int i = 0; i < VAPIX_MAX_PARALLEL; i++) {
+        CURL* handle = curl_easy_init();
+        if (!handle)
+            panic("curl_easy_init failed");
+        curl_easy_setopt(handle, CURLOPT_SHARE, client->share);
+        curl_easy_setopt(handle, CURLOPT_HTTPAUTH, CURLAUTH_BASIC);
+        curl_easy_setopt(handle, CURLOPT_TCP_KEEPALIVE, 1L);
+        // Wait for a connection that can be multiplexed rather than open another one
+        curl_easy_setopt(handle, CURLOPT_PIPEWAIT, 1L);
+        curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, append_to_gstring_callback);
+        client->handles[i] = handle;
+    }
+    return client;
+}
+
+void vapix_client_free(vapix_client_t* client) {
+    if (!client)
+        return;
+
+    syslog(LOG_INFO,
+           "Made %ld VAPIX requests over %ld connections",
+           client->num_requests,
+           client->num_connections);
+
+    if (client->properties)
+        json_decref(client->properties);
+    for (int i = 0; i < VAPIX_MAX_PARALLEL; i++)
+        curl_easy_cleanup(client->handles[i]);
+    curl_multi_cleanup(client->multi);
+    curl_share_cleanup(client->share);
+    for (int i = 0; i < CURL_LOCK_DATA_LAST; i++)
+        g_mutex_clear(&client->locks[i]);
+    g_free(client->userpwd);
+    g_free(client);
+}
+
+static void prepare(vapix_client_t* client,
+                    CURL* handle,
+                    const vapix_request_t* request,
+                    GString* response) {
+    char* url = g_strdup_printf(VAPIX_URL "%s", request->endpoint);
+    curl_easy_setopt(handle, CURLOPT_URL, url);
+    curl_easy_setopt(handle, CURLOPT_USERPWD, client->userpwd);
+    curl_easy_setopt(handle, CURLOPT_POSTFIELDS, request->body);
+    curl_easy_setopt(handle, CURLOPT_WRITEDATA, response);
+    // The URL and the credentials are copied by curl
+    g_free(url);
+}
+
+/**
+ * Returns the response, or NULL if the credentials were rejected and the
+ * request may be retried.
+ */
+static char* finish(vapix_client_t* client,
+                    CURL* handle,
+                    CURLcode res,
+                    const vapix_request_t* request,
+                    GString* response,
+                    gboolean may_retry) {
+    if (res != CURLE_OK)
+        panic("curl error %d: '%s'", res, curl_easy_strerror(res));
+
+    long response_code;
+    long num_connects = 0;
+    curl_easy_getinfo(handle, CURLINFO_RESPONSE_CODE, &response_code);
+    curl_easy_getinfo(handle, CURLINFO_NUM_CONNECTS, &num_connects);
+    client->num_requests++;
+    client->num_connections += num_connects;
+
+    if (response_code == 401 && may_retry) {
+        syslog(LOG_INFO, "VAPIX credentials rejected, fetching them again");
+        g_string_truncate(response, 0);
+        return NULL;
+    }
+    if (response_code != 200)
+        panic("Got response code %ld from request to %s with response '%s'",
+              response_code,
+              request->body,
+              response->str);
+
+    return g_string_free(response, FALSE);
+}
+
+char* vapix_client_post(vapix_client_t* client, const char* endpoint, const char* request) {
+    const vapix_request_t post = {.endpoint = endpoint, .body = request};
+    GString* response          = g_string_new(NULL);
+    CURL* handle               = client->handles[0];
+
+    update_credentials(client);
+    prepare(client, handle, &post, response);
+    char* result = finish(client, handle, curl_easy_perform(handle), &post, response, TRUE);
+    if (!result) {
+        vapix_credentials_refresh(client->credentials);
+        update_credentials(client);
+        prepare(client, handle, &post, response);
+        result = finish(client, handle, curl_easy_perform(handle), &post, response, FALSE);
+    }
+    return result;
+}
+
+json_t* vapix_client_post_json(vapix_client_t* client, const char* endpoint, const char* request) {
+    char* text_response = vapix_client_post(client, endpoint, request);
+    json_error_t parse_error;
+    json_t* json_response = json_loads(text_response, 0, &parse_error);
+    if (!json_response)
+        panic("Invalid JSON response: %s", parse_error.text);
+
+    const json_t* request_error = json_object_get(json_response, "error");
+    if (request_error)
+        panic("Failed to perform request: %s",
+              json_string_value(json_object_get(request_error, "message")));
+
+    g_free(text_response);
+    return json_response;
+}
+
+// Start or retry a request of a batch on a handle, its index is kept as private data
+static void start(vapix_client_t* client,
+                  CURL* handle,
+                  const vapix_request_t* requests,
+                  GString** responses,
+                  size_t index) {
+    if (!responses[index])
+        responses[index] = g_string_new(NULL);
+    prepare(client, handle, &requests[index], responses[index]);
+    curl_easy_setopt(handle, CURLOPT_PRIVATE, GSIZE_TO_POINTER(index));
+    curl_multi_add_handle(client->multi, handle);
+}
+
+void vapix_client_post_all(vapix_client_t* client, vapix_request_t* requests, size_t num_requests) {
+    GString** responses = g_new0(GString*, num_requests);
+    gboolean* retried   = g_new0(gboolean, num_requests);
+    gboolean refreshed  = FALSE;
+    size_t next         = 0;
+    int active          = 0;
+
+    update_credentials(client);
+
+    for (int i = 0; i < VAPIX_MAX_PARALLEL && next < num_requests; i++) {
+        start(client, client->handles[i], requests, responses, next++);
+        active++;
+    }
+
+    while (active > 0) {
+        int running;
+        CURLMcode mres = curl_multi_perform(client->multi, &running);
+        if (mres != CURLM_OK)
+            panic("curl_multi_perform error %d: '%s'", mres, curl_multi_strerror(mres));
+
+        CURLMsg* msg;
+        int queued;
+        while ((msg = curl_multi_info_read(client->multi, &queued))) {
+            if (msg->msg != CURLMSG_DONE)
+                continue;
+
+            CURL* handle = msg->easy_handle;
+            void* private;
+            curl_easy_getinfo(handle, CURLINFO_PRIVATE, &private);
+            size_t index = GPOINTER_TO_SIZE(private);
+            requests[index].response = finish(client,
+                                              handle,
+                                              msg->data.result,
+                                              &requests[index],
+                                              responses[index],
+                                              !retried[index]);
+            curl_multi_remove_handle(client->multi, handle);
+
+            // Retry with new credentials, fetched once for all the rejected requests
+            if (!requests[index].response) {
+                if (!refreshed) {
+                    vapix_credentials_refresh(client->credentials);
+                    update_credentials(client);
+                    refreshed = TRUE;
+                }
+                retried[index] = TRUE;
+                start(client, handle, requests, responses, index);
+                continue;
+            }
+            active--;
+
+            // Reuse the handle for the next request
+            if (next < num_requests) {
+                start(client, handle, requests, responses, next++);
+                active++;
+            }
+        }
+
+        if (active > 0) {
+            mres = curl_multi_poll(client->multi, NULL, 0, 1000, NULL);
+            if (mres != CURLM_OK)
+                panic("curl_multi_poll error %d: '%s'", mres, curl_multi_strerror(mres));
+        }
+    }
+    g_free(retried);
+    g_free(responses);
+}
+
+const char* vapix_client_get_property(vapix_client_t* client, const char* name) {
+    if (!client->properties || g_get_monotonic_time() >= client->properties_expire_us) {
+        const char* request =
+            "{"
+            "  \"apiVersion\": \"1.3\","
+            "  \"method\": \"getAllProperties\""
+            "}";
+        vapix_client_invalidate_properties(client);
+        client->properties = vapix_client_post_json(client, "basicdeviceinfo.cgi", request);
+        client->properties_expire_us =
+            g_get_monotonic_time() + (gint64)VAPIX_PROPERTY_TTL_S * G_USEC_PER_SEC;
+    }
+
+    const json_t* data      = json_object_get(client->properties, "data");
+    const json_t* prop_list = json_object_get(data, "propertyList");
+    return json_string_value(json_object_get(prop_list, name));
+}
+
+void vapix_client_invalidate_properties(vapix_client_t* client) {
+    if (client->properties)
+        json_decref(client->properties);
+    client->properties = NULL;
+}
@@ -0,0 +1,113 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Client for the VAPIX APIs of the device, for applications that call them
+ * repeatedly.
+ *
+ * The connections, the DNS cache and the TLS sessions are kept in a curl share
+ * handle, and the easy handles are reused, so a call only sets up a connection
+ * when there is no idle one to the device. A batch of requests is performed
+ * in parallel with a curl multi handle, multiplexed over one connection when
+ * the server speaks HTTP/2 and over up to VAPIX_MAX_PARALLEL connections when
+ * it does not.
+ *
+ * The credentials are taken from a vapix_credentials_t cache, and copied only
+ * when they have been refreshed. A request that is rejected
+ * with 401 is retried once with credentials fetched again.
+ *
+ * The properties from basic device information are cached, since they rarely
+ * change, until they are VAPIX_PROPERTY_TTL_S seconds old or invalidated.
+ *
+ * Any error is fatal, like in the rest of this example.
+ */
+
+#pragma once
+
+#include <curl/curl.h>
+#include <glib.h>
+#include <jansson.h>
+
+#include "vapix_credentials.h"
+
+#define VAPIX_MAX_PARALLEL   4
+#define VAPIX_PROPERTY_TTL_S 300
+
+typedef struct vapix_client {
+    vapix_credentials_t* credentials;
+    // Copy of the credentials, and their generation
+    char* userpwd;
+    guint credentials_generation;
+    CURLSH* share;
+    // Locks of the data in the share handle
+    GMutex locks[CURL_LOCK_DATA_LAST];
+    CURLM* multi;
+    CURL* handles[VAPIX_MAX_PARALLEL];
+
+    json_t* properties;
+    gint64 properties_expire_us;
+
+    long num_requests;
+    long num_connections;
+} vapix_client_t;
+
+typedef struct vapix_request {
+    const char* endpoint;
+    const char* body;
+    // Set by vapix_client_post_all(), freed with g_free()
+    char* response;
+} vapix_request_t;
+
+/**
+ * Create a client with the credentials from a cache, which must outlive it.
+ */
+vapix_client_t* vapix_client_new(vapix_credentials_t* credentials);
+
+void vapix_client_free(vapix_client_t* client);
+
+/**
+ * Post a request to an endpoint under axis-cgi.
+ *
+ * Returns the response, freed with g_free().
+ */
+char* vapix_client_post(vapix_client_t* client, const char* endpoint, const char* request);
+
+/**
+ * Post a JSON request and parse the response, which must not be an error.
+ *
+ * Returns the response, freed with json_decref().
+ */
+json_t* vapix_client_post_json(vapix_client_t* client, const char* endpoint, const char* request);
+
+/**
+ * Post the requests in parallel, and set their responses.
+ */
+void vapix_client_post_all(vapix_client_t* client, vapix_request_t* requests, size_t num_requests);
+
+/**
+ * Read a property from basic device information, fetched with
+ * getAllProperties when the cache is empty or too old.
+ *
+ * Returns the value, valid until the cache is refreshed or invalidated, or
+ * NULL if there is no such property.
+ */
+const char* vapix_client_get_property(vapix_client_t* client, const char* name);
+
+/**
+ * Drop the cached properties, e.g. when the application knows that they
+ * have changed, so the next read fetches them again.
+ */
+void vapix_client_invalidate_properties(vapix_client_t* client);
@@ -0,0 +1,176 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "vapix_credentials.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <syslog.h>
+
+#include "panic.h"
+
+#define LIFETIME_US ((gint64)VAPIX_CREDENTIALS_LIFETIME_S * G_USEC_PER_SEC)
+#define REFRESH_US  (LIFETIME_US * VAPIX_CREDENTIALS_REFRESH_PERCENT / 100)
+
+static char* parse_credentials(GVariant* result) {
+    char* credentials_string = NULL;
+    char* id                 = NULL;
+    char* password           = NULL;
+
+    g_variant_get(result, "(&s)", &credentials_string);
+    if (sscanf(credentials_string, "%m[^:]:%ms", &id, &password) != 2) {
+        free(id);
+        return NULL;
+    }
+    char* credentials = g_strdup_printf("%s:%s", id, password);
+
+    free(id);
+    free(password);
+    return credentials;
+}
+
+// Returns the credentials, or NULL with error set
+static char* fetch(vapix_credentials_t* credentials, GError** error) {
+    const char* bus_name       = "com.axis.HTTPConf1";
+    const char* object_path    = "/com/axis/HTTPConf1/VAPIXServiceAccounts1";
+    const char* interface_name = "com.axis.HTTPConf1.VAPIXServiceAccounts1";
+    const char* method_name    = "GetCredentials";
+
+    GVariant* result = g_dbus_connection_call_sync(credentials->connection,
+                                                   bus_name,
+                                                   object_path,
+                                                   interface_name,
+                                                   method_name,
+                                                   g_variant_new("(s)", credentials->username),
+                                                   NULL,
+                                                   G_DBUS_CALL_FLAGS_NONE,
+                                                   -1,
+                                                   NULL,
+                                                   error);
+    if (!result)
+        return NULL;
+
+    char* value = parse_credentials(result);
+    g_variant_unref(result);
+    if (!value)
+        g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "Malformed credentials");
+    return value;
+}
+
+// Store new credentials, with the mutex held
+static void store(vapix_credentials_t* credentials, char* value) {
+    g_free(credentials->credentials);
+    credentials->credentials = value;
+    credentials->generation++;
+    credentials->fetched_us = g_get_monotonic_time();
+}
+
+static void fetch_and_store(vapix_credentials_t* credentials) {
+    GError* error = NULL;
+    char* value   = fetch(credentials, &error);
+    if (!value)
+        panic("Error fetching VAPIX credentials: %s", error->message);
+    store(credentials, value);
+}
+
+static gpointer refresh_thread(gpointer data) {
+    vapix_credentials_t* credentials = data;
+    gint64 retry_us                  = 0;
+
+    g_mutex_lock(&credentials->mutex);
+    while (!credentials->stopping) {
+        // Later when the credentials are fetched by a caller meanwhile
+        gint64 refresh_us = MAX(credentials->fetched_us + REFRESH_US, retry_us);
+        if (g_get_monotonic_time() < refresh_us) {
+            g_cond_wait_until(&credentials->cond, &credentials->mutex, refresh_us);
+            continue;
+        }
+
+        // The cached credentials stay usable while D-Bus is called
+        g_mutex_unlock(&credentials->mutex);
+        GError* error = NULL;
+        char* value   = fetch(credentials, &error);
+        g_mutex_lock(&credentials->mutex);
+
+        if (value) {
+            store(credentials, value);
+        } else {
+            syslog(LOG_WARNING, "Error refreshing VAPIX credentials: %s", error->message);
+            g_error_free(error);
+            retry_us = g_get_monotonic_time() + VAPIX_CREDENTIALS_RETRY_S * G_USEC_PER_SEC;
+        }
+    }
+    g_mutex_unlock(&credentials->mutex);
+    return NULL;
+}
+
+vapix_credentials_t* vapix_credentials_new(const char* username) {
+    vapix_credentials_t* credentials = g_new0(vapix_credentials_t, 1);
+    credentials->username            = g_strdup(username);
+
+    GError* error           = NULL;
+    credentials->connection = g_bus_get_sync(G_BUS_TYPE_SYSTEM, NULL, &error);
+    if (!credentials->connection)
+        panic("Error connecting to D-Bus: %s", error->message);
+
+    g_mutex_init(&credentials->mutex);
+    g_cond_init(&credentials->cond);
+    fetch_and_store(credentials);
+
+    credentials->thread = g_thread_new("vapix-credentials", refresh_thread, credentials);
+    return credentials;
+}
+
+void vapix_credentials_free(vapix_credentials_t* credentials) {
+    if (!credentials)
+        return;
+
+    g_mutex_lock(&credentials->mutex);
+    credentials->stopping = TRUE;
+    g_cond_signal(&credentials->cond);
+    g_mutex_unlock(&credentials->mutex);
+    g_thread_join(credentials->thread);
+
+    g_cond_clear(&credentials->cond);
+    g_mutex_clear(&credentials->mutex);
+    g_object_unref(credentials->connection);
+    g_free(credentials->credentials);
+    g_free(credentials->username);
+    g_free(credentials);
+}
+
+char* vapix_credentials_get(vapix_credentials_t* credentials, guint* generation) {
+    g_mutex_lock(&credentials->mutex);
+    // E.g. when the background refresh has failed for the whole lifetime
+    if (g_get_monotonic_time() - credentials->fetched_us >= LIFETIME_US) {
+        fetch_and_store(credentials);
+        g_cond_signal(&credentials->cond);
+    }
+    char* value = NULL;
+    if (*generation != credentials->generation) {
+        value       = g_strdup(credentials->credentials);
+        *generation = credentials->generation;
+    }
+    g_mutex_unlock(&credentials->mutex);
+    return value;
+}
+
+void vapix_credentials_refresh(vapix_credentials_t* credentials) {
+    g_mutex_lock(&credentials->mutex);
+    fetch_and_store(credentials);
+    g_cond_signal(&credentials->cond);
+    g_mutex_unlock(&credentials->mutex);
+}
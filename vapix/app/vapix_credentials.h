@@ -0,0 +1,78 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Cache of the VAPIX credentials of the application.
+ *
+ * The credentials are fetched over D-Bus once, instead of for every call, and
+ * kept in memory only. They are considered valid for
+ * VAPIX_CREDENTIALS_LIFETIME_S seconds, and a thread of the cache fetches new
+ * ones in the background before that, over the same D-Bus connection, so a
+ * call never waits for D-Bus unless the credentials are rejected.
+ *
+ * The credentials change when they are refreshed. Each new value gets a new
+ * generation, so a holder of e.g. a curl handle only has to set them again
+ * when the generation is not the one it has.
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+#include <glib.h>
+
+#define VAPIX_CREDENTIALS_LIFETIME_S 3600
+// Refreshed in the background when this much of the lifetime has passed
+#define VAPIX_CREDENTIALS_REFRESH_PERCENT 75
+// Time to wait before a failed background refresh is retried
+#define VAPIX_CREDENTIALS_RETRY_S 10
+
+typedef struct vapix_credentials {
+    char* username;
+    GDBusConnection* connection;
+
+    // Protects the fields below, which the refresh thread writes
+    GMutex mutex;
+    GCond cond;
+    char* credentials;
+    // Starts at 1, so 0 is never current
+    guint generation;
+    gint64 fetched_us;
+    gboolean stopping;
+
+    GThread* thread;
+} vapix_credentials_t;
+
+/**
+ * Fetch the credentials of a VAPIX service account, and start refreshing them
+ * in the background.
+ */
+vapix_credentials_t* vapix_credentials_new(const char* username);
+
+void vapix_credentials_free(vapix_credentials_t* credentials);
+
+/**
+ * Get the credentials as "id:password", fetched again first if they have
+ * expired, unless the caller already has them. generation is the one the
+ * caller has, 0 for none, and is updated to the one returned.
+ *
+ * Returns a copy, freed with g_free(), or NULL if generation is current.
+ */
+char* vapix_credentials_get(vapix_credentials_t* credentials, guint* generation);
+
+/**
+ * Fetch new credentials now, e.g. when VAPIX has rejected the cached ones.
+ */
+void vapix_credentials_refresh(vapix_credentials_t* credentials);
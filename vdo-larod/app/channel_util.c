@@ -95,7 +95,9 @@ bool channel_util_choose_stream_resolution(unsigned int channel_id,
         }
     }
 
-    // Check the requested width and height towards max resolution
+    // The stream is requested at exactly the model size in the model format when vdo supports
+    // it, so the preprocessing only converts and there are no candidate streams to weigh
+    // against each other. Check the requested width and height towards max resolution
     if (chosen_req->width > set->resolutions[1].width ||
         chosen_req->height > set->resolutions[1].height) {
         panic("%s: Requested width or height larger than max resolution %ux%u",
@@ -168,6 +170,33 @@ unsigned int channel_util_get_first_input_channel(void) {
     return vdo_map_get_uint32(info, "id", 1);
 }
 
+unsigned int channel_util_get_input_channels(unsigned int* channel_ids,
+                                            unsigned int max_channels) {
+    unsigned int num_channels = 0;
+
+    // The inputs are numbered from 1, and the first input without channel ends the list
+    for (unsigned int input = 1; num_channels < max_channels; input++) {
+        g_autoptr(VdoChannel) channel = NULL;
+        g_autoptr(GError) error       = NULL;
+        g_autoptr(VdoMap) ch_desc     = vdo_map_new();
+
+        vdo_map_set_uint32(ch_desc, "input", input);
+        channel = vdo_channel_get_ex(ch_desc, &error);
+        if (!channel) {
+            break;
+        }
+        g_autoptr(VdoMap) info = vdo_channel_get_info(channel, &error);
+        if (!info) {
+            panic("%s: Failed vdo_channel_get_info(): %s", __func__, error->message);
+        }
+        channel_ids[num_channels++] = vdo_map_get_uint32(info, "id", input);
+    }
+    if (num_channels == 0) {
+        panic("%s: No input channel found", __func__);
+    }
+    return num_channels;
+}
+
 VdoPair32u channel_util_get_aspect_ratio(unsigned int channel_id) {
     g_autoptr(VdoChannel) channel = NULL;
     g_autoptr(GError) error       = NULL;
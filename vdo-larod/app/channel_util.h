@@ -35,4 +35,15 @@ bool channel_util_choose_stream_resolution(unsigned int channel,
 
 unsigned int channel_util_get_image_rotation(unsigned int input_channel);
 unsigned int channel_util_get_first_input_channel(void);
+
+/**
+ * @brief Get the ids of the input channels, one for each image sensor.
+ *
+ * @param channel_ids  Set to the ids of the channels.
+ * @param max_channels Maximum number of channels to get.
+ *
+ * @return Number of channels found, at least one.
+ */
+unsigned int channel_util_get_input_channels(unsigned int* channel_ids,
+                                            unsigned int max_channels);
 VdoPair32u channel_util_get_aspect_ratio(unsigned int channel_id);
@@ -0,0 +1,326 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "frame_fanout.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "panic.h"
+#include "vdo-error.h"
+
+unsigned int frame_fanout_buffer_count(const unsigned int* queue_depths,
+                                       unsigned int num_consumers) {
+    // One buffer for vdo to fill, and per consumer the queued frames and the one it processes
+    unsigned int count = 1;
+    for (unsigned int i = 0; i < num_consumers; i++) {
+        count += queue_depths[i] + 1;
+    }
+    return count;
+}
+
+frame_fanout_t* frame_fanout_new(VdoStream* stream) {
+    frame_fanout_t* fanout = calloc(1, sizeof(frame_fanout_t));
+    if (!fanout) {
+        panic("%s: Could not allocate fanout", __func__);
+    }
+    if (pipe(fanout->wake_fds) != 0) {
+        syslog(LOG_ERR, "%s: Could not create wake up pipe: %s", __func__, strerror(errno));
+        free(fanout);
+        return NULL;
+    }
+    fanout->stream = stream;
+    pthread_mutex_init(&fanout->mutex, NULL);
+    return fanout;
+}
+
+frame_consumer_t* frame_fanout_add_consumer(frame_fanout_t* fanout,
+                                            const char* name,
+                                            unsigned int depth,
+                                            frame_drop_policy_t policy) {
+    if (fanout->num_consumers == FRAME_FANOUT_MAX_CONSUMERS || depth == 0) {
+        syslog(LOG_ERR, "%s: Could not add consumer %s", __func__, name);
+        return NULL;
+    }
+
+    frame_consumer_t* consumer = &fanout->consumers[fanout->num_consumers];
+    consumer->queue            = calloc(depth, sizeof(frame_ref_t*));
+    if (!consumer->queue) {
+        panic("%s: Could not allocate queue for %s", __func__, name);
+    }
+    consumer->name      = name;
+    consumer->depth     = depth;
+    consumer->policy    = policy;
+    consumer->fanout    = fanout;
+    consumer->notify_fd = -1;
+
+    // Wait with a monotonic timeout, so changes of the system time do not matter
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&consumer->cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    fanout->num_consumers++;
+    return consumer;
+}
+
+/**
+ * @brief Drop a reference to a frame with the mutex held.
+ */
+static void release_locked(frame_ref_t* frame) {
+    if (--frame->refcount > 0) {
+        return;
+    }
+
+    g_autoptr(GError) error = NULL;
+    // This will allow vdo to fill this buffer with data again
+    if (!vdo_stream_buffer_unref(frame->fanout->stream, &frame->buffer, &error)) {
+        if (!vdo_error_is_expected(&error)) {
+            panic("%s: Unexpected error: %s", __func__, error->message);
+        }
+    }
+    frame->buffer = NULL;
+}
+
+static frame_ref_t* get_free_frame(frame_fanout_t* fanout) {
+    for (size_t i = 0; i < FRAME_FANOUT_MAX_FRAMES; i++) {
+        if (fanout->frames[i].refcount == 0) {
+            return &fanout->frames[i];
+        }
+    }
+    panic("%s: More than %d frames in use, lower the buffer count of the stream",
+          __func__,
+          FRAME_FANOUT_MAX_FRAMES);
+}
+
+static void notify(frame_consumer_t* consumer) {
+    if (consumer->notify_fd < 0) {
+        return;
+    }
+    uint64_t value = 1;
+    // The counter of the eventfd only fails to be written if it would overflow
+    if (write(consumer->notify_fd, &value, sizeof(value)) < 0 && errno != EAGAIN) {
+        panic("%s: Could not notify consumer %s: %s", __func__, consumer->name, strerror(errno));
+    }
+}
+
+static void push_frame(frame_consumer_t* consumer, frame_ref_t* frame) {
+    if (consumer->count == consumer->depth) {
+        consumer->dropped_count++;
+        if (consumer->policy == FRAME_DROP_NEWEST) {
+            return;
+        }
+        release_locked(consumer->queue[consumer->head]);
+        consumer->head = (consumer->head + 1) % consumer->depth;
+        consumer->count--;
+    }
+
+    frame->refcount++;
+    consumer->queue[(consumer->head + consumer->count) % consumer->depth] = frame;
+    consumer->count++;
+    consumer->delivered_count++;
+    pthread_cond_signal(&consumer->cond);
+
+    notify(consumer);
+}
+
+static void* capture_thread(void* data) {
+    frame_fanout_t* fanout = data;
+    GError* error          = NULL;
+
+    int fd = vdo_stream_get_fd(fanout->stream, &error);
+    if (fd < 0) {
+        goto end;
+    }
+    struct pollfd fds[2] = {
+        {.fd = fd, .events = POLLIN},
+        {.fd = fanout->wake_fds[0], .events = POLLIN},
+    };
+
+    while (true) {
+        int status = poll(fds, 2, -1);
+        if (status < 0 && errno == EINTR) {
+            continue;
+        }
+        if (status < 0) {
+            panic("Failed to poll with status %d", status);
+        }
+        if (fds[1].revents) {
+            break;
+        }
+
+        pthread_mutex_lock(&fanout->mutex);
+        VdoBuffer* buffer = vdo_stream_get_buffer(fanout->stream, &error);
+        if (!buffer) {
+            pthread_mutex_unlock(&fanout->mutex);
+            if (g_error_matches(error, VDO_ERROR, VDO_ERROR_NO_DATA)) {
+                g_clear_error(&error);
+                continue;
+            }
+            break;
+        }
+
+        // The capture thread holds a reference while the frame is handed out
+        frame_ref_t* frame = get_free_frame(fanout);
+        frame->buffer      = buffer;
+        frame->refcount    = 1;
+        frame->fanout      = fanout;
+        for (unsigned int i = 0; i < fanout->num_consumers; i++) {
+            push_frame(&fanout->consumers[i], frame);
+        }
+        release_locked(frame);
+        pthread_mutex_unlock(&fanout->mutex);
+    }
+
+end:
+    pthread_mutex_lock(&fanout->mutex);
+    fanout->stopped = true;
+    fanout->error   = error;
+    for (unsigned int i = 0; i < fanout->num_consumers; i++) {
+        pthread_cond_broadcast(&fanout->consumers[i].cond);
+        notify(&fanout->consumers[i]);
+    }
+    pthread_mutex_unlock(&fanout->mutex);
+    return NULL;
+}
+
+bool frame_fanout_start(frame_fanout_t* fanout, GError** error) {
+    if (!vdo_stream_start(fanout->stream, error)) {
+        return false;
+    }
+    if (pthread_create(&fanout->thread, NULL, capture_thread, fanout) != 0) {
+        panic("%s: Could not create capture thread", __func__);
+    }
+    fanout->thread_started = true;
+    return true;
+}
+
+void frame_fanout_stop(frame_fanout_t* fanout) {
+    if (!fanout->thread_started) {
+        return;
+    }
+    const char wake = 1;
+    if (write(fanout->wake_fds[1], &wake, sizeof(wake)) < 0) {
+        panic("%s: Could not wake up capture thread: %s", __func__, strerror(errno));
+    }
+    pthread_join(fanout->thread, NULL);
+    fanout->thread_started = false;
+}
+
+bool frame_fanout_stopped(frame_fanout_t* fanout, GError** error) {
+    pthread_mutex_lock(&fanout->mutex);
+    bool stopped = fanout->stopped;
+    if (stopped && error) {
+        *error        = fanout->error;
+        fanout->error = NULL;
+    }
+    pthread_mutex_unlock(&fanout->mutex);
+    return stopped;
+}
+
+void frame_fanout_lock(frame_fanout_t* fanout) {
+    pthread_mutex_lock(&fanout->mutex);
+}
+
+void frame_fanout_unlock(frame_fanout_t* fanout) {
+    pthread_mutex_unlock(&fanout->mutex);
+}
+
+void frame_fanout_destroy(frame_fanout_t* fanout) {
+    if (!fanout) {
+        return;
+    }
+    frame_fanout_stop(fanout);
+
+    for (unsigned int i = 0; i < fanout->num_consumers; i++) {
+        frame_consumer_t* consumer = &fanout->consumers[i];
+        syslog(LOG_INFO,
+               "Consumer %s got %llu frames and dropped %llu",
+               consumer->name,
+               (unsigned long long)consumer->delivered_count,
+               (unsigned long long)consumer->dropped_count);
+        for (; consumer->count > 0; consumer->count--) {
+            release_locked(consumer->queue[consumer->head]);
+            consumer->head = (consumer->head + 1) % consumer->depth;
+        }
+        pthread_cond_destroy(&consumer->cond);
+        free(consumer->queue);
+    }
+    vdo_stream_stop(fanout->stream);
+
+    if (fanout->error) {
+        g_error_free(fanout->error);
+    }
+    close(fanout->wake_fds[0]);
+    close(fanout->wake_fds[1]);
+    pthread_mutex_destroy(&fanout->mutex);
+    free(fanout);
+}
+
+void frame_consumer_set_notify_fd(frame_consumer_t* consumer, int notify_fd) {
+    pthread_mutex_lock(&consumer->fanout->mutex);
+    consumer->notify_fd = notify_fd;
+    pthread_mutex_unlock(&consumer->fanout->mutex);
+}
+
+bool frame_consumer_ready(frame_consumer_t* consumer) {
+    pthread_mutex_lock(&consumer->fanout->mutex);
+    bool ready = consumer->count > 0 && !consumer->fanout->stopped;
+    pthread_mutex_unlock(&consumer->fanout->mutex);
+    return ready;
+}
+
+frame_ref_t* frame_consumer_wait(frame_consumer_t* consumer, unsigned int timeout_ms) {
+    frame_fanout_t* fanout = consumer->fanout;
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+
+    pthread_mutex_lock(&fanout->mutex);
+    while (consumer->count == 0 && !fanout->stopped) {
+        if (pthread_cond_timedwait(&consumer->cond, &fanout->mutex, &deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+
+    frame_ref_t* frame = NULL;
+    if (consumer->count > 0 && !fanout->stopped) {
+        frame          = consumer->queue[consumer->head];
+        consumer->head = (consumer->head + 1) % consumer->depth;
+        consumer->count--;
+    }
+    pthread_mutex_unlock(&fanout->mutex);
+    return frame;
+}
+
+void frame_ref_release(frame_ref_t* frame) {
+    frame_fanout_t* fanout = frame->fanout;
+    pthread_mutex_lock(&fanout->mutex);
+    release_locked(frame);
+    pthread_mutex_unlock(&fanout->mutex);
+}
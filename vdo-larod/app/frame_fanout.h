@@ -0,0 +1,185 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Distribution of the frames of one VdoStream to several consumers.
+ *
+ * A capture thread fetches the frames from the stream and hands each frame
+ * to all consumers, so capture and scaling are done once no matter how many
+ * analytics use the frames. Each frame is reference counted, and the
+ * VdoBuffer is returned to vdo when the last consumer has released it.
+ *
+ * Every consumer has a bounded queue and a policy for when it is full. A
+ * consumer that is slower than the stream does not hold back the others, it
+ * only misses frames.
+ *
+ * The stream needs one buffer for vdo to fill, and for each consumer its
+ * queue depth plus the frame it is processing, see frame_fanout_buffer_count().
+ */
+
+#pragma once
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "vdo-buffer.h"
+#include "vdo-stream.h"
+
+#define FRAME_FANOUT_MAX_CONSUMERS 4
+// Frames that can be shared at the same time, at least the buffer count of the stream
+#define FRAME_FANOUT_MAX_FRAMES 8
+
+typedef enum frame_drop_policy {
+    // Replace the oldest queued frame, for consumers that want the newest frame
+    FRAME_DROP_OLDEST = 0,
+    // Drop the new frame, for consumers that want a run of consecutive frames
+    FRAME_DROP_NEWEST,
+} frame_drop_policy_t;
+
+typedef struct frame_fanout frame_fanout_t;
+
+typedef struct frame_ref {
+    VdoBuffer* buffer;
+    // Protected by the mutex of the fanout
+    unsigned int refcount;
+    frame_fanout_t* fanout;
+} frame_ref_t;
+
+typedef struct frame_consumer {
+    const char* name;
+    frame_drop_policy_t policy;
+
+    // Ring of queued frames, protected by the mutex of the fanout
+    frame_ref_t** queue;
+    unsigned int depth;
+    unsigned int head;
+    unsigned int count;
+    pthread_cond_t cond;
+    // Written to when a frame is queued, -1 if not set
+    int notify_fd;
+
+    uint64_t delivered_count;
+    uint64_t dropped_count;
+    frame_fanout_t* fanout;
+} frame_consumer_t;
+
+struct frame_fanout {
+    VdoStream* stream;
+    pthread_mutex_t mutex;
+    pthread_t thread;
+    bool thread_started;
+    // Written to wake the capture thread up when the fanout is stopped
+    int wake_fds[2];
+    bool stopped;
+    // The error that stopped the capture, NULL if it was stopped by the application
+    GError* error;
+
+    frame_consumer_t consumers[FRAME_FANOUT_MAX_CONSUMERS];
+    unsigned int num_consumers;
+    frame_ref_t frames[FRAME_FANOUT_MAX_FRAMES];
+};
+
+/**
+ * @brief Number of vdo buffers needed for the consumers that are added.
+ *
+ * @param queue_depths  Queue depth of each consumer.
+ * @param num_consumers Number of consumers.
+ */
+unsigned int frame_fanout_buffer_count(const unsigned int* queue_depths,
+                                       unsigned int num_consumers);
+
+/**
+ * @brief Create a fanout for a stream that is not started.
+ *
+ * The stream is started by frame_fanout_start() and must outlive the fanout.
+ *
+ * @return The new fanout, or NULL if the wake up pipe could not be created.
+ */
+frame_fanout_t* frame_fanout_new(VdoStream* stream);
+
+/**
+ * @brief Add a consumer, before the fanout is started.
+ *
+ * @param name   Name of the consumer, used in the log.
+ * @param depth  Number of frames that can be waiting in the queue of the consumer.
+ * @param policy What to do with a new frame when the queue is full.
+ *
+ * @return The consumer, owned by the fanout, or NULL if there are too many consumers.
+ */
+frame_consumer_t* frame_fanout_add_consumer(frame_fanout_t* fanout,
+                                            const char* name,
+                                            unsigned int depth,
+                                            frame_drop_policy_t policy);
+
+/**
+ * @brief Start the stream and the capture thread.
+ */
+bool frame_fanout_start(frame_fanout_t* fanout, GError** error);
+
+/**
+ * @brief Stop the capture thread and wake up all waiting consumers.
+ */
+void frame_fanout_stop(frame_fanout_t* fanout);
+
+/**
+ * @brief Check if the capture has stopped, by the application or by an error.
+ *
+ * @param error Set to the error that stopped the capture, if any. The error
+ *              is owned by the caller.
+ */
+bool frame_fanout_stopped(frame_fanout_t* fanout, GError** error);
+
+/**
+ * @brief Lock the fanout, to call other functions on the stream while the capture runs.
+ */
+void frame_fanout_lock(frame_fanout_t* fanout);
+void frame_fanout_unlock(frame_fanout_t* fanout);
+
+/**
+ * @brief Stop the fanout and free it.
+ *
+ * All frames held by consumers must have been released.
+ */
+void frame_fanout_destroy(frame_fanout_t* fanout);
+
+/**
+ * @brief Set an eventfd that is written to every time a frame is queued for the consumer.
+ *
+ * This makes it possible to wait for the frames of several consumers at once
+ * with poll(), and then get them with frame_consumer_wait() without timeout.
+ */
+void frame_consumer_set_notify_fd(frame_consumer_t* consumer, int notify_fd);
+
+/**
+ * @brief Check if a frame is queued for the consumer.
+ */
+bool frame_consumer_ready(frame_consumer_t* consumer);
+
+/**
+ * @brief Wait for the next frame of a consumer.
+ *
+ * @param timeout_ms Longest time to wait.
+ *
+ * @return The frame, to be released with frame_ref_release(), or NULL on
+ *         timeout or when the fanout has stopped.
+ */
+frame_ref_t* frame_consumer_wait(frame_consumer_t* consumer, unsigned int timeout_ms);
+
+/**
+ * @brief Release a frame, the buffer is returned to vdo when all consumers have released it.
+ */
+void frame_ref_release(frame_ref_t* frame);
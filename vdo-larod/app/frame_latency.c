@@ -0,0 +1,121 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "frame_latency.h"
+
+#include <string.h>
+#include <syslog.h>
+
+#include "vdo-frame.h"
+
+void frame_latency_init(frame_latency_t* latency,
+                        const frame_latency_params_t* params,
+                        unsigned int channel_id) {
+    memset(latency, 0, sizeof(*latency));
+    latency->params      = *params;
+    latency->channel_id  = channel_id;
+    latency->next_log_us = g_get_monotonic_time() + (gint64)params->log_interval_s * G_USEC_PER_SEC;
+}
+
+uint64_t frame_latency_timestamp(VdoBuffer* vdo_buf) {
+    return vdo_frame_get_timestamp(vdo_buffer_get_frame(vdo_buf));
+}
+
+/**
+ * @brief Time since the capture, 0 if the timestamp is in the future.
+ */
+static uint64_t age_us(uint64_t timestamp_us) {
+    uint64_t now_us = (uint64_t)g_get_monotonic_time();
+    return now_us > timestamp_us ? now_us - timestamp_us : 0;
+}
+
+bool frame_latency_check_age(frame_latency_t* latency, uint64_t timestamp_us) {
+    if (latency->params.max_queue_age_ms == 0 ||
+        age_us(timestamp_us) <= (uint64_t)latency->params.max_queue_age_ms * 1000) {
+        return true;
+    }
+    latency->stale_dropped++;
+    return false;
+}
+
+uint64_t frame_latency_record(frame_latency_t* latency, uint64_t timestamp_us) {
+    uint64_t latency_us = age_us(timestamp_us);
+
+    uint64_t ms = latency_us / 1000;
+    int bucket  = 0;
+    while (ms > 0 && bucket < FRAME_LATENCY_NUM_BUCKETS - 1) {
+        ms >>= 1;
+        bucket++;
+    }
+    latency->buckets[bucket]++;
+    latency->count++;
+    latency->sum_us += latency_us;
+    latency->max_us = MAX(latency->max_us, latency_us);
+    if (latency_us > (uint64_t)latency->params.budget_ms * 1000) {
+        latency->over_budget++;
+    }
+    return latency_us;
+}
+
+/**
+ * @brief Upper bound in ms of the bucket that holds a share of the latencies.
+ */
+static unsigned int percentile_ms(const frame_latency_t* latency, double share) {
+    uint64_t rank = (uint64_t)((double)latency->count * share + 0.5);
+    uint64_t seen = 0;
+    for (int i = 0; i < FRAME_LATENCY_NUM_BUCKETS - 1; i++) {
+        seen += latency->buckets[i];
+        if (seen >= rank) {
+            return 1u << i;
+        }
+    }
+    return (unsigned int)(latency->max_us / 1000);
+}
+
+void frame_latency_log_periodic(frame_latency_t* latency) {
+    if (latency->params.log_interval_s == 0) {
+        return;
+    }
+    gint64 now_us = g_get_monotonic_time();
+    if (now_us < latency->next_log_us) {
+        return;
+    }
+    latency->next_log_us = now_us + (gint64)latency->params.log_interval_s * G_USEC_PER_SEC;
+    frame_latency_log(latency);
+}
+
+void frame_latency_log(const frame_latency_t* latency) {
+    if (latency->count == 0) {
+        syslog(LOG_INFO,
+               "[Channel %u] Latency: no results delivered, %llu stale frames dropped",
+               latency->channel_id,
+               (unsigned long long)latency->stale_dropped);
+        return;
+    }
+    syslog(LOG_INFO,
+           "[Channel %u] Latency of %llu results: mean %llu us, p50 < %u ms, p99 < %u ms, "
+           "max %llu us, %llu over the %u ms budget (%.2f%%), %llu stale frames dropped",
+           latency->channel_id,
+           (unsigned long long)latency->count,
+           (unsigned long long)(latency->sum_us / latency->count),
+           percentile_ms(latency, 0.5),
+           percentile_ms(latency, 0.99),
+           (unsigned long long)latency->max_us,
+           (unsigned long long)latency->over_budget,
+           latency->params.budget_ms,
+           100.0 * (double)latency->over_budget / (double)latency->count,
+           (unsigned long long)latency->stale_dropped);
+}
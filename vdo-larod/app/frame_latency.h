@@ -0,0 +1,104 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * End-to-end latency of the results of a channel, from capture to delivery.
+ *
+ * The timestamp of a vdo frame is the capture time in microseconds on the
+ * monotonic clock, the same clock as g_get_monotonic_time(). The latency of
+ * a result is the time from the capture of its frame until the result is
+ * delivered, and is compared with a latency budget.
+ *
+ * A frame that has waited in the queues for longer than the budget before
+ * the inference starts cannot give a result in time, so it is dropped and
+ * counted instead of occupying the DLPU.
+ *
+ * The latencies are kept in buckets that are powers of two in milliseconds,
+ * and the counters are written to the log at a regular interval.
+ */
+
+#pragma once
+
+#include <glib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "vdo-buffer.h"
+
+#define FRAME_LATENCY_NUM_BUCKETS 12
+
+typedef struct frame_latency_params {
+    // Highest latency from capture to delivery of a result
+    unsigned int budget_ms;
+    // Highest age of a frame when the inference starts, 0 to never drop frames
+    unsigned int max_queue_age_ms;
+    // Interval between the logged metrics, 0 to only log them at exit
+    unsigned int log_interval_s;
+} frame_latency_params_t;
+
+typedef struct frame_latency {
+    frame_latency_params_t params;
+    unsigned int channel_id;
+
+    // Bucket 0 counts latencies below 1 ms, bucket i from 2^(i-1) up to 2^i ms
+    uint64_t buckets[FRAME_LATENCY_NUM_BUCKETS];
+    uint64_t count;
+    uint64_t sum_us;
+    uint64_t max_us;
+    uint64_t over_budget;
+    uint64_t stale_dropped;
+
+    gint64 next_log_us;
+} frame_latency_t;
+
+/**
+ * @brief Set up the latency accounting of a channel.
+ */
+void frame_latency_init(frame_latency_t* latency,
+                        const frame_latency_params_t* params,
+                        unsigned int channel_id);
+
+/**
+ * @brief Capture timestamp of a frame in microseconds on the monotonic clock.
+ */
+uint64_t frame_latency_timestamp(VdoBuffer* vdo_buf);
+
+/**
+ * @brief Check the age of a frame before the inference starts.
+ *
+ * @return False if the frame is older than the highest queue age, then it
+ *         is counted as dropped and should not be run.
+ */
+bool frame_latency_check_age(frame_latency_t* latency, uint64_t timestamp_us);
+
+/**
+ * @brief Add the latency of a result that is delivered now.
+ *
+ * @param timestamp_us Capture timestamp of the frame of the result.
+ *
+ * @return The latency in microseconds.
+ */
+uint64_t frame_latency_record(frame_latency_t* latency, uint64_t timestamp_us);
+
+/**
+ * @brief Write the metrics to the log if the log interval has passed.
+ */
+void frame_latency_log_periodic(frame_latency_t* latency);
+
+/**
+ * @brief Write the metrics to the log.
+ */
+void frame_latency_log(const frame_latency_t* latency);
@@ -0,0 +1,90 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * This file handles the adaptive framerate calculation of the application.
+ */
+
+#include "framerate_controller.h"
+
+#include <math.h>
+
+void framerate_controller_default_params(double max_framerate,
+                                         framerate_controller_params_t* params) {
+    params->min_framerate  = 1.0;
+    params->max_framerate  = max_framerate;
+    params->smoothing      = 0.2;
+    params->latency_budget = 1.0;
+    params->hysteresis     = 0.15;
+    params->hold_frames    = 10;
+}
+
+void framerate_controller_init(framerate_controller_t* controller,
+                               const framerate_controller_params_t* params,
+                               double framerate) {
+    controller->params              = *params;
+    controller->framerate           = framerate;
+    controller->mean_analysis_time  = 0.0;
+    controller->has_analysis_time   = false;
+    controller->frames_since_change = 0;
+}
+
+static double clamp_framerate(const framerate_controller_params_t* params, double framerate) {
+    if (framerate > params->max_framerate) {
+        return params->max_framerate;
+    }
+    if (framerate < params->min_framerate) {
+        return params->min_framerate;
+    }
+    return framerate;
+}
+
+bool framerate_controller_update(framerate_controller_t* controller, double analysis_time) {
+    const framerate_controller_params_t* params = &controller->params;
+
+    if (controller->has_analysis_time) {
+        controller->mean_analysis_time +=
+            params->smoothing * (analysis_time - controller->mean_analysis_time);
+    } else {
+        controller->mean_analysis_time = analysis_time;
+        controller->has_analysis_time  = true;
+    }
+
+    controller->frames_since_change++;
+    if (controller->frames_since_change < params->hold_frames) {
+        return false;
+    }
+
+    // The highest framerate where the analysis fits within the budget of each frame
+    double wanted = params->max_framerate;
+    if (controller->mean_analysis_time > 0.0) {
+        wanted = params->latency_budget * 1000.0 / controller->mean_analysis_time;
+    }
+    wanted = clamp_framerate(params, wanted);
+
+    // Ignore small changes, but always allow reaching the limits so the stream does not get
+    // stuck just below the requested framerate
+    double ratio     = wanted / controller->framerate;
+    bool at_limit    = wanted >= params->max_framerate || wanted <= params->min_framerate;
+    bool significant = ratio > 1.0 + params->hysteresis || ratio < 1.0 / (1.0 + params->hysteresis);
+    if (!significant && !(at_limit && fabs(wanted - controller->framerate) > 0.01)) {
+        return false;
+    }
+
+    controller->framerate           = wanted;
+    controller->frames_since_change = 0;
+    return true;
+}
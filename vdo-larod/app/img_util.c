@@ -33,90 +33,26 @@
 #include "vdo-stream.h"
 #include <vdo-error.h>
 
-#define IMG_PROVIDER_ANALYSIS_MAX (10)
-
-/**
- * @brief Calculate a new img provider framerate based on inference time
- *
- * @param img_framerate   Struct for the framerate calculations
- * @param analysis_time   Time in ms for the analysis
- *
- */
-static void calculate_new_framerate(img_framerate_t* img_framerate, unsigned int analysis_time) {
-    if (analysis_time > 201) {
-        img_framerate->framerate = 1.0;
-        img_framerate->frametime = 1001;
-        return;
-    }
-    if (analysis_time < 34) {
-        img_framerate->framerate = 30.0;
-        img_framerate->frametime = 34;
-    } else if (analysis_time < 41) {
-        img_framerate->framerate = 25.0;
-        img_framerate->frametime = 41;
-    } else if (analysis_time < 51) {
-        img_framerate->framerate = 20.0;
-        img_framerate->frametime = 51;
-    } else if (analysis_time < 67) {
-        img_framerate->framerate = 15.0;
-        img_framerate->frametime = 67;
-    } else if (analysis_time < 101) {
-        img_framerate->framerate = 10.0;
-        img_framerate->frametime = 101;
-    } else if (analysis_time < 201) {
-        img_framerate->framerate = 5.0;
-        img_framerate->frametime = 201;
-    }
-    if (img_framerate->framerate > img_framerate->wanted_framerate) {
-        img_framerate->framerate = img_framerate->wanted_framerate;
-    }
-}
-
-static bool
-update_framerate(VdoStream* stream, img_framerate_t* img_framerate, unsigned analysis_time) {
-    g_autoptr(GError) error    = NULL;
-    unsigned int old_frametime = img_framerate->frametime;
-
-    calculate_new_framerate(img_framerate, analysis_time);
-    if (old_frametime != img_framerate->frametime) {
-        if (!vdo_stream_set_framerate(stream, img_framerate->framerate, &error)) {
-            panic("%s: Failed to change framerate: %s", __func__, error->message);
-        }
-        syslog(LOG_INFO,
-               "Change VDO stream framerate to %f because of the mean analysis time %u ms",
-               img_framerate->framerate,
-               analysis_time);
-        return true;
-    }
-    return false;
-}
-
 bool img_util_update_framerate(VdoStream* stream,
-                               img_framerate_t* img_framerate,
+                               framerate_controller_t* controller,
                                unsigned analysis_time) {
-    bool ret = false;
+    g_autoptr(GError) error = NULL;
     assert(stream);
 
-    img_framerate->analysis_frame_count++;
-    img_framerate->tot_analysis_time += analysis_time;
-    if (img_framerate->analysis_frame_count == IMG_PROVIDER_ANALYSIS_MAX) {
-        img_framerate->mean_analysis_time =
-            img_framerate->tot_analysis_time / img_framerate->analysis_frame_count;
-
-        // If the analysis time is higher or lower than the time between frames from
-        // vdo change the framerate so the latest frame will be fetched from vdo
-        if (img_framerate->frametime < img_framerate->mean_analysis_time &&
-            img_framerate->frametime < 201) {
-            ret = update_framerate(stream, img_framerate, img_framerate->mean_analysis_time);
-        } else if (img_framerate->frametime > img_framerate->mean_analysis_time) {
-            ret = update_framerate(stream, img_framerate, img_framerate->mean_analysis_time);
-        }
-        img_framerate->mean_analysis_time   = 0;
-        img_framerate->analysis_frame_count = 0;
-        img_framerate->tot_analysis_time    = 0;
+    double old_framerate = controller->framerate;
+    if (!framerate_controller_update(controller, analysis_time)) {
+        return false;
+    }
+    if (!vdo_stream_set_framerate(stream, controller->framerate, &error)) {
+        panic("%s: Failed to change framerate: %s", __func__, error->message);
     }
+    syslog(LOG_INFO,
+           "Change VDO stream framerate to %f because of the mean analysis time %.1f ms",
+           controller->framerate,
+           controller->mean_analysis_time);
 
-    return ret;
+    // Only a lower framerate leaves old frames in vdo
+    return controller->framerate < old_framerate;
 }
 
 bool img_util_flush(VdoStream* stream, VdoBuffer** buf, GError** error) {
@@ -23,6 +23,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "framerate_controller.h"
 #include "vdo-error.h"
 #include "vdo-stream.h"
 #include "vdo-types.h"
@@ -46,27 +47,18 @@ typedef struct img_info {
     bool dmabuf;
 } img_info_t;
 
-typedef struct img_framerate {
-    unsigned int frametime;
-    unsigned int mean_analysis_time;
-    unsigned int analysis_frame_count;
-    unsigned int tot_analysis_time;
-    double wanted_framerate;
-    double framerate;
-} img_framerate_t;
-
 /**
  * @brief Update framerate for a VdoStream
  *
  * @param stream         The VdoStream to change framerate for
- * @param img_framerate  A struct containing all needed for framerate calculation
+ * @param controller     The controller keeping track of the analysis time
  * @param analysis_time  The analysis time to be used for
  * framerate calculation
  *
- * @return true if framerate was set otherwise false
+ * @return true if the framerate was lowered and the buffered frames should be flushed
  */
 bool img_util_update_framerate(VdoStream* stream,
-                               img_framerate_t* img_framerate,
+                               framerate_controller_t* controller,
                                unsigned int analysis_time);
 
 /**
@@ -0,0 +1,238 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "inference_scheduler.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <syslog.h>
+#include <unistd.h>
+
+#include "img_util.h"
+#include "panic.h"
+
+inference_scheduler_t* inference_scheduler_new(void) {
+    inference_scheduler_t* scheduler = calloc(1, sizeof(inference_scheduler_t));
+    if (!scheduler) {
+        panic("%s: Could not allocate scheduler", __func__);
+    }
+    scheduler->notify_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (scheduler->notify_fd < 0) {
+        syslog(LOG_ERR, "%s: Could not create eventfd: %s", __func__, strerror(errno));
+        free(scheduler);
+        return NULL;
+    }
+    return scheduler;
+}
+
+scheduler_channel_t* inference_scheduler_add_channel(inference_scheduler_t* scheduler,
+                                                     unsigned int channel_id,
+                                                     VdoStream* stream,
+                                                     model_provider_t* provider,
+                                                     double weight,
+                                                     double target_framerate) {
+    if (scheduler->num_channels == SCHEDULER_MAX_CHANNELS || weight <= 0.0 ||
+        target_framerate <= 0.0) {
+        syslog(LOG_ERR, "%s: Could not add channel %u", __func__, channel_id);
+        return NULL;
+    }
+
+    scheduler_channel_t* channel = &scheduler->channels[scheduler->num_channels];
+    channel->fanout              = frame_fanout_new(stream);
+    if (!channel->fanout) {
+        return NULL;
+    }
+    // Inference only wants the newest frame of each channel
+    channel->consumer =
+        frame_fanout_add_consumer(channel->fanout, "inference", 1, FRAME_DROP_OLDEST);
+    if (!channel->consumer) {
+        frame_fanout_destroy(channel->fanout);
+        return NULL;
+    }
+    frame_consumer_set_notify_fd(channel->consumer, scheduler->notify_fd);
+
+    channel->channel_id = channel_id;
+    channel->stream     = stream;
+    channel->provider   = provider;
+    channel->weight     = weight;
+    channel->period_us  = (gint64)(1000000.0 / target_framerate);
+
+    framerate_controller_params_t framerate_params;
+    framerate_controller_default_params(target_framerate, &framerate_params);
+    framerate_controller_init(&channel->controller, &framerate_params, target_framerate);
+
+    scheduler->num_channels++;
+    return channel;
+}
+
+bool inference_scheduler_start(inference_scheduler_t* scheduler, GError** error) {
+    for (unsigned int i = 0; i < scheduler->num_channels; i++) {
+        if (!frame_fanout_start(scheduler->channels[i].fanout, error)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Find the due channel with a frame and the lowest virtual start time.
+ *
+ * @param wake_us Lowered to the time when a channel with a frame becomes due.
+ */
+static scheduler_channel_t*
+find_next_channel(inference_scheduler_t* scheduler, gint64 now, gint64* wake_us, GError** error) {
+    scheduler_channel_t* next = NULL;
+    double next_start         = 0.0;
+
+    for (unsigned int i = 0; i < scheduler->num_channels; i++) {
+        scheduler_channel_t* channel = &scheduler->channels[i];
+        if (frame_fanout_stopped(channel->fanout, error)) {
+            return NULL;
+        }
+        if (!frame_consumer_ready(channel->consumer)) {
+            continue;
+        }
+        if (now < channel->next_due_us) {
+            *wake_us = MIN(*wake_us, channel->next_due_us);
+            continue;
+        }
+        // An idle channel starts at the current virtual time instead of catching up
+        double start = MAX(channel->finish_time, scheduler->virtual_time);
+        if (!next || start < next_start) {
+            next       = channel;
+            next_start = start;
+        }
+    }
+    if (next) {
+        next->start_time = next_start;
+    }
+    return next;
+}
+
+scheduler_channel_t* inference_scheduler_next(inference_scheduler_t* scheduler,
+                                              unsigned int timeout_ms,
+                                              frame_ref_t** frame,
+                                              GError** error) {
+    gint64 deadline_us = g_get_monotonic_time() + (gint64)timeout_ms * 1000;
+
+    struct pollfd fds = {
+        .fd     = scheduler->notify_fd,
+        .events = POLLIN,
+    };
+
+    while (true) {
+        gint64 now                   = g_get_monotonic_time();
+        gint64 wake_us               = deadline_us;
+        scheduler_channel_t* channel = find_next_channel(scheduler, now, &wake_us, error);
+        if (error && *error) {
+            return NULL;
+        }
+        if (channel) {
+            *frame = frame_consumer_wait(channel->consumer, 0);
+            if (*frame) {
+                scheduler->virtual_time = channel->start_time;
+                channel->next_due_us    = now + channel->period_us;
+                return channel;
+            }
+            continue;
+        }
+        if (now >= deadline_us) {
+            return NULL;
+        }
+
+        // Sleep until a frame is queued or a channel with a frame becomes due
+        int status = poll(&fds, 1, (int)((wake_us - now + 999) / 1000));
+        if (status < 0 && errno != EINTR) {
+            panic("%s: Failed to poll with status %d", __func__, status);
+        }
+        if (status > 0) {
+            uint64_t count;
+            if (read(scheduler->notify_fd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+                panic("%s: Could not read eventfd: %s", __func__, strerror(errno));
+            }
+        }
+    }
+}
+
+unsigned int inference_scheduler_next_batch(inference_scheduler_t* scheduler,
+                                            unsigned int timeout_ms,
+                                            unsigned int max_channels,
+                                            scheduler_channel_t** channels,
+                                            frame_ref_t** frames,
+                                            GError** error) {
+    channels[0] = inference_scheduler_next(scheduler, timeout_ms, &frames[0], error);
+    if (!channels[0]) {
+        return 0;
+    }
+    unsigned int num_channels = 1;
+    gint64 now                = g_get_monotonic_time();
+
+    // Running more frames in the same job costs little, so every due channel
+    // with a frame is added without waiting
+    for (unsigned int i = 0; i < scheduler->num_channels && num_channels < max_channels; i++) {
+        scheduler_channel_t* channel = &scheduler->channels[i];
+        if (channel == channels[0] || now < channel->next_due_us) {
+            continue;
+        }
+        frame_ref_t* frame = frame_consumer_wait(channel->consumer, 0);
+        if (!frame) {
+            continue;
+        }
+        channel->start_time    = MAX(channel->finish_time, scheduler->virtual_time);
+        channel->next_due_us   = now + channel->period_us;
+        channels[num_channels] = channel;
+        frames[num_channels]   = frame;
+        num_channels++;
+    }
+    return num_channels;
+}
+
+void inference_scheduler_done(inference_scheduler_t* scheduler,
+                              scheduler_channel_t* channel,
+                              frame_ref_t* frame,
+                              unsigned int inference_ms) {
+    (void)scheduler;
+
+    channel->finish_time = channel->start_time + inference_ms / channel->weight;
+    channel->num_jobs++;
+
+    if (inference_ms > 0) {
+        // The stream is also used by the capture thread of the fanout
+        frame_fanout_lock(channel->fanout);
+        img_util_update_framerate(channel->stream, &channel->controller, inference_ms);
+        frame_fanout_unlock(channel->fanout);
+    }
+    frame_ref_release(frame);
+}
+
+void inference_scheduler_destroy(inference_scheduler_t* scheduler) {
+    if (!scheduler) {
+        return;
+    }
+    for (unsigned int i = 0; i < scheduler->num_channels; i++) {
+        scheduler_channel_t* channel = &scheduler->channels[i];
+        syslog(LOG_INFO,
+               "[Channel %u] Ran %llu inference jobs",
+               channel->channel_id,
+               (unsigned long long)channel->num_jobs);
+        frame_fanout_destroy(channel->fanout);
+    }
+    close(scheduler->notify_fd);
+    free(scheduler);
+}
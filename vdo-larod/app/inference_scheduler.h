@@ -0,0 +1,152 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Scheduling of inference jobs from several channels on one larod connection.
+ *
+ * Each channel has its own stream, with a frame fanout that keeps the newest
+ * frame, and its own model provider sharing the loaded model. The scheduler
+ * picks the next channel to run inference on:
+ *
+ * - A channel is due when the time since its last job is at least one period
+ *   of its target framerate, and it has a frame.
+ * - Among the due channels, time is shared with start-time fair queuing: each
+ *   job advances the virtual time of its channel by the inference time divided
+ *   by the weight of the channel, and the channel with the lowest virtual time
+ *   runs next. A channel with twice the weight gets twice the inference time
+ *   when the channels compete. A channel that has been idle continues from the
+ *   current virtual time, so it does not get a burst of jobs.
+ *
+ * The framerate of each stream is also adapted to its inference time, which
+ * is capped at the target framerate.
+ */
+
+#pragma once
+
+#include <glib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "frame_fanout.h"
+#include "framerate_controller.h"
+#include "model.h"
+
+#define SCHEDULER_MAX_CHANNELS 4
+
+typedef struct scheduler_channel {
+    unsigned int channel_id;
+    VdoStream* stream;
+    frame_fanout_t* fanout;
+    frame_consumer_t* consumer;
+    model_provider_t* provider;
+    framerate_controller_t controller;
+
+    double weight;
+    gint64 period_us;
+    gint64 next_due_us;
+    // Virtual time when the last job of the channel finished, and when the running job started
+    double finish_time;
+    double start_time;
+
+    uint64_t num_jobs;
+} scheduler_channel_t;
+
+typedef struct inference_scheduler {
+    scheduler_channel_t channels[SCHEDULER_MAX_CHANNELS];
+    unsigned int num_channels;
+    // Start time of the last scheduled job
+    double virtual_time;
+    // Written to by the fanouts of all channels when a frame is queued
+    int notify_fd;
+} inference_scheduler_t;
+
+/**
+ * @brief Create a scheduler.
+ *
+ * @return The scheduler, or NULL if its eventfd could not be created.
+ */
+inference_scheduler_t* inference_scheduler_new(void);
+
+/**
+ * @brief Add a channel with a stream that is not started.
+ *
+ * The stream and the provider must outlive the scheduler.
+ *
+ * @param weight           Share of the inference time when channels compete.
+ * @param target_framerate Highest framerate to run inference at.
+ *
+ * @return The channel, or NULL if there are too many channels.
+ */
+scheduler_channel_t* inference_scheduler_add_channel(inference_scheduler_t* scheduler,
+                                                     unsigned int channel_id,
+                                                     VdoStream* stream,
+                                                     model_provider_t* provider,
+                                                     double weight,
+                                                     double target_framerate);
+
+/**
+ * @brief Start the streams of all channels.
+ */
+bool inference_scheduler_start(inference_scheduler_t* scheduler, GError** error);
+
+/**
+ * @brief Wait for the next channel to run inference on.
+ *
+ * @param timeout_ms Longest time to wait.
+ * @param frame      Set to the frame to run inference on.
+ * @param error      Set if the stream of a channel stopped because of an error.
+ *
+ * @return The channel, or NULL on timeout or error.
+ */
+scheduler_channel_t* inference_scheduler_next(inference_scheduler_t* scheduler,
+                                              unsigned int timeout_ms,
+                                              frame_ref_t** frame,
+                                              GError** error);
+
+/**
+ * @brief Wait for the next channels to run one batched inference job on.
+ *
+ * The first channel is the one inference_scheduler_next() picks, then the
+ * frames of the other due channels are added to the batch.
+ *
+ * @param max_channels Largest number of channels in the batch, the batch size of the model.
+ * @param channels     Set to the channels of the batch.
+ * @param frames       Set to the frame of each channel.
+ *
+ * @return Number of channels in the batch, 0 on timeout or error.
+ */
+unsigned int inference_scheduler_next_batch(inference_scheduler_t* scheduler,
+                                            unsigned int timeout_ms,
+                                            unsigned int max_channels,
+                                            scheduler_channel_t** channels,
+                                            frame_ref_t** frames,
+                                            GError** error);
+
+/**
+ * @brief Tell the scheduler that the job of a channel is done, and release its frame.
+ *
+ * @param inference_ms Time of the job in ms, 0 if it failed or was skipped. For a batched
+ *                     job, every channel of the batch is charged the whole time.
+ */
+void inference_scheduler_done(inference_scheduler_t* scheduler,
+                              scheduler_channel_t* channel,
+                              frame_ref_t* frame,
+                              unsigned int inference_ms);
+
+/**
+ * @brief Stop the streams and free the scheduler.
+ */
+void inference_scheduler_destroy(inference_scheduler_t* scheduler);
@@ -18,7 +18,9 @@
 #include "model_preprocessing.h"
 
 #include "larod.h"
+#include "model_cache.h"
 #include "panic.h"
+#include "power_backoff.h"
 
 #include <errno.h>
 #include <fcntl.h>
@@ -30,6 +32,10 @@
 #include <unistd.h>
 
 #define MAX_NBR_POWER_RETRIES 50
+#define MODEL_CACHE_APP_NAME "vdo_larod"
+
+// All providers share the device, so they also share the power state
+static power_backoff_t power_backoff;
 
 bool model_get_tensor_output_info(model_provider_t* provider,
                                   unsigned int tensor_output_index,
@@ -41,29 +47,15 @@ bool model_get_tensor_output_info(model_provider_t* provider,
     return true;
 }
 
-static void model_job_handle_no_power(int* nbr_of_retries) {
-    // Currently this will only happen when there is no power
-    //  Just a number but if no power available after 50 retries it is time to give up
-    if (*nbr_of_retries == MAX_NBR_POWER_RETRIES) {
-        panic("%s: Still no power available when running larod job %u, giving up",
-              __func__,
-              *nbr_of_retries);
-    }
-    syslog(LOG_INFO, "No power available when running larod job, try nbr %u", *nbr_of_retries);
-    *nbr_of_retries = *nbr_of_retries + 1;
-    usleep(250 * 1000 * *nbr_of_retries);
-}
-
 static int setup_tracked_tensors(model_provider_t* provider, VdoBuffer* vdo_buf) {
-    larodError* error    = NULL;
-    static int tensor_id = 0;
-    int tracked_id       = -1;
+    larodError* error = NULL;
+    int tracked_id    = -1;
 
     int64_t vdo_buf_offset = vdo_buffer_get_offset(vdo_buf);
     int vdo_buf_fd         = vdo_buffer_get_fd(vdo_buf);
     int buf_fd             = vdo_buf_fd;
 
-    tracked_id                   = tensor_id;
+    tracked_id                   = provider->num_tracked_tensors;
     larodTensor** tracked_tensor = provider->img_input_tensors[tracked_id];
 
     if (!provider->img_info->dmabuf) {
@@ -93,14 +85,15 @@ static int setup_tracked_tensors(model_provider_t* provider, VdoBuffer* vdo_buf)
     provider->img_input_tensors[tracked_id]   = tracked_tensor;
     provider->img_duped_fds[tracked_id]       = duped_fd;
     provider->img_tracked_tensors[tracked_id] = vdo_buf_fd;
-    tensor_id++;
+    provider->num_tracked_tensors++;
     return tracked_id;
 }
 
-bool model_run_inference(model_provider_t* provider, VdoBuffer* vdo_buf) {
-    larodError* error            = NULL;
-    static int nbr_power_retries = 0;
-    int tracked_id               = -1;
+/**
+ * @brief Get the input tensors of a vdo buffer, tracking the buffer the first time it is used.
+ */
+static larodTensor** get_input_tensors(model_provider_t* provider, VdoBuffer* vdo_buf) {
+    int tracked_id = -1;
 
     int vdo_buf_fd = vdo_buffer_get_fd(vdo_buf);
     if (vdo_buf_fd < 0) {
@@ -115,57 +108,82 @@ bool model_run_inference(model_provider_t* provider, VdoBuffer* vdo_buf) {
     if (tracked_id == -1) {
         tracked_id = setup_tracked_tensors(provider, vdo_buf);
     }
+    return provider->img_input_tensors[tracked_id];
+}
+
+/**
+ * @brief Run a job, starting a backoff period if there is no power.
+ *
+ * @return False if there was no power, the job should then be skipped.
+ */
+static bool run_job(model_provider_t* provider, larodJobRequest* req, const char* job_name) {
+    larodError* error = NULL;
 
-    larodTensor** input_tensors  = provider->img_input_tensors[tracked_id];
-    larodJobRequest* input_req   = provider->inf_req;
-    larodModel* input_model      = provider->model;
-    larodTensor** output_tensors = provider->output_tensors;
-    size_t num_outputs           = provider->num_outputs;
+    if (!larodRunJob(provider->conn, req, &error)) {
+        if (error->code != LAROD_ERROR_POWER_NOT_AVAILABLE) {
+            panic("%s: Unable to run %s job: %s (%d)", __func__, job_name, error->msg, error->code);
+        }
+        larodClearError(&error);
+        power_backoff_failed(&power_backoff);
+        return false;
+    }
+    power_backoff_succeeded(&power_backoff);
+    return true;
+}
 
-    if (provider->use_preprocessing) {
-        input_req      = provider->pp_req;
-        input_model    = provider->pp_model;
-        output_tensors = provider->pp_output_tensors;
-        num_outputs    = provider->pp_num_outputs;
-    }
-
-    if (!input_req) {
-        input_req = larodCreateJobRequest(input_model,
-                                          input_tensors,
-                                          1,
-                                          output_tensors,
-                                          num_outputs,
-                                          provider->crop_map,
-                                          &error);
-        if (!input_req) {
+/**
+ * @brief Run the preprocessing job of a provider on a vdo buffer.
+ */
+static bool run_preprocessing(model_provider_t* provider, VdoBuffer* vdo_buf) {
+    larodError* error           = NULL;
+    larodTensor** input_tensors = get_input_tensors(provider, vdo_buf);
+
+    if (!provider->pp_req) {
+        provider->pp_req = larodCreateJobRequest(provider->pp_model,
+                                                 input_tensors,
+                                                 1,
+                                                 provider->pp_output_tensors,
+                                                 provider->pp_num_outputs,
+                                                 provider->crop_map,
+                                                 &error);
+        if (!provider->pp_req) {
             panic("%s: Failed to create input job request: %s", __func__, error->msg);
         }
     } else {
-        if (!larodSetJobRequestInputs(input_req, input_tensors, 1, &error)) {
+        if (!larodSetJobRequestInputs(provider->pp_req, input_tensors, 1, &error)) {
             panic("%s: Failed to set input job request: %s", __func__, error->msg);
         }
     }
-    if (provider->use_preprocessing) {
-        provider->pp_req = input_req;
-    } else {
-        provider->inf_req = input_req;
+    return run_job(provider, provider->pp_req, "preprocessing");
+}
+
+static void update_output_timestamps(model_provider_t* provider, VdoBuffer* vdo_buf) {
+    VdoFrame* frame = vdo_buffer_get_frame(vdo_buf);
+    uint64_t pts    = vdo_frame_get_timestamp(frame);
+    // Update the tensor outputs with the timestamp
+    for (size_t i = 0; i < provider->num_outputs; i++) {
+        provider->model_output_tensors[i].timestamp = pts;
+    }
+}
+
+bool model_run_inference(model_provider_t* provider, VdoBuffer* vdo_buf) {
+    larodError* error = NULL;
+
+    if (provider->batch_size > 1) {
+        panic("%s: Use model_run_batch_inference() for a model with batch size %u",
+              __func__,
+              provider->batch_size);
+    }
+    if (!power_backoff_ready(&power_backoff)) {
+        return false;
     }
 
     // If the inference failed because of no power no need to run
     // the preprocssing job again
     if (provider->use_preprocessing) {
-        if (!larodRunJob(provider->conn, provider->pp_req, &error)) {
-            if (error->code != LAROD_ERROR_POWER_NOT_AVAILABLE) {
-                panic("%s: Unable to run preprocessing job: %s (%d)",
-                      __func__,
-                      error->msg,
-                      error->code);
-            }
-            larodClearError(&error);
-            model_job_handle_no_power(&nbr_power_retries);
+        if (!run_preprocessing(provider, vdo_buf)) {
             return false;
         }
-        nbr_power_retries = 0;
         if (!provider->inf_req) {
             provider->inf_req = larodCreateJobRequest(provider->model,
                                                       provider->pp_output_tensors,
@@ -178,26 +196,71 @@ bool model_run_inference(model_provider_t* provider, VdoBuffer* vdo_buf) {
                 panic("%s: Failed creating inference job request: %s", __func__, error->msg);
             }
         }
+    } else {
+        larodTensor** input_tensors = get_input_tensors(provider, vdo_buf);
+        if (!provider->inf_req) {
+            provider->inf_req = larodCreateJobRequest(provider->model,
+                                                      input_tensors,
+                                                      1,
+                                                      provider->output_tensors,
+                                                      provider->num_outputs,
+                                                      provider->crop_map,
+                                                      &error);
+            if (!provider->inf_req) {
+                panic("%s: Failed to create input job request: %s", __func__, error->msg);
+            }
+        } else {
+            if (!larodSetJobRequestInputs(provider->inf_req, input_tensors, 1, &error)) {
+                panic("%s: Failed to set input job request: %s", __func__, error->msg);
+            }
+        }
     }
 
-    if (!larodRunJob(provider->conn, provider->inf_req, &error)) {
-        if (error->code != LAROD_ERROR_POWER_NOT_AVAILABLE) {
-            panic("%s: Unable to run inference on model: %s (%d)",
-                  __func__,
-                  error->msg,
-                  error->code);
+    if (!run_job(provider, provider->inf_req, "inference")) {
+        return false;
+    }
+    update_output_timestamps(provider, vdo_buf);
+    return true;
+}
+
+bool model_run_batch_inference(model_provider_t* owner,
+                               model_provider_t** providers,
+                               VdoBuffer** vdo_bufs,
+                               unsigned int num_providers) {
+    larodError* error = NULL;
+
+    if (owner->batch_size <= 1 || owner->batch_owner || num_providers > owner->batch_size) {
+        panic("%s: Invalid batch of %u frames", __func__, num_providers);
+    }
+    if (!power_backoff_ready(&power_backoff)) {
+        return false;
+    }
+
+    // Preprocess every frame into its slot of the batched input tensor, then
+    // run the model once for all of them, which amortizes the job overhead
+    for (unsigned int i = 0; i < num_providers; i++) {
+        if (!run_preprocessing(providers[i], vdo_bufs[i])) {
+            return false;
         }
-        larodClearError(&error);
-        model_job_handle_no_power(&nbr_power_retries);
+    }
+    if (!owner->inf_req) {
+        owner->inf_req = larodCreateJobRequest(owner->model,
+                                               owner->batch_input_tensors,
+                                               1,
+                                               owner->output_tensors,
+                                               owner->num_outputs,
+                                               NULL,
+                                               &error);
+        if (!owner->inf_req) {
+            panic("%s: Failed creating inference job request: %s", __func__, error->msg);
+        }
+    }
+    if (!run_job(owner, owner->inf_req, "batched inference")) {
         return false;
     }
-    VdoFrame* frame = vdo_buffer_get_frame(vdo_buf);
-    uint64_t pts    = vdo_frame_get_timestamp(frame);
-    // Update the tensor outputs with the timestamp
-    for (size_t i = 0; i < provider->num_outputs; i++) {
-        provider->model_output_tensors[i].timestamp = pts;
+    for (unsigned int i = 0; i < num_providers; i++) {
+        update_output_timestamps(providers[i], vdo_bufs[i]);
     }
-    nbr_power_retries = 0;
     return true;
 }
 
@@ -262,13 +325,31 @@ create_inference_model(model_provider_t* provider, char* model_file, char* devic
            device_name,
            model_file);
     const larodDevice* device = larodGetDevice(provider->conn, device_name, 0, &error);
+    // A model compiled by an earlier run of the application is used if larod still has it
+    char cache_name[MODEL_CACHE_NAME_SIZE];
+    bool use_cache = model_cache_name(MODEL_CACHE_APP_NAME,
+                                      provider->larod_model_fd,
+                                      device_name,
+                                      cache_name,
+                                      sizeof(cache_name));
+    if (use_cache) {
+        larodModel* cached =
+            model_cache_lookup(provider->conn, MODEL_CACHE_APP_NAME, device_name, cache_name);
+        if (cached) {
+            syslog(LOG_INFO, "Using cached model %s", cache_name);
+            return cached;
+        }
+    }
+    larodAccess access     = use_cache ? LAROD_ACCESS_PUBLIC : LAROD_ACCESS_PRIVATE;
+    const char* model_name = use_cache ? cache_name : "Vdo larod model";
+
     syslog(LOG_INFO,
            "Loading the model... This might take up to 5 minutes depending on your device model.");
     larodModel* model = larodLoadModel(provider->conn,
                                        provider->larod_model_fd,
                                        device,
-                                       LAROD_ACCESS_PRIVATE,
-                                       "Vdo larod model",
+                                       access,
+                                       model_name,
                                        NULL,
                                        &error);
     if (!model && error->code != LAROD_ERROR_POWER_NOT_AVAILABLE) {
@@ -281,8 +362,8 @@ create_inference_model(model_provider_t* provider, char* model_file, char* devic
         model = larodLoadModel(provider->conn,
                                provider->larod_model_fd,
                                device,
-                               LAROD_ACCESS_PRIVATE,
-                               "Vdo larod model",
+                               access,
+                               model_name,
                                NULL,
                                &error);
         // Sleep between retries
@@ -312,27 +393,40 @@ void model_provider_destroy(model_provider_t* provider) {
 
     larodDestroyMap(&provider->crop_map);
 
-    larodDestroyModel(&provider->model);
-    // Only the model handle is released here. We count on larod service to
-    // release the privately loaded model when the session is disconnected in
-    // larodDisconnect().
-    larodDisconnect(&(provider->conn), NULL);
+    // A provider sharing the model of another provider leaves the model and
+    // the connection to the owner, which must be destroyed last
+    if (!provider->shared_model) {
+        larodDestroyModel(&provider->model);
+        // Only the model handle is released here. The model is loaded public,
+        // see model_cache.h, so larod keeps it for the next start. A model that
+        // could not be cached is private and released by larod when the session
+        // is disconnected in larodDisconnect().
+        larodDisconnect(&(provider->conn), NULL);
+    }
 
     if (provider->larod_model_fd >= 0) {
         close(provider->larod_model_fd);
     }
-    for (size_t i = 0; i < provider->num_outputs; i++) {
-        if (provider->model_output_tensors[i].data != MAP_FAILED) {
-            munmap(provider->model_output_tensors[i].data, provider->model_output_tensors[i].size);
+    // The outputs of a batched model are parts of the batched outputs mapped by the owner
+    model_tensor_output_t* mapped_outputs = provider->model_output_tensors;
+    if (provider->batch_size > 1) {
+        mapped_outputs = provider->batch_output_tensors;
+    }
+    for (size_t i = 0; mapped_outputs && i < provider->num_outputs; i++) {
+        if (mapped_outputs[i].data != MAP_FAILED) {
+            munmap(mapped_outputs[i].data, mapped_outputs[i].size);
         }
 
-        if (provider->model_output_tensors[i].fd >= 0) {
-            close(provider->model_output_tensors[i].fd);
+        if (mapped_outputs[i].fd >= 0) {
+            close(mapped_outputs[i].fd);
         }
     }
     if (provider->model_output_tensors) {
         free(provider->model_output_tensors);
     }
+    if (provider->batch_output_tensors) {
+        free(provider->batch_output_tensors);
+    }
     for (size_t i = 0; i < provider->img_info->nbr_buffers; i++) {
         larodDestroyTensors(provider->conn, &provider->img_input_tensors[i], 1, &error);
         if (provider->img_duped_fds[i] >= 0) {
@@ -348,6 +442,7 @@ void model_provider_destroy(model_provider_t* provider) {
                         provider->pp_num_outputs,
                         &error);
     larodDestroyTensors(provider->conn, &provider->output_tensors, provider->num_outputs, &error);
+    larodDestroyTensors(provider->conn, &provider->batch_input_tensors, 1, &error);
 
     larodDestroyJobRequest(&(provider->pp_req));
     larodDestroyJobRequest(&(provider->inf_req));
@@ -355,19 +450,103 @@ void model_provider_destroy(model_provider_t* provider) {
     free(provider);
 }
 
-model_provider_t*
-model_provider_new(char* model_file, char* device_name, size_t* num_output_tensors) {
-    model_provider_t* provider = calloc(1, sizeof(model_provider_t));
-    if (!provider) {
-        panic("%s: Unable to allocate model_provider_t: %s", __func__, strerror(errno));
+/**
+ * @brief Map the output tensors of a provider, to be able to read the result of the inference.
+ */
+static void map_output_tensors(model_provider_t* provider) {
+    larodError* error = NULL;
+
+    provider->model_output_tensors = calloc(provider->num_outputs, sizeof(model_tensor_output_t));
+    // To be able to get the data from the output tensors get the fd and mmap the memory
+    for (size_t i = 0; i < provider->num_outputs; i++) {
+        int fd = larodGetTensorFd(provider->output_tensors[i], &error);
+        if (fd == LAROD_INVALID_FD) {
+            panic("%s: Could not get tensor fd: %s", __func__, error->msg);
+        }
+        size_t output_size           = 0;
+        void* data                   = NULL;
+        larodTensorDataType datatype = LAROD_TENSOR_DATA_TYPE_INVALID;
+
+        provider->model_output_tensors[i].fd = fd;
+        if (!larodGetTensorFdSize(provider->output_tensors[i], &output_size, &error)) {
+            panic("%s: Could not get byte size of tensor: %s", __func__, error->msg);
+        }
+        provider->model_output_tensors[i].size = output_size;
+        data = mmap(NULL, output_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (data == MAP_FAILED) {
+            panic("%s: Could not map inference output tensors fd: %s", __func__, strerror(errno));
+        }
+        provider->model_output_tensors[i].data = data;
+        datatype = larodGetTensorDataType(provider->output_tensors[i], &error);
+        if (datatype == LAROD_TENSOR_DATA_TYPE_INVALID) {
+            panic("%s: Could not get output tensor data type: %s", __func__, error->msg);
+        }
+        provider->model_output_tensors[i].datatype = datatype;
+        syslog(LOG_INFO, "Created mmaped model output %zu with size %zu", i, output_size);
     }
+}
 
+/**
+ * @brief Set up the batched tensors of a provider with a model that takes several frames.
+ *
+ * The owner allocates an input tensor for the whole batch, that the
+ * preprocessing of each slot writes to, and maps the batched outputs. The
+ * outputs of each provider are the part of the batched outputs for its slot,
+ * so a provider sharing the model of the owner has no output tensors of its own.
+ */
+static void setup_batch_tensors(model_provider_t* provider,
+                                const larodTensorPitches* input_pitches) {
     larodError* error = NULL;
 
-    if (!larodConnect(&provider->conn, &error)) {
-        panic("%s: Could not connect to larod: %s", __func__, error->msg);
+    model_provider_t* owner = provider->batch_owner;
+    if (!owner) {
+        size_t num_inputs = 0;
+        provider->batch_input_tensors =
+            larodAllocModelInputs(provider->conn,
+                                  provider->model,
+                                  LAROD_FD_PROP_READWRITE | LAROD_FD_PROP_MAP,
+                                  &num_inputs,
+                                  NULL,
+                                  &error);
+        if (!provider->batch_input_tensors) {
+            panic("%s: Failed allocating batched input tensor: %s", __func__, error->msg);
+        }
+        // The pitch of the first dimension is the size of the batch, the next the size of a slot
+        provider->batch_slot_size = input_pitches->pitches[1];
+        provider->num_batch_slots = 1;
+        map_output_tensors(provider);
+        provider->batch_output_tensors = provider->model_output_tensors;
+        owner                          = provider;
+    } else {
+        // The shared provider only reads its part of the outputs of the owner
+        larodDestroyTensors(provider->conn,
+                            &provider->output_tensors,
+                            provider->num_outputs,
+                            &error);
+    }
+    provider->model_output_tensors = calloc(provider->num_outputs, sizeof(model_tensor_output_t));
+    if (!provider->model_output_tensors) {
+        panic("%s: Unable to allocate output tensors: %s", __func__, strerror(errno));
     }
 
+    for (size_t i = 0; i < provider->num_outputs; i++) {
+        model_tensor_output_t* batch_output = &owner->batch_output_tensors[i];
+        size_t slot_size                    = batch_output->size / provider->batch_size;
+        model_tensor_output_t* output       = &provider->model_output_tensors[i];
+
+        output->fd       = batch_output->fd;
+        output->datatype = batch_output->datatype;
+        output->size     = slot_size;
+        output->data     = (uint8_t*)batch_output->data + provider->batch_slot * slot_size;
+    }
+}
+
+/**
+ * @brief Get the model metadata and allocate the output tensors of a provider with a model.
+ */
+static void setup_model_tensors(model_provider_t* provider, size_t* num_output_tensors) {
+    larodError* error = NULL;
+
     provider->crop_map = NULL;
     provider->pp_req   = NULL;
     provider->inf_req  = NULL;
@@ -376,7 +555,6 @@ model_provider_new(char* model_file, char* device_name, size_t* num_output_tenso
     // The output tensors will be used for the inference job request
     larodTensor** input_tensors = NULL;
     size_t num_inputs           = 0;
-    provider->model             = create_inference_model(provider, model_file, device_name);
     setup_tensors(provider->conn,
                   provider->model,
                   &input_tensors,
@@ -429,40 +607,90 @@ model_provider_new(char* model_file, char* device_name, size_t* num_output_tenso
     } else {
         panic("%s: Invalid model format %u", __func__, provider->img_info->format);
     }
-    provider->model_output_tensors = calloc(provider->num_outputs, sizeof(model_tensor_output_t));
-    // To be able to get the data from the output tensors get the fd and mmap the memory
-    for (size_t i = 0; i < provider->num_outputs; i++) {
-        int fd = larodGetTensorFd(provider->output_tensors[i], &error);
-        if (fd == LAROD_INVALID_FD) {
-            panic("%s: Could not get tensor fd: %s", __func__, error->msg);
-        }
-        size_t output_size           = 0;
-        void* data                   = NULL;
-        larodTensorDataType datatype = LAROD_TENSOR_DATA_TYPE_INVALID;
-
-        provider->model_output_tensors[i].fd = fd;
-        if (!larodGetTensorFdSize(provider->output_tensors[i], &output_size, &error)) {
-            panic("%s: Could not get byte size of tensor: %s", __func__, error->msg);
-        }
-        provider->model_output_tensors[i].size = output_size;
-        data = mmap(NULL, output_size, PROT_READ, MAP_SHARED, fd, 0);
-        if (data == MAP_FAILED) {
-            panic("%s: Could not map inference output tensors fd: %s", __func__, strerror(errno));
-        }
-        provider->model_output_tensors[i].data = data;
-        datatype = larodGetTensorDataType(provider->output_tensors[i], &error);
-        if (datatype == LAROD_TENSOR_DATA_TYPE_INVALID) {
-            panic("%s: Could not get output tensor data type: %s", __func__, error->msg);
-        }
-        provider->model_output_tensors[i].datatype = datatype;
-        syslog(LOG_INFO, "Created mmaped model output %zu with size %zu", i, output_size);
+    // The first dimension is the number of frames the model takes in one job
+    provider->batch_size = input_dims->dims[0];
+    if (provider->batch_size > 1) {
+        syslog(LOG_INFO, "Detected model batch size %u", provider->batch_size);
+        setup_batch_tensors(provider, input_pitches);
+    } else {
+        map_output_tensors(provider);
     }
     *num_output_tensors = provider->num_outputs;
     larodDestroyTensors(provider->conn, &input_tensors, num_inputs, &error);
+}
+
+model_provider_t*
+model_provider_new(char* model_file, char* device_name, size_t* num_output_tensors) {
+    model_provider_t* provider = calloc(1, sizeof(model_provider_t));
+    if (!provider) {
+        panic("%s: Unable to allocate model_provider_t: %s", __func__, strerror(errno));
+    }
+
+    larodError* error = NULL;
+
+    if (!larodConnect(&provider->conn, &error)) {
+        panic("%s: Could not connect to larod: %s", __func__, error->msg);
+    }
+
+    provider->model = create_inference_model(provider, model_file, device_name);
+    setup_model_tensors(provider, num_output_tensors);
 
     return provider;
 }
 
+model_provider_t* model_provider_new_shared(model_provider_t* owner, size_t* num_output_tensors) {
+    model_provider_t* provider = calloc(1, sizeof(model_provider_t));
+    if (!provider) {
+        panic("%s: Unable to allocate model_provider_t: %s", __func__, strerror(errno));
+    }
+
+    // Use the connection and the loaded model of the owner, so the model is
+    // only loaded once, but have separate input and output tensors
+    provider->conn           = owner->conn;
+    provider->model          = owner->model;
+    provider->device_name    = owner->device_name;
+    provider->larod_model_fd = -1;
+    provider->shared_model   = true;
+    // With a batched model, the provider takes the next slot of the batch of the owner
+    if (owner->batch_size > 1) {
+        if (owner->num_batch_slots == owner->batch_size) {
+            panic("%s: All %u slots of the model batch are used", __func__, owner->batch_size);
+        }
+        provider->batch_owner = owner;
+        provider->batch_slot  = owner->num_batch_slots++;
+    }
+    setup_model_tensors(provider, num_output_tensors);
+
+    return provider;
+}
+
+bool model_provider_set_crop(model_provider_t* provider,
+                             unsigned int x,
+                             unsigned int y,
+                             unsigned int width,
+                             unsigned int height) {
+    larodError* error = NULL;
+
+    if (!provider->use_preprocessing) {
+        return false;
+    }
+    if (!provider->crop_map) {
+        provider->crop_map = larodCreateMap(&error);
+        if (!provider->crop_map) {
+            panic("%s: Could not create crop larodMap: %s", __func__, error->msg);
+        }
+    }
+    if (!larodMapSetIntArr4(provider->crop_map, "image.input.crop", x, y, width, height, &error)) {
+        panic("%s: Failed setting crop: %s", __func__, error->msg);
+    }
+    // The map is copied into the job request, so an existing request is updated
+    if (provider->pp_req &&
+        !larodSetJobRequestParams(provider->pp_req, provider->crop_map, &error)) {
+        panic("%s: Failed setting crop of job request: %s", __func__, error->msg);
+    }
+    return true;
+}
+
 img_info_t model_provider_get_model_metadata(model_provider_t* provider) {
     return *provider->img_info;
 }
@@ -488,6 +716,10 @@ bool model_provider_update_image_metadata(model_provider_t* provider, VdoMap* im
         provider->img_info->height != img_info.height) {
         provider->use_preprocessing = true;
     }
+    // The frames of a batch are gathered in the batched input tensor by the preprocessing
+    if (provider->batch_size > 1) {
+        provider->use_preprocessing = true;
+    }
 
     larodTensorLayout tensor_layout = LAROD_TENSOR_LAYOUT_UNSPECIFIED;
     if (img_info.format == VDO_FORMAT_RGB) {
@@ -42,6 +42,21 @@ typedef struct model_provider {
     larodModel* model;
     model_tensor_output_t* model_output_tensors;
     int larod_model_fd;
+    // The connection and the model belong to another provider
+    bool shared_model;
+
+    // Batch variables, used when the first dimension of the model input is larger than 1
+    unsigned int batch_size;
+    // Slot of the provider in the batched input and output tensors
+    unsigned int batch_slot;
+    // Provider that owns the batched tensors, NULL for the owner itself
+    struct model_provider* batch_owner;
+    // Batched input tensor that the preprocessing of all slots writes to, and the
+    // mapped batched outputs, only set for the owner
+    larodTensor** batch_input_tensors;
+    model_tensor_output_t* batch_output_tensors;
+    size_t batch_slot_size;
+    unsigned int num_batch_slots;
 
     // Preprocessing variables
     bool use_preprocessing;
@@ -56,19 +71,63 @@ typedef struct model_provider {
     larodTensor** img_input_tensors[MAX_NBR_IMG_PROVIDER_BUFFERS];
     int img_tracked_tensors[MAX_NBR_IMG_PROVIDER_BUFFERS];
     int img_duped_fds[MAX_NBR_IMG_PROVIDER_BUFFERS];
+    int num_tracked_tensors;
 } model_provider_t;
 
 bool model_run_inference(model_provider_t* provider, VdoBuffer* vdo_buf);
 
+/**
+ * @brief Run one inference job on the frames of several providers sharing a batched model.
+ *
+ * Each frame is preprocessed into the slot of its provider in the batched
+ * input tensor, and the outputs of each provider are updated. Slots without
+ * a frame are left as they are and their outputs should be ignored.
+ *
+ * @param owner         The provider that loaded the model.
+ * @param providers     The providers of the frames, the owner or providers sharing its model.
+ * @param vdo_bufs      One frame per provider.
+ * @param num_providers Number of frames, at most the batch size of the model.
+ */
+bool model_run_batch_inference(model_provider_t* owner,
+                               model_provider_t** providers,
+                               VdoBuffer** vdo_bufs,
+                               unsigned int num_providers);
+
 bool model_get_tensor_output_info(model_provider_t* provider,
                                   unsigned int tensor_output_index,
                                   model_tensor_output_t* tensor_output);
 
 img_info_t model_provider_get_model_metadata(model_provider_t* provider);
 
+/**
+ * @brief Let the preprocessing only use a region, in stream pixels, of the next frames.
+ *
+ * The region is scaled to the model input, so it should have the same aspect ratio.
+ *
+ * @return False if the provider does not use preprocessing, then the whole frame is used.
+ */
+bool model_provider_set_crop(model_provider_t* provider,
+                             unsigned int x,
+                             unsigned int y,
+                             unsigned int width,
+                             unsigned int height);
+
 bool model_provider_update_image_metadata(model_provider_t* provider, VdoMap* image_map);
 
 model_provider_t*
 model_provider_new(char* model_file, char* device_name, size_t* num_output_tensors);
 
+/**
+ * @brief Create a provider that uses the larod connection and the loaded model of another.
+ *
+ * The new provider has its own input, preprocessing and output tensors, so it
+ * can be used for another stream. The owner must be destroyed after all
+ * providers sharing its model.
+ *
+ * If the model takes a batch of frames, the new provider gets the next slot in
+ * the batched tensors of the owner instead, and is run together with the
+ * owner by model_run_batch_inference().
+ */
+model_provider_t* model_provider_new_shared(model_provider_t* owner, size_t* num_output_tensors);
+
 void model_provider_destroy(model_provider_t* provider);
@@ -98,17 +98,64 @@ static larodModel* create_preprocessing_model(model_provider_t* provider, img_in
     return model;
 }
 
+/**
+ * @brief Create the preprocessing output tensors that write to the slot of a provider in the
+ * batched input tensor of the model.
+ */
+static larodTensor** create_batch_slot_tensors(model_provider_t* provider) {
+    larodError* error       = NULL;
+    model_provider_t* owner = provider->batch_owner ? provider->batch_owner : provider;
+
+    larodTensor** tensors =
+        larodCreateModelOutputs(provider->pp_model, &provider->pp_num_outputs, &error);
+    if (!tensors) {
+        panic("%s: Failed creating output tensors: %s", __func__, error->msg);
+    }
+    larodTensor* batch_tensor = owner->batch_input_tensors[0];
+    int batch_fd              = larodGetTensorFd(batch_tensor, &error);
+    if (batch_fd == LAROD_INVALID_FD) {
+        panic("%s: Could not get batched tensor fd: %s", __func__, error->msg);
+    }
+    size_t batch_fd_size = 0;
+    if (!larodGetTensorFdSize(batch_tensor, &batch_fd_size, &error)) {
+        panic("%s: Could not get size of batched tensor: %s", __func__, error->msg);
+    }
+    int64_t batch_fd_offset = larodGetTensorFdOffset(batch_tensor, &error);
+    if (batch_fd_offset < 0) {
+        panic("%s: Could not get offset of batched tensor: %s", __func__, error->msg);
+    }
+
+    int64_t slot_offset = batch_fd_offset + (int64_t)provider->batch_slot * owner->batch_slot_size;
+    if (!larodSetTensorFd(tensors[0], batch_fd, &error)) {
+        panic("%s: Failed to set fd for tensor: %s", __func__, error->msg);
+    }
+    if (!larodSetTensorFdOffset(tensors[0], slot_offset, &error)) {
+        panic("%s: Failed to set offset for tensor: %s", __func__, error->msg);
+    }
+    if (!larodSetTensorFdSize(tensors[0], batch_fd_size, &error)) {
+        panic("%s: Failed to set size for tensor: %s", __func__, error->msg);
+    }
+    if (!larodSetTensorFdProps(tensors[0], LAROD_FD_PROP_READWRITE | LAROD_FD_PROP_MAP, &error)) {
+        panic("%s: Failed to set fd props for tensor: %s", __func__, error->msg);
+    }
+    return tensors;
+}
+
 bool model_preprocessing_setup(model_provider_t* provider, img_info_t* img_info) {
     larodError* error  = NULL;
     provider->pp_model = create_preprocessing_model(provider, img_info);
     // Create the output tensors for the preprocessing
-    provider->pp_output_tensors =
-        larodAllocModelOutputs(provider->conn,
-                               provider->pp_model,
-                               LAROD_FD_PROP_READWRITE | LAROD_FD_PROP_MAP,
-                               &provider->pp_num_outputs,
-                               NULL,
-                               &error);
+    if (provider->batch_size > 1) {
+        provider->pp_output_tensors = create_batch_slot_tensors(provider);
+    } else {
+        provider->pp_output_tensors =
+            larodAllocModelOutputs(provider->conn,
+                                   provider->pp_model,
+                                   LAROD_FD_PROP_READWRITE | LAROD_FD_PROP_MAP,
+                                   &provider->pp_num_outputs,
+                                   NULL,
+                                   &error);
+    }
     if (!provider->pp_output_tensors) {
         panic("%s: Failed retrieving output tensors: %s", __func__, error->msg);
     }
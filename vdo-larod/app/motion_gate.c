@@ -0,0 +1,194 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "motion_gate.h"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+
+#include "panic.h"
+
+motion_gate_t* motion_gate_new(VdoMap* stream_info, const motion_gate_params_t* params) {
+    VdoFormat format = vdo_map_get_uint32(stream_info, "format", 0);
+    if (format != VDO_FORMAT_YUV && format != VDO_FORMAT_RGB && format != VDO_FORMAT_PLANAR_RGB) {
+        syslog(LOG_ERR, "%s: Format %u is not supported", __func__, format);
+        return NULL;
+    }
+
+    motion_gate_t* gate = calloc(1, sizeof(motion_gate_t));
+    if (!gate) {
+        panic("%s: Unable to allocate motion gate: %s", __func__, strerror(errno));
+    }
+    gate->params = *params;
+    gate->format = format;
+    gate->width  = vdo_map_get_uint32(stream_info, "width", 0);
+    gate->height = vdo_map_get_uint32(stream_info, "height", 0);
+    gate->pitch  = vdo_map_get_uint32(stream_info, "pitch", gate->width);
+
+    gate->samples_x = (gate->width + MOTION_GATE_SAMPLE_STEP - 1) / MOTION_GATE_SAMPLE_STEP;
+    gate->samples_y = (gate->height + MOTION_GATE_SAMPLE_STEP - 1) / MOTION_GATE_SAMPLE_STEP;
+    gate->blocks_x  = (gate->samples_x + MOTION_GATE_BLOCK_SAMPLES - 1) / MOTION_GATE_BLOCK_SAMPLES;
+    gate->blocks_y  = (gate->samples_y + MOTION_GATE_BLOCK_SAMPLES - 1) / MOTION_GATE_BLOCK_SAMPLES;
+
+    gate->reference      = calloc((size_t)gate->samples_x * gate->samples_y, 1);
+    gate->current        = calloc((size_t)gate->samples_x * gate->samples_y, 1);
+    gate->changed_blocks = calloc((size_t)gate->blocks_x * gate->blocks_y, sizeof(bool));
+    if (!gate->reference || !gate->current || !gate->changed_blocks) {
+        panic("%s: Unable to allocate motion gate samples: %s", __func__, strerror(errno));
+    }
+    return gate;
+}
+
+/**
+ * @brief Luma of the pixel at x, y.
+ *
+ * For RGB the luma is approximated with (R + 2G + B) / 4, which is close
+ * enough to tell a change.
+ */
+static uint8_t sample_luma(const motion_gate_t* gate,
+                           const uint8_t* data,
+                           unsigned int x,
+                           unsigned int y) {
+    switch (gate->format) {
+        case VDO_FORMAT_RGB: {
+            const uint8_t* pixel = data + (size_t)y * gate->pitch + 3 * x;
+            return (uint8_t)((pixel[0] + 2 * pixel[1] + pixel[2]) >> 2);
+        }
+        case VDO_FORMAT_PLANAR_RGB: {
+            size_t plane_size = (size_t)gate->pitch * gate->height;
+            size_t offset     = (size_t)y * gate->pitch + x;
+            return (uint8_t)((data[offset] + 2 * data[plane_size + offset] +
+                              data[2 * plane_size + offset]) >>
+                             2);
+        }
+        default:
+            // The Y plane comes first in NV12
+            return data[(size_t)y * gate->pitch + x];
+    }
+}
+
+bool motion_gate_check(motion_gate_t* gate, VdoBuffer* buffer) {
+    const uint8_t* data = vdo_buffer_get_data(buffer);
+    if (!data) {
+        panic("%s: Could not get the data of the buffer", __func__);
+    }
+
+    memset(gate->changed_blocks, 0, (size_t)gate->blocks_x * gate->blocks_y * sizeof(bool));
+    unsigned int num_changed = 0;
+    for (unsigned int sy = 0; sy < gate->samples_y; sy++) {
+        const uint8_t* reference = gate->reference + (size_t)sy * gate->samples_x;
+        uint8_t* current         = gate->current + (size_t)sy * gate->samples_x;
+        bool* blocks =
+            gate->changed_blocks + (size_t)(sy / MOTION_GATE_BLOCK_SAMPLES) * gate->blocks_x;
+        for (unsigned int sx = 0; sx < gate->samples_x; sx++) {
+            current[sx] = sample_luma(gate,
+                                      data,
+                                      sx * MOTION_GATE_SAMPLE_STEP,
+                                      sy * MOTION_GATE_SAMPLE_STEP);
+            int diff    = current[sx] - reference[sx];
+            if (diff > gate->params.threshold || -diff > gate->params.threshold) {
+                blocks[sx / MOTION_GATE_BLOCK_SAMPLES] = true;
+                num_changed++;
+            }
+        }
+    }
+
+    float changed = (float)num_changed / (float)(gate->samples_x * gate->samples_y);
+    bool passed   = !gate->has_reference || changed >= gate->params.min_changed ||
+                    (gate->params.max_skipped > 0 && gate->skipped >= gate->params.max_skipped);
+    if (!passed) {
+        gate->skipped++;
+        gate->num_skipped++;
+        return false;
+    }
+
+    // Compare the next frames with this one, so slow changes add up until they pass
+    uint8_t* reference  = gate->reference;
+    gate->reference     = gate->current;
+    gate->current       = reference;
+    gate->has_reference = true;
+    gate->skipped       = 0;
+    gate->num_passed++;
+    return true;
+}
+
+bool motion_gate_get_region(const motion_gate_t* gate,
+                            unsigned int aspect_width,
+                            unsigned int aspect_height,
+                            motion_gate_region_t* region) {
+    unsigned int min_x = gate->blocks_x;
+    unsigned int min_y = gate->blocks_y;
+    unsigned int max_x = 0;
+    unsigned int max_y = 0;
+    for (unsigned int by = 0; by < gate->blocks_y; by++) {
+        for (unsigned int bx = 0; bx < gate->blocks_x; bx++) {
+            if (gate->changed_blocks[(size_t)by * gate->blocks_x + bx]) {
+                min_x = MIN(min_x, bx);
+                min_y = MIN(min_y, by);
+                max_x = MAX(max_x, bx + 1);
+                max_y = MAX(max_y, by + 1);
+            }
+        }
+    }
+    if (min_x >= max_x) {
+        return false;
+    }
+
+    const unsigned int block_size = MOTION_GATE_SAMPLE_STEP * MOTION_GATE_BLOCK_SAMPLES;
+    unsigned int x1               = min_x * block_size;
+    unsigned int y1               = min_y * block_size;
+    unsigned int x2               = MIN(max_x * block_size, gate->width);
+    unsigned int y2               = MIN(max_y * block_size, gate->height);
+
+    // Grow the region around its center to the aspect ratio of the model input
+    float width  = (float)(x2 - x1);
+    float height = (float)(y2 - y1);
+    float aspect = (float)aspect_width / (float)aspect_height;
+    if (width < height * aspect) {
+        width = height * aspect;
+    } else {
+        height = width / aspect;
+    }
+    if (width >= (float)gate->width || height >= (float)gate->height) {
+        return false;
+    }
+    float center_x = (float)(x1 + x2) / 2.0f;
+    float center_y = (float)(y1 + y2) / 2.0f;
+    float left     = CLAMP(center_x - width / 2.0f, 0.0f, (float)gate->width - width);
+    float top      = CLAMP(center_y - height / 2.0f, 0.0f, (float)gate->height - height);
+
+    region->x      = (unsigned int)left & ~1u;
+    region->y      = (unsigned int)top & ~1u;
+    region->width  = (unsigned int)width & ~1u;
+    region->height = (unsigned int)height & ~1u;
+    return true;
+}
+
+void motion_gate_destroy(motion_gate_t* gate) {
+    if (!gate) {
+        return;
+    }
+    syslog(LOG_INFO,
+           "Motion gate passed %llu frames and skipped %llu",
+           (unsigned long long)gate->num_passed,
+           (unsigned long long)gate->num_skipped);
+    free(gate->reference);
+    free(gate->current);
+    free(gate->changed_blocks);
+    free(gate);
+}
@@ -0,0 +1,118 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * A cheap check of whether a frame has changed since the last inference.
+ *
+ * The luma of a sparse grid of pixels is sampled, the Y plane for YUV streams
+ * and an approximation from the color channels for RGB streams, and compared
+ * with the samples of the last frame that passed the gate. The frame passes
+ * when enough samples have changed, so inference is skipped on idle frames
+ * and the DLPU can drop to low power. A frame always passes after a number of
+ * skipped frames, so the result does not get too old.
+ *
+ * The samples are grouped in blocks, and the blocks with changes give the
+ * region of the frame that is active, which can be used as a crop for the
+ * inference.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <glib.h>
+
+#include "vdo-buffer.h"
+#include "vdo-map.h"
+#include "vdo-types.h"
+
+// Distance in pixels between two samples in each direction
+#define MOTION_GATE_SAMPLE_STEP 8
+// Number of samples in each direction of a block
+#define MOTION_GATE_BLOCK_SAMPLES 4
+
+typedef struct motion_gate_params {
+    // Difference in luma for a sample to count as changed
+    uint8_t threshold;
+    // Share of the samples that must change for the frame to pass
+    float min_changed;
+    // Frames that can be skipped in a row before one passes anyway, 0 for no limit
+    unsigned int max_skipped;
+} motion_gate_params_t;
+
+typedef struct motion_gate_region {
+    unsigned int x;
+    unsigned int y;
+    unsigned int width;
+    unsigned int height;
+} motion_gate_region_t;
+
+typedef struct motion_gate {
+    motion_gate_params_t params;
+
+    VdoFormat format;
+    unsigned int width;
+    unsigned int height;
+    unsigned int pitch;
+
+    unsigned int samples_x;
+    unsigned int samples_y;
+    // Luma samples of the last frame that passed, and of the checked frame
+    uint8_t* reference;
+    uint8_t* current;
+    bool has_reference;
+
+    unsigned int blocks_x;
+    unsigned int blocks_y;
+    // Blocks with changed samples in the last checked frame
+    bool* changed_blocks;
+
+    unsigned int skipped;
+    uint64_t num_passed;
+    uint64_t num_skipped;
+} motion_gate_t;
+
+/**
+ * @brief Create a gate for the frames of a stream.
+ *
+ * @param stream_info The info map of the stream, see vdo_stream_get_info().
+ *
+ * @return The gate, or NULL if the format of the stream is not supported.
+ */
+motion_gate_t* motion_gate_new(VdoMap* stream_info, const motion_gate_params_t* params);
+
+/**
+ * @brief Check if a frame has changed enough since the last frame that passed.
+ *
+ * The samples of a frame that passes become the reference of the next check.
+ */
+bool motion_gate_check(motion_gate_t* gate, VdoBuffer* buffer);
+
+/**
+ * @brief Get the region of the changed blocks of the last checked frame.
+ *
+ * The region is grown to the aspect ratio of the model input, and is kept
+ * within the frame with even coordinates.
+ *
+ * @return False if no block changed, or the whole frame is needed.
+ */
+bool motion_gate_get_region(const motion_gate_t* gate,
+                            unsigned int aspect_width,
+                            unsigned int aspect_height,
+                            motion_gate_region_t* region);
+
+void motion_gate_destroy(motion_gate_t* gate);
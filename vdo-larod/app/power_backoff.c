@@ -0,0 +1,71 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "power_backoff.h"
+
+#include <syslog.h>
+
+#include "panic.h"
+
+bool power_backoff_ready(power_backoff_t* backoff) {
+    if (backoff->failures == 0 || g_get_monotonic_time() >= backoff->retry_at_us) {
+        return true;
+    }
+    backoff->skipped++;
+    return false;
+}
+
+void power_backoff_failed(power_backoff_t* backoff) {
+    gint64 now = g_get_monotonic_time();
+    // Jobs that were started before the backoff period do not extend it
+    if (backoff->failures > 0 && now < backoff->retry_at_us) {
+        return;
+    }
+    if (backoff->failures == POWER_BACKOFF_MAX_FAILURES) {
+        panic("%s: Still no power available after %u larod jobs, giving up",
+              __func__,
+              backoff->failures);
+    }
+
+    unsigned int delay_ms = POWER_BACKOFF_INITIAL_DELAY_MS;
+    for (unsigned int i = 0; i < backoff->failures && delay_ms < POWER_BACKOFF_MAX_DELAY_MS; i++) {
+        delay_ms *= 2;
+    }
+    delay_ms = MIN(delay_ms, POWER_BACKOFF_MAX_DELAY_MS);
+
+    if (backoff->failures == 0) {
+        syslog(LOG_WARNING, "No power available for larod jobs, entering degraded mode");
+        backoff->skipped = 0;
+    }
+    backoff->failures++;
+    backoff->retry_at_us = now + (gint64)delay_ms * 1000;
+    syslog(LOG_INFO,
+           "No power available when running larod job, try nbr %u, retrying in %u ms",
+           backoff->failures,
+           delay_ms);
+}
+
+void power_backoff_succeeded(power_backoff_t* backoff) {
+    if (backoff->failures == 0) {
+        return;
+    }
+    syslog(LOG_INFO,
+           "Power available again, leaving degraded mode after %u failed and %llu skipped jobs",
+           backoff->failures,
+           (unsigned long long)backoff->skipped);
+    backoff->failures = 0;
+    backoff->skipped  = 0;
+}
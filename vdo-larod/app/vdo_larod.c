@@ -44,14 +44,16 @@
 #include <syslog.h>
 
 #include "channel_util.h"
+#include "frame_latency.h"
 #include "img_util.h"
+#include "inference_scheduler.h"
 #include "model.h"
+#include "motion_gate.h"
 #include "panic.h"
 #include "vdo-error.h"
 #include "vdo-frame.h"
 #include "vdo-types.h"
 
-#include <poll.h>
 #include <unistd.h>
 
 volatile sig_atomic_t running = 1;
@@ -120,66 +122,82 @@ static VdoStream* create_new_vdo_stream(unsigned int channel,
 }
 
 /**
- * @brief Main function that starts a stream with different options.
+ * @brief Print the result of the inference on a frame of a channel.
  */
-int main(int argc, char** argv) {
-    char* device_name                     = argv[1];
-    char* model_file                      = argv[2];
-    char* image_fit                       = argv[3];
-    g_autoptr(GError) vdo_error           = NULL;
-    model_provider_t* model_provider      = NULL;
-    model_tensor_output_t* tensor_outputs = NULL;
-    img_info_t model_metadata             = {0};
-    img_framerate_t image_framerate       = {0};
-    g_autoptr(VdoStream) vdo_stream       = NULL;
-    g_autoptr(VdoMap) vdo_stream_info     = NULL;
-
-    // Stop main loop at signal
-    signal(SIGTERM, shutdown);
-    signal(SIGINT, shutdown);
-
-    syslog(LOG_INFO, "Starting %s", argv[0]);
-
-    if (argc != 4) {
-        syslog(LOG_ERR,
-               "Invalid number of arguments. Required arguments are: "
-               "DEVICENAME MODEL_PATH IMAGEFIT");
-        goto end;
-    }
-
-    // Start by loading the model and get the model metadata
-    size_t number_output_tensors = 0;
-    model_provider = model_provider_new(model_file, device_name, &number_output_tensors);
-    if (!model_provider) {
-        panic("%s: Could not create model provider", __func__);
-    }
-
-    tensor_outputs = calloc(number_output_tensors, sizeof(model_tensor_output_t));
-    if (!tensor_outputs) {
-        panic("%s: Could not allocate tensor outputs", __func__);
+static void print_result(unsigned int channel_id,
+                         model_provider_t* model_provider,
+                         const char* device_name,
+                         model_tensor_output_t* tensor_outputs,
+                         size_t number_output_tensors) {
+    if (number_output_tensors == 2) {
+        // Only parse if the number outputs are == 2
+        //  When a model with a different amount of output tensors is used, we don't want the
+        //  application to crash during parsing.
+        for (size_t i = 0; i < number_output_tensors; i++) {
+            if (!model_get_tensor_output_info(model_provider, i, &tensor_outputs[i])) {
+                panic("Failed to get output tensor info for %zu", i);
+            }
+        }
+        // The tensor_outputs contains
+        // data -  The tensor data
+        // size -  Tensor data size
+        // datatype -  Datatype of the tensor
+        // timestamp - The timestamp of the VDO frame used for inference
+
+        // Parse the data.
+        // Model output differs between the CV25 model and the other models.
+        // The CV25 model has car data at output 0 and person data at output 1.
+        // Also, the CV25 model directly outputs float32 data, while the other models' outputs
+        // are uint8 quantized.
+        if (strcmp(device_name, "ambarella-cvflow") == 0) {
+            float* car_pred    = (float*)tensor_outputs[0].data;
+            float* person_pred = (float*)tensor_outputs[1].data;
+
+            syslog(LOG_INFO,
+                   "[Channel %u] Person detected: %.2f%% - Car detected: %.2f%%",
+                   channel_id,
+                   *person_pred * 100,
+                   *car_pred * 100);
+        } else {
+            uint8_t* person_pred = (uint8_t*)tensor_outputs[0].data;
+            uint8_t* car_pred    = (uint8_t*)tensor_outputs[1].data;
+            syslog(LOG_INFO,
+                   "[Channel %u] Person detected: %.2f%% - Car detected: %.2f%%",
+                   channel_id,
+                   (float)*person_pred / 2.55f,
+                   (float)*car_pred / 2.55f);
+        }
     }
+}
 
-    // Get the model format and model input dimension and pitches
-    model_metadata = model_provider_get_model_metadata(model_provider);
-
-    // Set to a framerate that is sufficient for inference
-    double vdo_stream_framerate = 30.0;
-    // The vdo channel to be used
-    // When using VAPIX and rtsp the camera parameter normally corresponds
-    // to the channel number here.
-    unsigned int vdo_channel = 1;
-
-    // The buffer count will affect memory consumption so keep it as low
-    // as possible
-    unsigned int vdo_stream_buffer_count = 2;
+/**
+ * @brief Crop the next inference of a provider to the region that changed, or the whole frame.
+ */
+static void set_motion_crop(model_provider_t* provider, const motion_gate_t* gate) {
+    img_info_t model_metadata   = model_provider_get_model_metadata(provider);
+    motion_gate_region_t region = {0, 0, gate->width, gate->height};
 
-    // Set to false if e.g a view area is wanted instead of the whole sensor
-    bool fetch_from_whole_sensor = true;
+    motion_gate_get_region(gate, model_metadata.width, model_metadata.height, &region);
+    model_provider_set_crop(provider, region.x, region.y, region.width, region.height);
+}
 
-    if (fetch_from_whole_sensor) {
-        // Currently only take from the first input channel
-        vdo_channel = channel_util_get_first_input_channel();
-    }
+/**
+ * @brief Create the stream of a channel and set up the input of its model provider.
+ *
+ * @param gate_params Parameters of the motion gate of the channel, NULL for no gate.
+ * @param gate        Set to the motion gate of the channel.
+ *
+ * @return The stream, or NULL if the stream info could not be fetched, then error is set.
+ */
+static VdoStream* create_channel_stream(unsigned int vdo_channel,
+                                        model_provider_t* provider,
+                                        unsigned int num_buffers,
+                                        const char* image_fit,
+                                        double framerate,
+                                        const motion_gate_params_t* gate_params,
+                                        motion_gate_t** gate,
+                                        GError** error) {
+    img_info_t model_metadata = model_provider_get_model_metadata(provider);
 
     // Get the current global rotation and print
     uint32_t rotation = channel_util_get_image_rotation(vdo_channel);
@@ -203,137 +221,292 @@ int main(int argc, char** argv) {
                                                &model_metadata.format)) {
         panic("%s: Could not chose a resolution", __func__);
     }
-    vdo_stream = create_new_vdo_stream(vdo_channel,
-                                       model_metadata.format,
-                                       chosen_req,
-                                       vdo_stream_buffer_count,
-                                       image_fit,
-                                       vdo_stream_framerate);
-    if (!vdo_stream) {
-        return handle_vdo_failed(vdo_error);
-    }
-    vdo_stream_info = vdo_stream_get_info(vdo_stream, &vdo_error);
+    g_autoptr(VdoStream) vdo_stream = create_new_vdo_stream(vdo_channel,
+                                                            model_metadata.format,
+                                                            chosen_req,
+                                                            num_buffers,
+                                                            image_fit,
+                                                            framerate);
+    g_autoptr(VdoMap) vdo_stream_info = vdo_stream_get_info(vdo_stream, error);
     if (!vdo_stream_info) {
-        return handle_vdo_failed(vdo_error);
+        return NULL;
     }
     VdoPair32u aspect_ratio_def = {.w = 0u, .h = 0u};
     VdoPair32u stream_ar = vdo_map_get_pair32u(vdo_stream_info, "aspect_ratio", aspect_ratio_def);
-    syslog(LOG_INFO, "Stream aspect ratio is %u:%u", stream_ar.w, stream_ar.h);
+    syslog(LOG_INFO,
+           "[Channel %u] Stream aspect ratio is %u:%u",
+           vdo_channel,
+           stream_ar.w,
+           stream_ar.h);
 
-    image_framerate.wanted_framerate = vdo_stream_framerate;
-    double info_framerate = vdo_map_get_double(vdo_stream_info, "framerate", vdo_stream_framerate);
-    image_framerate.frametime = (unsigned int)((1.0 / info_framerate) * 1000.0);
+    // Use the vdo info map to update the model metadata
+    model_provider_update_image_metadata(provider, vdo_stream_info);
 
-    int fd = vdo_stream_get_fd(vdo_stream, &vdo_error);
-    if (fd < 0) {
-        return handle_vdo_failed(vdo_error);
+    if (gate_params) {
+        *gate = motion_gate_new(vdo_stream_info, gate_params);
+        if (!*gate) {
+            panic("%s: Could not create motion gate", __func__);
+        }
     }
-    struct pollfd fds = {
-        .fd     = fd,
-        .events = POLL_IN,
-    };
 
-    if (!vdo_stream_start(vdo_stream, &vdo_error)) {
-        return handle_vdo_failed(vdo_error);
+    return g_steal_pointer(&vdo_stream);
+}
+
+/**
+ * @brief Main function that starts a stream with different options.
+ */
+int main(int argc, char** argv) {
+    char* device_name                                         = argv[1];
+    char* model_file                                          = argv[2];
+    char* image_fit                                           = argv[3];
+    g_autoptr(GError) vdo_error                               = NULL;
+    model_provider_t* model_providers[SCHEDULER_MAX_CHANNELS] = {NULL};
+    VdoStream* vdo_streams[SCHEDULER_MAX_CHANNELS]            = {NULL};
+    model_tensor_output_t* tensor_outputs                     = NULL;
+    inference_scheduler_t* scheduler                          = NULL;
+    motion_gate_t* motion_gates[SCHEDULER_MAX_CHANNELS]       = {NULL};
+    frame_latency_t latencies[SCHEDULER_MAX_CHANNELS]         = {0};
+    unsigned int num_channels                                 = 0;
+
+    // Stop main loop at signal
+    signal(SIGTERM, shutdown);
+    signal(SIGINT, shutdown);
+
+    syslog(LOG_INFO, "Starting %s", argv[0]);
+
+    if (argc != 4) {
+        syslog(LOG_ERR,
+               "Invalid number of arguments. Required arguments are: "
+               "DEVICENAME MODEL_PATH IMAGEFIT");
+        goto end;
     }
-    syslog(LOG_INFO, "Start fetching video frames from VDO");
 
-    // Use the vdo info map to update the model metadata
-    model_provider_update_image_metadata(model_provider, vdo_stream_info);
+    // The vdo channels to be used
+    // When using VAPIX and rtsp the camera parameter normally corresponds
+    // to the channel number here.
+    unsigned int vdo_channels[SCHEDULER_MAX_CHANNELS] = {1};
+    num_channels                                      = 1;
 
-    while (running) {
-        struct timeval start_ts, end_ts;
-        unsigned int inference_ms = 0;
+    // Set to false if e.g a view area is wanted instead of the whole sensor
+    bool fetch_from_whole_sensor = true;
 
-        int status = 0;
-        do {
-            // If poll returns -1 then errno is set
-            // if the errno is set to EINTR then just
-            // continue this loop
-            status = poll(&fds, 1, -1);
-        } while (status == -1 && errno == EINTR);
+    if (fetch_from_whole_sensor) {
+        // Run inference on every sensor of multi-sensor cameras
+        num_channels = channel_util_get_input_channels(vdo_channels, SCHEDULER_MAX_CHANNELS);
+    }
 
-        if (status < 0) {
-            panic("Failed to poll with status %d", status);
-        }
+    // The first channel gets twice the inference time of the others when
+    // the channels compete, and runs at a higher framerate. The framerates
+    // are the highest ones, they are lowered if the inference is too slow.
+    const double channel_weights[SCHEDULER_MAX_CHANNELS]    = {2.0, 1.0, 1.0, 1.0};
+    const double channel_framerates[SCHEDULER_MAX_CHANNELS] = {30.0, 10.0, 10.0, 10.0};
+
+    // Skip inference on frames where nothing has changed since the last
+    // inference, which lets the DLPU idle on quiet scenes. Set to false to
+    // run inference on every frame.
+    bool use_motion_gate = true;
+    // Only run inference on the region that has changed instead of the whole
+    // frame, when the stream is preprocessed
+    bool crop_to_motion                    = false;
+    const motion_gate_params_t gate_params = {
+        .threshold   = 12,
+        .min_changed = 0.002f,
+        .max_skipped = 30,
+    };
 
-        g_autoptr(VdoBuffer) vdo_buf = vdo_stream_get_buffer(vdo_stream, &vdo_error);
-        if (!vdo_buf && g_error_matches(vdo_error, VDO_ERROR, VDO_ERROR_NO_DATA)) {
-            g_clear_error(&vdo_error);
-            continue;
-        }
-        if (!vdo_buf) {
+    // Results should be delivered within 100 ms of the capture. A frame that
+    // has already waited that long is dropped before the inference.
+    const frame_latency_params_t latency_params = {
+        .budget_ms        = 100,
+        .max_queue_age_ms = 100,
+        .log_interval_s   = 10,
+    };
+
+    // Start by loading the model and get the model metadata. The model is
+    // only loaded once, the providers of the other channels share it.
+    size_t number_output_tensors = 0;
+    model_providers[0] = model_provider_new(model_file, device_name, &number_output_tensors);
+    if (!model_providers[0]) {
+        panic("%s: Could not create model provider", __func__);
+    }
+    // A batched model has one slot per channel
+    if (model_providers[0]->batch_size > 1 && num_channels > model_providers[0]->batch_size) {
+        syslog(LOG_INFO,
+               "Only using the first %u of %u channels, the batch size of the model",
+               model_providers[0]->batch_size,
+               num_channels);
+        num_channels = model_providers[0]->batch_size;
+    }
+    for (unsigned int i = 1; i < num_channels; i++) {
+        model_providers[i] = model_provider_new_shared(model_providers[0], &number_output_tensors);
+    }
+
+    tensor_outputs = calloc(number_output_tensors, sizeof(model_tensor_output_t));
+    if (!tensor_outputs) {
+        panic("%s: Could not allocate tensor outputs", __func__);
+    }
+
+    scheduler = inference_scheduler_new();
+    if (!scheduler) {
+        panic("%s: Could not create inference scheduler", __func__);
+    }
+
+    // The frames of each channel are shared with other consumers through a
+    // frame fanout, so capture and scaling are only done once. Inference only
+    // wants the newest frame, so its queue holds a single frame.
+    // The buffer count will affect memory consumption so keep it as low
+    // as possible
+    unsigned int inference_queue_depth   = 1;
+    unsigned int vdo_stream_buffer_count = frame_fanout_buffer_count(&inference_queue_depth, 1);
+
+    for (unsigned int i = 0; i < num_channels; i++) {
+        vdo_streams[i] = create_channel_stream(vdo_channels[i],
+                                               model_providers[i],
+                                               vdo_stream_buffer_count,
+                                               image_fit,
+                                               channel_framerates[i],
+                                               use_motion_gate ? &gate_params : NULL,
+                                               &motion_gates[i],
+                                               &vdo_error);
+        if (!vdo_streams[i]) {
             return handle_vdo_failed(vdo_error);
         }
-        gettimeofday(&start_ts, NULL);
-        // Run inference and preprocessing if needed
-        if (!model_run_inference(model_provider, vdo_buf)) {
-            if (!img_util_flush(vdo_stream, &vdo_buf, &vdo_error)) {
+        if (!inference_scheduler_add_channel(scheduler,
+                                             vdo_channels[i],
+                                             vdo_streams[i],
+                                             model_providers[i],
+                                             channel_weights[i],
+                                             channel_framerates[i])) {
+            panic("%s: Could not add channel %u to the scheduler", __func__, vdo_channels[i]);
+        }
+        frame_latency_init(&latencies[i], &latency_params, vdo_channels[i]);
+    }
+
+    if (!inference_scheduler_start(scheduler, &vdo_error)) {
+        return handle_vdo_failed(vdo_error);
+    }
+    syslog(LOG_INFO, "Start fetching video frames from VDO on %u channels", num_channels);
+
+    // A model with a batch dimension larger than 1 runs the frames of several
+    // channels in one job
+    unsigned int batch_size = MAX(model_providers[0]->batch_size, 1u);
+
+    while (running) {
+        struct timeval start_ts, end_ts;
+        unsigned int inference_ms = 0;
+        bool inference_ok         = false;
+        scheduler_channel_t* channels[SCHEDULER_MAX_CHANNELS];
+        frame_ref_t* frames[SCHEDULER_MAX_CHANNELS];
+
+        // Wake up regularly to check if the application should stop
+        unsigned int num_jobs = inference_scheduler_next_batch(scheduler,
+                                                               100,
+                                                               batch_size,
+                                                               channels,
+                                                               frames,
+                                                               &vdo_error);
+        if (num_jobs == 0) {
+            if (vdo_error) {
                 return handle_vdo_failed(vdo_error);
             }
             continue;
         }
-        gettimeofday(&end_ts, NULL);
-        inference_ms = (unsigned int)(((end_ts.tv_sec - start_ts.tv_sec) * 1000) +
-                                      ((end_ts.tv_usec - start_ts.tv_usec) / 1000));
-        syslog(LOG_INFO, "Ran inference for %u ms", inference_ms);
-
-        if (number_output_tensors == 2) {
-            // Only parse if the number outputs are == 2
-            //  When a model with a different amount of output tensors is used, we don't want the
-            //  application to crash during parsing.
-            for (size_t i = 0; i < number_output_tensors; i++) {
-                if (!model_get_tensor_output_info(model_provider, i, &tensor_outputs[i])) {
-                    panic("Failed to get output tensor info for %zu", i);
-                }
-            }
-            // The tensor_outputs contains
-            // data -  The tensor data
-            // size -  Tensor data size
-            // datatype -  Datatype of the tensor
-            // timestamp - The timestamp of the VDO frame used for inference
-
-            // Parse the data.
-            // Model output differs between the CV25 model and the other models.
-            // The CV25 model has car data at output 0 and person data at output 1.
-            // Also, the CV25 model directly outputs float32 data, while the other models' outputs
-            // are uint8 quantized.
-            if (strcmp(device_name, "ambarella-cvflow") == 0) {
-                float* car_pred    = (float*)tensor_outputs[0].data;
-                float* person_pred = (float*)tensor_outputs[1].data;
 
-                syslog(LOG_INFO,
-                       "Person detected: %.2f%% - Car detected: %.2f%%",
-                       *person_pred * 100,
-                       *car_pred * 100);
-            } else {
-                uint8_t* person_pred = (uint8_t*)tensor_outputs[0].data;
-                uint8_t* car_pred    = (uint8_t*)tensor_outputs[1].data;
-                syslog(LOG_INFO,
-                       "Person detected: %.2f%% - Car detected: %.2f%%",
-                       (float)*person_pred / 2.55f,
-                       (float)*car_pred / 2.55f);
+        // Drop the frames that are too old to give a result in time, and the
+        // frames that have not changed, the channels can take the next frame
+        // when it is due
+        unsigned int num_changed = 0;
+        for (unsigned int i = 0; i < num_jobs; i++) {
+            size_t channel_index = (size_t)(channels[i] - scheduler->channels);
+            motion_gate_t* gate  = motion_gates[channel_index];
+            uint64_t timestamp   = frame_latency_timestamp(frames[i]->buffer);
+            if (!frame_latency_check_age(&latencies[channel_index], timestamp)) {
+                inference_scheduler_done(scheduler, channels[i], frames[i], 0);
+                continue;
+            }
+            if (gate && !motion_gate_check(gate, frames[i]->buffer)) {
+                inference_scheduler_done(scheduler, channels[i], frames[i], 0);
+                continue;
+            }
+            if (gate && crop_to_motion) {
+                set_motion_crop(channels[i]->provider, gate);
             }
+            channels[num_changed] = channels[i];
+            frames[num_changed]   = frames[i];
+            num_changed++;
+        }
+        num_jobs = num_changed;
+        if (num_jobs == 0) {
+            continue;
         }
 
-        // Check if the framerate from vdo should be changed
-        if (img_util_update_framerate(vdo_stream, &image_framerate, inference_ms)) {
-            if (!img_util_flush(vdo_stream, &vdo_buf, &vdo_error)) {
-                return handle_vdo_failed(vdo_error);
+        gettimeofday(&start_ts, NULL);
+        // Run inference and preprocessing if needed
+        if (batch_size > 1) {
+            model_provider_t* batch_providers[SCHEDULER_MAX_CHANNELS];
+            VdoBuffer* batch_buffers[SCHEDULER_MAX_CHANNELS];
+            for (unsigned int i = 0; i < num_jobs; i++) {
+                batch_providers[i] = channels[i]->provider;
+                batch_buffers[i]   = frames[i]->buffer;
             }
+            inference_ok = model_run_batch_inference(model_providers[0],
+                                                     batch_providers,
+                                                     batch_buffers,
+                                                     num_jobs);
         } else {
-            // This will allow vdo to fill this buffer with data again
-            if (!vdo_stream_buffer_unref(vdo_stream, &vdo_buf, &vdo_error)) {
-                if (!vdo_error_is_expected(&vdo_error)) {
-                    panic("%s: Unexpected error: %s", __func__, vdo_error->message);
-                }
-                g_clear_error(&vdo_error);
+            inference_ok = model_run_inference(channels[0]->provider, frames[0]->buffer);
+        }
+        if (inference_ok) {
+            gettimeofday(&end_ts, NULL);
+            inference_ms = (unsigned int)(((end_ts.tv_sec - start_ts.tv_sec) * 1000) +
+                                          ((end_ts.tv_usec - start_ts.tv_usec) / 1000));
+            syslog(LOG_INFO, "Ran inference on %u channels for %u ms", num_jobs, inference_ms);
+        }
+
+        for (unsigned int i = 0; i < num_jobs; i++) {
+            frame_latency_t* latency = &latencies[channels[i] - scheduler->channels];
+            if (inference_ok) {
+                print_result(channels[i]->channel_id,
+                             channels[i]->provider,
+                             device_name,
+                             tensor_outputs,
+                             number_output_tensors);
+
+                // The outputs carry the timestamp of the frame they were computed from
+                model_tensor_output_t output;
+                model_get_tensor_output_info(channels[i]->provider, 0, &output);
+                uint64_t latency_us = frame_latency_record(latency, output.timestamp);
+                syslog(LOG_INFO,
+                       "[Channel %u] Result delivered %llu ms after capture",
+                       channels[i]->channel_id,
+                       (unsigned long long)(latency_us / 1000));
             }
+            frame_latency_log_periodic(latency);
+            // Let the scheduler check if the framerate from vdo should be
+            // changed, and release the frame. The queue of the consumer only
+            // holds the newest frame, so old frames do not need to be flushed
+            // when the framerate is lowered.
+            inference_scheduler_done(scheduler, channels[i], frames[i], inference_ms);
         }
     }
 end:
-    if (model_provider) {
-        model_provider_destroy(model_provider);
+    for (unsigned int i = 0; i < num_channels && scheduler; i++) {
+        frame_latency_log(&latencies[i]);
+    }
+    inference_scheduler_destroy(scheduler);
+    for (unsigned int i = 0; i < num_channels; i++) {
+        motion_gate_destroy(motion_gates[i]);
+    }
+    for (unsigned int i = 0; i < num_channels; i++) {
+        if (vdo_streams[i]) {
+            g_object_unref(vdo_streams[i]);
+        }
+    }
+    // The first provider owns the model that the others share, so it is destroyed last
+    for (unsigned int i = num_channels; i > 0; i--) {
+        if (model_providers[i - 1]) {
+            model_provider_destroy(model_providers[i - 1]);
+        }
     }
     free(tensor_outputs);
 
@@ -0,0 +1,227 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cl_autotune.h"
+
+#include <glib.h>
+#include <syslog.h>
+
+#define CACHE_GROUP "LocalWorkSize"
+
+/* Candidates are powers of two up to this size in each dimension */
+#define MAX_LOCAL_SIZE 32
+
+/* Number of timed runs per candidate, after one warm-up run */
+#define NUM_RUNS 10
+
+typedef struct tune_context {
+    cl_command_queue queue;
+    cl_kernel kernel;
+    const size_t* global_work_offset;
+    const size_t* global_work_size;
+    int local_mem_arg;
+    cl_autotune_local_mem_func local_mem_size;
+    size_t max_work_group_size;
+    cl_ulong max_local_mem_size;
+} tune_context_t;
+
+/* Check that a local work size may be used with the kernel and global work size */
+static gboolean is_valid(const tune_context_t* ctx, const size_t local_work_size[2]) {
+    for (int i = 0; i < 2; i++) {
+        if (local_work_size[i] == 0 || ctx->global_work_size[i] % local_work_size[i] != 0)
+            return FALSE;
+    }
+    if (local_work_size[0] * local_work_size[1] > ctx->max_work_group_size)
+        return FALSE;
+    if (ctx->local_mem_size && ctx->local_mem_size(local_work_size) > ctx->max_local_mem_size)
+        return FALSE;
+    return TRUE;
+}
+
+static cl_int set_local_mem_arg(const tune_context_t* ctx, const size_t local_work_size[2]) {
+    if (ctx->local_mem_arg < 0)
+        return CL_SUCCESS;
+    return clSetKernelArg(ctx->kernel,
+                          (cl_uint)ctx->local_mem_arg,
+                          ctx->local_mem_size(local_work_size),
+                          NULL);
+}
+
+static cl_int enqueue_runs(const tune_context_t* ctx, const size_t local_work_size[2], int runs) {
+    cl_int ret = CL_SUCCESS;
+    for (int i = 0; i < runs && ret == CL_SUCCESS; i++) {
+        ret = clEnqueueNDRangeKernel(ctx->queue,
+                                     ctx->kernel,
+                                     2,
+                                     ctx->global_work_offset,
+                                     ctx->global_work_size,
+                                     local_work_size,
+                                     0,
+                                     NULL,
+                                     NULL);
+    }
+    cl_int finish_ret = clFinish(ctx->queue);
+    return ret != CL_SUCCESS ? ret : finish_ret;
+}
+
+/*
+ * Time a candidate. Returns the mean run time in microseconds, or a negative
+ * value if the candidate could not be run, e.g. due to lack of resources.
+ */
+static gint64 time_candidate(const tune_context_t* ctx, const size_t local_work_size[2]) {
+    if (set_local_mem_arg(ctx, local_work_size) != CL_SUCCESS)
+        return -1;
+
+    /* The first run may include one-time costs such as caching the kernel binary */
+    if (enqueue_runs(ctx, local_work_size, 1) != CL_SUCCESS)
+        return -1;
+
+    gint64 start = g_get_monotonic_time();
+    if (enqueue_runs(ctx, local_work_size, NUM_RUNS) != CL_SUCCESS)
+        return -1;
+    return (g_get_monotonic_time() - start) / NUM_RUNS;
+}
+
+static gboolean load_cached(const tune_context_t* ctx,
+                            const char* cache_path,
+                            const char* cache_key,
+                            size_t local_work_size[2]) {
+    GKeyFile* key_file = g_key_file_new();
+    gboolean found     = FALSE;
+
+    if (g_key_file_load_from_file(key_file, cache_path, G_KEY_FILE_NONE, NULL)) {
+        gsize length = 0;
+        gint* values =
+            g_key_file_get_integer_list(key_file, CACHE_GROUP, cache_key, &length, NULL);
+        if (values && length == 2 && values[0] > 0 && values[1] > 0) {
+            size_t cached[2] = {(size_t)values[0], (size_t)values[1]};
+            /* A stored size may no longer fit, e.g. after a driver update */
+            if (is_valid(ctx, cached) && set_local_mem_arg(ctx, cached) == CL_SUCCESS) {
+                local_work_size[0] = cached[0];
+                local_work_size[1] = cached[1];
+                found              = TRUE;
+            }
+        }
+        g_free(values);
+    }
+
+    g_key_file_free(key_file);
+    return found;
+}
+
+static void store_cached(const char* cache_path,
+                         const char* cache_key,
+                         const size_t local_work_size[2]) {
+    GKeyFile* key_file = g_key_file_new();
+    GError* error      = NULL;
+
+    /* Keep the results stored for other settings */
+    g_key_file_load_from_file(key_file, cache_path, G_KEY_FILE_KEEP_COMMENTS, NULL);
+
+    gint values[2] = {(gint)local_work_size[0], (gint)local_work_size[1]};
+    g_key_file_set_integer_list(key_file, CACHE_GROUP, cache_key, values, 2);
+    if (!g_key_file_save_to_file(key_file, cache_path, &error)) {
+        syslog(LOG_WARNING, "Unable to store local work size: %s", error->message);
+        g_clear_error(&error);
+    }
+
+    g_key_file_free(key_file);
+}
+
+int cl_autotune_local_work_size(cl_command_queue queue,
+                                cl_kernel kernel,
+                                const size_t global_work_offset[2],
+                                const size_t global_work_size[2],
+                                int local_mem_arg,
+                                cl_autotune_local_mem_func local_mem_size,
+                                const char* cache_path,
+                                const char* cache_key,
+                                size_t local_work_size[2]) {
+    tune_context_t ctx = {
+        .queue              = queue,
+        .kernel             = kernel,
+        .global_work_offset = global_work_offset,
+        .global_work_size   = global_work_size,
+        .local_mem_arg      = local_mem_arg,
+        .local_mem_size     = local_mem_arg < 0 ? NULL : local_mem_size,
+    };
+
+    cl_device_id device;
+    cl_int ret = clGetCommandQueueInfo(queue, CL_QUEUE_DEVICE, sizeof(device), &device, NULL);
+    ret |= clGetKernelWorkGroupInfo(kernel,
+                                    device,
+                                    CL_KERNEL_WORK_GROUP_SIZE,
+                                    sizeof(ctx.max_work_group_size),
+                                    &ctx.max_work_group_size,
+                                    NULL);
+    ret |= clGetDeviceInfo(device,
+                           CL_DEVICE_LOCAL_MEM_SIZE,
+                           sizeof(ctx.max_local_mem_size),
+                           &ctx.max_local_mem_size,
+                           NULL);
+    if (ret != CL_SUCCESS) {
+        syslog(LOG_ERR, "Unable to get work-group limits: %d", ret);
+        return -1;
+    }
+
+    if (load_cached(&ctx, cache_path, cache_key, local_work_size)) {
+        syslog(LOG_INFO,
+               "Using stored local work size %zux%zu for %s",
+               local_work_size[0],
+               local_work_size[1],
+               cache_key);
+        return 0;
+    }
+
+    size_t best[2]   = {0, 0};
+    gint64 best_time = G_MAXINT64;
+    for (size_t size0 = 1; size0 <= MAX_LOCAL_SIZE; size0 *= 2) {
+        for (size_t size1 = 1; size1 <= MAX_LOCAL_SIZE; size1 *= 2) {
+            size_t candidate[2] = {size0, size1};
+            if (!is_valid(&ctx, candidate))
+                continue;
+
+            gint64 time = time_candidate(&ctx, candidate);
+            if (time >= 0 && time < best_time) {
+                best[0]   = size0;
+                best[1]   = size1;
+                best_time = time;
+            }
+        }
+    }
+
+    if (best[0] == 0) {
+        syslog(LOG_ERR, "No local work size could be run for %s", cache_key);
+        return -1;
+    }
+
+    /* Leave the __local argument set for the chosen size */
+    if (set_local_mem_arg(&ctx, best) != CL_SUCCESS) {
+        syslog(LOG_ERR, "Unable to set __local kernel argument");
+        return -1;
+    }
+
+    syslog(LOG_INFO,
+           "Chose local work size %zux%zu for %s, %" G_GINT64_FORMAT " us per run",
+           best[0],
+           best[1],
+           cache_key,
+           best_time);
+    local_work_size[0] = best[0];
+    local_work_size[1] = best[1];
+    store_cached(cache_path, cache_key, local_work_size);
+    return 0;
+}
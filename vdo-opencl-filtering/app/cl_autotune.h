@@ -0,0 +1,65 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Autotuning of the local work size of a 2D OpenCL kernel.
+ *
+ * The fastest local work size depends on the GPU, the kernel and the global
+ * work size, which follows the resolution and rotation of the stream. Every
+ * candidate that evenly divides the global work size is timed, and the fastest
+ * one is stored in a key file. Later runs with the same cache key read the
+ * stored size instead of running the benchmark again.
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+#define CL_TARGET_OPENCL_VERSION 120
+#include <CL/cl.h>
+
+/* Size in bytes of a __local kernel argument for a local work size */
+typedef size_t (*cl_autotune_local_mem_func)(const size_t local_work_size[2]);
+
+/**
+ * @brief Find the local work size with the shortest kernel run time.
+ *
+ * All kernel arguments must be set, except an optional __local argument that
+ * depends on the local work size. That argument is set for each candidate, and
+ * is left set for the chosen local work size.
+ *
+ * @param queue              Command queue to time the kernel on.
+ * @param kernel             Kernel to tune.
+ * @param global_work_offset Global work offset used when enqueuing the kernel.
+ * @param global_work_size   Global work size used when enqueuing the kernel.
+ * @param local_mem_arg      Index of the __local argument, or -1 if there is none.
+ * @param local_mem_size     Size of the __local argument, NULL if there is none.
+ * @param cache_path         Key file with stored results, created if missing.
+ * @param cache_key          Name of the settings the result is valid for, e.g.
+ *                           the kernel, resolution and rotation.
+ * @param local_work_size    Set to the chosen local work size.
+ *
+ * @return 0 on success, -1 if no candidate could be run.
+ */
+int cl_autotune_local_work_size(cl_command_queue queue,
+                                cl_kernel kernel,
+                                const size_t global_work_offset[2],
+                                const size_t global_work_size[2],
+                                int local_mem_arg,
+                                cl_autotune_local_mem_func local_mem_size,
+                                const char* cache_path,
+                                const char* cache_key,
+                                size_t local_work_size[2]);
@@ -0,0 +1,367 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "filter_graph.h"
+
+#include <glib.h>
+#include <string.h>
+#include <syslog.h>
+
+#include "cl_autotune.h"
+
+/* Index of the __local tile argument of the tiled kernels */
+#define TILE_ARG 5
+
+/*
+ * The kernels reading the last row also read the row after it, and the last
+ * columns are read with vector loads, so the buffers between the stages are
+ * padded with a row and a vector.
+ */
+#define INTERMEDIATE_PADDING(width) ((width) + 16)
+
+/* Kernels that can be fused into the kernel before them */
+typedef struct pointwise_op {
+    const char* kernel_name;
+    /* Function applied to the luma of the kernel before */
+    const char* function;
+    /* Define that holds the parameter */
+    const char* param_define;
+} pointwise_op_t;
+
+static const pointwise_op_t pointwise_ops[] = {
+    {"threshold", "threshold_op", "THRESHOLD"},
+};
+
+static const pointwise_op_t* find_pointwise_op(const char* kernel_name) {
+    for (size_t i = 0; i < G_N_ELEMENTS(pointwise_ops); i++) {
+        if (strcmp(pointwise_ops[i].kernel_name, kernel_name) == 0)
+            return &pointwise_ops[i];
+    }
+    return NULL;
+}
+
+/* Size of the __local tile of the tiled kernels, see sobel_nv12.cl */
+static size_t tile_size(const size_t local_size[2]) {
+    return (local_size[0] + 2) * (local_size[1] + 1) * 8;
+}
+
+static cl_program build_program(cl_context context,
+                                cl_device_id device,
+                                const char* source,
+                                const char* options) {
+    cl_int ret;
+    cl_program program = clCreateProgramWithSource(context, 1, &source, NULL, &ret);
+    if (ret != CL_SUCCESS) {
+        syslog(LOG_ERR, "Could not create cl program");
+        return NULL;
+    }
+
+    ret = clBuildProgram(program, 1, &device, options, NULL, NULL);
+    if (ret != CL_SUCCESS) {
+        syslog(LOG_ERR, "Could not build cl_program with options \"%s\"", options);
+
+        if (ret == CL_BUILD_PROGRAM_FAILURE) {
+            /* Determine the size of the program log */
+            size_t log_size;
+            clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_LOG, 0, NULL, &log_size);
+            /* Allocate memory for the program log */
+            char* log = (char*)malloc(log_size);
+
+            /* Get the program log */
+            clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_LOG, log_size, log, NULL);
+
+            /* Print the program log */
+            syslog(LOG_INFO, "%s", log);
+            free(log);
+        }
+        clReleaseProgram(program);
+        return NULL;
+    }
+    return program;
+}
+
+/* Build the program of a stage and check if its kernel takes a __local tile */
+static int build_stage(filter_stage_t* stage,
+                       cl_context context,
+                       cl_device_id device,
+                       const char* source,
+                       const char* options) {
+    cl_int ret;
+
+    stage->program = build_program(context, device, source, options);
+    if (!stage->program)
+        return -1;
+
+    cl_kernel kernel = clCreateKernel(stage->program, stage->kernel_name, &ret);
+    if (ret != CL_SUCCESS) {
+        syslog(LOG_ERR, "Could not create cl kernel %s: %d", stage->kernel_name, ret);
+        return -1;
+    }
+
+    cl_uint num_args = 0;
+    ret = clGetKernelInfo(kernel, CL_KERNEL_NUM_ARGS, sizeof(num_args), &num_args, NULL);
+    clReleaseKernel(kernel);
+    if (ret != CL_SUCCESS) {
+        syslog(LOG_ERR, "Unable to get kernel info: %d", ret);
+        return -1;
+    }
+
+    /* This is the default setting for local_work_size, used until the graph is tuned */
+    stage->local_work_size[0] = 8;
+    stage->local_work_size[1] = 4;
+    stage->local_mem_size     = num_args > TILE_ARG ? tile_size(stage->local_work_size) : 0;
+    return 0;
+}
+
+filter_graph_t* filter_graph_new(cl_context context,
+                                 cl_device_id device,
+                                 cl_command_queue queue,
+                                 const char* source,
+                                 const filter_graph_op_t* ops,
+                                 size_t num_ops,
+                                 unsigned width,
+                                 unsigned height,
+                                 const size_t global_work_offset[2],
+                                 const size_t global_work_size[2]) {
+    cl_int ret;
+
+    if (num_ops == 0) {
+        syslog(LOG_ERR, "A filter graph needs at least one filter");
+        return NULL;
+    }
+
+    filter_graph_t* graph = g_new0(filter_graph_t, 1);
+    graph->width          = width;
+    graph->height         = height;
+    memcpy(graph->global_work_offset, global_work_offset, sizeof(graph->global_work_offset));
+    memcpy(graph->global_work_size, global_work_size, sizeof(graph->global_work_size));
+
+    /* Group the filters into stages, a pointwise filter joins the stage before it */
+    GString* options[FILTER_GRAPH_MAX_STAGES]                = {NULL};
+    const pointwise_op_t* stage_ops[FILTER_GRAPH_MAX_STAGES] = {NULL};
+    for (size_t i = 0; i < num_ops; i++) {
+        const pointwise_op_t* op = find_pointwise_op(ops[i].kernel_name);
+
+        /* A stage can hold one fused operation, whose define is not used by the stage */
+        if (op && graph->num_stages > 0) {
+            size_t last               = graph->num_stages - 1;
+            const pointwise_op_t* own = stage_ops[last];
+            if (!graph->stages[last].fused_op &&
+                (!own || strcmp(own->param_define, op->param_define) != 0)) {
+                graph->stages[last].fused_op = op->function;
+                g_string_append_printf(options[last],
+                                       " -DPOST_OP=%s -D%s=%d",
+                                       op->function,
+                                       op->param_define,
+                                       ops[i].param);
+                continue;
+            }
+        }
+
+        if (graph->num_stages == FILTER_GRAPH_MAX_STAGES) {
+            syslog(LOG_ERR, "Too many filter stages, at most %d", FILTER_GRAPH_MAX_STAGES);
+            goto error;
+        }
+        size_t index                     = graph->num_stages++;
+        graph->stages[index].kernel_name = g_strdup(ops[i].kernel_name);
+        stage_ops[index]                 = op;
+        options[index]                   = g_string_new("");
+        if (op)
+            g_string_append_printf(options[index], "-D%s=%d", op->param_define, ops[i].param);
+    }
+
+    for (size_t i = 0; i < graph->num_stages; i++) {
+        filter_stage_t* stage = &graph->stages[i];
+        if (build_stage(stage, context, device, source, options[i]->str))
+            goto error;
+        syslog(LOG_INFO,
+               "Filter stage %zu: %s%s%s",
+               i,
+               stage->kernel_name,
+               stage->fused_op ? " fused with " : "",
+               stage->fused_op ? stage->fused_op : "");
+    }
+
+    /* Allocate the buffers between the stages, never mapped to the CPU */
+    size_t intermediate_size = (size_t)width * height + INTERMEDIATE_PADDING(width);
+    for (size_t i = 0; i < 2 && i + 1 < graph->num_stages; i++) {
+        graph->intermediates[i] =
+            clCreateBuffer(context, CL_MEM_READ_WRITE, intermediate_size, NULL, &ret);
+        if (ret != CL_SUCCESS) {
+            syslog(LOG_ERR, "Unable to create intermediate cl memory object: %d", ret);
+            graph->intermediates[i] = NULL;
+            goto error;
+        }
+
+        /* The kernels do not write the first row and column, keep them black */
+        const cl_uchar zero = 0;
+
+        ret = clEnqueueFillBuffer(queue,
+                                  graph->intermediates[i],
+                                  &zero,
+                                  sizeof(zero),
+                                  0,
+                                  intermediate_size,
+                                  0,
+                                  NULL,
+                                  NULL);
+        if (ret != CL_SUCCESS) {
+            syslog(LOG_ERR, "Unable to clear intermediate cl memory object: %d", ret);
+            goto error;
+        }
+    }
+
+    for (size_t i = 0; i < graph->num_stages; i++)
+        g_string_free(options[i], TRUE);
+    return graph;
+
+error:
+    for (size_t i = 0; i < graph->num_stages; i++)
+        g_string_free(options[i], TRUE);
+    filter_graph_free(graph);
+    return NULL;
+}
+
+void filter_graph_free(filter_graph_t* graph) {
+    if (!graph)
+        return;
+
+    for (size_t i = 0; i < graph->num_stages; i++) {
+        if (graph->stages[i].program)
+            clReleaseProgram(graph->stages[i].program);
+        g_free((gpointer)graph->stages[i].kernel_name);
+    }
+    for (size_t i = 0; i < 2; i++) {
+        if (graph->intermediates[i])
+            clReleaseMemObject(graph->intermediates[i]);
+    }
+    g_free(graph);
+}
+
+int filter_graph_tune(filter_graph_t* graph,
+                      cl_command_queue queue,
+                      cl_mem in_y,
+                      cl_mem out_y,
+                      cl_mem out_cbcr,
+                      const char* cache_path,
+                      const char* settings) {
+    filter_chain_t* chain = filter_chain_new(graph, in_y, out_y, out_cbcr);
+    if (!chain)
+        return -1;
+
+    for (size_t i = 0; i < graph->num_stages; i++) {
+        filter_stage_t* stage = &graph->stages[i];
+
+        /* The run time depends on the kernel and the fused operation, not its parameter */
+        gchar* cache_key = g_strdup_printf("%s%s%s-%s",
+                                           stage->kernel_name,
+                                           stage->fused_op ? "+" : "",
+                                           stage->fused_op ? stage->fused_op : "",
+                                           settings);
+
+        if (cl_autotune_local_work_size(queue,
+                                        chain->kernels[i],
+                                        graph->global_work_offset,
+                                        graph->global_work_size,
+                                        stage->local_mem_size ? TILE_ARG : -1,
+                                        tile_size,
+                                        cache_path,
+                                        cache_key,
+                                        stage->local_work_size))
+            syslog(LOG_WARNING,
+                   "Using default local work size %zux%zu for %s",
+                   stage->local_work_size[0],
+                   stage->local_work_size[1],
+                   cache_key);
+
+        if (stage->local_mem_size)
+            stage->local_mem_size = tile_size(stage->local_work_size);
+        g_free(cache_key);
+    }
+
+    filter_chain_free(chain);
+    return 0;
+}
+
+filter_chain_t* filter_chain_new(const filter_graph_t* graph,
+                                 cl_mem in_y,
+                                 cl_mem out_y,
+                                 cl_mem out_cbcr) {
+    cl_int ret;
+    filter_chain_t* chain = g_new0(filter_chain_t, 1);
+    chain->graph          = graph;
+
+    for (size_t i = 0; i < graph->num_stages; i++) {
+        const filter_stage_t* stage = &graph->stages[i];
+        gboolean last               = i + 1 == graph->num_stages;
+        cl_mem input                = i == 0 ? in_y : graph->intermediates[(i - 1) % 2];
+        cl_mem output               = last ? out_y : graph->intermediates[i % 2];
+
+        cl_kernel kernel = clCreateKernel(stage->program, stage->kernel_name, &ret);
+        if (ret != CL_SUCCESS) {
+            syslog(LOG_ERR, "Could not create cl kernel %s: %d", stage->kernel_name, ret);
+            filter_chain_free(chain);
+            return NULL;
+        }
+        chain->kernels[i] = kernel;
+
+        ret = clSetKernelArg(kernel, 0, sizeof(cl_mem), (void*)&input);
+        ret |= clSetKernelArg(kernel, 1, sizeof(cl_mem), (void*)&output);
+        ret |= clSetKernelArg(kernel, 2, sizeof(cl_mem), (void*)&out_cbcr);
+        ret |= clSetKernelArg(kernel, 3, sizeof(graph->width), &graph->width);
+        ret |= clSetKernelArg(kernel, 4, sizeof(graph->height), &graph->height);
+        if (stage->local_mem_size)
+            ret |= clSetKernelArg(kernel, TILE_ARG, stage->local_mem_size, NULL);
+        if (ret != CL_SUCCESS) {
+            syslog(LOG_ERR, "Unable to set kernel arguments: %d", ret);
+            filter_chain_free(chain);
+            return NULL;
+        }
+    }
+    return chain;
+}
+
+void filter_chain_free(filter_chain_t* chain) {
+    if (!chain)
+        return;
+
+    for (size_t i = 0; i < chain->graph->num_stages; i++) {
+        if (chain->kernels[i])
+            clReleaseKernel(chain->kernels[i]);
+    }
+    g_free(chain);
+}
+
+cl_int filter_chain_enqueue(const filter_chain_t* chain, cl_command_queue queue, cl_event* done) {
+    const filter_graph_t* graph = chain->graph;
+    cl_int ret                  = CL_SUCCESS;
+
+    /* The queue is in-order, so each stage starts when the stage before it has completed */
+    for (size_t i = 0; i < graph->num_stages && ret == CL_SUCCESS; i++) {
+        cl_event* event = i + 1 == graph->num_stages ? done : NULL;
+
+        ret = clEnqueueNDRangeKernel(queue,
+                                     chain->kernels[i],
+                                     2,
+                                     graph->global_work_offset,
+                                     graph->global_work_size,
+                                     graph->stages[i].local_work_size,
+                                     0,
+                                     NULL,
+                                     event);
+    }
+    return ret;
+}
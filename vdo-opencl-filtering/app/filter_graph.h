@@ -0,0 +1,149 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * A chain of OpenCL filter kernels applied to the luma of NV12 images.
+ *
+ * All kernels of the graph have the arguments of the sobel_nv12 program: the
+ * input luma, the output luma and chroma, the width and the height. The tiled
+ * kernels take a __local tile as a sixth argument, which the graph sets.
+ *
+ * The images between the kernels are stored in buffers owned by the graph,
+ * which are only accessed by the GPU and never mapped to the CPU. A pointwise
+ * operation, e.g. threshold, is fused into the kernel before it, such that its
+ * result is applied before the luma is stored instead of in a separate pass.
+ * All kernels of a frame are enqueued at once and only the last one signals an
+ * event, so the CPU does not wait between the passes.
+ *
+ * The command queue must be in-order, the buffers between the kernels are
+ * shared by all frames in flight.
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+#define CL_TARGET_OPENCL_VERSION 120
+#include <CL/cl.h>
+
+#define FILTER_GRAPH_MAX_STAGES 8
+
+/* A filter to add to the graph */
+typedef struct filter_graph_op {
+    const char* kernel_name;
+    /* Parameter of pointwise operations, e.g. the threshold, ignored by other kernels */
+    int param;
+} filter_graph_op_t;
+
+/* One or more filters, run as one kernel */
+typedef struct filter_stage {
+    const char* kernel_name;
+    /* Function of a pointwise operation fused into the kernel, or NULL */
+    const char* fused_op;
+    cl_program program;
+    size_t local_work_size[2];
+    /* Size of the __local tile argument, 0 if the kernel has none */
+    size_t local_mem_size;
+} filter_stage_t;
+
+typedef struct filter_graph {
+    unsigned width;
+    unsigned height;
+    size_t global_work_offset[2];
+    size_t global_work_size[2];
+    filter_stage_t stages[FILTER_GRAPH_MAX_STAGES];
+    size_t num_stages;
+    /* Luma between the stages, stage i writes to intermediates[i % 2] */
+    cl_mem intermediates[2];
+} filter_graph_t;
+
+/* The kernels of a graph bound to an input and output buffer */
+typedef struct filter_chain {
+    const filter_graph_t* graph;
+    cl_kernel kernels[FILTER_GRAPH_MAX_STAGES];
+} filter_chain_t;
+
+/**
+ * @brief Create a filter graph and build its kernels.
+ *
+ * Each stage is built from the program source, with the defines of its fused
+ * operation. The local work size of the stages is {8, 4} until the graph is
+ * tuned.
+ *
+ * @param context            OpenCL context.
+ * @param device             Device to build the kernels for.
+ * @param queue              In-order command queue the graph is enqueued to.
+ * @param source             Source of the OpenCL program with the kernels.
+ * @param ops                Filters in the order they are applied.
+ * @param num_ops            Number of filters.
+ * @param width              Width of the images.
+ * @param height             Height of the images.
+ * @param global_work_offset Global work offset of all kernels.
+ * @param global_work_size   Global work size of all kernels.
+ *
+ * @return Pointer to a new graph, or NULL on failure.
+ */
+filter_graph_t* filter_graph_new(cl_context context,
+                                 cl_device_id device,
+                                 cl_command_queue queue,
+                                 const char* source,
+                                 const filter_graph_op_t* ops,
+                                 size_t num_ops,
+                                 unsigned width,
+                                 unsigned height,
+                                 const size_t global_work_offset[2],
+                                 const size_t global_work_size[2]);
+
+void filter_graph_free(filter_graph_t* graph);
+
+/**
+ * @brief Choose the local work size of each stage, see cl_autotune.h.
+ *
+ * The stages are timed reading from in_y and writing to out_y and out_cbcr.
+ * Should be called before any chain is bound.
+ *
+ * @param settings Name of the settings the result is valid for, e.g. the
+ *                 resolution and rotation. Added to the cache key of each stage.
+ */
+int filter_graph_tune(filter_graph_t* graph,
+                      cl_command_queue queue,
+                      cl_mem in_y,
+                      cl_mem out_y,
+                      cl_mem out_cbcr,
+                      const char* cache_path,
+                      const char* settings);
+
+/**
+ * @brief Create the kernels of the graph with all arguments set.
+ *
+ * The output chroma is written by every stage, so out_cbcr is also passed to
+ * the stages that write to the buffers between the stages.
+ *
+ * @return Pointer to a new chain, or NULL on failure.
+ */
+filter_chain_t* filter_chain_new(const filter_graph_t* graph,
+                                 cl_mem in_y,
+                                 cl_mem out_y,
+                                 cl_mem out_cbcr);
+
+void filter_chain_free(filter_chain_t* chain);
+
+/**
+ * @brief Enqueue all kernels of the chain, without waiting for them.
+ *
+ * @param done Set to an event signaled when the last kernel has completed.
+ */
+cl_int filter_chain_enqueue(const filter_chain_t* chain, cl_command_queue queue, cl_event* done);
@@ -14,6 +14,92 @@
  * limitations under the License.
  */
 
+/*
+ * Pointwise operations. The filter graph fuses a pointwise operation into the
+ * kernel before it by building that kernel with POST_OP defined as the
+ * operation, which is then applied to the luma before it is stored.
+ */
+#ifndef THRESHOLD
+#define THRESHOLD 128
+#endif
+
+#ifndef POST_OP
+#define POST_OP(pixels) (pixels)
+#endif
+
+uchar8 threshold_op(uchar8 pixels)
+{
+    return select((uchar8)0, (uchar8)255, pixels > (uchar8)THRESHOLD);
+}
+
+/*
+ * Sobel magnitude of 8 pixels, computed from 16 pixels of the previous, the
+ * current and the next row. The output pixels are at index 1 to 8.
+ */
+uchar8 sobel_3x1_mag(uchar16 prev, uchar16 cur, uchar16 next)
+{
+    short8 gx = (short8)0;
+    short8 gy = (short8)0;
+
+    /* Previous row */
+    short8 middle = convert_short8(prev.s12345678);
+
+    gy += middle * (short8)(-2);
+
+    /* Current row */
+    short8 left = convert_short8(cur.s01234567);
+    short8 right = convert_short8(cur.s23456789);
+
+    gx += left * (short8)(-2);
+    gx += right * (short8)(2);
+
+    /* Next row */
+    middle = convert_short8(next.s12345678);
+
+    gy += middle * (short8)(2);
+
+    return convert_uchar8(clamp(abs(gx) + abs(gy),1, 255));
+}
+
+uchar8 sobel_3x3_mag(uchar16 prev, uchar16 cur, uchar16 next)
+{
+    short8 gx = (short8)0;
+    short8 gy = (short8)0;
+
+    /* Previous row */
+    short8 left = convert_short8(prev.s01234567);
+    short8 middle = convert_short8(prev.s12345678);
+    short8 right = convert_short8(prev.s23456789);
+
+    gx += left * (short8)(-1);
+    gx += right * (short8)(1);
+
+    gy += left * (short8)(-1);
+    gy += middle * (short8)(-2);
+    gy += right * (short8)(-1);
+
+    /* Current row */
+    left = convert_short8(cur.s01234567);
+    right = convert_short8(cur.s23456789);
+
+    gx += left * (short8)(-2);
+    gx += right * (short8)(2);
+
+    /* Next row */
+    left = convert_short8(next.s01234567);
+    middle = convert_short8(next.s12345678);
+    right = convert_short8(next.s23456789);
+
+    gx += left * (short8)(-1);
+    gx += right * (short8)(1);
+
+    gy += left * (short8)(1);
+    gy += middle * (short8)(2);
+    gy += right * (short8)(1);
+
+    return convert_uchar8(clamp(abs(gx) + abs(gy),1, 255));
+}
+
 __kernel void sobel_3x1(__global const unsigned char *In_y,
                         __global unsigned char *Out_y,
                         __global unsigned char *Out_cbcr,
@@ -35,44 +121,119 @@ __kernel void sobel_3x1(__global const unsigned char *In_y,
      * for each row of y. */
     int cbcr_id = ((row >> 1) * width) + (col);
 
-    short8 gx = (short8)0;
-    short8 gy = (short8)0;
-    uchar8 mag = (uchar8)0;
+    uchar8 mag = sobel_3x1_mag(vload16(0, &In_y[pix_id - width - 1]),
+                               vload16(0, &In_y[pix_id - 1]),
+                               vload16(0, &In_y[pix_id + width - 1]));
+    vstore8(POST_OP(mag), 0, &Out_y[pix_id]);
 
-    /* Previous row */
-    uchar16 temp = vload16(0, &In_y[pix_id - width - 1]);
-    short8 middle = convert_short8(temp.s12345678);
+    /* Write cbcr data (128 for greyscale) */
+    uchar8 cbcr = (uchar8) 128;
+    vstore8(cbcr, 0, &Out_cbcr[cbcr_id]);
+}
 
-    gy += middle * (short8)(-2);
+__kernel void sobel_3x3(__global const unsigned char *In_y,
+                        __global unsigned char *Out_y,
+                        __global unsigned char *Out_cbcr,
+                        int width,
+                        int height)
+{
+    int row = get_global_id(0);
+    if (row > height - 1)
+        return;
 
-    /* Current row */
-    temp = vload16(0, &In_y[pix_id -1]);
-    short8 left = convert_short8(temp.s01234567);
-    short8 right = convert_short8(temp.s23456789);
+    int col = (get_global_id(1) << 3);
+    int pix_id = (row * width) + col + 1;
+    int cbcr_id = ((row >> 1) * width) + (col);
 
-    gx += left * (short8)(-2);
-    gx += right * (short8)(2);
+    uchar8 mag = sobel_3x3_mag(vload16(0, &In_y[pix_id - width - 1]),
+                               vload16(0, &In_y[pix_id - 1]),
+                               vload16(0, &In_y[pix_id + width - 1]));
+    vstore8(POST_OP(mag), 0, &Out_y[pix_id]);
 
-    /* Next row */
-    temp = vload16(0, &In_y[pix_id + width - 1]);
-    middle = convert_short8(temp.s12345678);
+    /* Write cbcr data (128 for greyscale) */
+    uchar8 cbcr = (uchar8) 128;
+    vstore8(cbcr, 0, &Out_cbcr[cbcr_id]);
+}
 
-    gy += middle * (short8)(2);
+/*
+ * The tiled kernels first copy the pixels read by the work-group to a tile in
+ * __local memory. The tile holds the rows of the work-group plus one row above
+ * and one below, and 8 columns more than the work-group writes. Each input
+ * pixel is then read once from __global memory by the work-group, instead of
+ * once for each of the three rows that use it.
+ *
+ * The tile is passed as a __local argument of
+ * (local size 0 + 2) * (local size 1 + 1) * 8 bytes.
+ */
+void load_tile(__global const unsigned char *In_y,
+               __local unsigned char *tile,
+               int width,
+               int height)
+{
+    int tile_rows = get_local_size(0) + 2;
+    /* Number of uchar8 vectors in a tile row */
+    int tile_vecs = get_local_size(1) + 1;
+    int first_row = get_global_id(0) - get_local_id(0) - 1;
+    int first_col = (get_global_id(1) - get_local_id(1)) << 3;
+
+    int num_items = get_local_size(0) * get_local_size(1);
+    int item = get_local_id(0) * get_local_size(1) + get_local_id(1);
+
+    for (int i = item; i < tile_rows * tile_vecs; i += num_items) {
+        int r = i / tile_vecs;
+        int v = i - r * tile_vecs;
+        /* Stay within the image, the clamped pixels are only used at the border */
+        int src_row = min(first_row + r, height - 1);
+        int src_col = min(first_col + (v << 3), width - 8);
+        uchar8 pixels = vload8(0, &In_y[src_row * width + src_col]);
+        vstore8(pixels, 0, &tile[(r * tile_vecs + v) << 3]);
+    }
+
+    barrier(CLK_LOCAL_MEM_FENCE);
+}
+
+__kernel void sobel_3x1_tiled(__global const unsigned char *In_y,
+                              __global unsigned char *Out_y,
+                              __global unsigned char *Out_cbcr,
+                              int width,
+                              int height,
+                              __local unsigned char *tile)
+{
+    /* All work-items of the work-group must reach the barrier */
+    load_tile(In_y, tile, width, height);
+
+    int row = get_global_id(0);
+    if (row > height - 1)
+        return;
+
+    int col = (get_global_id(1) << 3);
+    int pix_id = (row * width) + col + 1;
+    int cbcr_id = ((row >> 1) * width) + (col);
+
+    int stride = (get_local_size(1) + 1) << 3;
+    __local const unsigned char *center =
+        &tile[(get_local_id(0) + 1) * stride + (get_local_id(1) << 3)];
 
-    mag = convert_uchar8(clamp(abs(gx) + abs(gy),1, 255));
-    vstore8(mag, 0, &Out_y[pix_id]);
+    uchar8 mag = sobel_3x1_mag(vload16(0, center - stride),
+                               vload16(0, center),
+                               vload16(0, center + stride));
+    vstore8(POST_OP(mag), 0, &Out_y[pix_id]);
 
     /* Write cbcr data (128 for greyscale) */
     uchar8 cbcr = (uchar8) 128;
     vstore8(cbcr, 0, &Out_cbcr[cbcr_id]);
 }
 
-__kernel void sobel_3x3(__global const unsigned char *In_y,
-                        __global unsigned char *Out_y,
-                        __global unsigned char *Out_cbcr,
-                        int width,
-                        int height)
+__kernel void sobel_3x3_tiled(__global const unsigned char *In_y,
+                              __global unsigned char *Out_y,
+                              __global unsigned char *Out_cbcr,
+                              int width,
+                              int height,
+                              __local unsigned char *tile)
 {
+    /* All work-items of the work-group must reach the barrier */
+    load_tile(In_y, tile, width, height);
+
     int row = get_global_id(0);
     if (row > height - 1)
         return;
@@ -81,46 +242,68 @@ __kernel void sobel_3x3(__global const unsigned char *In_y,
     int pix_id = (row * width) + col + 1;
     int cbcr_id = ((row >> 1) * width) + (col);
 
-    short8 gx = (short8)0;
-    short8 gy = (short8)0;
-    uchar8 mag = (uchar8)0;
+    int stride = (get_local_size(1) + 1) << 3;
+    __local const unsigned char *center =
+        &tile[(get_local_id(0) + 1) * stride + (get_local_id(1) << 3)];
 
-    /* Previous row */
-    uchar16 temp = vload16(0, &In_y[pix_id - width - 1]);
-    short8 left = convert_short8(temp.s01234567);
-    short8 middle = convert_short8(temp.s12345678);
-    short8 right = convert_short8(temp.s23456789);
+    uchar8 mag = sobel_3x3_mag(vload16(0, center - stride),
+                               vload16(0, center),
+                               vload16(0, center + stride));
+    vstore8(POST_OP(mag), 0, &Out_y[pix_id]);
 
-    gx += left * (short8)(-1);
-    gx += right * (short8)(1);
+    /* Write cbcr data (128 for greyscale) */
+    uchar8 cbcr = (uchar8) 128;
+    vstore8(cbcr, 0, &Out_cbcr[cbcr_id]);
+}
 
-    gy += left * (short8)(-1);
-    gy += middle * (short8)(-2);
-    gy += right * (short8)(-1);
+/* Mean of the 3x3 neighborhood, to remove noise before edge detection */
+__kernel void box_3x3(__global const unsigned char *In_y,
+                      __global unsigned char *Out_y,
+                      __global unsigned char *Out_cbcr,
+                      int width,
+                      int height)
+{
+    int row = get_global_id(0);
+    if (row > height - 1)
+        return;
 
-    /* Current row */
-    temp = vload16(0, &In_y[pix_id -1]);
-    left = convert_short8(temp.s01234567);
-    right = convert_short8(temp.s23456789);
+    int col = (get_global_id(1) << 3);
+    int pix_id = (row * width) + col + 1;
+    int cbcr_id = ((row >> 1) * width) + (col);
 
-    gx += left * (short8)(-2);
-    gx += right * (short8)(2);
+    short8 sum = (short8)0;
+    for (int i = -1; i <= 1; i++) {
+        uchar16 temp = vload16(0, &In_y[pix_id + i * width - 1]);
+        sum += convert_short8(temp.s01234567);
+        sum += convert_short8(temp.s12345678);
+        sum += convert_short8(temp.s23456789);
+    }
 
-    /* Next row */
-    temp = vload16(0, &In_y[pix_id + width - 1]);
-    left = convert_short8(temp.s01234567);
-    middle = convert_short8(temp.s12345678);
-    right = convert_short8(temp.s23456789);
+    uchar8 mean = convert_uchar8((sum + (short8)4) / (short8)9);
+    vstore8(POST_OP(mean), 0, &Out_y[pix_id]);
 
-    gx += left * (short8)(-1);
-    gx += right * (short8)(1);
+    /* Write cbcr data (128 for greyscale) */
+    uchar8 cbcr = (uchar8) 128;
+    vstore8(cbcr, 0, &Out_cbcr[cbcr_id]);
+}
 
-    gy += left * (short8)(1);
-    gy += middle * (short8)(2);
-    gy += right * (short8)(1);
+/* Binary threshold at THRESHOLD, also available as a fused operation */
+__kernel void threshold(__global const unsigned char *In_y,
+                        __global unsigned char *Out_y,
+                        __global unsigned char *Out_cbcr,
+                        int width,
+                        int height)
+{
+    int row = get_global_id(0);
+    if (row > height - 1)
+        return;
+
+    int col = (get_global_id(1) << 3);
+    int pix_id = (row * width) + col + 1;
+    int cbcr_id = ((row >> 1) * width) + (col);
 
-    mag = convert_uchar8(clamp(abs(gx) + abs(gy),1, 255));
-    vstore8(mag, 0, &Out_y[pix_id]);
+    uchar8 pixels = threshold_op(vload8(0, &In_y[pix_id]));
+    vstore8(POST_OP(pixels), 0, &Out_y[pix_id]);
 
     /* Write cbcr data (128 for greyscale) */
     uchar8 cbcr = (uchar8) 128;
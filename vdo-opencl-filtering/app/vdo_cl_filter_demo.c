@@ -23,12 +23,24 @@
  * OpenCL uses the received frame buffer as input to the filtering operations.
  * The output buffer is different from the input, and is mapped by this example.
  * All image memory is allocated such that it may be zero-copied to the GPU,
- * ensuring good performance.
+ * ensuring good performance. If the GPU supports cl_arm_import_memory, the
+ * VDO buffers are imported by their dma-buf file descriptors, otherwise their
+ * mapped data is used through a host pointer.
  *
  * Sobel filtering is performed according to the sobel_nv12 OpenCL program.
  * You may choose to filter a half or a full image, with two different filter
- * kernels. The result is written to an output file with default name
- * /usr/local/packages/vdo_cl_filter_demo/localdata/cl_vdo_demo.yuv.
+ * kernels, each with a variant that stages the pixels in __local memory. The
+ * Sobel filter is run in a filter graph together with a denoise filter before
+ * it and a threshold after it, see filter_graph.h. The local work size of each
+ * kernel is chosen with a benchmark the first time a resolution and rotation
+ * is used, see cl_autotune.h. The result is written to an output file with
+ * default name /usr/local/packages/vdo_cl_filter_demo/localdata/cl_vdo_demo.yuv.
+ *
+ * The filtering is pipelined with two frames in flight. The OpenCL objects for
+ * each VDO buffer, including the kernel arguments, are set up the first time
+ * the buffer is received and are then reused. A frame is enqueued without
+ * waiting for it to complete, so the CPU fetches the next VDO buffer while the
+ * GPU filters the current frame.
  *
  * Suppose you have completed the steps of installation. You may then go to
  * /usr/local/packages/vdo_cl_filter_demo on your device and run the example as:
@@ -46,22 +58,33 @@
 #include <syslog.h>
 #include <unistd.h>
 
+#include <CL/cl_ext.h>
+
+#include "filter_graph.h"
 #include "vdo-error.h"
 #include "vdo-map.h"
 #include "vdo-stream.h"
 #include "vdo-types.h"
 
-#define CL_TARGET_OPENCL_VERSION 120
-#include <CL/cl.h>
-
 #define MAX_SOURCE_SIZE (0x100000)
 
+/* Max number of frames enqueued to the GPU that have not been written yet */
+#define MAX_FRAMES_IN_FLIGHT 2
+
 #define VDO_CLIENT_ERROR   g_quark_from_static_string("vdo-client-error")
 #define VDO_SUBFORMAT_NV12 "NV12"
 
 /* Supported filter kernels */
-#define FILTER_SOBEL_3X3 "sobel_3x3"
-#define FILTER_SOBEL_3X1 "sobel_3x1"
+#define FILTER_SOBEL_3X3       "sobel_3x3"
+#define FILTER_SOBEL_3X1       "sobel_3x1"
+#define FILTER_SOBEL_3X3_TILED "sobel_3x3_tiled"
+#define FILTER_SOBEL_3X1_TILED "sobel_3x1_tiled"
+#define FILTER_BOX_3X3         "box_3x3"
+/* Pointwise filter, fused into the filter before it */
+#define FILTER_THRESHOLD "threshold"
+
+/* Chosen local work sizes, stored per kernel, resolution and rotation */
+#define AUTOTUNE_CACHE_PATH "/usr/local/packages/vdo_cl_filter_demo/localdata/local_work_size.conf"
 
 /* Which part of the captured images to filter with OpenCL */
 enum render_area {
@@ -78,16 +101,52 @@ cl_device_id device_id     = NULL;
 cl_uint ret_num_devices;
 cl_uint ret_num_platforms;
 cl_context context;
-cl_program program;
-cl_kernel kernel;
 cl_command_queue command_queue;
+filter_graph_t* graph = NULL;
+
+/* clImportMemoryARM from cl_arm_import_memory, NULL if it is not supported */
+typedef cl_mem(CL_API_CALL* import_memory_func)(cl_context context,
+                                                 cl_mem_flags flags,
+                                                 const cl_import_properties_arm* properties,
+                                                 void* memory,
+                                                 size_t size,
+                                                 cl_int* errcode_ret);
+import_memory_func import_memory = NULL;
+/* Alignment in bytes of the origin of a sub-buffer */
+cl_uint mem_base_addr_align = 0;
+
+/*
+ * An output buffer and its luma and chroma sub-buffers, created and mapped
+ * once. There is one output slot per frame in flight.
+ */
+typedef struct output_slot {
+    cl_mem image;
+    cl_mem image_y;
+    cl_mem image_cbcr;
+    void* data;
+    /* Completion of the kernel writing to the slot, NULL when the slot is idle */
+    cl_event done;
+    /* The VDO buffer read by the kernel, returned to the server on completion */
+    VdoBuffer* buffer;
+} output_slot_t;
+
+/*
+ * The OpenCL objects bound to a VDO buffer, stored in the hash table. There is
+ * one filter chain per output slot, with all kernel arguments set when it is
+ * created.
+ */
+typedef struct input_entry {
+    /* The imported VDO buffer, NULL if the buffer is used through a host pointer */
+    cl_mem imported;
+    cl_mem image_y;
+    filter_chain_t* chains[MAX_FRAMES_IN_FLIGHT];
+} input_entry_t;
 
-/* OpenCL memory objects */
-cl_mem out_image;
-cl_mem out_image_y;
-cl_mem out_image_cbcr;
+output_slot_t out_slots[MAX_FRAMES_IN_FLIGHT];
 
 size_t global_work_size[2];
+/* Offset of 1 row, such that the previous row is within the buffer */
+const size_t global_work_offset[2] = {1, 0};
 
 GHashTable* table = NULL;
 
@@ -112,8 +171,8 @@ static void print_cl_platform_info(cl_platform_id id) {
     syslog(LOG_INFO, "End of info");
 }
 
-/* Create cl kernel program */
-static cl_program create_cl_program(cl_context cont, const char* file_name, cl_int* ret) {
+/* Read the source of the cl kernel program, NUL terminated */
+static char* read_cl_source(const char* file_name) {
     FILE* fp;
     char* source_str;
     size_t source_size;
@@ -122,41 +181,38 @@ static cl_program create_cl_program(cl_context cont, const char* file_name, cl_i
         syslog(LOG_ERR, "Failed to load kernel.");
         exit(1);
     }
-    source_str = (char*)malloc(MAX_SOURCE_SIZE);
+    source_str = (char*)malloc(MAX_SOURCE_SIZE + 1);
 
-    source_size = fread(source_str, 1, MAX_SOURCE_SIZE, fp);
+    source_size             = fread(source_str, 1, MAX_SOURCE_SIZE, fp);
+    source_str[source_size] = '\0';
 
     syslog(LOG_INFO, "Read cl file \"%s\", size of %zu bytes", file_name, source_size);
 
     fclose(fp);
-
-    cl_program prog = clCreateProgramWithSource(cont,
-                                                1,
-                                                (const char**)&source_str,
-                                                (const size_t*)&source_size,
-                                                ret);
-    free(source_str);
-    return prog;
+    return source_str;
 }
 
 static int free_opencl(void) {
-    int cl_ret;
-    cl_ret = clReleaseMemObject(out_image_y);
-    cl_ret |= clReleaseMemObject(out_image_cbcr);
-    if (cl_ret != CL_SUCCESS) {
-        syslog(LOG_ERR, "Failed to release memory objects: %d", cl_ret);
-        return -1;
+    int cl_ret = CL_SUCCESS;
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        output_slot_t* slot = &out_slots[i];
+        if (slot->data)
+            cl_ret |=
+                clEnqueueUnmapMemObject(command_queue, slot->image, slot->data, 0, NULL, NULL);
+        if (slot->image_y)
+            cl_ret |= clReleaseMemObject(slot->image_y);
+        if (slot->image_cbcr)
+            cl_ret |= clReleaseMemObject(slot->image_cbcr);
+        if (slot->image)
+            cl_ret |= clReleaseMemObject(slot->image);
     }
-    cl_ret = clReleaseKernel(kernel);
+    cl_ret |= clFinish(command_queue);
     if (cl_ret != CL_SUCCESS) {
-        syslog(LOG_ERR, "Failed to release the kernel: %d", cl_ret);
-        return -1;
-    }
-    cl_ret = clReleaseProgram(program);
-    if (cl_ret != CL_SUCCESS) {
-        syslog(LOG_ERR, "Failed to release the program: %d", cl_ret);
+        syslog(LOG_ERR, "Failed to release memory objects: %d", cl_ret);
         return -1;
     }
+    filter_graph_free(graph);
+    graph = NULL;
     cl_ret = clReleaseCommandQueue(command_queue);
     if (cl_ret != CL_SUCCESS) {
         syslog(LOG_ERR, "Failed to release the command queue: %d", cl_ret);
@@ -170,8 +226,43 @@ static int free_opencl(void) {
     return 0;
 }
 
-static int
-setup_opencl(const char* kernel_name, enum render_area area, unsigned width, unsigned height) {
+/* Check if VDO buffers can be imported by their dma-buf file descriptors */
+static void setup_dma_buf_import(void) {
+    size_t size = 0;
+    clGetDeviceInfo(device_id, CL_DEVICE_EXTENSIONS, 0, NULL, &size);
+    /* Zero-filled, so the string is terminated also if the query fails */
+    char* extensions = (char*)calloc(size + 1, 1);
+    clGetDeviceInfo(device_id, CL_DEVICE_EXTENSIONS, size, extensions, NULL);
+
+    gboolean supported = strstr(extensions, "cl_arm_import_memory_dma_buf") != NULL;
+    free(extensions);
+
+    if (supported) {
+        cl_int ret;
+        import_memory = (import_memory_func)clGetExtensionFunctionAddressForPlatform(
+            platform_id,
+            "clImportMemoryARM");
+        ret = clGetDeviceInfo(device_id,
+                              CL_DEVICE_MEM_BASE_ADDR_ALIGN,
+                              sizeof(mem_base_addr_align),
+                              &mem_base_addr_align,
+                              NULL);
+        /* The device reports the alignment in bits */
+        mem_base_addr_align /= 8;
+        if (ret != CL_SUCCESS || mem_base_addr_align == 0)
+            import_memory = NULL;
+    }
+
+    syslog(LOG_INFO,
+           "Using VDO buffers through %s",
+           import_memory ? "dma-buf import" : "host pointers");
+}
+
+static int setup_opencl(const filter_graph_op_t* filters,
+                        size_t num_filters,
+                        enum render_area area,
+                        unsigned width,
+                        unsigned height) {
     cl_int ret = clGetPlatformIDs(1, &platform_id, &ret_num_platforms);
     if (ret != CL_SUCCESS) {
         syslog(LOG_ERR, "Could not get device id's");
@@ -192,42 +283,7 @@ setup_opencl(const char* kernel_name, enum render_area area, unsigned width, uns
         return -1;
     }
 
-    program =
-        create_cl_program(context, "/usr/local/packages/vdo_cl_filter_demo/sobel_nv12.cl", &ret);
-
-    if (ret != CL_SUCCESS) {
-        syslog(LOG_ERR, "Could not create cl program");
-        return -1;
-    }
-
-    /* This string can be used to pass paramaters to the OpenCl compiler */
-    char options[] = "";
-    ret            = clBuildProgram(program, 1, &device_id, options, NULL, NULL);
-    if (ret != CL_SUCCESS) {
-        syslog(LOG_ERR, "Could not build cl_program");
-
-        if (ret == CL_BUILD_PROGRAM_FAILURE) {
-            /* Determine the size of the program log */
-            size_t log_size;
-            clGetProgramBuildInfo(program, device_id, CL_PROGRAM_BUILD_LOG, 0, NULL, &log_size);
-            /* Allocate memory for the program log */
-            char* log = (char*)malloc(log_size);
-
-            /* Get the program log */
-            clGetProgramBuildInfo(program, device_id, CL_PROGRAM_BUILD_LOG, log_size, log, NULL);
-
-            /* Print the program log */
-            syslog(LOG_INFO, "%s", log);
-            free(log);
-        }
-        return -1;
-    }
-
-    kernel = clCreateKernel(program, kernel_name, &ret);
-    if (ret != CL_SUCCESS) {
-        syslog(LOG_ERR, "Could not create cl_program");
-        return -1;
-    }
+    setup_dma_buf_import();
 
     command_queue = clCreateCommandQueue(context, device_id, 0, &ret);
     if (ret != CL_SUCCESS) {
@@ -247,29 +303,33 @@ setup_opencl(const char* kernel_name, enum render_area area, unsigned width, uns
             break;
     }
 
+    char* source = read_cl_source("/usr/local/packages/vdo_cl_filter_demo/sobel_nv12.cl");
+    graph        = filter_graph_new(context,
+                             device_id,
+                             command_queue,
+                             source,
+                             filters,
+                             num_filters,
+                             width,
+                             height,
+                             global_work_offset,
+                             global_work_size);
+    free(source);
+    if (!graph) {
+        syslog(LOG_ERR, "Could not create filter graph");
+        return -1;
+    }
+
     return 0;
 }
 
 /*
- * For our sobel operations we ignore cbcr values and simply output 128 for all
- * pixels directly in the kernel.
+ * Create the output slots. Each slot gets its own output buffer with luma and
+ * chroma sub-buffers, such that the GPU can write one frame while the CPU
+ * reads another one.
  */
-static int do_opencl_filtering(cl_mem* in_image_y,
-                               cl_mem* out_image,
-                               unsigned width,
-                               unsigned height,
-                               size_t image_y_size,
-                               size_t image_cbcr_size) {
-    int ret;
-
-    /*
-     * This is the setting for local_work_size that works the best in terms
-     * of not only speed, but also achieving correct functionality when stream
-     * is rotated. This is due to the fact that global_work_size needs to be
-     * evenly divisible by local_work_size in all dimensions.
-     */
-    size_t local_work_size[2] = {8, 4};
-    size_t offset[2]          = {1, 0};
+static int create_output_slots(unsigned num_slots, size_t image_y_size, size_t image_cbcr_size) {
+    cl_int ret;
 
     cl_buffer_region y_region = {
         .origin = 0,
@@ -281,110 +341,293 @@ static int do_opencl_filtering(cl_mem* in_image_y,
         .size   = image_cbcr_size,
     };
 
-    /*
-     * Since we use NV12 data we could also create a single memory object
-     * direcly with luma and chroma included. For simplicity we split them up.
-     *
-     * The idea is to use CL_MEM_USE_HOST_PTR which means GPU access system
-     * memory, such that no unnecessary data has to be copied to GPU memory.
-     * This data may still however be cached in the GPU.
-     */
-    out_image_y = clCreateSubBuffer(*out_image,
-                                    CL_MEM_WRITE_ONLY,
-                                    CL_BUFFER_CREATE_TYPE_REGION,
-                                    &y_region,
-                                    &ret);
-
-    out_image_cbcr = clCreateSubBuffer(*out_image,
-                                       CL_MEM_WRITE_ONLY,
-                                       CL_BUFFER_CREATE_TYPE_REGION,
-                                       &c_region,
-                                       &ret);
+    for (unsigned i = 0; i < num_slots; i++) {
+        output_slot_t* slot = &out_slots[i];
+
+        /*
+         * Allocate memory for output buffer. In this case it's more practical
+         * with a separate output buffer since we're performing a filtering
+         * operation.
+         *
+         * If possible, allocate the buffer using OpenCL, and then map up that
+         * memory to the CPU.
+         */
+        slot->image = clCreateBuffer(context,
+                                     CL_MEM_ALLOC_HOST_PTR,
+                                     image_y_size + image_cbcr_size,
+                                     NULL,
+                                     &ret);
+        if (ret != CL_SUCCESS) {
+            syslog(LOG_ERR, "Unable to create new cl out memory object: %d", ret);
+            return -1;
+        }
+
+        /*
+         * Since we use NV12 data we could also use the output buffer directly
+         * with luma and chroma included. For simplicity we split them up.
+         */
+        slot->image_y = clCreateSubBuffer(slot->image,
+                                          CL_MEM_WRITE_ONLY,
+                                          CL_BUFFER_CREATE_TYPE_REGION,
+                                          &y_region,
+                                          &ret);
+        if (ret != CL_SUCCESS) {
+            syslog(LOG_ERR, "Unable to create cl memory objects");
+            return -1;
+        }
+
+        slot->image_cbcr = clCreateSubBuffer(slot->image,
+                                             CL_MEM_WRITE_ONLY,
+                                             CL_BUFFER_CREATE_TYPE_REGION,
+                                             &c_region,
+                                             &ret);
+        if (ret != CL_SUCCESS) {
+            syslog(LOG_ERR, "Unable to create cl memory objects");
+            return -1;
+        }
+
+        slot->data = clEnqueueMapBuffer(command_queue,
+                                        slot->image,
+                                        CL_TRUE,
+                                        CL_MAP_READ,
+                                        0,
+                                        image_y_size + image_cbcr_size,
+                                        0,
+                                        NULL,
+                                        NULL,
+                                        &ret);
+        if (ret != CL_SUCCESS) {
+            syslog(LOG_ERR, "Unable to map cl out memory object: %d", ret);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * For our sobel operations we ignore cbcr values and simply output 128 for all
+ * pixels directly in the kernel.
+ *
+ * The kernels are only enqueued, the event of the slot is signaled when the
+ * last one has completed.
+ */
+static int enqueue_opencl_filtering(const filter_chain_t* chain, output_slot_t* slot) {
+    cl_int ret = filter_chain_enqueue(chain, command_queue, &slot->done);
     if (ret != CL_SUCCESS) {
-        syslog(LOG_ERR, "Unable to create cl memory objects");
+        syslog(LOG_ERR, "Unable to enqueue OpenCL kernels: %d", ret);
+        slot->done = NULL;
         return -1;
     }
 
-    ret = clSetKernelArg(kernel, 0, sizeof(cl_mem), (void*)in_image_y);
-    ret |= clSetKernelArg(kernel, 1, sizeof(cl_mem), (void*)&out_image_y);
-    ret |= clSetKernelArg(kernel, 2, sizeof(cl_mem), (void*)&out_image_cbcr);
-    ret |= clSetKernelArg(kernel, 3, sizeof(width), &width);
-    ret |= clSetKernelArg(kernel, 4, sizeof(height), &height);
-    ret |= clEnqueueNDRangeKernel(command_queue,
-                                  kernel,
-                                  2,
-                                  offset,
-                                  global_work_size,
-                                  local_work_size,
-                                  0,
-                                  NULL,
-                                  NULL);
-
-    ret |= clFinish(command_queue);
+    /* Submit the kernels to the GPU now instead of when the next frame is waited for */
+    ret = clFlush(command_queue);
     if (ret != CL_SUCCESS) {
-        syslog(LOG_ERR, "Unable to complete OpenCL operations: %d", ret);
+        syslog(LOG_ERR, "Unable to flush OpenCL command queue: %d", ret);
         return -1;
     }
     return 0;
 }
 
-static void free_table_entry(gpointer key, gpointer value, gpointer user_data) {
-    (void)key;
-    (void)user_data;
-    cl_mem mem_obj = *(cl_mem*)value;
-    cl_int ret     = clReleaseMemObject(mem_obj);
+/*
+ * Wait for the kernel writing to a slot to complete, write the frame to the
+ * output file unless it is NULL, and return the VDO buffer to the server.
+ */
+static gboolean finish_output_slot(output_slot_t* slot, FILE* output_file, GError** error) {
+    gboolean ok = TRUE;
+    cl_int ret  = CL_INVALID_EVENT;
+
+    /* The event is NULL if the kernel could not be enqueued */
+    if (slot->done) {
+        ret = clWaitForEvents(1, &slot->done);
+        clReleaseEvent(slot->done);
+        slot->done = NULL;
+    }
+
     if (ret != CL_SUCCESS) {
-        syslog(LOG_ERR, "Failed to release memory object: %d", ret);
+        g_set_error(error, VDO_CLIENT_ERROR, 0, "Unable to complete OpenCL operations: %d", ret);
+        ok = FALSE;
+    } else if (output_file) {
+        /* Lifetimes of buffer and frame are linked, no need to free frame */
+        VdoFrame* frame = vdo_buffer_get_frame(slot->buffer);
+        if (!fwrite(slot->data, vdo_frame_get_size(frame), 1, output_file)) {
+            g_set_error(error, VDO_CLIENT_ERROR, 0, "Unable to write frame: %m");
+            ok = FALSE;
+        }
     }
+
+    /* Release the buffer and allow the server to reuse it */
+    if (!vdo_stream_buffer_unref(stream, &slot->buffer, ok ? error : NULL))
+        ok = FALSE;
+    slot->buffer = NULL;
+    return ok;
 }
 
-/* Release cl memory objects on hash table cleanup */
-static void hash_table_destroy(void) {
-    g_hash_table_foreach(table, free_table_entry, NULL);
-    g_hash_table_destroy(table);
+/*
+ * Choose the local work size of the filter kernels. The benchmark writes to
+ * the first output slot, with a temporary input buffer since the run time does
+ * not depend on the image content.
+ */
+static int tune_opencl_filtering(enum render_area area,
+                                 unsigned width,
+                                 unsigned height,
+                                 unsigned rotation,
+                                 size_t image_size) {
+    cl_int ret;
+    cl_mem in_image = clCreateBuffer(context,
+                                     CL_MEM_READ_ONLY | CL_MEM_ALLOC_HOST_PTR,
+                                     image_size,
+                                     NULL,
+                                     &ret);
+    if (ret != CL_SUCCESS) {
+        syslog(LOG_ERR, "Unable to create new cl memory object: %d", ret);
+        return -1;
+    }
+
+    char settings[64];
+    snprintf(settings,
+             sizeof(settings),
+             "%ux%u-rot%u-%s",
+             width,
+             height,
+             rotation,
+             area == HALF_AREA ? "half" : "full");
+
+    int status = filter_graph_tune(graph,
+                                   command_queue,
+                                   in_image,
+                                   out_slots[0].image_y,
+                                   out_slots[0].image_cbcr,
+                                   AUTOTUNE_CACHE_PATH,
+                                   settings);
+    clReleaseMemObject(in_image);
+    return status;
 }
 
 /*
- * Map a VDO buffer address to an OpenCL memory object. If the address has
- * already been mapped, look up the OpenCL memory object in the hash table
+ * Import a VDO buffer by its dma-buf file descriptor, which lets the driver
+ * access the buffer without cache maintenance for a host pointer. The entry
+ * gets a sub-buffer of the luma, since the frame may start at an offset in the
+ * dma-buf. Returns FALSE if the buffer can not be imported.
  */
-static int map_input_buffer(void* buffer,
-                            cl_mem* in_images,
-                            cl_mem* in_image_y,
-                            size_t image_size,
-                            enum render_area area,
-                            unsigned buffer_count) {
-    int ret;
-    static unsigned count = 0;
-    (void)area;
+static gboolean import_input_buffer(input_entry_t* entry, VdoBuffer* buffer, size_t image_size) {
+    cl_int ret;
+
+    int fd          = vdo_buffer_get_fd(buffer);
+    int64_t offset  = vdo_buffer_get_offset(buffer);
+    size_t capacity = vdo_buffer_get_capacity(buffer);
+    if (fd < 0 || offset < 0 || (size_t)offset % mem_base_addr_align != 0 || capacity < image_size)
+        return FALSE;
+
+    const cl_import_properties_arm properties[] = {CL_IMPORT_TYPE_ARM,
+                                                   CL_IMPORT_TYPE_DMA_BUF_ARM,
+                                                   0};
+    entry->imported =
+        import_memory(context, CL_MEM_READ_ONLY, properties, &fd, (size_t)offset + capacity, &ret);
+    if (ret != CL_SUCCESS) {
+        syslog(LOG_WARNING, "Unable to import dma-buf %d: %d", fd, ret);
+        entry->imported = NULL;
+        return FALSE;
+    }
 
-    if (g_hash_table_contains(table, buffer)) {
-        *in_image_y = *((cl_mem*)g_hash_table_lookup(table, buffer));
-        return 0;
+    cl_buffer_region y_region = {
+        .origin = (size_t)offset,
+        .size   = image_size,
+    };
+    entry->image_y = clCreateSubBuffer(entry->imported,
+                                       CL_MEM_READ_ONLY,
+                                       CL_BUFFER_CREATE_TYPE_REGION,
+                                       &y_region,
+                                       &ret);
+    if (ret != CL_SUCCESS) {
+        syslog(LOG_WARNING, "Unable to create sub-buffer of dma-buf %d: %d", fd, ret);
+        entry->image_y = NULL;
+        clReleaseMemObject(entry->imported);
+        entry->imported = NULL;
+        return FALSE;
     }
+    return TRUE;
+}
+
+/* Release the cl objects of an entry on hash table cleanup */
+static void free_input_entry(gpointer data) {
+    input_entry_t* entry = data;
+
+    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+        filter_chain_free(entry->chains[i]);
+    cl_int ret = CL_SUCCESS;
+    if (entry->image_y)
+        ret |= clReleaseMemObject(entry->image_y);
+    if (entry->imported)
+        ret |= clReleaseMemObject(entry->imported);
+    if (ret != CL_SUCCESS) {
+        syslog(LOG_ERR, "Failed to release memory objects: %d", ret);
+    }
+    free(entry);
+}
+
+/*
+ * Map a VDO buffer address to an OpenCL memory object, and create the filter
+ * chains that read from it. If the address has already been mapped, look up
+ * its entry in the hash table.
+ */
+static input_entry_t* map_input_buffer(VdoBuffer* buffer,
+                                       void* data,
+                                       size_t image_size,
+                                       unsigned num_slots,
+                                       unsigned buffer_count) {
+    cl_int ret;
+
+    input_entry_t* entry = g_hash_table_lookup(table, data);
+    if (entry)
+        return entry;
 
     /* Make sure we're not getting any more unique addresses than asked for */
-    if (count == buffer_count) {
-        return -1;
+    if (g_hash_table_size(table) == buffer_count) {
+        return NULL;
     }
 
+    entry = calloc(1, sizeof(input_entry_t));
+    if (!entry) {
+        syslog(LOG_ERR, "Unable to allocate input entry");
+        return NULL;
+    }
+    g_hash_table_insert(table, (gpointer)data, (gpointer)entry);
+
     /*
      * Re-use already allocated VDO frame buffer as input to OpenCL program.
      * In this specific example we don't need the bottom 1/3rd of the frame
      * containing cbcr data, so we simply ignore it.
+     *
+     * The entry is keyed by the data address rather than the file descriptor,
+     * since several VDO buffers may share a file descriptor at different
+     * offsets.
      */
-    in_images[count] =
-        clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR, image_size, buffer, &ret);
-
-    if (ret != CL_SUCCESS) {
-        syslog(LOG_ERR, "Unable to create new cl memory object: %d", ret);
-        return -1;
+    if (!import_memory || !import_input_buffer(entry, buffer, image_size)) {
+        /*
+         * The idea is to use CL_MEM_USE_HOST_PTR which means GPU access system
+         * memory, such that no unnecessary data has to be copied to GPU memory.
+         * This data may still however be cached in the GPU.
+         */
+        entry->image_y =
+            clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR, image_size, data, &ret);
+        if (ret != CL_SUCCESS) {
+            syslog(LOG_ERR, "Unable to create new cl memory object: %d", ret);
+            entry->image_y = NULL;
+            return NULL;
+        }
     }
 
-    g_hash_table_insert(table, (gpointer)buffer, (gpointer)(&in_images[count]));
-    *in_image_y = in_images[count];
-    count++;
-    return 0;
+    /*
+     * Kernel arguments are kept by the kernel, so with one chain per input
+     * and output pair the arguments never need to be set again.
+     */
+    for (unsigned i = 0; i < num_slots; i++) {
+        entry->chains[i] =
+            filter_chain_new(graph, entry->image_y, out_slots[i].image_y, out_slots[i].image_cbcr);
+        if (!entry->chains[i])
+            return NULL;
+    }
+    return entry;
 }
 
 int main(void) {
@@ -392,9 +635,6 @@ int main(void) {
     FILE* output_file       = NULL;
     VdoMap* settings        = NULL;
     VdoMap* vdo_stream_info = NULL;
-    void* out_data          = NULL;
-    cl_mem* in_images       = NULL;
-    cl_int cl_ret           = CL_SUCCESS;
 
     const gchar* output_file_format = "yuv"; /* Also the VDO stream format */
 
@@ -404,10 +644,24 @@ int main(void) {
     const guint frames          = 5; /* Number of frames to process */
     const guint buffer_count    = 3; /* Number of unique VDO buffers */
 
-    /* Render settings specific for this example */
-    const char* kernel_name          = FILTER_SOBEL_3X3;
+    /*
+     * Render settings specific for this example. The filters are applied in
+     * order, the threshold is fused into the Sobel kernel.
+     */
+    const filter_graph_op_t filters[] = {
+        {FILTER_BOX_3X3, 0},
+        {FILTER_SOBEL_3X3_TILED, 0},
+        {FILTER_THRESHOLD, 64},
+    };
     enum render_area cur_render_area = HALF_AREA;
 
+    /*
+     * Number of frames enqueued to the GPU that have not been written yet, at
+     * most MAX_FRAMES_IN_FLIGHT. Each of them holds a VDO buffer while the
+     * next buffer is fetched, so buffer_count must be larger than this.
+     */
+    const guint frames_in_flight = MAX_FRAMES_IN_FLIGHT;
+
     /* Set up VDO */
     settings = vdo_map_new();
     vdo_map_set_uint32(settings, "format", VDO_FORMAT_YUV);
@@ -444,6 +698,8 @@ int main(void) {
            vdo_map_get_uint32(vdo_stream_info, "height", 0),
            vdo_map_get_uint32(vdo_stream_info, "framerate", 0));
 
+    /* The best local work size depends on the rotation */
+    guint rotation = vdo_map_get_uint32(vdo_stream_info, "rotation", 0);
     g_clear_object(&vdo_stream_info);
 
     /* Start the stream */
@@ -471,53 +727,29 @@ int main(void) {
     size_t image_cbcr_size = image_y_size / 2;
 
     /* Set up OpenCL */
-    if (setup_opencl(kernel_name, cur_render_area, image_width, image_height)) {
+    if (setup_opencl(filters, G_N_ELEMENTS(filters), cur_render_area, image_width, image_height)) {
         syslog(LOG_ERR, "Unable to setup OpenCL");
         goto exit;
     }
 
-    /* Initialize hash table for mapping VDO buffers to OpenCL memory objects */
-    table = g_hash_table_new(g_direct_hash, g_direct_equal);
+    /* Initialize hash table for mapping VDO buffers to OpenCL objects */
+    table = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, free_input_entry);
 
-    /*
-     * Allocate space for cl memory objects. The addresses to the memory objects
-     * will be stored in the hash table.
-     */
-    in_images = (cl_mem*)malloc(sizeof(cl_mem) * buffer_count);
+    if (create_output_slots(frames_in_flight, image_y_size, image_cbcr_size))
+        goto exit;
 
-    /*
-     * Allocate memory for output buffer. In this case it's more practical with
-     * a separate output buffer since we're performing a filtering operation.
-     *
-     * If possible, allocate the buffer using OpenCL, and then map up that memory
-     * to the CPU.
-     */
-    out_image = clCreateBuffer(context,
-                               CL_MEM_ALLOC_HOST_PTR,
-                               image_y_size + image_cbcr_size,
-                               NULL,
-                               &cl_ret);
-    if (cl_ret != CL_SUCCESS) {
-        syslog(LOG_ERR, "Unable to create new cl out memory object: %d", cl_ret);
-        return -1;
-    }
-    out_data = clEnqueueMapBuffer(command_queue,
-                                  out_image,
-                                  CL_TRUE,
-                                  CL_MAP_READ,
-                                  0,
-                                  image_y_size + image_cbcr_size,
-                                  0,
-                                  NULL,
-                                  NULL,
-                                  &cl_ret);
-    if (cl_ret != CL_SUCCESS) {
-        syslog(LOG_ERR, "Unable to map cl out memory object: %d", cl_ret);
-        return -1;
-    }
+    if (tune_opencl_filtering(cur_render_area,
+                              image_width,
+                              image_height,
+                              rotation,
+                              image_y_size + image_cbcr_size))
+        goto exit;
 
     /* Loop for the pre-determined number of frames */
     for (guint n = 0; n < frames; n++) {
+        guint slot_index    = n % frames_in_flight;
+        output_slot_t* slot = &out_slots[slot_index];
+
         /* Lifetimes of buffer and frame are linked, no need to free frame */
         VdoBuffer* buffer = vdo_stream_get_buffer(stream, &error);
         VdoFrame* frame   = vdo_buffer_get_frame(buffer);
@@ -534,6 +766,16 @@ int main(void) {
             goto exit;
         }
 
+        /*
+         * The slot was last used by the frame frames_in_flight frames ago.
+         * Wait for that frame and write it, while the GPU keeps filtering the
+         * frames after it.
+         */
+        if (slot->buffer && !finish_output_slot(slot, output_file, &error)) {
+            vdo_stream_buffer_unref(stream, &buffer, NULL);
+            goto exit;
+        }
+
         /*
          * Copying the image data to the output buffer is not always necessary,
          * if the filtering is done over the full image area.
@@ -541,39 +783,29 @@ int main(void) {
          * as the cl program will not render a full image.
          */
         if (cur_render_area != FULL_AREA)
-            memcpy(out_data, in_data, image_y_size + image_cbcr_size);
+            memcpy(slot->data, in_data, image_y_size + image_cbcr_size);
+
+        /* The slot holds the buffer until the frame has been written */
+        slot->buffer = buffer;
 
         /*
          * Map a received VDO frame buffer with a cl memory object. A cl buffer
-         * will be created for every unique VDO buffer determined by buffer_count.
-         * If the frame buffer has already been mapped, re-use its assigned
-         * cl buffer.
+         * and filter chains will be created for every unique VDO buffer determined
+         * by buffer_count. If the frame buffer has already been mapped, re-use
+         * its assigned cl objects.
          */
-        cl_mem in_image_y;
-        if (map_input_buffer(in_data,
-                             in_images,
-                             &in_image_y,
-                             image_y_size,
-                             cur_render_area,
-                             buffer_count))
-            goto exit;
-
-        if (do_opencl_filtering(&in_image_y,
-                                &out_image,
-                                image_width,
-                                image_height,
-                                image_y_size,
-                                image_cbcr_size))
-            goto exit;
-
-        if (!fwrite(out_data, vdo_frame_get_size(frame), 1, output_file)) {
-            g_set_error(&error, VDO_CLIENT_ERROR, 0, "Unable to write frame: %m");
-            vdo_stream_buffer_unref(stream, &buffer, NULL);
+        input_entry_t* entry =
+            map_input_buffer(buffer, in_data, image_y_size, frames_in_flight, buffer_count);
+        if (!entry || enqueue_opencl_filtering(entry->chains[slot_index], slot)) {
+            g_set_error(&error, VDO_CLIENT_ERROR, 0, "Unable to filter frame");
             goto exit;
         }
+    }
 
-        /* Release the buffer and allow the server to reuse it */
-        if (!vdo_stream_buffer_unref(stream, &buffer, &error))
+    /* Write the frames that are still in flight, oldest first */
+    for (guint n = frames; n < frames + frames_in_flight; n++) {
+        output_slot_t* slot = &out_slots[n % frames_in_flight];
+        if (slot->buffer && !finish_output_slot(slot, output_file, &error))
             goto exit;
     }
 
@@ -582,16 +814,14 @@ exit:
     if (vdo_error_is_expected(&error))
         g_clear_error(&error);
 
-    cl_ret = clEnqueueUnmapMemObject(command_queue, out_image, out_data, 0, NULL, NULL);
-    if (cl_ret != CL_SUCCESS) {
-        syslog(LOG_ERR, "Unable to unmap cl memory object: %d", cl_ret);
-        return -1;
+    /* Wait for any frames left in flight after an error, without writing them */
+    for (guint i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        if (out_slots[i].buffer)
+            finish_output_slot(&out_slots[i], NULL, NULL);
     }
 
-    hash_table_destroy();
-
-    if (in_images)
-        free(in_images);
+    if (table)
+        g_hash_table_destroy(table);
 
     gint ret = EXIT_SUCCESS;
     if (error) {
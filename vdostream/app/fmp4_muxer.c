@@ -0,0 +1,490 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fmp4_muxer.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+
+#include "panic.h"
+
+// The timestamps of VDO are in microseconds
+#define TIMESCALE 1000000
+#define TRACK_ID  1
+
+#define H264_NAL_SPS 7
+#define H264_NAL_PPS 8
+#define H265_NAL_VPS 32
+#define H265_NAL_SPS 33
+#define H265_NAL_PPS 34
+
+// Sample flags of ISO/IEC 14496-12 8.8.3.1
+#define SAMPLE_FLAGS_SYNC     0x02000000
+#define SAMPLE_FLAGS_NON_SYNC 0x01010000
+
+typedef struct byte_writer {
+    uint8_t* data;
+    size_t size;
+    size_t capacity;
+} byte_writer_t;
+
+static const uint32_t unity_matrix[9] = {0x00010000, 0, 0, 0, 0x00010000, 0, 0, 0, 0x40000000};
+
+static void put_bytes(byte_writer_t* w, const void* src, size_t size) {
+    if (w->size + size > w->capacity)
+        panic("%s: The boxes do not fit in %zu bytes", __func__, w->capacity);
+    memcpy(w->data + w->size, src, size);
+    w->size += size;
+}
+
+static void put_zeros(byte_writer_t* w, size_t size) {
+    if (w->size + size > w->capacity)
+        panic("%s: The boxes do not fit in %zu bytes", __func__, w->capacity);
+    memset(w->data + w->size, 0, size);
+    w->size += size;
+}
+
+static void put_u8(byte_writer_t* w, uint8_t value) {
+    put_bytes(w, &value, 1);
+}
+
+static void put_u16(byte_writer_t* w, uint16_t value) {
+    uint8_t bytes[2] = {value >> 8, value};
+    put_bytes(w, bytes, sizeof(bytes));
+}
+
+static void set_u32(uint8_t* dst, uint32_t value) {
+    dst[0] = value >> 24;
+    dst[1] = value >> 16;
+    dst[2] = value >> 8;
+    dst[3] = value;
+}
+
+static void put_u32(byte_writer_t* w, uint32_t value) {
+    uint8_t bytes[4];
+    set_u32(bytes, value);
+    put_bytes(w, bytes, sizeof(bytes));
+}
+
+static void put_u64(byte_writer_t* w, uint64_t value) {
+    put_u32(w, value >> 32);
+    put_u32(w, value);
+}
+
+static void put_matrix(byte_writer_t* w) {
+    for (size_t i = 0; i < 9; i++)
+        put_u32(w, unity_matrix[i]);
+}
+
+/**
+ * @brief Start a box, its size is set by box_end().
+ *
+ * @return The offset of the box.
+ */
+static size_t box_start(byte_writer_t* w, const char* type) {
+    size_t start = w->size;
+    put_u32(w, 0);
+    put_bytes(w, type, 4);
+    return start;
+}
+
+static size_t full_box_start(byte_writer_t* w, const char* type, uint8_t version, uint32_t flags) {
+    size_t start = box_start(w, type);
+    put_u32(w, (uint32_t)version << 24 | flags);
+    return start;
+}
+
+static void box_end(byte_writer_t* w, size_t start) {
+    set_u32(w->data + start, (uint32_t)(w->size - start));
+}
+
+/**
+ * @brief Find the NAL units of an Annex B byte stream, without the start codes.
+ *
+ * @return The number of NAL units, or -1 if there are more than max_nal_units.
+ */
+static int split_nal_units(const uint8_t* data,
+                           size_t size,
+                           struct iovec* nal_units,
+                           unsigned int max_nal_units) {
+    const uint8_t* end = data + size;
+    const uint8_t* nal = NULL;
+    unsigned int count = 0;
+
+    // A start code is 00 00 01, the end of the data is a start code of no NAL unit
+    const uint8_t* p = data + 2;
+    while (p <= end) {
+        const uint8_t* next = p < end ? memchr(p, 1, end - p) : NULL;
+        if (next && (next[-1] != 0 || next[-2] != 0)) {
+            p = next + 1;
+            continue;
+        }
+
+        if (nal) {
+            // NAL units end with a one bit, the zeros are trailing_zero_8bits
+            // or from a 4 byte start code
+            const uint8_t* nal_end = next ? next - 2 : end;
+            while (nal_end > nal && nal_end[-1] == 0)
+                nal_end--;
+            if (nal_end > nal) {
+                if (count == max_nal_units)
+                    return -1;
+                nal_units[count++] = (struct iovec){(void*)nal, nal_end - nal};
+            }
+        }
+        if (!next)
+            break;
+        nal = next + 1;
+        p   = next + 1;
+    }
+    return count;
+}
+
+static unsigned int nal_unit_type(fmp4_codec_t codec, const struct iovec* nal) {
+    uint8_t first = *(const uint8_t*)nal->iov_base;
+    return codec == FMP4_CODEC_H264 ? first & 0x1f : (first >> 1) & 0x3f;
+}
+
+static const struct iovec*
+find_nal_unit(fmp4_codec_t codec, const struct iovec* nal_units, int count, unsigned int type) {
+    for (int i = 0; i < count; i++) {
+        if (nal_unit_type(codec, &nal_units[i]) == type)
+            return &nal_units[i];
+    }
+    return NULL;
+}
+
+/**
+ * @brief Copy the start of a NAL unit without the emulation prevention bytes.
+ *
+ * @return The number of bytes copied.
+ */
+static size_t unescape(const struct iovec* nal, uint8_t* dst, size_t max_size) {
+    const uint8_t* src = nal->iov_base;
+    size_t zeros       = 0;
+    size_t size        = 0;
+    for (size_t i = 0; i < nal->iov_len && size < max_size; i++) {
+        if (zeros >= 2 && src[i] == 3) {
+            zeros = 0;
+            continue;
+        }
+        zeros       = src[i] == 0 ? zeros + 1 : 0;
+        dst[size++] = src[i];
+    }
+    return size;
+}
+
+static void put_parameter_set(byte_writer_t* w, const struct iovec* nal) {
+    put_u16(w, nal->iov_len);
+    put_bytes(w, nal->iov_base, nal->iov_len);
+}
+
+// AVCDecoderConfigurationRecord of ISO/IEC 14496-15 5.3.3.1
+static void put_avcc(byte_writer_t* w, const struct iovec* sps, const struct iovec* pps) {
+    const uint8_t* profile = sps->iov_base;
+    size_t avcc            = box_start(w, "avcC");
+    put_u8(w, 1);
+    // Profile, compatibility and level follow the NAL unit header of the SPS
+    put_bytes(w, profile + 1, 3);
+    // 4 byte NAL unit lengths
+    put_u8(w, 0xfc | 3);
+    put_u8(w, 0xe0 | 1);
+    put_parameter_set(w, sps);
+    put_u8(w, 1);
+    put_parameter_set(w, pps);
+    box_end(w, avcc);
+}
+
+// HEVCDecoderConfigurationRecord of ISO/IEC 14496-15 8.3.3.1
+static void put_hvcc(byte_writer_t* w,
+                     const struct iovec* vps,
+                     const struct iovec* sps,
+                     const struct iovec* pps) {
+    // NAL unit header, one byte of ids and the 12 bytes of general_profile_tier_level
+    uint8_t rbsp[15] = {0};
+    if (unescape(sps, rbsp, sizeof(rbsp)) < sizeof(rbsp))
+        panic("%s: The SPS is too short", __func__);
+
+    size_t hvcc = box_start(w, "hvcC");
+    put_u8(w, 1);
+    put_bytes(w, rbsp + 3, 12);
+    // No min_spatial_segmentation, unknown parallelism, 4:2:0 and 8 bits
+    put_u16(w, 0xf000);
+    put_u8(w, 0xfc);
+    put_u8(w, 0xfc | 1);
+    put_u8(w, 0xf8);
+    put_u8(w, 0xf8);
+    // Unknown average frame rate
+    put_u16(w, 0);
+    // numTemporalLayers 1, temporalIdNested and 4 byte NAL unit lengths
+    put_u8(w, 1 << 3 | 1 << 2 | 3);
+
+    const struct iovec* arrays[] = {vps, sps, pps};
+    put_u8(w, 3);
+    for (size_t i = 0; i < 3; i++) {
+        // Not complete, more parameter sets can be in the samples
+        put_u8(w, nal_unit_type(FMP4_CODEC_H265, arrays[i]));
+        put_u16(w, 1);
+        put_parameter_set(w, arrays[i]);
+    }
+    box_end(w, hvcc);
+}
+
+static void put_sample_entry(fmp4_muxer_t* muxer,
+                             byte_writer_t* w,
+                             const struct iovec* vps,
+                             const struct iovec* sps,
+                             const struct iovec* pps) {
+    bool h264    = muxer->codec == FMP4_CODEC_H264;
+    size_t entry = box_start(w, h264 ? "avc3" : "hev1");
+    put_zeros(w, 6);
+    // data_reference_index
+    put_u16(w, 1);
+    put_zeros(w, 16);
+    put_u16(w, muxer->width);
+    put_u16(w, muxer->height);
+    // 72 dpi
+    put_u32(w, 0x00480000);
+    put_u32(w, 0x00480000);
+    put_u32(w, 0);
+    // frame_count
+    put_u16(w, 1);
+    // compressorname
+    put_zeros(w, 32);
+    put_u16(w, 0x0018);
+    put_u16(w, 0xffff);
+    if (h264)
+        put_avcc(w, sps, pps);
+    else
+        put_hvcc(w, vps, sps, pps);
+    box_end(w, entry);
+}
+
+static void create_init_segment(fmp4_muxer_t* muxer,
+                                const struct iovec* vps,
+                                const struct iovec* sps,
+                                const struct iovec* pps) {
+    byte_writer_t w = {muxer->init_segment, 0, sizeof(muxer->init_segment)};
+
+    size_t ftyp = box_start(&w, "ftyp");
+    put_bytes(&w, "iso6", 4);
+    put_u32(&w, 0);
+    put_bytes(&w, "iso6mp41", 8);
+    box_end(&w, ftyp);
+
+    size_t moov = box_start(&w, "moov");
+
+    size_t mvhd = full_box_start(&w, "mvhd", 0, 0);
+    // Creation and modification time
+    put_zeros(&w, 8);
+    put_u32(&w, TIMESCALE);
+    // Duration, unknown for fragments
+    put_u32(&w, 0);
+    put_u32(&w, 0x00010000);
+    put_u16(&w, 0x0100);
+    put_zeros(&w, 10);
+    put_matrix(&w);
+    put_zeros(&w, 24);
+    put_u32(&w, TRACK_ID + 1);
+    box_end(&w, mvhd);
+
+    size_t trak = box_start(&w, "trak");
+
+    // Enabled and in movie
+    size_t tkhd = full_box_start(&w, "tkhd", 0, 3);
+    put_zeros(&w, 8);
+    put_u32(&w, TRACK_ID);
+    put_zeros(&w, 4 + 4 + 8);
+    // Layer, alternate group, volume and reserved
+    put_zeros(&w, 8);
+    put_matrix(&w);
+    put_u32(&w, muxer->width << 16);
+    put_u32(&w, muxer->height << 16);
+    box_end(&w, tkhd);
+
+    size_t mdia = box_start(&w, "mdia");
+
+    size_t mdhd = full_box_start(&w, "mdhd", 0, 0);
+    put_zeros(&w, 8);
+    put_u32(&w, TIMESCALE);
+    put_u32(&w, 0);
+    // Language "und"
+    put_u16(&w, 0x55c4);
+    put_u16(&w, 0);
+    box_end(&w, mdhd);
+
+    size_t hdlr = full_box_start(&w, "hdlr", 0, 0);
+    put_u32(&w, 0);
+    put_bytes(&w, "vide", 4);
+    put_zeros(&w, 12);
+    put_bytes(&w, "VideoHandler", sizeof("VideoHandler"));
+    box_end(&w, hdlr);
+
+    size_t minf = box_start(&w, "minf");
+
+    size_t vmhd = full_box_start(&w, "vmhd", 0, 1);
+    put_zeros(&w, 8);
+    box_end(&w, vmhd);
+
+    size_t dinf = box_start(&w, "dinf");
+    size_t dref = full_box_start(&w, "dref", 0, 0);
+    put_u32(&w, 1);
+    // The media data is in the same file
+    size_t url = full_box_start(&w, "url ", 0, 1);
+    box_end(&w, url);
+    box_end(&w, dref);
+    box_end(&w, dinf);
+
+    // The sample tables are empty, the samples are described by the fragments
+    size_t stbl = box_start(&w, "stbl");
+    size_t stsd = full_box_start(&w, "stsd", 0, 0);
+    put_u32(&w, 1);
+    put_sample_entry(muxer, &w, vps, sps, pps);
+    box_end(&w, stsd);
+    const char* empty_tables[] = {"stts", "stsc", "stco"};
+    for (size_t i = 0; i < 3; i++) {
+        size_t table = full_box_start(&w, empty_tables[i], 0, 0);
+        put_u32(&w, 0);
+        box_end(&w, table);
+    }
+    size_t stsz = full_box_start(&w, "stsz", 0, 0);
+    put_zeros(&w, 8);
+    box_end(&w, stsz);
+    box_end(&w, stbl);
+
+    box_end(&w, minf);
+    box_end(&w, mdia);
+    box_end(&w, trak);
+
+    size_t mvex = box_start(&w, "mvex");
+    size_t trex = full_box_start(&w, "trex", 0, 0);
+    put_u32(&w, TRACK_ID);
+    put_u32(&w, 1);
+    put_u32(&w, muxer->frame_duration_us);
+    put_zeros(&w, 8);
+    box_end(&w, trex);
+    box_end(&w, mvex);
+
+    box_end(&w, moov);
+    muxer->init_size = w.size;
+}
+
+fmp4_muxer_t*
+fmp4_muxer_new(fmp4_codec_t codec, unsigned int width, unsigned int height, double fps) {
+    fmp4_muxer_t* muxer = calloc(1, sizeof(fmp4_muxer_t));
+    if (!muxer)
+        panic("%s: Could not allocate muxer", __func__);
+    muxer->codec             = codec;
+    muxer->width             = width;
+    muxer->height            = height;
+    muxer->frame_duration_us = fps > 0.0 ? (uint32_t)(TIMESCALE / fps + 0.5) : TIMESCALE / 30;
+    return muxer;
+}
+
+bool fmp4_muxer_add_frame(fmp4_muxer_t* muxer,
+                          const uint8_t* data,
+                          size_t size,
+                          uint64_t timestamp_us,
+                          bool key_frame,
+                          fmp4_fragment_t* fragment) {
+    struct iovec nal_units[FMP4_MAX_NAL_UNITS];
+    int count = split_nal_units(data, size, nal_units, FMP4_MAX_NAL_UNITS);
+    if (count < 0) {
+        syslog(LOG_WARNING,
+               "%s: Skipped a frame of more than %d NAL units",
+               __func__,
+               FMP4_MAX_NAL_UNITS);
+        return false;
+    }
+    if (count == 0)
+        return false;
+
+    if (muxer->init_size == 0) {
+        if (!key_frame)
+            return false;
+        bool h264               = muxer->codec == FMP4_CODEC_H264;
+        unsigned int sps_type   = h264 ? H264_NAL_SPS : H265_NAL_SPS;
+        unsigned int pps_type   = h264 ? H264_NAL_PPS : H265_NAL_PPS;
+        const struct iovec* sps = find_nal_unit(muxer->codec, nal_units, count, sps_type);
+        const struct iovec* pps = find_nal_unit(muxer->codec, nal_units, count, pps_type);
+        const struct iovec* vps = find_nal_unit(muxer->codec, nal_units, count, H265_NAL_VPS);
+        if (!sps || !pps || (!h264 && !vps)) {
+            syslog(LOG_WARNING, "%s: No parameter sets in the key frame", __func__);
+            return false;
+        }
+        create_init_segment(muxer, vps, sps, pps);
+        muxer->first_timestamp_us = timestamp_us;
+    }
+
+    uint32_t payload_size = 0;
+    for (int i = 0; i < count; i++) {
+        set_u32(muxer->lengths[i], nal_units[i].iov_len);
+        payload_size += 4 + nal_units[i].iov_len;
+    }
+
+    byte_writer_t w = {muxer->header, 0, sizeof(muxer->header)};
+    size_t moof     = box_start(&w, "moof");
+
+    size_t mfhd = full_box_start(&w, "mfhd", 0, 0);
+    put_u32(&w, ++muxer->sequence_number);
+    box_end(&w, mfhd);
+
+    size_t traf = box_start(&w, "traf");
+    // The data offset is from the start of the moof
+    size_t tfhd = full_box_start(&w, "tfhd", 0, 0x020000);
+    put_u32(&w, TRACK_ID);
+    box_end(&w, tfhd);
+
+    size_t tfdt = full_box_start(&w, "tfdt", 1, 0);
+    put_u64(&w,
+            timestamp_us > muxer->first_timestamp_us ? timestamp_us - muxer->first_timestamp_us
+                                                     : 0);
+    box_end(&w, tfdt);
+
+    // One sample with data offset, duration, size and flags
+    size_t trun = full_box_start(&w, "trun", 0, 0x000701);
+    put_u32(&w, 1);
+    size_t data_offset = w.size;
+    put_u32(&w, 0);
+    put_u32(&w, muxer->frame_duration_us);
+    put_u32(&w, payload_size);
+    put_u32(&w, key_frame ? SAMPLE_FLAGS_SYNC : SAMPLE_FLAGS_NON_SYNC);
+    box_end(&w, trun);
+    box_end(&w, traf);
+    box_end(&w, moof);
+
+    set_u32(w.data + data_offset, (uint32_t)(w.size - moof + 8));
+    put_u32(&w, 8 + payload_size);
+    put_bytes(&w, "mdat", 4);
+
+    fragment->parts[0]  = (struct iovec){muxer->header, w.size};
+    fragment->num_parts = 1;
+    for (int i = 0; i < count; i++) {
+        fragment->parts[fragment->num_parts++] = (struct iovec){muxer->lengths[i], 4};
+        fragment->parts[fragment->num_parts++] = nal_units[i];
+    }
+    return true;
+}
+
+const uint8_t* fmp4_muxer_init_segment(const fmp4_muxer_t* muxer, size_t* size) {
+    *size = muxer->init_size;
+    return muxer->init_size > 0 ? muxer->init_segment : NULL;
+}
+
+void fmp4_muxer_free(fmp4_muxer_t* muxer) {
+    free(muxer);
+}
@@ -0,0 +1,103 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Streaming fragmented MP4 (ISO/IEC 14496-12) muxing of H.264 and H.265 frames.
+ *
+ * The stream is an initialization segment, ftyp and moov, followed by one
+ * fragment, moof and mdat, per frame. A fragment per frame needs no buffering
+ * of frames, and a player can start at any fragment of a key frame after the
+ * initialization segment.
+ *
+ * VDO delivers Annex B byte streams, where each NAL unit is preceded by a
+ * start code, while MP4 samples have a length before each NAL unit. The
+ * fragment is returned as an I/O vector of the box headers, the lengths and
+ * the NAL units in the frame buffer, so the payload is never copied by the
+ * muxer. The parameter sets stay in the key frames, as allowed by the avc3 and
+ * hev1 sample entries.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+// Most NAL units in one frame, slices and parameter sets included
+#define FMP4_MAX_NAL_UNITS 64
+#define FMP4_MAX_PARTS     (1 + 2 * FMP4_MAX_NAL_UNITS)
+#define FMP4_HEADER_SIZE   128
+#define FMP4_INIT_SIZE     1024
+
+typedef enum { FMP4_CODEC_H264, FMP4_CODEC_H265 } fmp4_codec_t;
+
+typedef struct fmp4_fragment {
+    struct iovec parts[FMP4_MAX_PARTS];
+    unsigned int num_parts;
+} fmp4_fragment_t;
+
+typedef struct fmp4_muxer {
+    fmp4_codec_t codec;
+    unsigned int width;
+    unsigned int height;
+    uint32_t frame_duration_us;
+
+    uint8_t init_segment[FMP4_INIT_SIZE];
+    size_t init_size;
+
+    uint32_t sequence_number;
+    uint64_t first_timestamp_us;
+    // Box headers and NAL unit lengths of the last fragment
+    uint8_t header[FMP4_HEADER_SIZE];
+    uint8_t lengths[FMP4_MAX_NAL_UNITS][4];
+} fmp4_muxer_t;
+
+/**
+ * @brief Create a muxer, the application panics on failure.
+ *
+ * @param fps Nominal frame rate, for the duration of each frame. The decode
+ *            times come from the frame timestamps.
+ */
+fmp4_muxer_t*
+fmp4_muxer_new(fmp4_codec_t codec, unsigned int width, unsigned int height, double fps);
+
+/**
+ * @brief Create the fragment of a frame.
+ *
+ * The initialization segment is created from the parameter sets of the first
+ * key frame, the frames before it are skipped.
+ *
+ * @param timestamp_us Capture time of the frame, e.g. from vdo_frame_get_timestamp().
+ * @param fragment     Filled with the parts of the fragment, which point into the
+ *                     muxer and the frame data, valid until the next call.
+ *
+ * @return False if the frame was skipped.
+ */
+bool fmp4_muxer_add_frame(fmp4_muxer_t* muxer,
+                          const uint8_t* data,
+                          size_t size,
+                          uint64_t timestamp_us,
+                          bool key_frame,
+                          fmp4_fragment_t* fragment);
+
+/**
+ * @brief The initialization segment to write before the fragments, NULL
+ * before the first key frame.
+ */
+const uint8_t* fmp4_muxer_init_segment(const fmp4_muxer_t* muxer, size_t* size);
+
+void fmp4_muxer_free(fmp4_muxer_t* muxer);
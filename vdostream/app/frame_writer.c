@@ -0,0 +1,284 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// For sync_file_range()
+#define _GNU_SOURCE
+
+#include "frame_writer.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <unistd.h>
+
+#include "panic.h"
+
+// Bytes written between two starts of the writeback
+#define SYNC_SIZE (4 * 1024 * 1024)
+#define PAGE_ALIGNMENT 4096
+
+static int open_segment(frame_writer_t* writer) {
+    g_autofree gchar* path =
+        writer->segment_size > 0 ? g_strdup_printf("%s.%04u", writer->path, writer->segment_index)
+                                 : g_strdup(writer->path);
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+        panic("%s: Could not open %s: %m", __func__, path);
+    syslog(LOG_INFO, "Writing to %s", path);
+    return fd;
+}
+
+/**
+ * @brief Start the writeback of the data written since the last call, and wait
+ * for the writeback of the range before to finish and drop it from the page cache.
+ *
+ * Both calls are only advice for the kernel, errors such as for /dev/null are ignored.
+ */
+static void pace_writeback(frame_writer_t* writer, bool force) {
+    uint64_t unsynced = writer->offset - writer->synced_offset;
+    if (unsynced == 0 || (!force && unsynced < SYNC_SIZE))
+        return;
+
+    sync_file_range(writer->fd,
+                    (off_t)writer->synced_offset,
+                    (off_t)unsynced,
+                    SYNC_FILE_RANGE_WRITE);
+    if (writer->synced_offset > 0) {
+        sync_file_range(writer->fd,
+                        0,
+                        (off_t)writer->synced_offset,
+                        SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE |
+                            SYNC_FILE_RANGE_WAIT_AFTER);
+        posix_fadvise(writer->fd, 0, (off_t)writer->synced_offset, POSIX_FADV_DONTNEED);
+    }
+    writer->synced_offset = writer->offset;
+}
+
+static void close_segment(frame_writer_t* writer) {
+    pace_writeback(writer, true);
+    if (close(writer->fd) != 0)
+        panic("%s: Could not close the output: %m", __func__);
+    writer->fd            = -1;
+    writer->offset        = 0;
+    writer->synced_offset = 0;
+}
+
+static void write_all(frame_writer_t* writer, const uint8_t* data, size_t size) {
+    gint64 start_us = g_get_monotonic_time();
+    size_t left     = size;
+    while (left > 0) {
+        ssize_t written = write(writer->fd, data, left);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written < 0)
+            panic("%s: Failed to write frames: %m", __func__);
+        data += written;
+        left -= (size_t)written;
+    }
+    writer->longest_write_us = MAX(writer->longest_write_us, g_get_monotonic_time() - start_us);
+    writer->offset += size;
+    writer->bytes_written += size;
+}
+
+static void write_block(frame_writer_t* writer, const frame_block_t* block) {
+    if (block->new_segment) {
+        close_segment(writer);
+        writer->segment_index++;
+        writer->fd = open_segment(writer);
+    }
+
+    if (writer->offset == 0 && writer->header)
+        write_all(writer, writer->header, writer->header_size);
+    write_all(writer, block->data, block->used);
+
+    pace_writeback(writer, false);
+}
+
+static void* writer_thread(void* data) {
+    frame_writer_t* writer = data;
+
+    pthread_mutex_lock(&writer->mutex);
+    while (true) {
+        while (writer->count == 0 && !writer->stopping)
+            pthread_cond_wait(&writer->cond, &writer->mutex);
+        if (writer->count == 0)
+            break;
+
+        frame_block_t* block = &writer->blocks[writer->head];
+        pthread_mutex_unlock(&writer->mutex);
+
+        write_block(writer, block);
+        block->used        = 0;
+        block->new_segment = false;
+
+        pthread_mutex_lock(&writer->mutex);
+        writer->head = (writer->head + 1) % FRAME_WRITER_NUM_BLOCKS;
+        writer->count--;
+    }
+    pthread_mutex_unlock(&writer->mutex);
+    return NULL;
+}
+
+frame_writer_t* frame_writer_new(const char* path, uint64_t segment_size) {
+    frame_writer_t* writer = calloc(1, sizeof(frame_writer_t));
+    if (!writer)
+        panic("%s: Could not allocate writer", __func__);
+    writer->path         = strdup(path);
+    writer->segment_size = segment_size;
+    if (!writer->path)
+        panic("%s: Could not allocate writer", __func__);
+
+    for (unsigned int i = 0; i < FRAME_WRITER_NUM_BLOCKS; i++) {
+        void* block_data = NULL;
+        if (posix_memalign(&block_data, PAGE_ALIGNMENT, FRAME_WRITER_BLOCK_SIZE) != 0)
+            panic("%s: Could not allocate block", __func__);
+        writer->blocks[i].data = block_data;
+    }
+
+    writer->fd = open_segment(writer);
+
+    pthread_mutex_init(&writer->mutex, NULL);
+    pthread_cond_init(&writer->cond, NULL);
+    if (pthread_create(&writer->thread, NULL, writer_thread, writer) != 0)
+        panic("%s: Could not create writer thread", __func__);
+    return writer;
+}
+
+/**
+ * @brief Hand the block being filled over to the writer thread.
+ */
+static void submit_block(frame_writer_t* writer) {
+    pthread_mutex_lock(&writer->mutex);
+    writer->count++;
+    pthread_cond_signal(&writer->cond);
+    pthread_mutex_unlock(&writer->mutex);
+    writer->fill = (writer->fill + 1) % FRAME_WRITER_NUM_BLOCKS;
+}
+
+/**
+ * @brief Bytes that can be queued without waiting for the writer thread.
+ *
+ * @param new_block If the block being filled is submitted first.
+ */
+static size_t free_space(frame_writer_t* writer, bool new_block) {
+    pthread_mutex_lock(&writer->mutex);
+    unsigned int free_blocks = FRAME_WRITER_NUM_BLOCKS - writer->count;
+    pthread_mutex_unlock(&writer->mutex);
+    if (free_blocks == 0)
+        return 0;
+
+    size_t used = writer->blocks[writer->fill].used;
+    size_t left = new_block && used > 0 ? 0 : FRAME_WRITER_BLOCK_SIZE - used;
+    return left + (free_blocks - 1) * (size_t)FRAME_WRITER_BLOCK_SIZE;
+}
+
+bool frame_writer_writev(frame_writer_t* writer,
+                         const struct iovec* parts,
+                         unsigned int num_parts,
+                         bool key_frame) {
+    size_t size = 0;
+    for (unsigned int i = 0; i < num_parts; i++)
+        size += parts[i].iov_len;
+    if (size == 0)
+        return true;
+    if (writer->wait_for_key_frame && !key_frame) {
+        writer->frames_dropped++;
+        return false;
+    }
+
+    bool rotate = key_frame && writer->segment_size > 0 && writer->segment_bytes > 0 &&
+                  writer->segment_bytes + size > writer->segment_size;
+    if (size > free_space(writer, rotate)) {
+        // The frames after a dropped frame cannot be decoded until the next key frame
+        writer->wait_for_key_frame = true;
+        writer->frames_dropped++;
+        return false;
+    }
+    writer->wait_for_key_frame = false;
+
+    if (rotate) {
+        if (writer->blocks[writer->fill].used > 0)
+            submit_block(writer);
+        writer->blocks[writer->fill].new_segment = true;
+        writer->segment_bytes                    = 0;
+    }
+
+    for (unsigned int i = 0; i < num_parts; i++) {
+        const uint8_t* src = parts[i].iov_base;
+        size_t left        = parts[i].iov_len;
+        while (left > 0) {
+            frame_block_t* block = &writer->blocks[writer->fill];
+            size_t chunk         = MIN(left, FRAME_WRITER_BLOCK_SIZE - block->used);
+            memcpy(block->data + block->used, src, chunk);
+            block->used += chunk;
+            src += chunk;
+            left -= chunk;
+            if (block->used == FRAME_WRITER_BLOCK_SIZE)
+                submit_block(writer);
+        }
+    }
+    writer->segment_bytes += size;
+    writer->frames_written++;
+    return true;
+}
+
+bool frame_writer_write(frame_writer_t* writer, const void* data, size_t size, bool key_frame) {
+    struct iovec part = {.iov_base = (void*)data, .iov_len = size};
+    return frame_writer_writev(writer, &part, 1, key_frame);
+}
+
+void frame_writer_set_header(frame_writer_t* writer, const void* data, size_t size) {
+    if (writer->header || writer->frames_written > 0)
+        panic("%s: The header must be set once, before the first frame", __func__);
+    writer->header = malloc(size);
+    if (!writer->header)
+        panic("%s: Could not allocate header", __func__);
+    memcpy(writer->header, data, size);
+    writer->header_size = size;
+}
+
+void frame_writer_close(frame_writer_t* writer) {
+    if (!writer)
+        return;
+
+    // When all blocks are queued, the block to fill is the one being written
+    if (free_space(writer, false) > 0 && writer->blocks[writer->fill].used > 0)
+        submit_block(writer);
+    pthread_mutex_lock(&writer->mutex);
+    writer->stopping = true;
+    pthread_cond_signal(&writer->cond);
+    pthread_mutex_unlock(&writer->mutex);
+    pthread_join(writer->thread, NULL);
+
+    close_segment(writer);
+    syslog(LOG_INFO,
+           "Frames written %llu, bytes %llu, files %u, dropped %llu, longest write %lld ms",
+           (unsigned long long)writer->frames_written,
+           (unsigned long long)writer->bytes_written,
+           writer->segment_index + 1,
+           (unsigned long long)writer->frames_dropped,
+           (long long)(writer->longest_write_us / 1000));
+
+    for (unsigned int i = 0; i < FRAME_WRITER_NUM_BLOCKS; i++)
+        free(writer->blocks[i].data);
+    pthread_cond_destroy(&writer->cond);
+    pthread_mutex_destroy(&writer->mutex);
+    free(writer->header);
+    free(writer->path);
+    free(writer);
+}
@@ -0,0 +1,126 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Writing of frames to a file from a thread of its own.
+ *
+ * The frames are copied into a ring of large page aligned blocks, and a
+ * writer thread writes each full block with one write() call. The capture
+ * loop only copies memory, so it does not block when the storage, e.g. an SD
+ * card, is slow for a while. If the ring is full, the frame is dropped, and
+ * for encoded video the following frames are dropped until the next key
+ * frame, so the file can still be decoded.
+ *
+ * The writer thread starts the writeback of the written data every few MB
+ * with sync_file_range() and drops the written pages from the page cache, so
+ * the kernel never has a large amount of dirty pages to flush at once.
+ *
+ * The output can be split into segment files of about the same size. A new
+ * segment is only started at a key frame, so every segment can be played on
+ * its own. A header, such as the initialization segment of a fragmented MP4
+ * stream, can be set to be written at the start of every segment.
+ */
+
+#pragma once
+
+#include <glib.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+#define FRAME_WRITER_BLOCK_SIZE (1024 * 1024)
+#define FRAME_WRITER_NUM_BLOCKS 8
+
+typedef struct frame_block {
+    uint8_t* data;
+    size_t used;
+    // Start a new segment file before the block is written
+    bool new_segment;
+} frame_block_t;
+
+typedef struct frame_writer {
+    char* path;
+    uint64_t segment_size;
+    // Written at the start of every segment, set before the first frame
+    uint8_t* header;
+    size_t header_size;
+
+    frame_block_t blocks[FRAME_WRITER_NUM_BLOCKS];
+    // Queued blocks, from head, protected by mutex. The block being written is still queued.
+    unsigned int head;
+    unsigned int count;
+    bool stopping;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    pthread_t thread;
+
+    // Only used by the capture loop
+    unsigned int fill;
+    uint64_t segment_bytes;
+    bool wait_for_key_frame;
+    uint64_t frames_written;
+    uint64_t frames_dropped;
+
+    // Only used by the writer thread
+    int fd;
+    unsigned int segment_index;
+    uint64_t offset;
+    uint64_t synced_offset;
+    uint64_t bytes_written;
+    gint64 longest_write_us;
+} frame_writer_t;
+
+/**
+ * @brief Open the output and start the writer thread, the application panics on failure.
+ *
+ * @param path         The output file, or the prefix of the segment files.
+ * @param segment_size Size in bytes after which a new segment is started, 0 for one file.
+ */
+frame_writer_t* frame_writer_new(const char* path, uint64_t segment_size);
+
+/**
+ * @brief Queue a frame to be written, without blocking.
+ *
+ * @param key_frame If the frame can be decoded without the previous frames.
+ *
+ * @return False if the frame was dropped.
+ */
+bool frame_writer_write(frame_writer_t* writer, const void* data, size_t size, bool key_frame);
+
+/**
+ * @brief Queue a frame made of several parts, such as box headers and the
+ * payload, without blocking. The parts are copied into the ring once.
+ *
+ * @param key_frame If the frame can be decoded without the previous frames.
+ *
+ * @return False if the frame was dropped.
+ */
+bool frame_writer_writev(frame_writer_t* writer,
+                         const struct iovec* parts,
+                         unsigned int num_parts,
+                         bool key_frame);
+
+/**
+ * @brief Set the header to write at the start of every segment, before the first frame.
+ */
+void frame_writer_set_header(frame_writer_t* writer, const void* data, size_t size);
+
+/**
+ * @brief Write all queued frames, close the output and free the writer.
+ */
+void frame_writer_close(frame_writer_t* writer);
@@ -31,7 +31,13 @@
  *
  * Second argument, frames, is an integer for number of captured frames.
  *
- * Finally, the third argument, output, is the output filename.
+ * The third argument, output, is the output filename.
+ *
+ * The optional argument segment-size splits the output into files of about
+ * that many MB, named output.0000, output.0001 and so on.
+ *
+ * Finally, the optional flag fmp4 writes h264 and h265 as fragmented MP4
+ * instead of the raw byte stream.
  *
  * Suppose that you have done through the steps of installation.
  * Then you would go to /usr/local/packages/vdoencodeclient on your device
@@ -61,6 +67,8 @@
 #include <stdlib.h>
 #include <syslog.h>
 
+#include "fmp4_muxer.h"
+#include "frame_writer.h"
 #include "panic.h"
 
 static gboolean shutdown       = FALSE;
@@ -73,6 +81,17 @@ static void handle_sigint(int signum) {
     shutdown = TRUE;
 }
 
+// Frames that can be decoded without the previous frames
+static gboolean is_key_frame(VdoFrame* frame) {
+    switch (vdo_frame_get_frame_type(frame)) {
+        case VDO_FRAME_TYPE_H264_P:
+        case VDO_FRAME_TYPE_H265_P:
+            return FALSE;
+        default:
+            return TRUE;
+    }
+}
+
 // Determine and log the received frame type
 static void print_frame(VdoFrame* frame) {
     gchar* frame_type;
@@ -128,18 +147,72 @@ static void set_format(VdoMap* settings, gchar* format) {
     }
 }
 
-static void save_frame_to_file(VdoBuffer* buffer, FILE* dest_f) {
+// Only the encoded video formats can be muxed
+static fmp4_muxer_t* new_muxer(gchar* format, VdoMap* info) {
+    fmp4_codec_t codec;
+    if (g_strcmp0(format, "h264") == 0)
+        codec = FMP4_CODEC_H264;
+    else if (g_strcmp0(format, "h265") == 0)
+        codec = FMP4_CODEC_H265;
+    else
+        panic("%s: Format \"%s\" cannot be written as fragmented MP4\n", __func__, format);
+
+    return fmp4_muxer_new(codec,
+                          vdo_map_get_uint32(info, "width", 0),
+                          vdo_map_get_uint32(info, "height", 0),
+                          vdo_map_get_double(info, "framerate", 0.0));
+}
+
+static gboolean write_fragment(VdoFrame* frame,
+                               gpointer data,
+                               frame_writer_t* writer,
+                               fmp4_muxer_t* muxer) {
+    fmp4_fragment_t fragment;
+    gboolean key_frame = is_key_frame(frame);
+    if (!fmp4_muxer_add_frame(muxer,
+                              data,
+                              vdo_frame_get_size(frame),
+                              vdo_frame_get_timestamp(frame),
+                              key_frame,
+                              &fragment))
+        return TRUE;
+
+    // The initialization segment is known from the first key frame
+    if (!writer->header) {
+        size_t init_size;
+        const uint8_t* init_segment = fmp4_muxer_init_segment(muxer, &init_size);
+        frame_writer_set_header(writer, init_segment, init_size);
+    }
+    return frame_writer_writev(writer, fragment.parts, fragment.num_parts, key_frame);
+}
+
+static void save_frame_to_file(VdoBuffer* buffer, frame_writer_t* writer, fmp4_muxer_t* muxer) {
+    static gint64 last_print_us = G_MININT64;
+
     // Lifetimes of buffer and frame are linked, no need to free frame
     VdoFrame* frame = vdo_buffer_get_frame(buffer);
 
-    print_frame(frame);
+    // Logging every frame costs more than writing it, so at most one frame per second is logged
+    gint64 now_us = g_get_monotonic_time();
+    if (now_us - last_print_us >= G_USEC_PER_SEC) {
+        print_frame(frame);
+        last_print_us = now_us;
+    }
 
     gpointer data = vdo_buffer_get_data(buffer);
     if (!data)
         panic("%s: Failed to get data: %m", __func__);
 
-    if (!fwrite(data, vdo_frame_get_size(frame), 1, dest_f))
-        panic("%s: Failed to write frame: %m", __func__);
+    // The frame is copied to the writer thread, so a slow output does not hold up the stream
+    gboolean written = muxer ? write_fragment(frame, data, writer, muxer)
+                             : frame_writer_write(writer,
+                                                  data,
+                                                  vdo_frame_get_size(frame),
+                                                  is_key_frame(frame));
+    if (!written)
+        syslog(LOG_WARNING,
+               "frame = %4u dropped, the output is too slow",
+               vdo_frame_get_sequence_nbr(frame));
 }
 
 static int handle_vdo_failed(GError* error) {
@@ -159,6 +232,8 @@ static int handle_vdo_failed(GError* error) {
  * --format [avif, h264, h265, jpeg, nv12, y800]
  * --frames [number of frames]
  * --output [output filename]
+ * --segment-size [size of each output file in MB]
+ * --fmp4
  */
 int main(int argc, char* argv[]) {
     g_autoptr(GError) error     = NULL;
@@ -168,7 +243,10 @@ int main(int argc, char* argv[]) {
     gchar* format               = "h264";
     guint frames                = G_MAXUINT;
     gchar* output_file          = "/dev/null";
-    FILE* dest_f                = NULL;
+    guint segment_mb            = 0;
+    gboolean fmp4               = FALSE;
+    frame_writer_t* writer      = NULL;
+    fmp4_muxer_t* muxer         = NULL;
 
     GOptionEntry options[] = {
         {"format",
@@ -180,6 +258,14 @@ int main(int argc, char* argv[]) {
          NULL},
         {"frames", 'n', 0, G_OPTION_ARG_INT, &frames, "number of frames", NULL},
         {"output", 'o', 0, G_OPTION_ARG_FILENAME, &output_file, "output filename", NULL},
+        {"segment-size",
+         's',
+         0,
+         G_OPTION_ARG_INT,
+         &segment_mb,
+         "size of each output file in MB, 0 for a single file",
+         NULL},
+        {"fmp4", 'f', 0, G_OPTION_ARG_NONE, &fmp4, "write h264 or h265 as fragmented MP4", NULL},
         {
             NULL,
             0,
@@ -199,9 +285,7 @@ int main(int argc, char* argv[]) {
     if (!g_option_context_parse(context, &argc, &argv, &error))
         panic("%s Failed to use option_context_parse: %s", __func__, error->message);
 
-    dest_f = fopen(output_file, "wb");
-    if (!dest_f)
-        panic("%s open failed: %m", __func__);
+    writer = frame_writer_new(output_file, (uint64_t)segment_mb * 1024 * 1024);
 
     if (signal(SIGINT, handle_sigint) == SIG_ERR)
         panic("%s Failed to install signal handler: %m", __func__);
@@ -226,7 +310,9 @@ int main(int argc, char* argv[]) {
                format,
                vdo_map_get_uint32(settings, "width", 0),
                vdo_map_get_uint32(settings, "height", 0));
-        save_frame_to_file(buffer, dest_f);
+        if (fmp4)
+            muxer = new_muxer(format, settings);
+        save_frame_to_file(buffer, writer, muxer);
         goto exit;
     }
 
@@ -251,6 +337,9 @@ int main(int argc, char* argv[]) {
            vdo_map_get_uint32(info, "height", 0),
            (unsigned int)(vdo_map_get_double(info, "framerate", 0.0) + 0.5));
 
+    if (fmp4)
+        muxer = new_muxer(format, info);
+
     // Start the stream
     if (!vdo_stream_start(stream, &error))
         panic("%s: Failed to start vdo stream : %s", __func__, error->message);
@@ -270,7 +359,7 @@ int main(int argc, char* argv[]) {
         if (!buffer)
             return handle_vdo_failed(error);
 
-        save_frame_to_file(buffer, dest_f);
+        save_frame_to_file(buffer, writer, muxer);
 
         // Release the buffer and allow the server to reuse it
         if (!vdo_stream_buffer_unref(stream, &buffer, &error)) {
@@ -281,8 +370,10 @@ int main(int argc, char* argv[]) {
     }
 
 exit:
-    if (dest_f)
-        fclose(dest_f);
+    // Waits for the queued frames to be written
+    frame_writer_close(writer);
+    if (muxer)
+        fmp4_muxer_free(muxer);
 
     g_option_context_free(context);
 
@@ -0,0 +1,132 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "arena.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Every allocation is preceded by its size, for realloc(). */
+#define ALIGNMENT   (_Alignof(max_align_t))
+#define HEADER_SIZE ALIGNMENT
+
+static size_t size_of(void* ptr) {
+    return *(size_t*)((char*)ptr - HEADER_SIZE);
+}
+
+/* Rounds up to a multiple of ALIGNMENT, less than size on overflow. */
+static size_t align_up(size_t size) {
+    return (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+}
+
+static void* arena_malloc(UriMemoryManager* memory, size_t size) {
+    arena_t* arena = memory->userData;
+    size_t aligned = align_up(size);
+
+    if (aligned < size || arena->size - arena->used < HEADER_SIZE + aligned) {
+        return NULL;
+    }
+    char* block     = arena->data + arena->used;
+    *(size_t*)block = size;
+    arena->last     = arena->used;
+    arena->used     = arena->last + HEADER_SIZE + aligned;
+    return block + HEADER_SIZE;
+}
+
+static void* arena_calloc(UriMemoryManager* memory, size_t nmemb, size_t size) {
+    if (size != 0 && nmemb > SIZE_MAX / size) {
+        return NULL;
+    }
+    void* ptr = arena_malloc(memory, nmemb * size);
+    if (ptr != NULL) {
+        memset(ptr, 0, nmemb * size);
+    }
+    return ptr;
+}
+
+static void* arena_realloc(UriMemoryManager* memory, void* ptr, size_t size) {
+    arena_t* arena = memory->userData;
+
+    if (ptr == NULL) {
+        return arena_malloc(memory, size);
+    }
+
+    /* The latest allocation grows in place. */
+    char* block = (char*)ptr - HEADER_SIZE;
+    if (block == arena->data + arena->last) {
+        size_t aligned = align_up(size);
+        if (aligned >= size && arena->size - arena->last >= HEADER_SIZE + aligned) {
+            *(size_t*)block = size;
+            arena->used     = arena->last + HEADER_SIZE + aligned;
+            return ptr;
+        }
+        return NULL;
+    }
+
+    void* new_ptr = arena_malloc(memory, size);
+    if (new_ptr != NULL) {
+        size_t old_size = size_of(ptr);
+        memcpy(new_ptr, ptr, old_size < size ? old_size : size);
+    }
+    return new_ptr;
+}
+
+static void* arena_reallocarray(UriMemoryManager* memory, void* ptr, size_t nmemb, size_t size) {
+    if (size != 0 && nmemb > SIZE_MAX / size) {
+        return NULL;
+    }
+    return arena_realloc(memory, ptr, nmemb * size);
+}
+
+static void arena_free_block(UriMemoryManager* memory, void* ptr) {
+    /* Freed when the arena is reset. */
+    (void)memory;
+    (void)ptr;
+}
+
+arena_t* arena_new(size_t size) {
+    arena_t* arena = calloc(1, sizeof(arena_t));
+    if (arena == NULL) {
+        return NULL;
+    }
+    arena->data = malloc(size);
+    if (arena->data == NULL) {
+        free(arena);
+        return NULL;
+    }
+    arena->size                = size;
+    arena->memory.malloc       = arena_malloc;
+    arena->memory.calloc       = arena_calloc;
+    arena->memory.realloc      = arena_realloc;
+    arena->memory.reallocarray = arena_reallocarray;
+    arena->memory.free         = arena_free_block;
+    arena->memory.userData     = arena;
+    return arena;
+}
+
+void arena_reset(arena_t* arena) {
+    arena->used = 0;
+    arena->last = 0;
+}
+
+void arena_free(arena_t* arena) {
+    if (arena == NULL) {
+        return;
+    }
+    free(arena->data);
+    free(arena);
+}
@@ -0,0 +1,54 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Arena for the memory uriparser allocates while a request is handled.
+ *
+ * The allocations are taken from one block in order, freeing them does
+ * nothing, and the whole arena is reset when the request is finished. Every
+ * worker thread has an arena of its own, so the requests neither call malloc()
+ * nor contend for its lock. An allocation that does not fit fails, which
+ * uriparser reports as URI_ERROR_MALLOC.
+ */
+
+#pragma once
+
+#include "uriparser/Uri.h"
+#include <stddef.h>
+
+typedef struct arena {
+    /* Passed to the uriparser functions ending with Mm. */
+    UriMemoryManager memory;
+    char* data;
+    size_t size;
+    size_t used;
+    /* Offset of the latest allocation, which can grow in place. */
+    size_t last;
+} arena_t;
+
+/**
+ * brief Create an arena of size bytes.
+ *
+ * return The arena, or NULL if it could not be allocated.
+ */
+arena_t* arena_new(size_t size);
+
+/**
+ * brief Free all allocations of the arena at once.
+ */
+void arena_reset(arena_t* arena);
+
+void arena_free(arena_t* arena);
@@ -0,0 +1,179 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "event_hub.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+event_hub_t* event_hub_new(unsigned int max_clients) {
+    event_hub_t* hub = calloc(1, sizeof(event_hub_t));
+    if (hub == NULL) {
+        return NULL;
+    }
+    hub->max_clients = max_clients;
+    pthread_mutex_init(&hub->mutex, NULL);
+    return hub;
+}
+
+event_client_t* event_hub_subscribe(event_hub_t* hub) {
+    event_client_t* client = NULL;
+
+    pthread_mutex_lock(&hub->mutex);
+    if (hub->num_clients < hub->max_clients) {
+        client = calloc(1, sizeof(event_client_t));
+    }
+    if (client != NULL) {
+        // The waits are timed with the monotonic clock
+        pthread_condattr_t attr;
+        pthread_condattr_init(&attr);
+        pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+        pthread_cond_init(&client->cond, &attr);
+        pthread_condattr_destroy(&attr);
+
+        client->next = hub->clients;
+        hub->clients = client;
+        hub->num_clients++;
+    }
+    pthread_mutex_unlock(&hub->mutex);
+    return client;
+}
+
+void event_hub_unsubscribe(event_hub_t* hub, event_client_t* client) {
+    pthread_mutex_lock(&hub->mutex);
+    for (event_client_t** node = &hub->clients; *node != NULL; node = &(*node)->next) {
+        if (*node == client) {
+            *node = client->next;
+            hub->num_clients--;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&hub->mutex);
+
+    for (unsigned int i = 0; i < client->count; i++) {
+        event_unref(client->queue[(client->head + i) % EVENT_QUEUE_SIZE]);
+    }
+    pthread_cond_destroy(&client->cond);
+    free(client);
+}
+
+/**
+ * brief Format a server-sent event, with a data line per line of data.
+ */
+static event_t* new_event(unsigned long long id, const char* type, const char* data) {
+    size_t lines = 1;
+    for (const char* c = data; *c != '\0'; c++) {
+        lines += *c == '\n';
+    }
+
+    char header[64];
+    int header_size = snprintf(header, sizeof(header), "id: %llu\nevent: %s\n", id, type);
+    if (header_size < 0 || (size_t)header_size >= sizeof(header)) {
+        return NULL;
+    }
+    // "data: " and "\n" per line, and the empty line that ends the event
+    size_t capacity = (size_t)header_size + strlen(data) + lines * 7 + 1;
+    event_t* event  = malloc(sizeof(event_t) + capacity);
+    if (event == NULL) {
+        return NULL;
+    }
+
+    char* out = event->data;
+    memcpy(out, header, (size_t)header_size);
+    out += header_size;
+    while (1) {
+        size_t length = strcspn(data, "\n");
+        memcpy(out, "data: ", 6);
+        memcpy(out + 6, data, length);
+        out += 6 + length;
+        *out++ = '\n';
+        if (data[length] == '\0') {
+            break;
+        }
+        data += length + 1;
+    }
+    *out++ = '\n';
+
+    atomic_init(&event->refs, 1);
+    event->size = (size_t)(out - event->data);
+    return event;
+}
+
+void event_hub_publish(event_hub_t* hub, const char* type, const char* data) {
+    pthread_mutex_lock(&hub->mutex);
+    event_t* event = new_event(++hub->last_id, type, data);
+    if (event == NULL) {
+        goto unlock;
+    }
+
+    for (event_client_t* client = hub->clients; client != NULL; client = client->next) {
+        // Drop the oldest event when the queue is full
+        if (client->count == EVENT_QUEUE_SIZE) {
+            event_unref(client->queue[client->head]);
+            client->head = (client->head + 1) % EVENT_QUEUE_SIZE;
+            client->count--;
+            client->dropped++;
+        }
+        atomic_fetch_add(&event->refs, 1);
+        client->queue[(client->head + client->count) % EVENT_QUEUE_SIZE] = event;
+        client->count++;
+        pthread_cond_signal(&client->cond);
+    }
+    event_unref(event);
+
+unlock:
+    pthread_mutex_unlock(&hub->mutex);
+}
+
+event_t* event_hub_next(event_hub_t* hub,
+                        event_client_t* client,
+                        int timeout_ms,
+                        unsigned long long* dropped) {
+    event_t* event = NULL;
+    struct timespec deadline;
+
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (timeout_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    pthread_mutex_lock(&hub->mutex);
+    while (client->count == 0) {
+        if (pthread_cond_timedwait(&client->cond, &hub->mutex, &deadline) != 0) {
+            break;
+        }
+    }
+    if (client->count > 0) {
+        event        = client->queue[client->head];
+        client->head = (client->head + 1) % EVENT_QUEUE_SIZE;
+        client->count--;
+    }
+    *dropped        = client->dropped;
+    client->dropped = 0;
+    pthread_mutex_unlock(&hub->mutex);
+    return event;
+}
+
+void event_unref(event_t* event) {
+    if (event != NULL && atomic_fetch_sub(&event->refs, 1) == 1) {
+        free(event);
+    }
+}
@@ -0,0 +1,99 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * Fan-out of events to the clients of a server-sent events stream.
+ *
+ * An event is formatted as a server-sent event once, when it is published,
+ * and the same reference counted event is put in the queue of every client.
+ * The queue of a client is bounded, and when a client does not keep up the
+ * oldest events in its queue are dropped, so a slow client never holds up
+ * the publisher nor the other clients.
+ */
+
+#pragma once
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+
+// Events kept for a client that has not yet written them
+#define EVENT_QUEUE_SIZE 32
+
+typedef struct event {
+    atomic_uint refs;
+    size_t size;
+    // The formatted event, "id: ...\nevent: ...\ndata: ...\n\n"
+    char data[];
+} event_t;
+
+typedef struct event_client {
+    event_t* queue[EVENT_QUEUE_SIZE];
+    unsigned int head;
+    unsigned int count;
+    // Events dropped since the last call to event_hub_next()
+    unsigned long long dropped;
+    pthread_cond_t cond;
+    struct event_client* next;
+} event_client_t;
+
+typedef struct event_hub {
+    pthread_mutex_t mutex;
+    event_client_t* clients;
+    unsigned int num_clients;
+    unsigned int max_clients;
+    unsigned long long last_id;
+} event_hub_t;
+
+/**
+ * brief Create a hub for at most max_clients clients at the same time.
+ *
+ * return The hub, or NULL if it could not be allocated.
+ */
+event_hub_t* event_hub_new(unsigned int max_clients);
+
+/**
+ * brief Add a client, which gets the events published from now on.
+ *
+ * return The client, or NULL if the hub already has max_clients clients.
+ */
+event_client_t* event_hub_subscribe(event_hub_t* hub);
+
+void event_hub_unsubscribe(event_hub_t* hub, event_client_t* client);
+
+/**
+ * brief Publish an event to all clients.
+ *
+ * param type Type of the event, the event field of the server-sent event.
+ * param data Data of the event, a line of its own per line in the data.
+ */
+void event_hub_publish(event_hub_t* hub, const char* type, const char* data);
+
+/**
+ * brief Take the oldest event in the queue of a client, waiting for at most
+ *        timeout_ms milliseconds if the queue is empty.
+ *
+ * param dropped Set to the number of events dropped from the queue since the
+ *               last call.
+ *
+ * return The event, unreferenced with event_unref(), or NULL on timeout.
+ */
+event_t* event_hub_next(event_hub_t* hub,
+                        event_client_t* client,
+                        int timeout_ms,
+                        unsigned long long* dropped);
+
+void event_unref(event_t* event);
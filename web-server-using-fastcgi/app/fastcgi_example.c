@@ -14,28 +14,328 @@
  * limitations under the License.
  */
 
-#include "fcgi_stdio.h"
+#include "arena.h"
+#include "event_hub.h"
+#include "fcgiapp.h"
 #include "uriparser/Uri.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/stat.h>
 #include <syslog.h>
 
 #define FCGI_SOCKET_NAME "FCGI_SOCKET_NAME"
 
+// Number of requests handled at the same time
+#define NUM_WORKERS 8
+// Event streams held at the same time, each holds a worker
+#define MAX_STREAMS (NUM_WORKERS / 2)
+// A comment is sent on an idle event stream this often, which also tells when
+// the client has gone
+#define KEEPALIVE_MS (15 * 1000)
+// Connections from the web server waiting to be accepted
+#define LISTEN_BACKLOG 64
+// Memory of each worker for parsing the URI and the query string
+#define ARENA_SIZE (16 * 1024)
+// The response is written to the web server in chunks of this size
+#define RESPONSE_BUFFER_SIZE 4096
+
+// Append a string literal, its length is known at compile time
+#define APPEND_LITERAL(response, literal) append(response, literal, sizeof(literal) - 1)
+
+typedef struct response {
+    FCGX_Stream* out;
+    char data[RESPONSE_BUFFER_SIZE];
+    size_t used;
+} response_t;
+
+// FCGX_Accept_r() is serialized between the workers, as some platforms require
+static pthread_mutex_t accept_mutex = PTHREAD_MUTEX_INITIALIZER;
+static atomic_uint count;  // counter of requests
+static event_hub_t* hub;  // events to the clients of events.cgi
+
+static void flush(response_t* response) {
+    if (response->used > 0) {
+        FCGX_PutStr(response->data, (int)response->used, response->out);
+        response->used = 0;
+    }
+}
+
+static void append(response_t* response, const char* data, size_t size) {
+    if (size > sizeof(response->data) - response->used) {
+        flush(response);
+    }
+    if (size > sizeof(response->data)) {
+        FCGX_PutStr(data, (int)size, response->out);
+        return;
+    }
+    memcpy(response->data + response->used, data, size);
+    response->used += size;
+}
+
+/**
+ * brief Append a string with the HTML special characters escaped.
+ *
+ * The URI and the query come from the client and are never used as a format
+ * string nor written as markup.
+ */
+static void append_html(response_t* response, const char* text) {
+    while (*text != '\0') {
+        size_t plain = strcspn(text, "&<>\"'");
+        append(response, text, plain);
+        text += plain;
+
+        switch (*text) {
+            case '&':
+                APPEND_LITERAL(response, "&amp;");
+                break;
+            case '<':
+                APPEND_LITERAL(response, "&lt;");
+                break;
+            case '>':
+                APPEND_LITERAL(response, "&gt;");
+                break;
+            case '"':
+                APPEND_LITERAL(response, "&quot;");
+                break;
+            case '\'':
+                APPEND_LITERAL(response, "&#39;");
+                break;
+            default:
+                return;
+        }
+        text++;
+    }
+}
+
+static void append_uint(response_t* response, unsigned int value) {
+    char number[16];
+    int size = snprintf(number, sizeof(number), "%u", value);
+    append(response, number, (size_t)size);
+}
+
+/**
+ * brief Handle one HTTP request.
+ *
+ * The response is built in the buffer of the worker and written in as few
+ * chunks as possible. The URI and the query string are parsed with the memory
+ * of the arena of the worker.
+ */
+static void handle_request(FCGX_Request* request, arena_t* arena, response_t* response) {
+    response->out  = request->out;
+    response->used = 0;
+
+    // Write the HTTP header and the HTML greeting
+    APPEND_LITERAL(response, "Content-Type: text/html\n\n<h1>Hello ");
+
+    // Parse the uri and the query string
+    const char* uriString = FCGX_GetParam("REQUEST_URI", request->envp);
+
+    UriUriA uri;
+    UriQueryListA* queryList;
+    int itemCount;
+    const char* errorPos;
+
+    // Parse the URI into data structure
+    if (uriString == NULL ||
+        uriParseSingleUriExMmA(&uri, uriString, NULL, &errorPos, &arena->memory) != URI_SUCCESS) {
+        /* Failure (no need to call uriFreeUriMembersMmA) */
+        APPEND_LITERAL(response, "Failed to parse URI");
+        flush(response);
+        return;
+    }
+
+    // Parse the query string into data structure
+    if (uriDissectQueryMallocExMmA(&queryList,
+                                   &itemCount,
+                                   uri.query.first,
+                                   uri.query.afterLast,
+                                   URI_TRUE,
+                                   URI_BR_DONT_TOUCH,
+                                   &arena->memory) != URI_SUCCESS) {
+        /* Failure */
+        APPEND_LITERAL(response, "Failed to parse query");
+        flush(response);
+        uriFreeUriMembersMmA(&uri, &arena->memory);
+        return;
+    }
+
+    // Find and print the name parameter in the query string
+    UriQueryListA* queryItem = queryList;
+
+    while (queryItem) {
+        if (strcmp(queryItem->key, "name") == 0 && queryItem->value != NULL) {
+            append_html(response, queryItem->value);
+        }
+        queryItem = queryItem->next;
+    }
+
+    // print the rest of the body
+    unsigned int number = atomic_fetch_add(&count, 1) + 1;
+    APPEND_LITERAL(response, " from FastCGI</h1> Request number ");
+    append_uint(response, number);
+    APPEND_LITERAL(response, "<br>URI: ");
+    append_html(response, uriString);
+    APPEND_LITERAL(response, "<br>KEY, ITEM: ");
+
+    queryItem = queryList;
+
+    while (queryItem) {
+        APPEND_LITERAL(response, "<br>");
+        append_html(response, queryItem->key);
+        APPEND_LITERAL(response, ", ");
+        if (queryItem->value != NULL) {
+            append_html(response, queryItem->value);
+        } else {
+            APPEND_LITERAL(response, "Null");
+        }
+        queryItem = queryItem->next;
+    }
+
+    flush(response);
+    uriFreeUriMembersMmA(&uri, &arena->memory);
+    uriFreeQueryListMmA(queryList, &arena->memory);
+
+    // Push the request to the event streams
+    char event[32];
+    snprintf(event, sizeof(event), "{\"request\": %u}", number);
+    event_hub_publish(hub, "request", event);
+}
+
+/**
+ * brief Tell the client how many events it missed, as a comment of the event stream.
+ */
+static int put_dropped(FCGX_Request* request, unsigned long long dropped) {
+    char comment[48];
+    int size = snprintf(comment, sizeof(comment), ": %llu events dropped\n\n", dropped);
+    return FCGX_PutStr(comment, size, request->out);
+}
+
+/**
+ * brief Stream the published events to the client as server-sent events.
+ *
+ * The connection is held until the client goes, which is noticed when a write
+ * fails. The events that are queued when the worker wakes up are written as
+ * one batch.
+ */
+static void handle_stream(FCGX_Request* request) {
+    event_client_t* client = event_hub_subscribe(hub);
+    if (client == NULL) {
+        static const char busy[] = "Status: 503 Service Unavailable\n"
+                                   "Content-Type: text/plain\n\n"
+                                   "Too many event streams\n";
+        FCGX_PutStr(busy, sizeof(busy) - 1, request->out);
+        return;
+    }
+
+    static const char header[] = "Content-Type: text/event-stream\n"
+                                 "Cache-Control: no-cache\n\n"
+                                 ": connected\n\n";
+    int status = FCGX_PutStr(header, sizeof(header) - 1, request->out);
+
+    while (status >= 0 && FCGX_FFlush(request->out) >= 0) {
+        unsigned long long dropped = 0;
+        event_t* event             = event_hub_next(hub, client, KEEPALIVE_MS, &dropped);
+        if (dropped > 0) {
+            status = put_dropped(request, dropped);
+        }
+        if (event == NULL) {
+            if (status >= 0) {
+                status = FCGX_PutStr(": keepalive\n\n", 13, request->out);
+            }
+            continue;
+        }
+        // Events dropped while the batch is written are reported after it
+        unsigned long long batch_dropped = 0;
+        while (event != NULL && status >= 0) {
+            status = FCGX_PutStr(event->data, (int)event->size, request->out);
+            event_unref(event);
+            event = event_hub_next(hub, client, 0, &dropped);
+            batch_dropped += dropped;
+        }
+        event_unref(event);
+        if (batch_dropped > 0 && status >= 0) {
+            status = put_dropped(request, batch_dropped);
+        }
+    }
+
+    event_hub_unsubscribe(hub, client);
+}
+
+/**
+ * brief Tell whether the request is for the CGI with the given name.
+ */
+static int is_script(FCGX_Request* request, const char* name) {
+    const char* script = FCGX_GetParam("SCRIPT_NAME", request->envp);
+    if (script == NULL) {
+        return 0;
+    }
+    const char* base = strrchr(script, '/');
+    return strcmp(base != NULL ? base + 1 : script, name) == 0;
+}
+
+/**
+ * brief Accept and handle requests on the socket until it fails.
+ *
+ * Every worker has a request, an arena and a response buffer of its own, and
+ * nothing is logged per request.
+ */
+static void* worker_thread(void* data) {
+    int sock = *(int*)data;
+    FCGX_Request request;
+    arena_t* arena       = arena_new(ARENA_SIZE);
+    response_t* response = malloc(sizeof(response_t));
+
+    if (arena == NULL || response == NULL) {
+        syslog(LOG_ERR, "Failed to allocate the memory of a worker");
+        goto out;
+    }
+    if (FCGX_InitRequest(&request, sock, 0) != 0) {
+        syslog(LOG_ERR, "FCGX_InitRequest failed");
+        goto out;
+    }
+
+    while (1) {
+        pthread_mutex_lock(&accept_mutex);
+        int status = FCGX_Accept_r(&request);
+        pthread_mutex_unlock(&accept_mutex);
+        if (status < 0) {
+            syslog(LOG_ERR, "FCGX_Accept_r failed: %d", status);
+            break;
+        }
+
+        if (is_script(&request, "events.cgi")) {
+            handle_stream(&request);
+        } else {
+            handle_request(&request, arena, response);
+        }
+        FCGX_Finish_r(&request);
+        arena_reset(arena);
+    }
+    FCGX_Free(&request, 1);
+
+out:
+    free(response);
+    arena_free(arena);
+    return NULL;
+}
+
 /**
  * brief Initialize fastcgi and request handling.
  *
- * Set up fastcgi and define how an HTTP request should be handled.
+ * Set up fastcgi and start the workers that handle the HTTP requests.
  *
  * return EXIT_FAILURE if any errors occur, otherwise EXIT_SUCCESS.
  */
 
 static int fcgi_run(void) {
-    int count = 0;  // counter of requests
     int sock;
-    FCGX_Request request;
     char* socket_path = NULL;
     int status;
+    pthread_t workers[NUM_WORKERS];
+    int num_workers = 0;
 
     socket_path = getenv(FCGI_SOCKET_NAME);
 
@@ -53,84 +353,34 @@ static int fcgi_run(void) {
         return status;
     }
 
-    sock = FCGX_OpenSocket(socket_path, 5);
-    chmod(socket_path, S_IRWXU | S_IRWXG | S_IRWXO);
-    status = FCGX_InitRequest(&request, sock, 0);
-
-    if (status != 0) {
-        syslog(LOG_INFO, "FCGX_InitRequest failed");
-        return status;
+    hub = event_hub_new(MAX_STREAMS);
+    if (hub == NULL) {
+        syslog(LOG_ERR, "Failed to create the event hub");
+        return EXIT_FAILURE;
     }
 
-    syslog(LOG_INFO, "Starting loop");
-
-    while (FCGX_Accept_r(&request) == 0) {
-        syslog(LOG_INFO, "FCGX_Accept_r OK");
-        // Write the HTTP header
-        FCGX_FPrintF(request.out, "Content-Type: text/html\n\n");
-        // Write the HTML greeting
-        FCGX_FPrintF(request.out, "<h1>Hello ");
-
-        // Parse the uri and the query string
-        const char* uriString = FCGX_GetParam("REQUEST_URI", request.envp);
-
-        UriUriA uri;
-        UriQueryListA* queryList;
-        int itemCount;
-        const char* errorPos;
-
-        syslog(LOG_INFO, "Parsing URI: %s", uriString);
-
-        // Parse the URI into data structure
-        if (uriParseSingleUriA(&uri, uriString, &errorPos) != URI_SUCCESS) {
-            /* Failure (no need to call uriFreeUriMembersA) */
-            FCGX_FPrintF(request.out, "Failed to parse URI");
-            FCGX_Finish_r(&request);
-            continue;
-        }
-
-        syslog(LOG_INFO, "URI: %s", uriString);
+    sock = FCGX_OpenSocket(socket_path, LISTEN_BACKLOG);
+    if (sock < 0) {
+        syslog(LOG_ERR, "FCGX_OpenSocket failed");
+        return EXIT_FAILURE;
+    }
+    chmod(socket_path, S_IRWXU | S_IRWXG | S_IRWXO);
 
-        // Parse the query string into data structure
-        if (uriDissectQueryMallocA(&queryList, &itemCount, uri.query.first, uri.query.afterLast) !=
-            URI_SUCCESS) {
-            /* Failure */
-            FCGX_FPrintF(request.out, "Failed to parse query");
-            FCGX_Finish_r(&request);
-            uriFreeUriMembersA(&uri);
+    for (int i = 0; i < NUM_WORKERS; i++) {
+        if (pthread_create(&workers[num_workers], NULL, worker_thread, &sock) != 0) {
+            syslog(LOG_WARNING, "Failed to create worker %d", i);
             continue;
         }
+        num_workers++;
+    }
+    if (num_workers == 0) {
+        return EXIT_FAILURE;
+    }
 
-        // Find and print the name parameter in the query string
-        UriQueryListA* queryItem = queryList;
-
-        while (queryItem) {
-            if (strcmp(queryItem->key, "name") == 0 && queryItem->value != NULL) {
-                FCGX_FPrintF(request.out, "%s", queryItem->value);
-            }
-            queryItem = queryItem->next;
-        }
-
-        // print the rest of the body
-        FCGX_FPrintF(request.out, " from FastCGI</h1> Request number %d", ++count);
-        FCGX_FPrintF(request.out, "<br>URI: ");
-        FCGX_FPrintF(request.out, (uriString ? uriString : "NULL"));
-        FCGX_FPrintF(request.out, "<br>KEY, ITEM: ");
-
-        queryItem = queryList;
+    syslog(LOG_INFO, "Starting %d workers", num_workers);
 
-        while (queryItem) {
-            if (queryItem->value != NULL) {
-                FCGX_FPrintF(request.out, "<br>%s, %s", queryItem->key, queryItem->value);
-            } else {
-                FCGX_FPrintF(request.out, "<br>%s, Null", queryItem->key);
-            }
-            queryItem = queryItem->next;
-        }
-
-        FCGX_Finish_r(&request);
-        uriFreeUriMembersA(&uri);
-        uriFreeQueryListA(queryList);
+    for (int i = 0; i < num_workers; i++) {
+        pthread_join(workers[i], NULL);
     }
 
     return EXIT_SUCCESS;
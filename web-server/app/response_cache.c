@@ -0,0 +1,191 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "response_cache.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static uint64_t now_ms(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000 + (uint64_t)now.tv_nsec / 1000000;
+}
+
+// 64-bit FNV-1a
+static uint64_t hash(const char* data, size_t size) {
+    uint64_t value = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < size; i++) {
+        value ^= (unsigned char)data[i];
+        value *= 0x100000001b3ULL;
+    }
+    return value;
+}
+
+response_cache_t* response_cache_new(unsigned int max_entries) {
+    response_cache_t* cache = calloc(1, sizeof(response_cache_t));
+    if (cache == NULL) {
+        return NULL;
+    }
+    cache->entries = calloc(max_entries, sizeof(cache_entry_t*));
+    if (cache->entries == NULL) {
+        free(cache);
+        return NULL;
+    }
+    cache->max_entries = max_entries;
+    pthread_mutex_init(&cache->mutex, NULL);
+    pthread_cond_init(&cache->cond, NULL);
+    return cache;
+}
+
+void response_cache_free(response_cache_t* cache) {
+    if (cache == NULL) {
+        return;
+    }
+    for (unsigned int i = 0; i < cache->num_entries; i++) {
+        cache_entry_unref(cache->entries[i]);
+    }
+    pthread_cond_destroy(&cache->cond);
+    pthread_mutex_destroy(&cache->mutex);
+    free(cache->entries);
+    free(cache);
+}
+
+static int find(response_cache_t* cache, const char* key) {
+    for (unsigned int i = 0; i < cache->num_entries; i++) {
+        if (strcmp(cache->entries[i]->key, key) == 0) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+static void remove_at(response_cache_t* cache, unsigned int index) {
+    cache_entry_unref(cache->entries[index]);
+    cache->entries[index] = cache->entries[--cache->num_entries];
+}
+
+/**
+ * Make room for an entry by removing the ready entry that expires first.
+ *
+ * Returns zero if all entries are being generated.
+ */
+static int make_room(response_cache_t* cache) {
+    int oldest = -1;
+    for (unsigned int i = 0; i < cache->num_entries; i++) {
+        cache_entry_t* entry = cache->entries[i];
+        if (entry->ready &&
+            (oldest < 0 || entry->expires_ms < cache->entries[oldest]->expires_ms)) {
+            oldest = (int)i;
+        }
+    }
+    if (oldest < 0) {
+        return 0;
+    }
+    remove_at(cache, (unsigned int)oldest);
+    return 1;
+}
+
+cache_entry_t* response_cache_get(response_cache_t* cache,
+                                  const char* key,
+                                  unsigned int ttl_s,
+                                  const char* content_type,
+                                  cache_generate_t generate,
+                                  void* user_data) {
+    cache_entry_t* entry = NULL;
+
+    pthread_mutex_lock(&cache->mutex);
+    while (1) {
+        int index = find(cache, key);
+        if (index < 0) {
+            break;
+        }
+        entry = cache->entries[index];
+        if (!entry->ready) {
+            // Wait for the request that generates the response
+            pthread_cond_wait(&cache->cond, &cache->mutex);
+            continue;
+        }
+        if (now_ms() < entry->expires_ms) {
+            atomic_fetch_add(&entry->refs, 1);
+            cache->hits++;
+            pthread_mutex_unlock(&cache->mutex);
+            return entry;
+        }
+        remove_at(cache, (unsigned int)index);
+        break;
+    }
+    cache->misses++;
+
+    entry = calloc(1, sizeof(cache_entry_t));
+    if (entry == NULL || (entry->key = strdup(key)) == NULL) {
+        free(entry);
+        pthread_mutex_unlock(&cache->mutex);
+        return NULL;
+    }
+    atomic_init(&entry->refs, 1);
+    entry->content_type = content_type;
+
+    // Without room, or with a time to live of 0, the response is generated
+    // for this request only
+    if (ttl_s > 0 && (cache->num_entries < cache->max_entries || make_room(cache))) {
+        atomic_fetch_add(&entry->refs, 1);
+        cache->entries[cache->num_entries++] = entry;
+    }
+    pthread_mutex_unlock(&cache->mutex);
+
+    entry->body = generate(user_data, &entry->size);
+    if (entry->body != NULL) {
+        snprintf(entry->etag,
+                 sizeof(entry->etag),
+                 "\"%016" PRIx64 "\"",
+                 hash(entry->body, entry->size));
+        entry->expires_ms = now_ms() + (uint64_t)ttl_s * 1000;
+    }
+
+    pthread_mutex_lock(&cache->mutex);
+    entry->ready = 1;
+    if (entry->body == NULL) {
+        int index = find(cache, key);
+        if (index >= 0 && cache->entries[index] == entry) {
+            remove_at(cache, (unsigned int)index);
+        }
+    }
+    pthread_cond_broadcast(&cache->cond);
+    pthread_mutex_unlock(&cache->mutex);
+
+    if (entry->body == NULL) {
+        cache_entry_unref(entry);
+        return NULL;
+    }
+    return entry;
+}
+
+unsigned int cache_entry_max_age(const cache_entry_t* entry) {
+    uint64_t now = now_ms();
+    return entry->expires_ms > now ? (unsigned int)((entry->expires_ms - now + 999) / 1000) : 0;
+}
+
+void cache_entry_unref(cache_entry_t* entry) {
+    if (entry != NULL && atomic_fetch_sub(&entry->refs, 1) == 1) {
+        free(entry->body);
+        free(entry->key);
+        free(entry);
+    }
+}
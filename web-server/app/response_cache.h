@@ -0,0 +1,90 @@
+/**
+ * Copyright (C) 2025, Axis Communications AB, Lund, Sweden
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     https://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/**
+ * In-memory cache of generated responses, keyed by the URI of the request.
+ *
+ * A response is generated on the first request for its URI, and the following
+ * requests get the same response until its time to live has passed. Requests
+ * that arrive while the response is generated wait for it instead of
+ * generating it again. Every response has an ETag from a hash of its body, so
+ * a client that already has it can be answered with 304 Not Modified.
+ */
+
+#pragma once
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct cache_entry {
+    atomic_uint refs;
+    char* key;
+    const char* content_type;
+    // Quoted hash of the body
+    char etag[20];
+    uint64_t expires_ms;
+    char* body;
+    size_t size;
+    // Zero while the response is generated
+    int ready;
+} cache_entry_t;
+
+typedef struct response_cache {
+    pthread_mutex_t mutex;
+    // Signaled when a response has been generated
+    pthread_cond_t cond;
+    cache_entry_t** entries;
+    unsigned int num_entries;
+    unsigned int max_entries;
+    unsigned long long hits;
+    unsigned long long misses;
+} response_cache_t;
+
+/**
+ * Generate a response, return the body allocated with malloc(), or NULL on
+ * failure.
+ */
+typedef char* (*cache_generate_t)(void* user_data, size_t* size);
+
+response_cache_t* response_cache_new(unsigned int max_entries);
+
+void response_cache_free(response_cache_t* cache);
+
+/**
+ * Get the response for key, generated by generate if there is none that is
+ * younger than ttl_s seconds.
+ *
+ * When the cache is full, the entry that expires first is replaced. With a
+ * ttl_s of 0 the response is not cached.
+ *
+ * Returns the entry, unreferenced with cache_entry_unref(), or NULL if the
+ * response could not be generated.
+ */
+cache_entry_t* response_cache_get(response_cache_t* cache,
+                                  const char* key,
+                                  unsigned int ttl_s,
+                                  const char* content_type,
+                                  cache_generate_t generate,
+                                  void* user_data);
+
+/**
+ * Seconds until the entry expires, for the max-age of the response.
+ */
+unsigned int cache_entry_max_age(const cache_entry_t* entry);
+
+void cache_entry_unref(cache_entry_t* entry);
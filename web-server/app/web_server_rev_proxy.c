@@ -15,17 +15,34 @@
  */
 
 #include "civetweb.h"
+#include "response_cache.h"
+#include <axsdk/axparameter.h>
 #include <signal.h>
 #include <stdarg.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <syslog.h>
 #include <time.h>
 #include <unistd.h>
 
-#define PORT "2001"
+#define APP_NAME "web_server_rev_proxy"
+#define PORT     "2001"
+// Responses kept in the cache, one per URI
+#define CACHE_MAX_ENTRIES 32
+#define STATS_SIZE        512
 volatile sig_atomic_t application_running = 1;
 
+// An endpoint whose responses are generated and cached
+typedef struct cached_endpoint {
+    const char* content_type;
+    cache_generate_t generate;
+} cached_endpoint_t;
+
+static response_cache_t* cache;
+static unsigned int cache_ttl_s;
+static unsigned int num_threads;
+
 __attribute__((noreturn)) __attribute__((format(printf, 1, 2))) static void
 panic(const char* format, ...) {
     va_list arg;
@@ -45,24 +62,197 @@ static int root_handler(struct mg_connection* conn, void* cb_data __attribute__(
     return 1;
 }
 
+static int get_int_parameter(AXParameter* handle, const char* name) {
+    gchar* str_value = NULL;
+    GError* error    = NULL;
+    int value;
+
+    if (!ax_parameter_get(handle, name, &str_value, &error)) {
+        panic("%s", error->message);
+    }
+    if (sscanf(str_value, "%d", &value) != 1) {
+        panic("Parameter %s was not an int", name);
+    }
+    g_free(str_value);
+    return value;
+}
+
+// Read a value like "MemTotal:" from /proc/meminfo, in kB
+static unsigned long read_meminfo(const char* name) {
+    FILE* file          = fopen("/proc/meminfo", "r");
+    unsigned long value = 0;
+    char line[128];
+
+    if (file == NULL) {
+        return 0;
+    }
+    while (fgets(line, sizeof(line), file) != NULL) {
+        if (strncmp(line, name, strlen(name)) == 0) {
+            sscanf(line + strlen(name), "%lu", &value);
+            break;
+        }
+    }
+    fclose(file);
+    return value;
+}
+
+// Statistics of the device and the server, read from /proc on every miss
+static char* generate_stats(void* user_data, size_t* size) {
+    double uptime = 0;
+    double load   = 0;
+    FILE* file    = NULL;
+    char* body    = malloc(STATS_SIZE);
+    (void)user_data;
+
+    if (body == NULL) {
+        return NULL;
+    }
+
+    if ((file = fopen("/proc/uptime", "r")) != NULL) {
+        if (fscanf(file, "%lf", &uptime) != 1) {
+            uptime = 0;
+        }
+        fclose(file);
+    }
+    if ((file = fopen("/proc/loadavg", "r")) != NULL) {
+        if (fscanf(file, "%lf", &load) != 1) {
+            load = 0;
+        }
+        fclose(file);
+    }
+
+    pthread_mutex_lock(&cache->mutex);
+    unsigned long long hits   = cache->hits;
+    unsigned long long misses = cache->misses;
+    pthread_mutex_unlock(&cache->mutex);
+
+    int length = snprintf(body,
+                          STATS_SIZE,
+                          "{\"uptime\": %.0f, \"load\": %.2f, \"memTotalKb\": %lu, "
+                          "\"memAvailableKb\": %lu, \"threads\": %u, \"cacheHits\": %llu, "
+                          "\"cacheMisses\": %llu}\n",
+                          uptime,
+                          load,
+                          read_meminfo("MemTotal:"),
+                          read_meminfo("MemAvailable:"),
+                          num_threads,
+                          hits,
+                          misses);
+    if (length < 0 || length >= STATS_SIZE) {
+        free(body);
+        return NULL;
+    }
+    *size = (size_t)length;
+    return body;
+}
+
+// Send a response from the cache, or 304 if the client already has it
+static int send_entry(struct mg_connection* conn, const cache_entry_t* entry) {
+    const struct mg_request_info* info = mg_get_request_info(conn);
+    const char* if_none_match          = mg_get_header(conn, "If-None-Match");
+    unsigned int max_age               = cache_entry_max_age(entry);
+
+    if (if_none_match != NULL &&
+        (strcmp(if_none_match, "*") == 0 || strstr(if_none_match, entry->etag) != NULL)) {
+        mg_printf(conn,
+                  "HTTP/1.1 304 Not Modified\r\n"
+                  "ETag: %s\r\n"
+                  "Cache-Control: max-age=%u\r\n\r\n",
+                  entry->etag,
+                  max_age);
+        return 304;
+    }
+
+    mg_printf(conn,
+              "HTTP/1.1 200 OK\r\n"
+              "Content-Type: %s\r\n"
+              "Content-Length: %zu\r\n"
+              "ETag: %s\r\n"
+              "Cache-Control: max-age=%u\r\n\r\n",
+              entry->content_type,
+              entry->size,
+              entry->etag,
+              max_age);
+    if (strcmp(info->request_method, "HEAD") != 0) {
+        mg_write(conn, entry->body, entry->size);
+    }
+    return 200;
+}
+
+static int cached_handler(struct mg_connection* conn, void* cb_data) {
+    const struct mg_request_info* info = mg_get_request_info(conn);
+    const cached_endpoint_t* endpoint  = cb_data;
+    char key[512];
+
+    // The responses differ by path and query
+    snprintf(key,
+             sizeof(key),
+             "%s?%s",
+             info->local_uri,
+             info->query_string != NULL ? info->query_string : "");
+
+    cache_entry_t* entry = response_cache_get(cache,
+                                              key,
+                                              cache_ttl_s,
+                                              endpoint->content_type,
+                                              endpoint->generate,
+                                              NULL);
+    if (entry == NULL) {
+        mg_send_http_error(conn, 500, "Failed to generate the response");
+        return 500;
+    }
+    int status = send_entry(conn, entry);
+    cache_entry_unref(entry);
+    return status;
+}
+
 int main(void) {
     signal(SIGTERM, stop_application);
     signal(SIGINT, stop_application);
 
+    GError* error       = NULL;
+    AXParameter* handle = ax_parameter_new(APP_NAME, &error);
+    if (handle == NULL) {
+        panic("%s", error->message);
+    }
+    num_threads = (unsigned int)get_int_parameter(handle, "NumThreads");
+    cache_ttl_s = (unsigned int)get_int_parameter(handle, "CacheTtlSeconds");
+    ax_parameter_free(handle);
+
+    cache = response_cache_new(CACHE_MAX_ENTRIES);
+    if (!cache) {
+        panic("Failed to create the response cache");
+    }
+
     mg_init_library(0);
 
+    char threads[16];
+    snprintf(threads, sizeof(threads), "%u", num_threads);
+
     struct mg_callbacks callbacks = {0};
-    const char* options[] =
-        {"listening_ports", PORT, "request_timeout_ms", "10000", "error_log_file", "error.log", 0};
+    const char* options[]         = {"listening_ports",
+                                     PORT,
+                                     "request_timeout_ms",
+                                     "10000",
+                                     "error_log_file",
+                                     "error.log",
+                                     "num_threads",
+                                     threads,
+                                     0};
 
     struct mg_context* context = mg_start(&callbacks, 0, options);
     if (!context) {
         panic("Something went wrong when starting the web server");
     }
 
-    syslog(LOG_INFO, "Server has started");
+    syslog(LOG_INFO,
+           "Server has started with %u threads, responses are cached for %u s",
+           num_threads,
+           cache_ttl_s);
 
+    static const cached_endpoint_t stats = {"application/json", generate_stats};
     mg_set_request_handler(context, "/", root_handler, 0);
+    mg_set_request_handler(context, "/stats", cached_handler, (void*)&stats);
 
     while (application_running) {
         sleep(1);
@@ -70,6 +260,7 @@ int main(void) {
 
     mg_stop(context);
     mg_exit_library();
+    response_cache_free(cache);
 
     return EXIT_SUCCESS;
 }